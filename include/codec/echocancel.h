@@ -50,14 +50,24 @@ class OpalEchoCanceler : public PObject
 {
   PCLASSINFO(OpalEchoCanceler, PObject);
 public:
+  enum Algorithm {
+    SpeexAlgorithm,       ///< Speex frequency domain acoustic echo canceller
+    NLMSAlgorithm,        ///< Fixed point time domain NLMS, suits line echo on gateways
+    NumAlgorithms
+  };
+
   struct Params {
     Params()
       : m_enabled(false)
       , m_duration(2000) // 250ms at 8kHz
+      , m_algorithm(SpeexAlgorithm)
+      , m_batched(false)
     { }
 
     bool    m_enabled;    ///< Echo cancellation will be performed
     unsigned m_duration;  ///< Number of samples of echo to cancel
+    Algorithm m_algorithm; ///< Echo cancellation algorithm to use
+    bool    m_batched;    ///< Cancel on a shared worker per core, with other calls frames
 
   };
 
@@ -89,10 +99,33 @@ public:
       const int clockRate     ///> Clock Rate for the preprocessor
     );
 
+
+    /**Cancel the echo in the captured frames of several calls in one pass.
+       This is what the per core workers do for Params::m_batched, it is
+       public for applications that run their own media workers. Each
+       frame is cancelled in place against the far end its canceler has
+       been sent so far.
+     */
+    static void CancelBatch(
+      OpalEchoCanceler * const * cancelers, ///> Canceler for each frame
+      RTP_DataFrame * const * frames,       ///> Captured frames to cancel
+      PINDEX count                          ///> Number of frames
+    );
+
 protected:
   PDECLARE_NOTIFIER(RTP_DataFrame, OpalEchoCanceler, ReceivedPacket);
   PDECLARE_NOTIFIER(RTP_DataFrame, OpalEchoCanceler, SentPacket);
 
+  void Cancel(RTP_DataFrame & input_frame);
+  void CancelSpeex(RTP_DataFrame & input_frame);
+  void CancelNLMS(RTP_DataFrame & input_frame);
+  void DestroyStates();
+  bool AllocateBuffers(size_t size);
+  void FreeBuffers();
+
+  struct NLMSState;
+  friend class OpalEchoCancelerWorker;
+
   PNotifier receiveHandler;
   PNotifier sendHandler;
 
@@ -104,12 +137,16 @@ protected:
   PMutex stateMutex;
   SpeexEchoState *echoState;
   SpeexPreprocessState *preprocessState;
+  NLMSState *nlmsState;
+  unsigned batchWorker;
+  PSyncPoint batchDone;
 
   // the following types are all void * to avoid including Speex header files
   void * ref_buf;
   void * echo_buf;
   void * e_buf;
   void * noise;
+  size_t bufferSize;
 };
 
 
@@ -227,6 +227,8 @@ struct PluginCodec_Definition;
 #define PLUGINCODEC_CONTROL_SET_LOG_FUNCTION      "set_log_function"
 #define PLUGINCODEC_CONTROL_GET_STATISTICS        "get_statistics"
 #define PLUGINCODEC_CONTROL_TERMINATE_CODEC       "terminate_codec"
+#define PLUGINCODEC_CONTROL_GET_INPUT_BUFFER      "get_input_buffer"
+#define PLUGINCODEC_CONTROL_ENCODE_ACCESS_UNIT    "encode_access_unit"
 
 
 /* Log function, plug in gets a pointer to this function which allows
@@ -328,6 +330,8 @@ struct PluginCodec_Option {
 #define PLUGINCODEC_OPTION_TX_KEY_FRAME_PERIOD        "Tx Key Frame Period"
 #define PLUGINCODEC_OPTION_VOICE_ACTIVITY_DETECT      "VAD"
 #define PLUGINCODEC_OPTION_DYNAMIC_PACKET_LOSS        "Dynamic Packet Loss"
+#define PLUGINCODEC_OPTION_ENCODER_THREADS            "Encoder Threads"
+#define PLUGINCODEC_OPTION_DECODER_THREADS            "Decoder Threads"
 
 #define PLUGINCODEC_OPTION_PROTOCOL      "Protocol"
 #define PLUGINCODEC_OPTION_PROTOCOL_H323 "H.323"
@@ -918,6 +922,48 @@ struct PluginCodec_Video_FrameHeader {
   unsigned int  height;
 };
 
+/* Parameter for PLUGINCODEC_CONTROL_GET_INPUT_BUFFER. On entry m_size is the
+   size of the next input frame, including the RTP header. If the encoder can
+   read its input from memory it owns, e.g. shared with a helper process, it
+   sets m_buffer to at least that many bytes. The caller may then build the
+   frame there before passing it to the codec function, saving a copy. The
+   memory is valid until the next call of the control. */
+struct PluginCodec_InputBuffer {
+  void *        m_buffer;
+  unsigned int  m_size;
+};
+
+/* Parameter for PLUGINCODEC_CONTROL_ENCODE_ACCESS_UNIT. This is an alternative
+   to the codec function for video encoders, which encodes a whole frame and
+   returns it as an access unit, e.g. the H.264 NAL units without start codes,
+   leaving OPAL to packetise it straight into the RTP frames it sends.
+
+   On entry m_input/m_inputLength is the RTP frame of raw video, as would be
+   passed to the codec function, and m_flags may contain
+   PluginCodec_CoderForceIFrame. On return m_data points to the coded data,
+   owned by the encoder and valid until the next call, with m_units giving
+   the offset and length of each unit in it, and m_flags has
+   PluginCodec_ReturnCoderIFrame if appropriate. If m_unitCount is zero the
+   encoder produced nothing for this frame.
+
+   The control returns 1 on success, 0 if the encoder cannot return access
+   units at this time, so the normal codec function must be used for this
+   frame, and -1 on error. */
+struct PluginCodec_NALUnit {
+  unsigned int  m_offset;
+  unsigned int  m_length;
+};
+
+struct PluginCodec_AccessUnit {
+  const void *                 m_input;
+  unsigned int                 m_inputLength;
+  unsigned int                 m_flags;
+  const unsigned char *        m_data;
+  unsigned int                 m_dataLength;
+  const PluginCodec_NALUnit *  m_units;
+  unsigned int                 m_unitCount;
+};
+
 #ifdef __cplusplus
 };
 
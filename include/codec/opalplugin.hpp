@@ -688,6 +688,24 @@ class PluginCodec : public PluginCodec_Utilities
     }
 
 
+    /** Get memory owned by the codec to build the next input frame in.
+        Returns NULL if the codec has none, and the caller uses its own.
+      */
+    virtual void * GetInputBuffer(size_t /*size*/)
+    {
+      return NULL;
+    }
+
+
+    /** Encode a whole frame as an access unit, for OPAL to packetise.
+        Returns 0 if the codec cannot do so, and the normal Transcode() is used.
+      */
+    virtual int EncodeAccessUnit(PluginCodec_AccessUnit & /*accessUnit*/)
+    {
+      return 0;
+    }
+
+
     /** Set the instance ID for the codec.
         This is used to match up the encode and decoder pairs of instances for
         a given call. While most codecs like G.723.1 are purely unidirectional,
@@ -978,6 +996,24 @@ class PluginCodec : public PluginCodec_Utilities
       return codec != NULL && codec->Terminate();
     }
 
+    static int GetInputBuffer_s(const PluginCodec_Definition *, void * context, const char *, void * parm, unsigned * len)
+    {
+      if (context == NULL || parm == NULL || len == NULL || *len != sizeof(PluginCodec_InputBuffer))
+        return false;
+
+      PluginCodec_InputBuffer * input = (PluginCodec_InputBuffer *)parm;
+      input->m_buffer = ((PluginCodec *)context)->GetInputBuffer(input->m_size);
+      return input->m_buffer != NULL;
+    }
+
+    static int EncodeAccessUnit_s(const PluginCodec_Definition *, void * context, const char *, void * parm, unsigned * len)
+    {
+      if (context == NULL || parm == NULL || len == NULL || *len != sizeof(PluginCodec_AccessUnit))
+        return -1;
+
+      return ((PluginCodec *)context)->EncodeAccessUnit(*(PluginCodec_AccessUnit *)parm);
+    }
+
     static struct PluginCodec_ControlDefn * GetControls()
     {
       static PluginCodec_ControlDefn ControlsTable[] = {
@@ -992,6 +1028,8 @@ class PluginCodec : public PluginCodec_Utilities
         { PLUGINCODEC_CONTROL_SET_INSTANCE_ID,       PluginCodec::SetInstanceID_s },
         { PLUGINCODEC_CONTROL_GET_STATISTICS,        PluginCodec::GetStatistics_s },
         { PLUGINCODEC_CONTROL_TERMINATE_CODEC,       PluginCodec::Terminate_s },
+        { PLUGINCODEC_CONTROL_GET_INPUT_BUFFER,      PluginCodec::GetInputBuffer_s },
+        { PLUGINCODEC_CONTROL_ENCODE_ACCESS_UNIT,    PluginCodec::EncodeAccessUnit_s },
         PLUGINCODEC_CONTROL_LOG_FUNCTION_INC
         { NULL }
       };
@@ -1067,6 +1105,7 @@ class PluginVideoEncoder : public PluginVideoCodec<NAME>
     unsigned m_maxRTPSize;
     unsigned m_tsto;
     unsigned m_keyFramePeriod;
+    unsigned m_threads;
 
   public:
     PluginVideoEncoder(const PluginCodec_Definition * defn)
@@ -1074,6 +1113,7 @@ class PluginVideoEncoder : public PluginVideoCodec<NAME>
       , m_maxRTPSize(PluginCodec_RTP_MaxPacketSize)
       , m_tsto(31)
       , m_keyFramePeriod(0) // Indicates auto/default
+      , m_threads(0) // Indicates auto/default
     {
     }
 
@@ -1101,6 +1141,9 @@ class PluginVideoEncoder : public PluginVideoCodec<NAME>
       if (strcasecmp(optionName, PLUGINCODEC_OPTION_TX_KEY_FRAME_PERIOD) == 0)
         return this->SetOptionUnsigned(this->m_keyFramePeriod, optionValue, 0);
 
+      if (strcasecmp(optionName, PLUGINCODEC_OPTION_ENCODER_THREADS) == 0)
+        return this->SetOptionUnsigned(this->m_threads, optionValue, 0, 64);
+
       // Base class sets bit rate and frame time
       return BaseClass::SetOption(optionName, optionValue);
     }
@@ -1136,11 +1179,13 @@ class PluginVideoDecoder : public PluginVideoCodec<NAME>
 
   protected:
     size_t m_outputSize;
+    unsigned m_threads;
 
   public:
     PluginVideoDecoder(const PluginCodec_Definition * defn)
       : BaseClass(defn)
       , m_outputSize(BaseClass::DefaultWidth*BaseClass::DefaultHeight*3/2 + sizeof(PluginCodec_Video_FrameHeader) + PluginCodec_RTP_MinHeaderSize)
+      , m_threads(0) // Indicates auto/default
     {
     }
 
@@ -1153,6 +1198,9 @@ class PluginVideoDecoder : public PluginVideoCodec<NAME>
       if (strcasecmp(optionName, PLUGINCODEC_OPTION_MAX_RX_FRAME_HEIGHT) == 0)
         return this->SetOptionUnsigned(this->m_height, optionValue, 16, this->m_maxHeight);
 
+      if (strcasecmp(optionName, PLUGINCODEC_OPTION_DECODER_THREADS) == 0)
+        return this->SetOptionUnsigned(this->m_threads, optionValue, 0, 64);
+
       // Base class sets bit rate and frame time
       return BaseClass::SetOption(optionName, optionValue);
     }
@@ -233,6 +233,8 @@ class OpalPluginTranscoder
     OpalPluginControl freeOptionsControl;
     OpalPluginControl getOutputDataSizeControl;
     OpalPluginControl getCodecStatistics;
+    OpalPluginControl getInputBufferControl;
+    OpalPluginControl encodeAccessUnitControl;
 #if PTRACING
     bool m_firstLoggedUpdateOptions[2];
 #endif
@@ -325,13 +327,18 @@ class OpalPluginVideoTranscoder : public OpalVideoTranscoder, public OpalPluginT
     PBoolean ConvertFrames(const RTP_DataFrame & src, RTP_DataFrameList & dstList);
     bool UpdateMediaFormats(const OpalMediaFormat & input, const OpalMediaFormat & output);
     PBoolean ExecuteCommand(const OpalMediaCommand & command);
+    virtual BYTE * GetInputBuffer(PINDEX size);
 
   protected:
     bool EncodeFrames(const RTP_DataFrame & src, RTP_DataFrameList & dstList);
     bool DecodeFrames(const RTP_DataFrame & src, RTP_DataFrameList & dstList);
     bool DecodeFrame(const RTP_DataFrame & src, RTP_DataFrameList & dstList);
+    int EncodeAccessUnit(const RTP_DataFrame & src, RTP_DataFrameList & dstList, bool forceIFrame);
+    RTP_DataFrame * GetEncodedFrame(PINDEX bufferSize);
 
     RTP_DataFrame * m_bufferRTP;
+    RTP_DataFrameList m_encodedFramePool;
+    OpalVideoFormat::PacketiserPtr m_packetiser;
     DWORD           m_lastDecodedTimestamp; // For missing marker bit detection
     DWORD           m_lastMarkerTimestamp;  // For continuous marker bit detection
     unsigned        m_consecutiveMarkers;
@@ -47,7 +47,8 @@ class OpalSilenceDetector : public PObject
     P_DECLARE_STREAMABLE_ENUM(Modes,
       NoSilenceDetection,
       FixedSilenceDetection,
-      AdaptiveSilenceDetection
+      AdaptiveSilenceDetection,
+      SpectralSilenceDetection
     );
     typedef Modes Mode; // Backward compatibility
 
@@ -57,13 +58,15 @@ class OpalSilenceDetector : public PObject
         unsigned threshold = 0,               ///<  Threshold value if FixedSilenceDetection
         unsigned signalDeadband = 10,         ///<  10 milliseconds of signal needed
         unsigned silenceDeadband = 400,       ///<  400 milliseconds of silence needed
-        unsigned adaptivePeriod = 600         ///<  600 millisecond window for adaptive threshold
+        unsigned adaptivePeriod = 600,        ///<  600 millisecond window for adaptive threshold
+        bool comfortNoise = false             ///<  Play comfort noise instead of silence
       )
         : m_mode(mode),
           m_threshold(threshold),
           m_signalDeadband(signalDeadband),
           m_silenceDeadband(silenceDeadband),
-          m_adaptivePeriod(adaptivePeriod)
+          m_adaptivePeriod(adaptivePeriod),
+          m_comfortNoise(comfortNoise)
         { }
 
       PString AsString() const;
@@ -74,6 +77,7 @@ class OpalSilenceDetector : public PObject
       unsigned m_signalDeadband;   /// milliseconds of signal needed
       unsigned m_silenceDeadband;  /// milliseconds of silence needed
       unsigned m_adaptivePeriod;   /// millisecond window for adaptive threshold
+      bool     m_comfortNoise;     /// Play comfort noise instead of silence in gaps
     };
 
   /**@name Construction */
@@ -162,6 +166,18 @@ class OpalSilenceDetector : public PObject
       PINDEX size           ///<  Size of payload buffer
     ) = 0;
 
+    /**Determine if there is voice in the last data frame, for the
+       SpectralSilenceDetection mode. This is called from within the silence
+       detection algorithm, after GetAverageSignalLevel() for the same frame.
+
+       The default behaviour compares the signal level to the adaptive
+       threshold, the same as AdaptiveSilenceDetection.
+      */
+    virtual bool HasSpectralSignal(
+      const BYTE * buffer,  ///<  RTP payload being detected
+      PINDEX size           ///<  Size of payload buffer
+    );
+
   private:
     /**Reset the adaptive filter
      */
@@ -186,6 +202,7 @@ class OpalSilenceDetector : public PObject
     unsigned m_signalReceivedTime;    // Duration of signal received
     unsigned m_silenceReceivedTime;   // Duration of silence received
     unsigned m_lastSignalLevel;       // Energy level from last data frame
+    bool     m_comfortNoise;          // Comfort noise is to be played in gaps
     Result   m_lastResult;            // What it says
     PMutex   m_inUse;                 // Protects values to allow change while running
 };
@@ -199,7 +216,7 @@ class OpalPCM16SilenceDetector : public OpalSilenceDetector
       */
     OpalPCM16SilenceDetector(
       const Params & newParam ///<  New parameters for silence detector
-    ) : OpalSilenceDetector(newParam) { }
+    );
 
   /**@name Overrides from OpalSilenceDetector */
   //@{
@@ -215,7 +232,78 @@ class OpalPCM16SilenceDetector : public OpalSilenceDetector
       const BYTE * buffer,  ///<  RTP payload being detected
       PINDEX size           ///<  Size of payload buffer
     );
+
+    /**Determine if there is voice in the last data frame.
+       The frame is passed through a bank of band pass filters covering the
+       speech band. The noise floor of each band is tracked, and voice is
+       present when the average signal to noise ratio across the bands is
+       high enough. Unlike the level based modes, this is not fooled by
+       loud but steady background noise.
+      */
+    virtual bool HasSpectralSignal(
+      const BYTE * buffer,  ///<  RTP payload being detected
+      PINDEX size           ///<  Size of payload buffer
+    );
   //@}
+
+    /**Get the sum of the absolute values of PCM-16 samples.
+       This is the basic energy measure for all PCM-16 level metering, it
+       uses the fastest vector instructions available on the CPU.
+      */
+    static PUInt64 GetSignalSum(
+      const short * pcm,    ///<  PCM-16 samples
+      PINDEX samples        ///<  Number of samples
+    );
+
+  protected:
+    enum { MaxSpectralBands = 12 };
+    struct SpectralBand {
+      float m_b0, m_a1, m_a2;   // Band pass biquad, b1 is zero and b2 is -b0
+      float m_z1, m_z2;         // Filter state, carried between frames
+      float m_noise;            // Noise floor energy
+    };
+    SpectralBand m_bands[MaxSpectralBands];
+    PINDEX       m_bandCount;
+    unsigned     m_spectralClockRate;
+    unsigned     m_spectralFrames;
+};
+
+
+/**Generate comfort noise for gaps in PCM-16 audio.
+   The level and spectral tilt of the background noise is learned from the
+   audio passed to Analyse(), then Generate() produces noise to match. This
+   is used to fill gaps when the remote stops sending during silence, rather
+   than playing dead air.
+  */
+class OpalPCM16ComfortNoise
+{
+  public:
+    OpalPCM16ComfortNoise();
+
+    /**Update the background noise estimate from received audio.
+      */
+    void Analyse(
+      const short * pcm,    ///<  PCM-16 samples
+      PINDEX samples        ///<  Number of samples
+    );
+
+    /**Generate comfort noise matching the background noise.
+      */
+    void Generate(
+      short * pcm,          ///<  PCM-16 samples to fill
+      PINDEX samples        ///<  Number of samples
+    );
+
+    /**Get the average absolute sample value of the background noise.
+      */
+    float GetNoiseLevel() const { return m_level; }
+
+  protected:
+    float   m_level;      // Average absolute sample of the background noise
+    float   m_tilt;       // First order spectral tilt, lag 1 correlation
+    float   m_state;      // Shaping filter state
+    PUInt32 m_seed;       // Noise generator state
+    bool    m_learnt;     // Have seen at least one frame
 };
 
 
@@ -0,0 +1,134 @@
+/*
+ * tonedetect.h
+ *
+ * Open Phone Abstraction Library (OPAL)
+ *
+ * Copyright (c) 2017 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#ifndef OPAL_CODEC_TONEDETECT_H
+#define OPAL_CODEC_TONEDETECT_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include <opal_config.h>
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/**Detect in-band tones in 8kHz PCM-16 audio.
+   A single bank of Goertzel filters covers DTMF, fax CNG/CED and the North
+   American ringback and busy tones, so all are detected in one pass over
+   the audio. Frames below a minimum energy skip the filter bank entirely.
+  */
+class OpalToneDetector : public PObject
+{
+    PCLASSINFO(OpalToneDetector, PObject);
+  public:
+    enum CallProgress {
+      NoCallProgress,
+      RingBackTone,   ///< 440Hz + 480Hz
+      BusyTone        ///< 480Hz + 620Hz
+    };
+
+    enum {
+      BlockSize = 205,      ///< Samples per analysis block, 25.6ms
+      NumFrequencies = 13,  ///< Frequencies detected
+      FilterBankSize = 16   ///< Filters in the bank, padded to a multiple of the vector size
+    };
+
+    /**Create a new detector.
+      */
+    OpalToneDetector();
+
+    /**Detect tones in the audio.
+       Returns the DTMF digits, 'X' for fax CNG and 'Y' for fax CED, as each
+       is confirmed. This is the same form as PDTMFDecoder::Decode().
+      */
+    PString Detect(
+      const short * pcm,      ///<  PCM-16 samples at 8kHz
+      PINDEX samples,         ///<  Number of samples
+      unsigned mult = 1,      ///<  Multiplier applied to samples
+      unsigned div = 1        ///<  Divisor applied to samples
+    );
+
+    /**A block of audio for one channel, for the multi-channel Detect().
+      */
+    struct Channel {
+      Channel() : m_detector(NULL), m_pcm(NULL), m_samples(0) { }
+
+      OpalToneDetector * m_detector;  ///<  Detector holding the channel's state
+      const short      * m_pcm;       ///<  PCM-16 samples at 8kHz
+      PINDEX             m_samples;   ///<  Number of samples
+      PString            m_tones;     ///<  Tones detected, as for the single channel Detect()
+    };
+
+    /**Detect tones in the audio of many channels in one call.
+       This allows a single worker thread to service the tone detection of a
+       large number of channels, rather than a filter on every patch thread.
+       Each channel is processed exactly as by the single channel Detect().
+      */
+    static void Detect(
+      Channel * channels,     ///<  Channels to process
+      PINDEX count,           ///<  Number of channels
+      unsigned mult = 1,      ///<  Multiplier applied to samples
+      unsigned div = 1        ///<  Divisor applied to samples
+    );
+
+    /**Get the current call progress tone.
+       This returns to NoCallProgress when no call progress tone has been
+       present for longer than the silent part of the ringback cadence.
+      */
+    CallProgress GetCallProgress() const { return m_callProgress; }
+
+    /**Reset the detector.
+      */
+    void Reset();
+
+  protected:
+    void ResetBlock();
+    void ResetTones();
+    void AnalyseBlock(PString & tones);
+    void NoCallProgressFor(PINDEX samples);
+
+    float        m_s1[FilterBankSize];
+    float        m_s2[FilterBankSize];
+    float        m_blockEnergy;
+    PINDEX       m_blockSamples;
+
+    char         m_lastDigit;
+    unsigned     m_digitBlocks;
+    unsigned     m_cngBlocks;
+    unsigned     m_cedBlocks;
+    CallProgress m_callProgress;
+    CallProgress m_progressCandidate;
+    unsigned     m_progressBlocks;
+    PINDEX       m_progressAbsent;
+};
+
+
+extern ostream & operator<<(ostream & strm, OpalToneDetector::CallProgress progress);
+
+
+#endif // OPAL_CODEC_TONEDETECT_H
+
+
+/////////////////////////////////////////////////////////////////////////////
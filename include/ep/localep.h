@@ -889,12 +889,27 @@ class OpalLocalMediaStream : public OpalMediaStream, public OpalMediaStreamPacin
     virtual PBoolean IsSynchronous() const;
   //@}
 
+  /**@name Member variable access */
+  //@{
+    /**Get the endpoint specific context for the stream.
+       A descendant of OpalLocalEndPoint may keep its own state for the
+       stream here, rather than looking it up on every frame. The endpoint
+       is responsible for the lifetime of whatever it points to.
+      */
+    void * GetContext() const { return m_context; }
+
+    /**Set the endpoint specific context for the stream.
+      */
+    void SetContext(void * context) { m_context = context; }
+  //@}
+
   protected:
     virtual void InternalClose() { }
 
     OpalLocalConnection            & m_connection;
     OpalLocalEndPoint::Synchronicity m_synchronicity;
     PBYTEArray                       m_silence;
+    void                           * m_context;
 };
 
 
@@ -65,6 +65,7 @@ class H245_TerminalCapabilitySet;
 class H245_NonStandardParameter;
 class H323Connection;
 class H323Capabilities;
+class H323SharedCapabilities;
 class H245_CapabilityIdentifier;
 class H245_GenericCapability;
 class H245_GenericParameter;
@@ -329,8 +330,8 @@ class H323Capability : public PObject
     /// Get unique capability number.
     unsigned GetCapabilityNumber() const { return assignedCapabilityNumber; }
 
-    /// Set unique capability number.
-    void SetCapabilityNumber(unsigned num) { assignedCapabilityNumber = num; }
+    /// Set unique capability number, the table it is in is reindexed.
+    void SetCapabilityNumber(unsigned num);
 
     /**Get media format of the media data this class represents.
       */
@@ -392,6 +393,8 @@ class H323Capability : public PObject
 
     mutable OpalMediaFormat m_mediaFormat;
 
+    H323SharedCapabilities * m_owner; // Table this capability is in, if any
+
 #if OPAL_H235_6 || OPAL_H235_8
     H235SecurityCapability * m_cryptoCapability;
 #endif
@@ -400,6 +403,7 @@ class H323Capability : public PObject
     P_REMOVE_VIRTUAL(PBoolean, IsMatch(const PASN_Choice &) const, false);
 
   friend class H323Capabilities;
+  friend class H323SharedCapabilities;
 };
 
 
@@ -2503,7 +2507,46 @@ class H323CapabilitiesSet : public H323CapabilitiesSetArray
 };
 
 
+/**The contents of a H323Capabilities, shared by copies of the table until
+   one of them is changed, internal use only.
+  */
+class H323SharedCapabilities
+{
+  public:
+    H323SharedCapabilities();
+    H323SharedCapabilities(const H323SharedCapabilities & other);
+
+    void Append(H323Capability * capability);
+    void RemoveFromIndex(H323Capability * capability);
+    void Renumber(H323Capability & capability, unsigned capabilityNumber);
+    void RebuildIndex();
+
+    atomic<unsigned>     m_references;
+    H323CapabilitiesList m_table;
+    H323CapabilitiesSet  m_set;
+    PStringSet           m_mediaPacketizations;
+
+    // Indexes of m_table, these are kept in table order so the first entry
+    // wins as for a linear search, which means rebuilding after a reorder
+    typedef std::map<unsigned, H323Capability *> NumberIndex;
+    NumberIndex          m_numberIndex;
+    typedef std::multimap<PCaselessString, H323Capability *> NameIndex;
+    NameIndex            m_nameIndex;
+
+  protected:
+    void RemoveFromNumberIndex(H323Capability * capability);
+
+  private:
+    void operator=(const H323SharedCapabilities &) { }
+};
+
+
 /**This class contains all of the capabilities and their combinations.
+
+   Copies of a table share the capabilities until one of them is changed,
+   so a connection may take a copy of a table cheaply. Functions that may
+   change the table, including the non-const FindCapability() and
+   operator[], first make the table unique to this instance.
   */
 class H323Capabilities : public PObject
 {
@@ -2523,20 +2566,24 @@ class H323Capabilities : public PObject
     );
 
     /**Construct a copy of a capability set.
-       Note this will completely duplicate the set by making clones of every
-       capability in the original set.
+       Note the capabilities are shared with the original until either is
+       changed, they are then cloned.
       */
     H323Capabilities(
       const H323Capabilities & original ///<  Original capabilities to duplicate
     );
 
     /**Assign a copy of a capability set.
-       Note this will completely duplicate the set by making clones of every
-       capability in the original set.
+       Note the capabilities are shared with the original until either is
+       changed, they are then cloned.
       */
     H323Capabilities & operator=(
       const H323Capabilities & original ///<  Original capabilities to duplicate
     );
+
+    /**Destroy the capability set, deleting the capabilities if not shared.
+      */
+    ~H323Capabilities();
   //@}
 
   /**@name Overrides from class PObject */
@@ -2552,11 +2599,14 @@ class H323Capabilities : public PObject
   //@{
     /**Get the number of capabilities in the set.
       */
-    PINDEX GetSize() const { return m_table.GetSize(); }
+    PINDEX GetSize() const { return m_body->m_table.GetSize(); }
 
     /**Get the capability at the specified index.
+       The const version may return a capability shared with copies of the
+       table, so it must not be modified.
       */
-    H323Capability & operator[](PINDEX i) const { return m_table[i]; }
+    H323Capability & operator[](PINDEX i) const { return m_body->m_table[i]; }
+    H323Capability & operator[](PINDEX i) { MakeUnique(); return m_body->m_table[i]; }
 
     /**Set the capability descriptor lists. This is three tier set of
        codecs. The top most level is a list of particular capabilities. Each
@@ -2757,6 +2807,24 @@ class H323Capabilities : public PObject
       unsigned subType = UINT_MAX         ///<  Sub-type to find (UINT_MAX=ignore)
     ) const;
 
+    /**Find a capability as for the const functions above. As the capability
+       returned may be modified, the table is first made unique so no copy
+       sharing it is affected. The const functions may return a capability
+       shared with copies of the table, so it must not be modified.
+      */
+    H323Capability * FindCapability(unsigned capabilityNumber);
+    H323Capability * FindCapability(
+      const PString & formatName,
+      H323Capability::CapabilityDirection direction = H323Capability::e_Unknown,
+      PBoolean exact = false
+    );
+    H323Capability * FindCapability(H323Capability::CapabilityDirection direction);
+    H323Capability * FindCapability(const H323Capability & capability);
+    H323Capability * FindCapability(const H245_Capability & cap);
+    H323Capability * FindCapability(const H245_DataType & dataType, const PString & mediaPacketization = PString::Empty());
+    H323Capability * FindCapability(const H245_ModeElement & modeElement, const PString & mediaPacketization = PString::Empty());
+    H323Capability * FindCapability(H323Capability::MainTypes mainType, unsigned subType = UINT_MAX);
+
     /**Build a H.245 PDU from the information in the capability set.
       */
     void BuildPDU(
@@ -2810,15 +2878,30 @@ class H323Capabilities : public PObject
       */
     OpalMediaFormatList GetMediaFormats() const;
 
-    const PStringSet & GetMediaPacketizations() const { return m_mediaPacketizations; }
+    /**Determine if the tables have identical capabilities, capability
+       numbers and simultaneous sets, so one may be shared in place of the
+       other.
+      */
+    bool IsIdentical(
+      const H323Capabilities & other
+    ) const;
 
-    const H323CapabilitiesSet & GetSet() const { return m_set; }
+    const PStringSet & GetMediaPacketizations() const { return m_body->m_mediaPacketizations; }
+
+    const H323CapabilitiesSet & GetSet() const { return m_body->m_set; }
   //@}
 
   protected:
-    H323CapabilitiesList m_table;
-    H323CapabilitiesSet  m_set;
-    PStringSet           m_mediaPacketizations;
+    void MakeUnique();
+    H323Capability * MakeUnique(H323Capability * capability);
+    void ReleaseBody();
+    const H323Capabilities & GetConstThis() const { return *this; }
+    H323Capability * FindMatchingCapability(
+      const H245_Capability & cap,
+      const PStringSet & mediaPacketizations
+    ) const;
+
+    H323SharedCapabilities * m_body;
 };
 
 
@@ -1038,6 +1038,15 @@ class H323EndPoint : public OpalRTPEndPoint
      */
     const H323Capabilities & GetCapabilities() const { return m_capabilities; }
 
+    /**Share a connection's local capability table with an identical one
+       built for an earlier connection, so calls with the same capabilities
+       keep a single copy. The connection gets its own copy again when it
+       changes the table.
+     */
+    virtual void ShareLocalCapabilities(
+      H323Capabilities & capabilities   ///< Table built by the connection
+    );
+
     /**Endpoint types.
      */
     enum TerminalTypes {
@@ -1460,6 +1469,8 @@ class H323EndPoint : public OpalRTPEndPoint
     PMutex                     m_reusableTransportMutex;
 
     H323Capabilities m_capabilities;
+    std::list<H323Capabilities> m_sharedLocalCapabilities; // Most recently used first
+    PMutex                      m_sharedLocalCapabilitiesMutex;
 
     typedef PDictionary<PString, H323Gatekeeper> GatekeeperByAlias;
 
@@ -64,6 +64,7 @@ class IAX2CallProcessor;
 class IAX2IeList;
 class IAX2MiniFrame;
 class IAX2Transmitter;
+class IAX2FrameList;
 
 
 
@@ -209,6 +210,26 @@ class IAX2Frame :  public PObject
   /**Get the offset to the beginning of the encrypted region */
   virtual PINDEX GetEncryptionOffset();
 
+  /**Values used in meta trunk frames, which carry the voice mini frames of
+     many calls to the same remote in one UDP packet */
+  enum MetaTrunkValues {
+    MetaTrunkCommand     = 1,   /*!< Meta command byte for a trunk frame                 */
+    MetaTrunkTimeStamps  = 1,   /*!< Command data flag, every entry has a time stamp     */
+    MetaTrunkHeaderSize  = 8,   /*!< Zeros, command, command data and 32 bit time stamp  */
+    MetaTrunkEntrySize   = 6    /*!< Length, call number and time stamp of each entry    */
+  };
+
+  /**True if this is a meta trunk frame, read from the network */
+  PBoolean IsTrunkFrame() const { return isTrunkFrame; }
+
+  /**Split a meta trunk frame, as read from the network, into a mini frame
+     for each entry. The new frames have been through ProcessNetworkPacket()
+     and are added to the supplied list. This frame is not deleted.
+
+     @return false if the trunk frame is malformed. Any entries before the
+     bad one are still added to the list. */
+  PBoolean SplitTrunkFrame(IAX2FrameList & frames);
+
  protected:
 
   /**Use the supplied encryptionKey, and data in storage, to decrypt this frame.
@@ -274,6 +295,9 @@ class IAX2Frame :  public PObject
   
   /**Flag to indicate if this is a MiniFrame with audio */
   PBoolean               isAudio;
+
+  /**Flag to indicate if this is a meta trunk frame */
+  PBoolean               isTrunkFrame;
   
   /**Index of where we are reading from the internal data area */
   PINDEX               currentReadIndex;  
@@ -354,9 +378,20 @@ class IAX2MiniFrame : public IAX2Frame
   /**Get the offset to the beginning of the encrypted region */
   virtual PINDEX GetEncryptionOffset();
 
+  /**Mark this frame as one that the transmitter should put into a meta
+     trunk frame, rather than sending on its own. Only unencrypted audio
+     frames to a peer with trunking enabled are marked. */
+  void SetTrunked(PBoolean newValue) { isTrunked = newValue; }
+
+  /**True if the transmitter should send this frame in a meta trunk frame */
+  PBoolean IsTrunked() const { return isTrunked; }
+
  protected:
   /**Initialise valus in this class to some preset value */
   void ZeroAllValues();
+
+  /**Flag to indicate this frame goes in a meta trunk frame */
+  PBoolean isTrunked;
 };
 
 /////////////////////////////////////////////////////////////////////////////    
@@ -127,6 +127,12 @@ class IAX2Connection : public OpalConnection
   */
   virtual void OnReleased();
 
+  /**Execute garbage collection for the connection.
+     The connection is not deleted until the final pass of the processor,
+     started by OnReleased(), is complete, as that pass uses the connection.
+  */
+  virtual bool GarbageCollection();
+
   /**Get the data formats this connection is capable of operating.
      This provides a list of media data format names that a
      OpalMediaStream may be created in within this connection.
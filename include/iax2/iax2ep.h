@@ -94,6 +94,89 @@ public:
 };
 
 
+/** A table to find the connection an incoming frame belongs to, without
+    building and comparing connection token strings. Every call has an
+    entry indexed by our (local) call number, which finds full frames that
+    carry it as the destination call number. Once a frame from the remote
+    has been seen, the entry is also indexed by the remote address, port
+    and remote call number, which finds mini frames, and full frames that
+    do not carry our call number.
+
+    Both indexes are hash tables whose buckets are spread across a set of
+    mutexes, so that lookups for different calls do not contend. Adding and
+    removing entries are rare, and are serialised by a separate mutex. */
+class IAX2CallTable : public PObject
+{
+  PCLASSINFO(IAX2CallTable, PObject);
+ public:
+  /**Construct an empty table */
+  IAX2CallTable();
+
+  /**Destroy the table, and any entries still in it */
+  ~IAX2CallTable();
+
+  /**Add a call, indexed by our call number.
+
+     @return false if the call number is already in use by another call */
+  PBoolean AddCall(
+    PINDEX localCallNumber,           ///< Source call number of our processor
+    IAX2Connection * connection       ///< Connection handling the call
+  );
+
+  /**Index an existing call by the remote details. This is a no-op if the
+     call is not in the table, or its remote details are already known. */
+  void AddRemote(
+    PINDEX localCallNumber,           ///< Source call number of our processor
+    IAX2Remote & remote               ///< Remote info of a frame received from the remote
+  );
+
+  /**Remove a call from both indexes, if it belongs to the connection */
+  void RemoveCall(
+    PINDEX localCallNumber,           ///< Source call number of our processor
+    IAX2Connection * connection       ///< Connection handling the call
+  );
+
+  /**Find the connection an incoming frame belongs to. If the frame carries
+     our call number, the remote details are indexed as well. */
+  PSafePtr<IAX2Connection> FindCall(IAX2Frame & frame);
+
+  /**Report if there is a call with our call number */
+  PBoolean IsCallActive(PINDEX localCallNumber);
+
+  /**Report the number of calls in the table */
+  PINDEX GetSize() const { return m_size; }
+
+ protected:
+  enum {
+    NumBuckets = 4096,  ///< Buckets in each index, a power of two
+    NumStripes = 64     ///< Mutexes shared by the buckets
+  };
+
+  struct Entry {
+    PSafePtr<IAX2Connection> m_connection;
+    PINDEX                   m_localCallNumber;
+    PIPSocket::Address       m_remoteAddress;
+    PINDEX                   m_remotePort;
+    PINDEX                   m_remoteCallNumber;
+    bool                     m_remoteKnown;
+    Entry                  * m_nextLocal;
+    Entry                  * m_nextRemote;
+  };
+
+  static unsigned HashLocal(PINDEX localCallNumber);
+  static unsigned HashRemote(const PIPSocket::Address & address, PINDEX port, PINDEX remoteCallNumber);
+  PCriticalSection & GetStripe(unsigned bucket) { return m_stripes[bucket % NumStripes]; }
+
+  Entry * FindLocal(PINDEX localCallNumber);
+
+  Entry          * m_localBuckets[NumBuckets];
+  Entry          * m_remoteBuckets[NumBuckets];
+  PCriticalSection m_stripes[NumStripes];
+  PMutex           m_writeMutex;
+  PINDEX           m_size;
+};
+
+
 
 
 /** A class to manage global variables. There is one Endpoint per application. */
@@ -230,6 +313,24 @@ class IAX2EndPoint : public OpalEndPoint
   /**Set the password to some value */
   void SetPassword(PString newValue);
 
+  /**Enable or disable trunking of voice frames to the specified remote
+     host. When enabled, the audio mini frames of every unencrypted call to
+     that host are collected by the transmitter and sent together in one
+     meta trunk frame every trunk period. IAX2 has no way of negotiating
+     this, so it should only be enabled for peers known to accept trunk
+     frames. Incoming trunk frames are always accepted. */
+  void SetTrunking(const PIPSocket::Address & remote, bool enable);
+
+  /**Report if voice frames to the specified remote host are trunked */
+  bool IsTrunking(const PIPSocket::Address & remote);
+
+  /**Set the interval at which trunk frames are sent. A longer period packs
+     more frames into each UDP packet, at the cost of added latency. */
+  void SetTrunkPeriod(const PTimeInterval & period) { m_trunkPeriod = period; }
+
+  /**Get the interval at which trunk frames are sent */
+  const PTimeInterval & GetTrunkPeriod() const { return m_trunkPeriod; }
+
   /**It is possible that a retransmitted frame has been in the transmit queue,
      and while sitting there that frames sending connection has died.  Thus,
      prior to transmission, call tis method.
@@ -401,6 +502,20 @@ class IAX2EndPoint : public OpalEndPoint
      processed */
   PBoolean EthernetFramesToBeProcessed() 
   { return m_packetsReadFromEthernet.GetSize() > 0; }
+
+  /**Get the thread pool that runs the call, registration and special
+     packet processors */
+  IAX2ThreadPool & GetThreadPool() { return m_threadPool; }
+
+  /**Set the maximum number of threads in the processor thread pool. The
+     default is 15. */
+  void SetProcessorThreads(unsigned count) { m_threadPool.SetMaxWorkers(std::max(count, 1U)); }
+
+  /**Get the maximum number of threads in the processor thread pool */
+  unsigned GetProcessorThreads() const { return m_threadPool.GetMaxWorkers(); }
+
+  /**Get the table used to find the connection for an incoming frame */
+  IAX2CallTable & GetCallTable() { return m_callTable; }
   //@}
   
  protected:
@@ -442,56 +557,35 @@ class IAX2EndPoint : public OpalEndPoint
   
   /**Mutex for the statusQueryCounter */
   PMutex m_statusQueryMutex;
+
+  /**Remote hosts that voice frames are trunked to */
+  PStringSet m_trunkPeers;
+
+  /**Mutex for the trunkPeers set */
+  PMutex m_trunkPeersMutex;
+
+  /**Interval at which trunk frames are sent */
+  PTimeInterval m_trunkPeriod;
   
   /**Pointer to the Processor class which handles special packets (eg lagrq) that have no 
      destination call to handle them. */
   IAX2SpecialProcessor * specialPacketHandler;
     
-  /**For the supplied IAX2Frame, pass it to a connection in the
-     connectionsActive structure.  If no matching connection is found, return
-     false;
+  /**For the supplied IAX2Frame, find the connection in the call table.
+     If no matching connection is found, return false;
      
      If a matching connections is found, give the frame to the
      connection (for the connection to process) and return true;
   */
-  PBoolean ProcessInMatchingConnection(IAX2Frame *f);  
-
-  /**For the supplied IAX2Frame, pass it to a connection in the
-     connectionsActive structure.  We are told the token of the connection
-     that matches this particular frame. 
-     
-
-     @return true - this is the normal and expected outcome. 
-     @return false - connection not found - say it died immediately
-     before this method was called */
-    PBoolean ProcessFrameInConnection(IAX2Frame *f, const PString & token);  
+  PBoolean ProcessInMatchingConnection(IAX2Frame *f);    
     
-  /**Take the supplied frame, and compare it with all the existing
-     connections.  If any of the existing connections has a matching
-     dest call number, then put this frame to that connection.  
+  /**Find calls by call numbers and remote address. This replaces looking
+     up connection tokens, which for calls we initiate is not known until
+     the first frame from the remote arrives. */
+  IAX2CallTable m_callTable;
 
-     Update the token translation dictionary if the supplied frame has
-     a valid connection token. */
-  PBoolean ProcessInConnectionTestAll(IAX2Frame *f);
-  
-  /**tokenTable is a hack to allow IAX2 to fit in with one of the
-     demands of the opal library. 
-     
-     Opal demands that at connection setup, we know the unique ID which 
-     this call will use. 
-
-     Since the unique ID is remote ip adress + remote's Source Call
-     number, this is unknown if we are initiating the
-     call. Consequently, this table is needed, as it provides a
-     translation between the initial (or psuedo) token and the
-     token that is later adopted */
-
-  PStringToString  m_tokenTable;
-  
-  /**Threading mutex on the variable tokenTable. We can now safely
-     read/write to this table, with the minimum of interference between
-     threads.  */
-  PReadWriteMutex  m_mutexTokenTable;
+  /**Thread pool that runs all the processors */
+  IAX2ThreadPool m_threadPool;
 
   /**Thread safe counter which keeps track of the calls created by this endpoint.
      This value is used when giving outgoing calls a unique ID */
@@ -37,6 +37,7 @@
 #if OPAL_IAX2
 
 #include <opal/connection.h>
+#include <ptclib/threadpool.h>
 
 #include <iax2/frame.h>
 #include <iax2/iedata.h>
@@ -47,6 +48,40 @@
 class IAX2EndPoint;
 class IAX2Connection;
 class IAX2ThreadHelper;
+class IAX2Processor;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/**Work item, queued on the endpoint thread pool, that processes all the
+   pending lists of one processor. Only one of these is ever queued for a
+   given processor, so the processing of each call is serialised without a
+   thread per call. */
+class IAX2ProcessorWork
+{
+ public:
+  /**Construct work for the specified processor */
+  IAX2ProcessorWork(IAX2Processor & processor) : m_processor(processor) { }
+
+  /**Called by the thread pool to do the work */
+  void Work();
+
+ protected:
+  IAX2Processor & m_processor;
+};
+
+
+/**The thread pool that runs all the processors of an endpoint */
+class IAX2ThreadPool : public PQueuedThreadPool<IAX2ProcessorWork>
+{
+  typedef PQueuedThreadPool<IAX2ProcessorWork> BaseClass;
+  PCLASSINFO(IAX2ThreadPool, BaseClass);
+ public:
+  IAX2ThreadPool(unsigned maxWorkers, const char * threadName)
+    : BaseClass(maxWorkers, 0, threadName, PThread::HighPriority)
+  {
+  }
+};
+
 
 ////////////////////////////////////////////////////////////////////////////////
 /**This class defines what the processor is to do on receiving an ack
@@ -126,10 +161,12 @@ class IAX2WaitingForAck : public PObject
     frames) are used to determine which processor will handle which incoming
     packet.
  
-    Each processor runs in its own thread so as to process incoming packets in
-    a timely fashion.
+    Processors do not have their own thread. When there is work to do, the
+    processor is queued on the thread pool of the endpoint, which calls
+    ProcessLists() on one of its workers. At most one worker runs a given
+    processor at any time.
  */
-class IAX2Processor : public PThread
+class IAX2Processor : public PObject
 {
   PCLASSINFO(IAX2Processor, PObject);
   
@@ -176,10 +213,11 @@ class IAX2Processor : public PThread
   /**Get the call start tick */
   const PTimeInterval & GetCallStartTick() { return callStartTick; }
   
-  /**The worker method of this thread. In here, all incoming frames (for this call)
-     are handled.
+  /**Called from the thread pool, via IAX2ProcessorWork, to handle all the
+     incoming frames (for this call) and any other pending work. Keeps going
+     until there is nothing left to do.
   */
-  void Main();
+  void ProcessPendingWork();
   
   /**Test to see if it is a status query type IAX2 frame (eg lagrq) and handle it. If the frame
      is a status query, and it is handled, return true */
@@ -189,13 +227,21 @@ class IAX2Processor : public PThread
      packets which are not sent to any particular call) */
   void SetSpecialPackets(PBoolean newValue) { specialPackets = newValue; }
   
-  /**Cause this thread to die immediately */
+  /**Stop processing. Pending work is processed one last time, after which
+     this processor is never run again. */
   void Terminate();
+
+  /**Wait for the final processing after Terminate() to be complete.
+
+     @return true if the processor has terminated */
+  PBoolean WaitForTermination(const PTimeInterval & maxWait = PMaxTimeInterval);
+
+  /**Report if the final processing after Terminate() has completed */
+  PBoolean IsTerminated() const { return terminated; }
   
-  /**Cause this thread to come to life, and process events that are
-   * pending at IAX2Connection. This method does not start this
-   * thread. This method causes this thread to be joggled back into
-   * life, after waiting on a PSyncPoint. */
+  /**Process events that are pending at IAX2Connection. This queues the
+   * processor on the endpoint thread pool, unless it is already queued
+   * or running, in which case the running worker goes round again. */
   void Activate();
 
   /**Test the sequence number of the incoming frame. This is only
@@ -232,18 +278,30 @@ class IAX2Processor : public PThread
   /** The timer which is used to test for no reply to our outgoing call setup messages */
   PTimer noResponseTimer;
   
-  /**Activate this thread to process all the lists of queued frames */
-  void CleanPendingLists() { activate.Signal(); }
+  /**Activate this processor to process all the lists of queued frames */
+  void CleanPendingLists() { Activate(); }
   
   /**Action to perform on receiving an ACK packet (which is required
      during call setup phase for receiver */
   IAX2WaitingForAck nextTask;
   
-   /**Flag which is used to activate this thread, so all pending tasks/packets are processed */
-  PSyncPoint activate;
-  
-  /**Flag to indicate, end this thread */
+  /**Mutex for the scheduled, rerun and terminated flags */
+  PMutex activateMutex;
+
+  /**Flag to indicate a work item for this processor is queued or running */
+  PBoolean scheduled;
+
+  /**Flag to indicate Activate() was called while the work was running */
+  PBoolean rerun;
+
+  /**Flag to indicate, end processing */
   PBoolean endThread;
+
+  /**Flag to indicate the final processing after Terminate() is done */
+  PBoolean terminated;
+
+  /**Signalled when the terminated flag is set */
+  PSyncPoint terminatedSync;
   
   /**Status of encryption for this processor - by default, no encryption */
   IAX2Encryption encryption;
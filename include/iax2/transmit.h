@@ -47,6 +47,67 @@
 #pragma interface
 #endif
 
+/**Voice mini frames waiting to go to one remote host in a meta trunk
+   frame. Each mini frame becomes an entry of length, call number, time
+   stamp and media, after the trunk header. Only used by the IAX2Transmit
+   thread, so there is no locking. */
+class IAX2TrunkBuffer : public PObject
+{
+  PCLASSINFO(IAX2TrunkBuffer, PObject);
+ public:
+  /**Constructor, for a trunk to the specified address and port */
+  IAX2TrunkBuffer(const PIPSocket::Address & address, WORD port);
+
+  /**Add the media of this mini frame as a trunk entry. 
+
+     @return false if there is not enough room, and the buffer should be
+     sent first. */
+  PBoolean AddMiniFrame(IAX2MiniFrame & frame);
+
+  /**Send the buffered entries, as one trunk frame, then empty the buffer.
+     
+     @return false if the transmission failed */
+  PBoolean Transmit(PUDPSocket & sock);
+
+  /**Report if it is time to send this buffer */
+  PBoolean IsDue(const PTimeInterval & period) const;
+
+  /**Report if nothing has been added to this buffer for IdleTimeout
+     milliseconds, so no calls are using it */
+  PBoolean IsIdle() const;
+
+  /**Report the number of mini frames waiting in this buffer */
+  PINDEX GetEntries() const { return entries; }
+
+  /**Largest trunk frame we will send, which keeps it under a typical MTU */
+  enum { MaxTrunkFrameSize = 1400 };
+
+  /**Milliseconds without entries, before a trunk buffer is removed */
+  enum { IdleTimeout = 10000 };
+
+ protected:
+  /**Where the trunk frame goes */
+  PIPSocket::Address address;
+
+  /**Port the trunk frame goes to */
+  WORD port;
+
+  /**The trunk frame, header and entries */
+  PBYTEArray data;
+
+  /**Bytes of data used */
+  PINDEX size;
+
+  /**Number of entries in data */
+  PINDEX entries;
+
+  /**When this trunk was created, for the trunk time stamp */
+  PTimeInterval startTick;
+
+  /**When the first entry in data was added */
+  PTimeInterval firstEntryTick;
+};
+
 /**Manage the transmission of ethernet packets on the specified
    port.  All transmitted packets are received from any of the current
    connections.  A separate thread is used to wait on the request to
@@ -114,6 +175,16 @@ class IAX2Transmit : public PThread
   //@}
   
  protected:
+
+  /**Put this mini frame in the trunk buffer for its remote host, and
+     delete it. A full buffer is sent before the frame is added. */
+  void AddToTrunk(IAX2MiniFrame * frame);
+
+  /**Send the trunk buffers whose period has elapsed, or all of them if
+     force is true. Idle buffers are removed.
+
+     @return true if there are still entries waiting in a buffer */
+  PBoolean ProcessTrunks(PBoolean force);
   
   /**Go through the acking list:: delete those who have too many
      retries, and transmit those who need retransmitting */
@@ -142,6 +213,16 @@ class IAX2Transmit : public PThread
   
   /**Flag to indicate that this thread should keep working */
   PBoolean       keepGoing;
+
+  /**Buffers of voice frames waiting to be trunked, indexed by remote
+     address and port */
+  PDictionary<PString, IAX2TrunkBuffer> trunkBuffers;
+
+  /**Number of trunk frames sent */
+  PINDEX trunkFramesSent;
+
+  /**Number of mini frames that were sent in trunk frames */
+  PINDEX trunkedMiniFrames;
 };
 
 
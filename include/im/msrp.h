@@ -65,6 +65,17 @@ class MSRPProtocol : public PInternetProtocol
     };
 
     static const unsigned MaximumMessageLength = 1024;
+    static const unsigned MaximumHeaderSize = 4096;
+    static const unsigned MaximumChunkSize = 10240 + MaximumHeaderSize;
+    static const unsigned MaximumOutstandingChunks = 8;
+    static const unsigned SendWindowTimeout = 10000;
+    static const unsigned MaximumQueuedData = 1024*1024;
+
+    enum ParseResult {
+      ParseIncomplete,
+      ParseComplete,
+      ParseFailed
+    };
 
     class Message
     {
@@ -97,6 +108,20 @@ class MSRPProtocol : public PInternetProtocol
       PString & messageId
     );
 
+    //
+    //  Send a message read from a stream, a chunk at a time, so a large
+    //  transfer is never held in memory. If length is P_MAX_INDEX the total
+    //  is sent as unknown, and the message ends at the end of the stream.
+    //
+    bool SendSEND(
+      const PURL & from, 
+      const PURL & to,
+      istream & body,
+      PINDEX length,
+      const PString & contentType,
+      PString & messageId
+    );
+
     bool SendChunk(
       const PString & transactionId, 
       const PString toUrl,
@@ -116,16 +141,56 @@ class MSRPProtocol : public PInternetProtocol
                     const PString & fromUrl,
                   const PMIMEInfo & mime);
 
-    bool ReadMessage(
+    //
+    //  Append whatever data is available on the socket to the receive buffer
+    //
+    bool ReadAvailable();
+
+    //
+    //  Write as much of the send queue as the socket will take without
+    //  blocking, false if the connection failed
+    //
+    bool WriteQueued();
+
+    //
+    //  Indicate there is data waiting for the socket to be writable
+    //
+    bool HasQueuedData();
+
+    //
+    //  Extract the next complete message from the receive buffer, if any
+    //
+    ParseResult ParseMessage(
       int & command,
       PString & chunkId,
       PMIMEInfo & mime, 
       PString & body
     );
 
+    //
+    //  Called when a response to a SEND chunk is received, opens the send window
+    //
+    void OnChunkResponse();
+
+    virtual PBoolean Close();
+
     //typedef std::map<std::string, Message> MessageMap;
     //MessageMap m_messageMap;
     PMutex m_mutex;
+
+  protected:
+    bool WaitForSendWindow(const PMIMEInfo & mime);
+    bool QueueData(const PString & data);
+    bool InternalWriteQueued();
+
+    std::string            m_txBuffer;  // Protected by m_mutex
+    std::string            m_rxBuffer;
+    std::string::size_type m_rxOffset;
+    std::string::size_type m_rxScanned;
+
+    PMutex     m_windowMutex;
+    unsigned   m_outstandingChunks;
+    PSyncPoint m_windowAvailable;
 };
 
 ////////////////////////////////////////////////////////////////////////////
@@ -151,6 +216,8 @@ class OpalMSRPManager : public PObject
     //
     bool GetLocalPort(WORD & port);
 
+    struct IncomingMSRP;
+
     //
     // Information about a connection to another MSRP manager
     //
@@ -160,22 +227,55 @@ class OpalMSRPManager : public PObject
         ~Connection();
 
         //
-        //  Start handler thread for a connection
+        //  Add the connection to the set serviced by a manager handler thread
         //
         void StartHandler();
 
         //
-        //  Handler thread for a connection
+        //  Read and process whatever data is available, false if connection lost
+        //
+        bool OnReadable();
+
+        //
+        //  Handle a single message parsed from the connection
+        //
+        void OnReceivedMessage(IncomingMSRP & incomingMsg);
+
+        //
+        //  Pass a received message to the callbacks, from the dispatch pool
         //
-        void HandlerThread();
+        void DispatchMessage(IncomingMSRP incomingMsg);
+
+        enum States {
+          Connecting,
+          Connected,
+          Failed
+        };
+
+        //
+        //  Set the state and wake anyone waiting for the connection
+        //
+        void SetState(States state);
+
+        //
+        //  Wait for a connection being made by another user, false if it failed
+        //
+        bool WaitConnected(const PTimeInterval & timeout);
+
+        OpalManager & GetOpalManager() { return m_manager.GetOpalManager(); }
 
         OpalMSRPManager & m_manager;
         std::string m_key;
         MSRPProtocol * m_protocol;
-        bool m_running;
-        PThread * m_handlerThread;
+        atomic<bool> m_running;
         bool m_originating;
         atomic<uint32_t> m_refCount;
+        size_t m_handlerIndex;
+
+      protected:
+        States m_state;
+        PDECLARE_MUTEX(m_stateMutex);
+        PSyncPoint m_stateChanged;
     };
 
     //
@@ -204,9 +304,10 @@ class OpalMSRPManager : public PObject
     PURL SessionIDToURL(const OpalTransportAddress & addr, const std::string & id);
 
     //
-    //  Main listening thread for new connections
+    //  Handler thread reading the connections assigned to it. The first one
+    //  also accepts new connections.
     //
-    void ListenerThread();
+    void HandlerThread(size_t index);
 
     struct IncomingMSRP {
       int       m_command;
@@ -239,20 +340,45 @@ class OpalMSRPManager : public PObject
     OpalManager & GetOpalManager() { return opalManager; }
 
   protected:
+    //
+    //  Assign a started connection to a handler thread with room for it
+    //
+    void AddToHandler(Connection & connection);
+
+    //
+    //  Remove a connection from the map and its handler thread, the
+    //  m_connectionInfoMapAddMutex must be held
+    //
+    void RemoveConnection(Connection & connection);
+
     OpalManager & opalManager;
     WORD m_listenerPort;
     PMutex mutex;
     PTCPSocket m_listenerSocket;
-    PThread * m_listenerThread;
+    atomic<bool> m_running;
 
     PMutex m_connectionInfoMapAddMutex;
     typedef std::map<PString, PSafePtr<Connection> > ConnectionInfoMapType;
     ConnectionInfoMapType m_connectionInfoMap;
 
+    // Each handler selects over at most MaxConnectionsPerHandler sockets,
+    // so PSocket::Select is never asked for more than FD_SETSIZE
+    typedef std::map<Connection *, PSafePtr<Connection> > HandlerConnections;
+    struct Handler {
+      PThread * m_thread;
+      HandlerConnections m_connections;
+    };
+    std::vector<Handler> m_handlers;
+
     typedef std::map<PString, CallBack> CallBackMap;
     CallBackMap m_callBacks;
     PMutex m_callBacksMutex;
 
+    // Callbacks are run here, not on the handler threads, grouped by
+    // connection so each connection's messages stay in order. Last, so it
+    // is shut down before anything the callbacks use is destroyed.
+    PSafeThreadPool m_dispatchPool;
+
   private:
     static OpalMSRPManager * msrp;
 };
@@ -74,9 +74,10 @@ typedef struct OpalHandleStruct * OpalHandle;
 
 
 typedef struct OpalMessage OpalMessage;
+typedef struct OpalMediaRing OpalMediaRing;
 
 /// Current API version
-#define OPAL_C_API_VERSION 36
+#define OPAL_C_API_VERSION 37
 
 
 ///////////////////////////////////////
@@ -259,6 +260,77 @@ extern OpalMessage * OPAL_EXPORT OpalGetMessage(OpalHandle opal, unsigned timeou
 typedef OpalMessage * (OPAL_EXPORT *OpalGetMessageFunction)(OpalHandle opal, unsigned timeout);
 
 
+///////////////////////////////////////
+
+/** Get up to \p maxMessages messages from the OPAL system in one call.
+    The first parameter must be the handle returned by OpalInitialise(). The
+    second parameter is an array of at least \p maxMessages pointers which is
+    filled in with the messages retrieved.
+
+    The function waits up to \p timeout milliseconds for the first message,
+    then takes any further messages already queued without waiting. This
+    allows an application, or a language binding, to drain a burst of events
+    with a single call rather than one call per event.
+
+    The return value is the number of messages placed in the array, zero
+    indicating the timeout expired or the system is shut down. Each message
+    returned must be disposed of by a call to OpalFreeMessage().
+
+    Example:
+      <code>
+      OpalMessage * messages[32];
+      unsigned i, count;
+
+      while ((count = OpalGetMessages(hOPAL, messages, 32, timeout)) > 0) {
+        for (i = 0; i < count; ++i) {
+          HandleMessage(messages[i]);
+          OpalFreeMessage(messages[i]);
+        }
+      }
+      </code>
+  */
+extern unsigned OPAL_EXPORT OpalGetMessages(OpalHandle opal, OpalMessage ** messages, unsigned maxMessages, unsigned timeout);
+
+/** String representation of the OpalGetMessages() which may be used for late
+    binding to the library.
+ */
+#if _WIN32
+  #define OPAL_GET_MESSAGES_FUNCTION MAKEINTRESOURCE(6)
+#else
+  #define OPAL_GET_MESSAGES_FUNCTION "OpalGetMessages"
+#endif
+
+/** Typedef representation of the pointer to the OpalGetMessages() function which
+    may be used for late binding to the library.
+ */
+typedef unsigned (OPAL_EXPORT *OpalGetMessagesFunction)(OpalHandle opal, OpalMessage ** messages, unsigned maxMessages, unsigned timeout);
+
+
+///////////////////////////////////////
+
+/** Wake OPAL if it is waiting on an empty media ring.
+    The application calls this after advancing m_writePosition of a ring it
+    produces into, when m_consumerWaiting in that ring is non-zero. See
+    OpalMediaRing for more information. It is cheap, and does nothing if
+    OPAL is not waiting, but the flag avoids the call for almost all frames.
+  */
+extern void OPAL_EXPORT OpalSignalMediaRing(OpalMediaRing * ring);
+
+/** String representation of the OpalSignalMediaRing() which may be used for late
+    binding to the library.
+ */
+#if _WIN32
+  #define OPAL_SIGNAL_MEDIA_RING_FUNCTION MAKEINTRESOURCE(7)
+#else
+  #define OPAL_SIGNAL_MEDIA_RING_FUNCTION "OpalSignalMediaRing"
+#endif
+
+/** Typedef representation of the pointer to the OpalSignalMediaRing() function which
+    may be used for late binding to the library.
+ */
+typedef void (OPAL_EXPORT *OpalSignalMediaRingFunction)(OpalMediaRing * ring);
+
+
 ///////////////////////////////////////
 
 /** Send a message to the OPAL system. The first parameter must be the handle
@@ -608,6 +680,66 @@ typedef enum OpalMediaDataType {
 } OpalMediaDataType;
 
 
+/**Shared ring buffer for raw media data.
+   This is used as an alternative to the OpalMediaDataFunction call backs,
+   see the m_mediaRingSize field in OpalParamGeneral. The ring is allocated
+   by OPAL and its address is passed to the application in the m_mediaRing
+   field of the OpalIndMediaStream message when the stream opens.
+
+   Each ring has exactly one producer and one consumer. For media coming
+   from the remote ("in" streams) OPAL is the producer and the application
+   the consumer, for media going to the remote ("out" streams) it is the
+   other way around. The producer only ever changes m_writePosition and the
+   consumer only ever changes m_readPosition. Both are free running byte
+   counts, the offset into m_data is the position modulo m_size.
+
+   The data is a sequence of records, each being a 32 bit length in host
+   byte order followed by that many bytes of media, padded to a multiple of
+   four bytes. The media is the same as would have been passed to the
+   OpalMediaDataFunction call back, so includes the RTP header if
+   m_mediaDataHeader is OpalMediaDataWithHeader. A record never wraps
+   around the end of m_data, if there is not enough room before the end the
+   producer writes a length of OPAL_MEDIA_RING_WRAP and starts the record at
+   the beginning of m_data.
+
+   The producer must make the record visible before advancing
+   m_writePosition, and the consumer must have finished with a record
+   before advancing m_readPosition, i.e. memory barriers are needed on
+   weakly ordered processors. If OPAL is the producer and the ring is full,
+   the frame is discarded and m_overruns incremented.
+
+   If OPAL is the consumer and the ring is empty, it sets m_consumerWaiting
+   and waits for up to a packet time (at least 10ms and at most 100ms) for
+   a record, then treats it as the call back returning zero bytes. So that
+   OPAL is not kept waiting, the application should, after advancing
+   m_writePosition, call OpalSignalMediaRing() if m_consumerWaiting is set.
+   OPAL does not wait if the media timing is OpalMediaTimingSimulated, as
+   OPAL then paces the stream itself.
+
+   The ring belongs to the OpalIndMediaStream message that carried it, and
+   remains valid until that message is released with OpalFreeMessage(), so
+   the application should keep the message for as long as it uses the ring.
+   Once the OpalIndMediaStream message indicating the stream has closed is
+   received, OPAL no longer reads or writes the ring. If the stream opens
+   again, it is with a new ring, sized for the new media format.
+
+   From Java the m_data field is a java.nio.ByteBuffer mapped directly on
+   to the ring, i.e. a DirectByteBuffer, so no per frame call or copy
+   crosses the binding boundary beyond reading and writing the positions.
+  */
+struct OpalMediaRing {
+  unsigned                m_size;            /**< Size of m_data in bytes, always a power of two. */
+  volatile unsigned       m_readPosition;    /**< Total bytes consumed, only changed by the consumer. */
+  volatile unsigned       m_writePosition;   /**< Total bytes produced, only changed by the producer. */
+  volatile unsigned       m_overruns;        /**< Count of frames discarded by OPAL due to the ring being full. */
+  volatile unsigned       m_consumerWaiting; /**< Non-zero when OPAL is waiting on an empty ring, see OpalSignalMediaRing(). */
+  unsigned char         * m_data;            /**< Ring data, m_size bytes. */
+};
+
+/// Record length value indicating the producer has skipped to the start of the ring.
+#define OPAL_MEDIA_RING_WRAP 0xffffffff
+
+
 /**Timing mode for the media data call back functions data type.
    This is used by the OpalCmdSetGeneralParameters command in the
    OpalParamGeneral structure.
@@ -819,6 +951,12 @@ typedef struct OpalParamGeneral {
                                            if the certicalte and private key files are not found at the locations
                                            indicated (value=1), or that only the file/value indicated in above
                                            fields is used exclusively (value=2). */
+  unsigned m_mediaRingSize;           /**< Size in bytes of a shared ring buffer to be used for raw media on
+                                           OPAL_PREFIX_LOCAL streams instead of the m_mediaReadData and
+                                           m_mediaWriteData call backs. This is rounded up to a power of two,
+                                           and is a minimum, each ring is made large enough for at least
+                                           four frames of its media format. See OpalMediaRing for more information. If zero then no change is
+                                           made, if -1 (UINT_MAX) then the call backs are used. */
 } OpalParamGeneral;
 
 
@@ -1305,6 +1443,10 @@ typedef struct OpalStatusMediaStream {
                                       video source device place on lower right corner. It would
                                       typically be a .BMP or .JPG file, but theoretically could be
                                       any video source device, including another camera. */
+  OpalMediaRing * m_mediaRing;   /**< For OpalIndMediaStream with m_state OpalMediaStateOpen, this is
+                                      the shared ring buffer for the raw media of the stream, if
+                                      m_mediaRingSize in OpalParamGeneral has been set. Otherwise NULL.
+                                      Ignored for OpalCmdMediaStream. */
 } OpalStatusMediaStream;
 
 
@@ -42,6 +42,7 @@
 #include <opal/guid.h>
 #include <opal/transports.h>
 #include <ptclib/dtmf.h>
+#include <codec/tonedetect.h>
 #include <ptlib/safecoll.h>
 #include <rtp/rtp.h>
 
@@ -87,6 +88,7 @@ class PURL;
 #define OPAL_OPT_ENABLE_INBAND_DTMF   "EnableInbandDTMF"      ///< String option to enable in band DTMF detection/send
 #define OPAL_OPT_DETECT_INBAND_DTMF   "DetectInBandDTMF"      ///< String option to enable in band DTMF detection
 #define OPAL_OPT_SEND_INBAND_DTMF     "SendInBandDTMF"        ///< String option to enable in band DTMF send as fall back for other UI modes
+#define OPAL_OPT_DETECT_INBAND_TONES  "DetectInBandTones"     ///< String option to use OPAL tone detector for in band DTMF, fax and call progress tones
 #define OPAL_OPT_DTMF_MULT            "dtmfmult"
 #define OPAL_OPT_DTMF_DIV             "dtmfdiv"
 #define OPAL_OPT_DISABLE_JITTER       "Disable-Jitter"        ///< String option to disable jitter buffer if "true"
@@ -1513,6 +1515,17 @@ class OpalConnection : public PSafeObject
       unsigned duration   ///< Duration of tone in milliseconds
     );
 
+    /**Call back for in-band call progress tone detected.
+       This is only called when OPAL_OPT_DETECT_INBAND_TONES is enabled, and
+       then once for each change of call progress tone in the audio,
+       including to NoCallProgress some seconds after the tone stops.
+
+       The default behaviour does nothing.
+      */
+    virtual void OnDetectedCallProgress(
+      OpalToneDetector::CallProgress progress   ///< Call progress tone detected
+    );
+
     /**Send a user input indication to the remote endpoint.
        This sends a Hook Flash emulation user input.
       */
@@ -1985,6 +1998,9 @@ class OpalConnection : public PSafeObject
     // added to the audio channel.
 #if OPAL_PTLIB_DTMF
     PDTMFDecoder m_dtmfDecoder;
+    OpalToneDetector m_toneDetector;
+    OpalToneDetector::CallProgress m_lastCallProgress;
+    bool         m_detectInBandTones;
     bool         m_detectInBandDTMF;
     unsigned     m_dtmfScaleMultiplier;
     unsigned     m_dtmfScaleDivisor;
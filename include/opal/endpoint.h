@@ -171,6 +171,45 @@ class OpalEndPoint : public PObject
       PSSLContext & context,    ///< Context to which t set certificates
       bool create               ///< Create self signed cert/key if required
     ) const;
+
+    /** Get the shared SSL context for TLS listeners or outgoing transports.
+        The context is created, and ApplySSLCredentials() called, on first
+        use. All TLS transports of the endpoint then share it, so credentials
+        are not re-loaded for every connection, and resumable sessions are
+        shared across all listeners.
+
+        Every few seconds the manager's certificate authority, certificate
+        and private key file names, and the modification times of those
+        files, are checked. If any have changed a new context is created, so
+        a renewed certificate is used without a restart. Contexts replaced
+        this way are deleted once no connection uses them, see
+        UseSSLContext(), or when the endpoint is destroyed.
+
+        Returns NULL if the credentials could not be applied.
+      */
+    PSSLContext * GetSSLContext(
+      bool server               ///< Context for listeners, rather than outgoing
+    );
+
+    /** Get the SSL context, as for GetSSLContext(), for a connection that
+        will use it until ReleaseSSLContext() is called.
+      */
+    PSSLContext * UseSSLContext(
+      bool server               ///< Context for listeners, rather than outgoing
+    );
+
+    /** Release a context obtained from UseSSLContext(). If it has been
+        replaced, and this was its last user, it is deleted.
+      */
+    void ReleaseSSLContext(
+      PSSLContext * context     ///< Context to release, may be NULL
+    );
+
+    /** Force the SSL contexts to be created again on next use.
+        This is for when ApplySSLCredentials() has been overridden to use
+        credentials other than the managers files.
+      */
+    void InvalidateSSLContexts();
 #endif
 
     /**Find a listener given the transport address.
@@ -209,6 +248,18 @@ class OpalEndPoint : public PObject
                           ///<  Associated transport for precedence and translation
     ) const;
 
+    /**Set the number of threads handling received packets on UDP listeners.
+       A value greater than one spreads the handling of incoming datagrams,
+       e.g. SIP parsing, over that many threads, see
+       OpalListenerUDP::SetReceiveThreads(). Only affects listeners started
+       after this call. Default is 1.
+      */
+    void SetUDPReceiveThreads(unsigned count) { m_receiveThreadsUDP = std::max(count, 1U); }
+
+    /**Get the number of threads handling received packets on UDP listeners.
+      */
+    unsigned GetUDPReceiveThreads() const { return m_receiveThreadsUDP; }
+
     /**Handle new incoming connection.
        This will either create a new connection object or utilise a previously
        created connection on the same transport address and reference number.
@@ -923,6 +974,17 @@ class OpalEndPoint : public PObject
     PCaselessString m_prefixName;
     Attributes      m_attributes;
     PINDEX          m_maxSizeUDP;
+    unsigned        m_receiveThreadsUDP;
+#if OPAL_PTLIB_SSL
+    PSSLContext   * m_sslContext[2];
+    PString         m_sslCredentials[2];
+    PTimeInterval   m_sslCredentialsChecked[2];
+    std::list<PSSLContext *> m_sslRetiredContexts;
+    std::map<PSSLContext *, unsigned> m_sslContextUsers;
+    void RetireSSLContext(PSSLContext * context);
+    PDECLARE_MUTEX( m_sslContextMutex);
+    PString GetSSLCredentialsKey() const;
+#endif
     OpalProductInfo m_productInfo;
     PString         m_defaultLocalPartyName;
     PString         m_defaultDisplayName;
@@ -40,6 +40,7 @@
 #include <opal/guid.h>
 #include <codec/silencedetect.h>
 #include <codec/echocancel.h>
+#include <rtp/pcapcapture.h>
 #include <im/im.h>
 
 #include <ptclib/pstun.h>
@@ -1696,6 +1697,12 @@ class OpalManager : public PObject
     void SetMaxRtpPacketSize(
       PINDEX size
     ) { m_rtpPacketSizeMax = size; }
+
+    /**Get the packet capture for media transports.
+       Capture is not running until OpalPCAPCapture::Start() is called, and
+       only calls matching a trigger are captured.
+      */
+    OpalPCAPCapture & GetPCAPCapture() { return m_pcapCapture; }
   //@}
 
 
@@ -1903,6 +1910,35 @@ class OpalManager : public PObject
       OpalVideoFormat::ContentRole role = OpalVideoFormat::eNoRole  ///< Role for video stream to get
     ) const { return m_videoOutputDevice[role]; }
 
+    /**Set the maximum number of threads all video codecs may use in total.
+       Each transcoder asks for the number of threads in the "Encoder Threads"
+       or "Decoder Threads" media option, and is granted what is left of this
+       budget, but always at least one. When a budget is set, a request for
+       zero (codec default) is treated as a request for one thread.
+
+       Default is zero which indicates no limit.
+     */
+    void SetMaxCodecThreads(
+      unsigned threads  ///< Maximum threads for all video codecs
+    ) { m_maxCodecThreads = threads; }
+
+    /**Get the maximum number of threads all video codecs may use in total.
+     */
+    unsigned GetMaxCodecThreads() const { return m_maxCodecThreads; }
+
+    /**Allocate threads from the video codec thread budget.
+       @return number of threads granted, to be released via ReleaseCodecThreads().
+     */
+    virtual unsigned AllocateCodecThreads(
+      unsigned requested  ///< Number of threads requested, zero is codec default
+    );
+
+    /**Release threads back to the video codec thread budget.
+     */
+    virtual void ReleaseCodecThreads(
+      unsigned threads  ///< Number of threads returned from AllocateCodecThreads()
+    );
+
 #endif
 
     PBoolean DetectInBandDTMFDisabled() const
@@ -2085,6 +2121,7 @@ class OpalManager : public PObject
 
     PINDEX        m_rtpPayloadSizeMax;
     PINDEX        m_rtpPacketSizeMax;
+    OpalPCAPCapture m_pcapCapture;
     OpalJitterBuffer::Params m_jitterParams;
     PStringArray  m_mediaFormatOrder;
     PStringArray  m_mediaFormatMask;
@@ -2112,6 +2149,9 @@ class OpalManager : public PObject
     PVideoDevice::OpenArgs m_videoInputDevice[OpalVideoFormat::NumContentRole];
     PVideoDevice::OpenArgs m_videoPreviewDevice[OpalVideoFormat::NumContentRole];
     PVideoDevice::OpenArgs m_videoOutputDevice[OpalVideoFormat::NumContentRole];
+    unsigned               m_maxCodecThreads;
+    unsigned               m_codecThreadsInUse;
+    PMutex                 m_codecThreadsMutex;
 #endif
 
     PIPSocket::PortRange m_tcpPorts, m_udpPorts, m_rtpIpPorts;
@@ -43,9 +43,11 @@
 #endif
 
 #include <limits>
+#include <vector>
 
 
 class PluginCodec_OptionMap;
+struct PluginCodec_NALUnit;
 class OpalMediaFormat;
 class H225_BandWidth;
 class PASN_Integer;
@@ -297,8 +299,143 @@ class OpalMediaFormatList : public OpalMediaFormatBaseList
 };
 
 
+/**Set of media formats represented as bits.
+   Every media format name is given a small, dense, index when a format of
+   that name is first constructed, so sets of formats may be combined with bitwise
+   operations instead of searching lists by name. Membership is by name only,
+   as for OpalMediaFormatList::HasFormat(), the options of a format play no
+   part. Use RemoveMissing() to apply the result back to a list.
+  */
+class OpalMediaFormatSet
+{
+  public:
+    /**Create an empty set.
+      */
+    OpalMediaFormatSet() { }
+
+    /**Create a set from the formats in the list.
+      */
+    explicit OpalMediaFormatSet(
+      const OpalMediaFormatList & formats
+    );
+
+    /**Get the index of the format name.
+       Returns P_MAX_INDEX if format is not valid.
+      */
+    static PINDEX GetIndex(
+      const OpalMediaFormat & format
+    );
+
+    /**Get the index of the format name, allocating one if needed.
+      */
+    static PINDEX GetIndex(
+      const PString & formatName
+    );
+
+    /**Add a format to the set.
+      */
+    OpalMediaFormatSet & operator+=(
+      const OpalMediaFormat & format
+    );
+
+    /**Add all formats in the list to the set.
+      */
+    OpalMediaFormatSet & operator+=(
+      const OpalMediaFormatList & formats
+    );
+
+    /**Add a format to the set by its index.
+      */
+    void AddIndex(
+      PINDEX index
+    );
+
+    /**Union with another set.
+      */
+    OpalMediaFormatSet & operator|=(
+      const OpalMediaFormatSet & other
+    );
+
+    /**Intersection with another set.
+      */
+    OpalMediaFormatSet & operator&=(
+      const OpalMediaFormatSet & other
+    );
+
+    /**Determine if the format is in the set.
+      */
+    bool Contains(
+      const OpalMediaFormat & format
+    ) const;
+
+    /**Determine if the format with the index is in the set.
+      */
+    bool ContainsIndex(
+      PINDEX index
+    ) const;
+
+    /**Determine if every format in this set is also in the other set.
+      */
+    bool IsSubsetOf(
+      const OpalMediaFormatSet & other
+    ) const;
+
+    /**Determine if set is empty.
+      */
+    bool IsEmpty() const;
+
+    /**Remove any formats from the list that are not in this set.
+       The order of the remaining entries is unchanged.
+      */
+    void RemoveMissing(
+      OpalMediaFormatList & formats
+    ) const;
+
+  protected:
+    typedef PUInt64 Word;
+    enum { BitsPerWord = sizeof(Word)*8 };
+    std::vector<Word> m_bits;
+};
+
+
 ///////////////////////////////////////////////////////////////////////////////
 
+/**Interned media option name.
+   Option names are converted once, on construction, to a small integer
+   identifier which can then be used to locate the option in any media
+   format without string comparisons. Keys are intended to be created once,
+   e.g. as a function static, and reused for every access.
+  */
+class OpalMediaOptionKey
+{
+  public:
+    explicit OpalMediaOptionKey(
+      const PString & name
+    );
+
+    const PString & GetName() const { return m_name; }
+    unsigned GetID() const { return m_id; }
+
+    /**Get the identifier for the option name, allocating one if the name
+       has not been seen before.
+      */
+    static unsigned Intern(
+      const PString & name
+    );
+
+    /**Get the identifier for the option name.
+       Returns UINT_MAX if no option of that name has ever been created.
+      */
+    static unsigned Find(
+      const PString & name
+    );
+
+  protected:
+    PCaselessString m_name;
+    unsigned        m_id;
+};
+
+
 /**Base class for options attached to an OpalMediaFormat.
   */
 class OpalMediaOption : public PObject
@@ -353,6 +490,7 @@ class OpalMediaOption : public PObject
     bool FromString(const PString & value);
 
     const PString & GetName() const { return m_name; }
+    unsigned GetID() const { return m_id; }
 
     bool IsReadOnly() const { return m_readOnly; }
     void SetReadOnly(bool readOnly) { m_readOnly = readOnly; }
@@ -415,6 +553,7 @@ class OpalMediaOption : public PObject
 
   protected:
     PCaselessString m_name;
+    unsigned        m_id;
     bool            m_readOnly;
     MergeType       m_merge;
 
@@ -723,6 +862,8 @@ class OpalMediaFormatInternal : public PObject
       time_t        timeStamp = 0,
       bool          allowMultiple = false
     );
+    OpalMediaFormatInternal(const OpalMediaFormatInternal & other);
+    ~OpalMediaFormatInternal();
 
     const PCaselessString & GetName() const { return formatName; }
 
@@ -736,20 +877,26 @@ class OpalMediaFormatInternal : public PObject
     virtual bool GetOptionValue(const PString & name, PString & value) const;
     virtual bool SetOptionValue(const PString & name, const PString & value);
     virtual bool GetOptionBoolean(const PString & name, bool dflt) const;
+    bool GetOptionBoolean(const OpalMediaOptionKey & key, bool dflt) const;
     virtual bool SetOptionBoolean(const PString & name, bool value);
     virtual int GetOptionInteger(const PString & name, int dflt) const;
+    int GetOptionInteger(const OpalMediaOptionKey & key, int dflt) const;
     virtual bool SetOptionInteger(const PString & name, int value);
+    bool SetOptionInteger(const OpalMediaOptionKey & key, int value);
     virtual double GetOptionReal(const PString & name, double dflt) const;
     virtual bool SetOptionReal(const PString & name, double value);
     virtual PINDEX GetOptionEnum(const PString & name, PINDEX dflt) const;
     virtual bool SetOptionEnum(const PString & name, PINDEX value);
     virtual PString GetOptionString(const PString & name, const PString & dflt) const;
+    PString GetOptionString(const OpalMediaOptionKey & key, const PString & dflt) const;
     virtual bool SetOptionString(const PString & name, const PString & value);
     virtual bool GetOptionOctets(const PString & name, PBYTEArray & octets) const;
     virtual bool SetOptionOctets(const PString & name, const PBYTEArray & octets);
     virtual bool SetOptionOctets(const PString & name, const BYTE * data, PINDEX length);
     virtual bool AddOption(OpalMediaOption * option, PBoolean overwrite = false);
     virtual OpalMediaOption * FindOption(const PString & name) const;
+    OpalMediaOption * FindOption(const OpalMediaOptionKey & key) const { return FindOptionByID(key.GetID()); }
+    OpalMediaOption * FindOptionByID(unsigned id) const;
 
     virtual bool ToNormalisedOptions();
     virtual bool ToCustomisedOptions();
@@ -762,6 +909,8 @@ class OpalMediaFormatInternal : public PObject
     void DeconflictPayloadTypes(OpalMediaFormatList & formats);
 
   protected:
+    void BuildOptionIndex();
+
     bool AdjustByOptionMaps(
       PTRACE_PARAM(const char * operation,)
       bool (*adjuster)(PluginCodec_OptionMap & original, PluginCodec_OptionMap & changed)
@@ -773,9 +922,19 @@ class OpalMediaFormatInternal : public PObject
     OpalMediaType                mediaType;
     PMutex                       media_format_mutex;
     PSortedList<OpalMediaOption> options;
+
+    /* Options sorted by OpalMediaOption::GetID(), read without a lock. It is
+       never changed once published, a new one is built on every change to
+       options, and the old one, and any option removed, retired until
+       destruction, as a reader could still be using them. */
+    typedef std::vector<OpalMediaOption *> OptionIndex;
+    atomic<const OptionIndex *>  m_optionIndex;
+    std::vector<const OptionIndex *> m_retiredIndexes;
+    PList<OpalMediaOption>       m_retiredOptions;
     time_t                       codecVersionTime;
     bool                         forceIsTransportable;
     bool                         m_allowMultiple;
+    PINDEX                       m_setIndex; // OpalMediaFormatSet::GetIndex() of formatName, fixed at construction
 
   friend bool operator==(const char * other, const OpalMediaFormat & fmt);
   friend bool operator!=(const char * other, const OpalMediaFormat & fmt);
@@ -784,6 +943,7 @@ class OpalMediaFormatInternal : public PObject
 
   friend class OpalMediaFormat;
   friend class OpalMediaFormatList;
+  friend class OpalMediaFormatSet;
   friend class OpalAudioFormatInternal;
 };
 
@@ -1011,30 +1171,30 @@ class OpalMediaFormat : public PContainer
     /**Determine if the media format requires a jitter buffer. As a rule an
        audio codec needs a jitter buffer and all others do not.
       */
-    bool NeedsJitterBuffer() const { return GetOptionBoolean(NeedsJitterOption()); }
+    bool NeedsJitterBuffer() const;
     static const PString & NeedsJitterOption();
 
     /**Get the maximum bandwidth used in bits/second.
       */
-    OpalBandwidth GetMaxBandwidth() const { return GetOptionInteger(MaxBitRateOption()); }
+    OpalBandwidth GetMaxBandwidth() const;
     static const PString & MaxBitRateOption();
 
     /**Get the used bandwidth used in bits/second.
       */
-    OpalBandwidth GetUsedBandwidth() const { return GetOptionInteger(TargetBitRateOption(), GetOptionInteger(MaxBitRateOption())); }
+    OpalBandwidth GetUsedBandwidth() const;
     static const PString & TargetBitRateOption();
 
     /**Get the maximum frame size in bytes. If this returns zero then the
        media format has no intrinsic maximum frame size, eg a video format
        would return zero but G.723.1 would return 24.
       */
-    PINDEX GetFrameSize() const { return GetOptionInteger(MaxFrameSizeOption()); }
+    PINDEX GetFrameSize() const;
     static const PString & MaxFrameSizeOption();
 
     /**Get the frame time in RTP timestamp units. If this returns zero then
        the media format is not real time and has no intrinsic timing eg T.120
       */
-    unsigned GetFrameTime() const { return GetOptionInteger(FrameTimeOption()); }
+    unsigned GetFrameTime() const;
     static const PString & FrameTimeOption();
 
     /**Get the number of RTP timestamp units per millisecond.
@@ -1048,7 +1208,7 @@ class OpalMediaFormat : public PContainer
 
     /**Get the clock rate in Hz for this format.
       */
-    unsigned GetClockRate() const { return GetOptionInteger(ClockRateOption(), AudioClockRate); }
+    unsigned GetClockRate() const;
     static const PString & ClockRateOption();
 
     /**Get the name of the OpalMediaOption indicating the protocol the format is being used on.
@@ -1126,6 +1286,10 @@ class OpalMediaFormat : public PContainer
       const PString & name,   ///<  Option name
       bool dflt = false       ///<  Default value if option not present
     ) const { PWaitAndSignal m(m_mutex); return m_info != NULL && m_info->GetOptionBoolean(name, dflt); }
+    bool GetOptionBoolean(
+      const OpalMediaOptionKey & key, ///<  Interned option name
+      bool dflt = false               ///<  Default value if option not present
+    ) const { PWaitAndSignal m(m_mutex); return m_info != NULL && m_info->GetOptionBoolean(key, dflt); }
 
     /**Set the option value of the specified name as a boolean.
        Note the option will not be added if it does not exist, the option
@@ -1145,6 +1309,10 @@ class OpalMediaFormat : public PContainer
       const PString & name,   ///<  Option name
       int dflt = 0            ///<  Default value if option not present
     ) const { PWaitAndSignal m(m_mutex); return m_info == NULL ? dflt : m_info->GetOptionInteger(name, dflt); }
+    int GetOptionInteger(
+      const OpalMediaOptionKey & key, ///<  Interned option name
+      int dflt = 0                    ///<  Default value if option not present
+    ) const { PWaitAndSignal m(m_mutex); return m_info == NULL ? dflt : m_info->GetOptionInteger(key, dflt); }
 
     /**Set the option value of the specified name as an integer.
        Note the option will not be added if it does not exist, the option
@@ -1157,6 +1325,10 @@ class OpalMediaFormat : public PContainer
       const PString & name,   ///<  Option name
       int value               ///<  New value for option
     ) { PWaitAndSignal m(m_mutex); MakeUnique(); return m_info != NULL && m_info->SetOptionInteger(name, value); }
+    bool SetOptionInteger(
+      const OpalMediaOptionKey & key, ///<  Interned option name
+      int value                       ///<  New value for option
+    ) { PWaitAndSignal m(m_mutex); MakeUnique(); return m_info != NULL && m_info->SetOptionInteger(key, value); }
 
     /**Get the option value of the specified name as a payload type. The default
        value is returned if the option is not present.
@@ -1220,6 +1392,10 @@ class OpalMediaFormat : public PContainer
       const PString & name,                   ///<  Option name
       const PString & dflt = PString::Empty() ///<  Default value if option not present
     ) const { PWaitAndSignal m(m_mutex); return m_info == NULL ? dflt : m_info->GetOptionString(name, dflt); }
+    PString GetOptionString(
+      const OpalMediaOptionKey & key,         ///<  Interned option name
+      const PString & dflt = PString::Empty() ///<  Default value if option not present
+    ) const { PWaitAndSignal m(m_mutex); return m_info == NULL ? dflt : m_info->GetOptionString(key, dflt); }
 
     /**Set the option value of the specified name as a string.
        Note the option will not be added if it does not exist, the option
@@ -1287,6 +1463,13 @@ class OpalMediaFormat : public PContainer
       const OpalMediaFormat & mediaFormat  ///<  Media format to copy to master list
     );
 
+    /**Get a sequence number for the master format list.
+       This changes whenever a media format is registered, removed or has its
+       master options changed, so a cache derived from the registered formats
+       can tell when it must be rebuilt.
+      */
+    static unsigned GetRegisteredMediaFormatsSequence();
+
     /**
       * Add a new option to this media format
       */
@@ -1306,6 +1489,9 @@ class OpalMediaFormat : public PContainer
     OpalMediaOption * FindOption(
       const PString & name
     ) const { PWaitAndSignal m(m_mutex); return m_info == NULL ? NULL : m_info->FindOption(name); }
+    OpalMediaOption * FindOption(
+      const OpalMediaOptionKey & key
+    ) const { PWaitAndSignal m(m_mutex); return m_info == NULL ? NULL : m_info->FindOption(key); }
 
     /** Get a pointer to the specified media format option.
         Returns NULL if thee option does not exist.
@@ -1373,6 +1559,7 @@ class OpalMediaFormat : public PContainer
 
   friend class OpalMediaFormatInternal;
   friend class OpalMediaFormatList;
+  friend class OpalMediaFormatSet;
   friend class OpalAudioFormat;
   friend class OpalVideoFormat;
 };
@@ -1495,6 +1682,8 @@ class OpalVideoFormat : public OpalMediaFormat
     static const PString & RateControlPeriodOption(); // Period over which the rate controller maintains the target bit rate.
     static const PString & FrameDropOption(); // Boolean to allow frame dropping to maintain target bit rate, default true
     static const PString & FreezeUntilIntraFrameOption();
+    static const PString & EncoderThreadsOption(); // Threads for encoder, zero is codec default
+    static const PString & DecoderThreadsOption(); // Threads for decoder, zero is codec default
 
     /**The "role" of the content in the video stream based on this media
        format. This is based on RFC4796 and H.239 semantics and is an
@@ -1549,6 +1738,34 @@ class OpalVideoFormat : public OpalMediaFormat
     typedef PFactory<FrameDetector, PCaselessString> FrameDetectFactory;
 
     FrameType GetFrameType(const BYTE * payloadPtr, PINDEX payloadSize, FrameDetectorPtr & detector) const;
+
+    /**Packetise a coded access unit, as returned by an encoder, directly
+       into the payloads of the RTP frames to be sent. Created by the RTP
+       encoding name, e.g. "H264", from PacketiserFactory.
+      */
+    class Packetiser
+    {
+    protected:
+      Packetiser() { }
+    public:
+      virtual ~Packetiser() { }
+
+      /// Set maximum payload size, packetisation mode etc. Returns false if unsupported.
+      virtual bool SetMediaFormat(const OpalMediaFormat & mediaFormat) = 0;
+
+      /// Maximum size of payload that GetPayload() will write
+      virtual PINDEX GetMaxPayloadSize() const = 0;
+
+      /// Start packetising a new access unit, data must be valid until the last payload
+      virtual void SetAccessUnit(const BYTE * data, const PluginCodec_NALUnit * units, PINDEX count) = 0;
+
+      /**Write the next payload. Returns the size written, or zero if there
+         are no more, and sets last on the final payload of the access unit.
+        */
+      virtual PINDEX GetPayload(BYTE * payload, bool & last) = 0;
+    };
+    typedef std::auto_ptr<Packetiser> PacketiserPtr;
+    typedef PFactory<Packetiser, PCaselessString> PacketiserFactory;
 };
 
 class OpalVideoFormatInternal : public OpalMediaFormatInternal
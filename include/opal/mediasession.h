@@ -44,6 +44,7 @@ class OpalMediaFormat;
 class OpalMediaFormatList;
 class OpalMediaCryptoSuite;
 class RTP_TransportWideCongestionControl;
+class OpalPCAPCapture;
 class H235SecurityCapability;
 class H323Capability;
 class PSTUNClient;
@@ -471,7 +472,10 @@ class OpalMediaTransport : public PSafeObject, public OpalMediaTransportChannelT
     struct CongestionControl
     {
       virtual ~CongestionControl() { }
-      virtual unsigned HandleTransmitPacket(unsigned sessionID, uint32_t ssrc) = 0;
+      virtual unsigned HandleTransmitPacket(unsigned sessionID, uint32_t ssrc, unsigned size) = 0;
+      /* Time to hold back a packet of size bytes, or PMaxTimeInterval if the
+         pacer is already too far behind and the packet should be dropped. */
+      virtual PTimeInterval GetPacingDelay(unsigned size) = 0;
       virtual void HandleReceivePacket(unsigned sn, const PTime & received) = 0;
       virtual PTimeInterval GetProcessInterval() const = 0;
       virtual bool ProcessReceivedPackets() = 0;
@@ -481,6 +485,11 @@ class OpalMediaTransport : public PSafeObject, public OpalMediaTransportChannelT
     CongestionControl * SetCongestionControl(CongestionControl * cc);
     CongestionControl * GetCongestionControl() const { return m_congestionControl; }
 
+    /**Set packet capture for this transport.
+       A NULL \p capture stops capturing.
+      */
+    void SetCapture(OpalPCAPCapture * capture) { m_capture = capture; }
+
   protected:
     virtual void InternalClose();
     virtual void InternalStop();
@@ -497,6 +506,8 @@ class OpalMediaTransport : public PSafeObject, public OpalMediaTransportChannelT
 
     atomic<CongestionControl *> m_congestionControl;
     PTimer m_ccTimer;
+
+    atomic<OpalPCAPCapture *> m_capture;
     PDECLARE_NOTIFIER(PTimer, OpalMediaTransport, ProcessCongestionControl);
 
     struct ChannelInfo
@@ -565,6 +576,8 @@ class OpalUDPMediaTransport : public OpalMediaTransport
     virtual void InternalRxData(SubChannels subchannel, const PBYTEArray & data);
     virtual bool InternalSetRemoteAddress(const PIPSocket::AddressAndPort & ap, SubChannels subchannel, bool dontOverride PTRACE_PARAM(, const char * source));
 
+    PIPSocketAddressAndPort GetCaptureAddress(SubChannels subchannel);
+
     bool m_localHasRestrictedNAT;
 
     struct SocketInfo
@@ -572,10 +585,14 @@ class OpalUDPMediaTransport : public OpalMediaTransport
       PUDPSocket         * m_socket;
       OpalTransportAddress m_localAddress;
       OpalTransportAddress m_remoteAddress;
+      PIPSocketAddressAndPort m_localAP;    // As bound, set only in Open()
+      PIPSocket::Address      m_routeTo;    // Remote used to resolve a wildcard m_localAP, under m_captureMutex
+      PIPSocketAddressAndPort m_captureAP;  // Resolved m_localAP, invalid until first capture, under m_captureMutex
 
-      SocketInfo() : m_socket(NULL) { }
+      SocketInfo() : m_socket(NULL), m_routeTo(PIPSocket::GetInvalidAddress()) { }
     };
     vector<SocketInfo> m_socketInfo;
+    PDECLARE_MUTEX(m_captureMutex);
 };
 
 
@@ -47,6 +47,7 @@ class OpalMediaPatch;
 class OpalLine;
 class OpalConnection;
 class OpalMediaStatistics;
+class OpalPCM16ComfortNoise;
 
 
 typedef PSafePtr<OpalMediaPatch, PSafePtrMultiThreaded> OpalMediaPatchPtr;
@@ -661,6 +662,7 @@ class OpalRawMediaStream : public OpalMediaStream
     PDECLARE_MUTEX(m_channelMutex);
 
     PBYTEArray m_silence;
+    OpalPCM16ComfortNoise * m_comfortNoise;
 
     PUInt64    m_averageSignalSum;
     unsigned   m_averageSignalSamples;
@@ -247,9 +247,22 @@ class OpalMediaPatch : public PSafeObject
     void StopThread();
     bool DispatchFrame(RTP_DataFrame & frame);
     bool DispatchFrameLocked(RTP_DataFrame & frame, bool bypassing);
+#if OPAL_VIDEO
+    BYTE * GetCodecInputBuffer(PINDEX size);
+    void ReleaseCodecBuffer();
+#endif
+    void DeleteTranscoder(OpalTranscoder * codec);
 
     OpalMediaStream & m_source;
 
+#if OPAL_VIDEO
+    // Transcoder whose memory the patch thread is reading the source into,
+    // declared before m_sinks as a Sink deleting its codec may retire it here
+    OpalTranscoder        * m_codecBufferOwner;
+    PList<OpalTranscoder>   m_retiredCodecs;
+    PDECLARE_MUTEX(m_codecBufferMutex);
+#endif
+
     class Sink : public PObject {
         PCLASSINFO(Sink, PObject);
       public:
@@ -262,6 +275,10 @@ class OpalMediaPatch : public PSafeObject
 #if OPAL_STATISTICS
         void GetStatistics(OpalMediaStatistics & statistics, bool fromSource) const;
 #endif
+#if OPAL_VIDEO
+        void AllocateCodecThreads(OpalMediaFormat & sourceFormat, OpalMediaFormat & destinationFormat);
+        void ReleaseCodecThreads();
+#endif
 
         OpalMediaPatch  &  m_patch;
         OpalMediaStreamPtr m_stream;
@@ -269,6 +286,9 @@ class OpalMediaPatch : public PSafeObject
         OpalTranscoder   * m_secondaryCodec;
         RTP_DataFrameList  m_intermediateFrames;
         RTP_DataFrameList  m_finalFrames;
+#if OPAL_VIDEO
+        unsigned           m_codecThreads;
+#endif
 
 #if OPAL_STATISTICS
         OpalAudioFormat m_audioFormat;
@@ -213,6 +213,19 @@ class OpalTranscoder : public OpalMediaFormatPair
       RTP_DataFrame & output        ///<  Output data
     ) = 0;
 
+    /**Get memory the transcoder would like its next input built in.
+       Some codecs, e.g. an encoder in a helper process, can read the input
+       directly from memory they own. If this returns non-NULL, the caller
+       may construct the next RTP_DataFrame passed to ConvertFrames() in that
+       memory, and avoid a copy of every frame. The memory is valid until the
+       next call to this function, or the transcoder is destroyed.
+
+       The default behaviour returns NULL.
+      */
+    virtual BYTE * GetInputBuffer(
+      PINDEX size     ///<  Size of input frame, including RTP header
+    );
+
     /**Create an instance of a media conversion function.
        Returns NULL if there is no registered media transcoder between the two
        named formats.
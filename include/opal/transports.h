@@ -47,6 +47,7 @@ class OpalManager;
 class OpalEndPoint;
 class OpalListener;
 class OpalTransport;
+class OpalTransportUDP;
 class OpalInternalTransport;
 
 typedef PSafePtr<OpalTransport> OpalTransportPtr;
@@ -755,14 +756,62 @@ class OpalListenerUDP : public OpalListenerIP
     void SetBufferSize(
       PINDEX size
     ) { m_bufferSize = size; }
+
+    /**Set the number of threads handling received packets.
+       If greater than one, the listener thread only reads datagrams and
+       passes them to one of this many threads, chosen by the remote address,
+       so all packets from a given remote are handled, in order, by the same
+       thread. The transport for each remote is also kept and re-used, rather
+       than being created for every packet.
+
+       This must be set before Open() is called.
+      */
+    void SetReceiveThreads(
+      unsigned count
+    ) { m_receiveThreadCount = count; }
+
+    /**Get the number of threads handling received packets.
+      */
+    unsigned GetReceiveThreads() const { return m_receiveThreadCount; }
   //@}
 
 
   protected:
     virtual const PCaselessString & GetProtoPrefix() const;
 
+    struct ReceivedPacket
+    {
+      ReceivedPacket(
+        const OpalTransportPtr & transport = OpalTransportPtr(),
+        const PBYTEArray & pdu = PBYTEArray()
+      ) : m_transport(transport), m_pdu(pdu) { }
+      OpalTransportPtr m_transport;
+      PBYTEArray       m_pdu;
+    };
+
+    struct CachedTransport
+    {
+      OpalTransportPtr m_transport;
+      PTimeInterval    m_lastUsed;
+    };
+    typedef std::map<PString, CachedTransport> TransportCache;
+
+    struct ReceiveThread
+    {
+      ReceiveThread() : m_thread(NULL), m_lastCacheCheck(0) { }
+      PSyncQueue<ReceivedPacket> m_queue;
+      PThread                  * m_thread;
+      TransportCache             m_transports; // Only used by listener thread
+      PTimeInterval              m_lastCacheCheck;
+    };
+
+    void ReadForReceiveThreads();
+    void ReceiveThreadMain(ReceiveThread * info);
+
     PMonitoredSocketsPtr m_listenerBundle;
     PINDEX               m_bufferSize;
+    unsigned             m_receiveThreadCount;
+    std::vector<ReceiveThread *> m_receiveThreads;
 };
 
 
@@ -1328,6 +1377,17 @@ class OpalTransportUDP : public OpalTransportIP
       const WriteConnectCallback & function  ///<  Function for writing data
     );
 
+    /**Write a datagram to a specific remote.
+       The remote address set with SetRemoteAddress() is not changed, so this
+       may be used on a transport shared by several threads, e.g. the cached
+       transports of an OpalListenerUDP with receive threads.
+      */
+    bool WriteTo(
+      const void * buf,                     ///< Data to write
+      PINDEX len,                           ///< Length of data
+      const OpalTransportAddress & address  ///< Remote to write to
+    );
+
     /**Set the size of UDP packet reads.
       */
     void SetBufferSize(
@@ -1483,9 +1543,25 @@ class OpalListenerTLS : public OpalListenerTCP
     ) const;
 
   protected:
+    /**Called when a TCP connection is accepted.
+       If the listener is in SpawnNewThreadMode, the TLS handshake, via
+       OnHandshake(), is queued to the shared handshake thread pool and NULL
+       is returned, so the listener thread never blocks on it. The transport
+       is then dispatched from that pool. For other modes OnHandshake() is
+       called directly.
+      */
     virtual OpalTransport * OnAccept(PTCPSocket * socket);
 
-    PSSLContext * m_sslContext;
+    /**Perform the TLS server handshake on the accepted socket.
+      */
+    virtual OpalTransport * OnHandshake(PTCPSocket * socket);
+
+    // Queued handshakes refer to us, so the destructor waits for them
+    unsigned         m_pendingHandshakes;
+    PDECLARE_MUTEX(  m_handshakesMutex);
+    PSyncPoint       m_handshakesDone;
+
+  friend class OpalTLSAcceptWork;
 };
 
 
@@ -1495,7 +1571,8 @@ class OpalTransportTLS : public OpalTransportTCP
     public:
       OpalTransportTLS(
         OpalEndPoint & endpoint,    ///<  Endpoint object
-        PChannel * ssl
+        PChannel * ssl,
+        PSSLContext * context = NULL ///< Context from OpalEndPoint::UseSSLContext(), released on destruction
       );
 
       OpalTransportTLS(
@@ -1510,9 +1587,85 @@ class OpalTransportTLS : public OpalTransportTCP
 
       // Overrides
       virtual PBoolean IsCompatibleTransport(const OpalTransportAddress & address) const;
+
+      /**Connect to the remote address.
+         The TCP connection is made, then the TLS handshake is queued to the
+         shared handshake thread pool and true returned without waiting for
+         it. Until the handshake completes Write(), ReadPDU() and WritePDU()
+         wait for it, and fail if it did.
+        */
       virtual PBoolean Connect();
+      virtual PBoolean Write(const void * buf, PINDEX len);
+      virtual PBoolean ReadPDU(PBYTEArray & pdu);
+      virtual PBoolean WritePDU(const PBYTEArray & pdu);
       virtual const PCaselessString & GetProtoPrefix() const;
       virtual bool IsAuthenticated(const PString & domain) const;
+
+      /// Statistics for TLS handshakes by all transports in the process
+      struct HandshakeStatistics
+      {
+        HandshakeStatistics();
+
+        unsigned      m_accepted;     ///< Server handshakes completed
+        unsigned      m_connected;    ///< Client handshakes completed
+        unsigned      m_failed;       ///< Handshakes, of either kind, that failed
+        unsigned      m_timedOut;     ///< Failed handshakes that were abandoned or exceeded the timeout
+        unsigned      m_pending;      ///< Handshakes queued or in progress
+        PTimeInterval m_totalTime;    ///< Total time of completed handshakes, including queuing
+        PTimeInterval m_maximumTime;  ///< Longest completed handshake, including queuing
+      };
+
+      /**Get the statistics for TLS handshakes.
+        */
+      static HandshakeStatistics GetHandshakeStatistics();
+
+      /**Set the maximum number of TLS handshakes in progress at once.
+         Server and client handshakes are executed on two thread pools of
+         this size, so a reconnection storm is queued rather than all
+         competing for the CPU, and incoming connections cannot starve
+         outgoing ones. Default is 4 each.
+        */
+      static void SetMaxHandshakeThreads(
+        unsigned count,   ///< Maximum concurrent handshakes
+        bool server       ///< Set for accepted, rather than outgoing, connections
+      );
+
+      /**Set the maximum number of TLS handshakes in progress at once, for
+         both server and client handshakes.
+        */
+      static void SetMaxHandshakeThreads(
+        unsigned count    ///< Maximum concurrent handshakes
+      );
+
+      /**Get the time allowed for a TLS handshake.
+        */
+      static PTimeInterval GetHandshakeTimeout(
+        bool server       ///< Get for accepted, rather than outgoing, connections
+      );
+
+      /**Set the time allowed for a TLS handshake.
+         This includes the time queued waiting for a handshake thread, a
+         handshake that has waited that long is abandoned without starting.
+         It also limits each read and write during the handshake, so a peer
+         that stops responding cannot hold a handshake thread. Default is 10
+         seconds for server and 20 seconds for client handshakes.
+        */
+      static void SetHandshakeTimeout(
+        const PTimeInterval & timeout,  ///< Time allowed
+        bool server                     ///< Set for accepted, rather than outgoing, connections
+      );
+
+    protected:
+      /// Wait for a handshake queued by Connect(), returns false if it failed
+      bool WaitForHandshake();
+      void OnHandshakeComplete(PChannel * ssl, bool ok);
+
+      PSSLContext * m_sslContext;
+      bool          m_handshakePending;
+      PDECLARE_MUTEX(m_handshakeMutex);
+      PSyncPoint    m_handshakeDone;
+
+    friend class OpalTLSConnectWork;
 };
 
 
@@ -1578,7 +1731,7 @@ public:
   virtual const PCaselessString & GetProtoPrefix() const;
 
 protected:
-  virtual OpalTransport * OnAccept(PTCPSocket * socket);
+  virtual OpalTransport * OnHandshake(PTCPSocket * socket);
 };
 
 
@@ -1640,7 +1793,8 @@ public:
     );
   OpalTransportWSS(
     OpalEndPoint & endpoint,    ///<  Endpoint object
-    PChannel * socket           ///<  Socket to use
+    PChannel * socket,          ///<  Socket to use
+    PSSLContext * context = NULL ///< Context from OpalEndPoint::UseSSLContext(), released on destruction
     );
 
   /**Connect to the remote address.
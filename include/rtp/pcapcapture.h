@@ -0,0 +1,218 @@
+/*
+ * pcapcapture.h
+ *
+ * Capture of media transport packets to rotating PCAP files
+ *
+ * Open Phone Abstraction Library (OPAL)
+ *
+ * Copyright (C) 2017 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida
+ *
+ * All Rights Reserved.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#ifndef OPAL_RTP_PCAPCAPTURE_H
+#define OPAL_RTP_PCAPCAPTURE_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include <rtp/pcapfile.h>
+
+#include <list>
+
+
+class OpalConnection;
+
+
+/**Capture of packets sent and received by media transports.
+   Transports of calls matching one of the triggers copy each packet, or just
+   the first part of it, into one of a small set of lock free rings. The
+   capturing thread never blocks, if a ring is full the packet is counted as
+   dropped. A background thread drains the rings into PCAP files which are
+   rotated by size and age, keeping at most a fixed number of files.
+
+   Capture is off until Start() is called.
+  */
+class OpalPCAPCapture : public PObject
+{
+    PCLASSINFO(OpalPCAPCapture, PObject);
+  public:
+    struct Params
+    {
+      Params()
+        : m_prefix("opal")
+        , m_snapLength(128)
+        , m_ringSize(16384)
+        , m_rings(8)
+        , m_maxFileSize(100*1024*1024)
+        , m_maxFileTime(0, 0, 10)
+        , m_maxFiles(10)
+        , m_flushInterval(250)
+      { }
+
+      PDirectory    m_directory;      ///< Directory for capture files
+      PString       m_prefix;         ///< Prefix for capture file names
+      PINDEX        m_snapLength;     ///< Bytes of each packet kept, zero is whole packet
+      unsigned      m_ringSize;       ///< Packets per ring, rounded up to power of two
+      unsigned      m_rings;          ///< Number of rings, spreads contention between threads
+      off_t         m_maxFileSize;    ///< Rotate file after this many bytes
+      PTimeInterval m_maxFileTime;    ///< Rotate file after this long
+      unsigned      m_maxFiles;       ///< Oldest files deleted beyond this many
+      PTimeInterval m_flushInterval;  ///< How often the writer drains the rings
+    };
+
+    struct Statistics
+    {
+      Statistics()
+        : m_captured(0)
+        , m_dropped(0)
+        , m_written(0)
+        , m_files(0)
+      { }
+
+      PUInt64  m_captured;  ///< Packets put in rings
+      PUInt64  m_dropped;   ///< Packets lost as ring was full
+      PUInt64  m_written;   ///< Packets written to files
+      unsigned m_files;     ///< Files created
+    };
+
+    OpalPCAPCapture();
+    ~OpalPCAPCapture();
+
+    /**Start capturing.
+       If the snap length, ring size or ring count differ from the last call,
+       new rings are used. The old ones are kept until this object is
+       destroyed, as a transport may still be putting a packet in them.
+      */
+    bool Start(
+      const Params & params
+    );
+
+    /**Stop capturing, writing everything still in the rings.
+      */
+    void Stop();
+
+    /**Indicate capture is running.
+      */
+    bool IsRunning() const { return m_running; }
+
+    /**Add a trigger for calls to be captured.
+       The pattern is matched, without regard to case, as a sub-string of the
+       call token, the remote party URL or the local party URL.
+       So an AoR such as "sip:fred@example.com" captures calls to and from
+       fred. A pattern of "*" captures everything.
+      */
+    void AddTrigger(const PString & pattern);
+
+    /// Remove a trigger previously added.
+    void RemoveTrigger(const PString & pattern);
+
+    /// Remove all triggers.
+    void ClearTriggers();
+
+    /// Get the current triggers.
+    PStringSet GetTriggers() const;
+
+    /**Indicate the media for the connection should be captured.
+      */
+    bool IsTriggered(
+      const OpalConnection & connection
+    ) const;
+
+    /**Capture a packet.
+       This never blocks and takes no locks. The \p hint selects the ring, so
+       each transport should use something constant, e.g. its local port.
+      */
+    void Capture(
+      unsigned hint,
+      const PIPSocketAddressAndPort & src,
+      const PIPSocketAddressAndPort & dst,
+      const void * data,
+      PINDEX length
+    );
+
+    /// Get capture statistics.
+    Statistics GetStatistics() const;
+
+  protected:
+    struct Slot
+    {
+      PInt64 m_time;
+      BYTE   m_srcAddress[16];
+      BYTE   m_dstAddress[16];
+      WORD   m_srcPort;
+      WORD   m_dstPort;
+      BYTE   m_srcAddressSize;
+      BYTE   m_dstAddressSize;
+      WORD   m_captured;
+      WORD   m_length;
+    };
+
+    // Bounded multi-producer, single consumer queue of fixed size slots
+    struct Ring
+    {
+      Ring(unsigned size, PINDEX snapLength);
+      ~Ring();
+
+      bool Push(const PIPSocketAddressAndPort & src, const PIPSocketAddressAndPort & dst, const void * data, PINDEX length);
+      const Slot * Front(const BYTE * & data);
+      void Pop();
+
+      size_t           m_mask;
+      PINDEX           m_snapLength;
+      atomic<size_t> * m_sequences;
+      Slot           * m_slots;
+      BYTE           * m_data;
+      atomic<size_t>   m_enqueuePosition;
+      size_t           m_dequeuePosition;
+      atomic<PUInt64>  m_dropped;
+    };
+
+    typedef std::vector<Ring *> Rings;
+
+    void WriterMain();
+    void Drain();
+    bool Rotate();
+
+    Params              m_params;
+    atomic<bool>        m_running;
+    atomic<Rings *>     m_rings;
+    std::list<Rings *>  m_retiredRings;
+
+    mutable PMutex      m_triggerMutex;
+    PStringSet          m_triggers;
+
+    PThread           * m_writerThread;
+    PSyncPoint          m_wakeWriter;
+    OpalPCAPFile        m_file;
+    PTime               m_fileOpened;
+    unsigned            m_fileSequence;
+    PStringList         m_files;
+
+    off_t               m_fileSize;
+    PUInt64             m_written;
+    unsigned            m_filesCreated;
+};
+
+
+#endif // OPAL_RTP_PCAPCAPTURE_H
+
+
+// End Of File ///////////////////////////////////////////////////////////////
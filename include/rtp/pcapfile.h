@@ -42,20 +42,48 @@ class OpalTranscoder;
 
 
 /**Class for a reading RTP from an Ethernet Capture (PCAP) file.
+   When opened for reading the file is memory mapped, if possible, so packets
+   are parsed directly from memory. DiscoverRTP() also builds an index of
+   every packet in each RTP stream, which then gives direct access to a
+   stream, and to a time within it, without scanning the rest of the file.
  */
 class OpalPCAPFile : public PFile
 {
     PCLASSINFO(OpalPCAPFile, PFile);
   public:
     OpalPCAPFile();
+    ~OpalPCAPFile();
 
     bool Restart();
 
+    virtual bool Close();
+    virtual off_t GetPosition() const;
+    virtual bool SetPosition(off_t pos, FilePositionOrigin origin = Start);
+    virtual bool IsEndOfFile() const;
+
+    bool IsMemoryMapped() const { return m_mapBase != NULL; }
+
     void PrintOn(ostream & strm) const;
 
     bool WriteFrame(const PEthSocket::Frame & frame);
     bool WriteRTP(const RTP_DataFrame & rtp, WORD port = 5000);
 
+    /**Write a UDP packet, of which only the first \p captured bytes of the
+       \p length are kept, with the time it was captured. Records are
+       buffered so they reach the disk in large writes, FlushBuffer() writes
+       anything outstanding. Returns the number of bytes added to the file, or
+       zero on error.
+      */
+    PINDEX WriteUDP(
+      const PTime & when,
+      const PIPSocketAddressAndPort & src,
+      const PIPSocketAddressAndPort & dst,
+      const void * data,
+      PINDEX captured,
+      PINDEX length
+    );
+    bool FlushBuffer();
+
     int GetDataLink(PBYTEArray & payload);
     int GetIP(PBYTEArray & payload);
     int GetTCP(PBYTEArray & payload);
@@ -76,6 +104,11 @@ class OpalPCAPFile : public PFile
     };
     int GetDecodedRTP(RTP_DataFrame & decodedRTP, DecodeContext & context);
 
+    /**Move to the first packet at or after the time, in the stream selected
+       with SetFilters(). Only available after DiscoverRTP().
+      */
+    bool SeekTime(const PTime & when);
+
 
     const PTime & GetPacketTime() const { return m_rawPacket.GetTimestamp(); }
     const PIPSocket::Address & GetSrcIP() const { return m_packetSrc.GetAddress(); }
@@ -86,22 +119,22 @@ class OpalPCAPFile : public PFile
 
     void SetFilterSrcIP(
       const PIPSocket::Address & ip
-    ) { m_filterSrc.SetAddress(ip); }
+    ) { m_filterSrc.SetAddress(ip); m_activeIndex = NULL; }
     const PIPSocket::Address & GetFilterSrcIP() const { return m_filterSrc.GetAddress(); }
 
     void SetFilterDstIP(
       const PIPSocket::Address & ip
-    ) { m_filterDst.SetAddress(ip); }
+    ) { m_filterDst.SetAddress(ip); m_activeIndex = NULL; }
     const PIPSocket::Address & GetFilterDstIP() const { return m_filterDst.GetAddress(); }
 
     void SetFilterSrcPort(
       WORD port
-    ) { m_filterSrc.SetPort(port); }
+    ) { m_filterSrc.SetPort(port); m_activeIndex = NULL; }
     WORD GetFilterSrcPort() const { return m_filterSrc.GetPort(); }
 
     void SetFilterDstPort(
       WORD port
-    ) { m_filterDst.SetPort(port); }
+    ) { m_filterDst.SetPort(port); m_activeIndex = NULL; }
     WORD GetFilterDstPort() const { return m_filterDst.GetPort(); }
 
 
@@ -143,7 +176,15 @@ class OpalPCAPFile : public PFile
     };
     typedef PNotifierTemplate<Progress &> ProgressNotifier;
 
-    bool DiscoverRTP(DiscoveredRTP & discoveredRTP, const ProgressNotifier & progressNotifier = NULL);
+    /**Find all the RTP streams in the file.
+       If the file is memory mapped, it is split into chunks scanned in
+       parallel by up to \p threads threads, zero being one per processor.
+      */
+    bool DiscoverRTP(
+      DiscoveredRTP & discoveredRTP,
+      const ProgressNotifier & progressNotifier = NULL,
+      unsigned threads = 0
+    );
 
     bool SetFilters(
       const DiscoveredRTPInfo & discoveredRTP,
@@ -163,8 +204,48 @@ class OpalPCAPFile : public PFile
 
     OpalMediaFormat GetMediaFormat(const RTP_DataFrame & rtp) const;
 
+    /// Location of a packet in the file, and its capture time in microseconds
+    struct PacketIndexEntry
+    {
+      PUInt64  m_position;
+      PInt64   m_time;
+    };
+    typedef std::vector<PacketIndexEntry> PacketIndex;
+
+    class StreamCursor;
+
+    /**Open an independent read position on a stream found by DiscoverRTP().
+       Cursors do not use the file position, so when the file is memory mapped
+       different streams may be read and decoded concurrently, one cursor per
+       thread, as long as the file itself is not read at the same time.
+      */
+    bool OpenStream(
+      const DiscoveredRTPKey & stream,
+      StreamCursor & cursor
+    ) const;
+
+    /**Move the cursor to the first packet at or after the time.
+      */
+    bool SeekStream(
+      StreamCursor & cursor,
+      const PTime & when
+    ) const;
+
+    int GetRTP(StreamCursor & cursor, RTP_DataFrame & rtp);
+    int GetDecodedRTP(StreamCursor & cursor, RTP_DataFrame & decodedRTP, DecodeContext & context);
+
   protected:
     bool InternalOpen(OpenMode mode, OpenOptions opt, PFileInfo::Permissions permissions);
+    bool ReadPacket();
+    int ExtractRTP(
+      PEthSocket::Frame & frame,
+      RTP_DataFrame & rtp,
+      PIPSocketAddressAndPort & src,
+      PIPSocketAddressAndPort & dst,
+      bool filter
+    ) const;
+    int InternalGetDecodedRTP(StreamCursor * cursor, RTP_DataFrame & decodedRTP, DecodeContext & context);
+    void Unmap();
 
     struct FileHeader { 
       DWORD magic_number;   /* magic number */
@@ -195,10 +276,25 @@ class OpalPCAPFile : public PFile
           PINDEX packetSize = P_MAX_INDEX
         );
 
+        bool Read(
+          const BYTE * base,
+          off_t size,
+          off_t & position
+        );
+
         bool m_otherEndian;
     };
     Frame m_rawPacket;
     PMutex m_writeMutex;
+    bool InternalFlushBuffer();
+
+    PEthSocket::Frame m_writeFrame;
+    PBYTEArray        m_writeBuffer;
+    PINDEX            m_writeBufferUsed;
+
+    const BYTE * m_mapBase;
+    off_t        m_mapSize;
+    off_t        m_mapPosition;
 
     PIPSocketAddressAndPort m_filterSrc;
     PIPSocketAddressAndPort m_filterDst;
@@ -210,6 +306,32 @@ class OpalPCAPFile : public PFile
 
     struct DiscoveryInfo;
     typedef std::map<DiscoveredRTPKey, DiscoveryInfo> DiscoveryMap;
+
+    struct DiscoveryChunk;
+    void DiscoverChunk(DiscoveryChunk * chunk);
+    bool IsRecordChain(off_t position) const;
+
+    typedef std::map<DiscoveredRTPKey, PacketIndex> StreamIndexMap;
+    StreamIndexMap      m_streamIndex;
+    const PacketIndex * m_activeIndex;
+    size_t              m_activePosition;
+
+  public:
+    class StreamCursor
+    {
+      public:
+        StreamCursor()
+          : m_index(NULL)
+          , m_position(0)
+        { }
+
+      protected:
+        const PacketIndex * m_index;
+        size_t              m_position;
+        Frame               m_frame;
+
+      friend class OpalPCAPFile;
+    };
 };
 
 
@@ -0,0 +1,144 @@
+/*
+ * rtp_bwe.h
+ *
+ * Send side bandwidth estimation for transport wide congestion control
+ *
+ * Open Phone Abstraction Library (OPAL)
+ *
+ * Copyright (C) 2017 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida
+ *
+ * All Rights Reserved.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#ifndef OPAL_RTP_RTP_BWE_H
+#define OPAL_RTP_RTP_BWE_H
+
+#ifdef P_USE_PRAGMA
+#pragma interface
+#endif
+
+#include <opal_config.h>
+
+#include <vector>
+
+
+/**Send side bandwidth estimation, loosely following draft-ietf-rmcat-gcc.
+   Packets are gathered into groups sent within a burst, the change in the
+   one way delay between groups is fed through a trendline filter and an
+   adaptive threshold over-use detector, which drives an AIMD rate controller.
+   A separate loss based controller from the same feedback sets an upper bound.
+
+   All times are passed in by the caller, so the estimator can be driven from
+   a packet trace as well as from live feedback.
+  */
+class RTP_BandwidthEstimator
+{
+  public:
+    enum {
+      MinBitRate     = 30000,
+      InitialBitRate = 300000,
+      MaxBitRate     = 30000000
+    };
+
+    RTP_BandwidthEstimator();
+
+    /// Get the current target bit rate for the sender
+    unsigned GetTargetBitRate() const;
+
+    /**Called for each acknowledged packet in a feedback, in sequence number order.
+       The \p sent time is local, the \p arrived time is the remote reference.
+      */
+    void OnPacketFeedback(
+      const PTimeInterval & sent,
+      const PTimeInterval & arrived,
+      unsigned size,
+      const PTimeInterval & now
+    );
+
+    /// Called once all packets in a feedback have been passed to OnPacketFeedback()
+    void OnFeedbackComplete(
+      unsigned received,
+      unsigned lost,
+      const PTimeInterval & now
+    );
+
+  protected:
+    enum UsageState {
+      e_Normal,
+      e_Underusing,
+      e_Overusing
+    };
+
+    enum {
+      BurstTimeMicroSeconds = 5000,
+      TrendlineWindow = 20,
+      TrendlineMaxDeltas = 60
+    };
+
+    void Reset();
+    void OnGroupDelta(double sendDelta, double arrivalDelta, const PTimeInterval & arrived, const PTimeInterval & now);
+    double GetSlope() const;
+    void Detect(double trend, double sendDelta);
+    void UpdateThreshold(double trend, const PTimeInterval & now);
+
+    // Current group of packets and the previous complete group
+    struct Group
+    {
+      Group() : m_valid(false) { }
+      bool          m_valid;
+      PTimeInterval m_firstSent;
+      PTimeInterval m_lastSent;
+      PTimeInterval m_lastArrival;
+    };
+    Group m_currentGroup;
+    Group m_previousGroup;
+
+    // Trendline filter
+    double m_accumulatedDelay;
+    double m_smoothedDelay;
+    double m_previousTrend;
+    unsigned m_numDeltas;
+    PTimeInterval m_firstArrival;
+    std::vector< std::pair<double, double> > m_history;
+    size_t m_historyIndex;
+
+    // Over-use detector
+    UsageState m_usage;
+    double m_threshold;
+    double m_timeOverUsing;
+    unsigned m_overuseCounter;
+    PTimeInterval m_lastThresholdUpdate;
+
+    // Rate controllers
+    double m_delayBasedRate;
+    double m_lossBasedRate;
+    double m_ackedRate;
+    PTimeInterval m_lastRateUpdate;
+    PTimeInterval m_lastLossIncrease;
+
+    // Acknowledged data in current feedback
+    unsigned m_feedbackBytes;
+    PTimeInterval m_feedbackFirstArrival;
+    PTimeInterval m_feedbackLastArrival;
+};
+
+
+#endif // OPAL_RTP_RTP_BWE_H
+
+// End Of File ///////////////////////////////////////////////////////////////
@@ -47,6 +47,7 @@
 #include <ptclib/url.h>
 
 #include <list>
+#include <queue>
 
 
 class OpalRTPEndPoint;
@@ -70,6 +71,15 @@ class RTP_MetricsReport;
   */
 #define OPAL_OPT_TRANSPORT_WIDE_CONGESTION_CONTROL "Transport-Wide-Congestion-Control"
 
+/**OpalConnection::StringOption key to an integer indicating that, when media
+   bypass is in effect between two plain RTP sessions, received packets are
+   relayed directly from one transport to the other. Only the SSRC, sequence
+   number and timestamp are rewritten, and receive/send statistics are only
+   updated every this many packets. Zero disables the relay, and media pass
+   through uses the normal media stream path. Default zero.
+  */
+#define OPAL_OPT_RTP_RELAY "RTP-Relay"
+
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -654,6 +664,36 @@ class OpalRTPSession : public OpalMediaSession
 
     bool HasFeedback(OpalMediaFormat::RTCPFeedback feature) const { return m_feedback&feature; }
 
+    /**Set direct relay of received RTP data packets to another session.
+       Packets read from this sessions transport are written straight to the
+       targets transport on the receiving thread, with the SSRC, sequence
+       number and timestamp rewritten to continue the targets sender stream.
+       The payload type is mapped from \p payloadType to \p targetPayloadType,
+       as are the RFC 2198 redundancy and RFC 5109 FEC payload types of the two
+       sessions, any other payload type takes the normal path, numbered in
+       the same sequence as the relayed packets. Header
+       extensions are renumbered to the targets identifiers for the same URI,
+       those the target did not negotiate, and the hop by hop absolute send
+       time and transport wide sequence number, are replaced with padding.
+       If \p payloadType is RTP_DataFrame::IllegalPayloadType, payload types
+       are passed through unchanged.
+
+       No jitter buffer, media patch or per packet statistics are involved,
+       the SyncSource statistics are updated every \p statisticsSample
+       packets. RTCP is not relayed, each session continues to do its own.
+
+       A NULL \p target stops relaying.
+      */
+    bool SetRelay(
+      OpalRTPSession * target,        ///< Session to relay data to
+      unsigned statisticsSample = 64, ///< Packets between statistics updates
+      RTP_DataFrame::PayloadTypes payloadType = RTP_DataFrame::IllegalPayloadType,      ///< Payload type received
+      RTP_DataFrame::PayloadTypes targetPayloadType = RTP_DataFrame::IllegalPayloadType ///< Payload type sent by target
+    );
+
+    /// Indicate relaying received data directly to another session.
+    bool IsRelaying() const { return m_relayTransport != NULL; }
+
   protected:
     virtual OpalMediaTransport * CreateMediaTransport(const PString & name);
     void InternalAttachTransport(const OpalMediaTransportPtr & transport PTRACE_PARAM(, const char * from));
@@ -663,6 +703,18 @@ class OpalRTPSession : public OpalMediaSession
     PDECLARE_MediaReadNotifier(OpalRTPSession, OnRxDataPacket);
     PDECLARE_MediaReadNotifier(OpalRTPSession, OnRxControlPacket);
     void CheckMediaFailed(SubChannels subchannel);
+    bool RelayDataPacket(PBYTEArray & data);
+    void RelayHeaderExtensions(BYTE * ptr, PINDEX size, bool twoByte);
+    void AddRelayStatistics(
+      RTP_SyncSourceId ssrc,
+      Direction dir,
+      unsigned packets,
+      uint64_t octets
+    );
+    void AttachRelayedSource(const SyncSource & sender);
+    void DetachRelayedSource();
+    void MapRelayedPacket(bool newSource, RTP_SequenceNumber & sequenceNumber, RTP_Timestamp & timestamp);
+    RTP_SequenceNumber NextRelayedSequenceNumber(unsigned discontinuity, RTP_Timestamp timestamp);
 
     OpalRTPEndPoint   & m_endpoint;
     OpalManager       & m_manager;
@@ -867,12 +919,55 @@ class OpalRTPSession : public OpalMediaSession
     // Congestion control
     OpalMediaTransport::CongestionControl * GetCongestionControl();
 
+    /* Video bursts held back by the pacer, sent from a timer so the media
+       thread writing the frame never sleeps. */
+    struct PacedFrame
+    {
+      PacedFrame(const RTP_DataFrame & frame, RewriteMode rewrite, const PIPSocketAddressAndPort * remote, const PTimeInterval & due);
+      RTP_DataFrame           m_frame;
+      RewriteMode             m_rewrite;
+      PIPSocketAddressAndPort m_remote;
+      PTimeInterval           m_due;
+    };
+    std::queue<PacedFrame> m_pacedFrames;
+    PDECLARE_MUTEX(m_pacerMutex);
+    PTimer m_pacerTimer;
+    bool     m_pacerDropping;       // Discarding the rest of a video frame the pacer could not hold
+    unsigned m_pacerDroppedPackets;
+    PDECLARE_NOTIFIER(PTimer, OpalRTPSession, TimedSendPaced);
+    SendReceiveStatus InternalWriteData(RTP_DataFrame & frame, RewriteMode rewrite, const PIPSocketAddressAndPort * remote);
+
     // Quality of service support
     PIPSocket::QoS m_qos;
     unsigned       m_packetOverhead;
     WORD           m_remoteControlPort;
     bool           m_sendEstablished;
 
+    // Direct relay to another session
+    PDECLARE_MUTEX(m_relayMutex);
+    OpalMediaTransportPtr m_relayTransport;
+    PSafePtr<OpalRTPSession> m_relaySession;
+    RTP_SyncSourceId      m_relaySourceIn;
+    RTP_SyncSourceId      m_relaySourceOut;
+    bool                  m_relayOffsetsSet;
+    unsigned              m_relayStatisticsSample;
+    BYTE                  m_relayPayloadTypes[RTP_DataFrame::MaxPayloadType+1]; // IllegalPayloadType if not relayed
+    BYTE                  m_relayExtensionIds[256]; // Zero to replace with padding
+    unsigned              m_relayPendingPackets;
+    uint64_t              m_relayPendingOctets;
+
+    /* The sender sequence of this session while others relay into it. Both
+       the relay and the normal path, e.g. for a payload type the relay does
+       not map, number their packets from here, so neither reuses or skips
+       sequence numbers, and a new relay source follows on from either. */
+    PDECLARE_MUTEX(m_relayedMutex);
+    atomic<unsigned>      m_relayedSources;
+    RTP_SyncSourceId      m_relayedSSRC;
+    RTP_SequenceNumber    m_relayedSequenceOffset;
+    RTP_Timestamp         m_relayedTimestampOffset;
+    RTP_SequenceNumber    m_relayedLastSequenceNumber;
+    RTP_Timestamp         m_relayedLastTimestamp;
+
     // Call backs for transport data
     OpalMediaTransport::ReadNotifier m_dataNotifier;
     OpalMediaTransport::ReadNotifier m_controlNotifier;
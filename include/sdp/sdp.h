@@ -114,6 +114,7 @@ class SDPBandwidth : public std::map<PCaselessString, OpalBandwidth>
 /////////////////////////////////////////////////////////
 
 class SDPMediaDescription;
+class SDPLineTokenizer;
 
 class SDPMediaFormat : public PObject
 {
@@ -668,6 +669,7 @@ class SDPSessionDescription : public PObject, public SDPCommonAttributes
     OpalMediaFormatList GetMediaFormats() const;
 
   protected:
+    bool InternalDecode(SDPLineTokenizer & tokenizer, const OpalMediaFormatList & mediaFormats);
     void ParseOwner(const PString & str);
 
     SDPMediaDescriptionArray mediaDescriptions;
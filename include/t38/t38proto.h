@@ -289,6 +289,70 @@ typedef OpalFaxConnection OpalT38Connection; // For backward compatibility
 
 class T38_UDPTLPacket;
 
+
+/**UDPTL packet encoded and decoded without the generic ASN.1 classes.
+   This covers the aligned PER forms that are sent in practice: no IFP of
+   16k or more, and at most MaxEntries secondary IFPs or FEC data entries.
+   Decoding leaves the IFPs pointing into the datagram, so nothing is
+   allocated or copied. Anything outside these forms fails, and the caller
+   should fall back to T38_UDPTLPacket.
+  */
+class OpalUDPTLPacket : public PObject
+{
+    PCLASSINFO(OpalUDPTLPacket, PObject);
+  public:
+    enum { MaxEntries = 32 };
+
+    struct IFP
+    {
+      IFP(const BYTE * data = NULL, PINDEX size = 0) : m_data(data), m_size(size) { }
+
+      const BYTE * m_data;
+      PINDEX       m_size;
+    };
+
+    OpalUDPTLPacket();
+
+    virtual void PrintOn(ostream & strm) const;
+
+    /**Decode the datagram.
+       Returns false if malformed, or not one of the forms handled.
+      */
+    bool Decode(
+      const BYTE * data,
+      PINDEX size
+    );
+
+    /**Get the size Encode() needs, zero if not one of the forms handled.
+      */
+    PINDEX GetEncodedSize() const;
+
+    /**Encode the packet into \p buffer.
+       Returns the number of bytes used, zero if the buffer is too small or
+       not one of the forms handled.
+      */
+    PINDEX Encode(
+      BYTE * buffer,
+      PINDEX size
+    ) const;
+
+    /**Set from a packet decoded by the generic ASN.1 classes.
+       The IFPs point into \p asn, which must outlive this object.
+       Returns false if there are too many entries.
+      */
+    bool SetFromASN(
+      const T38_UDPTLPacket & asn
+    );
+
+    WORD     m_sequenceNumber;
+    IFP      m_primary;
+    bool     m_fec;                   ///< Error recovery is FEC, otherwise secondary IFPs
+    unsigned m_fecPackets;            ///< Packets covered by FEC
+    PINDEX   m_count;                 ///< Number of secondary IFPs or FEC data entries
+    IFP      m_entries[MaxEntries];   ///< Secondary IFPs, most recent first, or FEC data
+};
+
+
 class OpalFaxSession : public OpalMediaSession
 {
   public:
@@ -316,7 +380,8 @@ class OpalFaxSession : public OpalMediaSession
     virtual void GetStatistics(OpalMediaStatistics & statistics, bool receiver) const;
 
   protected:
-    void SetFrameFromIFP(RTP_DataFrame & frame, const PASN_OctetString & ifp, unsigned sequenceNumber);
+    void SetFrameFromIFP(RTP_DataFrame & frame, const OpalUDPTLPacket::IFP & ifp, unsigned sequenceNumber);
+    bool DecodeUDPTL(bool & usedASN);
     void DecrementSentPacketRedundancy(bool stripRedundancy);
     bool WriteUDPTL();
 
@@ -328,7 +393,9 @@ class OpalFaxSession : public OpalMediaSession
 
     int                m_consecutiveBadPackets;
     bool               m_awaitingGoodPacket;
-    T38_UDPTLPacket  * m_receivedPacket;
+    PBYTEArray         m_receivedData;
+    OpalUDPTLPacket    m_receivedPacket;
+    T38_UDPTLPacket  * m_receivedASN;     // Only used for forms OpalUDPTLPacket does not handle
     unsigned           m_expectedSequenceNumber;
     int                m_secondaryPacket;
 
@@ -337,7 +404,17 @@ class OpalFaxSession : public OpalMediaSession
     PTimeInterval      m_keepAliveInterval;
     bool               m_optimiseOnRetransmit;
     std::vector<int>   m_sentPacketRedundancy;
-    T38_UDPTLPacket  * m_sentPacket;
+
+    struct SentIFP
+    {
+      SentIFP() : m_size(0) { }
+      PBYTEArray m_data;
+      PINDEX     m_size;
+    };
+    std::vector<SentIFP> m_sentIFPs;   // Primary then secondary IFPs, buffers are reused
+    PINDEX             m_sentCount;
+    WORD               m_sentSequenceNumber;
+    PBYTEArray         m_sentData;
     PDECLARE_MUTEX(m_writeMutex);
     PTimer             m_timerWriteDataIdle;
     PDECLARE_NOTIFIER(PTimer,  OpalFaxSession, OnWriteDataIdle);
@@ -132,11 +132,13 @@ SOURCES += $(OPAL_SRCDIR)/opal/manager.cxx \
            $(OPAL_SRCDIR)/opal/guid.cxx \
            $(OPAL_SRCDIR)/rtp/rtp.cxx \
            $(OPAL_SRCDIR)/rtp/rtp_session.cxx \
+           $(OPAL_SRCDIR)/rtp/rtp_bwe.cxx \
            $(OPAL_SRCDIR)/rtp/rtp_stream.cxx \
            $(OPAL_SRCDIR)/rtp/rtp_fec.cxx \
            $(OPAL_SRCDIR)/rtp/jitter.cxx \
            $(OPAL_SRCDIR)/rtp/metrics.cxx \
            $(OPAL_SRCDIR)/rtp/pcapfile.cxx \
+           $(OPAL_SRCDIR)/rtp/pcapcapture.cxx \
            $(OPAL_SRCDIR)/rtp/rtpep.cxx \
            $(OPAL_SRCDIR)/rtp/rtpconn.cxx \
            $(OPAL_SRCDIR)/ep/localep.cxx \
@@ -423,6 +425,7 @@ SOURCES += $(OPAL_SRCDIR)/codec/g711codec.cxx \
            $(OPAL_SRCDIR)/codec/rfc2833.cxx \
            $(OPAL_SRCDIR)/codec/opalwavfile.cxx \
            $(OPAL_SRCDIR)/codec/silencedetect.cxx \
+           $(OPAL_SRCDIR)/codec/tonedetect.cxx \
            $(OPAL_SRCDIR)/codec/opalpluginmgr.cxx
 
 ifeq ($(OPAL_VIDEO), yes)
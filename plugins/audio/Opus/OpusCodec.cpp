@@ -38,6 +38,7 @@
 #include "opus.h"
 
 #include <vector>
+#include <algorithm>
 
 #ifdef _MSC_VER
 #pragma warning(disable:4505)
@@ -194,6 +195,19 @@ static struct PluginCodec_Option const Complexity =
   "Complexity",
   false,
   PluginCodec_NoMerge,
+  "5",
+  NULL,
+  NULL,
+  0,
+  "0","10"
+};
+
+static struct PluginCodec_Option const LowRateComplexity =
+{
+  PluginCodec_IntegerOption,
+  "Low Rate Complexity",
+  false,
+  PluginCodec_NoMerge,
   "9",
   NULL,
   NULL,
@@ -212,6 +226,7 @@ static struct PluginCodec_Option const * const MyOptions[] = {
   &MaxAverageBitRate,
   &DynamicPacketLoss,
   &Complexity,
+  &LowRateComplexity,
   NULL
 };
 
@@ -366,8 +381,22 @@ class OpusPluginEncoder : public OpusPluginCodec
     OpusEncoder * m_encoder;
     unsigned      m_dynamicPacketLoss;
     bool          m_useDTX;
+    bool          m_constantBitRate;
     unsigned      m_bitRate;
+    unsigned      m_maxPlaybackRate;
     opus_int32    m_complexity;
+    opus_int32    m_lowRateComplexity;
+    bool          m_lowRate;
+
+    /* Below about 12.5kb/s the SILK layer gains a lot from extra complexity,
+       above it the gain is small, so only spend the CPU where it matters. The
+       bit rate is driven by TMMBR/REMB, so use some hysteresis. The default
+       Complexity is therefore moderate and the Low Rate Complexity high, see
+       samples/test/opuscplx for the cost of each. */
+    enum {
+      ComplexityThreshold = 12500,
+      ComplexityHysteresis = 1500
+    };
 
   public:
     OpusPluginEncoder(const PluginCodec_Definition * defn)
@@ -375,8 +404,12 @@ class OpusPluginEncoder : public OpusPluginCodec
       , m_encoder(NULL)
       , m_dynamicPacketLoss(0)
       , m_useDTX(false)
+      , m_constantBitRate(false)
       , m_bitRate(12000)
+      , m_maxPlaybackRate(MAX_SAMPLE_RATE)
       , m_complexity(0)
+      , m_lowRateComplexity(9)
+      , m_lowRate(false)
     {
       PTRACE(4, MY_CODEC_LOG, "Encoder created: version \"" << opus_get_version_string() << '"');
     }
@@ -418,6 +451,15 @@ class OpusPluginEncoder : public OpusPluginCodec
       if (strcasecmp(optionName, Complexity.m_name) == 0)
           return SetOptionUnsigned(m_complexity, optionValue, 0, 10);
 
+      if (strcasecmp(optionName, LowRateComplexity.m_name) == 0)
+          return SetOptionUnsigned(m_lowRateComplexity, optionValue, 0, 10);
+
+      if (strcasecmp(optionName, ConstantBitRate.m_name) == 0)
+        return SetOptionBoolean(m_constantBitRate, optionValue);
+
+      if (strcasecmp(optionName, MaxPlaybackRate.m_name) == 0)
+        return SetOptionUnsigned(m_maxPlaybackRate, optionValue, MIN_SAMPLE_RATE, MAX_SAMPLE_RATE);
+
       // Base class sets bit rate and frame time
       return OpusPluginCodec::SetOption(optionName, optionValue);
     }
@@ -428,22 +470,48 @@ class OpusPluginEncoder : public OpusPluginCodec
       if (m_encoder == NULL)
         return false;
 
-      //opus_encoder_ctl(m_encoder, OPUS_SET_MAX_BANDWIDTH(m_definition->sampleRate));
+      if (m_bitRate < ComplexityThreshold - ComplexityHysteresis)
+        m_lowRate = true;
+      else if (m_bitRate > ComplexityThreshold + ComplexityHysteresis)
+        m_lowRate = false;
+      opus_int32 complexity = m_lowRate ? std::max(m_complexity, m_lowRateComplexity) : m_complexity;
+
+      // No point encoding audio bandwidth the far end is going to discard
+      opus_int32 bandwidth = GetMaxBandwidth(std::min(m_sampleRate, m_maxPlaybackRate));
+
+      opus_encoder_ctl(m_encoder, OPUS_SET_MAX_BANDWIDTH(bandwidth));
       opus_encoder_ctl(m_encoder, OPUS_SET_INBAND_FEC(m_useInBandFEC));
       opus_encoder_ctl(m_encoder, OPUS_SET_PACKET_LOSS_PERC(m_dynamicPacketLoss));
       opus_encoder_ctl(m_encoder, OPUS_SET_DTX(m_useDTX));
+      opus_encoder_ctl(m_encoder, OPUS_SET_VBR(!m_constantBitRate));
       opus_encoder_ctl(m_encoder, OPUS_SET_BITRATE(m_bitRate));
-      opus_encoder_ctl(m_encoder, OPUS_SET_COMPLEXITY(m_complexity));
+      opus_encoder_ctl(m_encoder, OPUS_SET_COMPLEXITY(complexity));
       PTRACE(4, MY_CODEC_LOG, "Encoder options set:"
                               " fec=" << std::boolalpha << m_useInBandFEC << ","
                               " pkt-loss=" << m_dynamicPacketLoss << "%,"
                               " dtx=" << m_useDTX << ","
+                              " cbr=" << m_constantBitRate << ","
                               " bitrate=" << m_bitRate << ","
-                              " complexity=" << m_complexity);
+                              " max-playback=" << m_maxPlaybackRate << ","
+                              " complexity=" << complexity);
       return true;
     }
 
 
+    static opus_int32 GetMaxBandwidth(unsigned sampleRate)
+    {
+      if (sampleRate <= 8000)
+        return OPUS_BANDWIDTH_NARROWBAND;
+      if (sampleRate <= 12000)
+        return OPUS_BANDWIDTH_MEDIUMBAND;
+      if (sampleRate <= 16000)
+        return OPUS_BANDWIDTH_WIDEBAND;
+      if (sampleRate <= 24000)
+        return OPUS_BANDWIDTH_SUPERWIDEBAND;
+      return OPUS_BANDWIDTH_FULLBAND;
+    }
+
+
     virtual bool Transcode(const void * fromPtr,
                              unsigned & fromLen,
                                  void * toPtr,
@@ -29,6 +29,7 @@
 #include <vector>
 #include <queue>
 #include <map>
+#include <algorithm>
 
 
 #if defined(_WIN32) || defined(_WIN32_WCE)
@@ -42,6 +43,7 @@
 #else
   #include <unistd.h>
   #include <pthread.h>
+  #include <time.h>
   #define DIR_SEPERATORS "/"
 #endif
 
@@ -67,6 +69,12 @@ extern "C" {
 #define   PREF_FRAMES_PER_PACKET    1
 #define   MAX_FRAMES_PER_PACKET     1
 
+#define   GATEWAY_THREADS_ENV       "SPANDSP_GATEWAY_THREADS"
+#define   GATEWAY_MAX_BUFFERED      8000  // One second of samples, or bytes of IFPs
+#define   GATEWAY_STALLED           5     // Frames late before a worker pass is reported
+#define   GATEWAY_JITTER_TARGET     (2*SAMPLES_PER_FRAME) // Initial audio kept ahead of the media thread
+#define   GATEWAY_JITTER_MAX        (6*SAMPLES_PER_FRAME) // Limit on growing it after underruns
+
 
 #if LOGGING
 
@@ -706,10 +714,13 @@ class FaxT38
       if (payloadSize == 0)
         return true;
 
-      return t38_core_rx_ifp_packet(m_t38core,
-                                    PluginCodec_RTP_GetPayloadPtr(fromPtr),
-                                    payloadSize,
-                                    PluginCodec_RTP_GetSequenceNumber(fromPtr)) != -1;
+      return DecodeIFP(PluginCodec_RTP_GetPayloadPtr(fromPtr), payloadSize, PluginCodec_RTP_GetSequenceNumber(fromPtr));
+    }
+
+
+    bool DecodeIFP(const uint8_t * ifp, int len, uint16_t seq)
+    {
+      return m_t38core != NULL && t38_core_rx_ifp_packet(m_t38core, ifp, len, seq) != -1;
     }
 
 
@@ -1017,6 +1028,200 @@ class FaxTIFF : public FaxSpanDSP
 };
 
 
+/////////////////////////////////////////////////////////////////
+
+// Gateway mode, many T38_PCM instances share a few worker threads
+
+class T38_PCM;
+
+static unsigned GetMilliseconds()
+{
+#ifdef _WIN32
+  return GetTickCount();
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned)(ts.tv_sec*1000 + ts.tv_nsec/1000000);
+#endif
+}
+
+
+static void SleepMilliseconds(unsigned ms)
+{
+#ifdef _WIN32
+  Sleep(ms);
+#else
+  usleep(ms*1000);
+#endif
+}
+
+
+class GatewayWorker
+{
+  private:
+    CriticalSection        m_mutex;          // Held for a whole pass over m_gateways
+    std::vector<T38_PCM *> m_gateways;
+    CriticalSection        m_pendingMutex;   // Never held while taking another lock
+    std::vector<T38_PCM *> m_pending;
+    unsigned               m_count;
+    bool                   m_running;
+    bool                   m_shutdown;
+#ifdef _WIN32
+    HANDLE                 m_thread;
+#else
+    pthread_t              m_thread;
+#endif
+    bool                   m_joinable;
+
+  public:
+    GatewayWorker()
+      : m_count(0)
+      , m_running(false)
+      , m_shutdown(false)
+      , m_joinable(false)
+    {
+    }
+
+
+    // Called as the plugin is unloaded, so no thread outlives our code
+    ~GatewayWorker()
+    {
+      {
+        WaitAndSignal mutex(m_pendingMutex);
+        m_shutdown = true;
+      }
+      Join();
+    }
+
+
+    unsigned GetCount() const
+    {
+      WaitAndSignal mutex(m_pendingMutex);
+      return m_count;
+    }
+
+
+    /* Called with the gateway mutex held, so only takes m_pendingMutex. The
+       worker picks the gateway up on its next pass. */
+    void Add(T38_PCM * gateway)
+    {
+      WaitAndSignal mutex(m_pendingMutex);
+
+      m_pending.push_back(gateway);
+      ++m_count;
+
+      if (m_running)
+        return;
+
+      // Previous thread went idle, it takes no more locks, so cannot deadlock
+      Join();
+
+#ifdef _WIN32
+      m_thread = CreateThread(NULL, 0, &GatewayWorker::ThreadMain, this, 0, NULL);
+      m_joinable = m_thread != NULL;
+#else
+      m_joinable = pthread_create(&m_thread, NULL, &GatewayWorker::ThreadMain, this) == 0;
+#endif
+      m_running = m_joinable;
+      PTRACE(m_running ? 4 : 1, "Gateway worker " << (m_running ? "started" : "could not be started"));
+    }
+
+
+    // Waits for any pass in progress, so gateway may be deleted on return
+    void Remove(T38_PCM * gateway)
+    {
+      WaitAndSignal mutex(m_mutex);
+      WaitAndSignal pending(m_pendingMutex);
+
+      std::vector<T38_PCM *>::iterator it = std::find(m_gateways.begin(), m_gateways.end(), gateway);
+      if (it != m_gateways.end())
+        m_gateways.erase(it);
+      else {
+        it = std::find(m_pending.begin(), m_pending.end(), gateway);
+        if (it == m_pending.end())
+          return;
+        m_pending.erase(it);
+      }
+      --m_count;
+    }
+
+
+  private:
+    void Join()
+    {
+      if (!m_joinable)
+        return;
+
+#ifdef _WIN32
+      WaitForSingleObject(m_thread, INFINITE);
+      CloseHandle(m_thread);
+#else
+      pthread_join(m_thread, NULL);
+#endif
+      m_joinable = false;
+    }
+
+
+#ifdef _WIN32
+    static DWORD WINAPI ThreadMain(LPVOID arg)
+    {
+      ((GatewayWorker *)arg)->Main();
+      return 0;
+    }
+#else
+    static void * ThreadMain(void * arg)
+    {
+      ((GatewayWorker *)arg)->Main();
+      return NULL;
+    }
+#endif
+
+    void Main();
+};
+
+
+class GatewayPool
+{
+  private:
+    std::vector<GatewayWorker *> m_workers;
+
+  public:
+    GatewayPool()
+    {
+      const char * env = getenv(GATEWAY_THREADS_ENV);
+      int threads = env != NULL ? atoi(env) : 0;
+      for (int i = 0; i < threads; ++i)
+        m_workers.push_back(new GatewayWorker);
+    }
+
+    ~GatewayPool()
+    {
+      for (size_t i = 0; i < m_workers.size(); ++i)
+        delete m_workers[i];
+    }
+
+    bool IsEnabled() const { return !m_workers.empty(); }
+
+    GatewayWorker * Add(T38_PCM * gateway)
+    {
+      GatewayWorker * best = m_workers[0];
+      unsigned bestCount = best->GetCount();
+      for (size_t i = 1; i < m_workers.size() && bestCount > 0; ++i) {
+        unsigned count = m_workers[i]->GetCount();
+        if (count < bestCount) {
+          best = m_workers[i];
+          bestCount = count;
+        }
+      }
+
+      best->Add(gateway);
+      return best;
+    }
+};
+
+static GatewayPool TheGatewayPool;
+
+
 /////////////////////////////////////////////////////////////////
 
 class T38_PCM : public FaxSpanDSP, public FaxT38, public FaxPCM
@@ -1024,9 +1229,18 @@ class T38_PCM : public FaxSpanDSP, public FaxT38, public FaxPCM
   protected:
     t38_gateway_state_t * m_t38State;
 
+    // Only used in gateway mode, buffers between the patch threads and the worker
+    GatewayWorker       * m_worker;
+    std::vector<int16_t>  m_audioIn;
+    std::vector<int16_t>  m_audioOut;
+    size_t                m_audioOutTarget;
+    std::vector<uint8_t>  m_ifpIn;     // Records of length, sequence number, IFP
+
   public:
     T38_PCM(PTRACE_PARAM(const std::string &tag))
       : m_t38State(NULL)
+      , m_worker(NULL)
+      , m_audioOutTarget(GATEWAY_JITTER_TARGET)
     {
 #if LOGGING
       m_tag = tag;
@@ -1038,6 +1252,9 @@ class T38_PCM : public FaxSpanDSP, public FaxT38, public FaxPCM
 
     ~T38_PCM()
     {
+      if (m_worker != NULL)
+        m_worker->Remove(this);
+
       if (m_t38State != NULL) {
         t38_gateway_release(m_t38State);
         t38_gateway_free(m_t38State);
@@ -1057,12 +1274,24 @@ class T38_PCM : public FaxSpanDSP, public FaxT38, public FaxPCM
       if (!Open())
         return false;
 
-      int samplesLeft = t38_gateway_rx(m_t38State, (int16_t *)fromPtr, fromLen/2);
+      if (m_worker != NULL) {
+        // Worker does the modem, we just hand over the audio
+        const int16_t * samples = (const int16_t *)fromPtr;
+        if (m_audioIn.size() < GATEWAY_MAX_BUFFERED)
+          m_audioIn.insert(m_audioIn.end(), samples, samples + fromLen/2);
+        else {
+          PTRACE(2, m_tag << " T38_PCM::Encode: worker overrun, audio discarded");
+        }
+        fromLen -= fromLen%2;
+      }
+      else {
+        int samplesLeft = t38_gateway_rx(m_t38State, (int16_t *)fromPtr, fromLen/2);
 
-      if (samplesLeft < 0)
-        return false;
+        if (samplesLeft < 0)
+          return false;
 
-      fromLen -= samplesLeft*2;
+        fromLen -= samplesLeft*2;
+      }
 
       if (!FaxT38::EncodeRTP(toPtr, toLen, flags))
         return false;
@@ -1085,15 +1314,40 @@ class T38_PCM : public FaxSpanDSP, public FaxT38, public FaxPCM
       if (!Open())
         return false;
 
-      if (!FaxT38::DecodeRTP(fromPtr, fromLen))
-        return false;
+      if (m_worker != NULL) {
+        if (!QueueIFP(fromPtr, fromLen))
+          return false;
+
+        /* The worker refills what we take here, up to m_audioOutTarget, so
+           there is normally a whole frame. If it fell behind, fill with
+           silence rather than return nothing, which would stall the audio,
+           and have it keep a frame more ahead of us from now on. */
+        size_t wanted = toLen/2;
+        size_t samples = std::min(wanted, m_audioOut.size());
+        if (samples > 0) {
+          memcpy(toPtr, &m_audioOut[0], samples*2);
+          m_audioOut.erase(m_audioOut.begin(), m_audioOut.begin() + samples);
+        }
+        if (samples < wanted) {
+          if (m_audioOutTarget < GATEWAY_JITTER_MAX)
+            m_audioOutTarget += SAMPLES_PER_FRAME;
+          PTRACE(5, m_tag << " T38_PCM::Decode: worker underrun, " << (wanted - samples) << " samples of silence,"
+                             " target now " << m_audioOutTarget << " samples");
+          memset((int16_t *)toPtr + samples, 0, (wanted - samples)*2);
+        }
+        toLen = (unsigned)wanted*2;
+      }
+      else {
+        if (!FaxT38::DecodeRTP(fromPtr, fromLen))
+          return false;
 
-      int samplesGenerated = t38_gateway_tx(m_t38State, (int16_t *)toPtr, toLen/2);
+        int samplesGenerated = t38_gateway_tx(m_t38State, (int16_t *)toPtr, toLen/2);
 
-      if (samplesGenerated < 0)
-        return false;
+        if (samplesGenerated < 0)
+          return false;
 
-      toLen = samplesGenerated*2;
+        toLen = samplesGenerated*2;
+      }
 
       flags = PluginCodec_ReturnCoderLastFrame;
 
@@ -1124,6 +1378,48 @@ class T38_PCM : public FaxSpanDSP, public FaxT38, public FaxPCM
     }
 
 
+    /* Called by the gateway worker every frame time. All the audio received
+       since the last pass goes through the modem in one call, then exactly
+       as much audio as Decode() has taken is generated, to get back to
+       m_audioOutTarget ahead of it. The modem so runs at the rate the media
+       thread reads, not at the rate of our clock, and nothing is dropped. */
+    void Process()
+    {
+      WaitAndSignal mutex(m_mutex);
+
+      if (m_t38State == NULL || m_completed)
+        return;
+
+      if (!m_audioIn.empty()) {
+        int samplesLeft = t38_gateway_rx(m_t38State, &m_audioIn[0], (int)m_audioIn.size());
+        if (samplesLeft < 0 || (size_t)samplesLeft > m_audioIn.size())
+          samplesLeft = 0;
+        m_audioIn.erase(m_audioIn.begin(), m_audioIn.end() - samplesLeft);
+      }
+
+      size_t pos = 0;
+      while (pos + 4 <= m_ifpIn.size()) {
+        int len = (m_ifpIn[pos] << 8) | m_ifpIn[pos+1];
+        uint16_t seq = (uint16_t)((m_ifpIn[pos+2] << 8) | m_ifpIn[pos+3]);
+        pos += 4;
+        if (!FaxT38::DecodeIFP(&m_ifpIn[pos], len, seq)) {
+          PTRACE(2, m_tag << " T38_PCM::Process: IFP seq=" << seq << " rejected");
+        }
+        pos += len;
+      }
+      m_ifpIn.clear();
+
+      size_t used = m_audioOut.size();
+      if (used >= m_audioOutTarget)
+        return;
+
+      size_t wanted = m_audioOutTarget - used;
+      m_audioOut.resize(used + wanted);
+      int samplesGenerated = t38_gateway_tx(m_t38State, &m_audioOut[used], (int)wanted);
+      m_audioOut.resize(used + (samplesGenerated > 0 ? samplesGenerated : 0));
+    }
+
+
   protected:
     virtual bool SetOption(const char * option, const char * value)
     {
@@ -1140,6 +1436,33 @@ class T38_PCM : public FaxSpanDSP, public FaxT38, public FaxPCM
     }
 
 
+    bool QueueIFP(const void * fromPtr, unsigned fromLen)
+    {
+      int payloadSize = fromLen - PluginCodec_RTP_GetHeaderLength(fromPtr);
+      if (payloadSize < 0 || payloadSize > 0xffff)
+        return false;
+
+      if (payloadSize == 0)
+        return true;
+
+      uint16_t seq = PluginCodec_RTP_GetSequenceNumber(fromPtr);
+      size_t pos = m_ifpIn.size();
+      if (pos + 4 + payloadSize > GATEWAY_MAX_BUFFERED) {
+        // Worker not keeping up, as for audio, redundancy may recover it
+        PTRACE(2, m_tag << " T38_PCM::Decode: worker overrun, IFP seq=" << seq << " discarded");
+        return true;
+      }
+
+      m_ifpIn.resize(pos + 4 + payloadSize);
+      m_ifpIn[pos]   = (uint8_t)(payloadSize >> 8);
+      m_ifpIn[pos+1] = (uint8_t)payloadSize;
+      m_ifpIn[pos+2] = (uint8_t)(seq >> 8);
+      m_ifpIn[pos+3] = (uint8_t)seq;
+      memcpy(&m_ifpIn[pos+4], PluginCodec_RTP_GetPayloadPtr(fromPtr), payloadSize);
+      return true;
+    }
+
+
     bool Open()
     {
       if (m_completed)
@@ -1165,11 +1488,56 @@ class T38_PCM : public FaxSpanDSP, public FaxT38, public FaxPCM
       t38_gateway_set_ecm_capability(m_t38State, m_useECM);
       //t38_gateway_set_nsx_suppression(m_t38State, NULL, 0, NULL, 0);
 
+      if (TheGatewayPool.IsEnabled()) {
+        m_worker = TheGatewayPool.Add(this);
+        PTRACE(4, m_tag << " T38_PCM using shared gateway worker");
+      }
+
       return true;
     }
 };
 
 
+void GatewayWorker::Main()
+{
+  unsigned lastTick = GetMilliseconds();
+
+  for (;;) {
+    unsigned now = GetMilliseconds();
+    unsigned frames = (now - lastTick)/(MICROSECONDS_PER_FRAME/1000);
+    if (frames == 0) {
+      SleepMilliseconds(MICROSECONDS_PER_FRAME/1000 - (now - lastTick));
+      continue;
+    }
+
+    // Output is paced by Decode(), so a late pass just has more to refill
+    if (frames > GATEWAY_STALLED) {
+      PTRACE(2, "Gateway worker stalled for " << (now - lastTick) << "ms");
+      lastTick = now;
+    }
+    else
+      lastTick += frames*(MICROSECONDS_PER_FRAME/1000);
+
+    WaitAndSignal mutex(m_mutex);
+
+    {
+      WaitAndSignal pending(m_pendingMutex);
+      m_gateways.insert(m_gateways.end(), m_pending.begin(), m_pending.end());
+      m_pending.clear();
+      if (m_gateways.empty() || m_shutdown) {
+        // Idle, exit until the next call arrives
+        m_running = false;
+        PTRACE(4, "Gateway worker stopped");
+        return;
+      }
+    }
+
+    for (size_t i = 0; i < m_gateways.size(); ++i)
+      m_gateways[i]->Process();
+  }
+}
+
+
 /////////////////////////////////////////////////////////////////
 
 class TIFF_T38 : public FaxTIFF, public FaxT38
@@ -514,13 +514,22 @@ class VP8Encoder : public PluginVideoEncoder<VP8_CODEC>
                               " rc_buf_optimal_sz=" << m_config.rc_buf_optimal_sz << ","
                               " rc_undershoot_pct=" << m_config.rc_undershoot_pct);
 
-      if (m_config.g_w == m_width && m_config.g_h == m_height)
+      unsigned threads = m_threads > 0 ? m_threads : 1;
+      if (m_config.g_w == m_width && m_config.g_h == m_height && m_config.g_threads == threads)
         return !IS_ERROR(vpx_codec_enc_config_set, (&m_codec, &m_config));
 
       m_config.g_w = m_width;
       m_config.g_h = m_height;
+      m_config.g_threads = threads;
       vpx_codec_destroy(&m_codec);
-      return !IS_ERROR(vpx_codec_enc_init, (&m_codec, vpx_codec_vp8_cx(), &m_config, m_initFlags));
+      if (IS_ERROR(vpx_codec_enc_init, (&m_codec, vpx_codec_vp8_cx(), &m_config, m_initFlags)))
+        return false;
+
+      // Threads can only work on separate token partitions, so give them one each, up to the maximum of 8
+      int partitions = VP8_ONE_TOKENPARTITION;
+      while (partitions < VP8_EIGHT_TOKENPARTITION && (1U << partitions) < threads)
+        ++partitions;
+      return !IS_ERROR(vpx_codec_control_VP8E_SET_TOKEN_PARTITIONS, (&m_codec, VP8E_SET_TOKEN_PARTITIONS, partitions));
     }
 
 
@@ -783,6 +792,7 @@ class VP8Decoder : public PluginVideoDecoder<VP8_CODEC>
     bool                 m_intraFrame;
     bool                 m_ignoreTillKeyFrame;
     unsigned             m_consecutiveErrors;
+    unsigned             m_activeThreads;
 
   public:
     VP8Decoder(const PluginCodec_Definition * defn)
@@ -794,6 +804,7 @@ class VP8Decoder : public PluginVideoDecoder<VP8_CODEC>
       , m_intraFrame(false)
       , m_ignoreTillKeyFrame(false)
       , m_consecutiveErrors(0)
+      , m_activeThreads(0)
     {
       memset(&m_codec, 0, sizeof(m_codec));
       m_fullFrame.reserve(10000);
@@ -821,6 +832,28 @@ class VP8Decoder : public PluginVideoDecoder<VP8_CODEC>
     }
 
 
+    virtual bool OnChangedOptions()
+    {
+      if (m_threads == m_activeThreads)
+        return true;
+
+      // Thread count is only settable at initialisation time
+      vpx_codec_dec_cfg_t cfg;
+      memset(&cfg, 0, sizeof(cfg));
+      cfg.threads = m_threads;
+
+      vpx_codec_destroy(&m_codec);
+      if (IS_ERROR(vpx_codec_dec_init, (&m_codec, m_iface, &cfg, m_flags)))
+        return false;
+
+      PTRACE(4, MY_CODEC_LOG, "Decoder using " << m_threads << " threads");
+      m_activeThreads = m_threads;
+      m_firstFrame = true;
+      m_iterator = NULL;
+      return true;
+    }
+
+
     virtual int GetStatistics(char * bufferPtr, unsigned bufferSize)
     {
       size_t len = BaseClass::GetStatistics(bufferPtr, bufferSize);
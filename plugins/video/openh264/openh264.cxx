@@ -725,6 +725,8 @@ class H264_Encoder : public PluginVideoEncoder<MY_CODEC>
       param.fMaxFrameRate = (float)PLUGINCODEC_VIDEO_CLOCK/m_frameTime;
       param.uiIntraPeriod = m_keyFramePeriod;
       param.bPrefixNalAddingCtrl = false;
+      if (m_threads > 0)
+        param.iMultipleThreadIdc = (unsigned short)m_threads;
 
       param.sSpatialLayers[0].uiProfileIdc = m_profile;
       param.sSpatialLayers[0].uiLevelIdc = m_level;
@@ -741,7 +743,13 @@ class H264_Encoder : public PluginVideoEncoder<MY_CODEC>
           break;
 
         case 1 :
-          param.sSpatialLayers[0].sSliceCfg.uiSliceMode = SM_SINGLE_SLICE;
+          if (m_threads > 1) {
+            // Need a slice per thread for the encoder to actually use them
+            param.sSpatialLayers[0].sSliceCfg.uiSliceMode = SM_FIXEDSLCNUM_SLICE;
+            param.sSpatialLayers[0].sSliceCfg.sSliceArgument.uiSliceNum = m_threads;
+          }
+          else
+            param.sSpatialLayers[0].sSliceCfg.uiSliceMode = SM_SINGLE_SLICE;
           break;
 
         default :
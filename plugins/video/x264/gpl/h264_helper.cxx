@@ -54,7 +54,8 @@
 #include "../../common/dyna.cxx"
 
 
-static const unsigned Version = 1; // API version
+static const unsigned Version = 4; // API version
+static const unsigned PipeOnlyVersion = 1;
 
 
 #ifdef WIN32
@@ -193,6 +194,200 @@ void ResizeBuffer(size_t len)
 }
 
 
+#if X264_SHARED_MEMORY
+
+#include <sys/mman.h>
+#include <poll.h>
+
+int sharedFd = -1;
+int workFd = -1;
+int doneFd = -1;
+unsigned char * sharedPtr = NULL;
+size_t sharedSize = 0;
+
+
+bool MapSharedMemory()
+{
+  struct stat info;
+  if (fstat(sharedFd, &info) < 0) {
+    PTRACE(1, HelperTraceName, "Could not get shared memory size: " << strerror(errno));
+    return false;
+  }
+
+  if (sharedPtr != NULL) {
+    if ((size_t)info.st_size == sharedSize)
+      return true;
+    munmap(sharedPtr, sharedSize);
+    sharedPtr = NULL;
+  }
+
+  void * ptr = mmap(NULL, info.st_size, PROT_READ|PROT_WRITE, MAP_SHARED, sharedFd, 0);
+  if (ptr == MAP_FAILED) {
+    PTRACE(1, HelperTraceName, "Could not map shared memory: " << strerror(errno));
+    return false;
+  }
+
+  sharedPtr = (unsigned char *)ptr;
+  sharedSize = info.st_size;
+  PTRACE(4, HelperTraceName, "Mapped shared memory of " << sharedSize << " bytes");
+  return true;
+}
+
+
+void WakePlugin(X264SharedHeader * header)
+{
+  __atomic_add_fetch(&header->m_progress, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_exchange_n(&header->m_pluginWaiting, 0, __ATOMIC_SEQ_CST)) {
+    uint64_t one = 1;
+    if (write(doneFd, &one, sizeof(one)) < 0) {
+      PTRACE(1, HelperTraceName, "Error signalling plugin: " << strerror(errno));
+      exit(1);
+    }
+  }
+}
+
+
+void EncodeShared(X264SharedHeader * header, uint32_t frame)
+{
+  unsigned char * base = sharedPtr + X264_SHARED_ALIGN(sizeof(X264SharedHeader)) +
+                         (size_t)(frame % header->m_slotCount)*header->m_slotSize;
+  X264SharedSlot * slot = (X264SharedSlot *)base;
+  unsigned char * input = base + header->m_inputOffset;
+  unsigned char * output = base + header->m_outputOffset;
+  unsigned srcLen = slot->m_srcLen;
+  unsigned headerLen = slot->m_headerLen;
+  size_t maxPacket = X264_SHARED_ALIGN(sizeof(X264SharedPacket) + headerLen + rtpSize);
+
+  if (slot->m_accessUnit) {
+    /* The plugin packetises, so just the NAL units and an index of them, in
+       one go, as nothing can be sent until the index is complete anyway. */
+    uint32_t status = X264SlotFailed;
+    unsigned flags = slot->m_flags;
+    const unsigned char * data;
+    unsigned dataLen;
+    const PluginCodec_NALUnit * units;
+    unsigned unitCount;
+    if (x264.EncodeAccessUnit(input, srcLen, flags, data, dataLen, units, unitCount) > 0) {
+      size_t indexLen = sizeof(X264SharedAccessUnit) + unitCount*sizeof(PluginCodec_NALUnit);
+      if (sizeof(X264SharedPacket) + indexLen + dataLen > header->m_outputSize)
+        PTRACE(1, HelperTraceName, "Encoded access unit " << frame << " too large for shared memory");
+      else {
+        X264SharedPacket * packet = (X264SharedPacket *)output;
+        X264SharedAccessUnit * accessUnit = (X264SharedAccessUnit *)(packet+1);
+        accessUnit->m_unitCount = unitCount;
+        accessUnit->m_dataLength = dataLen;
+        memcpy(accessUnit+1, units, unitCount*sizeof(PluginCodec_NALUnit));
+        memcpy((unsigned char *)(accessUnit+1) + unitCount*sizeof(PluginCodec_NALUnit), data, dataLen);
+        packet->m_length = (uint32_t)(indexLen + dataLen);
+        packet->m_flags = flags | PluginCodec_ReturnCoderLastFrame;
+        __atomic_store_n(&slot->m_published, 1, __ATOMIC_SEQ_CST);
+        status = X264SlotComplete;
+      }
+    }
+
+    __atomic_store_n(&slot->m_status, status, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&header->m_completed, frame+1, __ATOMIC_SEQ_CST);
+    WakePlugin(header);
+    return;
+  }
+
+  /* Publish each packet as soon as it is made, so the plugin can be sending
+     the start of the frame while we packetise the rest of it. The x264
+     picture planes point straight at the input area, so the raw frame is
+     not copied here either. */
+  uint32_t status = X264SlotFailed;
+  uint32_t count = 0;
+  size_t used = 0;
+  while (used + maxPacket <= header->m_outputSize) {
+    X264SharedPacket * packet = (X264SharedPacket *)(output + used);
+    unsigned char * dst = (unsigned char *)(packet+1);
+    memcpy(dst, input - X264_SHARED_HEADER_TEMPLATE, headerLen);
+
+    unsigned dstLen = headerLen + rtpSize;
+    packet->m_flags = slot->m_flags;
+    if (!x264.EncodeFrames(input, srcLen, dst, dstLen, headerLen, packet->m_flags))
+      break;
+
+    packet->m_length = dstLen;
+    used += X264_SHARED_ALIGN(sizeof(X264SharedPacket) + dstLen);
+    __atomic_store_n(&slot->m_published, ++count, __ATOMIC_SEQ_CST);
+
+    if (packet->m_flags & PluginCodec_ReturnCoderLastFrame) {
+      status = X264SlotComplete;
+      break;
+    }
+
+    WakePlugin(header);
+  }
+
+  if (status != X264SlotComplete && used + maxPacket > header->m_outputSize) {
+    PTRACE(1, HelperTraceName, "Encoded frame " << frame << " too large for shared memory, discarding rest");
+    // Flush what the packetiser still holds, or it comes out as the next frame
+    ResizeBuffer(0);
+    unsigned drainFlags = 0;
+    do {
+      unsigned dstLen = rtpSize;
+      if (!x264.EncodeFrames(input, srcLen, buffer, dstLen, headerLen, drainFlags))
+        break;
+    } while ((drainFlags & PluginCodec_ReturnCoderLastFrame) == 0);
+  }
+
+  __atomic_store_n(&slot->m_status, status, __ATOMIC_SEQ_CST);
+  __atomic_store_n(&header->m_completed, frame+1, __ATOMIC_SEQ_CST);
+  WakePlugin(header);
+}
+
+
+/* Encode frames as the plugin queues them, returning when there is a command
+   waiting in the pipe. */
+void ProcessSharedFrames()
+{
+  for (;;) {
+    X264SharedHeader * header = (X264SharedHeader *)sharedPtr;
+    uint32_t completed = header->m_completed; // Only we write it
+    if (__atomic_load_n(&header->m_submitted, __ATOMIC_ACQUIRE) != completed) {
+      EncodeShared(header, completed);
+      continue;
+    }
+
+    __atomic_store_n(&header->m_helperWaiting, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&header->m_submitted, __ATOMIC_SEQ_CST) != completed) {
+      __atomic_store_n(&header->m_helperWaiting, 0, __ATOMIC_RELAXED);
+      continue;
+    }
+
+    struct pollfd fds[2];
+    fds[0].fd = downLink;
+    fds[0].events = POLLIN;
+    fds[0].revents = 0;
+    fds[1].fd = workFd;
+    fds[1].events = POLLIN;
+    fds[1].revents = 0;
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      PTRACE(1, HelperTraceName, "Error waiting for plugin: " << strerror(errno));
+      exit(1);
+    }
+
+    __atomic_store_n(&header->m_helperWaiting, 0, __ATOMIC_RELAXED);
+
+    if (fds[1].revents & POLLIN) {
+      uint64_t count;
+      if (read(workFd, &count, sizeof(count)) < 0 && errno != EINTR) {
+        PTRACE(1, HelperTraceName, "Error reading event from plugin: " << strerror(errno));
+        exit(1);
+      }
+    }
+
+    if (fds[0].revents != 0)
+      return;
+  }
+}
+
+#endif // X264_SHARED_MEMORY
+
+
 int main(int argc, char *argv[])
 {
   if (argc < 2) {
@@ -208,17 +403,37 @@ int main(int argc, char *argv[])
 
   OpenPipe(argv[1], argv[2]);
 
+#if X264_SHARED_MEMORY
+  if (argc > 5) {
+    sharedFd = atoi(argv[3]);
+    workFd = atoi(argv[4]);
+    doneFd = atoi(argv[5]);
+    if (!MapSharedMemory())
+      sharedFd = -1;
+  }
+#endif
+
   PTRACE(5, HelperTraceName, "GPL executable ready");
 
   rtpSize = 1500;
 
   for (;;) {
+#if X264_SHARED_MEMORY
+    if (sharedFd >= 0)
+      ProcessSharedFrames();
+#endif
+
     unsigned msg;
     ReadPipe(&msg, sizeof(msg));
 
     switch (msg) {
       case H264ENCODERCONTEXT_CREATE:
+#if X264_SHARED_MEMORY
+        if (sharedFd >= 0)
           WritePipe(&Version, sizeof(Version)); 
+        else
+#endif
+          WritePipe(&PipeOnlyVersion, sizeof(PipeOnlyVersion)); 
         break;
       case H264ENCODERCONTEXT_DELETE:
           WritePipe(&msg, sizeof(msg)); 
@@ -267,6 +482,11 @@ int main(int argc, char *argv[])
           x264.SetProfileLevel((val>>16)&0xff, val&0xff, (val>>8)&0xff);
           WritePipe(&msg, sizeof(msg)); 
         break;
+      case SET_THREADS:
+          ReadPipe(&val, sizeof(val));
+          x264.SetThreads(val);
+          WritePipe(&msg, sizeof(msg)); 
+        break;
       case ENCODE_FRAMES:
           ReadPipe(&srcLen, sizeof(srcLen));
           ResizeBuffer(srcLen);
@@ -286,6 +506,18 @@ int main(int argc, char *argv[])
           WritePipe(&ret, sizeof(ret));
         }
         break;
+#if X264_SHARED_MEMORY
+      case SET_SHARED_LAYOUT:
+        {
+          unsigned reply = msg;
+          if (!MapSharedMemory()) {
+            sharedFd = -1; // Plugin falls back to the pipe
+            reply = 0;
+          }
+          WritePipe(&reply, sizeof(reply));
+        }
+        break;
+#endif
       case SET_MAX_PAYLOAD_SIZE:
           ReadPipe(&val, sizeof(val));
           x264.SetMaxRTPPayloadSize(val);
@@ -765,6 +765,8 @@ class H264_Encoder : public PluginVideoEncoder<MY_CODEC>
       m_encoder.SetRateControlPeriod(m_rateControlPeriod);
       m_encoder.SetTSTO(m_tsto);
       m_encoder.SetMaxKeyFramePeriod(m_keyFramePeriod != 0 ? m_keyFramePeriod : 10*PLUGINCODEC_VIDEO_CLOCK/m_frameTime); // Every 10 seconds
+      if (m_threads != 0)
+        m_encoder.SetThreads(m_threads);
 
       unsigned mode = m_isH323 ? m_packetisationModeH323 : m_packetisationModeSDP;
       if (mode == 0) {
@@ -820,6 +822,15 @@ class H264_Encoder : public PluginVideoEncoder<MY_CODEC>
     }
 
 
+#if !defined(X264_LICENSED)
+    virtual void * GetInputBuffer(size_t size)
+    {
+      // Frames built here go to the helper process without being copied
+      return m_encoder.GetInputBuffer(size);
+    }
+#endif
+
+
     virtual bool Transcode(const void * fromPtr,
                              unsigned & fromLen,
                                  void * toPtr,
@@ -843,6 +854,22 @@ class H264_Encoder : public PluginVideoEncoder<MY_CODEC>
 #endif
       return true;
     }
+
+
+    virtual int EncodeAccessUnit(PluginCodec_AccessUnit & accessUnit)
+    {
+      int result = m_encoder.EncodeAccessUnit((const unsigned char *)accessUnit.m_input, accessUnit.m_inputLength,
+                                              accessUnit.m_flags, accessUnit.m_data, accessUnit.m_dataLength,
+                                              accessUnit.m_units, accessUnit.m_unitCount);
+      if (result <= 0)
+        return result;
+
+      PluginCodec_RTP srcRTP(accessUnit.m_input, accessUnit.m_inputLength);
+      PluginCodec_Video_FrameHeader * header = (PluginCodec_Video_FrameHeader *)srcRTP.GetPayloadPtr();
+      m_width = header->width&~1;
+      m_height = header->height&~1;
+      return result;
+    }
 };
 
 
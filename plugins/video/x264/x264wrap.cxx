@@ -267,6 +267,14 @@ bool H264Encoder::SetTSTO(unsigned tsto)
 }
 
 
+bool H264Encoder::SetThreads(unsigned threads)
+{
+  // Zero is auto detect, the "zerolatency" tune means these are sliced threads
+  m_context.i_threads = threads;
+  return true;
+}
+
+
 bool H264Encoder::ApplyOptions()
 {
   if (m_codec != NULL)
@@ -290,6 +298,77 @@ bool H264Encoder::ApplyOptions()
 }
 
 
+bool H264Encoder::EncodePicture(const unsigned char * src, unsigned srcLen, unsigned flags,
+                                x264_nal_t * & NALUs, int & numberOfNALUs)
+{
+  // create RTP frame from source buffer
+  PluginCodec_RTP srcRTP(src, srcLen);
+
+  // do a validation of size
+  size_t payloadSize = srcRTP.GetPayloadSize();
+  if (payloadSize < sizeof(PluginCodec_Video_FrameHeader)) {
+    PTRACE(1, HelperTraceName, "Video grab far too small, Close down video transmission thread");
+    return false;
+  }
+
+  PluginCodec_Video_FrameHeader * header = (PluginCodec_Video_FrameHeader *)srcRTP.GetPayloadPtr();
+  if (header->x != 0 || header->y != 0) {
+    PTRACE(1, HelperTraceName, "Video grab of partial frame unsupported, Close down video transmission thread");
+    return false;
+  }
+
+  unsigned planeWidth = (header->width+1)&~1;
+  unsigned planeHeight = (header->height+1)&~1;
+
+  if (payloadSize < sizeof(PluginCodec_Video_FrameHeader)+planeWidth*planeHeight*3/2) {
+    PTRACE(1, HelperTraceName, "Video grab far too small, Close down video transmission thread");
+    return false;
+  }
+
+  unsigned encodeWidth = header->width&~1;
+  unsigned encodeHeight = header->height&~1;
+
+  // if the incoming data has changed size, tell the encoder
+  if ((unsigned)m_context.i_width != encodeWidth || (unsigned)m_context.i_height != encodeHeight) {
+    PTRACE(4, HelperTraceName, "Detected resolution change " << m_context.i_width << 'x' << m_context.i_height
+           << " to " << encodeWidth << 'x' << encodeHeight << " (" << header->width << 'x' << header->width << ')');
+    x264_encoder_close(m_codec);
+    m_context.i_width = encodeWidth;
+    m_context.i_height = encodeHeight;
+    m_codec = x264_encoder_open(&m_context);
+    if (m_codec == NULL) {
+      PTRACE(1, HelperTraceName, "Couldn't re-open encoder");
+      return false;
+    }
+    PTRACE(4, HelperTraceName, "Encoder successfully re-opened");
+  } 
+
+  // Prepare the frame to be encoded
+  x264_picture_t inputPicture;
+  x264_picture_init(&inputPicture);
+  inputPicture.i_qpplus1 = 0;
+  inputPicture.img.i_csp = X264_CSP_I420;
+  inputPicture.img.i_stride[0] = planeWidth;
+  inputPicture.img.i_stride[1] = inputPicture.img.i_stride[2] = planeWidth/2;
+  inputPicture.img.plane[0] = (uint8_t *)(((unsigned char *)header) + sizeof(PluginCodec_Video_FrameHeader));
+  inputPicture.img.plane[1] = inputPicture.img.plane[0] + planeWidth*planeHeight;
+  inputPicture.img.plane[2] = inputPicture.img.plane[1] + planeWidth*planeHeight/4;
+  inputPicture.i_type = flags != 0 ? X264_TYPE_IDR : X264_TYPE_AUTO;
+
+  NALUs = NULL;
+  numberOfNALUs = 0;
+  while (numberOfNALUs == 0) { // workaround for first 2 packets being 0
+    x264_picture_t outputPicture;
+    if (x264_encoder_encode(m_codec, &NALUs, &numberOfNALUs, &inputPicture, &outputPicture) < 0) {
+      PTRACE(1, HelperTraceName, "x264_encoder_encode failed");
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
 bool H264Encoder::EncodeFrames(const unsigned char * src, unsigned & srcLen,
                                unsigned char * dst, unsigned & dstLen,
                                unsigned /*headerLen*/, unsigned int & flags)
@@ -301,73 +380,14 @@ bool H264Encoder::EncodeFrames(const unsigned char * src, unsigned & srcLen,
 
   // if there are NALU's encoded, return them
   if (!m_encapsulation.HasRTPFrames()) {
-    // create RTP frame from source buffer
-    PluginCodec_RTP srcRTP(src, srcLen);
-
-    // do a validation of size
-    size_t payloadSize = srcRTP.GetPayloadSize();
-    if (payloadSize < sizeof(PluginCodec_Video_FrameHeader)) {
-      PTRACE(1, HelperTraceName, "Video grab far too small, Close down video transmission thread");
-      return 0;
-    }
-
-    PluginCodec_Video_FrameHeader * header = (PluginCodec_Video_FrameHeader *)srcRTP.GetPayloadPtr();
-    if (header->x != 0 || header->y != 0) {
-      PTRACE(1, HelperTraceName, "Video grab of partial frame unsupported, Close down video transmission thread");
+    x264_nal_t *NALUs;
+    int numberOfNALUs;
+    if (!EncodePicture(src, srcLen, flags, NALUs, numberOfNALUs))
       return 0;
-    }
-
-    unsigned planeWidth = (header->width+1)&~1;
-    unsigned planeHeight = (header->height+1)&~1;
-
-    if (payloadSize < sizeof(PluginCodec_Video_FrameHeader)+planeWidth*planeHeight*3/2) {
-      PTRACE(1, HelperTraceName, "Video grab far too small, Close down video transmission thread");
-      return 0;
-    }
-
-    unsigned encodeWidth = header->width&~1;
-    unsigned encodeHeight = header->height&~1;
-
-    // if the incoming data has changed size, tell the encoder
-    if ((unsigned)m_context.i_width != encodeWidth || (unsigned)m_context.i_height != encodeHeight) {
-      PTRACE(4, HelperTraceName, "Detected resolution change " << m_context.i_width << 'x' << m_context.i_height
-             << " to " << encodeWidth << 'x' << encodeHeight << " (" << header->width << 'x' << header->width << ')');
-      x264_encoder_close(m_codec);
-      m_context.i_width = encodeWidth;
-      m_context.i_height = encodeHeight;
-      m_codec = x264_encoder_open(&m_context);
-      if (m_codec == NULL) {
-        PTRACE(1, HelperTraceName, "Couldn't re-open encoder");
-        return 0;
-      }
-      PTRACE(4, HelperTraceName, "Encoder successfully re-opened");
-    } 
-
-    // Prepare the frame to be encoded
-    x264_picture_t inputPicture;
-    x264_picture_init(&inputPicture);
-    inputPicture.i_qpplus1 = 0;
-    inputPicture.img.i_csp = X264_CSP_I420;
-    inputPicture.img.i_stride[0] = planeWidth;
-    inputPicture.img.i_stride[1] = inputPicture.img.i_stride[2] = planeWidth/2;
-    inputPicture.img.plane[0] = (uint8_t *)(((unsigned char *)header) + sizeof(PluginCodec_Video_FrameHeader));
-    inputPicture.img.plane[1] = inputPicture.img.plane[0] + planeWidth*planeHeight;
-    inputPicture.img.plane[2] = inputPicture.img.plane[1] + planeWidth*planeHeight/4;
-    inputPicture.i_type = flags != 0 ? X264_TYPE_IDR : X264_TYPE_AUTO;
-
-    x264_nal_t *NALUs = NULL;
-    int numberOfNALUs = 0;
-    while (numberOfNALUs == 0) { // workaround for first 2 packets being 0
-      x264_picture_t outputPicture;
-      if (x264_encoder_encode(m_codec, &NALUs, &numberOfNALUs, &inputPicture, &outputPicture) < 0) {
-        PTRACE(1, HelperTraceName, "x264_encoder_encode failed");
-        return 0;
-      }
-    }
 
     m_encapsulation.Reset();
     m_encapsulation.Allocate(numberOfNALUs);
-    m_encapsulation.SetTimestamp(srcRTP.GetTimestamp());
+    m_encapsulation.SetTimestamp(PluginCodec_RTP(src, srcLen).GetTimestamp());
     for (int i = 0; i < numberOfNALUs; i++)
       m_encapsulation.AddNALU(NALUs[i].i_type, NALUs[i].i_payload-4, NALUs[i].p_payload+4);
   }
@@ -380,6 +400,39 @@ bool H264Encoder::EncodeFrames(const unsigned char * src, unsigned & srcLen,
 }
 
 
+int H264Encoder::EncodeAccessUnit(const unsigned char * src, unsigned srcLen, unsigned int & flags,
+                                  const unsigned char * & data, unsigned & dataLen,
+                                  const PluginCodec_NALUnit * & units, unsigned & unitCount)
+{
+  if (m_codec == NULL) {
+    PTRACE(1, HelperTraceName, "Encoder not open");
+    return -1;
+  }
+
+  x264_nal_t *NALUs;
+  int numberOfNALUs;
+  if (!EncodePicture(src, srcLen, flags, NALUs, numberOfNALUs))
+    return -1;
+
+  /* x264 writes all the NAL units of a picture contiguously, so return them
+     where they are, just indexing past each start code. */
+  flags = 0;
+  data = NALUs[0].p_payload;
+  m_units.resize(numberOfNALUs);
+  for (int i = 0; i < numberOfNALUs; i++) {
+    m_units[i].m_offset = (unsigned)(NALUs[i].p_payload + 4 - data);
+    m_units[i].m_length = NALUs[i].i_payload - 4;
+    if (NALUs[i].i_type == NAL_SLICE_IDR)
+      flags |= PluginCodec_ReturnCoderIFrame;
+  }
+
+  dataLen = m_units.back().m_offset + m_units.back().m_length;
+  units = &m_units[0];
+  unitCount = numberOfNALUs;
+  return 1;
+}
+
+
 #else // X264_LICENSED || GPL_HELPER_APP
 
 #if PLUGINCODEC_TRACING
@@ -604,6 +657,12 @@ bool H264Encoder::WritePipe(const void * ptr, size_t len)
 #include <sys/stat.h>
 #include <sys/wait.h>
 
+#if X264_SHARED_MEMORY
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#endif
+
 
 static const char DefaultPluginDirs[] = "." DIR_TOKENISER
                                         VID_PLUGIN_DIR DIR_TOKENISER
@@ -618,6 +677,18 @@ static bool IsExecutable(const char * path)
 
 H264Encoder::H264Encoder()
   : m_loaded(false)
+#if X264_SHARED_MEMORY
+  , m_sharedFd(-1)
+  , m_workFd(-1)
+  , m_doneFd(-1)
+  , m_sharedPtr(NULL)
+  , m_sharedSize(0)
+  , m_pipelineDepth(1)
+  , m_submitted(0)
+  , m_collected(0)
+  , m_sharedPacket(0)
+  , m_sharedOffset(0)
+#endif
   , m_pipeToProcess(-1)
   , m_pipeFromProcess(-1)
   , m_startNewFrame(true)
@@ -649,9 +720,383 @@ H264Encoder::~H264Encoder()
     int status;
     waitpid(m_pid, &status, 0);
   }
+
+#if X264_SHARED_MEMORY
+  CloseSharedMemory();
+#endif
+}
+
+
+#if X264_SHARED_MEMORY
+
+bool H264Encoder::OpenSharedMemory()
+{
+  const char * depth = ::getenv("X264_PIPELINE_DEPTH");
+  m_pipelineDepth = depth != NULL ? atoi(depth) : 1;
+  if (m_pipelineDepth == 0) {
+    PTRACE(3, PipeTraceName, "Shared memory disabled by X264_PIPELINE_DEPTH, using pipe only");
+    return false;
+  }
+  if (m_pipelineDepth > X264_SHARED_MAX_SLOTS)
+    m_pipelineDepth = X264_SHARED_MAX_SLOTS;
+
+  // Deliberately not close on exec, the helper inherits the descriptors
+  m_sharedFd = (int)syscall(SYS_memfd_create, "x264-frames", 0);
+  m_workFd = eventfd(0, 0);
+  m_doneFd = eventfd(0, 0);
+  if (m_sharedFd < 0 || m_workFd < 0 || m_doneFd < 0) {
+    PTRACE(2, PipeTraceName, "Could not create shared memory, using pipe only - " << strerror(errno));
+    CloseSharedMemory();
+    return false;
+  }
+
+  m_sharedSize = sysconf(_SC_PAGESIZE);
+  if (ftruncate(m_sharedFd, m_sharedSize) < 0) {
+    PTRACE(2, PipeTraceName, "Could not size shared memory, using pipe only - " << strerror(errno));
+    CloseSharedMemory();
+    return false;
+  }
+
+  void * ptr = mmap(NULL, m_sharedSize, PROT_READ|PROT_WRITE, MAP_SHARED, m_sharedFd, 0);
+  if (ptr == MAP_FAILED) {
+    PTRACE(2, PipeTraceName, "Could not map shared memory, using pipe only - " << strerror(errno));
+    CloseSharedMemory();
+    return false;
+  }
+
+  // A new memfd is all zeros, so no slots and nothing submitted
+  m_sharedPtr = (unsigned char *)ptr;
+  m_submitted = m_collected = 0;
+  return true;
+}
+
+
+void H264Encoder::CloseSharedMemory()
+{
+  if (m_sharedPtr != NULL) {
+    munmap(m_sharedPtr, m_sharedSize);
+    m_sharedPtr = NULL;
+  }
+
+  if (m_sharedFd >= 0) {
+    close(m_sharedFd);
+    m_sharedFd = -1;
+  }
+
+  if (m_workFd >= 0) {
+    close(m_workFd);
+    m_workFd = -1;
+  }
+
+  if (m_doneFd >= 0) {
+    close(m_doneFd);
+    m_doneFd = -1;
+  }
+
+  m_sharedSize = 0;
+  m_startNewFrame = true;
+}
+
+
+X264SharedSlot * H264Encoder::GetSharedSlot(uint32_t frame) const
+{
+  const X264SharedHeader * header = (const X264SharedHeader *)m_sharedPtr;
+  return (X264SharedSlot *)(m_sharedPtr + X264_SHARED_ALIGN(sizeof(X264SharedHeader)) +
+                            (size_t)(frame % header->m_slotCount)*header->m_slotSize);
+}
+
+
+bool H264Encoder::WaitShared(uint32_t progress)
+{
+  /* Returns when the helper has made any progress since the caller read the
+     progress counter, the caller then re-checks what it was waiting for. */
+  X264SharedHeader * header = (X264SharedHeader *)m_sharedPtr;
+
+  __atomic_store_n(&header->m_pluginWaiting, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&header->m_progress, __ATOMIC_SEQ_CST) != progress) {
+    __atomic_store_n(&header->m_pluginWaiting, 0, __ATOMIC_RELAXED);
+    return true;
+  }
+
+  for (;;) {
+    struct pollfd pfd;
+    pfd.fd = m_doneFd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    int result = poll(&pfd, 1, 1000);
+    if (result > 0) {
+      uint64_t count;
+      if (read(m_doneFd, &count, sizeof(count)) < 0 && errno != EINTR) {
+        PTRACE(1, PipeTraceName, "Error reading event from sub-process - " << strerror(errno));
+        return false;
+      }
+      return true;
+    }
+
+    if (result < 0) {
+      if (errno == EINTR)
+        continue;
+      PTRACE(1, PipeTraceName, "Error waiting for sub-process - " << strerror(errno));
+      return false;
+    }
+
+    if (__atomic_load_n(&header->m_progress, __ATOMIC_ACQUIRE) != progress)
+      return true;
+
+    int status;
+    if (waitpid(m_pid, &status, WNOHANG) == m_pid) {
+      PTRACE(1, PipeTraceName, "Sub-process no longer running!");
+      m_pid = 0;
+      return false;
+    }
+  }
+}
+
+
+bool H264Encoder::WaitCompleted(uint32_t frames)
+{
+  X264SharedHeader * header = (X264SharedHeader *)m_sharedPtr;
+  for (;;) {
+    uint32_t progress = __atomic_load_n(&header->m_progress, __ATOMIC_ACQUIRE);
+    if ((int32_t)(__atomic_load_n(&header->m_completed, __ATOMIC_ACQUIRE) - frames) >= 0)
+      return true;
+    if (!WaitShared(progress))
+      return false;
+  }
+}
+
+
+bool H264Encoder::ResizeSharedMemory(size_t inputSize)
+{
+  X264SharedHeader * header = (X264SharedHeader *)m_sharedPtr;
+  if (header->m_inputSize >= inputSize)
+    return true;
+
+  // The helper must not be using the region while it moves, let it finish everything queued
+  if (!WaitCompleted(m_submitted))
+    return false;
+
+  if (m_collected != m_submitted) {
+    PTRACE(3, PipeTraceName, "Discarding " << (m_submitted - m_collected) << " encoded frames on resize");
+    m_collected = m_submitted;
+  }
+  m_startNewFrame = true;
+
+  /* Encoded output for a frame is, in practice, well below the raw size, but
+     allow for RTP headers and the odd pathological frame. */
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t inputOffset = X264_SHARED_ALIGN(sizeof(X264SharedSlot)) + X264_SHARED_HEADER_TEMPLATE;
+  size_t inputCapacity = X264_SHARED_ALIGN(inputSize);
+  size_t outputCapacity = X264_SHARED_ALIGN(inputSize + inputSize/4 + 65536);
+  size_t slotSize = inputOffset + inputCapacity + outputCapacity;
+  size_t newSize = (X264_SHARED_ALIGN(sizeof(X264SharedHeader)) + slotSize*m_pipelineDepth + page - 1) & ~(page - 1);
+
+  munmap(m_sharedPtr, m_sharedSize);
+  m_sharedPtr = NULL;
+
+  if (ftruncate(m_sharedFd, newSize) < 0) {
+    PTRACE(1, PipeTraceName, "Could not resize shared memory to " << newSize << " - " << strerror(errno));
+    return false;
+  }
+
+  void * ptr = mmap(NULL, newSize, PROT_READ|PROT_WRITE, MAP_SHARED, m_sharedFd, 0);
+  if (ptr == MAP_FAILED) {
+    PTRACE(1, PipeTraceName, "Could not remap shared memory to " << newSize << " - " << strerror(errno));
+    return false;
+  }
+
+  m_sharedPtr = (unsigned char *)ptr;
+  m_sharedSize = newSize;
+
+  // The counters live in the region, so they survive the resize
+  header = (X264SharedHeader *)m_sharedPtr;
+  header->m_slotCount = m_pipelineDepth;
+  header->m_slotSize = (uint32_t)slotSize;
+  header->m_inputOffset = (uint32_t)inputOffset;
+  header->m_inputSize = (uint32_t)inputCapacity;
+  header->m_outputOffset = (uint32_t)(inputOffset + inputCapacity);
+  header->m_outputSize = (uint32_t)outputCapacity;
+
+  unsigned msg = SET_SHARED_LAYOUT;
+  if (!WritePipe(&msg, sizeof(msg)) || !ReadPipe(&msg, sizeof(msg)) || msg != SET_SHARED_LAYOUT) {
+    PTRACE(1, PipeTraceName, "GPL process could not remap shared memory");
+    return false;
+  }
+
+  PTRACE(4, PipeTraceName, "Resized shared memory to " << newSize << " bytes, " << m_pipelineDepth << " slots");
+  return true;
+}
+
+
+bool H264Encoder::SubmitSharedFrame(const unsigned char * src, unsigned srcLen,
+                                    const unsigned char * rtpHeader, unsigned headerLen,
+                                    unsigned flags, bool accessUnit)
+{
+  if (headerLen > X264_SHARED_HEADER_TEMPLATE) {
+    PTRACE(1, PipeTraceName, "RTP header of " << headerLen << " bytes too large");
+    return false;
+  }
+
+  // The slot is re-used from pipeline depth frames ago, which must be finished with
+  if (!WaitCompleted(m_submitted - m_pipelineDepth + 1))
+    return false;
+
+  X264SharedHeader * header = (X264SharedHeader *)m_sharedPtr;
+  X264SharedSlot * slot = GetSharedSlot(m_submitted);
+  unsigned char * input = (unsigned char *)slot + header->m_inputOffset;
+  if (src != input) {
+    // Not built in place by the caller, see GetInputBuffer(), so copy it in
+    if (!ResizeSharedMemory(srcLen))
+      return false;
+    header = (X264SharedHeader *)m_sharedPtr;
+    slot = GetSharedSlot(m_submitted);
+    input = (unsigned char *)slot + header->m_inputOffset;
+    memcpy(input, src, srcLen);
+  }
+  else if (srcLen > header->m_inputSize) {
+    PTRACE(1, PipeTraceName, "Frame of " << srcLen << " bytes overran shared input of " << header->m_inputSize);
+    return false;
+  }
+
+  memcpy(input - X264_SHARED_HEADER_TEMPLATE, rtpHeader, headerLen);
+  slot->m_srcLen = srcLen;
+  slot->m_headerLen = headerLen;
+  slot->m_flags = flags;
+  slot->m_published = 0;
+  slot->m_status = X264SlotQueued;
+  slot->m_accessUnit = accessUnit;
+
+  __atomic_store_n(&header->m_submitted, ++m_submitted, __ATOMIC_SEQ_CST);
+  if (__atomic_exchange_n(&header->m_helperWaiting, 0, __ATOMIC_SEQ_CST)) {
+    uint64_t one = 1;
+    if (write(m_workFd, &one, sizeof(one)) < 0) {
+      PTRACE(1, PipeTraceName, "Error signalling sub-process - " << strerror(errno));
+      return false;
+    }
+  }
+
+  return true;
 }
 
 
+bool H264Encoder::EncodeFramesShared(const unsigned char * src, unsigned & srcLen,
+                                     unsigned char * dst, unsigned & dstLen,
+                                     unsigned headerLen, unsigned int & flags)
+{
+  X264SharedHeader * header = (X264SharedHeader *)m_sharedPtr;
+
+  if (m_startNewFrame) {
+    if (!SubmitSharedFrame(src, srcLen, dst, headerLen, flags, false)) {
+      CloseSharedMemory();
+      return false;
+    }
+
+    /* With a pipeline depth of more than one, the output for this call is
+       from an earlier frame, and until the pipeline fills there is none. */
+    if (m_submitted - m_collected < m_pipelineDepth) {
+      dstLen = 0;
+      flags = PluginCodec_ReturnCoderLastFrame;
+      return true;
+    }
+
+    header = (X264SharedHeader *)m_sharedPtr;
+    m_startNewFrame = false;
+    m_sharedPacket = 0;
+    m_sharedOffset = header->m_outputOffset;
+  }
+
+  // Wait for the helper to publish the next packet, it may still be encoding the rest
+  X264SharedSlot * slot = GetSharedSlot(m_collected);
+  for (;;) {
+    uint32_t progress = __atomic_load_n(&header->m_progress, __ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&slot->m_published, __ATOMIC_ACQUIRE) > m_sharedPacket)
+      break;
+
+    if (__atomic_load_n(&slot->m_status, __ATOMIC_ACQUIRE) != X264SlotQueued) {
+      PTRACE(1, PipeTraceName, "GPL process failed to encode frame " << m_collected);
+      ++m_collected;
+      m_startNewFrame = true;
+      return false;
+    }
+
+    if (!WaitShared(progress)) {
+      CloseSharedMemory();
+      return false;
+    }
+  }
+
+  const X264SharedPacket * packet = (const X264SharedPacket *)((const unsigned char *)slot + m_sharedOffset);
+  if (packet->m_length > dstLen) {
+    PTRACE(1, PipeTraceName, "Encoded packet of " << packet->m_length << " bytes too large for buffer of " << dstLen);
+    ++m_collected;
+    m_startNewFrame = true;
+    return false;
+  }
+
+  memcpy(dst, packet+1, packet->m_length);
+  dstLen = packet->m_length;
+  flags = packet->m_flags;
+
+  m_sharedOffset += X264_SHARED_ALIGN(sizeof(X264SharedPacket) + packet->m_length);
+  ++m_sharedPacket;
+
+  if ((flags & PluginCodec_ReturnCoderLastFrame) != 0) {
+    ++m_collected;
+    m_startNewFrame = true;
+  }
+  return true;
+}
+
+
+int H264Encoder::EncodeAccessUnitShared(const unsigned char * src, unsigned srcLen, unsigned int & flags,
+                                        const unsigned char * & data, unsigned & dataLen,
+                                        const PluginCodec_NALUnit * & units, unsigned & unitCount)
+{
+  // Part way through handing out the packets of a frame from EncodeFrames()
+  if (!m_startNewFrame)
+    return 0;
+
+  if (!SubmitSharedFrame(src, srcLen, src, 0, flags, true)) {
+    CloseSharedMemory();
+    return -1;
+  }
+
+  unitCount = 0;
+  if (m_submitted - m_collected < m_pipelineDepth)
+    return 1; // Pipeline filling, nothing to send yet
+
+  if (!WaitCompleted(m_collected+1)) {
+    CloseSharedMemory();
+    return -1;
+  }
+
+  const X264SharedSlot * slot = GetSharedSlot(m_collected++);
+  if (slot->m_status != X264SlotComplete) {
+    PTRACE(1, PipeTraceName, "GPL process failed to encode access unit " << m_collected-1);
+    return -1;
+  }
+
+  if (!slot->m_accessUnit) {
+    PTRACE(2, PipeTraceName, "Discarding packetised frame " << m_collected-1 << " queued before access units used");
+    return 1;
+  }
+
+  /* Hand back the NAL units where the helper put them, they are packetised
+     by the caller before this slot can be used again. */
+  const X264SharedPacket * packet = (const X264SharedPacket *)((const unsigned char *)slot +
+                                                               ((const X264SharedHeader *)m_sharedPtr)->m_outputOffset);
+  const X264SharedAccessUnit * accessUnit = (const X264SharedAccessUnit *)(packet+1);
+  units = (const PluginCodec_NALUnit *)(accessUnit+1);
+  unitCount = accessUnit->m_unitCount;
+  data = (const unsigned char *)(units + unitCount);
+  dataLen = accessUnit->m_dataLength;
+  flags = packet->m_flags;
+  return 1;
+}
+
+#endif // X264_SHARED_MEMORY
+
+
 bool H264Encoder::OpenPipeAndExecute(void * instance, const char * executablePath)
 {
   snprintf(m_dlName, sizeof(m_dlName), "/tmp/x264-%d-%p-dl", getpid(), instance);
@@ -679,6 +1124,16 @@ bool H264Encoder::OpenPipeAndExecute(void * instance, const char * executablePat
   }
 #endif /* HAVE_MKFIFO */
 
+  char sharedArg[20], workArg[20], doneArg[20];
+  sharedArg[0] = '\0';
+#if X264_SHARED_MEMORY
+  if (OpenSharedMemory()) {
+    snprintf(sharedArg, sizeof(sharedArg), "%d", m_sharedFd);
+    snprintf(workArg, sizeof(workArg), "%d", m_workFd);
+    snprintf(doneArg, sizeof(doneArg), "%d", m_doneFd);
+  }
+#endif
+
   m_pid = vfork();
   if (m_pid < 0) {
     PTRACE(1, PipeTraceName, "Error when trying to vfork");
@@ -687,7 +1142,10 @@ bool H264Encoder::OpenPipeAndExecute(void * instance, const char * executablePat
 
   if (m_pid == 0) {
     // If succeeds, execl does not return
-    execl(executablePath, executablePath, m_dlName, m_ulName, NULL);
+    if (sharedArg[0] != '\0')
+      execl(executablePath, executablePath, m_dlName, m_ulName, sharedArg, workArg, doneArg, NULL);
+    else
+      execl(executablePath, executablePath, m_dlName, m_ulName, NULL);
     // With vfork() we must not do anything other than execl or _exit
     _exit(1);
     return false;
@@ -794,6 +1252,15 @@ bool H264Encoder::Load(void * instance)
   }
 
   PTRACE(4, PipeTraceName, "Successfully established communication with GPL process version " << msg);
+
+#if X264_SHARED_MEMORY
+  // Earlier helpers do not know this shared ring layout, version 4 reports 1 if it could not map it
+  if (m_sharedPtr != NULL && msg < 4) {
+    PTRACE(3, PipeTraceName, "GPL process not using shared memory, falling back to pipe");
+    CloseSharedMemory();
+  }
+#endif
+
   m_loaded = true;
   return true;
 }
@@ -880,6 +1347,12 @@ bool H264Encoder::SetMaxKeyFramePeriod(unsigned period)
 }
 
 
+bool H264Encoder::SetThreads(unsigned threads)
+{
+  return WriteValue(SET_THREADS, threads);
+}
+
+
 bool H264Encoder::ApplyOptions()
 {
   unsigned msg = APPLY_OPTIONS;
@@ -891,6 +1364,11 @@ bool H264Encoder::EncodeFrames(const unsigned char * src, unsigned & srcLen,
                                unsigned char * dst, unsigned & dstLen,
                                unsigned headerLen, unsigned int & flags)
 {
+#if X264_SHARED_MEMORY
+  if (m_sharedPtr != NULL)
+    return EncodeFramesShared(src, srcLen, dst, dstLen, headerLen, flags);
+#endif
+
   unsigned msg;
   if (m_startNewFrame) {
     msg = ENCODE_FRAMES;
@@ -921,6 +1399,44 @@ bool H264Encoder::EncodeFrames(const unsigned char * src, unsigned & srcLen,
 }
 
 
+int H264Encoder::EncodeAccessUnit(const unsigned char * src, unsigned srcLen, unsigned int & flags,
+                                  const unsigned char * & data, unsigned & dataLen,
+                                  const PluginCodec_NALUnit * & units, unsigned & unitCount)
+{
+#if X264_SHARED_MEMORY
+  if (m_sharedPtr != NULL)
+    return EncodeAccessUnitShared(src, srcLen, flags, data, dataLen, units, unitCount);
+#else
+  (void)src; (void)srcLen; (void)flags; (void)data; (void)dataLen; (void)units; (void)unitCount;
+#endif
+
+  // Through the pipe the packets are made by the helper
+  return 0;
+}
+
+
+unsigned char * H264Encoder::GetInputBuffer(size_t size)
+{
+#if X264_SHARED_MEMORY
+  /* The caller builds the next frame straight into the input area of the
+     slot it will be submitted in, so it is never copied on its way to the
+     helper. Only valid between frames, and once the slot is free. */
+  if (m_sharedPtr == NULL || !m_startNewFrame)
+    return NULL;
+
+  if (!ResizeSharedMemory(size) || !WaitCompleted(m_submitted - m_pipelineDepth + 1)) {
+    CloseSharedMemory();
+    return NULL;
+  }
+
+  return (unsigned char *)GetSharedSlot(m_submitted) + ((X264SharedHeader *)m_sharedPtr)->m_inputOffset;
+#else
+  (void)size;
+  return NULL;
+#endif
+}
+
+
 #endif // X264_LICENSED || GPL_HELPER_APP
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -33,7 +33,9 @@
 #define OPAL_H264ENC_H 1
 
 #include "../common/platform.h"
+#include <codec/opalplugin.h>
 #include <string>
+#include <vector>
 
 
 #if X264_LICENSED || GPL_HELPER_APP
@@ -69,6 +71,89 @@ extern "C" {
 #define SET_PROFILE_LEVEL         13
 #define SET_MAX_NALU_SIZE         14
 #define SET_RATE_CONTROL_PERIOD   15
+#define SET_SHARED_LAYOUT         16
+#define SET_THREADS               18
+
+
+/* On Linux the raw frames and the encoded packets are exchanged with the
+   helper process through an anonymous shared memory region (memfd) that is
+   inherited by the child, along with two eventfd's used to wake each other.
+   Only the small command messages go through the named pipes. If the region
+   cannot be created, or the helper is too old, then everything goes through
+   the pipes as before. */
+#if !defined(WIN32) && defined(__linux__)
+  #include <sys/syscall.h>
+  #if defined(SYS_memfd_create)
+    #define X264_SHARED_MEMORY 1
+  #endif
+#endif
+
+#ifndef X264_SHARED_MEMORY
+  #define X264_SHARED_MEMORY 0
+#endif
+
+/* Layout of the shared region. After the header there is a ring of slots,
+   one per video frame that may be in flight. Frame N uses slot N modulo the
+   slot count. Each slot starts with a X264SharedSlot, then the RTP header
+   template, then the input area holding the source RTP frame, then the
+   output area. The output area holds the encoded RTP packets for the frame,
+   each preceded by a X264SharedPacket, and is published a packet at a time
+   so the plugin can return the first packets while the rest are produced.
+
+   The counters are only ever written by one side, the other side reads them
+   with acquire semantics. A side about to sleep sets its "waiting" flag and
+   re-checks, the other side only writes to the eventfd if it clears that
+   flag, so there is no system call at all while both are busy. */
+struct X264SharedHeader
+{
+  uint32_t m_slotCount;
+  uint32_t m_slotSize;
+  uint32_t m_inputOffset;   // Relative to slot
+  uint32_t m_inputSize;
+  uint32_t m_outputOffset;  // Relative to slot
+  uint32_t m_outputSize;
+  uint32_t m_submitted;     // Frames queued, written by plugin
+  uint32_t m_completed;     // Frames finished, written by helper
+  uint32_t m_progress;      // Bumped by helper on every packet and frame
+  uint32_t m_helperWaiting;
+  uint32_t m_pluginWaiting;
+};
+
+enum X264SlotStatus
+{
+  X264SlotQueued,
+  X264SlotComplete,
+  X264SlotFailed
+};
+
+struct X264SharedSlot
+{
+  uint32_t m_srcLen;
+  uint32_t m_headerLen;
+  uint32_t m_flags;
+  uint32_t m_published;     // Packets in output area, written by helper
+  uint32_t m_status;        // X264SlotStatus, written by helper
+  uint32_t m_accessUnit;    // Non-zero for a single X264SharedPacket holding an access unit
+};
+
+struct X264SharedPacket
+{
+  uint32_t m_length;
+  uint32_t m_flags;
+};
+
+/* An access unit is returned as one X264SharedPacket, the data of which is
+   this, followed by m_unitCount PluginCodec_NALUnit's, followed by the NAL
+   units themselves, with offsets relative to the end of the index. */
+struct X264SharedAccessUnit
+{
+  uint32_t m_unitCount;
+  uint32_t m_dataLength;
+};
+
+#define X264_SHARED_ALIGN(n) (((n)+63)&~63)
+#define X264_SHARED_HEADER_TEMPLATE 1024
+#define X264_SHARED_MAX_SLOTS 8
 
 
 class H264Encoder
@@ -89,6 +174,7 @@ class H264Encoder
     bool SetMaxNALUSize(unsigned size);
     bool SetTSTO(unsigned tsto);
     bool SetMaxKeyFramePeriod(unsigned period);
+    bool SetThreads(unsigned threads);
 
     bool ApplyOptions();
 
@@ -101,15 +187,42 @@ class H264Encoder
       unsigned int & flags
     );
 
+    /* Encode a frame, returning its NAL units, without start codes, for the
+       caller to packetise. The data is valid until the next call. Returns 1
+       on success, 0 if not possible now, e.g. using the pipe to the helper,
+       and -1 on error. */
+    int EncodeAccessUnit(
+      const unsigned char * src,
+      unsigned srcLen,
+      unsigned int & flags,
+      const unsigned char * & data,
+      unsigned & dataLen,
+      const PluginCodec_NALUnit * & units,
+      unsigned & unitCount
+    );
+
     unsigned GetWidth() const;
     unsigned GetHeight() const;
 
+#if !(X264_LICENSED || GPL_HELPER_APP)
+    unsigned char * GetInputBuffer(size_t size);
+#endif
+
   protected:
 #if X264_LICENSED || GPL_HELPER_APP
 
+    bool EncodePicture(
+      const unsigned char * src,
+      unsigned srcLen,
+      unsigned flags,
+      x264_nal_t * & NALUs,
+      int & numberOfNALUs
+    );
+
     x264_param_t   m_context;
     x264_t       * m_codec;
     H264Frame      m_encapsulation;
+    std::vector<PluginCodec_NALUnit> m_units;
 
 #else // X264_LICENSED || GPL_HELPER_APP
 
@@ -120,6 +233,51 @@ class H264Encoder
 
     bool m_loaded;
 
+  #if X264_SHARED_MEMORY
+    bool OpenSharedMemory();
+    void CloseSharedMemory();
+    bool ResizeSharedMemory(size_t inputSize);
+    X264SharedSlot * GetSharedSlot(uint32_t frame) const;
+    bool WaitShared(uint32_t progress);
+    bool WaitCompleted(uint32_t frames);
+    bool SubmitSharedFrame(
+      const unsigned char * src,
+      unsigned srcLen,
+      const unsigned char * header,
+      unsigned headerLen,
+      unsigned flags,
+      bool accessUnit
+    );
+    bool EncodeFramesShared(
+      const unsigned char * src,
+      unsigned & srcLen,
+      unsigned char * dst,
+      unsigned & dstLen,
+      unsigned headerLen,
+      unsigned int & flags
+    );
+    int EncodeAccessUnitShared(
+      const unsigned char * src,
+      unsigned srcLen,
+      unsigned int & flags,
+      const unsigned char * & data,
+      unsigned & dataLen,
+      const PluginCodec_NALUnit * & units,
+      unsigned & unitCount
+    );
+
+    int             m_sharedFd;
+    int             m_workFd;
+    int             m_doneFd;
+    unsigned char * m_sharedPtr;
+    size_t          m_sharedSize;
+    unsigned        m_pipelineDepth;
+    uint32_t        m_submitted;
+    uint32_t        m_collected;
+    uint32_t        m_sharedPacket;
+    size_t          m_sharedOffset;
+  #endif // X264_SHARED_MEMORY
+
   #if WIN32
     HANDLE m_hStandardError;
     std::string m_errorOutput;
@@ -33,6 +33,8 @@
 #include <ptclib/random.h>
 
 #include <math.h>
+#include <memory>
+#include <algorithm>
 
 
 #define OUTPUT_BPS(strm, rate) \
@@ -93,16 +95,27 @@ void CodecTest::Main()
              "i-info. display per-frame info (use multiple times for more info)\n"
              "-pcap: save encoded packets in a PCAP file\n"
              "-list. list all available plugin codecs\n"
+             "-benchmark. measure throughput of every registered transcoder\n"
+             "-benchmark-time: seconds to run each transcoder per thread count, default 1\n"
+             "-benchmark-threads: maximum threads for scaling test, default 4\n"
+             "-benchmark-output: write benchmark results as CSV to file, default stdout\n"
+             "-silence-benchmark. measure speed and accuracy of silence detection and comfort noise\n"
+#if OPAL_AEC
+             "-echo-benchmark. measure echo return loss enhancement and speed of echo cancellers\n"
+             "-echo-channels: calls cancelled together by the batched echo benchmark, default 32\n"
+#endif
              PTRACE_ARGLIST
              "h-help. print this help message.\n"
              , false);
   if (!args.IsParsed() || args.HasOption('h') ||
-              (args.GetCount() == 0 && !args.HasOption("list"))) {
+              (args.GetCount() == 0 && !args.HasOption("list") && !args.HasOption("benchmark") && !args.HasOption("silence-benchmark") && !args.HasOption("echo-benchmark"))) {
     cerr << "usage: " << GetFile().GetTitle() << " [ options ] fmtname [ fmtname ]\n"
               "  where fmtname is the Media Format Name for the codec(s) to test, up to two\n"
               "  formats (one audio and one video) may be specified.\n";
     args.Usage(cerr) << "\n"
-               "e.g. " << GetFile().GetTitle() << " --grab-device fake --grab-channel 2 GSM-AMR H.264\n\n";
+               "e.g. " << GetFile().GetTitle() << " --grab-device fake --grab-channel 2 GSM-AMR H.264\n\n"
+               "In benchmark mode the fmtname arguments are optional and limit the\n"
+               "transcoders tested to those with one of the formats as input or output.\n";
     return;
   }
 
@@ -143,6 +156,26 @@ void CodecTest::Main()
     return;
   }
 
+  if (args.HasOption("benchmark")) {
+    CodecBenchmark benchmark(args);
+    benchmark.Run();
+    return;
+  }
+
+  if (args.HasOption("silence-benchmark")) {
+    SilenceBenchmark benchmark(args);
+    benchmark.Run();
+    return;
+  }
+
+#if OPAL_AEC
+  if (args.HasOption("echo-benchmark")) {
+    EchoBenchmark benchmark(args);
+    benchmark.Run();
+    return;
+  }
+#endif
+
   g_infoCount = args.GetOptionCount('i');
 
   unsigned threadCount = args.GetOptionString('S').AsInteger();
@@ -277,6 +310,716 @@ void CodecTest::Main()
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+
+BenchmarkThread::BenchmarkThread(OpalTranscoder * transcoder, const RTP_DataFrameList & input, const PTimeInterval & duration)
+  : PThread(5000, NoAutoDeleteThread, NormalPriority, "Benchmark")
+  , m_transcoder(transcoder)
+  , m_duration(duration)
+  , m_frames(0)
+  , m_ok(true)
+{
+  // Private copy of the input, so threads do not share reference counts
+  for (RTP_DataFrameList::const_iterator it = input.begin(); it != input.end(); ++it)
+    m_input.Append(new RTP_DataFrame(it->GetPointer(), it->GetPacketSize()));
+}
+
+
+void BenchmarkThread::Main()
+{
+  RTP_DataFrameList output;
+  RTP_DataFrameList::iterator it = m_input.begin();
+
+  PTimeInterval start = PTimer::Tick();
+  do {
+    if (!m_transcoder->ConvertFrames(*it, output)) {
+      m_ok = false;
+      break;
+    }
+    ++m_frames;
+    if (++it == m_input.end())
+      it = m_input.begin();
+    m_elapsed = PTimer::Tick() - start;
+  } while (m_elapsed < m_duration);
+}
+
+
+CodecBenchmark::CodecBenchmark(PArgList & args)
+  : m_duration(0, args.GetOptionString("benchmark-time", "1").AsUnsigned())
+  , m_maxThreads(args.GetOptionString("benchmark-threads", "4").AsUnsigned())
+  , m_results(&cout)
+{
+  if (m_duration == 0)
+    m_duration.SetInterval(0, 1);
+  if (m_maxThreads == 0)
+    m_maxThreads = 1;
+
+  for (PINDEX i = 0; i < args.GetCount(); ++i)
+    m_filter += args[i] + '\n';
+
+  PString filename = args.GetOptionString("benchmark-output");
+  if (!filename.IsEmpty()) {
+    if (m_file.Open(filename, PFile::WriteOnly))
+      m_results = &m_file;
+    else
+      cerr << "Could not open benchmark output file \"" << filename << "\", using stdout." << endl;
+  }
+}
+
+
+void CodecBenchmark::Run()
+{
+  *m_results << "input,output,threads,frames,seconds,frames_per_sec,ns_per_frame,allocs_per_frame,scaling" << endl;
+
+  OpalTranscoderList transcoders = OpalTranscoderFactory::GetKeyList();
+  PStringArray filter = m_filter.Lines();
+  for (OpalTranscoderIterator it = transcoders.begin(); it != transcoders.end(); ++it) {
+    if (!filter.IsEmpty() &&
+         filter.GetStringsIndex(it->first) == P_MAX_INDEX &&
+         filter.GetStringsIndex(it->second) == P_MAX_INDEX)
+      continue;
+
+    OpalMediaFormat input = it->first;
+    OpalMediaFormat output = it->second;
+    if (input.IsValid() && output.IsValid())
+      RunPair(input, output);
+    else
+      cerr << "Skipping " << it->first << " -> " << it->second << ", unknown media format." << endl;
+  }
+}
+
+
+bool CodecBenchmark::GenerateRaw(const OpalMediaFormat & raw, const OpalMediaFormat & other, PINDEX size, RTP_DataFrameList & frames)
+{
+  if (raw.GetMediaType() == OpalMediaType::Audio()) {
+    // One second of a two tone mix with a little noise, for whatever frame size the codec wants
+    unsigned channels = raw.GetOptionInteger(OpalAudioFormat::ChannelsOption(), 1);
+    unsigned clockRate = raw.GetClockRate();
+    PINDEX samples = size/sizeof(short);
+    if (samples == 0 || clockRate == 0)
+      return false;
+
+    unsigned count = std::max((unsigned)(clockRate*channels/samples), 1U);
+    DWORD timestamp = 0;
+    PINDEX sample = 0;
+    for (unsigned frame = 0; frame < count; ++frame) {
+      RTP_DataFrame * rtp = new RTP_DataFrame(size);
+      rtp->SetPayloadType(raw.GetPayloadType());
+      rtp->SetTimestamp(timestamp);
+      short * pcm = (short *)rtp->GetPayloadPtr();
+      for (PINDEX i = 0; i < samples; ++i, ++sample) {
+        double t = (double)(sample/channels)/clockRate;
+        pcm[i] = (short)(6000*sin(2*M_PI*440*t) + 4000*sin(2*M_PI*1000*t) + PRandom::Number(400) - 200);
+      }
+      frames.Append(rtp);
+      timestamp += samples/channels;
+    }
+    return true;
+  }
+
+#if OPAL_VIDEO
+  if (raw.GetMediaType() == OpalMediaType::Video()) {
+    // A moving pattern, so inter-frame coding has something to do
+    unsigned width = other.GetOptionInteger(OpalVideoFormat::FrameWidthOption(), PVideoFrameInfo::CIFWidth);
+    unsigned height = other.GetOptionInteger(OpalVideoFormat::FrameHeightOption(), PVideoFrameInfo::CIFHeight);
+    PINDEX planeSize = width*height;
+    for (unsigned frame = 0; frame < 30; ++frame) {
+      RTP_DataFrame * rtp = new RTP_DataFrame(sizeof(OpalVideoTranscoder::FrameHeader) + planeSize*3/2);
+      rtp->SetPayloadType(raw.GetPayloadType());
+      rtp->SetTimestamp(frame*OpalMediaFormat::VideoClockRate/30);
+      rtp->SetMarker(true);
+      OpalVideoTranscoder::FrameHeader * header = (OpalVideoTranscoder::FrameHeader *)rtp->GetPayloadPtr();
+      header->x = header->y = 0;
+      header->width = width;
+      header->height = height;
+      BYTE * yuv = OpalVideoFrameDataPtr(header);
+      for (unsigned y = 0; y < height; ++y) {
+        for (unsigned x = 0; x < width; ++x)
+          *yuv++ = (BYTE)((x + y + frame*4) ^ (y*frame/8));
+      }
+      for (PINDEX i = 0; i < planeSize/2; ++i)
+        *yuv++ = (BYTE)(128 + (i + frame)%64 - 32);
+      frames.Append(rtp);
+    }
+    return true;
+  }
+#endif
+
+  return false;
+}
+
+
+bool CodecBenchmark::GenerateInput(const OpalMediaFormat & input, const OpalMediaFormat & output, RTP_DataFrameList & frames)
+{
+  if (!input.IsTransportable()) {
+    std::auto_ptr<OpalTranscoder> transcoder(OpalTranscoder::Create(input, output));
+    return transcoder.get() != NULL && GenerateRaw(input, output, transcoder->GetOptimalDataFrameSize(true), frames);
+  }
+
+  // Encoded input, so make some by encoding raw media
+  OpalMediaFormatList rawFormats = OpalTranscoder::GetSourceFormats(input);
+  for (OpalMediaFormatList::iterator raw = rawFormats.begin(); raw != rawFormats.end(); ++raw) {
+    if (raw->IsTransportable())
+      continue;
+
+    std::auto_ptr<OpalTranscoder> encoder(OpalTranscoder::Create(*raw, input));
+    if (encoder.get() == NULL)
+      continue;
+
+    RTP_DataFrameList rawFrames;
+    if (!GenerateRaw(*raw, input, encoder->GetOptimalDataFrameSize(true), rawFrames))
+      continue;
+
+    for (RTP_DataFrameList::iterator it = rawFrames.begin(); it != rawFrames.end(); ++it) {
+      RTP_DataFrameList encoded;
+      if (encoder->ConvertFrames(*it, encoded)) {
+        for (RTP_DataFrameList::iterator enc = encoded.begin(); enc != encoded.end(); ++enc)
+          frames.Append(new RTP_DataFrame(enc->GetPointer(), enc->GetPacketSize()));
+      }
+    }
+
+    if (!frames.IsEmpty())
+      return true;
+  }
+
+  return false;
+}
+
+
+void CodecBenchmark::RunPair(const OpalMediaFormat & input, const OpalMediaFormat & output)
+{
+  RTP_DataFrameList frames;
+  if (!GenerateInput(input, output, frames)) {
+    cerr << "Skipping " << input << " -> " << output << ", could not generate input." << endl;
+    return;
+  }
+
+  cerr << "Benchmarking " << input << " -> " << output << endl;
+
+  double singleThreadRate = 0;
+  for (unsigned threadCount = 1; threadCount <= m_maxThreads; ++threadCount) {
+    PList<BenchmarkThread> threads;
+    for (unsigned i = 0; i < threadCount; ++i) {
+      OpalTranscoder * transcoder = OpalTranscoder::Create(input, output);
+      if (transcoder == NULL) {
+        cerr << "Could not create transcoder " << input << " -> " << output << endl;
+        return;
+      }
+      threads.Append(new BenchmarkThread(transcoder, frames, m_duration));
+    }
+
+#if PMEMORY_CHECK
+    PMemoryHeap::State before;
+    PMemoryHeap::GetState(before);
+#endif
+
+    for (PINDEX i = 0; i < threads.GetSize(); ++i)
+      threads[i].Resume();
+
+    // Wait for every thread before looking at any results, the threads are
+    // deleted with the list when we return
+    for (PINDEX i = 0; i < threads.GetSize(); ++i)
+      threads[i].WaitForTermination();
+
+    PInt64 totalFrames = 0;
+    PTimeInterval maxElapsed;
+    for (PINDEX i = 0; i < threads.GetSize(); ++i) {
+      if (!threads[i].m_ok) {
+        cerr << "Transcoder " << input << " -> " << output << " failed." << endl;
+        return;
+      }
+      totalFrames += threads[i].m_frames;
+      if (maxElapsed < threads[i].m_elapsed)
+        maxElapsed = threads[i].m_elapsed;
+    }
+
+    double seconds = maxElapsed.GetMilliSeconds()/1000.0;
+    if (totalFrames == 0 || seconds <= 0)
+      return;
+
+    double rate = totalFrames/seconds;
+    if (threadCount == 1)
+      singleThreadRate = rate;
+
+    // Time per frame as seen by one thread, so it grows if threads contend
+    double nsPerFrame = seconds*1e9*threadCount/totalFrames;
+
+    *m_results << input << ',' << output << ','
+               << threadCount << ','
+               << totalFrames << ','
+               << seconds << ','
+               << rate << ','
+               << nsPerFrame << ',';
+#if PMEMORY_CHECK
+    PMemoryHeap::State after;
+    PMemoryHeap::GetState(after);
+    *m_results << (double)(after.allocationNumber - before.allocationNumber)/totalFrames;
+#endif
+    *m_results << ',' << rate/singleThreadRate << endl;
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* Synthetic test audio: talk spurts of a few seconds of harmonic "voice",
+   with syllable rate modulation and a wandering pitch, separated by gaps,
+   all mixed with background noise at a known signal to noise ratio. The
+   ground truth is known for every frame, so the detectors can be scored. */
+
+static const double TalkSpurtSeconds = 1.6;
+static const double TalkCycleSeconds = 3.0;
+static const double SpeechRMS = 3000;
+
+SilenceBenchmark::SilenceBenchmark(PArgList & args)
+  : m_duration(0, args.GetOptionString("benchmark-time", "1").AsUnsigned())
+  , m_clockRate(8000)
+  , m_frameSize(160)
+  , m_seed(1)
+{
+  if (m_duration == 0)
+    m_duration.SetInterval(0, 1);
+}
+
+
+void SilenceBenchmark::Run()
+{
+  static const char * const NoiseNames[NumNoiseTypes] = { "white", "low" };
+  static const double SNRs[] = { 30, 20, 10, 5, 0 };
+  static const OpalSilenceDetector::Modes Modes[] = {
+    OpalSilenceDetector::AdaptiveSilenceDetection,
+    OpalSilenceDetector::SpectralSilenceDetection
+  };
+
+  cout << "Silence detection accuracy, " << TalkSpurtSeconds << "s talk every " << TalkCycleSeconds << "s\n"
+          "noise,snr_db,mode,speech_detected_pct,false_alarm_pct" << endl;
+  for (int noise = 0; noise < NumNoiseTypes; ++noise) {
+    for (PINDEX i = 0; i < PARRAYSIZE(SNRs); ++i) {
+      GenerateAudio((NoiseType)noise, SNRs[i]);
+      for (PINDEX m = 0; m < PARRAYSIZE(Modes); ++m) {
+        double detected, falseAlarms;
+        RunAccuracy(Modes[m], detected, falseAlarms);
+        cout << NoiseNames[noise] << ',' << SNRs[i] << ',' << Modes[m] << ','
+             << fixed << setprecision(1) << detected << ',' << falseAlarms << endl;
+      }
+    }
+  }
+
+  cout << "\nSilence detection speed, " << m_frameSize << " sample frames\n"
+          "mode,frames_per_sec,ns_per_frame,channels_per_core" << endl;
+  GenerateAudio(WhiteNoise, 20);
+  RunSpeed(OpalSilenceDetector::NoSilenceDetection);
+  RunSpeed(OpalSilenceDetector::AdaptiveSilenceDetection);
+  RunSpeed(OpalSilenceDetector::SpectralSilenceDetection);
+
+  cout << "\nComfort noise matching\n"
+          "noise,actual_level,learnt_level,generated_level,actual_tilt,generated_tilt" << endl;
+  for (int noise = 0; noise < NumNoiseTypes; ++noise) {
+    GenerateAudio((NoiseType)noise, 20);
+    cout << NoiseNames[noise] << ',';
+    RunComfortNoise();
+  }
+}
+
+
+void SilenceBenchmark::GenerateAudio(NoiseType noise, double snr)
+{
+  PINDEX frames = (PINDEX)(30*m_clockRate/m_frameSize); // 30 seconds
+  PINDEX samples = frames*m_frameSize;
+  m_audio.resize(samples);
+  m_noise.resize(samples);
+  m_speech.resize(frames);
+
+  /* Noise is uniform white noise, or the same through a first order low
+     pass, like traffic or machinery rumble, scaled to the requested SNR. */
+  double lowPass = noise == LowNoise ? 0.95 : 0;
+  double noiseRMS = SpeechRMS/pow(10, snr/20);
+  double noiseGain = noiseRMS*sqrt(3.0)*sqrt(1 - lowPass*lowPass);
+  double state = 0;
+
+  double phase = 0;
+  for (PINDEX i = 0; i < samples; ++i) {
+    double t = (double)i/m_clockRate;
+
+    m_seed = m_seed*1664525 + 1013904223;
+    state = (int)m_seed/2147483648.0 + lowPass*state;
+    double n = noiseGain*state;
+
+    double voice = 0;
+    double inCycle = fmod(t, TalkCycleSeconds);
+    if (inCycle < TalkSpurtSeconds) {
+      double pitch = 130 + 30*sin(2*M_PI*0.7*t);
+      phase += 2*M_PI*pitch/m_clockRate;
+      // Harmonics with a falling spectrum and formant like bumps
+      for (int h = 1; h*pitch < m_clockRate*0.45; ++h) {
+        double f = h*pitch;
+        double formant = 1 + 2*exp(-pow((f-500)/150, 2)) + 1.5*exp(-pow((f-1500)/200, 2)) + exp(-pow((f-2500)/250, 2));
+        voice += formant/h*sin(h*phase);
+      }
+      // Syllables at about 4 per second, never fully closing
+      voice *= 0.3 + 0.7*fabs(sin(M_PI*4*inCycle));
+      voice *= SpeechRMS/1.2;
+    }
+
+    m_noise[i] = (short)std::max(-32767.0, std::min(n, 32767.0));
+    m_audio[i] = (short)std::max(-32767.0, std::min(voice + n, 32767.0));
+    if (i % m_frameSize == 0)
+      m_speech[i/m_frameSize] = inCycle < TalkSpurtSeconds;
+  }
+}
+
+
+void SilenceBenchmark::RunAccuracy(OpalSilenceDetector::Modes mode, double & detected, double & falseAlarms)
+{
+  OpalPCM16SilenceDetector detector(OpalSilenceDetector::Params(mode));
+  detector.SetClockRate(m_clockRate);
+
+  unsigned speechFrames = 0, speechDetected = 0, silentFrames = 0, silentDetected = 0;
+  for (PINDEX frame = 0; frame < (PINDEX)m_speech.size(); ++frame) {
+    OpalSilenceDetector::Result result = detector.Detect((const BYTE *)&m_audio[frame*m_frameSize],
+                                                         m_frameSize*sizeof(short),
+                                                         (frame+1)*m_frameSize);
+    // Skip the first cycle, while the detectors learn the noise
+    if (frame*m_frameSize < TalkCycleSeconds*m_clockRate)
+      continue;
+    if (m_speech[frame]) {
+      ++speechFrames;
+      if (result != OpalSilenceDetector::IsSilent)
+        ++speechDetected;
+    }
+    else {
+      ++silentFrames;
+      if (result != OpalSilenceDetector::IsSilent)
+        ++silentDetected;
+    }
+  }
+
+  // Note the silence deadband (hangover) makes some false alarms unavoidable
+  detected = speechFrames > 0 ? 100.0*speechDetected/speechFrames : 0;
+  falseAlarms = silentFrames > 0 ? 100.0*silentDetected/silentFrames : 0;
+}
+
+
+void SilenceBenchmark::RunSpeed(OpalSilenceDetector::Modes mode)
+{
+  OpalPCM16SilenceDetector detector(OpalSilenceDetector::Params(mode));
+  detector.SetClockRate(m_clockRate);
+
+  PINDEX frameCount = m_speech.size();
+  PInt64 frames = 0;
+  PTimeInterval elapsed, start = PTimer::Tick();
+  do {
+    for (PINDEX i = 0; i < 50; ++i, ++frames) {
+      PINDEX frame = (PINDEX)(frames % frameCount);
+      if (mode == OpalSilenceDetector::NoSilenceDetection)
+        OpalPCM16SilenceDetector::GetSignalSum(&m_audio[frame*m_frameSize], m_frameSize);
+      else
+        detector.Detect((const BYTE *)&m_audio[frame*m_frameSize], m_frameSize*sizeof(short), (PINDEX)(frames+1)*m_frameSize);
+    }
+    elapsed = PTimer::Tick() - start;
+  } while (elapsed < m_duration);
+
+  double seconds = elapsed.GetMilliSeconds()/1000.0;
+  double rate = frames/seconds;
+  double framesPerChannel = (double)m_clockRate/m_frameSize;
+  cout << (mode == OpalSilenceDetector::NoSilenceDetection ? "GetSignalSum" : (const char *)PSTRSTRM(mode)) << ','
+       << fixed << setprecision(0) << rate << ','
+       << seconds*1e9/frames << ','
+       << rate/framesPerChannel << endl;
+}
+
+
+static double MeanAbs(const short * pcm, size_t samples)
+{
+  return samples > 0 ? (double)OpalPCM16SilenceDetector::GetSignalSum(pcm, samples)/samples : 0;
+}
+
+
+static double LagOneCorrelation(const short * pcm, size_t samples)
+{
+  double r0 = 0, r1 = 0;
+  for (size_t i = 1; i < samples; ++i) {
+    r0 += (double)pcm[i]*pcm[i];
+    r1 += (double)pcm[i]*pcm[i-1];
+  }
+  return r0 > 0 ? r1/r0 : 0;
+}
+
+
+void SilenceBenchmark::RunComfortNoise()
+{
+  // Learn from the mixed audio, as the media stream would
+  OpalPCM16ComfortNoise comfortNoise;
+  for (size_t i = 0; i + m_frameSize <= m_audio.size(); i += m_frameSize)
+    comfortNoise.Analyse(&m_audio[i], m_frameSize);
+
+  std::vector<short> generated(m_clockRate*5);
+  for (size_t i = 0; i + m_frameSize <= generated.size(); i += m_frameSize)
+    comfortNoise.Generate(&generated[i], m_frameSize);
+
+  cout << fixed << setprecision(1)
+       << MeanAbs(&m_noise[0], m_noise.size()) << ','
+       << comfortNoise.GetNoiseLevel() << ','
+       << MeanAbs(&generated[0], generated.size()) << ','
+       << setprecision(3)
+       << LagOneCorrelation(&m_noise[0], m_noise.size()) << ','
+       << LagOneCorrelation(&generated[0], generated.size()) << endl;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+#if OPAL_AEC
+
+/* The far end is bursts of shaped noise with a syllable envelope, played
+   through a synthetic echo path: a bulk delay then an exponentially decaying
+   random impulse response, 6dB down overall. The near end microphone is the
+   echo, some room noise, and every few seconds the near party talking over
+   the far end (double talk). ERLE is measured only where the far end talks
+   alone, after the first few seconds of convergence. */
+
+static const unsigned EchoSeconds = 20;
+static const unsigned EchoConvergeSeconds = 5;
+
+static int EchoNoise(PUInt32 & seed, int range)
+{
+  seed = seed*1664525 + 1013904223;
+  return (int)((seed >> 8) % (2*range + 1)) - range;
+}
+
+EchoBenchmark::EchoBenchmark(PArgList & args)
+  : m_duration(0, args.GetOptionString("benchmark-time", "1").AsUnsigned())
+  , m_clockRate(8000)
+  , m_frameSize(160)
+  , m_channels(std::max(1U, args.GetOptionString("echo-channels", "32").AsUnsigned()))
+{
+  if (m_duration == 0)
+    m_duration.SetInterval(0, 1);
+}
+
+
+void EchoBenchmark::Run()
+{
+  static const unsigned Tails[] = { 256, 1024, 2000 };
+
+  cout << "Echo canceller, " << EchoSeconds << "s of audio, ERLE after " << EchoConvergeSeconds << "s, "
+          "NLMS-batch is " << m_channels << " calls on the per core workers, timed by CPU used\n"
+          "algorithm,tail_samples,erle_db,frames_per_sec,ns_per_frame,channels_per_core" << endl;
+  for (PINDEX i = 0; i < PARRAYSIZE(Tails); ++i) {
+    GenerateAudio(Tails[i]);
+    RunAlgorithm(OpalEchoCanceler::SpeexAlgorithm, Tails[i]);
+    RunAlgorithm(OpalEchoCanceler::NLMSAlgorithm, Tails[i]);
+    RunBatched(Tails[i]);
+  }
+}
+
+
+void EchoBenchmark::GenerateAudio(unsigned tail)
+{
+  PUInt32 seed = 1;
+
+  // Echo path, bulk delay of an eighth of the tail, rest decays by 60dB
+  std::vector<double> impulse(tail);
+  unsigned delay = tail/8;
+  double decay = pow(0.001, 1.0/(tail - delay));
+  double gain = 1, energy = 0;
+  for (unsigned i = delay; i < tail; ++i, gain *= decay) {
+    impulse[i] = gain*EchoNoise(seed, 1000)/1000.0;
+    energy += impulse[i]*impulse[i];
+  }
+  double scale = 0.5/sqrt(energy);
+  for (unsigned i = 0; i < tail; ++i)
+    impulse[i] *= scale;
+
+  PINDEX samples = EchoSeconds*m_clockRate;
+  m_farEnd.resize(samples);
+  m_nearEnd.resize(samples);
+  m_farOnly.resize(samples/m_frameSize);
+
+  double farState = 0, nearState = 0;
+  for (PINDEX i = 0; i < samples; ++i) {
+    double t = (double)i/m_clockRate;
+
+    // Far end talks 2s in every 3s, near end 1s in every 7s
+    double farEnvelope = fmod(t, 3) < 2 ? 0.3 + 0.7*fabs(sin(M_PI*4*t)) : 0;
+    double nearEnvelope = fmod(t, 7) > 6 ? 0.3 + 0.7*fabs(sin(M_PI*3*t)) : 0;
+
+    farState = EchoNoise(seed, 1000) + 0.9*farState;
+    nearState = EchoNoise(seed, 1000) + 0.8*nearState;
+    m_farEnd[i] = (short)(farEnvelope*farState*3);
+
+    double echo = 0;
+    for (unsigned j = delay; j < tail && j <= (unsigned)i; ++j)
+      echo += impulse[j]*m_farEnd[i-j];
+    double roomNoise = EchoNoise(seed, 30);
+    m_nearEnd[i] = (short)std::max(-32767.0, std::min(echo + nearEnvelope*nearState*3 + roomNoise, 32767.0));
+
+    if (i % m_frameSize == 0)
+      m_farOnly[i/m_frameSize] = farEnvelope > 0 && nearEnvelope == 0 && t >= EchoConvergeSeconds;
+  }
+}
+
+
+void EchoBenchmark::RunAlgorithm(OpalEchoCanceler::Algorithm algorithm, unsigned tail)
+{
+  OpalEchoCanceler::Params params;
+  params.m_enabled = true;
+  params.m_duration = tail;
+  params.m_algorithm = algorithm;
+
+  OpalEchoCanceler canceler;
+  canceler.SetParameters(params);
+  canceler.SetClockRate(m_clockRate);
+
+  RTP_DataFrame farFrame(m_frameSize*sizeof(short));
+  RTP_DataFrame nearFrame(m_frameSize*sizeof(short));
+
+  // One pass for the ERLE
+  double micEnergy = 0, residualEnergy = 0;
+  PINDEX frameCount = m_farOnly.size();
+  for (PINDEX frame = 0; frame < frameCount; ++frame) {
+    memcpy(farFrame.GetPayloadPtr(), &m_farEnd[frame*m_frameSize], m_frameSize*sizeof(short));
+    memcpy(nearFrame.GetPayloadPtr(), &m_nearEnd[frame*m_frameSize], m_frameSize*sizeof(short));
+    canceler.GetSendHandler()(farFrame, 0);
+    canceler.GetReceiveHandler()(nearFrame, 0);
+
+    if (m_farOnly[frame]) {
+      const short * mic = &m_nearEnd[frame*m_frameSize];
+      const short * residual = (const short *)nearFrame.GetPayloadPtr();
+      for (PINDEX i = 0; i < m_frameSize; ++i) {
+        micEnergy += (double)mic[i]*mic[i];
+        residualEnergy += (double)residual[i]*residual[i];
+      }
+    }
+  }
+  double erle = 10*log10((micEnergy + 1)/(residualEnergy + 1));
+
+  // Then repeat the audio for the CPU cost
+  PInt64 frames = 0;
+  PTimeInterval elapsed, start = PTimer::Tick();
+  do {
+    PINDEX frame = (PINDEX)(frames++ % frameCount);
+    memcpy(farFrame.GetPayloadPtr(), &m_farEnd[frame*m_frameSize], m_frameSize*sizeof(short));
+    memcpy(nearFrame.GetPayloadPtr(), &m_nearEnd[frame*m_frameSize], m_frameSize*sizeof(short));
+    canceler.GetSendHandler()(farFrame, 0);
+    canceler.GetReceiveHandler()(nearFrame, 0);
+    elapsed = PTimer::Tick() - start;
+  } while (elapsed < m_duration);
+
+  double seconds = elapsed.GetMilliSeconds()/1000.0;
+  double rate = frames/seconds;
+  cout << (algorithm == OpalEchoCanceler::NLMSAlgorithm ? "NLMS" : "Speex") << ','
+       << tail << ','
+       << fixed << setprecision(1) << erle << ','
+       << setprecision(0) << rate << ','
+       << seconds*1e9/frames << ','
+       << rate*m_frameSize/m_clockRate << endl;
+}
+
+
+/* Each call has its own thread feeding its canceler, as a media patch would,
+   and Params::m_batched has the cancelling done on the shared workers. As
+   the threads mostly wait on the workers, the speed is taken from the CPU
+   used by the whole process rather than the elapsed time. */
+void EchoBenchmark::RunBatched(unsigned tail)
+{
+  OpalEchoCanceler::Params params;
+  params.m_enabled = true;
+  params.m_duration = tail;
+  params.m_algorithm = OpalEchoCanceler::NLMSAlgorithm;
+  params.m_batched = true;
+
+  std::vector<Channel> channels(m_channels);
+  for (size_t i = 0; i < channels.size(); ++i) {
+    channels[i].m_canceler = new OpalEchoCanceler;
+    channels[i].m_canceler->SetParameters(params);
+    channels[i].m_canceler->SetClockRate(m_clockRate);
+  }
+
+  RunChannels(channels, &EchoBenchmark::ChannelERLE);
+
+  PProcess::Times before, after;
+  PProcess::Current().GetTimes(before);
+  m_timedStart = PTimer::Tick();
+  RunChannels(channels, &EchoBenchmark::ChannelTimed);
+  PProcess::Current().GetTimes(after);
+
+  double micEnergy = 0, residualEnergy = 0;
+  PInt64 frames = 0;
+  for (size_t i = 0; i < channels.size(); ++i) {
+    micEnergy += channels[i].m_micEnergy;
+    residualEnergy += channels[i].m_residualEnergy;
+    frames += channels[i].m_frames;
+    delete channels[i].m_canceler;
+  }
+  double erle = 10*log10((micEnergy + 1)/(residualEnergy + 1));
+
+  PTimeInterval cpu = (after.m_kernel + after.m_user) - (before.m_kernel + before.m_user);
+  double seconds = std::max(cpu.GetMilliSeconds(), (PInt64)1)/1000.0;
+  double rate = frames/seconds;
+  cout << "NLMS-batch,"
+       << tail << ','
+       << fixed << setprecision(1) << erle << ','
+       << setprecision(0) << rate << ','
+       << seconds*1e9/std::max(frames, (PInt64)1) << ','
+       << rate*m_frameSize/m_clockRate << endl;
+}
+
+
+void EchoBenchmark::RunChannels(std::vector<Channel> & channels, void (EchoBenchmark::*function)(Channel &))
+{
+  PList<PThread> threads;
+  for (size_t i = 0; i < channels.size(); ++i)
+    threads.Append(new PThreadObj1Arg<EchoBenchmark, Channel &>(*this, channels[i], function, false, "Echo"));
+  for (PList<PThread>::iterator it = threads.begin(); it != threads.end(); ++it)
+    it->WaitForTermination();
+}
+
+
+void EchoBenchmark::ChannelERLE(Channel & channel)
+{
+  RTP_DataFrame farFrame(m_frameSize*sizeof(short));
+  RTP_DataFrame nearFrame(m_frameSize*sizeof(short));
+
+  PINDEX frameCount = m_farOnly.size();
+  for (PINDEX frame = 0; frame < frameCount; ++frame) {
+    memcpy(farFrame.GetPayloadPtr(), &m_farEnd[frame*m_frameSize], m_frameSize*sizeof(short));
+    memcpy(nearFrame.GetPayloadPtr(), &m_nearEnd[frame*m_frameSize], m_frameSize*sizeof(short));
+    channel.m_canceler->GetSendHandler()(farFrame, 0);
+    channel.m_canceler->GetReceiveHandler()(nearFrame, 0);
+
+    if (m_farOnly[frame]) {
+      const short * mic = &m_nearEnd[frame*m_frameSize];
+      const short * residual = (const short *)nearFrame.GetPayloadPtr();
+      for (PINDEX i = 0; i < m_frameSize; ++i) {
+        channel.m_micEnergy += (double)mic[i]*mic[i];
+        channel.m_residualEnergy += (double)residual[i]*residual[i];
+      }
+    }
+  }
+}
+
+
+void EchoBenchmark::ChannelTimed(Channel & channel)
+{
+  RTP_DataFrame farFrame(m_frameSize*sizeof(short));
+  RTP_DataFrame nearFrame(m_frameSize*sizeof(short));
+
+  PINDEX frameCount = m_farOnly.size();
+  do {
+    PINDEX frame = (PINDEX)(channel.m_frames++ % frameCount);
+    memcpy(farFrame.GetPayloadPtr(), &m_farEnd[frame*m_frameSize], m_frameSize*sizeof(short));
+    memcpy(nearFrame.GetPayloadPtr(), &m_nearEnd[frame*m_frameSize], m_frameSize*sizeof(short));
+    channel.m_canceler->GetSendHandler()(farFrame, 0);
+    channel.m_canceler->GetReceiveHandler()(nearFrame, 0);
+  } while (PTimer::Tick() - m_timedStart < m_duration);
+}
+
+#endif // OPAL_AEC
+
+
+///////////////////////////////////////////////////////////////////////////////
+
 int TranscoderThread::InitialiseCodec(PArgList & args,
                                       const OpalMediaType & mediaType,
                                       OpalMediaFormat & mediaFormat,
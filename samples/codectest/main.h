@@ -29,6 +29,8 @@
 #include <codec/vidcodec.h>
 #include <opal/patch.h>
 #include <rtp/pcapfile.h>
+#include <codec/silencedetect.h>
+#include <codec/echocancel.h>
 
 class TranscoderThread : public PThread
 {
@@ -183,6 +185,105 @@ class VideoThread : public TranscoderThread
 };
 
 
+class BenchmarkThread : public PThread
+{
+  public:
+    BenchmarkThread(OpalTranscoder * transcoder, const RTP_DataFrameList & input, const PTimeInterval & duration);
+    ~BenchmarkThread() { delete m_transcoder; }
+
+    virtual void Main();
+
+    OpalTranscoder  * m_transcoder;
+    RTP_DataFrameList m_input;
+    PTimeInterval     m_duration;
+    PTimeInterval     m_elapsed;
+    PInt64            m_frames;
+    bool              m_ok;
+};
+
+
+class CodecBenchmark
+{
+  public:
+    CodecBenchmark(PArgList & args);
+
+    void Run();
+
+  protected:
+    bool GenerateRaw(const OpalMediaFormat & raw, const OpalMediaFormat & other, PINDEX size, RTP_DataFrameList & frames);
+    bool GenerateInput(const OpalMediaFormat & input, const OpalMediaFormat & output, RTP_DataFrameList & frames);
+    void RunPair(const OpalMediaFormat & input, const OpalMediaFormat & output);
+
+    PTimeInterval m_duration;
+    unsigned      m_maxThreads;
+    PString       m_filter;
+    PTextFile     m_file;
+    ostream     * m_results;
+};
+
+
+class SilenceBenchmark
+{
+  public:
+    SilenceBenchmark(PArgList & args);
+
+    void Run();
+
+  protected:
+    enum NoiseType { WhiteNoise, LowNoise, NumNoiseTypes };
+    void GenerateAudio(NoiseType noise, double snr);
+    void RunAccuracy(OpalSilenceDetector::Modes mode, double & detected, double & falseAlarms);
+    void RunSpeed(OpalSilenceDetector::Modes mode);
+    void RunComfortNoise();
+
+    PTimeInterval      m_duration;
+    unsigned           m_clockRate;
+    PINDEX             m_frameSize;
+    std::vector<short> m_audio;
+    std::vector<short> m_noise;
+    std::vector<bool>  m_speech;
+    PUInt32            m_seed;
+};
+
+
+#if OPAL_AEC
+class EchoBenchmark
+{
+  public:
+    EchoBenchmark(PArgList & args);
+
+    void Run();
+
+  protected:
+    struct Channel
+    {
+      Channel() : m_canceler(NULL), m_micEnergy(0), m_residualEnergy(0), m_frames(0) { }
+
+      OpalEchoCanceler * m_canceler;
+      double             m_micEnergy;
+      double             m_residualEnergy;
+      PInt64             m_frames;
+    };
+
+    void GenerateAudio(unsigned tail);
+    void RunAlgorithm(OpalEchoCanceler::Algorithm algorithm, unsigned tail);
+    void RunBatched(unsigned tail);
+    void RunChannels(std::vector<Channel> & channels, void (EchoBenchmark::*function)(Channel &));
+    void ChannelERLE(Channel & channel);
+    void ChannelTimed(Channel & channel);
+
+    PTimeInterval      m_duration;
+    unsigned           m_clockRate;
+    PINDEX             m_frameSize;
+    unsigned           m_channels;
+    PTimeInterval      m_timedStart;
+    std::vector<short> m_farEnd;
+    std::vector<short> m_nearEnd;
+    std::vector<bool>  m_farOnly;
+};
+#endif // OPAL_AEC
+
+
 class CodecTest : public PProcess
 {
   PCLASSINFO(CodecTest, PProcess)
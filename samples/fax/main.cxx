@@ -64,6 +64,7 @@ PString MyManager::GetArgumentSpec() const
          "e-switch-on-ced. Switch to T.38 on receipt of CED tone as caller.\n"
          "X-switch-time: Set fail safe T.38 switch time in seconds.\n"
          "T-timeout: Set timeout to wait for fax rx/tx to complete in seconds.\n"
+         "-calls: Number of faxes to receive before exiting, default 1.\n"
          "q-quiet. Only output error conditions.\n"
 #if OPAL_STATISTICS
          "v-verbose. Output statistics during fax operation\n"
@@ -92,7 +93,9 @@ void MyManager::Usage(ostream & strm, const PArgList & args)
   strm << "\n"
           "e.g. " << args.GetCommandName() << " --option 'T.38:Header-Info=My custom header line' send_fax.tif sip:fred@bloggs.com\n"
           "\n"
-          "     " << args.GetCommandName() << " received_fax.tif\n\n";
+          "     " << args.GetCommandName() << " received_fax.tif\n"
+          "\n"
+          "     " << args.GetCommandName() << " --calls 10 'received_fax_<du>.tif'\n\n";
 }
 
 
@@ -181,26 +184,34 @@ bool MyManager::Initialise(PArgList & args, bool, const PString &)
 
   PString tiff = args[0];
   if (args.GetCount() == 1) {
+    // Route macros such as <du> in the file name give each call its own file
+    m_expectedCalls = std::max(1U, args.GetOptionString("calls", "1").AsUnsigned());
     output << "Receive directory: " << faxEP->GetDefaultDirectory() << "\n"
             "\n"
-            "Awaiting incoming fax, saving as " << tiff << " ..." << endl;
+            "Awaiting " << m_expectedCalls << " incoming fax(es), saving as " << tiff << " ..." << endl;
     return true;
   }
 
-  bool atLeastOne = false;
+  // Early calls may clear before the last is started, so assume all will be
+  m_expectedCalls = args.GetCount() - 1;
+  unsigned started = 0;
 
   output << '\n';
   for (PINDEX arg = 1; arg < args.GetCount(); ++arg) {
     PString destination = args[arg];
     if (SetUpCall(prefix + ":" + tiff, destination) != NULL)
-      atLeastOne = true;
+      ++started;
     else
       output << "Could not start call to \"" << destination << '"' << endl;
     output << "Sending " << tiff << " to " << destination << endl;
   }
   output << "Awaiting transmission ..." << endl;
 
-  return atLeastOne;
+  m_expectedCalls = started;
+  if (started > 0 && m_clearedCalls >= started)
+    EndRun();
+
+  return started > 0;
 }
 
 
@@ -277,7 +288,7 @@ void MyManager::OnClearedCall(OpalCall & call)
       *LockedOutput() << "Call error: " << OpalConnection::GetCallEndReasonText(call.GetCallEndReason());
   }
 
-  if (GetCallCount() == 1)
+  if (++m_clearedCalls >= m_expectedCalls)
     EndRun();
 }
 
@@ -32,6 +32,8 @@ class MyManager : public OpalManagerConsole
     PCLASSINFO(MyManager, OpalManagerConsole)
 
   public:
+    MyManager() : m_expectedCalls(1), m_clearedCalls(0), m_showProgress(false) { }
+
     virtual PString GetArgumentSpec() const;
     virtual void Usage(ostream & strm, const PArgList & args);
     virtual bool Initialise(PArgList & args, bool verbose, const PString & defaultRoute = PString::Empty());
@@ -39,8 +41,10 @@ class MyManager : public OpalManagerConsole
     virtual void OnClearedCall(OpalCall & call); // Callback override
 
   private:
-    PSimpleTimer m_competionTimeout;
-    bool         m_showProgress;
+    PSimpleTimer     m_competionTimeout;
+    atomic<unsigned> m_expectedCalls;
+    atomic<unsigned> m_clearedCalls;
+    bool             m_showProgress;
 };
 
 
@@ -91,7 +91,69 @@ function test_fax()
   fi
 }
 
-if [ $# -ge 3 ]; then
+function gateway_calls()
+{
+  # $1 is number of parallel calls, $2 is a tag for the result files
+  # Tracing is off, it would dominate the CPU used
+  XX_ARG="--no-lid --no-capi --no-h323 --timeout 2:30"
+
+  # One process receives every call, so all its gateways share one pool.
+  # The dialled user is the call number, and names the received file.
+  RESULT_PREFIX="$RESULT_DIR/gateway_${2}_${1}_"
+  RX_TIME=""
+  if [ -x /usr/bin/time ]; then
+    RX_TIME="/usr/bin/time -f %U+%S -o ${RESULT_PREFIX}rx.cpu"
+  fi
+  $RX_TIME $FAXOPAL $XX_ARG --sip $HOST:15060 --calls $1 "${RESULT_PREFIX}rx_<du>.tif" < /dev/null > ${RESULT_PREFIX}rx.out 2>&1 &
+  sleep 2
+
+  DEST_URLS=""
+  for (( CALL=0; CALL < $1; CALL++ )); do
+    DEST_URLS+=" sip:$CALL@$HOST:15060"
+  done
+
+  START=`date +%s`
+  $FAXOPAL $XX_ARG --sip $HOST:25060 --audio $CURDIR/F06_200.tif $DEST_URLS < /dev/null > ${RESULT_PREFIX}tx.out 2>&1 &
+  wait
+  ELAPSED=$(( `date +%s` - START ))
+
+  TX_PASSED=`grep -c Success ${RESULT_PREFIX}tx.out`
+  RX_PASSED=`grep -c Success ${RESULT_PREFIX}rx.out`
+  PASSED=$(( TX_PASSED < RX_PASSED ? TX_PASSED : RX_PASSED ))
+
+  RX_CPU="unknown"
+  if [ -s ${RESULT_PREFIX}rx.cpu ]; then
+    RX_CPU="`tail -1 ${RESULT_PREFIX}rx.cpu | awk -F+ '{ print $1 + $2 }'`s"
+  fi
+}
+
+
+function test_gateway()
+{
+  # G.711 sender, T.38 receiver, so the receiver runs a T38_PCM gateway per call
+  MAX_CALLS=${1:-64}
+  CAPACITY=0
+  CALLS=1
+  while [ $CALLS -le $MAX_CALLS ]; do
+    echo -n "Performing gateway test ($2) with $CALLS parallel calls ... "
+    gateway_calls $CALLS $2
+    echo "$PASSED successful in ${ELAPSED}s, receiver CPU $RX_CPU."
+    if [ $PASSED -ne $CALLS ]; then
+      break
+    fi
+    CAPACITY=$CALLS
+    CALLS=$(( CALLS * 2 ))
+  done
+  echo "Gateway capacity ($2): $CAPACITY parallel calls"
+}
+
+
+if [ "$1" = "gateway" ]; then
+  unset SPANDSP_GATEWAY_THREADS
+  test_gateway "$2" media-threads
+  export SPANDSP_GATEWAY_THREADS=${GATEWAY_THREADS:-`getconf _NPROCESSORS_ONLN`}
+  test_gateway "$2" "$SPANDSP_GATEWAY_THREADS-workers"
+elif [ $# -ge 3 ]; then
   test_fax $*
 elif [ $# = 0 ]; then
   test_fax sip t38  t38
@@ -110,5 +172,6 @@ elif [ $# = 0 ]; then
   test_fax h323 g711 g711 slow
 else
   echo "usage: $0 { sip | h323 } { t38 | g711 } { t38 | g711 } [ slow | fast ]"
+  echo "       $0 gateway [ max-parallel-calls ]"
 fi
 
@@ -0,0 +1,380 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for bandwidth estimation simulator
+ *
+ * Copyright (c) 2017 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <ptlib/pprocess.h>
+#include <ptclib/random.h>
+#include <rtp/rtp_bwe.h>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+
+
+/* Everything runs in virtual time, in microseconds, stepped one millisecond
+   at a time. A sender, either replaying a packet trace or a synthetic video
+   encoder following the estimate, feeds an optional pacer and then a single
+   drop tail bottleneck. The receiver reports arrival times every feedback
+   interval, exactly as transport wide congestion control does, and the
+   reports are given to RTP_BandwidthEstimator after the return path delay. */
+
+class BWESim : public PProcess
+{
+    PCLASSINFO(BWESim, PProcess)
+  public:
+    BWESim();
+
+    virtual void Main();
+
+  protected:
+    struct Packet
+    {
+      Packet(PInt64 created = 0, unsigned size = 0) : m_created(created), m_size(size), m_sequenceNumber(0), m_sent(0), m_arrival(0) { }
+      PInt64   m_created;
+      unsigned m_size;
+      unsigned m_sequenceNumber;
+      PInt64   m_sent;
+      PInt64   m_arrival;
+    };
+
+    struct Feedback
+    {
+      PInt64 m_due;
+      std::vector<Packet> m_packets;
+      unsigned m_lost;
+    };
+
+    bool LoadTrace(const PString & filename);
+    bool SetBottleneck(const PString & spec);
+    unsigned GetCapacity(PInt64 now) const;
+    void Encode(PInt64 now);
+    void Send(Packet & packet, PInt64 now);
+
+    RTP_BandwidthEstimator m_estimator;
+
+    std::deque<Packet> m_trace;
+    unsigned m_frameRate;
+    unsigned m_keyFrameInterval;
+    unsigned m_maxPacketSize;
+    PInt64   m_nextFrame;
+    unsigned m_frameCount;
+
+    bool     m_pacing;
+    PInt64   m_pacerNextSend;
+    std::deque<Packet> m_pacerQueue;
+
+    std::map<PInt64, unsigned> m_capacity; // Time -> bits/second
+    PInt64   m_queueLimit;
+    PInt64   m_propagation;
+    double   m_randomLoss;
+    PInt64   m_linkFree;
+    unsigned m_nextSequenceNumber;
+
+    std::deque<Packet> m_inFlight;
+    std::vector<Packet> m_arrived;
+    unsigned m_highestReported;
+    std::deque<Feedback> m_feedback;
+
+    // Per second and total statistics
+    struct Stats
+    {
+      Stats() : m_sentBytes(0), m_deliveredBytes(0), m_packets(0), m_lost(0), m_delaySum(0) { }
+      PUInt64  m_sentBytes;
+      PUInt64  m_deliveredBytes;
+      unsigned m_packets;
+      unsigned m_lost;
+      PInt64   m_delaySum;
+    };
+    Stats m_second;
+    Stats m_total;
+    std::vector<PInt64> m_delays;
+};
+
+
+PCREATE_PROCESS(BWESim);
+
+
+BWESim::BWESim()
+  : PProcess("Open Phone Abstraction Library", "Bandwidth Estimation Simulator", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_BUILD)
+  , m_frameRate(30)
+  , m_keyFrameInterval(0)
+  , m_maxPacketSize(1200)
+  , m_nextFrame(0)
+  , m_frameCount(0)
+  , m_pacing(false)
+  , m_pacerNextSend(0)
+  , m_queueLimit(300000)
+  , m_propagation(40000)
+  , m_randomLoss(0)
+  , m_linkFree(0)
+  , m_nextSequenceNumber(0)
+  , m_highestReported(0)
+{
+}
+
+
+void BWESim::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "t-trace: Replay packet trace file, lines of \"<ms> <bytes>\"\n"
+             "r-frame-rate: Synthetic encoder frame rate, default 30\n"
+             "k-key-frame: Synthetic encoder key frame interval in seconds, default none\n"
+             "b-bottleneck: Capacity schedule \"kbps[@sec],...\", default 1000\n"
+             "q-queue: Bottleneck queue limit in ms, default 300\n"
+             "d-delay: One way propagation delay in ms, default 40\n"
+             "l-loss: Random loss percentage, default 0\n"
+             "D-duration: Simulation length in seconds, default 60\n"
+             "F-feedback: Feedback interval in ms, default 100\n"
+             "p-pacing. Pace packets at 2.5 times the estimate\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed()|| args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  if (args.HasOption('t') && !LoadTrace(args.GetOptionString('t')))
+    return;
+
+  if (!SetBottleneck(args.GetOptionString('b', "1000")))
+    return;
+
+  m_frameRate = std::max(1U, args.GetOptionString('r', "30").AsUnsigned());
+  m_keyFrameInterval = args.GetOptionString('k').AsUnsigned();
+  m_queueLimit = args.GetOptionString('q', "300").AsUnsigned()*1000LL;
+  m_propagation = args.GetOptionString('d', "40").AsUnsigned()*1000LL;
+  m_randomLoss = args.GetOptionString('l', "0").AsReal()/100;
+  m_pacing = args.HasOption('p');
+  PInt64 duration = args.GetOptionString('D', "60").AsUnsigned()*1000000LL;
+  PInt64 feedbackInterval = std::max(1U, args.GetOptionString('F', "100").AsUnsigned())*1000LL;
+  PInt64 nextFeedback = feedbackInterval;
+
+  cout << "  Time  Capacity    Target      Sent Delivered  Delay   Loss\n"
+          "   (s)    (kb/s)    (kb/s)    (kb/s)    (kb/s)   (ms)    (%)\n";
+
+  for (PInt64 now = 0; now < duration; now += 1000) {
+    // Sender
+    if (m_trace.empty())
+      Encode(now);
+    else {
+      while (!m_trace.empty() && m_trace.front().m_created <= now) {
+        m_pacerQueue.push_back(m_trace.front());
+        m_trace.pop_front();
+      }
+    }
+
+    while (!m_pacerQueue.empty() && (!m_pacing || m_pacerNextSend <= now)) {
+      Packet & packet = m_pacerQueue.front();
+      if (m_pacing) {
+        m_pacerNextSend = std::max(m_pacerNextSend, now - 5000);
+        m_pacerNextSend += packet.m_size*8*1000000LL*2/(m_estimator.GetTargetBitRate()*5LL);
+      }
+      Send(packet, now);
+      m_pacerQueue.pop_front();
+    }
+
+    // Receiver
+    while (!m_inFlight.empty() && m_inFlight.front().m_arrival <= now) {
+      Packet & packet = m_inFlight.front();
+      PInt64 delay = packet.m_arrival - packet.m_created;
+      m_second.m_deliveredBytes += packet.m_size;
+      m_second.m_delaySum += delay;
+      ++m_second.m_packets;
+      m_delays.push_back(delay);
+      m_arrived.push_back(packet);
+      m_inFlight.pop_front();
+    }
+
+    if (now >= nextFeedback) {
+      nextFeedback += feedbackInterval;
+      if (!m_arrived.empty()) {
+        Feedback feedback;
+        feedback.m_due = now + m_propagation;
+        feedback.m_packets.swap(m_arrived);
+        unsigned highest = feedback.m_packets.back().m_sequenceNumber;
+        unsigned expected = highest - m_highestReported;
+        feedback.m_lost = expected > feedback.m_packets.size() ? expected - feedback.m_packets.size() : 0;
+        m_highestReported = highest;
+        m_feedback.push_back(feedback);
+      }
+    }
+
+    // Sender receives the feedback
+    while (!m_feedback.empty() && m_feedback.front().m_due <= now) {
+      Feedback & feedback = m_feedback.front();
+      PTimeInterval tick = PTimeInterval::MicroSeconds(now);
+      for (size_t i = 0; i < feedback.m_packets.size(); ++i)
+        m_estimator.OnPacketFeedback(PTimeInterval::MicroSeconds(feedback.m_packets[i].m_sent),
+                                     PTimeInterval::MicroSeconds(feedback.m_packets[i].m_arrival),
+                                     feedback.m_packets[i].m_size, tick);
+      m_estimator.OnFeedbackComplete(feedback.m_packets.size(), feedback.m_lost, tick);
+      m_feedback.pop_front();
+    }
+
+    if ((now+1000) % 1000000 == 0) {
+      cout << setw(6) << (now+1000)/1000000
+           << setw(10) << GetCapacity(now)/1000
+           << setw(10) << m_estimator.GetTargetBitRate()/1000
+           << setw(10) << m_second.m_sentBytes*8/1000
+           << setw(10) << m_second.m_deliveredBytes*8/1000
+           << setw(7) << (m_second.m_packets > 0 ? m_second.m_delaySum/m_second.m_packets/1000 : 0)
+           << setw(7) << fixed << setprecision(1)
+           << (m_second.m_lost > 0 ? 100.0*m_second.m_lost/(m_second.m_lost + m_second.m_packets) : 0.0)
+           << endl;
+      m_total.m_sentBytes += m_second.m_sentBytes;
+      m_total.m_deliveredBytes += m_second.m_deliveredBytes;
+      m_total.m_packets += m_second.m_packets;
+      m_total.m_lost += m_second.m_lost;
+      m_total.m_delaySum += m_second.m_delaySum;
+      m_second = Stats();
+    }
+  }
+
+  PUInt64 capacityBits = 0;
+  for (PInt64 t = 0; t < duration; t += 1000)
+    capacityBits += GetCapacity(t)/1000;
+
+  PInt64 p95 = 0;
+  if (!m_delays.empty()) {
+    std::sort(m_delays.begin(), m_delays.end());
+    p95 = m_delays[m_delays.size()*95/100];
+  }
+
+  cout << "\nUtilisation: " << setprecision(1) << (capacityBits > 0 ? 100.0*m_total.m_deliveredBytes*8/capacityBits : 0.0) << "%\n"
+          "Mean delay:  " << (m_total.m_packets > 0 ? m_total.m_delaySum/m_total.m_packets/1000 : 0) << "ms\n"
+          "95% delay:   " << p95/1000 << "ms\n"
+          "Loss:        " << (m_total.m_lost > 0 ? 100.0*m_total.m_lost/(m_total.m_lost + m_total.m_packets) : 0.0) << '%'
+       << endl;
+}
+
+
+bool BWESim::LoadTrace(const PString & filename)
+{
+  PTextFile file;
+  if (!file.Open(filename, PFile::ReadOnly)) {
+    cerr << "Could not open " << filename << endl;
+    return false;
+  }
+
+  PString line;
+  while (file.ReadLine(line)) {
+    line = line.Trim();
+    if (line.IsEmpty() || line[0] == '#')
+      continue;
+
+    PStringArray fields = line.Tokenise(" \t,", false);
+    if (fields.GetSize() < 2) {
+      cerr << "Invalid trace line: " << line << endl;
+      return false;
+    }
+
+    m_trace.push_back(Packet((PInt64)(fields[0].AsReal()*1000), fields[1].AsUnsigned()));
+  }
+
+  if (m_trace.empty()) {
+    cerr << "No packets in " << filename << endl;
+    return false;
+  }
+
+  // Start the replay at time zero
+  PInt64 start = m_trace.front().m_created;
+  for (std::deque<Packet>::iterator it = m_trace.begin(); it != m_trace.end(); ++it)
+    it->m_created -= start;
+
+  cout << "Loaded " << m_trace.size() << " packets from " << filename << endl;
+  return true;
+}
+
+
+bool BWESim::SetBottleneck(const PString & spec)
+{
+  PStringArray steps = spec.Tokenise(",", false);
+  for (PINDEX i = 0; i < steps.GetSize(); ++i) {
+    PString kbps, seconds;
+    if (!steps[i].Split('@', kbps, seconds))
+      kbps = steps[i];
+    unsigned rate = kbps.AsUnsigned()*1000;
+    if (rate == 0) {
+      cerr << "Invalid bottleneck capacity: " << steps[i] << endl;
+      return false;
+    }
+    m_capacity[(PInt64)(seconds.AsReal()*1000000)] = rate;
+  }
+
+  return !m_capacity.empty();
+}
+
+
+unsigned BWESim::GetCapacity(PInt64 now) const
+{
+  std::map<PInt64, unsigned>::const_iterator it = m_capacity.upper_bound(now);
+  return it == m_capacity.begin() ? it->second : (--it)->second;
+}
+
+
+void BWESim::Encode(PInt64 now)
+{
+  if (now < m_nextFrame)
+    return;
+
+  m_nextFrame += 1000000/m_frameRate;
+
+  // Encoder follows the estimate, key frames are bigger and steal from the frames after them
+  unsigned frameSize = m_estimator.GetTargetBitRate()/m_frameRate/8;
+  if (m_keyFrameInterval > 0 && m_frameCount % (m_keyFrameInterval*m_frameRate) == 0)
+    frameSize *= 5;
+  ++m_frameCount;
+
+  while (frameSize > 0) {
+    unsigned size = std::min(frameSize, m_maxPacketSize);
+    m_pacerQueue.push_back(Packet(now, size));
+    frameSize -= size;
+  }
+}
+
+
+void BWESim::Send(Packet & packet, PInt64 now)
+{
+  packet.m_sequenceNumber = ++m_nextSequenceNumber;
+  packet.m_sent = now;
+  m_second.m_sentBytes += packet.m_size;
+
+  // Drop tail when the bottleneck queue is over its limit
+  if (m_linkFree - now > m_queueLimit || (m_randomLoss > 0 && PRandom::Number(1000000) < m_randomLoss*1000000)) {
+    ++m_second.m_lost;
+    return;
+  }
+
+  m_linkFree = std::max(m_linkFree, now) + packet.m_size*8*1000000LL/GetCapacity(now);
+  packet.m_arrival = m_linkFree + m_propagation;
+  m_inFlight.push_back(packet); // Single FIFO link, so arrivals stay in order
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
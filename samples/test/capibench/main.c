@@ -0,0 +1,538 @@
+/*
+ * main.c
+ *
+ * OPAL "C" API event and media benchmark
+ *
+ * Open Phone Abstraction Library
+ *
+ * Copyright (c) 2017 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+/* Compares the two ways an application can cross the C API.
+
+   Events: string user input is sent over a SIP loopback call until a burst
+   of OpalIndUserInput messages is queued, which is then drained once with
+   an OpalGetMessage() per event and once with OpalGetMessages() batches.
+
+   Media: raw audio flows both ways over the same loopback for a fixed time,
+   once through the OpalMediaDataFunction call backs and once through the
+   shared OpalMediaRing buffers, with asynchronous media timing so neither is
+   paced, and the frames per second crossing the API are reported.
+ */
+
+#define _CRT_NONSTDC_NO_WARNINGS
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <opal.h>
+
+
+#if defined(_WIN32)
+
+  #include <windows.h>
+
+  #define SLEEP(ms)         Sleep(ms)
+  #define MEMORY_BARRIER()  MemoryBarrier()
+  #define ATOMIC_INC(var)   InterlockedIncrement(&(var))
+
+  static double Now()
+  {
+    LARGE_INTEGER count, frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return (double)count.QuadPart/frequency.QuadPart;
+  }
+
+#else // _WIN32
+
+  #include <unistd.h>
+  #include <sys/time.h>
+
+  #define SLEEP(ms)         usleep((ms)*1000)
+  #define MEMORY_BARRIER()  __sync_synchronize()
+  #define ATOMIC_INC(var)   __sync_fetch_and_add(&(var), 1)
+
+  static double Now()
+  {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec/1000000.0;
+  }
+
+#endif // _WIN32
+
+
+#define MAX_RINGS     8
+#define MAX_BATCH     256
+#define RECORD_SIZE(len) ((sizeof(unsigned) + (len) + 3) & ~3u)
+
+typedef struct MediaRingInfo {
+  OpalMessage   * m_message;   // OpalIndMediaStream that keeps the ring valid
+  OpalMediaRing * m_ring;
+  int             m_producer;  // Application writes to this ring
+} MediaRingInfo;
+
+OpalHandle    hOPAL;
+unsigned      EventCount = 10000;
+unsigned      BatchSize = 32;
+unsigned      SettleTime = 5;
+unsigned      MediaDuration = 10;
+unsigned      FrameSize = 320;
+const char  * Port = "15060";
+
+char        * CallToken;
+unsigned      EstablishedCount;
+unsigned      UserInputCount;
+MediaRingInfo Rings[MAX_RINGS];
+unsigned      RingCount;
+
+volatile long FramesFromApp;
+volatile long FramesToApp;
+unsigned char FrameData[2048];
+
+
+
+static OpalMessage * MySendCommand(OpalMessage * command, const char * errorMessage)
+{
+  OpalMessage * response;
+  if ((response = OpalSendMessage(hOPAL, command)) == NULL)
+    return NULL;
+
+  if (response->m_type != OpalIndCommandError)
+    return response;
+
+  if (response->m_param.m_commandError == NULL || *response->m_param.m_commandError == '\0')
+    fprintf(stderr, "%s.\n", errorMessage);
+  else
+    fprintf(stderr, "%s: %s\n", errorMessage, response->m_param.m_commandError);
+
+  OpalFreeMessage(response);
+  return NULL;
+}
+
+
+static int MyReadMediaData(const char * token, const char * stream, const char * format, void * userData, void * data, int size)
+{
+  int length = size < (int)FrameSize ? size : (int)FrameSize;
+  memcpy(data, FrameData, length);
+  ATOMIC_INC(FramesFromApp);
+  return length;
+}
+
+
+static int MyWriteMediaData(const char * token, const char * stream, const char * format, void * userData, void * data, int size)
+{
+  ATOMIC_INC(FramesToApp);
+  return size;
+}
+
+
+static int WriteMediaRing(OpalMediaRing * ring, const void * data, unsigned length)
+{
+  unsigned recordSize = RECORD_SIZE(length);
+  unsigned position = ring->m_writePosition;
+  unsigned offset = position & (ring->m_size-1);
+  unsigned skip = recordSize > ring->m_size - offset ? ring->m_size - offset : 0;
+
+  MEMORY_BARRIER();
+  if (skip + recordSize > ring->m_size - (position - ring->m_readPosition))
+    return 0;
+
+  if (skip > 0) {
+    *(unsigned *)(ring->m_data + offset) = OPAL_MEDIA_RING_WRAP;
+    position += skip;
+    offset = 0;
+  }
+
+  *(unsigned *)(ring->m_data + offset) = length;
+  memcpy(ring->m_data + offset + sizeof(unsigned), data, length);
+
+  MEMORY_BARRIER();
+  ring->m_writePosition = position + recordSize;
+
+  MEMORY_BARRIER();
+  if (ring->m_consumerWaiting)
+    OpalSignalMediaRing(ring);
+  return 1;
+}
+
+
+static int ReadMediaRing(OpalMediaRing * ring)
+{
+  unsigned position = ring->m_readPosition;
+  unsigned offset, length;
+
+  for (;;) {
+    if (position == ring->m_writePosition)
+      return 0;
+
+    MEMORY_BARRIER();
+    offset = position & (ring->m_size-1);
+    length = *(const unsigned *)(ring->m_data + offset);
+    if (length != OPAL_MEDIA_RING_WRAP)
+      break;
+    position += ring->m_size - offset;
+  }
+
+  // A real application would use the media in place here
+
+  MEMORY_BARRIER();
+  ring->m_readPosition = position + RECORD_SIZE(length);
+  return 1;
+}
+
+
+static int PumpMediaRings()
+{
+  int busy = 0;
+  unsigned i;
+
+  for (i = 0; i < RingCount; ++i) {
+    if (Rings[i].m_producer) {
+      while (WriteMediaRing(Rings[i].m_ring, FrameData, FrameSize)) {
+        ++FramesFromApp;
+        busy = 1;
+      }
+    }
+    else {
+      while (ReadMediaRing(Rings[i].m_ring)) {
+        ++FramesToApp;
+        busy = 1;
+      }
+    }
+  }
+
+  return busy;
+}
+
+
+static void HandleMessage(OpalMessage * message)
+{
+  OpalMessage command;
+  OpalMessage * response;
+  size_t len;
+
+  switch (message->m_type) {
+    case OpalIndIncomingCall :
+      memset(&command, 0, sizeof(command));
+      command.m_type = OpalCmdAnswerCall;
+      command.m_param.m_answerCall.m_callToken = message->m_param.m_incomingCall.m_callToken;
+      if ((response = MySendCommand(&command, "Could not answer call")) != NULL)
+        OpalFreeMessage(response);
+      break;
+
+    case OpalIndEstablished :
+      ++EstablishedCount;
+      break;
+
+    case OpalIndUserInput :
+      ++UserInputCount;
+      break;
+
+    case OpalIndMediaStream :
+      if (message->m_param.m_mediaStream.m_state == OpalMediaStateOpen &&
+          message->m_param.m_mediaStream.m_mediaRing != NULL &&
+          RingCount < MAX_RINGS) {
+        // Type is from the network side, OPAL reads what we write for "out"
+        len = strlen(message->m_param.m_mediaStream.m_type);
+        Rings[RingCount].m_message = message;
+        Rings[RingCount].m_ring = message->m_param.m_mediaStream.m_mediaRing;
+        Rings[RingCount].m_producer = len > 4 && strcmp(message->m_param.m_mediaStream.m_type+len-4, " out") == 0;
+        ++RingCount;
+        return; // Message freed when done with the ring
+      }
+      break;
+
+    default :
+      break;
+  }
+
+  OpalFreeMessage(message);
+}
+
+
+static int HandleMessages(unsigned timeout)
+{
+  OpalMessage * messages[MAX_BATCH];
+  unsigned count, i;
+
+  if ((count = OpalGetMessages(hOPAL, messages, MAX_BATCH, timeout)) == 0)
+    return 0;
+
+  for (i = 0; i < count; ++i)
+    HandleMessage(messages[i]);
+  return 1;
+}
+
+
+static int SetGeneral(unsigned ringSize)
+{
+  OpalMessage command;
+  OpalMessage * response;
+
+  memset(&command, 0, sizeof(command));
+  command.m_type = OpalCmdSetGeneralParameters;
+  command.m_param.m_general.m_autoRxMedia = command.m_param.m_general.m_autoTxMedia = "audio";
+  command.m_param.m_general.m_mediaOrder = "G.711-uLaw-64k";
+  command.m_param.m_general.m_mediaReadData = MyReadMediaData;
+  command.m_param.m_general.m_mediaWriteData = MyWriteMediaData;
+  command.m_param.m_general.m_mediaDataHeader = OpalMediaDataPayloadOnly;
+  command.m_param.m_general.m_mediaTiming = OpalMediaTimingAsynchronous;
+  command.m_param.m_general.m_mediaRingSize = ringSize;
+  if ((response = MySendCommand(&command, "Could not set general options")) == NULL)
+    return 0;
+
+  OpalFreeMessage(response);
+  return 1;
+}
+
+
+static int InitialiseOPAL()
+{
+  OpalMessage command;
+  OpalMessage * response;
+  unsigned version;
+  char interfaces[100];
+
+  version = OPAL_C_API_VERSION;
+  if ((hOPAL = OpalInitialise(&version, OPAL_PREFIX_SIP " " OPAL_PREFIX_LOCAL)) == NULL) {
+    fputs("Could not initialise OPAL\n", stderr);
+    return 0;
+  }
+
+  if (!SetGeneral(UINT_MAX))
+    return 0;
+
+  snprintf(interfaces, sizeof(interfaces), "udp$127.0.0.1:%s", Port);
+
+  memset(&command, 0, sizeof(command));
+  command.m_type = OpalCmdSetProtocolParameters;
+  command.m_param.m_protocol.m_prefix = OPAL_PREFIX_SIP;
+  command.m_param.m_protocol.m_interfaceAddresses = interfaces;
+  command.m_param.m_protocol.m_userInputMode = OpalUserInputAsString;
+  if ((response = MySendCommand(&command, "Could not set SIP options")) == NULL)
+    return 0;
+
+  OpalFreeMessage(response);
+  return 1;
+}
+
+
+static int MakeCall()
+{
+  OpalMessage command;
+  OpalMessage * response;
+  char destination[100];
+  double start;
+
+  snprintf(destination, sizeof(destination), "sip:bench@127.0.0.1:%s", Port);
+
+  EstablishedCount = 0;
+  RingCount = 0;
+
+  memset(&command, 0, sizeof(command));
+  command.m_type = OpalCmdSetUpCall;
+  command.m_param.m_callSetUp.m_partyA = OPAL_PREFIX_LOCAL ":";
+  command.m_param.m_callSetUp.m_partyB = destination;
+  if ((response = MySendCommand(&command, "Could not make call")) == NULL)
+    return 0;
+
+  CallToken = strdup(response->m_param.m_callSetUp.m_callToken);
+  OpalFreeMessage(response);
+
+  // Both the outgoing and the incoming (looped back) call must establish
+  start = Now();
+  while (EstablishedCount < 2) {
+    if (Now() - start > 10) {
+      fputs("Loopback call did not establish\n", stderr);
+      return 0;
+    }
+    HandleMessages(100);
+  }
+
+  return 1;
+}
+
+
+static void ClearCall()
+{
+  OpalMessage command;
+  OpalMessage * response;
+  unsigned i;
+
+  // Rings are released with the messages that carried them
+  for (i = 0; i < RingCount; ++i)
+    OpalFreeMessage(Rings[i].m_message);
+  RingCount = 0;
+
+  memset(&command, 0, sizeof(command));
+  command.m_type = OpalCmdClearCall;
+  command.m_param.m_clearCall.m_callToken = CallToken;
+  if ((response = MySendCommand(&command, "Could not clear call")) != NULL)
+    OpalFreeMessage(response);
+
+  free(CallToken);
+  CallToken = NULL;
+
+  while (HandleMessages(1000))
+    ;
+}
+
+
+static int BenchEvents(int batch)
+{
+  OpalMessage command;
+  OpalMessage * response;
+  OpalMessage * messages[MAX_BATCH];
+  unsigned sent, count, i, drained;
+  double start, elapsed;
+
+  for (sent = 0; sent < EventCount; ++sent) {
+    memset(&command, 0, sizeof(command));
+    command.m_type = OpalCmdUserInput;
+    command.m_param.m_userInput.m_callToken = CallToken;
+    command.m_param.m_userInput.m_userInput = "1";
+    if ((response = MySendCommand(&command, "Could not send user input")) == NULL)
+      return 0;
+    OpalFreeMessage(response);
+  }
+
+  // Let them all arrive at the far end and queue up
+  SLEEP(SettleTime*1000);
+
+  UserInputCount = 0;
+  drained = 0;
+  start = Now();
+  if (batch) {
+    while ((count = OpalGetMessages(hOPAL, messages, BatchSize, 0)) > 0) {
+      for (i = 0; i < count; ++i)
+        HandleMessage(messages[i]);
+      drained += count;
+    }
+  }
+  else {
+    OpalMessage * message;
+    while ((message = OpalGetMessage(hOPAL, 0)) != NULL) {
+      HandleMessage(message);
+      ++drained;
+    }
+  }
+  elapsed = Now() - start;
+
+  printf("%-22s %8u %8u %8.3f %12.0f\n",
+         batch ? "OpalGetMessages" : "OpalGetMessage",
+         UserInputCount, drained, elapsed, elapsed > 0 ? drained/elapsed : 0.0);
+  if (UserInputCount < EventCount)
+    printf("  %u of %u user input events not yet queued, increase --settle\n", EventCount - UserInputCount, EventCount);
+  return 1;
+}
+
+
+static int BenchMedia(int ring)
+{
+  double start, elapsed;
+  unsigned rings;
+
+  if (!SetGeneral(ring ? 65536 : UINT_MAX))
+    return 0;
+
+  FramesFromApp = FramesToApp = 0;
+  if (!MakeCall())
+    return 0;
+
+  start = Now();
+  while ((elapsed = Now() - start) < MediaDuration) {
+    int busy = HandleMessages(0);
+    if (ring && PumpMediaRings())
+      busy = 1;
+    if (!busy)
+      SLEEP(1);
+  }
+
+  rings = RingCount;
+  ClearCall();
+
+  printf("%-22s %12.0f %12.0f",
+         ring ? "Media rings" : "Call backs",
+         FramesFromApp/elapsed, FramesToApp/elapsed);
+  if (ring)
+    printf("  (%u rings)", rings);
+  putchar('\n');
+  return 1;
+}
+
+
+int main(int argc, const char * const * argv)
+{
+  int i;
+
+  for (i = 1; i < argc; ++i) {
+    if (i+1 < argc && strcmp(argv[i], "--events") == 0)
+      EventCount = atoi(argv[++i]);
+    else if (i+1 < argc && strcmp(argv[i], "--batch") == 0)
+      BatchSize = atoi(argv[++i]);
+    else if (i+1 < argc && strcmp(argv[i], "--settle") == 0)
+      SettleTime = atoi(argv[++i]);
+    else if (i+1 < argc && strcmp(argv[i], "--duration") == 0)
+      MediaDuration = atoi(argv[++i]);
+    else if (i+1 < argc && strcmp(argv[i], "--frame-size") == 0)
+      FrameSize = atoi(argv[++i]);
+    else if (i+1 < argc && strcmp(argv[i], "--port") == 0)
+      Port = argv[++i];
+    else {
+      fputs("usage: capibench [ options ]\n"
+            "  --events n      Number of user input events, default 10000\n"
+            "  --batch n       Messages per OpalGetMessages() call, default 32\n"
+            "  --settle n      Seconds to let events queue before draining, default 5\n"
+            "  --duration n    Seconds of media for each mode, default 10\n"
+            "  --frame-size n  Bytes of PCM-16 per media frame, default 320\n"
+            "  --port n        SIP loopback port, default 15060\n", stderr);
+      return 1;
+    }
+  }
+
+  if (BatchSize < 1 || BatchSize > MAX_BATCH)
+    BatchSize = MAX_BATCH;
+  if (FrameSize < 2 || FrameSize > sizeof(FrameData))
+    FrameSize = sizeof(FrameData);
+  for (i = 0; i < (int)sizeof(FrameData); ++i)
+    FrameData[i] = (unsigned char)i;
+
+  if (!InitialiseOPAL())
+    return 1;
+
+  printf("%-22s %8s %8s %8s %12s\n", "Events", "Input", "Drained", "Seconds", "Messages/s");
+  if (!MakeCall() || !BenchEvents(0) || !BenchEvents(1))
+    return 1;
+  ClearCall();
+
+  printf("\n%-22s %12s %12s\n", "Media", "To OPAL/s", "From OPAL/s");
+  if (!BenchMedia(0) || !BenchMedia(1))
+    return 1;
+
+  OpalShutDown(hOPAL);
+  return 0;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
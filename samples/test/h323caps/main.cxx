@@ -0,0 +1,384 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for H.323 capability table benchmark
+ *
+ * Copyright (c) 2017 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <opal/manager.h>
+#include <h323/h323caps.h>
+#include <h323/h323ep.h>
+#include <h323/h323con.h>
+#include <ep/localep.h>
+#include <asn/h245.h>
+
+
+/* Builds a capability table from every registered capability, as an
+   endpoint does, optionally copied several times so names are duplicated,
+   then reverses its order with Reorder(). After each change the number and
+   exact name lookups are checked against a linear search of the table, and
+   the time taken by the lookups, the reorder, a table copy (which shares the
+   capabilities) and a table clone (a copy that is then changed) is reported.
+
+   Then a number of H.323 calls are made over loopback between local
+   endpoints, reporting the process memory used per call, and the time to
+   build and to parse a TerminalCapabilitySet on one of the connections. The
+   --no-share option stops the endpoint sharing identical local capability
+   tables between connections, to compare the memory used. */
+
+#if OPAL_H323
+
+class CapsEndPoint : public H323EndPoint
+{
+    PCLASSINFO(CapsEndPoint, H323EndPoint)
+  public:
+    CapsEndPoint(OpalManager & manager, bool share)
+      : H323EndPoint(manager)
+      , m_share(share)
+    {
+    }
+
+    virtual void ShareLocalCapabilities(H323Capabilities & capabilities)
+    {
+      if (m_share)
+        H323EndPoint::ShareLocalCapabilities(capabilities);
+    }
+
+  protected:
+    bool m_share;
+};
+
+
+class CapsManager : public OpalManager
+{
+    PCLASSINFO(CapsManager, OpalManager)
+  public:
+    CapsManager()
+      : m_established(0)
+    {
+    }
+
+    virtual void OnEstablishedCall(OpalCall & call)
+    {
+      ++m_established;
+      OpalManager::OnEstablishedCall(call);
+    }
+
+    atomic<unsigned> m_established;
+};
+
+
+class H323CapsTest : public PProcess
+{
+    PCLASSINFO(H323CapsTest, PProcess)
+  public:
+    H323CapsTest();
+
+    virtual void Main();
+
+  protected:
+    bool Check(const H323Capabilities & caps, const char * when);
+    void Benchmark(const H323Capabilities & caps, unsigned iterations);
+    void BenchmarkCalls(CapsManager & manager, CapsEndPoint & h323, const PString & destination, unsigned callCount, unsigned iterations);
+    bool WaitForCalls(CapsManager & manager, unsigned expected);
+};
+
+
+PCREATE_PROCESS(H323CapsTest);
+
+
+H323CapsTest::H323CapsTest()
+  : PProcess("Open Phone Abstraction Library", "H.323 Capabilities", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_BUILD)
+{
+}
+
+
+void H323CapsTest::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "c-copies: Number of copies of each capability in the table, default 1\n"
+             "i-iterations: Number of lookups of each capability, default 1000\n"
+             "n-calls: Number of H.323 calls to make, default 20, 0 for none\n"
+             "p-port: Port for H.323 calls over loopback, default 1720\n"
+             "-no-share. Do not share local capability tables between calls\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  unsigned copies = std::max(1U, args.GetOptionString('c', "1").AsUnsigned());
+  unsigned iterations = std::max(1U, args.GetOptionString('i', "1000").AsUnsigned());
+
+  // Makes sure all the plug in codecs are registered
+  CapsManager manager;
+
+  H323Capabilities caps;
+  caps.AddAllCapabilities(0, 0, "*");
+  PINDEX registered = caps.GetSize();
+  for (unsigned copy = 1; copy < copies; ++copy) {
+    for (PINDEX i = 0; i < registered; ++i)
+      caps.Copy(caps[i]);
+  }
+
+  cout << caps.GetSize() << " capabilities, " << registered << " registered" << endl;
+  if (!Check(caps, "after build"))
+    return;
+
+  PStringArray order(registered);
+  for (PINDEX i = 0; i < registered; ++i)
+    order[i] = caps[registered-i-1].GetFormatName();
+
+  PTimeInterval start = PTimer::Tick();
+  caps.Reorder(order);
+  PTimeInterval reorderTime = PTimer::Tick() - start;
+  if (!Check(caps, "after reorder"))
+    return;
+
+  caps.Remove(caps[caps.GetSize()/2].GetFormatName());
+  if (!Check(caps, "after remove"))
+    return;
+
+  cout << "Reorder:        " << setw(10) << reorderTime.GetMicroSeconds() << "us" << endl;
+  Benchmark(caps, iterations);
+
+  unsigned callCount = args.GetOptionString('n', "20").AsUnsigned();
+  if (callCount == 0)
+    return;
+
+  manager.SetAutoStartReceiveVideo(false);
+  manager.SetAutoStartTransmitVideo(false);
+
+  CapsEndPoint * h323 = new CapsEndPoint(manager, !args.HasOption("no-share"));
+  PString address = "tcp$127.0.0.1:" + args.GetOptionString('p', "1720");
+  if (!h323->StartListener(address)) {
+    cerr << "Could not listen on " << address << endl;
+    SetTerminationValue(1);
+    return;
+  }
+
+  new OpalLocalEndPoint(manager);
+  manager.AddRouteEntry("local:.* = h323:<da>");
+  manager.AddRouteEntry("h323:.* = local:<du>");
+
+  BenchmarkCalls(manager, *h323, "h323:caps@" + address.Mid(4), callCount, iterations);
+  manager.ClearAllCalls();
+}
+
+
+bool H323CapsTest::Check(const H323Capabilities & caps, const char * when)
+{
+  for (PINDEX i = 0; i < caps.GetSize(); ++i) {
+    H323Capability * expected = NULL;
+    for (PINDEX j = 0; j < caps.GetSize(); ++j) {
+      if (caps[j].GetCapabilityNumber() == caps[i].GetCapabilityNumber()) {
+        expected = &caps[j];
+        break;
+      }
+    }
+    if (caps.FindCapability(caps[i].GetCapabilityNumber()) != expected) {
+      cerr << "Lookup of number " << caps[i].GetCapabilityNumber() << " wrong " << when << endl;
+      SetTerminationValue(1);
+      return false;
+    }
+
+    PCaselessString name = caps[i].GetFormatName();
+    for (PINDEX j = 0; j < caps.GetSize(); ++j) {
+      if (name == caps[j].GetFormatName()) {
+        expected = &caps[j];
+        break;
+      }
+    }
+    if (caps.FindCapability(name, H323Capability::e_Unknown, true) != expected) {
+      cerr << "Lookup of name \"" << name << "\" wrong " << when << endl;
+      SetTerminationValue(1);
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+void H323CapsTest::Benchmark(const H323Capabilities & caps, unsigned iterations)
+{
+  PStringArray names(caps.GetSize());
+  for (PINDEX i = 0; i < caps.GetSize(); ++i)
+    names[i] = caps[i].GetFormatName();
+
+  unsigned lookups = iterations*caps.GetSize();
+  unsigned found = 0;
+
+  PTimeInterval start = PTimer::Tick();
+  for (unsigned count = 0; count < iterations; ++count) {
+    for (PINDEX i = 0; i < caps.GetSize(); ++i) {
+      if (caps.FindCapability(caps[i].GetCapabilityNumber()) != NULL)
+        ++found;
+    }
+  }
+  PTimeInterval numberTime = PTimer::Tick() - start;
+
+  start = PTimer::Tick();
+  for (unsigned count = 0; count < iterations; ++count) {
+    for (PINDEX i = 0; i < names.GetSize(); ++i) {
+      if (caps.FindCapability(names[i], H323Capability::e_Unknown, true) != NULL)
+        ++found;
+    }
+  }
+  PTimeInterval nameTime = PTimer::Tick() - start;
+
+  unsigned copies = std::max(1U, iterations/100);
+  start = PTimer::Tick();
+  for (unsigned count = 0; count < copies; ++count) {
+    H323Capabilities copy(caps);
+    found += copy.GetSize() > 0;
+  }
+  PTimeInterval copyTime = PTimer::Tick() - start;
+
+  // The non-const lookup makes the copy unique, cloning every capability
+  start = PTimer::Tick();
+  for (unsigned count = 0; count < copies; ++count) {
+    H323Capabilities copy(caps);
+    found += copy.FindCapability(caps[0].GetCapabilityNumber()) != &caps[0];
+  }
+  PTimeInterval cloneTime = PTimer::Tick() - start;
+
+  cout << "Number lookup:  " << setw(10) << numberTime.GetMicroSeconds()*1000/lookups << "ns\n"
+          "Name lookup:    " << setw(10) << nameTime.GetMicroSeconds()*1000/lookups << "ns\n"
+          "Table copy:     " << setw(10) << copyTime.GetMicroSeconds()*1000/copies << "ns\n"
+          "Table clone:    " << setw(10) << cloneTime.GetMicroSeconds()/copies << "us\n"
+          "Found:          " << setw(10) << found
+       << endl;
+
+  if (found != 2*lookups + 2*copies)
+    SetTerminationValue(1);
+}
+
+
+static PINDEX ResidentKB()
+{
+#ifdef P_LINUX
+  PTextFile status("/proc/self/status", PFile::ReadOnly);
+  PString line;
+  while (status.ReadLine(line)) {
+    if (line.NumCompare("VmRSS:") == PObject::EqualTo)
+      return line.Mid(6).Trim().AsUnsigned();
+  }
+#endif
+  return 0;
+}
+
+
+bool H323CapsTest::WaitForCalls(CapsManager & manager, unsigned expected)
+{
+  PSimpleTimer timeout(0, 30);
+  while (manager.m_established < expected) {
+    if (timeout.HasExpired()) {
+      cerr << "Only " << manager.m_established/2 << " of " << expected/2 << " calls established" << endl;
+      SetTerminationValue(1);
+      return false;
+    }
+    PThread::Sleep(10);
+  }
+  return true;
+}
+
+
+void H323CapsTest::BenchmarkCalls(CapsManager & manager,
+                                  CapsEndPoint & h323,
+                                  const PString & destination,
+                                  unsigned callCount,
+                                  unsigned iterations)
+{
+  // Each call to ourselves is two OpalCall's, the outgoing and the incoming
+
+  // The first call loads everything used by all calls, so is not counted
+  if (manager.SetUpCall("local:*", destination) == NULL || !WaitForCalls(manager, 2))
+    return;
+
+  PINDEX residentBefore = ResidentKB();
+
+  for (unsigned call = 0; call < callCount; ++call) {
+    if (manager.SetUpCall("local:*", destination) == NULL) {
+      cerr << "Could not start call " << call << endl;
+      SetTerminationValue(1);
+      return;
+    }
+  }
+
+  if (!WaitForCalls(manager, (callCount+1)*2))
+    return;
+
+  PINDEX residentAfter = ResidentKB();
+  cout << callCount << " H.323 calls";
+  if (residentBefore > 0)
+    cout << ", memory per call: " << (residentAfter - residentBefore)*1024/callCount << " bytes";
+  cout << endl;
+
+  PStringList tokens = h323.GetAllConnections();
+  if (tokens.IsEmpty())
+    return;
+
+  PSafePtr<H323Connection> connection = h323.FindConnectionWithLock(tokens[0]);
+  if (connection == NULL)
+    return;
+
+  unsigned count = std::max(1U, iterations/10);
+  H245_TerminalCapabilitySet pdu;
+
+  PTimeInterval start = PTimer::Tick();
+  for (unsigned i = 0; i < count; ++i) {
+    pdu = H245_TerminalCapabilitySet();
+    connection->GetLocalCapabilities().BuildPDU(*connection, pdu);
+  }
+  PTimeInterval buildTime = PTimer::Tick() - start;
+
+  PINDEX parsed = 0;
+  start = PTimer::Tick();
+  for (unsigned i = 0; i < count; ++i) {
+    H323Capabilities remoteCapabilities(*connection, pdu);
+    parsed = remoteCapabilities.GetSize();
+  }
+  PTimeInterval parseTime = PTimer::Tick() - start;
+
+  cout << "TCS entries:    " << setw(10) << pdu.m_capabilityTable.GetSize() << "\n"
+          "TCS build:      " << setw(10) << buildTime.GetMicroSeconds()/count << "us\n"
+          "TCS parse:      " << setw(10) << parseTime.GetMicroSeconds()/count << "us\n"
+          "TCS parsed:     " << setw(10) << parsed
+       << endl;
+
+  if (parsed == 0)
+    SetTerminationValue(1);
+}
+
+#else
+
+#error Cannot build H.323 capabilities test without H.323
+
+#endif // OPAL_H323
+
+
+// End of File ///////////////////////////////////////////////////////////////
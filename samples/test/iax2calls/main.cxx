@@ -0,0 +1,220 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for IAX2 many simultaneous calls test
+ *
+ * Copyright (c) 2017 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <opal_config.h>
+#include <opal/manager.h>
+#include <iax2/iax2ep.h>
+#include <ep/localep.h>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+
+/* Makes a number of simultaneous IAX2 calls from the endpoint to itself over
+   loopback, with the local endpoint sending and receiving audio at each end,
+   so every call has two IAX2 connections, each run by a processor on the
+   endpoint thread pool. Reported are the time to set up all the calls, the
+   threads in the process and the CPU used per call while they are all up,
+   and the time to clear them all. After clearing, every IAX2 connection must
+   have been deleted, which needs the final pass of each processor to have
+   completed. */
+
+#if OPAL_IAX2
+
+class CallsManager : public OpalManager
+{
+    PCLASSINFO(CallsManager, OpalManager)
+  public:
+    CallsManager()
+      : m_established(0)
+      , m_cleared(0)
+    {
+    }
+
+    virtual void OnEstablishedCall(OpalCall & call)
+    {
+      ++m_established;
+      OpalManager::OnEstablishedCall(call);
+    }
+
+    virtual void OnClearedCall(OpalCall & call)
+    {
+      ++m_cleared;
+      OpalManager::OnClearedCall(call);
+    }
+
+    atomic<unsigned> m_established;
+    atomic<unsigned> m_cleared;
+};
+
+
+class IAX2Calls : public PProcess
+{
+    PCLASSINFO(IAX2Calls, PProcess)
+  public:
+    IAX2Calls();
+
+    virtual void Main();
+};
+
+
+PCREATE_PROCESS(IAX2Calls);
+
+
+IAX2Calls::IAX2Calls()
+  : PProcess("Open Phone Abstraction Library", "IAX2 Calls", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_BUILD)
+{
+}
+
+
+#ifndef _WIN32
+static PInt64 CPUMicroSeconds()
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return (PInt64)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)*1000000 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+#endif
+
+
+static PString ThreadCount()
+{
+#ifdef P_LINUX
+  PTextFile status("/proc/self/status", PFile::ReadOnly);
+  PString line;
+  while (status.ReadLine(line)) {
+    if (line.NumCompare("Threads:") == PObject::EqualTo)
+      return line.Mid(8).Trim();
+  }
+#endif
+  return "unknown";
+}
+
+
+void IAX2Calls::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "c-calls: Number of simultaneous calls, default 100\n"
+             "r-rate: Calls started per second, default 50\n"
+             "d-duration: Seconds to hold all the calls up, default 10\n"
+             "t-threads: Maximum processor threads in the endpoint pool\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  unsigned callCount = std::max(1U, args.GetOptionString('c', "100").AsUnsigned());
+  unsigned rate = std::max(1U, args.GetOptionString('r', "50").AsUnsigned());
+  PTimeInterval duration(0, args.GetOptionString('d', "10").AsUnsigned());
+
+  CallsManager manager;
+  manager.SetAutoStartReceiveVideo(false);
+  manager.SetAutoStartTransmitVideo(false);
+
+  IAX2EndPoint * iax2 = new IAX2EndPoint(manager);
+  if (!iax2->InitialisedOK()) {
+    cerr << "Could not start IAX2 endpoint on port " << iax2->ListenPortNumber() << endl;
+    SetTerminationValue(1);
+    return;
+  }
+  if (args.HasOption('t'))
+    iax2->SetProcessorThreads(args.GetOptionString('t').AsUnsigned());
+
+  new OpalLocalEndPoint(manager);
+  manager.AddRouteEntry("local:.* = iax2:<da>");
+  manager.AddRouteEntry("iax2:.* = local:<du>");
+
+  cout << callCount << " calls at " << rate << " calls/s, held for " << duration << 's' << endl;
+
+  // Each call to ourselves is two OpalCall's, the outgoing and the incoming
+  unsigned expected = callCount*2;
+
+  PTimeInterval start = PTimer::Tick();
+  for (unsigned call = 0; call < callCount; ++call) {
+    if (manager.SetUpCall("local:*", "iax2:bench@127.0.0.1/bench") == NULL) {
+      cerr << "Could not start call " << call << endl;
+      break;
+    }
+
+    PTimeInterval due = PTimeInterval::MicroSeconds((PInt64)(call+1)*1000000/rate);
+    PTimeInterval elapsed = PTimer::Tick() - start;
+    if (due > elapsed)
+      PThread::Sleep(due - elapsed);
+  }
+
+  PSimpleTimer setUpTimeout(0, 30 + callCount/rate);
+  while (manager.m_established < expected && manager.m_cleared == 0 && !setUpTimeout.HasExpired())
+    PThread::Sleep(10);
+  PTimeInterval setUpTime = PTimer::Tick() - start;
+  unsigned established = manager.m_established;
+
+  cout << "Established:   " << established/2 << " of " << callCount << " calls in " << setUpTime << "s\n"
+          "Threads:       " << ThreadCount() << endl;
+
+#ifndef _WIN32
+  PInt64 cpuStart = CPUMicroSeconds();
+  PTimeInterval holdStart = PTimer::Tick();
+#endif
+  PThread::Sleep(duration);
+#ifndef _WIN32
+  PInt64 cpuUsed = CPUMicroSeconds() - cpuStart;
+  PTimeInterval held = PTimer::Tick() - holdStart;
+  cout << "CPU per call:  " << setprecision(3) << fixed
+       << cpuUsed*100.0/std::max(held.GetMicroSeconds(), (PInt64)1)/callCount << "% of a core" << endl;
+#endif
+
+  start = PTimer::Tick();
+  manager.ClearAllCalls();
+
+  // Connections are deleted by garbage collection, after their processors finish
+  PSimpleTimer clearTimeout(0, 30);
+  while (iax2->GetConnectionCount() > 0 && !clearTimeout.HasExpired())
+    PThread::Sleep(10);
+  PTimeInterval clearTime = PTimer::Tick() - start;
+
+  PINDEX remaining = iax2->GetConnectionCount();
+  cout << "Cleared:       " << manager.m_cleared/2 << " calls in " << clearTime << "s\n"
+          "Left over:     " << remaining << " IAX2 connections" << endl;
+
+  if (established < expected || remaining > 0)
+    SetTerminationValue(1);
+}
+
+#else
+
+#error Cannot build IAX2 calls test without IAX2
+
+#endif // OPAL_IAX2
+
+
+// End of File ///////////////////////////////////////////////////////////////
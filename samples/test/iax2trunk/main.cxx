@@ -0,0 +1,230 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for IAX2 trunking packet rate test
+ *
+ * Copyright (c) 2017 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <opal/manager.h>
+#include <iax2/iax2ep.h>
+#include <iax2/frame.h>
+#include <iax2/transmit.h>
+
+
+/* Sends the audio mini frames of a number of simultaneous calls over
+   loopback UDP, once as individual packets and once through an
+   IAX2TrunkBuffer, as the endpoint does for a trunked peer. The trunk frames
+   are split again with IAX2Frame::SplitTrunkFrame and every entry checked
+   against what was sent, then the packet rates of the two are reported. */
+
+#if OPAL_IAX2
+
+class IAX2Trunk : public PProcess
+{
+    PCLASSINFO(IAX2Trunk, PProcess)
+  public:
+    IAX2Trunk();
+
+    virtual void Main();
+
+  protected:
+    void MakeMedia(unsigned call, unsigned timeStamp, PBYTEArray & media);
+    bool ReceiveTrunk(IAX2EndPoint & endpoint, PUDPSocket & socket);
+
+    unsigned m_mediaSize;
+    unsigned m_received;
+    unsigned m_errors;
+};
+
+
+PCREATE_PROCESS(IAX2Trunk);
+
+
+IAX2Trunk::IAX2Trunk()
+  : PProcess("Open Phone Abstraction Library", "IAX2 Trunk", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_BUILD)
+  , m_mediaSize(160)
+  , m_received(0)
+  , m_errors(0)
+{
+}
+
+
+void IAX2Trunk::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "c-calls: Number of simultaneous calls, default 100\n"
+             "d-duration: Seconds of audio per call, default 10\n"
+             "f-frame-time: Milliseconds of audio per frame, default 20\n"
+             "s-size: Bytes of media per frame, default 160 (G.711)\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  unsigned callCount = std::max(1U, std::min(0x7ffeU, args.GetOptionString('c', "100").AsUnsigned()));
+  unsigned frameTime = std::max(1U, args.GetOptionString('f', "20").AsUnsigned());
+  unsigned frameCount = std::max(1U, args.GetOptionString('d', "10").AsUnsigned())*1000/frameTime;
+  m_mediaSize = std::max(1U, std::min(1000U, args.GetOptionString('s', "160").AsUnsigned()));
+
+  OpalManager manager;
+  IAX2EndPoint * endpoint = new IAX2EndPoint(manager);
+
+  PIPSocket::Address loopback = PIPSocket::Address::GetLoopback();
+  PUDPSocket sender, relay, receiver;
+  if (!sender.Listen(loopback) || !relay.Listen(loopback) || !receiver.Listen(loopback)) {
+    cerr << "Could not open sockets" << endl;
+    return;
+  }
+  relay.SetReadTimeout(1000);
+  receiver.SetReadTimeout(1000);
+
+  cout << callCount << " calls, " << frameCount << " frames of "
+       << m_mediaSize << " bytes every " << frameTime << "ms" << endl;
+
+  IAX2TrunkBuffer trunk(loopback, receiver.GetPort());
+  unsigned miniPackets = 0, miniBytes = 0, trunkPackets = 0, trunkBytes = 0;
+
+  PTimeInterval started = PTimer::Tick();
+  for (unsigned frame = 0; frame < frameCount; ++frame) {
+    // Each call sends its mini frame, as it would without trunking
+    for (unsigned call = 0; call < callCount; ++call) {
+      unsigned timeStamp = (frame*frameTime) & 0xffff;
+      PBYTEArray media;
+      MakeMedia(call, timeStamp, media);
+      PBYTEArray packet(4 + media.GetSize());
+      packet[0] = (BYTE)((call+2) >> 8);
+      packet[1] = (BYTE)(call+2);
+      packet[2] = (BYTE)(timeStamp >> 8);
+      packet[3] = (BYTE)timeStamp;
+      memcpy(packet.GetPointer() + 4, media, media.GetSize());
+      if (!sender.WriteTo(packet, packet.GetSize(), loopback, relay.GetPort())) {
+        cerr << "Write failed: " << sender.GetErrorText() << endl;
+        return;
+      }
+      ++miniPackets;
+      miniBytes += packet.GetSize();
+    }
+
+    // The sending endpoint gathers the period's mini frames into the trunk
+    for (unsigned call = 0; call < callCount; ++call) {
+      IAX2Frame raw(*endpoint);
+      if (!raw.ReadNetworkPacket(relay) || !raw.ProcessNetworkPacket() || !raw.IsAudio()) {
+        cerr << "Mini frame " << call << " of period " << frame << " not received" << endl;
+        return;
+      }
+
+      IAX2MiniFrame mini(raw);
+      mini.ProcessNetworkPacket();
+      if (!trunk.AddMiniFrame(mini)) {
+        trunkBytes += IAX2Frame::MetaTrunkHeaderSize + trunk.GetEntries()*(IAX2Frame::MetaTrunkEntrySize + m_mediaSize);
+        ++trunkPackets;
+        trunk.Transmit(relay);
+        if (!ReceiveTrunk(*endpoint, receiver))
+          return;
+        trunk.AddMiniFrame(mini);
+      }
+    }
+
+    if (trunk.GetEntries() > 0) {
+      trunkBytes += IAX2Frame::MetaTrunkHeaderSize + trunk.GetEntries()*(IAX2Frame::MetaTrunkEntrySize + m_mediaSize);
+      ++trunkPackets;
+      trunk.Transmit(relay);
+      if (!ReceiveTrunk(*endpoint, receiver))
+        return;
+    }
+  }
+  PTimeInterval elapsed = PTimer::Tick() - started;
+
+  double seconds = frameCount*frameTime/1000.0;
+  cout << "\nWithout trunking: " << setw(8) << (unsigned)(miniPackets/seconds) << " packets/s, "
+                                 << setw(10) << (unsigned)(miniBytes/seconds) << " bytes/s\n"
+          "With trunking:    " << setw(8) << (unsigned)(trunkPackets/seconds) << " packets/s, "
+                               << setw(10) << (unsigned)(trunkBytes/seconds) << " bytes/s\n"
+          "Packet reduction: " << setprecision(1) << fixed << (trunkPackets > 0 ? (double)miniPackets/trunkPackets : 0.0) << "x\n"
+          "Entries checked:  " << m_received << " of " << miniPackets << ", " << m_errors << " errors\n"
+          "Processing time:  " << elapsed << 's'
+       << endl;
+
+  if (m_received != miniPackets || m_errors > 0)
+    SetTerminationValue(1);
+}
+
+
+void IAX2Trunk::MakeMedia(unsigned call, unsigned timeStamp, PBYTEArray & media)
+{
+  media.SetSize(m_mediaSize);
+  for (unsigned i = 0; i < m_mediaSize; ++i)
+    media[i] = (BYTE)(call*7 + timeStamp*3 + i);
+}
+
+
+bool IAX2Trunk::ReceiveTrunk(IAX2EndPoint & endpoint, PUDPSocket & socket)
+{
+  IAX2Frame trunkFrame(endpoint);
+  if (!trunkFrame.ReadNetworkPacket(socket) || !trunkFrame.ProcessNetworkPacket() || !trunkFrame.IsTrunkFrame()) {
+    cerr << "Trunk frame not received" << endl;
+    return false;
+  }
+
+  IAX2FrameList frames;
+  if (!trunkFrame.SplitTrunkFrame(frames)) {
+    cerr << "Trunk frame could not be split" << endl;
+    return false;
+  }
+
+  IAX2Frame * entry;
+  while ((entry = frames.GetLastFrame()) != NULL) {
+    IAX2MiniFrame mini(*entry);
+    mini.ProcessNetworkPacket();
+
+    unsigned call = mini.GetRemoteInfo().SourceCallNumber() - 2;
+    unsigned timeStamp = mini.GetTimeStamp() & 0xffff;
+    PBYTEArray expected;
+    MakeMedia(call, timeStamp, expected);
+
+    if (call >= 0x7ffe ||
+        mini.GetMediaDataSize() != expected.GetSize() ||
+        memcmp(mini.GetMediaDataPointer(), expected, expected.GetSize()) != 0) {
+      PTRACE(2, "IAX2Trunk", "Entry for call " << call << " at " << timeStamp << " does not match");
+      ++m_errors;
+    }
+
+    ++m_received;
+    delete entry;
+  }
+
+  return true;
+}
+
+#else
+
+#error Cannot build IAX2 trunking test without IAX2
+
+#endif // OPAL_IAX2
+
+
+// End of File ///////////////////////////////////////////////////////////////
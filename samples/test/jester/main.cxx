@@ -36,6 +36,10 @@
 #include "main.h"
 #include "../../../version.h"
 
+#include <time.h>
+#include <algorithm>
+#include <set>
+
 
 #define new PNEW
 
@@ -77,6 +81,7 @@ JesterProcess::JesterProcess()
   , m_lastSilentTimestamp(0)
   , m_lastGeneratedJitter(0)
   , m_lastFrameTime(0)
+  , m_lostPackets(0)
 {
 }
 
@@ -97,7 +102,12 @@ void JesterProcess::Main()
              "S-size: size of each RTP packet in ms\n"
              "m-marker. turn some of the marker bits off, that indicate speech bursts\n"
              "P-pcap: Read RTP data from PCAP file\n"
-             "R. Non real time test\n"
+             "-session: RTP session in PCAP file to use, rather than asking\n"
+             "R-simulate. Non real time simulation, runs as fast as possible\n"
+             "b-jitter-buffer: jitter buffer types to simulate, comma separated, default audio\n"
+             "-jitter-params: jitter buffer tuning parameters (see below)\n"
+             "-seed: random number seed for generated jitter, default 1\n"
+             "-csv. output simulation results as CSV\n"
              "v-version. report version and program info.\n"
              "w-wavfile:audio file from which the source data is read from\n"
              PTRACE_ARGLIST
@@ -109,6 +119,15 @@ void JesterProcess::Main()
             "jitter levels. e.g. \"0=30,16000=60,48000=120,64000=30\" would start at\n"
             "30ms, thena 2 seconds in generate 60ms of jitter, at 6 seconds 120ms,\n"
             "finally at 8 seconds back to 30ms for the remainder of the test.\n"
+            "\n"
+            "The jitter buffer tuning parameters are a comma separated list of\n"
+            "name=value pairs, all in milliseconds except overrun-factor, from:\n"
+            "  initial, grow, shrink-period, shrink, silence-period, silence-shrink,\n"
+            "  drift-period and overrun-factor\n"
+            "\n"
+            "A simulation replays the same packets through each jitter buffer type,\n"
+            "\"none\" being no jitter buffer at all, in virtual time, and reports the\n"
+            "latency added, the frames lost, late or concealed and the CPU used.\n"
             "\n";
     return;
   }
@@ -149,7 +168,35 @@ void JesterProcess::Main()
         << 20 << '-' << 1000 << endl;
     }
   } 
+
+  static struct {
+    const char * m_name;
+    unsigned OpalJitterBuffer::Params::* m_member;
+  } const TuningParams[] = {
+    { "initial",         &OpalJitterBuffer::Params::m_currentJitterDelay  },
+    { "grow",            &OpalJitterBuffer::Params::m_jitterGrowTime      },
+    { "shrink-period",   &OpalJitterBuffer::Params::m_jitterShrinkPeriod  },
+    { "shrink",          &OpalJitterBuffer::Params::m_jitterShrinkTime    },
+    { "silence-period",  &OpalJitterBuffer::Params::m_silenceShrinkPeriod },
+    { "silence-shrink",  &OpalJitterBuffer::Params::m_silenceShrinkTime   },
+    { "drift-period",    &OpalJitterBuffer::Params::m_jitterDriftPeriod   },
+    { "overrun-factor",  &OpalJitterBuffer::Params::m_overrunFactor       }
+  };
+  PStringArray tuning = args.GetOptionString("jitter-params").Tokenise(',', false);
+  for (PINDEX i = 0; i < tuning.GetSize(); ++i) {
+    PStringArray param = tuning[i].Tokenise('=');
+    size_t p = 0;
+    while (param.GetSize() == 2 && p < PARRAYSIZE(TuningParams) && !(param[0] *= TuningParams[p].m_name))
+      ++p;
+    if (p >= PARRAYSIZE(TuningParams)) {
+      cerr << "Illegal jitter buffer parameter \"" << tuning[i] << '"' << endl;
+      return;
+    }
+    init.*TuningParams[p].m_member = param[1].AsUnsigned();
+  }
+
   m_jitterBuffer.SetDelay(init);
+  m_random.SetSeed(args.GetOptionString("seed", "1").AsUnsigned());
 
   m_silenceSuppression = args.HasOption('s');
   m_dropPackets = args.HasOption('d');
@@ -170,22 +217,32 @@ void JesterProcess::Main()
     m_generateJitter[change[0].AsUnsigned()] = change[1].AsUnsigned();
   }
 
-  if (!m_wavFile.Open(args.GetOptionString('w', "../callgen/ogm.wav"), PFile::ReadOnly)) {
+  bool simulate = args.HasOption('R');
+
+  // With CSV output, only the results go to stdout so it can be redirected
+  bool csv = simulate && args.HasOption("csv");
+  ostream & info = csv ? cerr : cout;
+
+  // Simulation does not listen to the audio, so only needs the WAV file if asked for
+  if ((!simulate || args.HasOption('w')) &&
+        !m_wavFile.Open(args.GetOptionString('w', "../callgen/ogm.wav"), PFile::ReadOnly)) {
     cerr << "the audio file " << m_wavFile.GetName() << " does not exist." << endl;
     return;
   }
 
-  PString audioDevice = args.GetOptionString('a', PSoundChannel::GetDefaultDevice(PSoundChannel::Player));
-  if (!m_player.Open(audioDevice, PSoundChannel::Player, 1, m_sampleRate)) {
-    cerr << "Failed to open the sound device \"" << audioDevice 
-         << "\", available devices:\n";
-    PStringList namesPlay = PSoundChannel::GetDeviceNames(PSoundChannel::Player);
-    for (PINDEX i = 0; i < namesPlay.GetSize(); i++)
-      cerr << i << "  " << namesPlay[i] << endl;
-    cerr << endl;
-    return;
+  if (!simulate) {
+    PString audioDevice = args.GetOptionString('a', PSoundChannel::GetDefaultDevice(PSoundChannel::Player));
+    if (!m_player.Open(audioDevice, PSoundChannel::Player, 1, m_sampleRate)) {
+      cerr << "Failed to open the sound device \"" << audioDevice 
+           << "\", available devices:\n";
+      PStringList namesPlay = PSoundChannel::GetDeviceNames(PSoundChannel::Player);
+      for (PINDEX i = 0; i < namesPlay.GetSize(); i++)
+        cerr << i << "  " << namesPlay[i] << endl;
+      cerr << endl;
+      return;
+    }
+    m_player.SetBuffers(m_bytesPerBlock, 160/(m_sampleRate/1000)/2);
   }
-  m_player.SetBuffers(m_bytesPerBlock, 160/(m_sampleRate/1000)/2);
 
   if (args.HasOption('P')) {
     if (!m_pcap.Open(args.GetOptionString('P'))) {
@@ -193,26 +250,35 @@ void JesterProcess::Main()
       return;
     }
 
-    cout << "Analysing PCAP file ... " << flush;
+    info << "Analysing PCAP file ... " << flush;
     OpalPCAPFile::DiscoveredRTP discoveredRTP;
     if (!m_pcap.DiscoverRTP(discoveredRTP)) {
       cerr << "error: no RTP sessions found" << endl;
       return;
     }
 
-    cout << "\nSelect one of the following sessions:\n" << discoveredRTP << endl;
-    for (;;) {
-      cout << "Session? " << flush;
-      size_t session;
-      cin >> session;
-      if (m_pcap.SetFilters(discoveredRTP[session]))
-        break;
-      cout << "Session " << session << " is not valid" << endl;
+    if (args.HasOption("session")) {
+      size_t session = args.GetOptionString("session").AsUnsigned();
+      if (session >= discoveredRTP.size() || !m_pcap.SetFilters(discoveredRTP[session])) {
+        cerr << "Session " << session << " is not valid, available sessions:\n" << discoveredRTP << endl;
+        return;
+      }
+    }
+    else {
+      info << "\nSelect one of the following sessions:\n" << discoveredRTP << endl;
+      for (;;) {
+        info << "Session? " << flush;
+        size_t session;
+        cin >> session;
+        if (m_pcap.SetFilters(discoveredRTP[session]))
+          break;
+        info << "Session " << session << " is not valid" << endl;
+      }
     }
-    cout << "\nPCAP file         : " << m_pcap.GetFilePath() << endl;
+    info << "\nPCAP file         : " << m_pcap.GetFilePath() << endl;
   }
   else {
-    cout << "Packet size       : " << m_bytesPerBlock << " bytes (" << m_bytesPerBlock/(m_sampleRate/1000)/2 << "ms)\n"
+    info << "Packet size       : " << m_bytesPerBlock << " bytes (" << m_bytesPerBlock/(m_sampleRate/1000)/2 << "ms)\n"
             "Generated jitter  : " << m_generateJitter << "\n"
             "Silence periods   : " << (m_silenceSuppression ? "yes" : "no") << "\n"
             "Suppress markers  : " << (m_markerSuppression ? "yes" : "no") << "\n"
@@ -220,66 +286,24 @@ void JesterProcess::Main()
          << endl;
   }
 
-  cout << "Jitter buffer size: " << init.m_minJitterDelay << ".." << init.m_maxJitterDelay << " timestamp units" << endl;
-
-  if (args.HasOption('R')) {
-    PTimeInterval genTick = m_startTimeDelta;
-    PTimeInterval outTick;
-    PINDEX lastReadTimeDelta = 80;
-    while (m_pcap.IsOpen() ? !m_pcap.IsEndOfFile() : (m_generateSequenceNumber < m_maxSequenceNumber)) {
-      RTP_DataFrame writeFrame;
-      PTimeInterval delay;
-      bool gotFrame = GenerateFrame(writeFrame, delay);
-      genTick += delay;
-
-      while (outTick <= genTick) {
-        RTP_DataFrame readFrame(m_bytesPerBlock);
-        readFrame.SetTimestamp(m_playbackTimestamp);
-        if (!m_jitterBuffer.ReadData(readFrame, 0, outTick))
-          break;
-
-        DWORD ts = readFrame.GetTimestamp();
-        PINDEX sz = readFrame.GetPayloadSize();
-        PTRACE(5, "Jester\tExtracted frame : "
-                  "ts=" << setw(8) << ts << " "
-                  "tick=" << setw(7) << outTick << " "
-                  "sz=" << sz);
-        if (sz == 0)
-          m_playbackTimestamp += lastReadTimeDelta;
-        else {
-          switch (readFrame.GetPayloadType()) {
-            case RTP_DataFrame::PCMA :
-            case RTP_DataFrame::PCMU :
-              lastReadTimeDelta = sz;
-              break;
-            case RTP_DataFrame::G729 :
-              lastReadTimeDelta = sz/10*80;
-              break;
-            case RTP_DataFrame::G723 :
-              lastReadTimeDelta = sz/24*240;
-              break;
-            default :
-              lastReadTimeDelta = 160;
-          }
-          m_playbackTimestamp = ts + lastReadTimeDelta;
-        }
-        outTick += lastReadTimeDelta/(m_sampleRate/1000);
-#if 0
-        static unsigned adjust = 0;
-        outTick -= ++adjust % 3 > 0;
-#endif
-      }
+  info << "Jitter buffer size: " << init.m_minJitterDelay << ".." << init.m_maxJitterDelay << " timestamp units" << endl;
 
-      if (gotFrame) {
-        DWORD ts = writeFrame.GetTimestamp();
-        PTRACE(5, "Jester\tInserting frame : "
-                  "ts=" << setw(8) << ts << " "
-                  "tick=" << setw(7) << genTick << " "
-                  "(" << PTimeInterval(ts/(m_sampleRate/1000)) << ')');
-        if (!m_jitterBuffer.WriteData(writeFrame, genTick))
-          break;
-      }
+  if (simulate) {
+    JesterTrace trace;
+    LoadTrace(trace);
+    if (trace.empty()) {
+      cerr << "No packets to simulate" << endl;
+      return;
     }
+
+    if (csv)
+      cout << "jitter_buffer,packets,lost,played,late,too_late,overruns,concealed,"
+              "latency_min,latency_p50,latency_p90,latency_p99,latency_max,cpu_us_per_packet" << endl;
+
+    PStringArray types = args.GetOptionString('b', "audio").Tokenise(',', false);
+    for (PINDEX i = 0; i < types.GetSize(); ++i)
+      Simulate(types[i], init, trace, csv);
+    return;
   }
   else {
     cout << "Audio device      : " << m_player.GetName() << endl;
@@ -318,7 +342,7 @@ void JesterProcess::GeneratePackets(PThread &, P_INT_PTR)
   while (m_keepRunning) {
     RTP_DataFrame frame;
     PTimeInterval delay;
-    bool gotFrame = GenerateFrame(frame, delay);
+    bool gotFrame = GenerateFrame(frame, delay, PTimer::Tick() - m_initialTick);
 
     if (delay > 0)
       PThread::Sleep(delay);
@@ -333,7 +357,7 @@ void JesterProcess::GeneratePackets(PThread &, P_INT_PTR)
 }
 
 
-bool JesterProcess::GenerateFrame(RTP_DataFrame & frame, PTimeInterval & delay)
+bool JesterProcess::GenerateFrame(RTP_DataFrame & frame, PTimeInterval & delay, const PTimeInterval & elapsed)
 {
   if (m_pcap.IsOpen()) {
     RTP_DataFrame rtp;
@@ -384,7 +408,7 @@ bool JesterProcess::GenerateFrame(RTP_DataFrame & frame, PTimeInterval & delay)
     m_lastFrameWasSilence = false;
   }
 
-  if (!m_wavFile.Read(frame.GetPayloadPtr(), m_bytesPerBlock)) {
+  if (m_wavFile.IsOpen() && !m_wavFile.Read(frame.GetPayloadPtr(), m_bytesPerBlock)) {
     m_wavFile.Close();
     m_wavFile.Open();
     PTRACE(3, "Jester\tRestarted sound file");
@@ -397,8 +421,8 @@ bool JesterProcess::GenerateFrame(RTP_DataFrame & frame, PTimeInterval & delay)
                "Jester\tGenerated jitter changed to " << it->second << "ms");
   m_lastGeneratedJitter = it->second;
   delay.SetInterval(elapsedTimestamp/(m_sampleRate/1000)
-                          - (PTimer::Tick() - m_initialTick).GetMilliSeconds()
-                          + PRandom::Number(m_lastGeneratedJitter));
+                          - elapsed.GetMilliSeconds()
+                          + m_random.Generate()%(m_lastGeneratedJitter+1));
 
   m_generateTimestamp += m_bytesPerBlock/2;
 
@@ -406,6 +430,203 @@ bool JesterProcess::GenerateFrame(RTP_DataFrame & frame, PTimeInterval & delay)
 }
 
 
+void JesterProcess::LoadTrace(JesterTrace & trace)
+{
+  // Sequence numbers skipped over, but which may yet arrive out of order
+  static const RTP_SequenceNumber MaxReorder = 1000;
+  std::set<RTP_SequenceNumber> missing;
+
+  PTimeInterval tick = m_startTimeDelta;
+  bool haveSequence = false;
+  RTP_SequenceNumber expectedSequence = 0;
+
+  while (m_pcap.IsOpen() ? !m_pcap.IsEndOfFile() : (m_generateSequenceNumber < m_maxSequenceNumber)) {
+    RTP_DataFrame frame;
+    PTimeInterval delay;
+    bool gotFrame = GenerateFrame(frame, delay, tick - m_startTimeDelta);
+
+    // Arrival order is what the jitter buffer sees, so virtual time never goes backwards
+    if (delay > 0)
+      tick += delay;
+
+    if (gotFrame) {
+      RTP_SequenceNumber sequence = frame.GetSequenceNumber();
+      RTP_SequenceNumber gap = (RTP_SequenceNumber)(sequence - expectedSequence);
+      RTP_SequenceNumber behind = (RTP_SequenceNumber)(expectedSequence - sequence);
+      if (haveSequence && gap != 0 && behind <= MaxReorder)
+        missing.erase(sequence); // Arrived late, or a duplicate
+      else {
+        if (haveSequence) {
+          if (gap < MaxReorder) {
+            for (RTP_SequenceNumber i = 0; i < gap; ++i)
+              missing.insert((RTP_SequenceNumber)(expectedSequence + i));
+          }
+          else {
+            // A jump this big is the sender resynchronising, not loss, and
+            // anything still missing from before it is never going to arrive
+            PTRACE(3, "Jester\tSequence resync from " << expectedSequence << " to " << sequence);
+            m_lostPackets += missing.size();
+            missing.clear();
+          }
+        }
+        haveSequence = true;
+        expectedSequence = (RTP_SequenceNumber)(sequence + 1);
+
+        // Anything too far behind is never going to turn up
+        for (std::set<RTP_SequenceNumber>::iterator it = missing.begin(); it != missing.end(); ) {
+          if ((RTP_SequenceNumber)(expectedSequence - *it) > MaxReorder) {
+            ++m_lostPackets;
+            missing.erase(it++);
+          }
+          else
+            ++it;
+        }
+      }
+      trace.push_back(JesterArrival(tick, frame));
+    }
+  }
+
+  m_lostPackets += missing.size();
+
+  PTRACE(3, "Jester\tLoaded " << trace.size() << " packets, " << m_lostPackets << " lost, "
+            "duration " << (trace.empty() ? PTimeInterval() : trace.back().m_tick - trace.front().m_tick));
+}
+
+
+void JesterProcess::Simulate(const PString & type,
+                             const OpalJitterBuffer::Init & init,
+                             const JesterTrace & trace,
+                             bool csv)
+{
+  OpalJitterBuffer * jitterBuffer;
+  if (type *= "none")
+    jitterBuffer = new OpalNonJitterBuffer(init);
+  else if ((jitterBuffer = OpalJitterBufferFactory::CreateInstance(type, init)) == NULL) {
+    cerr << "Unknown jitter buffer type \"" << type << '"' << endl;
+    return;
+  }
+
+  unsigned msUnits = m_sampleRate/1000;
+  map<RTP_Timestamp, PTimeInterval> pending;
+  vector<PInt64> latencies;
+  latencies.reserve(trace.size());
+  RTP_Timestamp playbackTimestamp = m_playbackTimestamp;
+  RTP_Timestamp highestTimestamp = 0;
+  PINDEX lastReadTimeDelta = 80;
+  unsigned concealed = 0;
+  bool written = false;
+  bool playing = false;
+
+  PTimeInterval outTick;
+  PTimeInterval endTick = trace.back().m_tick + PTimeInterval(init.m_maxJitterDelay);
+  JesterTrace::const_iterator arrival = trace.begin();
+
+  clock_t cpuStart = clock();
+
+  while (outTick <= endTick) {
+    // Deliver everything that has arrived by the time of the next read
+    while (arrival != trace.end() && arrival->m_tick <= outTick) {
+      RTP_Timestamp ts = arrival->m_frame.GetTimestamp();
+      pending[ts] = arrival->m_tick;
+      if (!written || (int)(ts - highestTimestamp) > 0)
+        highestTimestamp = ts;
+      written = true;
+      jitterBuffer->WriteData(arrival->m_frame, arrival->m_tick);
+      ++arrival;
+    }
+
+    RTP_DataFrame readFrame(m_bytesPerBlock);
+    readFrame.SetTimestamp(playbackTimestamp);
+    if (!jitterBuffer->ReadData(readFrame, 0, outTick))
+      break;
+
+    PINDEX sz = readFrame.GetPayloadSize();
+    if (sz == 0) {
+      // A gap while later audio is already waiting is one the decoder must conceal
+      if (playing && written && (int)(highestTimestamp - playbackTimestamp) > 0)
+        ++concealed;
+      playbackTimestamp += lastReadTimeDelta;
+    }
+    else {
+      RTP_Timestamp ts = readFrame.GetTimestamp();
+      map<RTP_Timestamp, PTimeInterval>::iterator it = pending.find(ts);
+      if (it != pending.end()) {
+        latencies.push_back((outTick - it->second).GetMilliSeconds());
+        pending.erase(it);
+      }
+      playing = true;
+
+      switch (readFrame.GetPayloadType()) {
+        case RTP_DataFrame::PCMA :
+        case RTP_DataFrame::PCMU :
+          lastReadTimeDelta = sz;
+          break;
+        case RTP_DataFrame::G729 :
+          lastReadTimeDelta = sz/10*80;
+          break;
+        case RTP_DataFrame::G723 :
+          lastReadTimeDelta = sz/24*240;
+          break;
+        case RTP_DataFrame::L16_Mono :
+          lastReadTimeDelta = sz/2;
+          break;
+        default :
+          lastReadTimeDelta = 160;
+      }
+      playbackTimestamp = ts + lastReadTimeDelta;
+    }
+    outTick += std::max(lastReadTimeDelta/(PINDEX)msUnits, (PINDEX)1);
+  }
+
+  double cpuPerPacket = (double)(clock() - cpuStart)*1000000/CLOCKS_PER_SEC/trace.size();
+
+  unsigned tooLate = jitterBuffer->GetPacketsTooLate();
+  unsigned overruns = jitterBuffer->GetBufferOverruns();
+  delete jitterBuffer;
+
+  std::sort(latencies.begin(), latencies.end());
+  PInt64 percentiles[5] = { 0, 0, 0, 0, 0 };
+  if (!latencies.empty()) {
+    static const unsigned Points[5] = { 0, 50, 90, 99, 100 };
+    for (PINDEX i = 0; i < 5; ++i)
+      percentiles[i] = latencies[(latencies.size()-1)*Points[i]/100];
+  }
+
+  size_t late = trace.size() - latencies.size();
+
+  if (csv) {
+    cout << type << ','
+         << trace.size() << ','
+         << m_lostPackets << ','
+         << latencies.size() << ','
+         << late << ','
+         << tooLate << ','
+         << overruns << ','
+         << concealed;
+    for (PINDEX i = 0; i < 5; ++i)
+      cout << ',' << percentiles[i];
+    cout << ',' << cpuPerPacket << endl;
+    return;
+  }
+
+  cout << "Jitter buffer \"" << type << "\"\n"
+          "  Packets in trace      = " << trace.size() << "\n"
+          "  Lost in trace         = " << m_lostPackets << "\n"
+          "  Frames played         = " << latencies.size() << "\n"
+          "  Frames never played   = " << late << "\n"
+          "  Too late packet count = " << tooLate << "\n"
+          "  Packet overrun count  = " << overruns << "\n"
+          "  Frames concealed      = " << concealed << "\n"
+          "  Added latency (ms)    = min " << percentiles[0]
+       << ", 50% " << percentiles[1]
+       << ", 90% " << percentiles[2]
+       << ", 99% " << percentiles[3]
+       << ", max " << percentiles[4] << "\n"
+          "  CPU per packet        = " << cpuPerPacket << "us\n"
+       << endl;
+}
+
+
 void JesterProcess::ConsumePackets(PThread &, P_INT_PTR)
 {
   if (m_startTimeDelta < 0)
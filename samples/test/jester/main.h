@@ -49,6 +49,21 @@
 
 typedef map<DWORD, DWORD> JitterProfileMap;
 
+
+/**A packet and the time it arrived, relative to the start of the trace. */
+struct JesterArrival
+{
+  JesterArrival(const PTimeInterval & tick, const RTP_DataFrame & frame)
+    : m_tick(tick)
+    , m_frame(frame)
+  { }
+
+  PTimeInterval m_tick;
+  RTP_DataFrame m_frame;
+};
+
+typedef vector<JesterArrival> JesterTrace;
+
 /////////////////////////////////////////////////////////////////////////////
 /**we use this class primarily to access variables in the OpalJitterBuffer*/
 class JesterJitterBuffer : public OpalAudioJitterBuffer
@@ -92,7 +107,20 @@ class JesterProcess : public PProcess
 #endif
 
     void Report();
-    bool GenerateFrame(RTP_DataFrame & frame, PTimeInterval & delay);
+    bool GenerateFrame(RTP_DataFrame & frame, PTimeInterval & delay, const PTimeInterval & elapsed);
+
+    /**Collect the complete arrival trace, from the PCAP file or generated,
+       so every simulation replays exactly the same packets. */
+    void LoadTrace(JesterTrace & trace);
+
+    /**Replay the trace through a jitter buffer in virtual time, as fast as
+       possible, and report the latency and loss it produced. */
+    void Simulate(
+      const PString & type,
+      const OpalJitterBuffer::Init & init,
+      const JesterTrace & trace,
+      bool csv
+    );
 
     /**Handle user input, which is keys to describe the status of the program,
        while the different loops run. The program will not finish until this
@@ -139,6 +167,12 @@ class JesterProcess : public PProcess
     /**Maximum generated jitter */
     JitterProfileMap m_generateJitter;
 
+    /**Source of generated jitter, seeded so runs are repeatable */
+    PRandom m_random;
+
+    /**Packets missing from the trace, by sequence number */
+    unsigned m_lostPackets;
+
     /**the timestamp, as used by the generate thread */
     DWORD m_generateTimestamp;
     DWORD m_initialTimestamp;
@@ -0,0 +1,193 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for media format option lookup benchmark
+ *
+ * Copyright (c) 2017 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <opal_config.h>
+#include <opal/mediafmt.h>
+
+
+/* Times OpalMediaFormat option reads, by name and by OpalMediaOptionKey, on
+   a number of threads, each with its own copy of the format as each media
+   stream has, and with all of them reading the one format. Then, while the
+   threads read an option by key, another repeatedly replaces that option,
+   which removes one and adds one without changing the number of options.
+   Every read must see one of the values written. */
+
+static const char BenchOptionName[] = "Bench Replaced";
+
+
+class MediaOptions : public PProcess
+{
+    PCLASSINFO(MediaOptions, PProcess)
+  public:
+    MediaOptions();
+
+    virtual void Main();
+
+  protected:
+    enum Modes {
+      ByName,
+      ByKey,
+      SharedByKey
+    };
+    PTimeInterval Run(Modes mode);
+    void Reader(Modes mode);
+    void Replacer();
+
+    OpalMediaFormat    m_format;
+    OpalMediaOptionKey m_clockRateKey;
+    OpalMediaOptionKey m_replacedKey;
+    unsigned           m_threads;
+    unsigned           m_lookups;
+    atomic<unsigned>   m_errors;
+    atomic<bool>       m_replacing;
+};
+
+
+PCREATE_PROCESS(MediaOptions);
+
+
+MediaOptions::MediaOptions()
+  : PProcess("Open Phone Abstraction Library", "Media Options", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_BUILD)
+  , m_clockRateKey(OpalMediaFormat::ClockRateOption())
+  , m_replacedKey(BenchOptionName)
+  , m_threads(4)
+  , m_lookups(1000000)
+  , m_errors(0)
+  , m_replacing(false)
+{
+}
+
+
+void MediaOptions::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "f-format: Media format to read, default " OPAL_G711_ULAW_64K "\n"
+             "t-threads: Number of threads reading, default 4\n"
+             "l-lookups: Lookups per thread, default 1000000\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  m_format = args.GetOptionString('f', OPAL_G711_ULAW_64K);
+  if (!m_format.IsValid()) {
+    cerr << "Unknown media format \"" << args.GetOptionString('f') << '"' << endl;
+    SetTerminationValue(1);
+    return;
+  }
+
+  m_threads = std::max(1U, args.GetOptionString('t', "4").AsUnsigned());
+  m_lookups = std::max(1U, args.GetOptionString('l', "1000000").AsUnsigned());
+  m_format.AddOption(new OpalMediaOptionUnsigned(BenchOptionName, false, OpalMediaOption::NoMerge, 1), true);
+
+  PUInt64 total = (PUInt64)m_threads*m_lookups;
+  cout << m_format << ", " << m_format.GetOptionCount() << " options, "
+       << m_threads << " threads, " << total << " lookups" << endl;
+
+  PTimeInterval byName = Run(ByName);
+  PTimeInterval byKey = Run(ByKey);
+  PTimeInterval sharedByKey = Run(SharedByKey);
+
+  m_replacing = true;
+  PThread * replacer = new PThreadObj<MediaOptions>(*this, &MediaOptions::Replacer, false, "Replacer");
+  Run(SharedByKey);
+  m_replacing = false;
+  replacer->WaitForTermination();
+  delete replacer;
+
+  cout << "Own copy, by name:  " << setw(8) << byName.GetMicroSeconds()*1000/total << "ns/lookup\n"
+          "Own copy, by key:   " << setw(8) << byKey.GetMicroSeconds()*1000/total << "ns/lookup\n"
+          "Shared, by key:     " << setw(8) << sharedByKey.GetMicroSeconds()*1000/total << "ns/lookup\n"
+          "Bad values read:    " << setw(8) << m_errors << endl;
+
+  if (m_errors != 0) {
+    cerr << "Options read while being replaced had bad values" << endl;
+    SetTerminationValue(1);
+  }
+}
+
+
+PTimeInterval MediaOptions::Run(Modes mode)
+{
+  PTimeInterval start = PTimer::Tick();
+
+  PList<PThread> readers;
+  for (unsigned i = 0; i < m_threads; ++i)
+    readers.Append(new PThreadObj1Arg<MediaOptions, Modes>(*this, mode, &MediaOptions::Reader, false, "Reader"));
+  for (PList<PThread>::iterator it = readers.begin(); it != readers.end(); ++it)
+    it->WaitForTermination();
+  readers.RemoveAll();
+
+  return PTimer::Tick() - start;
+}
+
+
+void MediaOptions::Reader(Modes mode)
+{
+  if (mode == SharedByKey) {
+    for (unsigned i = 0; i < m_lookups; ++i) {
+      int value = m_format.GetOptionInteger(m_replacedKey, 0);
+      if (value != 1 && value != 2)
+        ++m_errors;
+    }
+    return;
+  }
+
+  // As a media stream has, its own copy of the format
+  OpalMediaFormat format = m_format;
+  format.MakeUnique();
+  PString name = OpalMediaFormat::ClockRateOption();
+
+  PUInt64 sum = 0;
+  if (mode == ByName) {
+    for (unsigned i = 0; i < m_lookups; ++i)
+      sum += format.GetOptionInteger(name);
+  }
+  else {
+    for (unsigned i = 0; i < m_lookups; ++i)
+      sum += format.GetOptionInteger(m_clockRateKey);
+  }
+
+  if (sum != (PUInt64)format.GetClockRate()*m_lookups)
+    ++m_errors;
+}
+
+
+void MediaOptions::Replacer()
+{
+  // Each replacement retires the old option, so don't go on forever
+  for (unsigned count = 0; m_replacing && count < 100000; ++count)
+    m_format.AddOption(new OpalMediaOptionUnsigned(BenchOptionName, false, OpalMediaOption::NoMerge, 1 + count%2), true);
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
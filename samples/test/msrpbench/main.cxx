@@ -0,0 +1,213 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for MSRP benchmark
+ *
+ * Copyright (c) 2017 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <opal/manager.h>
+#include <im/msrp.h>
+
+
+/* Runs a number of MSRP sessions through an OpalMSRPManager that talks to
+   its own listener, so both the sending and receiving sides are serviced by
+   its handler threads. MSRP shares a TCP connection per remote address, so
+   sessions are spread over distinct loopback addresses, 127.0.0.1 upwards,
+   to get more than one connection. Reports messages and bytes per second. */
+
+#if OPAL_HAS_MSRP
+
+class MSRPBench : public PProcess
+{
+    PCLASSINFO(MSRPBench, PProcess)
+  public:
+    MSRPBench();
+
+    virtual void Main();
+
+  protected:
+    void Sender(unsigned first);
+
+    PDECLARE_NOTIFIER2(OpalMSRPManager, MSRPBench, OnReceived, OpalMSRPManager::IncomingMSRP &);
+
+    struct Session {
+      PURL m_localURL;
+      PURL m_remoteURL;
+      PSafePtr<OpalMSRPManager::Connection> m_connection;
+    };
+    std::vector<Session> m_sessions;
+
+    unsigned m_senders;
+    unsigned m_messages;
+    PString  m_text;
+
+    atomic<unsigned> m_sent;
+    atomic<unsigned> m_failed;
+    atomic<unsigned> m_received;
+    atomic<unsigned> m_receivedBytes;
+    PSyncPoint       m_allReceived;
+    unsigned         m_expected;
+};
+
+
+PCREATE_PROCESS(MSRPBench);
+
+
+MSRPBench::MSRPBench()
+  : PProcess("Open Phone Abstraction Library", "MSRP Benchmark", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_BUILD)
+  , m_senders(1)
+  , m_messages(1)
+  , m_sent(0)
+  , m_failed(0)
+  , m_received(0)
+  , m_receivedBytes(0)
+  , m_expected(0)
+{
+}
+
+
+void MSRPBench::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "s-sessions: Number of MSRP sessions, default 1000\n"
+             "c-connections: Number of TCP connections (loopback addresses), default 16, max 254\n"
+             "n-messages: Messages per session, default 10\n"
+             "l-length: Message length in bytes, default 100, over 1024 is sent in chunks\n"
+             "t-threads: Sending threads, default 8\n"
+             "p-port: Listener port, default 12855\n"
+             "w-wait: Seconds to wait for all messages, default 60\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  unsigned sessionCount = std::max(1U, args.GetOptionString('s', "1000").AsUnsigned());
+  unsigned connectionCount = std::max(1U, std::min(254U, args.GetOptionString('c', "16").AsUnsigned()));
+  m_messages = std::max(1U, args.GetOptionString('n', "10").AsUnsigned());
+  m_senders = std::max(1U, std::min(sessionCount, args.GetOptionString('t', "8").AsUnsigned()));
+  WORD port = (WORD)args.GetOptionString('p', "12855").AsUnsigned();
+  PTimeInterval wait(0, args.GetOptionString('w', "60").AsUnsigned());
+
+  unsigned length = std::max(1U, args.GetOptionString('l', "100").AsUnsigned());
+  m_text = std::string(length, 'x').c_str();
+
+  OpalManager manager;
+  OpalMSRPManager msrp(manager, port);
+  if (!msrp.GetLocalPort(port)) {
+    cerr << "No MSRP listener" << endl;
+    return;
+  }
+
+  m_expected = sessionCount*m_messages*((length+MSRPProtocol::MaximumMessageLength-1)/MSRPProtocol::MaximumMessageLength);
+
+  cout << sessionCount << " sessions over " << connectionCount << " connections, "
+       << m_messages << " messages of " << length << " bytes each, "
+       << m_senders << " sending threads" << endl;
+
+  PTimeInterval start = PTimer::Tick();
+  m_sessions.resize(sessionCount);
+  for (unsigned i = 0; i < sessionCount; ++i) {
+    Session & session = m_sessions[i];
+    PIPSocket::Address remote(127, 0, 0, (BYTE)(i%connectionCount + 1));
+    session.m_localURL = psprintf("msrp://127.0.0.1:%u/local%u;tcp", port, i);
+    session.m_remoteURL = psprintf("msrp://%s:%u/remote%u;tcp", (const char *)remote.AsString(), port, i);
+
+    // Messages arriving at the listener are addressed To the remote URL
+    msrp.SetNotifier(session.m_remoteURL, session.m_localURL, PCREATE_NOTIFIER2(OnReceived, OpalMSRPManager::IncomingMSRP &));
+
+    session.m_connection = msrp.OpenConnection(session.m_localURL, session.m_remoteURL);
+    if (session.m_connection == NULL) {
+      cerr << "Could not open connection to " << session.m_remoteURL << endl;
+      return;
+    }
+  }
+  PTimeInterval setupTime = PTimer::Tick() - start;
+
+  start = PTimer::Tick();
+  PList<PThread> senders;
+  for (unsigned i = 0; i < m_senders; ++i)
+    senders.Append(new PThreadObj1Arg<MSRPBench, unsigned>(*this, i, &MSRPBench::Sender, false, "Sender"));
+  for (PList<PThread>::iterator it = senders.begin(); it != senders.end(); ++it)
+    it->WaitForTermination();
+  PTimeInterval sendTime = PTimer::Tick() - start;
+
+  bool complete = m_allReceived.Wait(wait);
+  PTimeInterval totalTime = PTimer::Tick() - start;
+
+  unsigned received = m_received;
+  PInt64 ms = std::max(totalTime.GetMilliSeconds(), (PInt64)1);
+  cout << "\nSetup:      " << setupTime << "s\n"
+          "Sending:    " << sendTime << "s\n"
+          "Complete:   " << totalTime << 's' << (complete ? "" : " (timed out)") << "\n"
+          "Sent:       " << m_sent << " messages, " << m_failed << " failed\n"
+          "Received:   " << received << " of " << m_expected << " chunks\n"
+          "Throughput: " << received*1000/ms << " chunks/s, " << m_receivedBytes*1000/ms << " bytes/s"
+       << endl;
+
+  for (std::vector<Session>::iterator it = m_sessions.begin(); it != m_sessions.end(); ++it) {
+    msrp.RemoveNotifier(it->m_remoteURL, it->m_localURL);
+    msrp.CloseConnection(it->m_connection);
+  }
+
+  if (!complete || m_failed > 0)
+    SetTerminationValue(1);
+}
+
+
+void MSRPBench::Sender(unsigned first)
+{
+  for (unsigned message = 0; message < m_messages; ++message) {
+    for (size_t i = first; i < m_sessions.size(); i += m_senders) {
+      Session & session = m_sessions[i];
+      PString id;
+      if (session.m_connection->m_protocol->SendSEND(session.m_localURL, session.m_remoteURL, m_text, "text/plain", id))
+        ++m_sent;
+      else
+        ++m_failed;
+    }
+  }
+}
+
+
+void MSRPBench::OnReceived(OpalMSRPManager &, OpalMSRPManager::IncomingMSRP & incoming)
+{
+  if (incoming.m_command != MSRPProtocol::SEND)
+    return;
+
+  m_receivedBytes += incoming.m_body.GetLength();
+  if (++m_received == m_expected)
+    m_allReceived.Signal();
+}
+
+#else
+
+#error Cannot build MSRP benchmark without MSRP
+
+#endif // OPAL_HAS_MSRP
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,188 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for media format negotiation benchmark
+ *
+ * Copyright (c) 2017 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <opal/manager.h>
+#include <opal/transcoders.h>
+
+
+/* Registers extra audio formats until there are at least the requested
+   number, then negotiates the formats common to a number of simulated
+   connections, each offering a different subset, as OpalCall does. This is
+   done once by intersecting lists with HasFormat() and once with
+   OpalMediaFormatSet bit sets, the results compared and the times reported.
+   It also checks that GetPossibleFormats() returns the options of a
+   registered format after SetRegisteredMediaFormat() has changed them. */
+
+class Negotiate : public PProcess
+{
+    PCLASSINFO(Negotiate, PProcess)
+  public:
+    Negotiate();
+
+    virtual void Main();
+
+  protected:
+    bool CheckRegistryChange();
+};
+
+
+PCREATE_PROCESS(Negotiate);
+
+
+Negotiate::Negotiate()
+  : PProcess("Open Phone Abstraction Library", "Negotiate", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_BUILD)
+{
+}
+
+
+void Negotiate::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "f-formats: Minimum registered formats, default 60\n"
+             "c-connections: Number of connections in the call, default 3\n"
+             "i-iterations: Number of negotiations, default 10000\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  unsigned formatCount = args.GetOptionString('f', "60").AsUnsigned();
+  unsigned connectionCount = std::max(2U, args.GetOptionString('c', "3").AsUnsigned());
+  unsigned iterations = std::max(1U, args.GetOptionString('i', "10000").AsUnsigned());
+
+  // Makes sure all the plug in codecs are registered
+  OpalManager manager;
+
+  // The master list refers to the registering instance, so these are never deleted
+  OpalMediaFormatList allFormats = OpalMediaFormat::GetAllRegisteredMediaFormats();
+  for (unsigned i = 0; allFormats.GetSize() < (PINDEX)formatCount; ++i) {
+    new OpalAudioFormat(psprintf("Negotiate-%u", i), RTP_DataFrame::DynamicBase, "negotiate", 2, 1, 1, 1);
+    allFormats = OpalMediaFormat::GetAllRegisteredMediaFormats();
+  }
+
+  // Each connection offers a different, overlapping, subset
+  std::vector<OpalMediaFormatList> offers(connectionCount);
+  PINDEX position = 0;
+  for (OpalMediaFormatList::iterator format = allFormats.begin(); format != allFormats.end(); ++format, ++position) {
+    for (unsigned connection = 0; connection < connectionCount; ++connection) {
+      if (position % (connection+1) == 0 || position % 5 == 0)
+        offers[connection] += *format;
+    }
+  }
+
+  cout << allFormats.GetSize() << " registered formats, " << connectionCount << " connections" << endl;
+
+  OpalMediaFormatList listResult, setResult;
+
+  PTimeInterval start = PTimer::Tick();
+  for (unsigned count = 0; count < iterations; ++count) {
+    listResult = OpalTranscoder::GetPossibleFormats(offers[0]);
+    for (unsigned connection = 1; connection < connectionCount; ++connection) {
+      OpalMediaFormatList possibleFormats = OpalTranscoder::GetPossibleFormats(offers[connection]);
+      for (OpalMediaFormatList::iterator format = listResult.begin(); format != listResult.end(); ) {
+        if (possibleFormats.HasFormat(*format))
+          ++format;
+        else
+          listResult.erase(format++);
+      }
+    }
+  }
+  PTimeInterval listTime = PTimer::Tick() - start;
+
+  start = PTimer::Tick();
+  for (unsigned count = 0; count < iterations; ++count) {
+    setResult = OpalTranscoder::GetPossibleFormats(offers[0]);
+    OpalMediaFormatSet commonSet(setResult);
+    for (unsigned connection = 1; connection < connectionCount; ++connection)
+      commonSet &= OpalMediaFormatSet(OpalTranscoder::GetPossibleFormats(offers[connection]));
+    commonSet.RemoveMissing(setResult);
+  }
+  PTimeInterval setTime = PTimer::Tick() - start;
+
+  start = PTimer::Tick();
+  for (unsigned count = 0; count < iterations; ++count)
+    OpalTranscoder::GetPossibleFormats(allFormats);
+  PTimeInterval possibleTime = PTimer::Tick() - start;
+
+  cout << "Common formats:      " << setw(8) << setResult.GetSize() << "\n"
+          "HasFormat() lists:   " << setw(8) << listTime.GetMicroSeconds()/iterations << "us\n"
+          "Bit sets:            " << setw(8) << setTime.GetMicroSeconds()/iterations << "us\n"
+          "GetPossibleFormats:  " << setw(8) << possibleTime.GetMicroSeconds()/iterations << "us"
+       << endl;
+
+  bool same = listResult.GetSize() == setResult.GetSize();
+  for (OpalMediaFormatList::iterator l = listResult.begin(), s = setResult.begin(); same && l != listResult.end(); ++l, ++s)
+    same = *l == *s;
+  if (!same) {
+    cerr << "Negotiated formats differ:\n"
+         << setfill(',') << listResult << '\n' << setResult << setfill(' ') << endl;
+    SetTerminationValue(1);
+  }
+
+  if (!CheckRegistryChange())
+    SetTerminationValue(1);
+}
+
+
+bool Negotiate::CheckRegistryChange()
+{
+  OpalMediaFormatList pcm;
+  pcm += OpalPCM16;
+
+  OpalMediaFormat original = OpalG711_ULAW_64K;
+  OpalMediaFormat changed = original;
+  int frames = original.GetOptionInteger(OpalAudioFormat::TxFramesPerPacketOption(), 1) + 1;
+  changed.SetOptionInteger(OpalAudioFormat::TxFramesPerPacketOption(), frames);
+
+  // Make sure any cache is populated before the change
+  OpalTranscoder::GetPossibleFormats(pcm);
+  OpalMediaFormat::SetRegisteredMediaFormat(changed);
+
+  OpalMediaFormatList possible = OpalTranscoder::GetPossibleFormats(pcm);
+  OpalMediaFormat::SetRegisteredMediaFormat(original);
+
+  OpalMediaFormatList::const_iterator it = possible.FindFormat(OpalG711_ULAW_64K);
+  if (it == possible.end()) {
+    cout << "No transcoder from " << OpalPCM16 << " to " << OpalG711_ULAW_64K << ", registry change not checked" << endl;
+    return true;
+  }
+
+  if (it->GetOptionInteger(OpalAudioFormat::TxFramesPerPacketOption(), 1) == frames) {
+    cout << "Registry change:     passed" << endl;
+    return true;
+  }
+
+  cerr << "GetPossibleFormats returned stale options for " << *it << endl;
+  return false;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,244 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for Opus encoder complexity sweep
+ *
+ * Copyright (c) 2017 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <opal_config.h>
+#include <opal/transcoders.h>
+
+#include <math.h>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+
+/* Encodes a synthetic, speech like, signal with the Opus plug in at each of
+   a list of target bit rates, for every Complexity from 0 to 10, and reports
+   the encoder CPU time per 20ms frame and the bit rate actually produced.
+   The "Low Rate Complexity" option is set to 0 for the sweep, so Complexity
+   alone applies. A last row per bit rate uses the format's default options,
+   showing what the encoder costs when the bit rate decides which of the two
+   complexities is used. */
+
+static const char ComplexityOption[] = "Complexity";
+static const char LowRateComplexityOption[] = "Low Rate Complexity";
+
+
+class OpusComplexity : public PProcess
+{
+    PCLASSINFO(OpusComplexity, PProcess)
+  public:
+    OpusComplexity();
+
+    virtual void Main();
+
+  protected:
+    bool Run(unsigned bitRate, int complexity);
+    void Generate(short * samples, unsigned frame);
+
+    OpalMediaFormat m_format;
+    OpalMediaFormat m_pcm;
+    unsigned        m_sampleRate;
+    unsigned        m_channels;
+    unsigned        m_frameSamples;
+    unsigned        m_frames;
+    double          m_phase;
+    unsigned        m_seed;
+};
+
+
+PCREATE_PROCESS(OpusComplexity);
+
+
+OpusComplexity::OpusComplexity()
+  : PProcess("Open Phone Abstraction Library", "Opus Complexity", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_BUILD)
+  , m_sampleRate(48000)
+  , m_channels(1)
+  , m_frameSamples(960)
+  , m_frames(500)
+  , m_phase(0)
+  , m_seed(1)
+{
+}
+
+
+void OpusComplexity::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "f-format: Opus media format to use, default " OPAL_OPUS48 "\n"
+             "r-rates: Comma separated target bit rates, default 8000,10000,12000,16000,24000,32000\n"
+             "s-seconds: Seconds of audio to encode per run, default 10\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  m_format = args.GetOptionString('f', OPAL_OPUS48);
+  if (!m_format.IsValid() || !m_format.HasOption(ComplexityOption)) {
+    cerr << "Unknown or non-Opus media format \"" << args.GetOptionString('f', OPAL_OPUS48) << '"' << endl;
+    SetTerminationValue(1);
+    return;
+  }
+
+  // The RTP clock is always 48kHz, the PCM the encoder takes may not be
+  OpalMediaFormatList sources = OpalTranscoder::GetSourceFormats(m_format);
+  for (OpalMediaFormatList::iterator it = sources.begin(); it != sources.end(); ++it) {
+    if (it->IsTransportable())
+      continue;
+    m_pcm = *it;
+    break;
+  }
+  if (!m_pcm.IsValid()) {
+    cerr << "No encoder for " << m_format << endl;
+    SetTerminationValue(1);
+    return;
+  }
+
+  m_sampleRate = m_pcm.GetClockRate();
+  m_channels = std::max(1, m_pcm.GetOptionInteger(OpalAudioFormat::ChannelsOption(), 1));
+  m_frameSamples = m_sampleRate/50;
+  m_frames = std::max(1U, args.GetOptionString('s', "10").AsUnsigned())*50;
+
+  PStringArray rates = args.GetOptionString('r', "8000,10000,12000,16000,24000,32000").Tokenise(",", false);
+
+  cout << m_pcm << " to " << m_format << ", " << m_frames/50 << " seconds per run, default "
+       << ComplexityOption << '=' << m_format.GetOptionInteger(ComplexityOption) << ", "
+       << LowRateComplexityOption << '=' << m_format.GetOptionInteger(LowRateComplexityOption) << "\n"
+          "Target b/s  Complexity  us/frame  Real time %  Actual b/s" << endl;
+
+  for (PINDEX i = 0; i < rates.GetSize(); ++i) {
+    unsigned bitRate = rates[i].AsUnsigned();
+    for (int complexity = 0; complexity <= 10; ++complexity) {
+      if (!Run(bitRate, complexity)) {
+        SetTerminationValue(1);
+        return;
+      }
+    }
+    if (!Run(bitRate, -1)) {
+      SetTerminationValue(1);
+      return;
+    }
+  }
+}
+
+
+bool OpusComplexity::Run(unsigned bitRate, int complexity)
+{
+  OpalMediaFormat format = m_format;
+  format.MakeUnique();
+  format.SetOptionInteger(OpalMediaFormat::TargetBitRateOption(), bitRate);
+  if (complexity >= 0) {
+    format.SetOptionInteger(ComplexityOption, complexity);
+    format.SetOptionInteger(LowRateComplexityOption, 0);
+  }
+
+  OpalTranscoder * encoder = OpalTranscoder::Create(m_pcm, format);
+  if (encoder == NULL) {
+    cerr << "Could not create encoder for " << format << endl;
+    return false;
+  }
+  encoder->UpdateMediaFormats(OpalMediaFormat(), format);
+
+  RTP_DataFrame input(m_frameSamples*m_channels*sizeof(short));
+  RTP_DataFrameList output;
+  m_phase = 0;
+  m_seed = 1;
+  PUInt64 bytes = 0;
+
+#ifndef _WIN32
+  struct rusage before;
+  getrusage(RUSAGE_SELF, &before);
+#endif
+  PTimeInterval start = PTimer::Tick();
+
+  for (unsigned frame = 0; frame < m_frames; ++frame) {
+    input.SetTimestamp(frame*m_frameSamples);
+    Generate((short *)input.GetPayloadPtr(), frame);
+    if (!encoder->ConvertFrames(input, output)) {
+      cerr << "Encoder failed at frame " << frame << endl;
+      delete encoder;
+      return false;
+    }
+    for (RTP_DataFrameList::iterator it = output.begin(); it != output.end(); ++it)
+      bytes += it->GetPayloadSize();
+  }
+
+  PInt64 elapsedUS = (PTimer::Tick() - start).GetMicroSeconds();
+#ifndef _WIN32
+  struct rusage after;
+  getrusage(RUSAGE_SELF, &after);
+  elapsedUS = (PInt64)(after.ru_utime.tv_sec + after.ru_stime.tv_sec - before.ru_utime.tv_sec - before.ru_stime.tv_sec)*1000000 +
+              after.ru_utime.tv_usec + after.ru_stime.tv_usec - before.ru_utime.tv_usec - before.ru_stime.tv_usec;
+#endif
+  delete encoder;
+
+  cout << setw(10) << bitRate << "  " << setw(10);
+  if (complexity >= 0)
+    cout << complexity;
+  else
+    cout << "default";
+  cout << setw(10) << setprecision(1) << fixed << (double)elapsedUS/m_frames
+       << setw(13) << setprecision(2) << elapsedUS/(m_frames*200.0) // 20ms frame is 20000us, as a percentage
+       << setw(12) << bytes*8*50/m_frames
+       << endl;
+  return true;
+}
+
+
+void OpusComplexity::Generate(short * samples, unsigned frame)
+{
+  /* A voiced sound: harmonics of a pitch that glides between about 100Hz and
+     200Hz, at a syllable rate envelope, with a little noise. Pure tones or
+     silence would let the encoder take short cuts that speech does not. */
+  static const double TwoPi = 6.283185307179586;
+
+  for (unsigned i = 0; i < m_frameSamples; ++i) {
+    double t = (double)(frame*m_frameSamples + i)/m_sampleRate;
+    double pitch = 150 + 50*sin(TwoPi*0.7*t);
+    double envelope = 0.5 + 0.5*sin(TwoPi*4*t);
+    m_phase += TwoPi*pitch/m_sampleRate;
+    if (m_phase > TwoPi)
+      m_phase -= TwoPi;
+
+    double value = 0;
+    for (int harmonic = 1; harmonic <= 20 && harmonic*pitch < m_sampleRate/2; ++harmonic)
+      value += sin(harmonic*m_phase)/harmonic;
+
+    m_seed = m_seed*1103515245 + 12345;
+    double noise = ((int)((m_seed >> 16) & 0x7fff) - 16384)/16384.0;
+
+    for (unsigned channel = 0; channel < m_channels; ++channel)
+      *samples++ = (short)(6000*envelope*value + 300*noise);
+  }
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
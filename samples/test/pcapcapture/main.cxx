@@ -0,0 +1,182 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for PCAP capture overhead benchmark
+ *
+ * Copyright (c) 2017 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <opal_config.h>
+#include <rtp/pcapcapture.h>
+#include <rtp/rtp.h>
+
+
+/* Simulates the media transports of many streams, by default 10,000, each
+   handing every packet to OpalPCAPCapture::Capture() with its local port as
+   the hint, as OpalUDPMediaTransport does. This is spread over a number of
+   threads, as the transports' read threads would be. The cost per packet is
+   timed with capture stopped, which is what every untriggered transport of
+   a running system pays, and with it running. The load for the streams at
+   a 20ms packet time, in each direction, is derived from that. After the
+   capture is stopped every packet put in the rings must have been written. */
+
+class PCAPCapture : public PProcess
+{
+    PCLASSINFO(PCAPCapture, PProcess)
+  public:
+    PCAPCapture();
+
+    virtual void Main();
+
+  protected:
+    PTimeInterval Run();
+    void Streams(unsigned first);
+
+    OpalPCAPCapture m_capture;
+    unsigned        m_streams;
+    unsigned        m_threads;
+    unsigned        m_packets;
+    RTP_DataFrame   m_rtp;
+};
+
+
+PCREATE_PROCESS(PCAPCapture);
+
+
+PCAPCapture::PCAPCapture()
+  : PProcess("Open Phone Abstraction Library", "PCAP Capture", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_BUILD)
+  , m_streams(10000)
+  , m_threads(4)
+  , m_packets(100)
+  , m_rtp(160)
+{
+}
+
+
+void PCAPCapture::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "s-streams: Number of simulated streams, default 10000\n"
+             "t-threads: Number of threads sending, default 4\n"
+             "p-packets: Packets per stream, default 100\n"
+             "d-directory: Directory for capture files, default current\n"
+             "S-snap-length: Bytes of each packet captured, default 128\n"
+             "r-ring-size: Packets per ring, default 16384\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  m_streams = std::max(1U, args.GetOptionString('s', "10000").AsUnsigned());
+  m_threads = std::max(1U, args.GetOptionString('t', "4").AsUnsigned());
+  m_packets = std::max(1U, args.GetOptionString('p', "100").AsUnsigned());
+
+  OpalPCAPCapture::Params params;
+  params.m_directory = args.GetOptionString('d', ".");
+  params.m_prefix = "pcapcapture";
+  params.m_snapLength = args.GetOptionString('S', "128").AsInteger();
+  params.m_ringSize = args.GetOptionString('r', "16384").AsUnsigned();
+  params.m_maxFiles = 2;
+
+  PUInt64 total = (PUInt64)m_streams*m_packets;
+  cout << m_streams << " streams, " << m_threads << " threads, " << total << " packets" << endl;
+
+  PTimeInterval stoppedTime = Run();
+
+  if (!m_capture.Start(params)) {
+    cerr << "Could not start capture in " << params.m_directory << endl;
+    SetTerminationValue(1);
+    return;
+  }
+  PTimeInterval runningTime = Run();
+  m_capture.Stop();
+
+  OpalPCAPCapture::Statistics stats = m_capture.GetStatistics();
+
+  // Each stream sends and receives 50 packets a second
+  PUInt64 perSecond = (PUInt64)m_streams*100;
+  PUInt64 stoppedNS = stoppedTime.GetMicroSeconds()*1000/total;
+  PUInt64 runningNS = runningTime.GetMicroSeconds()*1000/total;
+  cout << "Capture stopped:  " << setw(10) << stoppedNS << "ns/packet, "
+                               << setw(6) << stoppedNS*perSecond/10000000 << "% of a core\n"
+          "Capture running:  " << setw(10) << runningNS << "ns/packet, "
+                               << setw(6) << runningNS*perSecond/10000000 << "% of a core\n"
+          "Captured:         " << setw(10) << stats.m_captured << "\n"
+          "Dropped:          " << setw(10) << stats.m_dropped << "\n"
+          "Written:          " << setw(10) << stats.m_written << "\n"
+          "Files:            " << setw(10) << stats.m_files
+       << endl;
+
+  if (stats.m_captured + stats.m_dropped != total) {
+    cerr << "Packets captured and dropped do not add up to those sent" << endl;
+    SetTerminationValue(1);
+  }
+
+  if (stats.m_written != stats.m_captured) {
+    cerr << "Packets written differ from those captured" << endl;
+    SetTerminationValue(1);
+  }
+}
+
+
+PTimeInterval PCAPCapture::Run()
+{
+  PTimeInterval start = PTimer::Tick();
+
+  PList<PThread> senders;
+  for (unsigned i = 0; i < m_threads; ++i)
+    senders.Append(new PThreadObj1Arg<PCAPCapture, unsigned>(*this, i, &PCAPCapture::Streams, false, "Sender"));
+  for (PList<PThread>::iterator it = senders.begin(); it != senders.end(); ++it)
+    it->WaitForTermination();
+  senders.RemoveAll();
+
+  return PTimer::Tick() - start;
+}
+
+
+void PCAPCapture::Streams(unsigned first)
+{
+  // Each thread owns every m_threads'th stream, as a read thread owns its transport
+  std::vector<PIPSocketAddressAndPort> locals, remotes;
+  for (unsigned stream = first; stream < m_streams; stream += m_threads) {
+    WORD port = (WORD)(5000 + stream*2);
+    locals.push_back(PIPSocketAddressAndPort(PIPSocket::Address(10, 0, 0, 1), port));
+    remotes.push_back(PIPSocketAddressAndPort(PIPSocket::Address(10, 1, (BYTE)(stream >> 8), (BYTE)stream), port));
+  }
+
+  for (unsigned packet = 0; packet < m_packets; ++packet) {
+    for (size_t i = 0; i < locals.size(); ++i) {
+      if (packet & 1)
+        m_capture.Capture(locals[i].GetPort(), remotes[i], locals[i], m_rtp, m_rtp.GetPacketSize());
+      else
+        m_capture.Capture(locals[i].GetPort(), locals[i], remotes[i], m_rtp, m_rtp.GetPacketSize());
+    }
+  }
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
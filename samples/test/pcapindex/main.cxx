@@ -0,0 +1,149 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for PCAP RTP index benchmark
+ *
+ * Copyright (c) 2017 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <opal_config.h>
+#include <rtp/pcapfile.h>
+
+
+/* Times RTP discovery of a capture file with each of the given numbers of
+   threads, then reads every discovered stream back, once by filtering a
+   full pass over the file per stream, as was needed before the index, and
+   once through per stream cursors on concurrent threads. The packet counts
+   of the two must agree. */
+
+class PCAPIndex : public PProcess
+{
+    PCLASSINFO(PCAPIndex, PProcess)
+  public:
+    PCAPIndex();
+
+    virtual void Main();
+
+  protected:
+    void ReadStream(OpalPCAPFile::DiscoveredRTPInfo & info);
+
+    OpalPCAPFile     m_pcap;
+    atomic<unsigned> m_cursorPackets;
+};
+
+
+PCREATE_PROCESS(PCAPIndex);
+
+
+PCAPIndex::PCAPIndex()
+  : PProcess("Open Phone Abstraction Library", "PCAP Index", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_BUILD)
+  , m_cursorPackets(0)
+{
+}
+
+
+void PCAPIndex::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "t-threads: Comma separated discovery thread counts, 0 is one per processor, default 1,0\n"
+             "n-no-scan. Do not do the full pass per stream\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h') || args.GetCount() == 0) {
+    args.Usage(cerr, "[ options ] file.pcap");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  if (!m_pcap.Open(args[0], PFile::ReadOnly)) {
+    cerr << "Could not open " << args[0] << endl;
+    SetTerminationValue(1);
+    return;
+  }
+
+  cout << m_pcap.GetFilePath() << ", " << m_pcap.GetLength() << " bytes" << endl;
+
+  OpalPCAPFile::DiscoveredRTP discoveredRTP;
+  PStringArray threadCounts = args.GetOptionString('t', "1,0").Tokenise(',');
+  for (PINDEX i = 0; i < threadCounts.GetSize(); ++i) {
+    discoveredRTP.RemoveAll();
+    PTimeInterval start = PTimer::Tick();
+    if (!m_pcap.DiscoverRTP(discoveredRTP, NULL, threadCounts[i].AsUnsigned())) {
+      cerr << "Discovery failed" << endl;
+      SetTerminationValue(1);
+      return;
+    }
+    cout << "Discovery, " << setw(2) << threadCounts[i] << " threads:  "
+         << setw(10) << (PTimer::Tick() - start) << "s, " << discoveredRTP.GetSize() << " streams" << endl;
+  }
+
+  unsigned scanPackets = 0;
+  if (!args.HasOption('n')) {
+    PTimeInterval start = PTimer::Tick();
+    for (PINDEX i = 0; i < discoveredRTP.GetSize(); ++i) {
+      // Plain port filters, so the index is not used
+      m_pcap.SetFilterSrcIP(discoveredRTP[i].m_src.GetAddress());
+      m_pcap.SetFilterSrcPort(discoveredRTP[i].m_src.GetPort());
+      m_pcap.SetFilterDstIP(discoveredRTP[i].m_dst.GetAddress());
+      m_pcap.SetFilterDstPort(discoveredRTP[i].m_dst.GetPort());
+      m_pcap.Restart();
+      while (!m_pcap.IsEndOfFile()) {
+        RTP_DataFrame rtp;
+        if (m_pcap.GetRTP(rtp) >= 0 && rtp.GetSyncSource() == discoveredRTP[i].m_ssrc)
+          ++scanPackets;
+      }
+    }
+    cout << "Full pass per stream:   " << setw(10) << (PTimer::Tick() - start) << "s, " << scanPackets << " packets" << endl;
+  }
+
+  PTimeInterval start = PTimer::Tick();
+  PList<PThread> readers;
+  for (PINDEX i = 0; i < discoveredRTP.GetSize(); ++i)
+    readers.Append(new PThreadObj1Arg<PCAPIndex, OpalPCAPFile::DiscoveredRTPInfo &>(
+                          *this, discoveredRTP[i], &PCAPIndex::ReadStream, false, "Reader"));
+  for (PList<PThread>::iterator it = readers.begin(); it != readers.end(); ++it)
+    it->WaitForTermination();
+  readers.RemoveAll();
+  cout << "Concurrent cursors:     " << setw(10) << (PTimer::Tick() - start) << "s, " << m_cursorPackets << " packets" << endl;
+
+  if (!args.HasOption('n') && scanPackets != m_cursorPackets) {
+    cerr << "Packet counts differ" << endl;
+    SetTerminationValue(1);
+  }
+}
+
+
+void PCAPIndex::ReadStream(OpalPCAPFile::DiscoveredRTPInfo & info)
+{
+  OpalPCAPFile::StreamCursor cursor;
+  if (!m_pcap.OpenStream(info, cursor))
+    return;
+
+  RTP_DataFrame rtp;
+  while (m_pcap.GetRTP(cursor, rtp) >= 0)
+    ++m_cursorPackets;
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
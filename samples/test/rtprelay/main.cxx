@@ -0,0 +1,327 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for direct RTP relay benchmark
+ *
+ * Copyright (c) 2017 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <opal_config.h>
+#include <opal/manager.h>
+#include <rtp/rtpep.h>
+#include <rtp/rtpconn.h>
+#include <rtp/rtp_session.h>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+
+/* Relays RTP between pairs of OpalRTPSession on the loopback interface, as
+   OpalRTPSession::SetRelay() does for media bypass. For each pair a thread
+   sends RTP to the first session, which relays it out of the second to a
+   socket read by another thread. The sender keeps only a window of packets
+   in flight, so the socket buffers do not overflow and any loss is the
+   relay's. Reported are the packets relayed per second, and, on Linux, the
+   packets relayed per second of CPU used by everything except the sending
+   and receiving threads, i.e. the packets/sec/core of the relay itself. The
+   receiver also checks the sequence numbers are consecutive. */
+
+class BenchEndPoint : public OpalRTPEndPoint
+{
+    PCLASSINFO(BenchEndPoint, OpalRTPEndPoint);
+  public:
+    BenchEndPoint(OpalManager & manager)
+      : OpalRTPEndPoint(manager, "bench", NoAttributes)
+    {
+    }
+
+    virtual PSafePtr<OpalConnection> MakeConnection(OpalCall &, const PString &, void *, unsigned, OpalConnection::StringOptions *)
+    {
+      return NULL;
+    }
+};
+
+
+class BenchConnection : public OpalRTPConnection
+{
+    PCLASSINFO(BenchConnection, OpalRTPConnection);
+  public:
+    BenchConnection(OpalCall & call, BenchEndPoint & endpoint)
+      : OpalRTPConnection(call, endpoint, endpoint.GetManager().GetNextToken('B'))
+    {
+    }
+
+    virtual bool IsNetworkConnection() const { return true; }
+};
+
+
+class RTPRelay : public PProcess
+{
+    PCLASSINFO(RTPRelay, PProcess)
+  public:
+    RTPRelay();
+
+    virtual void Main();
+
+  protected:
+    struct Pair
+    {
+      Pair() : m_in(NULL), m_out(NULL), m_sent(0), m_received(0), m_outOfSequence(0) { }
+
+      PUDPSocket       m_generator;
+      PUDPSocket       m_sink;
+      OpalRTPSession * m_in;
+      OpalRTPSession * m_out;
+      atomic<unsigned> m_sent;
+      atomic<unsigned> m_received;
+      unsigned         m_outOfSequence;
+    };
+
+    bool Open(BenchConnection & connection, unsigned index, Pair & pair);
+    void Generator(Pair * pair);
+    void Sink(Pair * pair);
+    void AddThreadCPU();
+
+    unsigned         m_packets;
+    unsigned         m_payloadSize;
+    unsigned         m_window;
+    PDECLARE_MUTEX(m_cpuMutex);
+    PInt64           m_threadCPU; // Microseconds used by generator and sink threads
+};
+
+
+PCREATE_PROCESS(RTPRelay);
+
+
+RTPRelay::RTPRelay()
+  : PProcess("Open Phone Abstraction Library", "RTP Relay", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_BUILD)
+  , m_packets(1000000)
+  , m_payloadSize(160)
+  , m_window(256)
+  , m_threadCPU(0)
+{
+}
+
+
+#ifndef _WIN32
+static PInt64 CPUMicroSeconds(int who)
+{
+  struct rusage usage;
+  getrusage(who, &usage);
+  return (PInt64)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)*1000000 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+#endif
+
+
+void RTPRelay::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "p-pairs: Number of relayed session pairs, default 1\n"
+             "n-packets: Packets to relay per pair, default 1000000\n"
+             "s-size: RTP payload size, default 160\n"
+             "w-window: Packets in flight per pair, default 256\n"
+             "S-sample: Packets between relay statistics updates, default 64\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  unsigned pairCount = std::max(1U, args.GetOptionString('p', "1").AsUnsigned());
+  m_packets = std::max(1U, args.GetOptionString('n', "1000000").AsUnsigned());
+  m_payloadSize = std::min(1400U, args.GetOptionString('s', "160").AsUnsigned());
+  m_window = std::max(1U, args.GetOptionString('w', "256").AsUnsigned());
+  unsigned sample = std::max(1U, args.GetOptionString('S', "64").AsUnsigned());
+
+  OpalManager manager;
+  BenchEndPoint * endpoint = new BenchEndPoint(manager);
+  PSafePtr<OpalCall> call = manager.InternalCreateCall();
+  BenchConnection * connection = call != NULL ? new BenchConnection(*call, *endpoint) : NULL;
+  if (connection == NULL || endpoint->AddConnection(connection) == NULL) {
+    cerr << "Could not create connection" << endl;
+    SetTerminationValue(1);
+    return;
+  }
+
+  std::vector<Pair *> pairs;
+  for (unsigned i = 0; i < pairCount; ++i) {
+    pairs.push_back(new Pair);
+    if (!Open(*connection, i, *pairs.back())) {
+      SetTerminationValue(1);
+      break;
+    }
+    if (!pairs.back()->m_in->SetRelay(pairs.back()->m_out, sample)) {
+      cerr << "Could not relay pair " << i << endl;
+      SetTerminationValue(1);
+      break;
+    }
+  }
+
+  if (GetTerminationValue() == 0) {
+    cout << pairCount << " pairs, " << m_packets << " packets each, "
+         << m_payloadSize << " byte payload, window " << m_window << endl;
+
+#ifndef _WIN32
+    PInt64 startCPU = CPUMicroSeconds(RUSAGE_SELF);
+#endif
+    PTimeInterval start = PTimer::Tick();
+
+    PList<PThread> threads;
+    for (size_t i = 0; i < pairs.size(); ++i) {
+      threads.Append(new PThreadObj1Arg<RTPRelay, Pair *>(*this, pairs[i], &RTPRelay::Sink, false, "Sink"));
+      threads.Append(new PThreadObj1Arg<RTPRelay, Pair *>(*this, pairs[i], &RTPRelay::Generator, false, "Generator"));
+    }
+    for (PList<PThread>::iterator it = threads.begin(); it != threads.end(); ++it)
+      it->WaitForTermination();
+    threads.RemoveAll();
+
+    PTimeInterval elapsed = PTimer::Tick() - start;
+
+    PUInt64 sent = 0, received = 0, outOfSequence = 0;
+    for (size_t i = 0; i < pairs.size(); ++i) {
+      sent += pairs[i]->m_sent;
+      received += pairs[i]->m_received;
+      outOfSequence += pairs[i]->m_outOfSequence;
+    }
+
+    cout << "Sent:               " << setw(12) << sent << "\n"
+            "Relayed:            " << setw(12) << received << "\n"
+            "Out of sequence:    " << setw(12) << outOfSequence << "\n"
+            "Packets/second:     " << setw(12) << received*1000/std::max(elapsed.GetMilliSeconds(), (PInt64)1) << endl;
+
+#if defined(RUSAGE_THREAD)
+    PInt64 relayCPU = CPUMicroSeconds(RUSAGE_SELF) - startCPU - m_threadCPU;
+    cout << "Relay CPU us/packet:" << setw(12) << setprecision(3) << fixed << (double)relayCPU/std::max(received, (PUInt64)1) << "\n"
+            "Packets/second/core:" << setw(12) << received*1000000/std::max(relayCPU, (PInt64)1) << endl;
+#endif
+
+    if (received < sent || outOfSequence > 0) {
+      cerr << "Relay lost or misordered packets" << endl;
+      SetTerminationValue(1);
+    }
+  }
+
+  for (size_t i = 0; i < pairs.size(); ++i) {
+    if (pairs[i]->m_in != NULL)
+      pairs[i]->m_in->SetRelay(NULL);
+    delete pairs[i];
+  }
+
+  call->Clear();
+  manager.ShutDownEndpoints();
+}
+
+
+bool RTPRelay::Open(BenchConnection & connection, unsigned index, Pair & pair)
+{
+  PIPSocket::Address loopback(127, 0, 0, 1);
+  if (!pair.m_generator.Listen(loopback, 0, 0) || !pair.m_sink.Listen(loopback, 0, 0)) {
+    cerr << "Could not open sockets for pair " << index << endl;
+    return false;
+  }
+
+  PIPSocket::Address address;
+  WORD generatorPort, sinkPort;
+  pair.m_generator.GetLocalAddress(address, generatorPort);
+  pair.m_sink.GetLocalAddress(address, sinkPort);
+
+  pair.m_in = dynamic_cast<OpalRTPSession *>(connection.UseMediaSession(index*2+1, OpalMediaType::Audio()));
+  pair.m_out = dynamic_cast<OpalRTPSession *>(connection.UseMediaSession(index*2+2, OpalMediaType::Audio()));
+  if (pair.m_in == NULL || pair.m_out == NULL ||
+      !pair.m_in->Open(loopback.AsString(), OpalTransportAddress(loopback, generatorPort, OpalTransportAddress::UdpPrefix())) ||
+      !pair.m_out->Open(loopback.AsString(), OpalTransportAddress(loopback, sinkPort, OpalTransportAddress::UdpPrefix()))) {
+    cerr << "Could not open RTP sessions for pair " << index << endl;
+    return false;
+  }
+
+  pair.m_out->AddSyncSource(0, OpalRTPSession::e_Sender);
+  pair.m_in->Start();
+  pair.m_out->Start();
+
+  PIPSocket::Address inAddress;
+  WORD inPort;
+  pair.m_in->GetLocalAddress().GetIpAndPort(inAddress, inPort);
+  pair.m_generator.SetSendAddress(loopback, inPort);
+  pair.m_sink.SetReadTimeout(2000);
+  return true;
+}
+
+
+void RTPRelay::Generator(Pair * pair)
+{
+  RTP_DataFrame frame(m_payloadSize);
+  frame.SetPayloadType(RTP_DataFrame::PCMU);
+  frame.SetSyncSource(0x12345678);
+  memset(frame.GetPayloadPtr(), 0xff, m_payloadSize);
+
+  for (unsigned i = 0; i < m_packets; ++i) {
+    // Keep the window, but do not wait forever if the relay is losing them
+    for (unsigned spin = 0; pair->m_sent - pair->m_received >= m_window && spin < 100000; ++spin)
+      PThread::Yield();
+
+    frame.SetSequenceNumber((RTP_SequenceNumber)i);
+    frame.SetTimestamp(i*m_payloadSize);
+    frame.SetMarker(i == 0);
+    if (!pair->m_generator.Write(frame.GetPointer(), frame.GetPacketSize()))
+      break;
+    ++pair->m_sent;
+  }
+
+  AddThreadCPU();
+}
+
+
+void RTPRelay::Sink(Pair * pair)
+{
+  BYTE buffer[2048];
+  bool first = true;
+  RTP_SequenceNumber expected = 0;
+
+  while (pair->m_received < m_packets && pair->m_sink.Read(buffer, sizeof(buffer))) {
+    RTP_DataFrame frame(buffer, pair->m_sink.GetLastReadCount(), false);
+    if (!first && frame.GetSequenceNumber() != expected)
+      ++pair->m_outOfSequence;
+    expected = (RTP_SequenceNumber)(frame.GetSequenceNumber() + 1);
+    first = false;
+    ++pair->m_received;
+  }
+
+  AddThreadCPU();
+}
+
+
+void RTPRelay::AddThreadCPU()
+{
+#if defined(RUSAGE_THREAD)
+  PInt64 cpu = CPUMicroSeconds(RUSAGE_THREAD);
+  PWaitAndSignal lock(m_cpuMutex);
+  m_threadCPU += cpu;
+#endif
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
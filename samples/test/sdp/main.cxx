@@ -33,9 +33,58 @@ class Test : public PProcess
     Test();
 
     virtual void Main();
+
+  protected:
+    void Benchmark(const PString & text, unsigned count);
 };
 
 
+static const char DefaultOffer[] =
+  "v=0\r\n"
+  "o=- 1457125393 1 IN IP4 192.168.1.10\r\n"
+  "s=OPAL SDP benchmark\r\n"
+  "c=IN IP4 192.168.1.10\r\n"
+  "t=0 0\r\n"
+  "a=group:BUNDLE audio video\r\n"
+  "a=msid-semantic: WMS stream\r\n"
+  "m=audio 5004 RTP/SAVPF 111 0 8 9 101\r\n"
+  "a=rtcp:5005 IN IP4 192.168.1.10\r\n"
+  "a=ice-ufrag:8hhY\r\n"
+  "a=ice-pwd:asd88fgpdd777uzjYhagZg\r\n"
+  "a=candidate:1 1 udp 2130706431 192.168.1.10 5004 typ host\r\n"
+  "a=candidate:1 2 udp 2130706431 192.168.1.10 5005 typ host\r\n"
+  "a=mid:audio\r\n"
+  "a=sendrecv\r\n"
+  "a=rtcp-mux\r\n"
+  "a=crypto:1 AES_CM_128_HMAC_SHA1_80 inline:PS1uQCVeeCFCanVmcjkpPywjNWhcYD0mXXtxaVBR|2^20|1:32\r\n"
+  "a=rtpmap:111 opus/48000/2\r\n"
+  "a=fmtp:111 minptime=10;useinbandfec=1\r\n"
+  "a=rtpmap:0 PCMU/8000\r\n"
+  "a=rtpmap:8 PCMA/8000\r\n"
+  "a=rtpmap:9 G722/8000\r\n"
+  "a=rtpmap:101 telephone-event/8000\r\n"
+  "a=fmtp:101 0-15\r\n"
+  "a=ssrc:3570614608 cname:4TOk42mSjXCkVIa6\r\n"
+  "a=ssrc:3570614608 msid:stream audio0\r\n"
+  "m=video 5006 RTP/SAVPF 96 97 100\r\n"
+  "a=rtcp:5007 IN IP4 192.168.1.10\r\n"
+  "a=mid:video\r\n"
+  "a=sendrecv\r\n"
+  "a=rtcp-mux\r\n"
+  "a=crypto:1 AES_CM_128_HMAC_SHA1_80 inline:d0RmdmcmVCspeEc3QGZiNWpVLFJhQX1cfHAwJSoj|2^20|1:32\r\n"
+  "a=rtpmap:96 VP8/90000\r\n"
+  "a=rtcp-fb:96 nack\r\n"
+  "a=rtcp-fb:96 nack pli\r\n"
+  "a=rtcp-fb:96 ccm fir\r\n"
+  "a=rtpmap:97 H264/90000\r\n"
+  "a=fmtp:97 profile-level-id=42e01f;packetization-mode=1\r\n"
+  "a=rtcp-fb:97 nack pli\r\n"
+  "a=rtpmap:100 H263-1998/90000\r\n"
+  "a=fmtp:100 CIF=1;QCIF=1\r\n"
+  "a=ssrc:2231627014 cname:4TOk42mSjXCkVIa6\r\n"
+  "a=ssrc:2231627014 msid:stream video0\r\n";
+
+
 PCREATE_PROCESS(Test);
 
 
@@ -50,6 +99,7 @@ void Test::Main()
   PArgList & args = GetArguments();
   args.Parse("[Options:]"
              "f-file: Parse SDP from file and output from encoded\n"
+             "b-benchmark: Decode and encode the SDP from --file, or a built in offer, this many times\n"
              "v-verbose. Indicate verbose output.\n"
              PTRACE_ARGLIST
              "h-help."
@@ -61,6 +111,20 @@ void Test::Main()
 
   PTRACE_INITIALISE(args);
 
+  if (args.HasOption('b')) {
+    PString text = DefaultOffer;
+    if (args.HasOption('f')) {
+      PTextFile file;
+      if (!file.Open(args.GetOptionString('f'), PFile::ReadOnly)) {
+        cerr << "Could not open " << file.GetFilePath() << endl;
+        return;
+      }
+      text = file.ReadString(P_MAX_INDEX);
+    }
+    Benchmark(text, std::max(1U, args.GetOptionString('b').AsUnsigned()));
+    return;
+  }
+
   if (args.HasOption('f')) {
     PTextFile file;
     if (!file.Open(args.GetOptionString('f'), PFile::ReadOnly)) {
@@ -94,4 +158,57 @@ void Test::Main()
 }
 
 
+void Test::Benchmark(const PString & text, unsigned count)
+{
+  OpalMediaFormatList formats = OpalMediaFormat::GetAllRegisteredMediaFormats();
+
+  // Check the decode is stable, so we are timing the real thing
+  SDPSessionDescription first(0, 0, OpalTransportAddress());
+  if (!first.Decode(text, formats)) {
+    cerr << "Could not decode SDP" << endl;
+    SetTerminationValue(1);
+    return;
+  }
+  PString encoded = first.Encode();
+
+  SDPSessionDescription second(0, 0, OpalTransportAddress());
+  if (!second.Decode(encoded, formats) || second.Encode() != encoded) {
+    cerr << "Encode/decode round trip is not stable:\n" << encoded << endl;
+    SetTerminationValue(1);
+    return;
+  }
+
+  cout << "SDP of " << text.GetLength() << " bytes, "
+       << first.GetMediaDescriptions().GetSize() << " media descriptions, "
+       << count << " iterations" << endl;
+
+  PTimeInterval start = PTimer::Tick();
+  for (unsigned i = 0; i < count; ++i) {
+    SDPSessionDescription sdp(0, 0, OpalTransportAddress());
+    sdp.Decode(text, formats);
+  }
+  PTimeInterval decodeTime = PTimer::Tick() - start;
+
+  start = PTimer::Tick();
+  for (unsigned i = 0; i < count; ++i)
+    first.Encode();
+  PTimeInterval encodeTime = PTimer::Tick() - start;
+
+  // An answer is a decode of the offer and encode of our reply
+  start = PTimer::Tick();
+  for (unsigned i = 0; i < count; ++i) {
+    SDPSessionDescription sdp(0, 0, OpalTransportAddress());
+    sdp.Decode(text, formats);
+    sdp.SetOwnerVersion(i);
+    sdp.Encode();
+  }
+  PTimeInterval answerTime = PTimer::Tick() - start;
+
+  cout << "Decode:       " << setw(8) << count*1000/std::max(decodeTime.GetMilliSeconds(), (PInt64)1) << "/s\n"
+          "Encode:       " << setw(8) << count*1000/std::max(encodeTime.GetMilliSeconds(), (PInt64)1) << "/s\n"
+          "Offer/answer: " << setw(8) << count*1000/std::max(answerTime.GetMilliSeconds(), (PInt64)1) << "/s"
+       << endl;
+}
+
+
 // End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,197 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for SIP flood benchmark
+ *
+ * Copyright (c) 2017 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <opal/manager.h>
+#include <sip/sipep.h>
+
+
+/* Floods a SIP UDP listener with OPTIONS requests from a number of client
+   sockets, so the listener sees that many different remotes, and counts the
+   responses. With --server, an OPAL SIP endpoint is run in the same process
+   as the target, using the given number of UDP receive threads, so the
+   scaling of OpalListenerUDP can be measured on its own. */
+
+class SIPFlood : public PProcess
+{
+    PCLASSINFO(SIPFlood, PProcess)
+  public:
+    SIPFlood();
+
+    virtual void Main();
+
+  protected:
+    void Receiver(PUDPSocket & socket);
+
+    PIPSocketAddressAndPort m_target;
+    atomic<unsigned> m_sent;
+    atomic<unsigned> m_received;
+    atomic<bool>     m_running;
+};
+
+
+PCREATE_PROCESS(SIPFlood);
+
+
+SIPFlood::SIPFlood()
+  : PProcess("Open Phone Abstraction Library", "SIP Flood", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_BUILD)
+  , m_sent(0)
+  , m_received(0)
+  , m_running(true)
+{
+}
+
+
+void SIPFlood::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "s-server: Run an OPAL SIP endpoint as target, with this many UDP receive threads\n"
+             "p-port: Port for --server, default 5060\n"
+             "c-clients: Number of client sockets, default 64\n"
+             "r-rate: Requests per second, default 0 is as fast as possible\n"
+             "d-duration: Test length in seconds, default 10\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h') || (args.GetCount() == 0 && !args.HasOption('s'))) {
+    args.Usage(cerr, "[ options ] [ host:port ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  OpalManager * manager = NULL;
+  if (args.HasOption('s')) {
+    manager = new OpalManager;
+    SIPEndPoint * sip = new SIPEndPoint(*manager);
+    sip->SetUDPReceiveThreads(args.GetOptionString('s').AsUnsigned());
+    PString listener = "udp$127.0.0.1:" + args.GetOptionString('p', "5060");
+    if (!sip->StartListener(listener)) {
+      cerr << "Could not start listener " << listener << endl;
+      delete manager;
+      return;
+    }
+    m_target.Parse(listener.Mid(4));
+    cout << "Server listening on " << m_target << " with " << sip->GetUDPReceiveThreads() << " receive threads" << endl;
+  }
+
+  if (args.GetCount() > 0 && !m_target.Parse(args[0], 5060)) {
+    cerr << "Invalid target " << args[0] << endl;
+    delete manager;
+    return;
+  }
+
+  unsigned clientCount = std::max(1U, args.GetOptionString('c', "64").AsUnsigned());
+  unsigned rate = args.GetOptionString('r').AsUnsigned();
+  PTimeInterval duration(0, args.GetOptionString('d', "10").AsUnsigned());
+
+  PList<PUDPSocket> sockets;
+  PList<PThread> receivers;
+  for (unsigned i = 0; i < clientCount; ++i) {
+    PUDPSocket * socket = new PUDPSocket;
+    if (!socket->Listen(m_target.GetAddress().IsLoopback() ? PIPSocket::Address::GetLoopback() : PIPSocket::GetDefaultIpAny())) {
+      cerr << "Could not open client socket: " << socket->GetErrorText() << endl;
+      delete socket;
+      break;
+    }
+    socket->SetReadTimeout(500);
+    socket->SetSendAddress(m_target);
+    sockets.Append(socket);
+    receivers.Append(new PThreadObj1Arg<SIPFlood, PUDPSocket &>(*this, *socket, &SIPFlood::Receiver, false, "Receiver"));
+  }
+
+  cout << "Flooding " << m_target << " from " << sockets.GetSize() << " sockets";
+  if (rate > 0)
+    cout << " at " << rate << " requests/s";
+  cout << " for " << duration << 's' << endl;
+
+  PTime start;
+  PTimeInterval nextReport(1000);
+  unsigned lastSent = 0, lastReceived = 0;
+  unsigned sequence = 0;
+  while (PTime() - start < duration) {
+    PUDPSocket & socket = sockets[sequence % sockets.GetSize()];
+    WORD localPort = socket.GetPort();
+    PStringStream pdu;
+    pdu << "OPTIONS sip:flood@" << m_target << " SIP/2.0\r\n"
+           "Via: SIP/2.0/UDP 127.0.0.1:" << localPort << ";branch=z9hG4bK" << sequence << ";rport\r\n"
+           "Max-Forwards: 70\r\n"
+           "From: <sip:flood@127.0.0.1:" << localPort << ">;tag=" << sequence << "\r\n"
+           "To: <sip:flood@" << m_target << ">\r\n"
+           "Call-ID: " << sequence << "-flood@127.0.0.1\r\n"
+           "CSeq: 1 OPTIONS\r\n"
+           "Content-Length: 0\r\n"
+           "\r\n";
+    if (socket.Write((const char *)pdu, pdu.GetLength()))
+      ++m_sent;
+    ++sequence;
+
+    PTimeInterval elapsed = PTime() - start;
+    if (rate > 0) {
+      PTimeInterval due = PTimeInterval::MicroSeconds(sequence*1000000LL/rate);
+      if (due > elapsed)
+        PThread::Sleep(due - elapsed);
+    }
+
+    if (elapsed >= nextReport) {
+      nextReport += 1000;
+      unsigned sent = m_sent, received = m_received;
+      cout << setw(4) << elapsed.GetSeconds() << "s  sent " << setw(7) << sent - lastSent
+           << "/s  responses " << setw(7) << received - lastReceived << "/s" << endl;
+      lastSent = sent;
+      lastReceived = received;
+    }
+  }
+
+  // Allow for stragglers
+  PThread::Sleep(1000);
+  m_running = false;
+  for (PList<PThread>::iterator it = receivers.begin(); it != receivers.end(); ++it)
+    it->WaitForTermination();
+
+  PTimeInterval elapsed = PTime() - start - 1000;
+  unsigned sent = m_sent, received = m_received;
+  cout << "\nSent:      " << sent << " (" << sent*1000/std::max(elapsed.GetMilliSeconds(), (PInt64)1) << "/s)\n"
+          "Responses: " << received << " (" << received*1000/std::max(elapsed.GetMilliSeconds(), (PInt64)1) << "/s)\n"
+          "Lost:      " << (sent > received ? sent - received : 0)
+       << endl;
+
+  receivers.RemoveAll();
+  sockets.RemoveAll();
+  delete manager;
+}
+
+
+void SIPFlood::Receiver(PUDPSocket & socket)
+{
+  char buffer[2048];
+  while (m_running) {
+    if (socket.Read(buffer, sizeof(buffer)-1) && socket.GetLastReadCount() > 8 && strncmp(buffer, "SIP/2.0 ", 8) == 0)
+      ++m_received;
+  }
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,187 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for TLS reconnect storm benchmark
+ *
+ * Copyright (c) 2017 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <opal/manager.h>
+#include <sip/sipep.h>
+
+
+/* Simulates a trunk reconnecting all its phones at once: a number of client
+   threads all connect to a local TLS listener at the same moment, through
+   the OPAL TLS transports, so both the accept and connect handshake pools
+   are exercised. Reports connect latency and the handshake statistics. */
+
+#if OPAL_PTLIB_SSL
+
+class TLSStorm : public PProcess
+{
+    PCLASSINFO(TLSStorm, PProcess)
+  public:
+    TLSStorm();
+
+    virtual void Main();
+
+  protected:
+    void Client(unsigned count);
+
+    SIPEndPoint        * m_endpoint;
+    OpalTransportAddress m_listener;
+    PSyncPointAck        m_go;
+    atomic<unsigned>     m_connected;
+    atomic<unsigned>     m_failed;
+    PDECLARE_MUTEX(m_mutex);
+    PTimeInterval        m_totalLatency;
+    PTimeInterval        m_maxLatency;
+};
+
+
+PCREATE_PROCESS(TLSStorm);
+
+
+TLSStorm::TLSStorm()
+  : PProcess("Open Phone Abstraction Library", "TLS Storm", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_BUILD)
+  , m_endpoint(NULL)
+  , m_connected(0)
+  , m_failed(0)
+{
+}
+
+
+void TLSStorm::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "c-clients: Number of simultaneous clients, default 200\n"
+             "n-connects: Connections per client, default 5\n"
+             "p-port: Listener port, default 15061\n"
+             "S-server-threads: Accept handshake threads, default 4\n"
+             "C-client-threads: Connect handshake threads, default 4\n"
+             "t-timeout: Handshake timeout in seconds, default 10\n"
+             "d-directory: Directory for generated certificate, default temporary\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  unsigned clientCount = std::max(1U, args.GetOptionString('c', "200").AsUnsigned());
+  unsigned connects = std::max(1U, args.GetOptionString('n', "5").AsUnsigned());
+  OpalTransportTLS::SetMaxHandshakeThreads(args.GetOptionString('S', "4").AsUnsigned(), true);
+  OpalTransportTLS::SetMaxHandshakeThreads(args.GetOptionString('C', "4").AsUnsigned(), false);
+  PTimeInterval timeout(0, args.GetOptionString('t', "10").AsUnsigned());
+  OpalTransportTLS::SetHandshakeTimeout(timeout, true);
+  OpalTransportTLS::SetHandshakeTimeout(timeout, false);
+
+  PDirectory dir = args.GetOptionString('d', PDirectory::GetTemporary());
+
+  OpalManager manager;
+  manager.SetSSLCertificateFile(dir + "tlsstorm_cert.pem");
+  manager.SetSSLPrivateKeyFile(dir + "tlsstorm_key.pem");
+  manager.SetSSLAutoCreateCertificate(true);
+
+  m_endpoint = new SIPEndPoint(manager);
+  m_listener = "tls$127.0.0.1:" + args.GetOptionString('p', "15061");
+  if (!m_endpoint->StartListener(m_listener)) {
+    cerr << "Could not start listener on " << m_listener << endl;
+    return;
+  }
+
+  cout << clientCount << " clients making " << connects << " connections each to " << m_listener << endl;
+
+  PList<PThread> clients;
+  for (unsigned i = 0; i < clientCount; ++i)
+    clients.Append(new PThreadObj1Arg<TLSStorm, unsigned>(*this, connects, &TLSStorm::Client, false, "Client"));
+
+  // Let them all get to the starting line
+  PThread::Sleep(500);
+  PTime start;
+  for (unsigned i = 0; i < clientCount; ++i)
+    m_go.Signal();
+
+  for (PList<PThread>::iterator it = clients.begin(); it != clients.end(); ++it)
+    it->WaitForTermination();
+  PTimeInterval elapsed = PTime() - start;
+
+  OpalTransportTLS::HandshakeStatistics stats = OpalTransportTLS::GetHandshakeStatistics();
+  unsigned handshakes = stats.m_accepted + stats.m_connected;
+
+  cout << "\nElapsed:            " << elapsed << "s\n"
+          "Connected:          " << m_connected << '\n'
+          "Failed:             " << m_failed << '\n'
+          "Connects/second:    " << m_connected*1000/std::max(elapsed.GetMilliSeconds(), (PInt64)1) << '\n'
+          "Mean connect time:  " << (m_connected > 0 ? m_totalLatency.GetMilliSeconds()/m_connected : 0) << "ms\n"
+          "Max connect time:   " << m_maxLatency.GetMilliSeconds() << "ms\n"
+          "\nHandshake statistics:\n"
+          "  Accepted:         " << stats.m_accepted << "\n"
+          "  Connected:        " << stats.m_connected << "\n"
+          "  Failed:           " << stats.m_failed << "\n"
+          "  Timed out:        " << stats.m_timedOut << "\n"
+          "  Pending:          " << stats.m_pending << "\n"
+          "  Mean time:        " << (handshakes > 0 ? stats.m_totalTime.GetMilliSeconds()/handshakes : 0) << "ms\n"
+          "  Max time:         " << stats.m_maximumTime.GetMilliSeconds() << "ms"
+       << endl;
+
+  clients.RemoveAll();
+}
+
+
+void TLSStorm::Client(unsigned count)
+{
+  m_go.Wait();
+  m_go.Acknowledge();
+
+  for (unsigned i = 0; i < count; ++i) {
+    OpalTransportPtr transport = new OpalTransportTLS(*m_endpoint, PIPSocket::Address::GetLoopback());
+    transport->SetRemoteAddress(m_listener);
+
+    PTimeInterval started = PTimer::Tick();
+    bool ok = transport->Connect();
+    PTimeInterval latency = PTimer::Tick() - started;
+
+    if (ok) {
+      ++m_connected;
+      PWaitAndSignal lock(m_mutex);
+      m_totalLatency += latency;
+      if (m_maxLatency < latency)
+        m_maxLatency = latency;
+    }
+    else
+      ++m_failed;
+
+    transport->CloseWait();
+  }
+}
+
+#else
+
+#error Cannot build TLS storm test without SSL
+
+#endif // OPAL_PTLIB_SSL
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,403 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for tone detector test and benchmark
+ *
+ * Copyright (c) 2017 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <opal/manager.h>
+#include <codec/tonedetect.h>
+#include <ptclib/dtmf.h>
+
+#include <math.h>
+
+
+/* Checks OpalToneDetector against synthetic audio with known content:
+   - all sixteen DTMF digits at the minimum 40ms on and 40ms off, at random
+     alignment to the analysis blocks, with twist and background noise;
+   - fax CNG bursts and a CED tone;
+   - busy and ringback cadences, and the return to no call progress after
+     they stop;
+   - a minute of speech like audio, which must not produce any tones;
+   - the multi-channel Detect() giving the same results as the single one.
+   Then the cost per 20ms frame is measured for the detector, its batch
+   entry point and PDTMFDecoder, and reported as channels per core. */
+
+static const unsigned SampleRate = 8000;
+static const PINDEX FrameSamples = 160;
+static const char DTMFDigits[] = "123A456B789C*0#D";
+static const double DTMFRows[4] = { 697, 770, 852, 941 };
+static const double DTMFColumns[4] = { 1209, 1336, 1477, 1633 };
+
+
+class ToneDetectTest : public PProcess
+{
+    PCLASSINFO(ToneDetectTest, PProcess)
+  public:
+    ToneDetectTest();
+
+    virtual void Main();
+
+  protected:
+    typedef std::vector<short> Audio;
+
+    double Noise();
+    void AddTone(Audio & audio, double f1, double f2, double level1, double level2, unsigned ms, double noise = 100);
+    void AddSilence(Audio & audio, unsigned ms, double noise = 100);
+    void AddSpeech(Audio & audio, unsigned ms);
+    PString DetectAll(OpalToneDetector & detector, const Audio & audio);
+
+    bool TestDTMF(unsigned trials);
+    bool TestFax();
+    bool TestCallProgress(OpalToneDetector::CallProgress expected, unsigned onMs, unsigned offMs, double f2);
+    bool TestTalkOff();
+    bool TestBatch(unsigned channels);
+    void Benchmark(unsigned channels, const PTimeInterval & duration);
+    void Check(bool ok, const char * name);
+
+    PUInt32  m_seed;
+    unsigned m_failures;
+};
+
+
+PCREATE_PROCESS(ToneDetectTest);
+
+
+ToneDetectTest::ToneDetectTest()
+  : PProcess("Open Phone Abstraction Library", "Tone Detect Test", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_BUILD)
+  , m_seed(1)
+  , m_failures(0)
+{
+}
+
+
+void ToneDetectTest::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "d-dtmf-trials: Number of DTMF sequences to check, default 100\n"
+             "c-channels: Channels for the multi-channel tests, default 1000\n"
+             "t-time: Seconds to run each benchmark, default 2\n"
+             "b-benchmark-only. Skip the accuracy tests\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  unsigned channels = std::max(1U, args.GetOptionString('c', "1000").AsUnsigned());
+
+  if (!args.HasOption('b')) {
+    Check(TestDTMF(std::max(1U, args.GetOptionString('d', "100").AsUnsigned())), "DTMF digits");
+    Check(TestFax(), "Fax CNG and CED");
+    Check(TestCallProgress(OpalToneDetector::BusyTone, 500, 500, 620), "Busy tone");
+    Check(TestCallProgress(OpalToneDetector::RingBackTone, 2000, 4000, 440), "Ringback tone");
+    Check(TestTalkOff(), "Talk off");
+    Check(TestBatch(std::min(channels, 100U)), "Multi-channel");
+    cout << '\n' << (m_failures == 0 ? "All tests passed" : "Tests FAILED") << '\n' << endl;
+  }
+
+  Benchmark(channels, PTimeInterval(0, std::max(1U, args.GetOptionString('t', "2").AsUnsigned())));
+
+  if (m_failures > 0)
+    SetTerminationValue(1);
+}
+
+
+void ToneDetectTest::Check(bool ok, const char * name)
+{
+  cout << setw(20) << left << name << (ok ? "passed" : "FAILED") << endl;
+  if (!ok)
+    ++m_failures;
+}
+
+
+double ToneDetectTest::Noise()
+{
+  m_seed = m_seed*1664525 + 1013904223;
+  return (int)m_seed/2147483648.0;
+}
+
+
+void ToneDetectTest::AddTone(Audio & audio, double f1, double f2, double level1, double level2, unsigned ms, double noise)
+{
+  PINDEX samples = ms*SampleRate/1000;
+  for (PINDEX i = 0; i < samples; ++i)
+    audio.push_back((short)(level1*sin(2*M_PI*f1*i/SampleRate) + level2*sin(2*M_PI*f2*i/SampleRate) + noise*Noise()));
+}
+
+
+void ToneDetectTest::AddSilence(Audio & audio, unsigned ms, double noise)
+{
+  PINDEX samples = ms*SampleRate/1000;
+  for (PINDEX i = 0; i < samples; ++i)
+    audio.push_back((short)(noise*Noise()));
+}
+
+
+void ToneDetectTest::AddSpeech(Audio & audio, unsigned ms)
+{
+  // Harmonics of a wandering pitch, formant like bumps, syllable envelope
+  PINDEX samples = ms*SampleRate/1000;
+  double phase = 0;
+  for (PINDEX i = 0; i < samples; ++i) {
+    double t = (double)i/SampleRate;
+    double pitch = 130 + 40*sin(2*M_PI*0.7*t) + 15*sin(2*M_PI*3.1*t);
+    phase += 2*M_PI*pitch/SampleRate;
+    double voice = 0;
+    for (int h = 1; h*pitch < 3600; ++h) {
+      double f = h*pitch;
+      double formant = 1 + 2*exp(-pow((f-600)/150, 2)) + 1.5*exp(-pow((f-1400)/200, 2)) + exp(-pow((f-2400)/250, 2));
+      voice += formant/h*sin(h*phase);
+    }
+    audio.push_back((short)(2500*voice*(0.3 + 0.7*fabs(sin(M_PI*4*t))) + 300*Noise()));
+  }
+}
+
+
+PString ToneDetectTest::DetectAll(OpalToneDetector & detector, const Audio & audio)
+{
+  PString tones;
+  for (size_t i = 0; i + FrameSamples <= audio.size(); i += FrameSamples)
+    tones += detector.Detect(&audio[i], FrameSamples);
+  return tones;
+}
+
+
+bool ToneDetectTest::TestDTMF(unsigned trials)
+{
+  unsigned failed = 0;
+  for (unsigned trial = 0; trial < trials; ++trial) {
+    // Random start so the digits fall anywhere in the analysis blocks
+    Audio audio;
+    AddSilence(audio, 1 + (m_seed >> 8) % 30);
+
+    PString sent;
+    for (PINDEX i = 0; i < 16; ++i) {
+      PINDEX digit = (i + trial) % 16;
+      sent += DTMFDigits[digit];
+      // Alternate the twist, with the row tone up or down 4dB
+      double row = trial & 1 ? 6000 : 3800;
+      double column = trial & 1 ? 3800 : 6000;
+      AddTone(audio, DTMFRows[digit/4], DTMFColumns[digit%4], row, column, 40);
+      AddSilence(audio, 40);
+    }
+    AddSilence(audio, 100);
+
+    OpalToneDetector detector;
+    PString received = DetectAll(detector, audio);
+    if (received != sent) {
+      PTRACE(2, "ToneDetect", "DTMF trial " << trial << " sent \"" << sent << "\" received \"" << received << '"');
+      ++failed;
+    }
+  }
+
+  cout << "  " << trials - failed << " of " << trials << " DTMF sequences exactly correct" << endl;
+  return failed == 0;
+}
+
+
+bool ToneDetectTest::TestFax()
+{
+  Audio audio;
+  for (int i = 0; i < 3; ++i) {
+    AddTone(audio, 1100, 0, 8000, 0, 500);
+    AddSilence(audio, 3000);
+  }
+  AddTone(audio, 2100, 0, 8000, 0, 3000);
+  AddSilence(audio, 500);
+
+  OpalToneDetector detector;
+  PString tones = DetectAll(detector, audio);
+  if (tones == "XXXY")
+    return true;
+
+  cout << "  Fax tones \"" << tones << "\", expected \"XXXY\"" << endl;
+  return false;
+}
+
+
+bool ToneDetectTest::TestCallProgress(OpalToneDetector::CallProgress expected, unsigned onMs, unsigned offMs, double f2)
+{
+  OpalToneDetector detector;
+
+  // Must be detected and held through three cadences
+  bool ok = true;
+  for (int cycle = 0; cycle < 3; ++cycle) {
+    Audio audio;
+    AddTone(audio, 480, f2, 5000, 5000, onMs);
+    DetectAll(detector, audio);
+    if (detector.GetCallProgress() != expected) {
+      cout << "  " << expected << " not detected in cycle " << cycle << ", got " << detector.GetCallProgress() << endl;
+      ok = false;
+    }
+
+    audio.clear();
+    AddSilence(audio, offMs);
+    DetectAll(detector, audio);
+    if (detector.GetCallProgress() != expected) {
+      cout << "  " << expected << " not held in gap of cycle " << cycle << ", got " << detector.GetCallProgress() << endl;
+      ok = false;
+    }
+  }
+
+  // Then released once it stops
+  Audio audio;
+  AddSilence(audio, 5000);
+  DetectAll(detector, audio);
+  if (detector.GetCallProgress() != OpalToneDetector::NoCallProgress) {
+    cout << "  " << expected << " still reported after tone stopped" << endl;
+    ok = false;
+  }
+
+  return ok;
+}
+
+
+bool ToneDetectTest::TestTalkOff()
+{
+  Audio audio;
+  AddSpeech(audio, 60000);
+
+  OpalToneDetector detector;
+  PString tones = DetectAll(detector, audio);
+  if (tones.IsEmpty() && detector.GetCallProgress() == OpalToneDetector::NoCallProgress)
+    return true;
+
+  cout << "  Speech gave tones \"" << tones << "\" and call progress " << detector.GetCallProgress() << endl;
+  return false;
+}
+
+
+bool ToneDetectTest::TestBatch(unsigned channelCount)
+{
+  // Each channel gets a different digit sequence
+  std::vector<Audio> audio(channelCount);
+  std::vector<PString> sent(channelCount);
+  for (unsigned c = 0; c < channelCount; ++c) {
+    AddSilence(audio[c], 1 + c % 30);
+    for (PINDEX i = 0; i < 4; ++i) {
+      PINDEX digit = (c*3 + i*5) % 16;
+      sent[c] += DTMFDigits[digit];
+      AddTone(audio[c], DTMFRows[digit/4], DTMFColumns[digit%4], 5000, 5000, 60);
+      AddSilence(audio[c], 60);
+    }
+  }
+
+  std::vector<OpalToneDetector> detectors(channelCount);
+  std::vector<OpalToneDetector::Channel> channels(channelCount);
+  std::vector<PString> received(channelCount);
+  size_t length = audio[0].size();
+  for (unsigned c = 1; c < channelCount; ++c)
+    length = std::min(length, audio[c].size());
+
+  for (size_t i = 0; i + FrameSamples <= length; i += FrameSamples) {
+    for (unsigned c = 0; c < channelCount; ++c) {
+      channels[c].m_detector = &detectors[c];
+      channels[c].m_pcm = &audio[c][i];
+      channels[c].m_samples = FrameSamples;
+    }
+    OpalToneDetector::Detect(&channels[0], channelCount);
+    for (unsigned c = 0; c < channelCount; ++c)
+      received[c] += channels[c].m_tones;
+  }
+
+  unsigned failed = 0;
+  for (unsigned c = 0; c < channelCount; ++c) {
+    if (received[c] != sent[c]) {
+      PTRACE(2, "ToneDetect", "Channel " << c << " sent \"" << sent[c] << "\" received \"" << received[c] << '"');
+      ++failed;
+    }
+  }
+
+  cout << "  " << channelCount - failed << " of " << channelCount << " channels correct" << endl;
+  return failed == 0;
+}
+
+
+void ToneDetectTest::Benchmark(unsigned channelCount, const PTimeInterval & duration)
+{
+  // Mostly speech, some silence and digits, like a real call
+  Audio audio;
+  AddSpeech(audio, 6000);
+  AddSilence(audio, 2000, 20);
+  for (PINDEX i = 0; i < 16; ++i) {
+    AddTone(audio, DTMFRows[i/4], DTMFColumns[i%4], 5000, 5000, 60);
+    AddSilence(audio, 60);
+  }
+  PINDEX frameCount = audio.size()/FrameSamples;
+  double framesPerChannel = (double)SampleRate/FrameSamples;
+
+  cout << "Benchmark, " << FrameSamples << " sample frames\n"
+          "detector,frames_per_sec,ns_per_frame,channels_per_core" << endl;
+
+  for (int test = 0; test < 3; ++test) {
+    static const char * const Names[] = { "OpalToneDetector", "OpalToneDetector batch", "PDTMFDecoder" };
+
+    OpalToneDetector detector;
+    PDTMFDecoder decoder;
+    std::vector<OpalToneDetector> detectors(test == 1 ? channelCount : 0);
+    std::vector<OpalToneDetector::Channel> channels(detectors.size());
+
+    PInt64 frames = 0;
+    PTimeInterval elapsed, start = PTimer::Tick();
+    do {
+      PINDEX frame = (PINDEX)(frames % frameCount);
+      const short * pcm = &audio[frame*FrameSamples];
+      switch (test) {
+        case 0 :
+          detector.Detect(pcm, FrameSamples);
+          ++frames;
+          break;
+
+        case 1 :
+          // Channels are staggered through the audio
+          for (unsigned c = 0; c < channelCount; ++c) {
+            channels[c].m_detector = &detectors[c];
+            channels[c].m_pcm = &audio[((frame + c) % frameCount)*FrameSamples];
+            channels[c].m_samples = FrameSamples;
+          }
+          OpalToneDetector::Detect(&channels[0], channelCount);
+          frames += channelCount;
+          break;
+
+        default :
+          decoder.Decode(pcm, FrameSamples);
+          ++frames;
+      }
+      elapsed = PTimer::Tick() - start;
+    } while (elapsed < duration);
+
+    double seconds = elapsed.GetMilliSeconds()/1000.0;
+    double rate = frames/seconds;
+    cout << Names[test] << ','
+         << fixed << setprecision(0) << rate << ','
+         << seconds*1e9/frames << ','
+         << rate/framesPerChannel << endl;
+  }
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,412 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for UDPTL codec test and benchmark
+ *
+ * Copyright (c) 2017 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <opal_config.h>
+#include <t38/t38proto.h>
+#include <rtp/pcapfile.h>
+#include <ptclib/random.h>
+
+
+/* Checks OpalUDPTLPacket against T38_UDPTLPacket and PPER_Stream, which
+   OpalFaxSession used for every datagram before. Random packets, with and
+   without FEC, with empty primary IFPs, IFPs needing two byte lengths, and
+   more entries than OpalUDPTLPacket handles, are encoded both ways and the
+   bytes compared. Those bytes, copies of them randomly truncated or with
+   bytes corrupted, and the UDP payloads of any PCAP files given as a
+   corpus, are then decoded both ways and the fields compared. Anything
+   OpalUDPTLPacket refuses must be a form it is documented not to handle,
+   and decode by the generic classes. Finally the packets per second each
+   way can encode and decode a typical packet are reported. */
+
+#if OPAL_FAX
+
+#include <asn/t38.h>
+
+
+class UDPTLTest : public PProcess
+{
+    PCLASSINFO(UDPTLTest, PProcess)
+  public:
+    UDPTLTest();
+
+    virtual void Main();
+
+  protected:
+    bool RandomPacket(unsigned index);
+    bool DamagedPackets(const PBYTEArray & data);
+    bool CheckDecode(const PBYTEArray & data, const char * source);
+    void Benchmark(unsigned iterations);
+
+    PRandom  m_random;
+    unsigned m_fastDecodes;
+    unsigned m_fallbacks;
+    unsigned m_rejected;
+};
+
+
+PCREATE_PROCESS(UDPTLTest);
+
+
+UDPTLTest::UDPTLTest()
+  : PProcess("Open Phone Abstraction Library", "UDPTL Test", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_BUILD)
+  , m_fastDecodes(0)
+  , m_fallbacks(0)
+  , m_rejected(0)
+{
+}
+
+
+void UDPTLTest::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "r-random: Number of random packets, default 100000\n"
+             "s-seed: Random number seed, default from clock\n"
+             "p-port: Only use UDP packets of PCAP corpus to/from this port\n"
+             "i-iterations: Benchmark iterations, default 1000000\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ] [ corpus.pcap ... ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  unsigned seed = args.HasOption('s') ? args.GetOptionString('s').AsUnsigned() : (unsigned)PTimer::Tick().GetMilliSeconds();
+  m_random.SetSeed(seed);
+  cout << "Random seed " << seed << endl;
+
+  unsigned randomCount = args.GetOptionString('r', "100000").AsUnsigned();
+  for (unsigned i = 0; i < randomCount; ++i) {
+    if (!RandomPacket(i)) {
+      SetTerminationValue(1);
+      return;
+    }
+  }
+
+  for (PINDEX arg = 0; arg < args.GetCount(); ++arg) {
+    OpalPCAPFile pcap;
+    if (!pcap.Open(args[arg], PFile::ReadOnly)) {
+      cerr << "Could not open " << args[arg] << endl;
+      SetTerminationValue(1);
+      return;
+    }
+
+    if (args.HasOption('p')) {
+      WORD port = (WORD)args.GetOptionString('p').AsUnsigned();
+      pcap.SetFilterSrcPort(port);
+      pcap.SetFilterDstPort(port);
+    }
+
+    PBYTEArray payload;
+    while (!pcap.IsEndOfFile()) {
+      if (pcap.GetUDP(payload) > 0 && !CheckDecode(payload, args[arg])) {
+        SetTerminationValue(1);
+        return;
+      }
+    }
+  }
+
+  cout << "Fast decodes:  " << setw(10) << m_fastDecodes << "\n"
+          "Fallbacks:     " << setw(10) << m_fallbacks << "\n"
+          "Rejected:      " << setw(10) << m_rejected
+       << endl;
+
+  Benchmark(std::max(1U, args.GetOptionString('i', "1000000").AsUnsigned()));
+}
+
+
+static PINDEX RandomSize(PRandom & random)
+{
+  switch (random.Generate(0, 9)) {
+    case 0 :
+      return 0;
+    case 1 :
+      return random.Generate(128, 16383); // Two byte length
+    case 2 :
+      return random.Generate(128, 300);
+    default :
+      return random.Generate(1, 127);
+  }
+}
+
+
+static void RandomIFP(PRandom & random, PBYTEArray & storage)
+{
+  PINDEX size = RandomSize(random);
+  storage.SetSize(size);
+  for (PINDEX i = 0; i < size; ++i)
+    storage[i] = (BYTE)random.Generate();
+}
+
+
+static bool SameIFP(const OpalUDPTLPacket::IFP & ifp1, const OpalUDPTLPacket::IFP & ifp2)
+{
+  return ifp1.m_size == ifp2.m_size && memcmp(ifp1.m_data, ifp2.m_data, ifp1.m_size) == 0;
+}
+
+
+static bool SamePacket(const OpalUDPTLPacket & packet1, const OpalUDPTLPacket & packet2)
+{
+  if (packet1.m_sequenceNumber != packet2.m_sequenceNumber ||
+      packet1.m_fec != packet2.m_fec ||
+      packet1.m_fecPackets != packet2.m_fecPackets ||
+      packet1.m_count != packet2.m_count ||
+      !SameIFP(packet1.m_primary, packet2.m_primary))
+    return false;
+
+  for (PINDEX i = 0; i < packet1.m_count; ++i) {
+    if (!SameIFP(packet1.m_entries[i], packet2.m_entries[i]))
+      return false;
+  }
+
+  return true;
+}
+
+
+bool UDPTLTest::RandomPacket(unsigned index)
+{
+  bool fec = m_random.Generate(0, 3) == 0;
+  unsigned fecPackets = fec ? m_random.Generate(0, 0x7fffffff) >> m_random.Generate(0, 30) : 0;
+  PINDEX count = m_random.Generate(0, 7) == 0 ? m_random.Generate(0, OpalUDPTLPacket::MaxEntries+8) : m_random.Generate(0, 4);
+
+  // Built with the generic classes, which have no limit on entries
+  T38_UDPTLPacket asn;
+  asn.m_seq_number = m_random.Generate(0, 65535);
+  PBYTEArray ifp;
+  RandomIFP(m_random, ifp);
+  asn.m_primary_ifp_packet.SetValue(ifp);
+
+  if (fec) {
+    asn.m_error_recovery.SetTag(T38_UDPTLPacket_error_recovery::e_fec_info);
+    T38_UDPTLPacket_error_recovery_fec_info & fecInfo = asn.m_error_recovery;
+    fecInfo.m_fec_npackets = fecPackets;
+    fecInfo.m_fec_data.SetSize(count);
+    for (PINDEX i = 0; i < count; ++i) {
+      RandomIFP(m_random, ifp);
+      fecInfo.m_fec_data[i].SetValue(ifp);
+    }
+  }
+  else {
+    asn.m_error_recovery.SetTag(T38_UDPTLPacket_error_recovery::e_secondary_ifp_packets);
+    T38_UDPTLPacket_error_recovery_secondary_ifp_packets & secondary = asn.m_error_recovery;
+    secondary.SetSize(count);
+    for (PINDEX i = 0; i < count; ++i) {
+      RandomIFP(m_random, ifp);
+      secondary[i].SetValue(ifp);
+    }
+  }
+
+  PPER_Stream per;
+  asn.Encode(per);
+  per.CompleteEncoding();
+
+  OpalUDPTLPacket packet;
+  bool fits = packet.SetFromASN(asn);
+  if (fits != (count <= OpalUDPTLPacket::MaxEntries)) {
+    cerr << "Random packet " << index << ": SetFromASN() returned " << fits << " for " << count << " entries" << endl;
+    return false;
+  }
+
+  if (fits) {
+    PINDEX size = packet.GetEncodedSize();
+    PBYTEArray encoded(size);
+    if (size == 0 || packet.Encode(encoded.GetPointer(), size) != size) {
+      cerr << "Random packet " << index << ": could not encode " << packet << endl;
+      return false;
+    }
+
+    if (encoded != per) {
+      cerr << "Random packet " << index << ": " << packet << " encoded differently:\n"
+           << hex << setfill('0') << setprecision(2) << encoded << "\n"
+           << setprecision(2) << (const PBYTEArray &)per << dec << setfill(' ') << endl;
+      return false;
+    }
+  }
+
+  return CheckDecode(per, "random") && DamagedPackets(per);
+}
+
+
+bool UDPTLTest::DamagedPackets(const PBYTEArray & data)
+{
+  PINDEX size = data.GetSize();
+  if (size < 2)
+    return true;
+
+  // Cut short anywhere, including inside a length or just before the end
+  PBYTEArray truncated((const BYTE *)data, m_random.Generate(0, size-1));
+  if (!CheckDecode(truncated, "truncated"))
+    return false;
+
+  // A few bytes changed, so lengths, counts and choice tags get garbage
+  PBYTEArray corrupted((const BYTE *)data, size);
+  unsigned changes = m_random.Generate(1, 3);
+  for (unsigned i = 0; i < changes; ++i)
+    corrupted[m_random.Generate(0, size-1)] ^= (BYTE)m_random.Generate(1, 255);
+  return CheckDecode(corrupted, "corrupted");
+}
+
+
+bool UDPTLTest::CheckDecode(const PBYTEArray & data, const char * source)
+{
+  OpalUDPTLPacket fast;
+  bool fastOK = fast.Decode(data, data.GetSize());
+
+  T38_UDPTLPacket asn;
+  PPER_Stream per(data);
+  bool asnOK = asn.Decode(per) && per.GetPosition() >= per.GetSize();
+
+  if (fastOK) {
+    ++m_fastDecodes;
+
+    OpalUDPTLPacket generic;
+    if (!asnOK || !generic.SetFromASN(asn) || !SamePacket(fast, generic)) {
+      cerr << source << ": generic decode differs from " << fast << ":\n"
+           << hex << setfill('0') << setprecision(2) << data << dec << setfill(' ') << endl;
+      return false;
+    }
+
+    // Whatever the encoding received, what we send must be canonical
+    PPER_Stream reencoded;
+    asn.Encode(reencoded);
+    reencoded.CompleteEncoding();
+    PINDEX size = fast.GetEncodedSize();
+    PBYTEArray encoded(size);
+    if (fast.Encode(encoded.GetPointer(), size) != size || encoded != reencoded) {
+      cerr << source << ": re-encoding " << fast << " differs" << endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  if (!asnOK) {
+    ++m_rejected;
+    return true;
+  }
+
+  ++m_fallbacks;
+
+  // Must be too many entries, a long IFP, or not the canonical encoding
+  OpalUDPTLPacket generic;
+  PINDEX size;
+  if (generic.SetFromASN(asn) && (size = generic.GetEncodedSize()) > 0) {
+    PBYTEArray encoded(size);
+    if (generic.Encode(encoded.GetPointer(), size) != size || encoded != data)
+      return true;
+    cerr << source << ": fast decoder refused " << generic << ":\n"
+         << hex << setfill('0') << setprecision(2) << data << dec << setfill(' ') << endl;
+    return false;
+  }
+
+  return true;
+}
+
+
+void UDPTLTest::Benchmark(unsigned iterations)
+{
+  // Typical of T.38 image data with three levels of redundancy
+  static const PINDEX Sizes[] = { 120, 120, 118, 115 };
+  PBYTEArray ifps[PARRAYSIZE(Sizes)];
+  OpalUDPTLPacket packet;
+  packet.m_sequenceNumber = 1234;
+  for (PINDEX i = 0; i < PARRAYSIZE(Sizes); ++i) {
+    BYTE * ptr = ifps[i].GetPointer(Sizes[i]);
+    for (PINDEX j = 0; j < Sizes[i]; ++j)
+      ptr[j] = (BYTE)(i+j);
+    if (i == 0)
+      packet.m_primary = OpalUDPTLPacket::IFP(ifps[i], Sizes[i]);
+    else
+      packet.m_entries[packet.m_count++] = OpalUDPTLPacket::IFP(ifps[i], Sizes[i]);
+  }
+
+  PBYTEArray datagram(packet.GetEncodedSize());
+  PINDEX size = packet.Encode(datagram.GetPointer(), datagram.GetSize());
+
+  unsigned done = 0;
+
+  PTimeInterval start = PTimer::Tick();
+  for (unsigned i = 0; i < iterations; ++i)
+    done += packet.Encode(datagram.GetPointer(), size) == size;
+  PTimeInterval fastEncode = PTimer::Tick() - start;
+
+  start = PTimer::Tick();
+  for (unsigned i = 0; i < iterations; ++i) {
+    OpalUDPTLPacket decoded;
+    done += decoded.Decode(datagram, size);
+  }
+  PTimeInterval fastDecode = PTimer::Tick() - start;
+
+  // Built as OpalFaxSession::WriteUDPTL() used to for every packet
+  start = PTimer::Tick();
+  for (unsigned i = 0; i < iterations; ++i) {
+    T38_UDPTLPacket asn;
+    asn.m_seq_number = packet.m_sequenceNumber;
+    asn.m_primary_ifp_packet.SetValue(packet.m_primary.m_data, packet.m_primary.m_size);
+    asn.m_error_recovery.SetTag(T38_UDPTLPacket_error_recovery::e_secondary_ifp_packets);
+    T38_UDPTLPacket_error_recovery_secondary_ifp_packets & secondary = asn.m_error_recovery;
+    secondary.SetSize(packet.m_count);
+    for (PINDEX j = 0; j < packet.m_count; ++j)
+      secondary[j].SetValue(packet.m_entries[j].m_data, packet.m_entries[j].m_size);
+    PPER_Stream per;
+    asn.Encode(per);
+    per.CompleteEncoding();
+    done += per.GetSize() == size;
+  }
+  PTimeInterval asnEncode = PTimer::Tick() - start;
+
+  start = PTimer::Tick();
+  for (unsigned i = 0; i < iterations; ++i) {
+    T38_UDPTLPacket asn;
+    PPER_Stream per(datagram);
+    done += asn.Decode(per);
+  }
+  PTimeInterval asnDecode = PTimer::Tick() - start;
+
+  cout << size << " byte packets\n"
+          "Fast encode:   " << setw(10) << iterations*1000ULL/std::max(fastEncode.GetMilliSeconds(), (PInt64)1) << " packets/s\n"
+          "Fast decode:   " << setw(10) << iterations*1000ULL/std::max(fastDecode.GetMilliSeconds(), (PInt64)1) << " packets/s\n"
+          "ASN.1 encode:  " << setw(10) << iterations*1000ULL/std::max(asnEncode.GetMilliSeconds(), (PInt64)1) << " packets/s\n"
+          "ASN.1 decode:  " << setw(10) << iterations*1000ULL/std::max(asnDecode.GetMilliSeconds(), (PInt64)1) << " packets/s"
+       << endl;
+
+  if (done != iterations*4) {
+    cerr << "Benchmark packets failed to encode or decode" << endl;
+    SetTerminationValue(1);
+  }
+}
+
+#else
+
+#error Cannot build UDPTL test without fax support
+
+#endif // OPAL_FAX
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -0,0 +1,247 @@
+/*
+ * main.cxx
+ *
+ * OPAL application source file for video encoder throughput benchmark
+ *
+ * Copyright (c) 2017 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+#include <opal_config.h>
+#include <opal/transcoders.h>
+#include <codec/vidcodec.h>
+#include <codec/opalpluginmgr.h>
+
+#include <set>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+
+/* Encodes a moving synthetic picture, by default 1080p, as fast as possible,
+   for each X264_PIPELINE_DEPTH given, 0 being the plain pipe to the helper
+   process. Each depth is run with the picture built in a separate frame that
+   the encoder must copy, then built in the memory returned by
+   OpalTranscoder::GetInputBuffer(), as OpalMediaPatch does for a grabber,
+   and then also with the encoder returning whole access units that OPAL
+   packetises directly into the RTP frames sent. Frames per second and the
+   CPU used by this process and its children, i.e. the GPL helper, are
+   reported for each, along with the number of distinct RTP frames output,
+   which, as the encoder re-uses its frames, is the number it allocated. */
+
+class VideoEncode : public PProcess
+{
+    PCLASSINFO(VideoEncode, PProcess)
+  public:
+    VideoEncode();
+
+    virtual void Main();
+
+  protected:
+    bool Run(const PString & depth, bool inPlace, bool accessUnits);
+    void Generate(BYTE * payload, unsigned frame);
+
+    OpalMediaFormat m_format;
+    unsigned        m_width;
+    unsigned        m_height;
+    unsigned        m_frames;
+};
+
+
+PCREATE_PROCESS(VideoEncode);
+
+
+VideoEncode::VideoEncode()
+  : PProcess("Open Phone Abstraction Library", "Video Encode", OPAL_MAJOR, OPAL_MINOR, ReleaseCode, OPAL_BUILD)
+  , m_width(1920)
+  , m_height(1080)
+  , m_frames(300)
+{
+}
+
+
+void VideoEncode::Main()
+{
+  PArgList & args = GetArguments();
+  args.Parse("[Options:]"
+             "f-format: Video format to encode, default " OPAL_H264_MODE1 "\n"
+             "s-size: Frame size, default 1920x1080\n"
+             "n-frames: Number of frames per run, default 300\n"
+             "b-bit-rate: Target bit rate, default 4000000\n"
+             "d-depth: Comma separated X264_PIPELINE_DEPTH values, default 0,1,2\n"
+             PTRACE_ARGLIST
+             "h-help."
+             , false);
+  if (!args.IsParsed() || args.HasOption('h')) {
+    args.Usage(cerr, "[ options ]");
+    return;
+  }
+
+  PTRACE_INITIALISE(args);
+
+  OPAL_REGISTER_RAW_VIDEO();
+  OpalPluginCodecManager::GetInstance();
+
+  m_format = args.GetOptionString('f', OPAL_H264_MODE1);
+  if (!m_format.IsValid()) {
+    cerr << "Unknown video format \"" << args.GetOptionString('f') << '"' << endl;
+    SetTerminationValue(1);
+    return;
+  }
+
+  if (!PVideoFrameInfo::ParseSize(args.GetOptionString('s', "1920x1080"), m_width, m_height)) {
+    cerr << "Illegal video frame size \"" << args.GetOptionString('s') << '"' << endl;
+    SetTerminationValue(1);
+    return;
+  }
+
+  m_frames = std::max(1U, args.GetOptionString('n', "300").AsUnsigned());
+
+  unsigned bitRate = args.GetOptionString('b', "4000000").AsUnsigned();
+  m_format.SetOptionInteger(OpalVideoFormat::FrameWidthOption(), m_width);
+  m_format.SetOptionInteger(OpalVideoFormat::FrameHeightOption(), m_height);
+  m_format.SetOptionInteger(OpalVideoFormat::MaxRxFrameWidthOption(), m_width);
+  m_format.SetOptionInteger(OpalVideoFormat::MaxRxFrameHeightOption(), m_height);
+  m_format.SetOptionInteger(OpalMediaFormat::MaxBitRateOption(), bitRate);
+  m_format.SetOptionInteger(OpalMediaFormat::TargetBitRateOption(), bitRate);
+
+  cout << m_format << ' ' << m_width << 'x' << m_height << ", " << m_frames << " frames per run\n"
+          "Depth  Input     Packetiser  Frames/s   CPU ms/frame  Buffers" << endl;
+
+  PStringArray depths = args.GetOptionString('d', "0,1,2").Tokenise(",", false);
+  for (PINDEX i = 0; i < depths.GetSize(); ++i) {
+    if (!Run(depths[i], false, false) || !Run(depths[i], true, false) || !Run(depths[i], true, true)) {
+      SetTerminationValue(1);
+      return;
+    }
+  }
+}
+
+
+bool VideoEncode::Run(const PString & depth, bool inPlace, bool accessUnits)
+{
+  // The x264 plugin reads this when it starts its helper, i.e. in Create()
+  PConfig env(PConfig::Environment);
+  env.SetString("X264_PIPELINE_DEPTH", depth);
+  env.SetBoolean("OPAL_ENCODE_ACCESS_UNITS", accessUnits);
+
+#ifndef _WIN32
+  struct rusage selfBefore, childBefore;
+  getrusage(RUSAGE_SELF, &selfBefore);
+  getrusage(RUSAGE_CHILDREN, &childBefore);
+#endif
+
+  OpalTranscoder * encoder = OpalTranscoder::Create(OpalYUV420P, m_format);
+  if (encoder == NULL) {
+    cerr << "Could not create encoder for " << m_format << endl;
+    return false;
+  }
+  encoder->UpdateMediaFormats(OpalMediaFormat(), m_format);
+
+  PINDEX payloadSize = sizeof(OpalVideoTranscoder::FrameHeader) + m_width*m_height*3/2;
+  PINDEX frameSize = RTP_DataFrame::MinHeaderSize + payloadSize;
+  RTP_DataFrame copied(payloadSize);
+
+  unsigned inPlaceCount = 0;
+  PINDEX packets = 0;
+  std::set<const RTP_DataFrame *> buffers;
+  // Kept across calls, as OpalMediaPatch does, so the encoder can re-use its frames
+  RTP_DataFrameList output;
+
+  PTimeInterval start = PTimer::Tick();
+
+  for (unsigned frame = 0; frame < m_frames; ++frame) {
+    RTP_DataFrame input(0);
+    BYTE * buffer = inPlace ? encoder->GetInputBuffer(frameSize) : NULL;
+    if (buffer != NULL) {
+      memset(buffer, 0, RTP_DataFrame::MinHeaderSize);
+      buffer[0] = 0x80;
+      input = RTP_DataFrame(buffer, frameSize, false);
+      ++inPlaceCount;
+    }
+    else
+      input = copied;
+
+    input.SetPayloadType(OpalYUV420P.GetPayloadType());
+    input.SetTimestamp(frame*OpalMediaFormat::VideoClockRate/30);
+    input.SetMarker(true);
+    Generate(input.GetPayloadPtr(), frame);
+
+    if (!encoder->ConvertFrames(input, output)) {
+      cerr << "Encoder failed at frame " << frame << endl;
+      delete encoder;
+      return false;
+    }
+
+    packets += output.GetSize();
+    for (RTP_DataFrameList::iterator it = output.begin(); it != output.end(); ++it)
+      buffers.insert(&*it);
+  }
+
+  PTimeInterval elapsed = PTimer::Tick() - start;
+  delete encoder; // Reaps the helper, so its CPU is in RUSAGE_CHILDREN
+
+  cout << setw(5) << depth << "  " << setw(8) << (inPlace ? "in place" : "copied")
+       << setw(12) << (accessUnits ? "OPAL" : "plugin")
+       << setw(10) << setprecision(1) << fixed << m_frames*1000.0/std::max(elapsed.GetMilliSeconds(), (PInt64)1);
+
+#ifndef _WIN32
+  struct rusage selfAfter, childAfter;
+  getrusage(RUSAGE_SELF, &selfAfter);
+  getrusage(RUSAGE_CHILDREN, &childAfter);
+  PInt64 cpuUS = 0;
+  const struct rusage * after[2] = { &selfAfter, &childAfter };
+  const struct rusage * before[2] = { &selfBefore, &childBefore };
+  for (int i = 0; i < 2; ++i)
+    cpuUS += (PInt64)(after[i]->ru_utime.tv_sec + after[i]->ru_stime.tv_sec -
+                      before[i]->ru_utime.tv_sec - before[i]->ru_stime.tv_sec)*1000000 +
+                      after[i]->ru_utime.tv_usec + after[i]->ru_stime.tv_usec -
+                      before[i]->ru_utime.tv_usec - before[i]->ru_stime.tv_usec;
+  cout << setw(15) << setprecision(2) << cpuUS/1000.0/m_frames;
+#endif
+
+  cout << setw(9) << buffers.size() << "   (" << packets << " packets";
+  if (inPlace && inPlaceCount < m_frames)
+    cout << ", " << m_frames - inPlaceCount << " frames copied";
+  cout << ')' << endl;
+  return true;
+}
+
+
+void VideoEncode::Generate(BYTE * payload, unsigned frame)
+{
+  // A moving pattern, so inter-frame coding has something to do
+  OpalVideoTranscoder::FrameHeader * header = (OpalVideoTranscoder::FrameHeader *)payload;
+  header->x = header->y = 0;
+  header->width = m_width;
+  header->height = m_height;
+  BYTE * yuv = OpalVideoFrameDataPtr(header);
+  for (unsigned y = 0; y < m_height; ++y) {
+    for (unsigned x = 0; x < m_width; ++x)
+      *yuv++ = (BYTE)((x + y + frame*4) ^ (y*frame/8));
+  }
+  PINDEX planeSize = m_width*m_height;
+  for (PINDEX i = 0; i < planeSize/2; ++i)
+    *yuv++ = (BYTE)(128 + (i + frame)%64 - 32);
+}
+
+
+// End of File ///////////////////////////////////////////////////////////////
@@ -46,6 +46,312 @@ extern "C" {
 
 #include <codec/echocancel.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define OPAL_AEC_SSE2 1
+#endif
+
+#include <algorithm>
+#include <vector>
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* Normalised Least Mean Squares adaptive filter, entirely fixed point.
+
+   The far end history is kept twice over so the filter window is always
+   contiguous, newest sample first. Coefficients are held as Q31 for the
+   adaption and as a Q15 copy for filtering, so both inner loops are plain
+   16 bit vector operations. Adaption is frozen during double talk, using
+   a Geigel detector against a decaying far end peak.
+ */
+struct OpalEchoCanceler::NLMSState
+{
+  enum {
+    StepShift = 2,            // Adaption step size, mu, of 1/4
+    DoubleTalkHangover = 30,  // ms to hold adaption off after double talk
+    MinimumPower = 1000,      // Far end window energy below which we do not adapt
+    MaximumGainShift = 20     // Enough that the gain is never clipped above MinimumPower
+  };
+
+  NLMSState(unsigned duration, unsigned clockRate);
+  short Process(short nearEnd, short farEnd);
+
+  unsigned             m_taps;
+  unsigned             m_position;
+  std::vector<short>   m_history;
+  std::vector<PInt32>  m_coefficients;
+  std::vector<short>   m_filter;
+  PInt64               m_power;
+  int                  m_farPeak;
+  unsigned             m_peakDecayShift;
+  unsigned             m_hangover;
+  unsigned             m_hangoverSamples;
+};
+
+
+/* A long tail of full scale products overflows 32 bits, so the sum is 64 bit.
+   The vector path widens each pair sum from _mm_madd_epi16 before adding. */
+static PInt64 NLMSFilter(const short * x, const short * h, unsigned taps)
+{
+#if OPAL_AEC_SSE2
+  __m128i acc = _mm_setzero_si128();
+  for (unsigned i = 0; i < taps; i += 8) {
+    __m128i pairs = _mm_madd_epi16(_mm_loadu_si128((const __m128i *)(x+i)),
+                                   _mm_loadu_si128((const __m128i *)(h+i)));
+    __m128i sign = _mm_srai_epi32(pairs, 31);
+    acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(pairs, sign));
+    acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(pairs, sign));
+  }
+  acc = _mm_add_epi64(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1,0,3,2)));
+  PInt64 sum;
+  _mm_storel_epi64((__m128i *)&sum, acc);
+  return sum;
+#else
+  PInt64 sum = 0;
+  for (unsigned i = 0; i < taps; ++i)
+    sum += x[i]*h[i];
+  return sum;
+#endif
+}
+
+
+/* The step is gain*2^shift times the window, the gain being held to 16 bits
+   so the products fit the vector multiply. Each step is first limited so it
+   cannot overflow when shifted, then the coefficient add saturates, so a
+   large error with a quiet far end cannot wrap a coefficient around. */
+#if OPAL_AEC_SSE2
+static __m128i NLMSClamp(__m128i value, __m128i lower, __m128i upper)
+{
+  __m128i over = _mm_cmpgt_epi32(value, upper);
+  value = _mm_or_si128(_mm_andnot_si128(over, value), _mm_and_si128(over, upper));
+  __m128i under = _mm_cmpgt_epi32(lower, value);
+  return _mm_or_si128(_mm_andnot_si128(under, value), _mm_and_si128(under, lower));
+}
+
+
+static __m128i NLMSAddSaturate(__m128i a, __m128i b)
+{
+  __m128i sum = _mm_add_epi32(a, b);
+  __m128i overflow = _mm_srai_epi32(_mm_and_si128(_mm_xor_si128(a, sum), _mm_xor_si128(b, sum)), 31);
+  __m128i limit = _mm_xor_si128(_mm_srai_epi32(a, 31), _mm_set1_epi32(0x7fffffff));
+  return _mm_or_si128(_mm_andnot_si128(overflow, sum), _mm_and_si128(overflow, limit));
+}
+#endif
+
+
+static void NLMSAdapt(const short * x, PInt32 * h32, short * h16, short gain, unsigned shift, unsigned taps)
+{
+  const PInt32 limit = 0x7fffffff >> shift;
+
+#if OPAL_AEC_SSE2
+  const __m128i g = _mm_set1_epi16(gain);
+  const __m128i count = _mm_cvtsi32_si128(shift);
+  const __m128i upper = _mm_set1_epi32(limit);
+  const __m128i lower = _mm_set1_epi32(~limit);
+  for (unsigned i = 0; i < taps; i += 8) {
+    __m128i xv = _mm_loadu_si128((const __m128i *)(x+i));
+    __m128i lo = _mm_mullo_epi16(xv, g);
+    __m128i hi = _mm_mulhi_epi16(xv, g);
+    __m128i s0 = _mm_sll_epi32(NLMSClamp(_mm_unpacklo_epi16(lo, hi), lower, upper), count);
+    __m128i s1 = _mm_sll_epi32(NLMSClamp(_mm_unpackhi_epi16(lo, hi), lower, upper), count);
+    __m128i c0 = NLMSAddSaturate(_mm_loadu_si128((const __m128i *)(h32+i)),   s0);
+    __m128i c1 = NLMSAddSaturate(_mm_loadu_si128((const __m128i *)(h32+i+4)), s1);
+    _mm_storeu_si128((__m128i *)(h32+i),   c0);
+    _mm_storeu_si128((__m128i *)(h32+i+4), c1);
+    _mm_storeu_si128((__m128i *)(h16+i),   _mm_packs_epi32(_mm_srai_epi32(c0, 16), _mm_srai_epi32(c1, 16)));
+  }
+#else
+  const PInt64 scale = (PInt64)1 << shift;
+  for (unsigned i = 0; i < taps; ++i) {
+    PInt64 step = std::max<PInt64>(~limit, std::min<PInt64>(limit, x[i]*gain)) * scale;
+    h32[i] = (PInt32)std::max<PInt64>(-0x7fffffff-1, std::min<PInt64>(0x7fffffff, h32[i] + step));
+    h16[i] = (short)(h32[i] >> 16);
+  }
+#endif
+}
+
+
+static short SaturateShort(PInt64 value)
+{
+  return (short)std::max<PInt64>(-32768, std::min<PInt64>(32767, value));
+}
+
+
+OpalEchoCanceler::NLMSState::NLMSState(unsigned duration, unsigned clockRate)
+  : m_taps((std::max(duration, 8U) + 7) & ~7U) // Multiple of vector size
+  , m_position(0)
+  , m_history(m_taps*2)
+  , m_coefficients(m_taps)
+  , m_filter(m_taps)
+  , m_power(0)
+  , m_farPeak(0)
+  , m_peakDecayShift(0)
+  , m_hangover(0)
+  , m_hangoverSamples(DoubleTalkHangover*clockRate/1000)
+{
+  // Far end peak decays over roughly the length of the echo tail
+  while ((1U << m_peakDecayShift) < m_taps)
+    ++m_peakDecayShift;
+}
+
+
+short OpalEchoCanceler::NLMSState::Process(short nearEnd, short farEnd)
+{
+  m_position = (m_position == 0 ? m_taps : m_position) - 1;
+  short oldest = m_history[m_position];
+  m_history[m_position] = m_history[m_position + m_taps] = farEnd;
+  m_power += farEnd*farEnd - oldest*oldest;
+
+  const short * window = &m_history[m_position];
+  short error = SaturateShort(nearEnd - (NLMSFilter(window, &m_filter[0], m_taps) >> 15));
+
+  m_farPeak -= m_farPeak >> m_peakDecayShift;
+  if (m_farPeak < PABS(farEnd))
+    m_farPeak = PABS(farEnd);
+
+  if (PABS(nearEnd) > m_farPeak/2)
+    m_hangover = m_hangoverSamples;
+
+  if (m_hangover > 0)
+    --m_hangover;
+  else if (m_power > MinimumPower) {
+    /* A quiet far end makes for a large gain, so rather than clip it, which
+       slows convergence to a crawl, keep the top 16 bits and a shift. */
+    PInt64 gain = (PInt64)error * ((PInt64)1 << (31 - StepShift)) / m_power;
+    unsigned shift = 0;
+    while ((gain > 32767 || gain < -32767) && shift < MaximumGainShift) {
+      gain /= 2;
+      ++shift;
+    }
+    if (gain != 0)
+      NLMSAdapt(window, &m_coefficients[0], &m_filter[0], SaturateShort(gain), shift, m_taps);
+  }
+
+  return error;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+/* With Params::m_batched the media patch threads of all the calls hand their
+   captured frames to one worker per core and wait, the worker cancelling all
+   that queued up since its last pass in one go. A canceler always goes to the
+   same worker, so its filter state stays warm in the one cache. */
+class OpalEchoCancelerWorker
+{
+  public:
+    OpalEchoCancelerWorker()
+      : m_running(true)
+    {
+      m_thread = new PThreadObj<OpalEchoCancelerWorker>(*this, &OpalEchoCancelerWorker::Main, false, "AEC Batch", PThread::HighPriority);
+    }
+
+
+    ~OpalEchoCancelerWorker()
+    {
+      m_mutex.Wait();
+      m_running = false;
+      m_mutex.Signal();
+      m_work.Signal();
+      PThread::WaitAndDelete(m_thread);
+    }
+
+
+    void Cancel(OpalEchoCanceler & canceler, RTP_DataFrame & frame)
+    {
+      m_mutex.Wait();
+      if (!m_running) {
+        m_mutex.Signal();
+        OpalEchoCanceler * cancelers = &canceler;
+        RTP_DataFrame * frames = &frame;
+        OpalEchoCanceler::CancelBatch(&cancelers, &frames, 1);
+        return;
+      }
+      m_cancelers.push_back(&canceler);
+      m_frames.push_back(&frame);
+      m_mutex.Signal();
+
+      m_work.Signal();
+      canceler.batchDone.Wait();
+    }
+
+
+  protected:
+    void Main()
+    {
+      std::vector<OpalEchoCanceler *> cancelers;
+      std::vector<RTP_DataFrame *> frames;
+
+      for (;;) {
+        m_work.Wait();
+
+        m_mutex.Wait();
+        bool running = m_running;
+        cancelers.swap(m_cancelers);
+        frames.swap(m_frames);
+        m_mutex.Signal();
+
+        if (!cancelers.empty()) {
+          OpalEchoCanceler::CancelBatch(&cancelers[0], &frames[0], cancelers.size());
+          // The patch thread may delete its canceler as soon as it is signalled
+          for (size_t i = 0; i < cancelers.size(); ++i)
+            cancelers[i]->batchDone.Signal();
+          cancelers.clear();
+          frames.clear();
+        }
+
+        if (!running)
+          return;
+      }
+    }
+
+    bool                            m_running;
+    std::vector<OpalEchoCanceler *> m_cancelers;
+    std::vector<RTP_DataFrame *>    m_frames;
+    PDECLARE_MUTEX(m_mutex);
+    PSyncPoint                      m_work;
+    PThread                       * m_thread;
+};
+
+
+static unsigned GetProcessorCount()
+{
+#if _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors;
+#else
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (unsigned)count : 1;
+#endif
+}
+
+
+static OpalEchoCancelerWorker & GetBatchWorker(unsigned index)
+{
+  static struct Workers : std::vector<OpalEchoCancelerWorker *>
+  {
+    Workers()
+    {
+      for (unsigned i = GetProcessorCount(); i > 0; --i)
+        push_back(new OpalEchoCancelerWorker);
+      PTRACE(3, "Echo Canceler\tStarted " << size() << " batch workers");
+    }
+
+    ~Workers()
+    {
+      for (iterator it = begin(); it != end(); ++it)
+        delete *it;
+    }
+  } workers;
+
+  return *workers[index % workers.size()];
+}
+
+
+static atomic<unsigned> s_nextBatchWorker;
+
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -55,11 +361,14 @@ OpalEchoCanceler::OpalEchoCanceler()
 {
   echoState = NULL;
   preprocessState = NULL;
+  nlmsState = NULL;
+  batchWorker = s_nextBatchWorker++;
 
   e_buf = NULL;
   echo_buf = NULL;
   ref_buf = NULL;
   noise = NULL;
+  bufferSize = 0;
 
   echo_chan = new PQueueChannel();
   echo_chan->Open(10000);
@@ -76,6 +385,24 @@ OpalEchoCanceler::OpalEchoCanceler()
 OpalEchoCanceler::~OpalEchoCanceler()
 {
   PWaitAndSignal m(stateMutex);
+  DestroyStates();
+  FreeBuffers();
+
+  echo_chan->Close();
+  delete(echo_chan);
+}
+
+
+void OpalEchoCanceler::SetParameters(const Params& newParam)
+{
+  PWaitAndSignal m(stateMutex);
+  param = newParam;
+  DestroyStates();
+}
+
+
+void OpalEchoCanceler::DestroyStates()
+{
   if (echoState) {
     speex_echo_state_destroy(echoState);
     echoState = NULL;
@@ -86,6 +413,13 @@ OpalEchoCanceler::~OpalEchoCanceler()
     preprocessState = NULL;
   }
 
+  delete nlmsState;
+  nlmsState = NULL;
+}
+
+
+void OpalEchoCanceler::FreeBuffers()
+{
   if (ref_buf)
     free(ref_buf);
   if (e_buf)
@@ -94,26 +428,29 @@ OpalEchoCanceler::~OpalEchoCanceler()
     free(echo_buf);
   if (noise)
     free(noise);
-  
-  echo_chan->Close();
-  delete(echo_chan);
+
+  ref_buf = e_buf = echo_buf = noise = NULL;
+  bufferSize = 0;
 }
 
 
-void OpalEchoCanceler::SetParameters(const Params& newParam)
+bool OpalEchoCanceler::AllocateBuffers(size_t size)
 {
-  PWaitAndSignal m(stateMutex);
-  param = newParam;
+  if (size == bufferSize)
+    return false;
 
-  if (echoState) {
-    speex_echo_state_destroy(echoState);
-    echoState = NULL;
-  }
-  
-  if (preprocessState) {
-    speex_preprocess_state_destroy(preprocessState);
-    preprocessState = NULL;
-  }
+  FreeBuffers();
+
+  bufferSize = size;
+  echo_buf = malloc(size);
+  e_buf = malloc(size);
+  ref_buf = malloc(size);
+#if OPAL_SPEEX_FLOAT_NOISE
+  noise = malloc((size/sizeof(short)+1)*sizeof(float));
+#else
+  noise = malloc((size/sizeof(short)+1)*sizeof(spx_int32_t));
+#endif
+  return true;
 }
 
 
@@ -136,9 +473,70 @@ void OpalEchoCanceler::ReceivedPacket(RTP_DataFrame& input_frame, P_INT_PTR)
   if (!param.m_enabled || input_frame.GetPayloadSize() == 0)
     return;
 
+  if (param.m_batched)
+    GetBatchWorker(batchWorker).Cancel(*this, input_frame);
+  else {
+    PWaitAndSignal m(stateMutex);
+    Cancel(input_frame);
+  }
+}
+
+
+void OpalEchoCanceler::CancelBatch(OpalEchoCanceler * const * cancelers, RTP_DataFrame * const * frames, PINDEX count)
+{
+  for (PINDEX i = 0; i < count; ++i) {
+    PWaitAndSignal m(cancelers[i]->stateMutex);
+    if (cancelers[i]->param.m_enabled && frames[i]->GetPayloadSize() > 0)
+      cancelers[i]->Cancel(*frames[i]);
+  }
+}
+
+
+void OpalEchoCanceler::Cancel(RTP_DataFrame & input_frame)
+{
+  if (param.m_algorithm == NLMSAlgorithm)
+    CancelNLMS(input_frame);
+  else
+    CancelSpeex(input_frame);
+}
+
+
+void OpalEchoCanceler::CancelNLMS(RTP_DataFrame & input_frame)
+{
+  size_t samples = input_frame.GetPayloadSize()/sizeof(short);
+
+  if (nlmsState == NULL) {
+    nlmsState = new NLMSState(param.m_duration, clockRate);
+    PTRACE(4, "Echo Canceler\tCreated NLMS canceler with " << nlmsState->m_taps << " taps");
+  }
+
+  AllocateBuffers(samples*sizeof(short));
+
+  /* Use whatever reference echo is available, the rest of the frame is
+     processed against silence so the filter history stays in step. */
+  short * farEnd = (short *)echo_buf;
+  size_t farSamples = 0;
+  if (echo_chan->Read(farEnd, samples*sizeof(short)))
+    farSamples = echo_chan->GetLastReadCount()/sizeof(short);
+
+  short * nearEnd = (short *)input_frame.GetPayloadPtr();
+  for (size_t i = 0; i < samples; i++) {
+    /* Remove the DC offset */
+    mean = 0.999*mean + 0.001*nearEnd[i];
+    nearEnd[i] = nlmsState->Process(nearEnd[i] - (short)mean, i < farSamples ? farEnd[i] : 0);
+  }
+}
+
+
+void OpalEchoCanceler::CancelSpeex(RTP_DataFrame & input_frame)
+{
   size_t inputSize = input_frame.GetPayloadSize(); // Size is in bytes
 
-  PWaitAndSignal m(stateMutex);
+  // The Speex states are built for a fixed frame size, so start again if it changes
+  if (AllocateBuffers(inputSize)) {
+    PTRACE_IF(3, echoState != NULL, "Echo Canceler\tFrame size changed to " << inputSize << " bytes, resetting");
+    DestroyStates();
+  }
 
   if (echoState == NULL) 
     echoState = speex_echo_state_init(inputSize/sizeof(short), param.m_duration);
@@ -149,19 +547,6 @@ void OpalEchoCanceler::ReceivedPacket(RTP_DataFrame& input_frame, P_INT_PTR)
     speex_preprocess_ctl(preprocessState, SPEEX_PREPROCESS_SET_DENOISE, &dummy);
   }
 
-  if (echo_buf == NULL)
-    echo_buf = (spx_int16_t *) malloc(inputSize);
-  if (noise == NULL)
-#if OPAL_SPEEX_FLOAT_NOISE
-    noise = malloc((inputSize/sizeof(short)+1)*sizeof(float));
-#else
-    noise = malloc((inputSize/sizeof(short)+1)*sizeof(spx_int32_t));
-#endif
-  if (e_buf == NULL)
-    e_buf = (spx_int16_t *) malloc(inputSize);
-  if (ref_buf == NULL)
-    ref_buf = (spx_int16_t *) malloc(inputSize);
-
   /* Remove the DC offset */
   short *j = (short *) input_frame.GetPayloadPtr();
   for (size_t i = 0 ; i < inputSize/sizeof(short) ; i++) {
@@ -273,6 +273,142 @@ struct OpalKeyFrameDetectorH264 : OpalVideoFormat::FrameDetector
 PFACTORY_CREATE(OpalVideoFormat::FrameDetectFactory, OpalKeyFrameDetectorH264, H264EncodingName);
 
 
+/* RFC 6184 packetisation of the NAL units of an access unit. Mode 0 sends
+   every NAL unit on its own, the encoder having been told to keep them small
+   enough. Mode 1 aggregates consecutive small NAL units, e.g. SPS and PPS,
+   with STAP-A, and fragments large ones with FU-A. */
+class OpalH264Packetiser : public OpalVideoFormat::Packetiser
+{
+  protected:
+    PINDEX                      m_maxPayloadSize;
+    unsigned                    m_mode;
+    const BYTE                * m_data;
+    const PluginCodec_NALUnit * m_units;
+    PINDEX                      m_count;
+    PINDEX                      m_unit;
+    PINDEX                      m_fragment; // Offset into m_unit for FU-A, zero if not started
+    PINDEX                      m_largest;
+
+  public:
+    OpalH264Packetiser()
+      : m_maxPayloadSize(H241_MAX_NALU_SIZE)
+      , m_mode(1)
+      , m_data(NULL)
+      , m_units(NULL)
+      , m_count(0)
+      , m_unit(0)
+      , m_fragment(0)
+      , m_largest(0)
+    {
+    }
+
+
+    virtual bool SetMediaFormat(const OpalMediaFormat & mediaFormat)
+    {
+      m_mode = mediaFormat.GetOptionInteger(PacketizationModeName, 1);
+      m_maxPayloadSize = mediaFormat.GetOptionInteger(OpalMediaFormat::MaxTxPacketSizeOption(), PluginCodec_RTP_MaxPacketSize)
+                                                                                               - RTP_DataFrame::MinHeaderSize;
+      PTRACE_IF(2, m_mode > 1, "H.264\tCannot packetise in mode " << m_mode);
+      return m_mode <= 1 && m_maxPayloadSize > 2;
+    }
+
+
+    virtual PINDEX GetMaxPayloadSize() const
+    {
+      // Mode 0 cannot fragment, so an oversized NAL unit goes as is
+      return m_mode == 0 ? std::max(m_maxPayloadSize, m_largest) : m_maxPayloadSize;
+    }
+
+
+    virtual void SetAccessUnit(const BYTE * data, const PluginCodec_NALUnit * units, PINDEX count)
+    {
+      m_data = data;
+      m_units = units;
+      m_count = count;
+      m_unit = 0;
+      m_fragment = 0;
+
+      m_largest = 0;
+      for (PINDEX i = 0; i < count; ++i) {
+        if (m_largest < (PINDEX)units[i].m_length)
+          m_largest = units[i].m_length;
+      }
+    }
+
+
+    virtual PINDEX GetPayload(BYTE * payload, bool & last)
+    {
+      // Skip any empty units, they cannot be sent
+      while (m_unit < m_count && m_units[m_unit].m_length == 0)
+        ++m_unit;
+      if (m_unit >= m_count)
+        return 0;
+
+      const BYTE * nalu = m_data + m_units[m_unit].m_offset;
+      PINDEX length = m_units[m_unit].m_length;
+      PINDEX size;
+
+      if (m_fragment == 0 && (length <= m_maxPayloadSize || m_mode == 0)) {
+        // See how many following units fit in a STAP-A with this one
+        PINDEX count = 1;
+        PINDEX aggregate = 1 + 2 + length;
+        if (m_mode != 0) {
+          while (m_unit+count < m_count && aggregate + 2 + (PINDEX)m_units[m_unit+count].m_length <= m_maxPayloadSize)
+            aggregate += 2 + m_units[m_unit+count++].m_length;
+        }
+
+        if (count == 1) {
+          memcpy(payload, nalu, length);
+          size = length;
+        }
+        else {
+          BYTE header = 24;
+          size = 1;
+          for (PINDEX i = 0; i < count; ++i) {
+            const PluginCodec_NALUnit & unit = m_units[m_unit+i];
+            const BYTE * data = m_data + unit.m_offset;
+            header |= data[0] & 0x80; // F bit is OR of all
+            if ((data[0] & 0x60) > (header & 0x60))
+              header = (BYTE)((header & 0x9f) | (data[0] & 0x60)); // NRI is maximum of all
+            *(PUInt16b *)(payload+size) = (WORD)unit.m_length;
+            memcpy(payload+size+2, data, unit.m_length);
+            size += 2 + unit.m_length;
+          }
+          payload[0] = header;
+        }
+        m_unit += count;
+      }
+      else {
+        // FU-A, the NAL header is reconstructed from the indicator and FU header
+        if (m_fragment == 0)
+          m_fragment = 1;
+
+        PINDEX chunk = std::min(m_maxPayloadSize - 2, length - m_fragment);
+        payload[0] = (BYTE)((nalu[0] & 0xe0) | 28);
+        payload[1] = (BYTE)(nalu[0] & 0x1f);
+        if (m_fragment == 1)
+          payload[1] |= 0x80;
+        memcpy(payload+2, nalu + m_fragment, chunk);
+        size = 2 + chunk;
+
+        m_fragment += chunk;
+        if (m_fragment >= length) {
+          payload[1] |= 0x40;
+          m_fragment = 0;
+          ++m_unit;
+        }
+      }
+
+      while (m_unit < m_count && m_units[m_unit].m_length == 0)
+        ++m_unit;
+      last = m_unit >= m_count;
+      return size;
+    }
+};
+
+PFACTORY_CREATE(OpalVideoFormat::PacketiserFactory, OpalH264Packetiser, H264EncodingName);
+
+
 struct OpalKeyFrameDetectorFlashH264 : OpalVideoFormat::FrameDetector
 {
     virtual OpalVideoFormat::FrameType GetFrameType(const BYTE * rtp, PINDEX size)
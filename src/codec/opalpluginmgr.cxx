@@ -591,6 +591,8 @@ OpalPluginTranscoder::OpalPluginTranscoder(const PluginCodec_Definition * defn,
   , freeOptionsControl(defn, PLUGINCODEC_CONTROL_FREE_CODEC_OPTIONS)
   , getOutputDataSizeControl(defn, PLUGINCODEC_CONTROL_GET_OUTPUT_DATA_SIZE)
   , getCodecStatistics(defn, PLUGINCODEC_CONTROL_GET_STATISTICS)
+  , getInputBufferControl(defn, PLUGINCODEC_CONTROL_GET_INPUT_BUFFER)
+  , encodeAccessUnitControl(defn, PLUGINCODEC_CONTROL_ENCODE_ACCESS_UNIT)
 {
 #if PTRACING
   m_firstLoggedUpdateOptions[true] = m_firstLoggedUpdateOptions[false] = true;
@@ -893,6 +895,18 @@ PBoolean OpalPluginVideoTranscoder::UpdateMediaFormats(const OpalMediaFormat & i
       return false;
 
     inputMediaFormat.Merge(outputMediaFormat);
+
+    /* If the plug in can give us whole access units, packetise them ourselves
+       straight into the RTP frames sent, rather than the plug in packetising
+       into its own buffers and us copying each packet out. */
+    if (encodeAccessUnitControl.Exists() && PConfig(PConfig::Environment).GetBoolean("OPAL_ENCODE_ACCESS_UNITS", true)) {
+      if (m_packetiser.get() == NULL)
+        m_packetiser.reset(OpalVideoFormat::PacketiserFactory::CreateInstance(outputMediaFormat.GetEncodingName()));
+      if (m_packetiser.get() != NULL && !m_packetiser->SetMediaFormat(outputMediaFormat))
+        m_packetiser.reset();
+      PTRACE(4, "OpalPlugin\t" << (m_packetiser.get() != NULL ? "Using" : "Not using")
+             << " access unit packetiser for " << outputMediaFormat);
+    }
   }
   else {
     if (!UpdateOptions(inputMediaFormat))
@@ -922,9 +936,100 @@ PBoolean OpalPluginVideoTranscoder::ConvertFrames(const RTP_DataFrame & src, RTP
 }
 
 
+BYTE * OpalPluginVideoTranscoder::GetInputBuffer(PINDEX size)
+{
+  if (context == NULL || !isEncoder)
+    return NULL;
+
+  PluginCodec_InputBuffer input;
+  input.m_buffer = NULL;
+  input.m_size = size;
+
+  PWaitAndSignal mutex(updateMutex);
+  if (getInputBufferControl.Call(&input, sizeof(input), context) <= 0)
+    return NULL;
+
+  return (BYTE *)input.m_buffer;
+}
+
+
+RTP_DataFrame * OpalPluginVideoTranscoder::GetEncodedFrame(PINDEX bufferSize)
+{
+  if (m_encodedFramePool.IsEmpty())
+    return new RTP_DataFrame((PINDEX)0, bufferSize);
+
+  m_encodedFramePool.DisallowDeleteObjects();
+  RTP_DataFrame * frame = (RTP_DataFrame *)m_encodedFramePool.RemoveHead();
+  m_encodedFramePool.AllowDeleteObjects();
+
+  frame->SetPaddingSize(0);
+  frame->SetPayloadSize(0);
+  frame->SetMinSize(bufferSize);
+  return frame;
+}
+
+
+int OpalPluginVideoTranscoder::EncodeAccessUnit(const RTP_DataFrame & src, RTP_DataFrameList & dstList, bool forceIFrame)
+{
+  if (m_packetiser.get() == NULL)
+    return 0;
+
+  PluginCodec_AccessUnit accessUnit;
+  memset(&accessUnit, 0, sizeof(accessUnit));
+  accessUnit.m_input = (const BYTE *)src;
+  accessUnit.m_inputLength = src.GetHeaderSize() + src.GetPayloadSize();
+  accessUnit.m_flags = forceIFrame || m_totalFrames == 0 ? PluginCodec_CoderForceIFrame : 0;
+
+  int result = encodeAccessUnitControl.Call(&accessUnit, sizeof(accessUnit), context);
+  if (result <= 0) {
+    PTRACE_IF(2, result < 0, "OpalPlugin\tEncoding access unit failed at frame " << m_totalFrames);
+    return result;
+  }
+
+  if ((accessUnit.m_flags & PluginCodec_ReturnCoderIFrame) != 0)
+    m_lastFrameWasIFrame = true;
+
+  /* The payloads are written directly into the (usually recycled) frames to
+     be sent, so the only copy of the coded data is from the encoder to here. */
+  m_packetiser->SetAccessUnit(accessUnit.m_data, accessUnit.m_units, accessUnit.m_unitCount);
+  PINDEX bufferSize = src.GetHeaderSize() + m_packetiser->GetMaxPayloadSize();
+
+  bool last = accessUnit.m_unitCount == 0;
+  while (!last) {
+    RTP_DataFrame * dst = GetEncodedFrame(bufferSize);
+    dst->CopyHeader(src);
+    dst->SetPayloadType(GetPayloadType(false));
+
+    PINDEX size = m_packetiser->GetPayload(dst->GetPayloadPtr(), last);
+    if (size == 0) {
+      m_encodedFramePool.Append(dst);
+      break;
+    }
+
+    dst->SetPayloadSize(size);
+    dst->SetMarker(last);
+    dstList.Append(dst);
+  }
+
+  return 1;
+}
+
+
 bool OpalPluginVideoTranscoder::EncodeFrames(const RTP_DataFrame & src, RTP_DataFrameList & dstList)
 {
-  dstList.RemoveAll();
+  /* Keep the output frames from last time for re-use, a key frame can be a
+     hundred or more packets and allocating each one every time is expensive.
+     A frame may only be re-used if nobody downstream, e.g. a retransmission
+     queue, still holds a reference to its buffer. */
+  dstList.DisallowDeleteObjects();
+  while (!dstList.IsEmpty()) {
+    RTP_DataFrame * frame = (RTP_DataFrame *)dstList.RemoveHead();
+    if (frame->IsUnique())
+      m_encodedFramePool.Append(frame);
+    else
+      delete frame;
+  }
+  dstList.AllowDeleteObjects();
 
   if (src.GetPayloadSize() == 0)
     return true;
@@ -941,9 +1046,14 @@ bool OpalPluginVideoTranscoder::EncodeFrames(const RTP_DataFrame & src, RTP_Data
 
   bool foreIFrame = m_encodingIntraFrameControl.RequireIntraFrame();
   PTRACE_IF(4, foreIFrame, "OpalPlugin\tI-Frame forced from video codec at frame " << m_totalFrames+1);
-  do {
+
+  int accessUnit = EncodeAccessUnit(src, dstList, foreIFrame);
+  if (accessUnit < 0)
+    return false;
+
+  if (accessUnit == 0) do {
     // Some plug ins a very rude and use more memory than we say they can, so add an extra 1k
-    RTP_DataFrame * dst = new RTP_DataFrame((PINDEX)0, outputDataSize+1024);
+    RTP_DataFrame * dst = GetEncodedFrame(outputDataSize+1024);
     dst->CopyHeader(src);
     dst->SetPayloadType(GetPayloadType(false));
 
@@ -953,7 +1063,7 @@ bool OpalPluginVideoTranscoder::EncodeFrames(const RTP_DataFrame & src, RTP_Data
     flags = foreIFrame || m_totalFrames == 0 ? PluginCodec_CoderForceIFrame : 0;
 
     if (!Transcode((const BYTE *)src, &fromLen, dst->GetPointer(), &toLen, &flags)) {
-      delete dst;
+      m_encodedFramePool.Append(dst);
       return false;
     }
 
@@ -961,7 +1071,7 @@ bool OpalPluginVideoTranscoder::EncodeFrames(const RTP_DataFrame & src, RTP_Data
       m_lastFrameWasIFrame = true;
 
     if (toLen < RTP_DataFrame::MinHeaderSize || (PINDEX)toLen < dst->GetHeaderSize())
-      delete dst;
+      m_encodedFramePool.Append(dst);
     else {
       dst->SetPayloadSize(toLen - dst->GetHeaderSize());
       dst->SetMarker((flags & PluginCodec_ReturnCoderLastFrame) != 0);
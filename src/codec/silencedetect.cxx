@@ -34,6 +34,18 @@
 #include <codec/silencedetect.h>
 #include <opal/patch.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define OPAL_SILENCE_SSE2 1
+  #if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+    #define OPAL_SILENCE_AVX2 1
+  #endif
+#endif
+
+#include <algorithm>
+#include <math.h>
+
 #define new PNEW
 #define PTraceModule() "Silence"
 
@@ -84,6 +96,7 @@ void OpalSilenceDetector::SetParameters(const Params & newParam, const int rate
   m_signalDeadband = newParam.m_signalDeadband*m_clockRate/1000;
   m_silenceDeadband = newParam.m_silenceDeadband*m_clockRate/1000;
   m_adaptivePeriod = newParam.m_adaptivePeriod*m_clockRate/1000;
+  m_comfortNoise = newParam.m_comfortNoise;
   if (m_mode == FixedSilenceDetection)
     m_levelThreshold = newParam.m_threshold;// note: this value compared to uLaw encoded signal level
   else
@@ -94,7 +107,8 @@ void OpalSilenceDetector::SetParameters(const Params & newParam, const int rate
             "threshold=" << m_levelThreshold << ", "
             "silencedb=" << m_silenceDeadband << " samples, "
             "signaldb=" << m_signalDeadband << " samples, "
-            "period=" << m_adaptivePeriod << " samples");
+            "period=" << m_adaptivePeriod << " samples, "
+            "comfort=" << m_comfortNoise);
 }
 
 
@@ -105,7 +119,7 @@ void OpalSilenceDetector::SetClockRate(unsigned rate)
   m_silenceDeadband = m_silenceDeadband * 1000 / m_clockRate * rate / 1000;
   m_adaptivePeriod = m_adaptivePeriod * 1000 / m_clockRate * rate / 1000;
   m_clockRate = rate;
-  if (m_mode == AdaptiveSilenceDetection)
+  if (m_mode == AdaptiveSilenceDetection || m_mode == SpectralSilenceDetection)
     AdaptiveReset();
 }
 
@@ -117,6 +131,7 @@ void OpalSilenceDetector::GetParameters(Params & params)
   params.m_signalDeadband = m_signalDeadband*1000/m_clockRate;
   params.m_silenceDeadband = m_silenceDeadband*1000/m_clockRate;
   params.m_adaptivePeriod = m_adaptivePeriod*1000/m_clockRate;
+  params.m_comfortNoise = m_comfortNoise;
 }
 
 
@@ -126,7 +141,8 @@ PString OpalSilenceDetector::Params::AsString() const
                << m_threshold << ','
                << m_signalDeadband << ','
                << m_silenceDeadband << ','
-               << m_adaptivePeriod);
+               << m_adaptivePeriod << ','
+               << (m_comfortNoise ? 1 : 0));
 }
 
 
@@ -135,6 +151,8 @@ void OpalSilenceDetector::Params::FromString(const PString & str)
   PStringArray params = str.Tokenise(',');
   switch (params.GetSize()) {
     default :
+    case 6 :
+      m_comfortNoise = params[5].AsUnsigned() != 0;
     case 5 :
       m_adaptivePeriod = params[4].AsUnsigned();
     case 4 :
@@ -211,8 +229,9 @@ OpalSilenceDetector::Result OpalSilenceDetector::Detect(const BYTE * audioPtr, P
   // Convert to a logarithmic scale - use uLaw which is complemented
   m_lastSignalLevel = linear2ulaw(rawSignalLevel) ^ 0xff;
 
-  // Now if signal level above threshold we are "talking"
-  bool haveSignal = m_lastSignalLevel > m_levelThreshold;
+  // Now if signal level above threshold, or the spectrum says so, we are "talking"
+  bool haveSignal = m_mode == SpectralSilenceDetection ? HasSpectralSignal(audioPtr, audioLen)
+                                                       : m_lastSignalLevel > m_levelThreshold;
 
   // If no change ie still talking or still silent, reset frame counter
   if ((m_lastResult != IsSilent) == haveSignal) {
@@ -318,23 +337,291 @@ OpalSilenceDetector::Result OpalSilenceDetector::Detect(const BYTE * audioPtr, P
 }
 
 
+bool OpalSilenceDetector::HasSpectralSignal(const BYTE *, PINDEX)
+{
+  return m_lastSignalLevel > m_levelThreshold;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 
+// Centre frequencies of the spectral detection bands, about a third octave apart
+static const float SpectralBandCentres[] = { 250, 350, 500, 650, 800, 1000, 1250, 1500, 1800, 2200, 2700, 3300 };
+static const float SpectralBandQ = 3.0f;
+static const float SpectralVoiceSNR = 2.0f;     // Average dB above the noise floors for voice
+static const float SpectralMaxBandSNR = 20.0f;  // So one loud band cannot decide alone
+static const unsigned SpectralBootstrapFrames = 5; // Assumed to be background noise
+
+
+OpalPCM16SilenceDetector::OpalPCM16SilenceDetector(const Params & newParam)
+  : OpalSilenceDetector(newParam)
+  , m_bandCount(0)
+  , m_spectralClockRate(0)
+  , m_spectralFrames(0)
+{
+}
+
+
 unsigned OpalPCM16SilenceDetector::GetAverageSignalLevel(const BYTE * buffer, PINDEX size)
 {
   // Calculate the average signal level of this frame
-  int sum = 0;
   PINDEX samples = size/2;
+  if (samples == 0)
+    return 0;
+
+  return (unsigned)(GetSignalSum((const short *)buffer, samples)/samples);
+}
+
+
+bool OpalPCM16SilenceDetector::HasSpectralSignal(const BYTE * buffer, PINDEX size)
+{
+  PINDEX samples = size/2;
+  if (samples == 0)
+    return false;
+
+  unsigned clockRate = GetClockRate();
+
+  if (m_spectralClockRate != clockRate) {
+    m_spectralClockRate = clockRate;
+    m_spectralFrames = 0;
+    m_bandCount = 0;
+    for (PINDEX i = 0; i < (PINDEX)PARRAYSIZE(SpectralBandCentres) && SpectralBandCentres[i] < clockRate*0.45f; ++i) {
+      // Constant peak gain band pass biquad
+      float w0 = 2*(float)M_PI*SpectralBandCentres[i]/clockRate;
+      float alpha = sinf(w0)/(2*SpectralBandQ);
+      float a0 = 1 + alpha;
+      SpectralBand & band = m_bands[m_bandCount++];
+      band.m_b0 = alpha/a0;
+      band.m_a1 = -2*cosf(w0)/a0;
+      band.m_a2 = (1 - alpha)/a0;
+      band.m_z1 = band.m_z2 = 0;
+      band.m_noise = 0;
+    }
+    PTRACE(4, "Spectral detection using " << m_bandCount << " bands at " << clockRate << "Hz");
+  }
+
   const short * pcm = (const short *)buffer;
+  float energies[MaxSpectralBands];
+  for (PINDEX b = 0; b < m_bandCount; ++b) {
+    SpectralBand & band = m_bands[b];
+    float z1 = band.m_z1, z2 = band.m_z2, energy = 0;
+    for (PINDEX i = 0; i < samples; ++i) {
+      float x = pcm[i];
+      float y = band.m_b0*x + z1;
+      z1 = z2 - band.m_a1*y;
+      z2 = -band.m_b0*x - band.m_a2*y;
+      energy += y*y;
+    }
+    band.m_z1 = z1;
+    band.m_z2 = z2;
+    energies[b] = energy/samples + 1; // Floor avoids log of zero on digital silence
+  }
+
+  if (m_spectralFrames < SpectralBootstrapFrames) {
+    for (PINDEX b = 0; b < m_bandCount; ++b)
+      m_bands[b].m_noise = (m_bands[b].m_noise*m_spectralFrames + energies[b])/(m_spectralFrames+1);
+    ++m_spectralFrames;
+    return false;
+  }
+
+  float snrSum = 0;
+  for (PINDEX b = 0; b < m_bandCount; ++b)
+    snrSum += std::max(0.0f, std::min(10*log10f(energies[b]/m_bands[b].m_noise), SpectralMaxBandSNR));
+  float averageSNR = m_bandCount > 0 ? snrSum/m_bandCount : 0;
+  bool voice = averageSNR > SpectralVoiceSNR;
+
+  /* The noise floors drop quickly, follow the noise when clearly no voice,
+     and otherwise creep up by at most 3dB a second. Frames near the decision
+     point are not followed, so missed quiet speech does not raise the floor. */
+  float rise = powf(2.0f, (float)samples/clockRate);
+  for (PINDEX b = 0; b < m_bandCount; ++b) {
+    SpectralBand & band = m_bands[b];
+    if (energies[b] < band.m_noise)
+      band.m_noise = 0.7f*band.m_noise + 0.3f*energies[b];
+    else if (averageSNR < SpectralVoiceSNR/2)
+      band.m_noise = 0.95f*band.m_noise + 0.05f*energies[b];
+    else
+      band.m_noise = std::min(band.m_noise*rise, energies[b]);
+  }
+
+  PTRACE(6, "Spectral SNR " << averageSNR << "dB, voice=" << voice);
+  return voice;
+}
+
+
+static PUInt64 SignalSumScalar(const short * pcm, PINDEX samples)
+{
+  PUInt64 sum = 0;
   const short * end = pcm + samples;
   while (pcm != end) {
-    if (*pcm < 0)
-      sum -= *pcm++;
-    else
-      sum += *pcm++;
+    sum += PABS(*pcm);
+    pcm++;
+  }
+  return sum;
+}
+
+
+#if OPAL_SILENCE_SSE2
+
+/* Absolute values are formed in 16 bits, where -32768 becomes 0x8000 which
+   is still correct when zero extended, then accumulated in 32 bit lanes.
+   Each vector adds at most 65536 to a lane, so flush to the 64 bit total
+   well before a lane could overflow.
+ */
+static const PINDEX MaxVectorsPerBlock = 32768;
+
+static PUInt64 SignalSumSSE2(const short * pcm, PINDEX samples)
+{
+  PUInt64 sum = 0;
+  const __m128i zero = _mm_setzero_si128();
+
+  while (samples >= 8) {
+    PINDEX vectors = std::min(samples/8, MaxVectorsPerBlock);
+    samples -= vectors*8;
+
+    __m128i acc = zero;
+    while (vectors-- > 0) {
+      __m128i v = _mm_loadu_si128((const __m128i *)pcm);
+      __m128i sign = _mm_srai_epi16(v, 15);
+      v = _mm_sub_epi16(_mm_xor_si128(v, sign), sign);
+      acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(v, zero));
+      acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(v, zero));
+      pcm += 8;
+    }
+
+    PUInt32 lanes[4];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    sum += (PUInt64)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  }
+
+  return sum + SignalSumScalar(pcm, samples);
+}
+
+#endif // OPAL_SILENCE_SSE2
+
+
+#if OPAL_SILENCE_AVX2
+
+__attribute__((target("avx2")))
+static PUInt64 SignalSumAVX2(const short * pcm, PINDEX samples)
+{
+  PUInt64 sum = 0;
+  const __m256i zero = _mm256_setzero_si256();
+
+  while (samples >= 16) {
+    PINDEX vectors = std::min(samples/16, MaxVectorsPerBlock);
+    samples -= vectors*16;
+
+    __m256i acc = zero;
+    while (vectors-- > 0) {
+      __m256i v = _mm256_abs_epi16(_mm256_loadu_si256((const __m256i *)pcm));
+      acc = _mm256_add_epi32(acc, _mm256_unpacklo_epi16(v, zero));
+      acc = _mm256_add_epi32(acc, _mm256_unpackhi_epi16(v, zero));
+      pcm += 16;
+    }
+
+    PUInt32 lanes[8];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    for (PINDEX i = 0; i < 8; ++i)
+      sum += lanes[i];
+  }
+
+  return sum + SignalSumSSE2(pcm, samples);
+}
+
+#endif // OPAL_SILENCE_AVX2
+
+
+typedef PUInt64 (*SignalSumFunction)(const short * pcm, PINDEX samples);
+
+static SignalSumFunction SelectSignalSum()
+{
+#if OPAL_SILENCE_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    PTRACE(4, "Using AVX2 signal level calculation");
+    return SignalSumAVX2;
+  }
+#endif
+#if OPAL_SILENCE_SSE2
+  PTRACE(4, "Using SSE2 signal level calculation");
+  return SignalSumSSE2;
+#else
+  return SignalSumScalar;
+#endif
+}
+
+
+PUInt64 OpalPCM16SilenceDetector::GetSignalSum(const short * pcm, PINDEX samples)
+{
+  // CPU features do not change, so a race on first use is harmless
+  static SignalSumFunction function = SelectSignalSum();
+  return function(pcm, samples);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+
+OpalPCM16ComfortNoise::OpalPCM16ComfortNoise()
+  : m_level(0)
+  , m_tilt(0)
+  , m_state(0)
+  , m_seed(0x12345678)
+  , m_learnt(false)
+{
+}
+
+
+void OpalPCM16ComfortNoise::Analyse(const short * pcm, PINDEX samples)
+{
+  if (samples < 2)
+    return;
+
+  float level = (float)OpalPCM16SilenceDetector::GetSignalSum(pcm, samples)/samples;
+
+  /* The background is the quiet part of the audio, so follow the minimum
+     level down quickly, and up slowly so a noisier room is followed. */
+  if (!m_learnt)
+    m_level = level;
+  else if (level < m_level)
+    m_level = 0.7f*m_level + 0.3f*level;
+  else
+    m_level = std::min(m_level*(1 + samples*0.00005f), level);
+
+  // Only learn the spectral tilt from frames that are background noise
+  if (level <= m_level*2) {
+    float r0 = 0, r1 = 0;
+    for (PINDEX i = 1; i < samples; ++i) {
+      r0 += (float)pcm[i]*pcm[i];
+      r1 += (float)pcm[i]*pcm[i-1];
+    }
+    if (r0 > 0) {
+      float tilt = std::max(-0.9f, std::min(r1/r0, 0.9f));
+      m_tilt = m_learnt ? 0.9f*m_tilt + 0.1f*tilt : tilt;
+    }
   }
 
-  return sum/samples;
+  m_learnt = true;
+}
+
+
+void OpalPCM16ComfortNoise::Generate(short * pcm, PINDEX samples)
+{
+  if (!m_learnt || m_level < 1) {
+    memset(pcm, 0, samples*sizeof(short));
+    return;
+  }
+
+  /* Uniform noise has an average absolute value of half its peak, and the
+     first order shaping filter raises the RMS by 1/sqrt(1-tilt^2), so scale
+     to get back to the measured level. */
+  float gain = 2*m_level*sqrtf(1 - m_tilt*m_tilt);
+  for (PINDEX i = 0; i < samples; ++i) {
+    m_seed = m_seed*1664525 + 1013904223;
+    float white = (int)m_seed/2147483648.0f;
+    m_state = white + m_tilt*m_state;
+    float sample = gain*m_state;
+    pcm[i] = (short)std::max(-32767.0f, std::min(sample, 32767.0f));
+  }
 }
 
 
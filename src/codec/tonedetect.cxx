@@ -0,0 +1,335 @@
+/*
+ * tonedetect.cxx
+ *
+ * Open Phone Abstraction Library (OPAL)
+ *
+ * Copyright (c) 2017 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida Pty. Ltd.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "tonedetect.h"
+#endif
+#include <opal_config.h>
+
+#include <codec/tonedetect.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+  #include <xmmintrin.h>
+  #define OPAL_TONE_SSE 1
+#endif
+
+#include <math.h>
+#include <algorithm>
+
+#define new PNEW
+#define PTraceModule() "Tones"
+
+
+// Order matters, AnalyseBlock() indexes into this table
+static const double Frequencies[OpalToneDetector::NumFrequencies] = {
+   697,  770,  852,  941,   // DTMF rows
+  1209, 1336, 1477, 1633,   // DTMF columns
+  1100, 2100,               // Fax CNG and CED
+   440,  480,  620          // Call progress
+};
+
+enum {
+  RowBase = 0,
+  ColumnBase = 4,
+  CNGIndex = 8,
+  CEDIndex = 9,
+  Freq440Index = 10,
+  Freq480Index = 11,
+  Freq620Index = 12
+};
+
+static const char DTMFDigits[4][4] = {
+  { '1', '2', '3', 'A' },
+  { '4', '5', '6', 'B' },
+  { '7', '8', '9', 'C' },
+  { '*', '0', '#', 'D' }
+};
+
+static const float MinimumMeanSquare = 10000;  // About -44dBm0
+static const float DTMFMinimumRatio = 0.7f;    // Fraction of block energy in the two DTMF tones
+static const float DTMFMaximumTwist = 6.3f;    // 8dB
+static const float DTMFMinimumRatioRelative = 4.0f; // Other rows/columns must be 6dB down
+static const float FaxMinimumRatio = 0.6f;
+static const float ProgressMinimumRatio = 0.6f;
+static const float ProgressComponentRatio = 0.15f;
+
+/* A digit may be as short as 40ms, which is only certain to contain one whole
+   block, so digits are reported on the first block. The tests on twist and on
+   the other rows and columns are what reject speech. */
+static const unsigned DTMFConfirmBlocks = 1;      // 25.6ms
+static const unsigned CNGConfirmBlocks = 16;      // 410ms
+static const unsigned CEDConfirmBlocks = 20;      // 512ms
+static const unsigned ProgressConfirmBlocks = 8;  // 205ms
+static const PINDEX ProgressReleaseSamples = 36000; // 4.5s, longer than the 4s gap in ringback cadence
+
+
+// Padding filters have a zero coefficient and are never looked at
+struct ToneDetectorCoefficients
+{
+  ToneDetectorCoefficients()
+  {
+    for (PINDEX i = 0; i < OpalToneDetector::FilterBankSize; ++i)
+      m_coef[i] = i < OpalToneDetector::NumFrequencies ? (float)(2*cos(2*M_PI*Frequencies[i]/8000)) : 0;
+  }
+
+  float m_coef[OpalToneDetector::FilterBankSize];
+};
+
+static const ToneDetectorCoefficients & GetCoefficients()
+{
+  static ToneDetectorCoefficients coefficients;
+  return coefficients;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+OpalToneDetector::OpalToneDetector()
+{
+  Reset();
+}
+
+
+void OpalToneDetector::Reset()
+{
+  ResetBlock();
+  ResetTones();
+  m_callProgress = NoCallProgress;
+  m_progressCandidate = NoCallProgress;
+  m_progressAbsent = 0;
+}
+
+
+void OpalToneDetector::ResetTones()
+{
+  m_lastDigit = '\0';
+  m_digitBlocks = m_cngBlocks = m_cedBlocks = m_progressBlocks = 0;
+}
+
+
+void OpalToneDetector::NoCallProgressFor(PINDEX samples)
+{
+  if (m_callProgress == NoCallProgress)
+    return;
+
+  m_progressAbsent += samples;
+  if (m_progressAbsent >= ProgressReleaseSamples) {
+    PTRACE(3, "Call progress " << m_callProgress << " stopped");
+    m_callProgress = NoCallProgress;
+    m_progressAbsent = 0;
+  }
+}
+
+
+void OpalToneDetector::ResetBlock()
+{
+  for (PINDEX i = 0; i < FilterBankSize; ++i)
+    m_s1[i] = m_s2[i] = 0;
+  m_blockEnergy = 0;
+  m_blockSamples = 0;
+}
+
+
+PString OpalToneDetector::Detect(const short * pcm, PINDEX samples, unsigned mult, unsigned div)
+{
+  PString tones;
+  if (samples <= 0)
+    return tones;
+
+  float scale = div != 0 ? (float)mult/div : 1.0f;
+
+  // Gate on the energy of the whole frame, silence never reaches the filters
+  float energy = 0;
+  for (PINDEX i = 0; i < samples; ++i)
+    energy += (float)pcm[i]*pcm[i];
+  if (energy*scale*scale < MinimumMeanSquare*samples) {
+    ResetBlock();
+    ResetTones();
+    m_progressCandidate = NoCallProgress;
+    NoCallProgressFor(samples);
+    return tones;
+  }
+
+  const float * coef = GetCoefficients().m_coef;
+
+  while (samples > 0) {
+    PINDEX count = std::min(samples, (PINDEX)(BlockSize - m_blockSamples));
+    samples -= count;
+    m_blockSamples += count;
+
+#if OPAL_TONE_SSE
+    // The whole bank lives in registers, one sample updates four filters per instruction
+    __m128 c0 = _mm_loadu_ps(coef),   c1 = _mm_loadu_ps(coef+4),   c2 = _mm_loadu_ps(coef+8),   c3 = _mm_loadu_ps(coef+12);
+    __m128 a0 = _mm_loadu_ps(m_s1),   a1 = _mm_loadu_ps(m_s1+4),   a2 = _mm_loadu_ps(m_s1+8),   a3 = _mm_loadu_ps(m_s1+12);
+    __m128 b0 = _mm_loadu_ps(m_s2),   b1 = _mm_loadu_ps(m_s2+4),   b2 = _mm_loadu_ps(m_s2+8),   b3 = _mm_loadu_ps(m_s2+12);
+    while (count-- > 0) {
+      float sample = *pcm++*scale;
+      m_blockEnergy += sample*sample;
+      __m128 x = _mm_set1_ps(sample);
+      __m128 n0 = _mm_sub_ps(_mm_add_ps(x, _mm_mul_ps(c0, a0)), b0);
+      __m128 n1 = _mm_sub_ps(_mm_add_ps(x, _mm_mul_ps(c1, a1)), b1);
+      __m128 n2 = _mm_sub_ps(_mm_add_ps(x, _mm_mul_ps(c2, a2)), b2);
+      __m128 n3 = _mm_sub_ps(_mm_add_ps(x, _mm_mul_ps(c3, a3)), b3);
+      b0 = a0; b1 = a1; b2 = a2; b3 = a3;
+      a0 = n0; a1 = n1; a2 = n2; a3 = n3;
+    }
+    _mm_storeu_ps(m_s1, a0);   _mm_storeu_ps(m_s1+4, a1);   _mm_storeu_ps(m_s1+8, a2);   _mm_storeu_ps(m_s1+12, a3);
+    _mm_storeu_ps(m_s2, b0);   _mm_storeu_ps(m_s2+4, b1);   _mm_storeu_ps(m_s2+8, b2);   _mm_storeu_ps(m_s2+12, b3);
+#else
+    while (count-- > 0) {
+      float sample = *pcm++*scale;
+      m_blockEnergy += sample*sample;
+      for (PINDEX i = 0; i < NumFrequencies; ++i) {
+        float s0 = sample + coef[i]*m_s1[i] - m_s2[i];
+        m_s2[i] = m_s1[i];
+        m_s1[i] = s0;
+      }
+    }
+#endif
+
+    if (m_blockSamples >= BlockSize) {
+      AnalyseBlock(tones);
+      ResetBlock();
+    }
+  }
+
+  return tones;
+}
+
+
+void OpalToneDetector::AnalyseBlock(PString & tones)
+{
+  if (m_blockEnergy < MinimumMeanSquare*BlockSize) {
+    ResetTones();
+    m_progressCandidate = NoCallProgress;
+    NoCallProgressFor(BlockSize);
+    return;
+  }
+
+  /* Convert each filter output to the fraction of the block energy at that
+     frequency, a pure tone at the filter frequency gives very close to 1. */
+  const float * coef = GetCoefficients().m_coef;
+  float normalise = 2.0f/(BlockSize*m_blockEnergy);
+  float ratio[NumFrequencies];
+  for (PINDEX i = 0; i < NumFrequencies; ++i)
+    ratio[i] = (m_s1[i]*m_s1[i] + m_s2[i]*m_s2[i] - coef[i]*m_s1[i]*m_s2[i])*normalise;
+
+  // DTMF, strongest row and column, each clear of the others
+  PINDEX row = 0, col = 0;
+  for (PINDEX i = 1; i < 4; ++i) {
+    if (ratio[RowBase+i] > ratio[RowBase+row])
+      row = i;
+    if (ratio[ColumnBase+i] > ratio[ColumnBase+col])
+      col = i;
+  }
+
+  float rowRatio = ratio[RowBase+row];
+  float colRatio = ratio[ColumnBase+col];
+  bool isDigit = rowRatio + colRatio > DTMFMinimumRatio &&
+                 rowRatio < colRatio*DTMFMaximumTwist &&
+                 colRatio < rowRatio*DTMFMaximumTwist;
+  for (PINDEX i = 0; isDigit && i < 4; ++i) {
+    if ((i != row && ratio[RowBase+i]*DTMFMinimumRatioRelative > rowRatio) ||
+        (i != col && ratio[ColumnBase+i]*DTMFMinimumRatioRelative > colRatio))
+      isDigit = false;
+  }
+
+  char digit = isDigit ? DTMFDigits[row][col] : '\0';
+  if (digit != m_lastDigit) {
+    m_lastDigit = digit;
+    m_digitBlocks = 0;
+  }
+  if (digit != '\0' && ++m_digitBlocks == DTMFConfirmBlocks) {
+    PTRACE(4, "DTMF '" << digit << "' detected");
+    tones += digit;
+  }
+
+  // Fax tones, reported once per burst
+  if (ratio[CNGIndex] < FaxMinimumRatio)
+    m_cngBlocks = 0;
+  else if (++m_cngBlocks == CNGConfirmBlocks) {
+    PTRACE(3, "Fax CNG detected");
+    tones += 'X';
+  }
+
+  if (ratio[CEDIndex] < FaxMinimumRatio)
+    m_cedBlocks = 0;
+  else if (++m_cedBlocks == CEDConfirmBlocks) {
+    PTRACE(3, "Fax CED detected");
+    tones += 'Y';
+  }
+
+  // Call progress, 480Hz with one of 440Hz for ringback or 620Hz for busy
+  CallProgress progress = NoCallProgress;
+  if (ratio[Freq480Index] > ProgressComponentRatio) {
+    if (ratio[Freq440Index] > ProgressComponentRatio && ratio[Freq440Index] + ratio[Freq480Index] > ProgressMinimumRatio)
+      progress = RingBackTone;
+    else if (ratio[Freq620Index] > ProgressComponentRatio && ratio[Freq620Index] + ratio[Freq480Index] > ProgressMinimumRatio)
+      progress = BusyTone;
+  }
+
+  if (progress != m_progressCandidate) {
+    m_progressCandidate = progress;
+    m_progressBlocks = 0;
+  }
+
+  if (progress == NoCallProgress)
+    NoCallProgressFor(BlockSize);
+  else {
+    if (progress == m_callProgress)
+      m_progressAbsent = 0;
+    if (++m_progressBlocks == ProgressConfirmBlocks && progress != m_callProgress) {
+      m_callProgress = progress;
+      m_progressAbsent = 0;
+      PTRACE(3, "Call progress " << progress << " detected");
+    }
+  }
+}
+
+
+void OpalToneDetector::Detect(Channel * channels, PINDEX count, unsigned mult, unsigned div)
+{
+  for (PINDEX i = 0; i < count; ++i) {
+    Channel & channel = channels[i];
+    if (PAssertNULL(channel.m_detector) != NULL)
+      channel.m_tones = channel.m_detector->Detect(channel.m_pcm, channel.m_samples, mult, div);
+  }
+}
+
+
+ostream & operator<<(ostream & strm, OpalToneDetector::CallProgress progress)
+{
+  static const char * const Names[] = { "none", "ringback", "busy" };
+  if (progress >= 0 && progress < (int)PARRAYSIZE(Names))
+    strm << Names[progress];
+  else
+    strm << "CallProgress<" << (int)progress << '>';
+  return strm;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
@@ -187,6 +187,18 @@ class OPALPINVOKE {
   }
 
 
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_new_OpalMessageArray")]
+  public static extern global::System.IntPtr new_OpalMessageArray(int jarg1);
+
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_delete_OpalMessageArray")]
+  public static extern void delete_OpalMessageArray(global::System.Runtime.InteropServices.HandleRef jarg1);
+
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OpalMessageArray_getitem")]
+  public static extern global::System.IntPtr OpalMessageArray_getitem(global::System.Runtime.InteropServices.HandleRef jarg1, int jarg2);
+
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OpalMessageArray_setitem")]
+  public static extern void OpalMessageArray_setitem(global::System.Runtime.InteropServices.HandleRef jarg1, int jarg2, global::System.Runtime.InteropServices.HandleRef jarg3);
+
   [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OPAL_C_API_VERSION_get")]
   public static extern int OPAL_C_API_VERSION_get();
 
@@ -208,6 +220,18 @@ class OPALPINVOKE {
   [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OPAL_GET_MESSAGE_FUNCTION_get")]
   public static extern string OPAL_GET_MESSAGE_FUNCTION_get();
 
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OpalGetMessages")]
+  public static extern uint OpalGetMessages(global::System.Runtime.InteropServices.HandleRef jarg1, global::System.Runtime.InteropServices.HandleRef jarg2, uint jarg3, uint jarg4);
+
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OPAL_GET_MESSAGES_FUNCTION_get")]
+  public static extern string OPAL_GET_MESSAGES_FUNCTION_get();
+
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OpalSignalMediaRing")]
+  public static extern void OpalSignalMediaRing(global::System.Runtime.InteropServices.HandleRef jarg1);
+
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OPAL_SIGNAL_MEDIA_RING_FUNCTION_get")]
+  public static extern string OPAL_SIGNAL_MEDIA_RING_FUNCTION_get();
+
   [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OpalSendMessage")]
   public static extern global::System.IntPtr OpalSendMessage(global::System.Runtime.InteropServices.HandleRef jarg1, global::System.Runtime.InteropServices.HandleRef jarg2);
 
@@ -280,6 +304,51 @@ class OPALPINVOKE {
   [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OPAL_PREFIX_ALL_get")]
   public static extern string OPAL_PREFIX_ALL_get();
 
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OpalMediaRing_size_set")]
+  public static extern void OpalMediaRing_size_set(global::System.Runtime.InteropServices.HandleRef jarg1, uint jarg2);
+
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OpalMediaRing_size_get")]
+  public static extern uint OpalMediaRing_size_get(global::System.Runtime.InteropServices.HandleRef jarg1);
+
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OpalMediaRing_readPosition_set")]
+  public static extern void OpalMediaRing_readPosition_set(global::System.Runtime.InteropServices.HandleRef jarg1, uint jarg2);
+
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OpalMediaRing_readPosition_get")]
+  public static extern uint OpalMediaRing_readPosition_get(global::System.Runtime.InteropServices.HandleRef jarg1);
+
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OpalMediaRing_writePosition_set")]
+  public static extern void OpalMediaRing_writePosition_set(global::System.Runtime.InteropServices.HandleRef jarg1, uint jarg2);
+
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OpalMediaRing_writePosition_get")]
+  public static extern uint OpalMediaRing_writePosition_get(global::System.Runtime.InteropServices.HandleRef jarg1);
+
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OpalMediaRing_overruns_set")]
+  public static extern void OpalMediaRing_overruns_set(global::System.Runtime.InteropServices.HandleRef jarg1, uint jarg2);
+
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OpalMediaRing_overruns_get")]
+  public static extern uint OpalMediaRing_overruns_get(global::System.Runtime.InteropServices.HandleRef jarg1);
+
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OpalMediaRing_consumerWaiting_set")]
+  public static extern void OpalMediaRing_consumerWaiting_set(global::System.Runtime.InteropServices.HandleRef jarg1, uint jarg2);
+
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OpalMediaRing_consumerWaiting_get")]
+  public static extern uint OpalMediaRing_consumerWaiting_get(global::System.Runtime.InteropServices.HandleRef jarg1);
+
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OpalMediaRing_data_set")]
+  public static extern void OpalMediaRing_data_set(global::System.Runtime.InteropServices.HandleRef jarg1, global::System.Runtime.InteropServices.HandleRef jarg2);
+
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OpalMediaRing_data_get")]
+  public static extern global::System.IntPtr OpalMediaRing_data_get(global::System.Runtime.InteropServices.HandleRef jarg1);
+
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_new_OpalMediaRing")]
+  public static extern global::System.IntPtr new_OpalMediaRing();
+
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_delete_OpalMediaRing")]
+  public static extern void delete_OpalMediaRing(global::System.Runtime.InteropServices.HandleRef jarg1);
+
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OPAL_MEDIA_RING_WRAP_get")]
+  public static extern int OPAL_MEDIA_RING_WRAP_get();
+
   [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OpalParamGeneral_audioRecordDevice_set")]
   public static extern void OpalParamGeneral_audioRecordDevice_set(global::System.Runtime.InteropServices.HandleRef jarg1, string jarg2);
 
@@ -538,6 +607,12 @@ class OPALPINVOKE {
   [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OpalParamGeneral_autoCreateCertificate_get")]
   public static extern uint OpalParamGeneral_autoCreateCertificate_get(global::System.Runtime.InteropServices.HandleRef jarg1);
 
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OpalParamGeneral_mediaRingSize_set")]
+  public static extern void OpalParamGeneral_mediaRingSize_set(global::System.Runtime.InteropServices.HandleRef jarg1, uint jarg2);
+
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OpalParamGeneral_mediaRingSize_get")]
+  public static extern uint OpalParamGeneral_mediaRingSize_get(global::System.Runtime.InteropServices.HandleRef jarg1);
+
   [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_new_OpalParamGeneral")]
   public static extern global::System.IntPtr new_OpalParamGeneral();
 
@@ -1000,6 +1075,12 @@ class OPALPINVOKE {
   [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OpalStatusMediaStream_watermark_get")]
   public static extern string OpalStatusMediaStream_watermark_get(global::System.Runtime.InteropServices.HandleRef jarg1);
 
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OpalStatusMediaStream_mediaRing_set")]
+  public static extern void OpalStatusMediaStream_mediaRing_set(global::System.Runtime.InteropServices.HandleRef jarg1, global::System.Runtime.InteropServices.HandleRef jarg2);
+
+  [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_OpalStatusMediaStream_mediaRing_get")]
+  public static extern global::System.IntPtr OpalStatusMediaStream_mediaRing_get(global::System.Runtime.InteropServices.HandleRef jarg1);
+
   [global::System.Runtime.InteropServices.DllImport("OPAL", EntryPoint="CSharp_new_OpalStatusMediaStream")]
   public static extern global::System.IntPtr new_OpalStatusMediaStream();
 
@@ -0,0 +1,106 @@
+//------------------------------------------------------------------------------
+// <auto-generated />
+//
+// This file was automatically generated by SWIG (http://www.swig.org).
+// Version 3.0.7
+//
+// Do not make changes to this file unless you know what you are doing--modify
+// the SWIG interface file instead.
+//------------------------------------------------------------------------------
+
+
+public class OpalMediaRing : global::System.IDisposable {
+  private global::System.Runtime.InteropServices.HandleRef swigCPtr;
+  protected bool swigCMemOwn;
+
+  internal OpalMediaRing(global::System.IntPtr cPtr, bool cMemoryOwn) {
+    swigCMemOwn = cMemoryOwn;
+    swigCPtr = new global::System.Runtime.InteropServices.HandleRef(this, cPtr);
+  }
+
+  internal static global::System.Runtime.InteropServices.HandleRef getCPtr(OpalMediaRing obj) {
+    return (obj == null) ? new global::System.Runtime.InteropServices.HandleRef(null, global::System.IntPtr.Zero) : obj.swigCPtr;
+  }
+
+  ~OpalMediaRing() {
+    Dispose();
+  }
+
+  public virtual void Dispose() {
+    lock(this) {
+      if (swigCPtr.Handle != global::System.IntPtr.Zero) {
+        if (swigCMemOwn) {
+          swigCMemOwn = false;
+          OPALPINVOKE.delete_OpalMediaRing(swigCPtr);
+        }
+        swigCPtr = new global::System.Runtime.InteropServices.HandleRef(null, global::System.IntPtr.Zero);
+      }
+      global::System.GC.SuppressFinalize(this);
+    }
+  }
+
+  public uint size {
+    set {
+      OPALPINVOKE.OpalMediaRing_size_set(swigCPtr, value);
+    } 
+    get {
+      uint ret = OPALPINVOKE.OpalMediaRing_size_get(swigCPtr);
+      return ret;
+    } 
+  }
+
+  public uint readPosition {
+    set {
+      OPALPINVOKE.OpalMediaRing_readPosition_set(swigCPtr, value);
+    } 
+    get {
+      uint ret = OPALPINVOKE.OpalMediaRing_readPosition_get(swigCPtr);
+      return ret;
+    } 
+  }
+
+  public uint writePosition {
+    set {
+      OPALPINVOKE.OpalMediaRing_writePosition_set(swigCPtr, value);
+    } 
+    get {
+      uint ret = OPALPINVOKE.OpalMediaRing_writePosition_get(swigCPtr);
+      return ret;
+    } 
+  }
+
+  public uint overruns {
+    set {
+      OPALPINVOKE.OpalMediaRing_overruns_set(swigCPtr, value);
+    } 
+    get {
+      uint ret = OPALPINVOKE.OpalMediaRing_overruns_get(swigCPtr);
+      return ret;
+    } 
+  }
+
+  public uint consumerWaiting {
+    set {
+      OPALPINVOKE.OpalMediaRing_consumerWaiting_set(swigCPtr, value);
+    } 
+    get {
+      uint ret = OPALPINVOKE.OpalMediaRing_consumerWaiting_get(swigCPtr);
+      return ret;
+    } 
+  }
+
+  public SWIGTYPE_p_unsigned_char data {
+    set {
+      OPALPINVOKE.OpalMediaRing_data_set(swigCPtr, SWIGTYPE_p_unsigned_char.getCPtr(value));
+    } 
+    get {
+      global::System.IntPtr cPtr = OPALPINVOKE.OpalMediaRing_data_get(swigCPtr);
+      SWIGTYPE_p_unsigned_char ret = (cPtr == global::System.IntPtr.Zero) ? null : new SWIGTYPE_p_unsigned_char(cPtr, false);
+      return ret;
+    } 
+  }
+
+  public OpalMediaRing() : this(OPALPINVOKE.new_OpalMediaRing(), true) {
+  }
+
+}
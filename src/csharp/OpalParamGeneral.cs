@@ -472,6 +472,16 @@ public class OpalParamGeneral : global::System.IDisposable {
     } 
   }
 
+  public uint mediaRingSize {
+    set {
+      OPALPINVOKE.OpalParamGeneral_mediaRingSize_set(swigCPtr, value);
+    } 
+    get {
+      uint ret = OPALPINVOKE.OpalParamGeneral_mediaRingSize_get(swigCPtr);
+      return ret;
+    } 
+  }
+
   public OpalParamGeneral() : this(OPALPINVOKE.new_OpalParamGeneral(), true) {
   }
 
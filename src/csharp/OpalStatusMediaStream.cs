@@ -109,6 +109,17 @@ public class OpalStatusMediaStream : global::System.IDisposable {
     } 
   }
 
+  public OpalMediaRing mediaRing {
+    set {
+      OPALPINVOKE.OpalStatusMediaStream_mediaRing_set(swigCPtr, OpalMediaRing.getCPtr(value));
+    } 
+    get {
+      global::System.IntPtr cPtr = OPALPINVOKE.OpalStatusMediaStream_mediaRing_get(swigCPtr);
+      OpalMediaRing ret = (cPtr == global::System.IntPtr.Zero) ? null : new OpalMediaRing(cPtr, false);
+      return ret;
+    } 
+  }
+
   public OpalStatusMediaStream() : this(OPALPINVOKE.new_OpalStatusMediaStream(), true) {
   }
 
@@ -298,15 +298,77 @@ SWIGEXPORT void SWIGSTDCALL SWIGRegisterStringCallback_OPAL(SWIG_CSharpStringHel
     int opal_csharp_swig_wrapper_link;
   
 
+static OpalMessage * *new_OpalMessageArray(int nelements) { 
+  return (new OpalMessage *[nelements]());
+}
+
+static void delete_OpalMessageArray(OpalMessage * *ary) { 
+  delete [] ary;
+}
+
+static OpalMessage * OpalMessageArray_getitem(OpalMessage * *ary, int index) {
+    return ary[index];
+}
+static void OpalMessageArray_setitem(OpalMessage * *ary, int index, OpalMessage * value) {
+    ary[index] = value;
+}
+
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+SWIGEXPORT void * SWIGSTDCALL CSharp_new_OpalMessageArray(int jarg1) {
+  void * jresult ;
+  int arg1 ;
+  OpalMessage **result = 0 ;
+  
+  arg1 = (int)jarg1; 
+  result = (OpalMessage **)new_OpalMessageArray(arg1);
+  jresult = (void *)result; 
+  return jresult;
+}
+
+
+SWIGEXPORT void SWIGSTDCALL CSharp_delete_OpalMessageArray(void * jarg1) {
+  OpalMessage **arg1 = (OpalMessage **) 0 ;
+  
+  arg1 = (OpalMessage **)jarg1; 
+  delete_OpalMessageArray(arg1);
+}
+
+
+SWIGEXPORT void * SWIGSTDCALL CSharp_OpalMessageArray_getitem(void * jarg1, int jarg2) {
+  void * jresult ;
+  OpalMessage **arg1 = (OpalMessage **) 0 ;
+  int arg2 ;
+  OpalMessage *result = 0 ;
+  
+  arg1 = (OpalMessage **)jarg1; 
+  arg2 = (int)jarg2; 
+  result = (OpalMessage *)OpalMessageArray_getitem(arg1,arg2);
+  jresult = (void *)result; 
+  return jresult;
+}
+
+
+SWIGEXPORT void SWIGSTDCALL CSharp_OpalMessageArray_setitem(void * jarg1, int jarg2, void * jarg3) {
+  OpalMessage **arg1 = (OpalMessage **) 0 ;
+  int arg2 ;
+  OpalMessage *arg3 = (OpalMessage *) 0 ;
+  
+  arg1 = (OpalMessage **)jarg1; 
+  arg2 = (int)jarg2; 
+  arg3 = (OpalMessage *)jarg3; 
+  OpalMessageArray_setitem(arg1,arg2,arg3);
+}
+
+
 SWIGEXPORT int SWIGSTDCALL CSharp_OPAL_C_API_VERSION_get() {
   int jresult ;
   int result;
   
-  result = (int)(36);
+  result = (int)(37);
   jresult = result; 
   return jresult;
 }
@@ -378,6 +440,52 @@ SWIGEXPORT char * SWIGSTDCALL CSharp_OPAL_GET_MESSAGE_FUNCTION_get() {
 }
 
 
+SWIGEXPORT unsigned int SWIGSTDCALL CSharp_OpalGetMessages(void * jarg1, void * jarg2, unsigned int jarg3, unsigned int jarg4) {
+  unsigned int jresult ;
+  OpalHandle arg1 = (OpalHandle) 0 ;
+  OpalMessage **arg2 = (OpalMessage **) 0 ;
+  unsigned int arg3 ;
+  unsigned int arg4 ;
+  unsigned int result;
+  
+  arg1 = (OpalHandle)jarg1; 
+  arg2 = (OpalMessage **)jarg2; 
+  arg3 = (unsigned int)jarg3; 
+  arg4 = (unsigned int)jarg4; 
+  result = (unsigned int)OpalGetMessages(arg1,arg2,arg3,arg4);
+  jresult = result; 
+  return jresult;
+}
+
+
+SWIGEXPORT char * SWIGSTDCALL CSharp_OPAL_GET_MESSAGES_FUNCTION_get() {
+  char * jresult ;
+  char *result = 0 ;
+  
+  result = (char *)("OpalGetMessages");
+  jresult = SWIG_csharp_string_callback((const char *)result); 
+  return jresult;
+}
+
+
+SWIGEXPORT void SWIGSTDCALL CSharp_OpalSignalMediaRing(void * jarg1) {
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  
+  arg1 = (OpalMediaRing *)jarg1; 
+  OpalSignalMediaRing(arg1);
+}
+
+
+SWIGEXPORT char * SWIGSTDCALL CSharp_OPAL_SIGNAL_MEDIA_RING_FUNCTION_get() {
+  char * jresult ;
+  char *result = 0 ;
+  
+  result = (char *)("OpalSignalMediaRing");
+  jresult = SWIG_csharp_string_callback((const char *)result); 
+  return jresult;
+}
+
+
 SWIGEXPORT void * SWIGSTDCALL CSharp_OpalSendMessage(void * jarg1, void * jarg2) {
   void * jresult ;
   OpalHandle arg1 = (OpalHandle) 0 ;
@@ -620,6 +728,166 @@ SWIGEXPORT char * SWIGSTDCALL CSharp_OPAL_PREFIX_ALL_get() {
 }
 
 
+SWIGEXPORT void SWIGSTDCALL CSharp_OpalMediaRing_size_set(void * jarg1, unsigned int jarg2) {
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  unsigned int arg2 ;
+  
+  arg1 = (OpalMediaRing *)jarg1; 
+  arg2 = (unsigned int)jarg2; 
+  if (arg1) (arg1)->m_size = arg2;
+}
+
+
+SWIGEXPORT unsigned int SWIGSTDCALL CSharp_OpalMediaRing_size_get(void * jarg1) {
+  unsigned int jresult ;
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  unsigned int result;
+  
+  arg1 = (OpalMediaRing *)jarg1; 
+  result = (unsigned int) ((arg1)->m_size);
+  jresult = result; 
+  return jresult;
+}
+
+
+SWIGEXPORT void SWIGSTDCALL CSharp_OpalMediaRing_readPosition_set(void * jarg1, unsigned int jarg2) {
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  unsigned int arg2 ;
+  
+  arg1 = (OpalMediaRing *)jarg1; 
+  arg2 = (unsigned int)jarg2; 
+  if (arg1) (arg1)->m_readPosition = arg2;
+}
+
+
+SWIGEXPORT unsigned int SWIGSTDCALL CSharp_OpalMediaRing_readPosition_get(void * jarg1) {
+  unsigned int jresult ;
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  unsigned int result;
+  
+  arg1 = (OpalMediaRing *)jarg1; 
+  result = (unsigned int) ((arg1)->m_readPosition);
+  jresult = result; 
+  return jresult;
+}
+
+
+SWIGEXPORT void SWIGSTDCALL CSharp_OpalMediaRing_writePosition_set(void * jarg1, unsigned int jarg2) {
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  unsigned int arg2 ;
+  
+  arg1 = (OpalMediaRing *)jarg1; 
+  arg2 = (unsigned int)jarg2; 
+  if (arg1) (arg1)->m_writePosition = arg2;
+}
+
+
+SWIGEXPORT unsigned int SWIGSTDCALL CSharp_OpalMediaRing_writePosition_get(void * jarg1) {
+  unsigned int jresult ;
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  unsigned int result;
+  
+  arg1 = (OpalMediaRing *)jarg1; 
+  result = (unsigned int) ((arg1)->m_writePosition);
+  jresult = result; 
+  return jresult;
+}
+
+
+SWIGEXPORT void SWIGSTDCALL CSharp_OpalMediaRing_overruns_set(void * jarg1, unsigned int jarg2) {
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  unsigned int arg2 ;
+  
+  arg1 = (OpalMediaRing *)jarg1; 
+  arg2 = (unsigned int)jarg2; 
+  if (arg1) (arg1)->m_overruns = arg2;
+}
+
+
+SWIGEXPORT unsigned int SWIGSTDCALL CSharp_OpalMediaRing_overruns_get(void * jarg1) {
+  unsigned int jresult ;
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  unsigned int result;
+  
+  arg1 = (OpalMediaRing *)jarg1; 
+  result = (unsigned int) ((arg1)->m_overruns);
+  jresult = result; 
+  return jresult;
+}
+
+
+SWIGEXPORT void SWIGSTDCALL CSharp_OpalMediaRing_consumerWaiting_set(void * jarg1, unsigned int jarg2) {
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  unsigned int arg2 ;
+  
+  arg1 = (OpalMediaRing *)jarg1; 
+  arg2 = (unsigned int)jarg2; 
+  if (arg1) (arg1)->m_consumerWaiting = arg2;
+}
+
+
+SWIGEXPORT unsigned int SWIGSTDCALL CSharp_OpalMediaRing_consumerWaiting_get(void * jarg1) {
+  unsigned int jresult ;
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  unsigned int result;
+  
+  arg1 = (OpalMediaRing *)jarg1; 
+  result = (unsigned int) ((arg1)->m_consumerWaiting);
+  jresult = result; 
+  return jresult;
+}
+
+
+SWIGEXPORT void SWIGSTDCALL CSharp_OpalMediaRing_data_set(void * jarg1, void * jarg2) {
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  unsigned char *arg2 = (unsigned char *) 0 ;
+  
+  arg1 = (OpalMediaRing *)jarg1; 
+  arg2 = (unsigned char *)jarg2; 
+  if (arg1) (arg1)->m_data = arg2;
+}
+
+
+SWIGEXPORT void * SWIGSTDCALL CSharp_OpalMediaRing_data_get(void * jarg1) {
+  void * jresult ;
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  unsigned char *result = 0 ;
+  
+  arg1 = (OpalMediaRing *)jarg1; 
+  result = (unsigned char *) ((arg1)->m_data);
+  jresult = (void *)result; 
+  return jresult;
+}
+
+
+SWIGEXPORT void * SWIGSTDCALL CSharp_new_OpalMediaRing() {
+  void * jresult ;
+  OpalMediaRing *result = 0 ;
+  
+  result = (OpalMediaRing *)new OpalMediaRing();
+  jresult = (void *)result; 
+  return jresult;
+}
+
+
+SWIGEXPORT void SWIGSTDCALL CSharp_delete_OpalMediaRing(void * jarg1) {
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  
+  arg1 = (OpalMediaRing *)jarg1; 
+  delete arg1;
+}
+
+
+SWIGEXPORT int SWIGSTDCALL CSharp_OPAL_MEDIA_RING_WRAP_get() {
+  int jresult ;
+  int result;
+  
+  result = (int)(0xffffffff);
+  jresult = result; 
+  return jresult;
+}
+
+
 SWIGEXPORT void SWIGSTDCALL CSharp_OpalParamGeneral_audioRecordDevice_set(void * jarg1, char * jarg2) {
   OpalParamGeneral *arg1 = (OpalParamGeneral *) 0 ;
   char *arg2 = (char *) 0 ;
@@ -1678,6 +1946,28 @@ SWIGEXPORT unsigned int SWIGSTDCALL CSharp_OpalParamGeneral_autoCreateCertificat
 }
 
 
+SWIGEXPORT void SWIGSTDCALL CSharp_OpalParamGeneral_mediaRingSize_set(void * jarg1, unsigned int jarg2) {
+  OpalParamGeneral *arg1 = (OpalParamGeneral *) 0 ;
+  unsigned int arg2 ;
+  
+  arg1 = (OpalParamGeneral *)jarg1; 
+  arg2 = (unsigned int)jarg2; 
+  if (arg1) (arg1)->m_mediaRingSize = arg2;
+}
+
+
+SWIGEXPORT unsigned int SWIGSTDCALL CSharp_OpalParamGeneral_mediaRingSize_get(void * jarg1) {
+  unsigned int jresult ;
+  OpalParamGeneral *arg1 = (OpalParamGeneral *) 0 ;
+  unsigned int result;
+  
+  arg1 = (OpalParamGeneral *)jarg1; 
+  result = (unsigned int) ((arg1)->m_mediaRingSize);
+  jresult = result; 
+  return jresult;
+}
+
+
 SWIGEXPORT void * SWIGSTDCALL CSharp_new_OpalParamGeneral() {
   void * jresult ;
   OpalParamGeneral *result = 0 ;
@@ -3663,6 +3953,28 @@ SWIGEXPORT char * SWIGSTDCALL CSharp_OpalStatusMediaStream_watermark_get(void *
 }
 
 
+SWIGEXPORT void SWIGSTDCALL CSharp_OpalStatusMediaStream_mediaRing_set(void * jarg1, void * jarg2) {
+  OpalStatusMediaStream *arg1 = (OpalStatusMediaStream *) 0 ;
+  OpalMediaRing *arg2 = (OpalMediaRing *) 0 ;
+  
+  arg1 = (OpalStatusMediaStream *)jarg1; 
+  arg2 = (OpalMediaRing *)jarg2; 
+  if (arg1) (arg1)->m_mediaRing = arg2;
+}
+
+
+SWIGEXPORT void * SWIGSTDCALL CSharp_OpalStatusMediaStream_mediaRing_get(void * jarg1) {
+  void * jresult ;
+  OpalStatusMediaStream *arg1 = (OpalStatusMediaStream *) 0 ;
+  OpalMediaRing *result = 0 ;
+  
+  arg1 = (OpalStatusMediaStream *)jarg1; 
+  result = (OpalMediaRing *) ((arg1)->m_mediaRing);
+  jresult = (void *)result; 
+  return jresult;
+}
+
+
 SWIGEXPORT void * SWIGSTDCALL CSharp_new_OpalStatusMediaStream() {
   void * jresult ;
   OpalStatusMediaStream *result = 0 ;
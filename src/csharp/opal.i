@@ -10,5 +10,9 @@
 
   %include "typemaps.i"
 
+  // Array of message pointers for OpalGetMessages()
+  %include "carrays.i"
+  %array_functions(OpalMessage *, OpalMessageArray);
+
   /* Parse the header file to generate wrappers */
   %include "opal.h"
@@ -660,6 +660,7 @@ OpalLocalMediaStream::OpalLocalMediaStream(OpalLocalConnection & connection,
   , OpalMediaStreamPacing(mediaFormat)
   , m_connection(connection)
   , m_synchronicity(synchronicity)
+  , m_context(NULL)
 {
 }
 
@@ -1077,9 +1077,11 @@ PBoolean H323Connection::OnReceivedSignalSetup(const H323SignalPDU & originalSet
     if (!m_capabilityExchangeProcedure->HasReceivedCapabilities())
       m_remoteCapabilities.RemoveAll();
 
+    // This shares the endpoint table, so only use const lookups
     bool localCapsEmpty = m_localCapabilities.GetSize() == 0;
     if (localCapsEmpty)
       m_localCapabilities = m_endpoint.GetCapabilities();
+    const H323Capabilities & localCapabilities = m_localCapabilities;
 
     // Extract capabilities from the fast start OpenLogicalChannel structures
     PINDEX i;
@@ -1100,7 +1102,7 @@ PBoolean H323Connection::OnReceivedSignalSetup(const H323SignalPDU & originalSet
         }
         if (dataType != NULL) {
           H323Capability * capability = m_remoteCapabilities.FindCapability(*dataType);
-          if (capability == NULL && (capability = m_localCapabilities.FindCapability(*dataType)) != NULL) {
+          if (capability == NULL && (capability = localCapabilities.FindCapability(*dataType)) != NULL) {
             // If we actually have the remote capabilities then the remote (very oddly)
             // had a fast connect entry it could not do. If we have not yet got a remote
             // cap table then build one using all possible caps.
@@ -2663,7 +2665,7 @@ PBoolean H323Connection::HandleFastStartAcknowledge(const H225_ArrayOf_PASN_Octe
 
     nothingToOpen = false;
 
-    H323Capability * replyCapability = m_localCapabilities.FindCapability(dataType);
+    H323Capability * replyCapability = GetLocalCapabilities().FindCapability(dataType);
     if (replyCapability == NULL)
       continue;
 
@@ -4171,6 +4173,8 @@ void H323Connection::OnSetLocalCapabilities()
   else if (rfc2833Capability != NULL)
     m_localCapabilities.SetCapability(0, P_MAX_INDEX, rfc2833Capability);
 
+  m_endpoint.ShareLocalCapabilities(m_localCapabilities);
+
   m_localMediaFormats = m_localCapabilities.GetMediaFormats();
   PTRACE(3, "H323\tSetLocalCapabilities: "
          << setfill(',') << m_localMediaFormats << '\n'
@@ -4288,7 +4292,7 @@ OpalMediaFormatList H323Connection::GetMediaFormats() const
   if (  IsH245Master() &&
         (
           (m_localCapabilities.GetSize() > 0 &&
-           m_localCapabilities[0].GetCapabilityDirection() == H323Capability::e_ReceiveAndTransmit)
+           GetLocalCapabilities()[0].GetCapabilityDirection() == H323Capability::e_ReceiveAndTransmit)
           ||
           (m_remoteCapabilities.GetSize() > 0 &&
            m_remoteCapabilities[0].GetCapabilityDirection() == H323Capability::e_ReceiveAndTransmit)
@@ -4749,7 +4753,7 @@ void H323Connection::SelectFastStartChannels(unsigned sessionID,
 {
   // Select all of the fast start channels to offer to the remote when initiating a call.
   for (PINDEX i = 0; i < m_localCapabilities.GetSize(); i++) {
-    H323Capability & capability = m_localCapabilities[i];
+    const H323Capability & capability = GetLocalCapabilities()[i];
     if (capability.GetDefaultSessionID() == sessionID) {
       if (receiver) {
         if (!OpenLogicalChannel(capability, sessionID, H323Channel::IsReceiver)) {
@@ -5012,6 +5016,7 @@ H323Channel * H323Connection::CreateLogicalChannel(const H245_OpenLogicalChannel
   const H245_DataType * dataType;
   H323Channel::Directions direction;
   H323Capability * capability;
+  std::auto_ptr<H323Capability> localCapability;
 
   if (startingFast && open.HasOptionalField(H245_OpenLogicalChannel::e_reverseLogicalChannelParameters)) {
     if (open.m_reverseLogicalChannelParameters.m_multiplexParameters.GetTag() !=
@@ -5051,8 +5056,15 @@ H323Channel * H323Connection::CreateLogicalChannel(const H245_OpenLogicalChannel
         param->m_mediaPacketization.GetTag() == H245_H2250LogicalChannelParameters_mediaPacketization::e_rtpPayloadType)
       mediaPacketization = H323GetRTPPacketization(param->m_mediaPacketization);
 
-    // See if datatype is supported
-    capability = m_localCapabilities.FindCapability(*dataType, mediaPacketization);
+    /* See if datatype is supported. The local table may be shared with the
+       endpoint or other connections, so the PDU is applied to a copy of the
+       entry, which the channel clones anyway. */
+    const H323Capabilities & localCapabilities = m_localCapabilities;
+    capability = localCapabilities.FindCapability(*dataType, mediaPacketization);
+    if (capability != NULL) {
+      localCapability.reset(capability->CloneAs<H323Capability>());
+      capability = localCapability.get();
+    }
   }
 
   if (capability == NULL) {
@@ -5188,7 +5200,7 @@ PBoolean H323Connection::OnCreateLogicalChannel(const H323Capability & capabilit
     }
   }
   else {
-    H323Capability * localCapability = m_localCapabilities.FindCapability(capability);
+    H323Capability * localCapability = GetLocalCapabilities().FindCapability(capability);
     if (localCapability == NULL || !m_localCapabilities.IsAllowed(*localCapability)) {
       PTRACE(2, "H323\tOnCreateLogicalChannel - receive capability " << capability << " not allowed.");
       OnFailedMediaStream(true, "Local endpoint is not capable of media format");
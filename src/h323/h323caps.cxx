@@ -159,6 +159,7 @@ void H323SetMediaCapability(const H323Capability &, DATA_TYPE & dataType, CAP_TY
 H323Capability::H323Capability()
   : assignedCapabilityNumber(0) // Unassigned
   , capabilityDirection(e_Unknown)
+  , m_owner(NULL)
 #if OPAL_H235_6 || OPAL_H235_8
   , m_cryptoCapability(NULL)
 #endif
@@ -171,6 +172,7 @@ H323Capability::H323Capability(const H323Capability & other)
   , assignedCapabilityNumber(other.assignedCapabilityNumber)
   , capabilityDirection(other.capabilityDirection)
   , m_mediaFormat(other.m_mediaFormat)
+  , m_owner(NULL) // Copy is not in any table yet
 #if OPAL_H235_6 || OPAL_H235_8
   , m_cryptoCapability(other.m_cryptoCapability != NULL ? other.m_cryptoCapability->CloneAs<H235SecurityCapability>() : NULL)
 #endif
@@ -199,6 +201,16 @@ H323Capability::~H323Capability()
 }
 
 
+void H323Capability::SetCapabilityNumber(unsigned num)
+{
+  // Keep the table index by number correct, if in a table
+  if (m_owner != NULL)
+    m_owner->Renumber(*this, num);
+  else
+    assignedCapabilityNumber = num;
+}
+
+
 PObject::Comparison H323Capability::Compare(const PObject & obj) const
 {
   PAssert(PIsDescendant(&obj, H323Capability), PInvalidCast);
@@ -2942,12 +2954,14 @@ PBoolean H323CapabilitiesSet::SetSize(PINDEX newSize)
 
 
 H323Capabilities::H323Capabilities()
+  : m_body(new H323SharedCapabilities)
 {
 }
 
 
 H323Capabilities::H323Capabilities(H323Connection & connection,
                                    const H245_TerminalCapabilitySet & pdu)
+  : m_body(new H323SharedCapabilities)
 {
   PTRACE_CONTEXT_ID_FROM(connection);
 
@@ -2958,8 +2972,8 @@ H323Capabilities::H323Capabilities(H323Connection & connection,
    *  version of the codec against possibly multiple codec with the same 'subtype' such as
    *  e_h263VideoCapability.
    */
-  m_mediaPacketizations += "RFC2190";  // Always supported
-  m_mediaPacketizations += OpalPluginCodec_Identifer_H264_Aligned; // Always supported
+  m_body->m_mediaPacketizations += "RFC2190";  // Always supported
+  m_body->m_mediaPacketizations += OpalPluginCodec_Identifer_H264_Aligned; // Always supported
   const H245_MultiplexCapability * muxCap = NULL;
   if (pdu.HasOptionalField(H245_TerminalCapabilitySet::e_multiplexCapability)) {
     muxCap = &pdu.m_multiplexCapability;
@@ -2974,9 +2988,9 @@ H323Capabilities::H323Capabilities(H323Connection & connection,
         for (PINDEX i = 0; i < mediaPacket.m_rtpPayloadType.GetSize(); i++) {
           PString mediaPacketization = H323GetRTPPacketization(mediaPacket.m_rtpPayloadType[i]);
           if (!mediaPacketization.IsEmpty()) {
-            m_mediaPacketizations += mediaPacketization;
+            m_body->m_mediaPacketizations += mediaPacketization;
             PTRACE(4, "H323\tH323Capabilities(ctor) Appended mediaPacketization="
-                   << mediaPacketization << ", mediaPacketization count=" << m_mediaPacketizations.GetSize());
+                   << mediaPacketization << ", mediaPacketization count=" << m_body->m_mediaPacketizations.GetSize());
           }
         } // for ... m_rtpPayloadType.GetSize()
       } // e_rtpPayloadType
@@ -2985,13 +2999,17 @@ H323Capabilities::H323Capabilities(H323Connection & connection,
 
   // Decode out of the PDU, the list of known codecs.
   if (pdu.HasOptionalField(H245_TerminalCapabilitySet::e_capabilityTable)) {
-    H323Capabilities allCapabilities(dynamic_cast<const H323EndPoint &>(connection.GetEndPoint()).GetCapabilities());
+    /* The endpoint capabilities are used as read only templates, only those
+       matching an entry in the PDU are cloned. Media packetizations are not
+       used in the match, as they were never part of the endpoint table. */
+    const H323Capabilities & allCapabilities = dynamic_cast<const H323EndPoint &>(connection.GetEndPoint()).GetCapabilities();
+    const PStringSet noMediaPacketizations;
     OpalMediaFormatList localFormats = connection.GetLocalMediaFormats();
     PTRACE(4, "H323\tParsing remote capabilities");
 
     for (PINDEX i = 0; i < pdu.m_capabilityTable.GetSize(); i++) {
       if (pdu.m_capabilityTable[i].HasOptionalField(H245_CapabilityTableEntry::e_capability)) {
-        H323Capability * capability = allCapabilities.FindCapability(pdu.m_capabilityTable[i].m_capability);
+        H323Capability * capability = allCapabilities.FindMatchingCapability(pdu.m_capabilityTable[i].m_capability, noMediaPacketizations);
         if (capability != NULL) {
           H323Capability * copy = capability->CloneAs<H323Capability>();
           OpalMediaFormatList::const_iterator it = localFormats.FindFormat(copy->GetMediaFormat());
@@ -3001,7 +3019,7 @@ H323Capabilities::H323Capabilities(H323Connection & connection,
             delete copy;
           else {
             copy->SetCapabilityNumber(pdu.m_capabilityTable[i].m_capabilityTableEntryNumber);
-            m_table.Append(copy);
+            m_body->Append(copy);
           }
         }
       }
@@ -3009,40 +3027,39 @@ H323Capabilities::H323Capabilities(H323Connection & connection,
   }
 
 #if OPAL_H235_6 || OPAL_H235_8
-  for (PINDEX i = 0; i < m_table.GetSize(); ) {
-    if (m_table[i].PostTCS(connection, *this))
+  for (PINDEX i = 0; i < m_body->m_table.GetSize(); ) {
+    if (m_body->m_table[i].PostTCS(connection, *this))
       ++i;
-    else
-      m_table.RemoveAt(i);
+    else {
+      m_body->RemoveFromIndex(&m_body->m_table[i]);
+      m_body->m_table.RemoveAt(i);
+    }
   }
 #endif
 
-  if (!m_mediaPacketizations.IsEmpty()) { // also update the mediaPacketizations option
-    for (PINDEX i = 0; i < m_table.GetSize(); ++i) {
-      OpalMediaFormat & mediaFormat = m_table[i].GetWritableMediaFormat();
+  if (!m_body->m_mediaPacketizations.IsEmpty()) { // also update the mediaPacketizations option
+    for (PINDEX i = 0; i < m_body->m_table.GetSize(); ++i) {
+      OpalMediaFormat & mediaFormat = m_body->m_table[i].GetWritableMediaFormat();
       PStringSet intersection;
-      if (PStringSet::Intersection(m_mediaPacketizations, mediaFormat.GetMediaPacketizationSet(), &intersection))
+      if (PStringSet::Intersection(m_body->m_mediaPacketizations, mediaFormat.GetMediaPacketizationSet(), &intersection))
         mediaFormat.SetMediaPacketizations(intersection);
     }
   }
 
   PINDEX outerSize = pdu.m_capabilityDescriptors.GetSize();
-  m_set.SetSize(outerSize);
+  m_body->m_set.SetSize(outerSize);
   for (PINDEX outer = 0; outer < outerSize; outer++) {
     H245_CapabilityDescriptor & desc = pdu.m_capabilityDescriptors[outer];
     if (desc.HasOptionalField(H245_CapabilityDescriptor::e_simultaneousCapabilities)) {
       PINDEX middleSize = desc.m_simultaneousCapabilities.GetSize();
-      m_set[outer].m_capabilityDescriptorNumber = desc.m_capabilityDescriptorNumber;
-      m_set[outer].SetSize(middleSize);
+      m_body->m_set[outer].m_capabilityDescriptorNumber = desc.m_capabilityDescriptorNumber;
+      m_body->m_set[outer].SetSize(middleSize);
       for (PINDEX middle = 0; middle < middleSize; middle++) {
         H245_AlternativeCapabilitySet & alt = desc.m_simultaneousCapabilities[middle];
         for (PINDEX inner = 0; inner < alt.GetSize(); inner++) {
-          for (PINDEX cap = 0; cap < m_table.GetSize(); cap++) {
-            if (m_table[cap].GetCapabilityNumber() == alt[inner]) {
-              m_set[outer][middle].Append(&m_table[cap]);
-              break;
-            }
-          }
+          H323SharedCapabilities::NumberIndex::const_iterator it = m_body->m_numberIndex.find(alt[inner]);
+          if (it != m_body->m_numberIndex.end())
+            m_body->m_set[outer][middle].Append(it->second);
         }
       }
     }
@@ -3052,33 +3069,43 @@ H323Capabilities::H323Capabilities(H323Connection & connection,
 
 H323Capabilities::H323Capabilities(const H323Capabilities & original)
   : PObject(original)
+  , m_body(original.m_body)
 {
-  operator=(original);
+  ++m_body->m_references;
 }
 
 
 H323Capabilities & H323Capabilities::operator=(const H323Capabilities & original)
 {
-  RemoveAll();
-  Merge(original);
+  if (m_body != original.m_body) {
+    ++original.m_body->m_references;
+    ReleaseBody();
+    m_body = original.m_body;
+  }
   return *this;
 }
 
 
+H323Capabilities::~H323Capabilities()
+{
+  ReleaseBody();
+}
+
+
 void H323Capabilities::PrintOn(ostream & strm) const
 {
   std::streamsize indent = strm.precision()-1;
   strm << setw(indent) << " " << "Table:\n";
-  for (PINDEX i = 0; i < m_table.GetSize(); i++)
-    strm << setw(indent+2) << " " << m_table[i] << '\n';
+  for (PINDEX i = 0; i < m_body->m_table.GetSize(); i++)
+    strm << setw(indent+2) << " " << m_body->m_table[i] << '\n';
 
   strm << setw(indent) << " " << "Set:\n";
-  for (PINDEX outer = 0; outer < m_set.GetSize(); outer++) {
-    strm << setw(indent+2) << " " << outer << ": capabilityDescriptorNumber = " << m_set[outer].m_capabilityDescriptorNumber << '\n';
-    for (PINDEX middle = 0; middle < m_set[outer].GetSize(); middle++) {
+  for (PINDEX outer = 0; outer < m_body->m_set.GetSize(); outer++) {
+    strm << setw(indent+2) << " " << outer << ": capabilityDescriptorNumber = " << m_body->m_set[outer].m_capabilityDescriptorNumber << '\n';
+    for (PINDEX middle = 0; middle < m_body->m_set[outer].GetSize(); middle++) {
       strm << setw(indent+4) << " " << middle << ":\n";
-      for (PINDEX inner = 0; inner < m_set[outer][middle].GetSize(); inner++)
-        strm << setw(indent+6) << " " << m_set[outer][middle][inner] << '\n';
+      for (PINDEX inner = 0; inner < m_body->m_set[outer][middle].GetSize(); inner++)
+        strm << setw(indent+6) << " " << m_body->m_set[outer][middle][inner] << '\n';
     }
   }
 }
@@ -3089,34 +3116,45 @@ PINDEX H323Capabilities::SetCapability(PINDEX descriptorNum,
                                        H323Capability * capability,
                                        H323Capability * before)
 {
+  // Make sure we have our own table, and the capabilities passed in refer to it
+  if (m_body->m_references > 1) {
+    PINDEX capabilityIndex = m_body->m_table.GetObjectsIndex(capability);
+    PINDEX beforeIndex = before != NULL ? m_body->m_table.GetObjectsIndex(before) : P_MAX_INDEX;
+    MakeUnique();
+    if (capabilityIndex != P_MAX_INDEX)
+      capability = &m_body->m_table[capabilityIndex];
+    if (beforeIndex != P_MAX_INDEX)
+      before = &m_body->m_table[beforeIndex];
+  }
+
   // Make sure capability has been added to table.
   Add(capability);
 
   bool newDescriptor = descriptorNum == P_MAX_INDEX;
   if (newDescriptor)
-    descriptorNum = m_set.GetSize();
+    descriptorNum = m_body->m_set.GetSize();
 
   // Make sure the outer array is big enough
-  m_set.SetMinSize(descriptorNum+1);
+  m_body->m_set.SetMinSize(descriptorNum+1);
 
   // Set to unique value
-  m_set[descriptorNum].m_capabilityDescriptorNumber = 1;
+  m_body->m_set[descriptorNum].m_capabilityDescriptorNumber = 1;
   for (PINDEX i = 0; i < descriptorNum; ++i) {
-    if (m_set[i].m_capabilityDescriptorNumber >= m_set[descriptorNum].m_capabilityDescriptorNumber)
-      m_set[descriptorNum].m_capabilityDescriptorNumber = m_set[i].m_capabilityDescriptorNumber+1;
+    if (m_body->m_set[i].m_capabilityDescriptorNumber >= m_body->m_set[descriptorNum].m_capabilityDescriptorNumber)
+      m_body->m_set[descriptorNum].m_capabilityDescriptorNumber = m_body->m_set[i].m_capabilityDescriptorNumber+1;
   }
 
   if (simultaneousNum == P_MAX_INDEX)
-    simultaneousNum = m_set[descriptorNum].GetSize();
+    simultaneousNum = m_body->m_set[descriptorNum].GetSize();
 
   // Make sure the middle array is big enough
-  m_set[descriptorNum].SetMinSize(simultaneousNum+1);
+  m_body->m_set[descriptorNum].SetMinSize(simultaneousNum+1);
 
   // Now we can put the new entry in.
   if (before != NULL)
-    m_set[descriptorNum][simultaneousNum].Insert(*before, capability);
+    m_body->m_set[descriptorNum][simultaneousNum].Insert(*before, capability);
   else
-    m_set[descriptorNum][simultaneousNum].Append(capability);
+    m_body->m_set[descriptorNum][simultaneousNum].Append(capability);
   return newDescriptor ? descriptorNum : simultaneousNum;
 }
 
@@ -3158,7 +3196,8 @@ PINDEX H323Capabilities::AddMediaFormat(PINDEX descriptorNum,
 
   capability->SetCapabilityDirection(direction);
   capability->GetWritableMediaFormat() = mediaFormat;
-  m_mediaPacketizations.Union(mediaFormat.GetMediaPacketizationSet());
+  MakeUnique();
+  m_body->m_mediaPacketizations.Union(mediaFormat.GetMediaPacketizationSet());
 
   return SetCapability(descriptorNum, simultaneous, capability);
 }
@@ -3199,7 +3238,7 @@ PINDEX H323Capabilities::AddAllCapabilities(PINDEX descriptorNum,
 }
 
 
-static unsigned MergeCapabilityNumber(const H323CapabilitiesList & table,
+static unsigned MergeCapabilityNumber(const std::map<unsigned, H323Capability *> & index,
                                       unsigned newCapabilityNumber)
 {
   // Assign a unique number to the codec, check if the user wants a specific
@@ -3207,29 +3246,158 @@ static unsigned MergeCapabilityNumber(const H323CapabilitiesList & table,
   if (newCapabilityNumber == 0)
     newCapabilityNumber = 1;
 
-  PINDEX i = 0;
-  while (i < table.GetSize()) {
-    if (table[i].GetCapabilityNumber() != newCapabilityNumber)
-      i++;
-    else {
-      // If it already in use, increment it
-      newCapabilityNumber++;
-      i = 0;
+  // If it already in use, increment it
+  while (index.find(newCapabilityNumber) != index.end())
+    newCapabilityNumber++;
+
+  return newCapabilityNumber;
+}
+
+
+H323SharedCapabilities::H323SharedCapabilities()
+  : m_references(1)
+{
+}
+
+
+H323SharedCapabilities::H323SharedCapabilities(const H323SharedCapabilities & other)
+  : m_references(1)
+  , m_mediaPacketizations(other.m_mediaPacketizations)
+{
+  m_mediaPacketizations.MakeUnique();
+
+  std::map<const H323Capability *, H323Capability *> clones;
+  for (PINDEX i = 0; i < other.m_table.GetSize(); i++) {
+    H323Capability * capability = other.m_table[i].CloneAs<H323Capability>();
+    clones[&other.m_table[i]] = capability;
+    Append(capability);
+  }
+
+  PINDEX outerSize = other.m_set.GetSize();
+  m_set.SetSize(outerSize);
+  for (PINDEX outer = 0; outer < outerSize; outer++) {
+    PINDEX middleSize = other.m_set[outer].GetSize();
+    m_set[outer].m_capabilityDescriptorNumber = other.m_set[outer].m_capabilityDescriptorNumber;
+    m_set[outer].SetSize(middleSize);
+    for (PINDEX middle = 0; middle < middleSize; middle++) {
+      for (PINDEX inner = 0; inner < other.m_set[outer][middle].GetSize(); inner++)
+        m_set[outer][middle].Append(clones[&other.m_set[outer][middle][inner]]);
     }
   }
+}
 
-  return newCapabilityNumber;
+
+void H323SharedCapabilities::Append(H323Capability * capability)
+{
+  capability->m_owner = this;
+  m_table.Append(capability);
+  m_numberIndex.insert(NumberIndex::value_type(capability->GetCapabilityNumber(), capability));
+  m_nameIndex.insert(NameIndex::value_type(capability->GetFormatName(), capability));
+}
+
+
+void H323SharedCapabilities::RemoveFromIndex(H323Capability * capability)
+{
+  std::pair<NameIndex::iterator, NameIndex::iterator> range = m_nameIndex.equal_range(capability->GetFormatName());
+  for (NameIndex::iterator it = range.first; it != range.second; ++it) {
+    if (it->second == capability) {
+      m_nameIndex.erase(it);
+      break;
+    }
+  }
+
+  RemoveFromNumberIndex(capability);
+}
+
+
+void H323SharedCapabilities::RemoveFromNumberIndex(H323Capability * capability)
+{
+  unsigned capabilityNumber = capability->GetCapabilityNumber();
+  NumberIndex::iterator it = m_numberIndex.find(capabilityNumber);
+  if (it == m_numberIndex.end() || it->second != capability)
+    return;
+
+  m_numberIndex.erase(it);
+
+  // A remote may have used a number twice, the next one in the table takes over
+  for (PINDEX i = 0; i < m_table.GetSize(); i++) {
+    if (&m_table[i] != capability && m_table[i].GetCapabilityNumber() == capabilityNumber) {
+      m_numberIndex[capabilityNumber] = &m_table[i];
+      break;
+    }
+  }
+}
+
+
+void H323SharedCapabilities::Renumber(H323Capability & capability, unsigned capabilityNumber)
+{
+  if (capability.assignedCapabilityNumber == capabilityNumber)
+    return;
+
+  RemoveFromNumberIndex(&capability);
+  capability.assignedCapabilityNumber = capabilityNumber;
+
+  // Keep the first in table order for a number used twice, as for a linear search
+  NumberIndex::iterator it = m_numberIndex.find(capabilityNumber);
+  if (it == m_numberIndex.end())
+    m_numberIndex.insert(NumberIndex::value_type(capabilityNumber, &capability));
+  else if (m_table.GetObjectsIndex(&capability) < m_table.GetObjectsIndex(it->second))
+    it->second = &capability;
+}
+
+
+void H323SharedCapabilities::RebuildIndex()
+{
+  m_numberIndex.clear();
+  m_nameIndex.clear();
+
+  for (PINDEX i = 0; i < m_table.GetSize(); i++) {
+    H323Capability & capability = m_table[i];
+    m_numberIndex.insert(NumberIndex::value_type(capability.GetCapabilityNumber(), &capability));
+    m_nameIndex.insert(NameIndex::value_type(capability.GetFormatName(), &capability));
+  }
+}
+
+
+void H323Capabilities::MakeUnique()
+{
+  if (m_body->m_references <= 1)
+    return;
+
+  H323SharedCapabilities * body = new H323SharedCapabilities(*m_body);
+  ReleaseBody();
+  m_body = body;
+}
+
+
+H323Capability * H323Capabilities::MakeUnique(H323Capability * capability)
+{
+  if (m_body->m_references <= 1)
+    return capability;
+
+  // Find the same entry in our own copy of the table
+  PINDEX index = m_body->m_table.GetObjectsIndex(capability);
+  MakeUnique();
+  return index != P_MAX_INDEX ? &m_body->m_table[index] : capability;
+}
+
+
+void H323Capabilities::ReleaseBody()
+{
+  if (--m_body->m_references == 0)
+    delete m_body;
 }
 
 
 void H323Capabilities::Add(H323Capability * capability)
 {
   // See if already added, confuses things if you add the same instance twice
-  if (m_table.GetObjectsIndex(capability) != P_MAX_INDEX)
+  if (m_body->m_table.GetObjectsIndex(capability) != P_MAX_INDEX)
     return;
 
-  capability->SetCapabilityNumber(MergeCapabilityNumber(m_table, 1));
-  m_table.Append(capability);
+  MakeUnique();
+  capability->assignedCapabilityNumber = MergeCapabilityNumber(m_body->m_numberIndex, 1);
+  m_body->Append(capability);
 
   PTRACE_CONTEXT_ID_TO(capability);
 
@@ -3239,9 +3407,11 @@ void H323Capabilities::Add(H323Capability * capability)
 
 H323Capability * H323Capabilities::Copy(const H323Capability & capability)
 {
+  MakeUnique();
+
   H323Capability * newCapability = (H323Capability *)capability.Clone();
-  newCapability->SetCapabilityNumber(MergeCapabilityNumber(m_table, capability.GetCapabilityNumber()));
-  m_table.Append(newCapability);
+  newCapability->assignedCapabilityNumber = MergeCapabilityNumber(m_body->m_numberIndex, capability.GetCapabilityNumber());
+  m_body->Append(newCapability);
 
   PTRACE(4, "H323\tAdded capability: " << *newCapability);
   return newCapability;
@@ -3253,30 +3423,33 @@ void H323Capabilities::Remove(H323Capability * capability)
   if (capability == NULL)
     return;
 
+  capability = MakeUnique(capability);
+
   PTRACE(4, "H323\tRemoving capability: " << *capability);
 
   unsigned capabilityNumber = capability->GetCapabilityNumber();
 
-  for (PINDEX outer = 0; outer < m_set.GetSize(); ) {
-    for (PINDEX middle = 0; middle < m_set[outer].GetSize(); ) {
-      for (PINDEX inner = 0; inner < m_set[outer][middle].GetSize(); inner++) {
-        if (m_set[outer][middle][inner].GetCapabilityNumber() == capabilityNumber) {
-          m_set[outer][middle].RemoveAt(inner);
+  for (PINDEX outer = 0; outer < m_body->m_set.GetSize(); ) {
+    for (PINDEX middle = 0; middle < m_body->m_set[outer].GetSize(); ) {
+      for (PINDEX inner = 0; inner < m_body->m_set[outer][middle].GetSize(); inner++) {
+        if (m_body->m_set[outer][middle][inner].GetCapabilityNumber() == capabilityNumber) {
+          m_body->m_set[outer][middle].RemoveAt(inner);
           break;
         }
       }
-      if (m_set[outer][middle].GetSize() == 0)
-        m_set[outer].RemoveAt(middle);
+      if (m_body->m_set[outer][middle].GetSize() == 0)
+        m_body->m_set[outer].RemoveAt(middle);
       else
         middle++;
     }
-    if (m_set[outer].GetSize() == 0)
-      m_set.RemoveAt(outer);
+    if (m_body->m_set[outer].GetSize() == 0)
+      m_body->m_set.RemoveAt(outer);
     else
       outer++;
   }
 
-  m_table.Remove(capability);
+  m_body->RemoveFromIndex(capability);
+  m_body->m_table.Remove(capability);
 }
 
 
@@ -3299,18 +3472,29 @@ void H323Capabilities::Remove(const PStringArray & codecNames)
 
 void H323Capabilities::RemoveAll()
 {
-  m_table.RemoveAll();
-  m_set.RemoveAll();
+  if (m_body->m_references > 1) {
+    // Copies sharing the table keep it, we just start a new empty one
+    H323SharedCapabilities * body = new H323SharedCapabilities;
+    body->m_mediaPacketizations = m_body->m_mediaPacketizations;
+    body->m_mediaPacketizations.MakeUnique();
+    ReleaseBody();
+    m_body = body;
+    return;
+  }
+
+  m_body->m_table.RemoveAll();
+  m_body->m_set.RemoveAll();
+  m_body->m_numberIndex.clear();
+  m_body->m_nameIndex.clear();
 }
 
 
 H323Capability * H323Capabilities::FindCapability(unsigned capabilityNumber) const
 {
-  for (PINDEX i = 0; i < m_table.GetSize(); i++) {
-    if (m_table[i].GetCapabilityNumber() == capabilityNumber) {
-      PTRACE(4, "H323\tFound capability: " << m_table[i]);
-      return &m_table[i];
-    }
+  H323SharedCapabilities::NumberIndex::const_iterator it = m_body->m_numberIndex.find(capabilityNumber);
+  if (it != m_body->m_numberIndex.end()) {
+    PTRACE(4, "H323\tFound capability: " << *it->second);
+    return it->second;
   }
 
   PTRACE(4, "H323\tCould not find capability: " << capabilityNumber);
@@ -3322,14 +3506,24 @@ H323Capability * H323Capabilities::FindCapability(const PString & formatName,
                                                   H323Capability::CapabilityDirection direction,
                                                   PBoolean exact) const
 {
-  PStringArray wildcard = formatName.Tokenise('*', false);
-
-  for (PINDEX i = 0; i < m_table.GetSize(); i++) {
-    PCaselessString str = m_table[i].GetFormatName();
-    if ((exact ? (str == formatName) : MatchWildcard(str, wildcard)) &&
-              (direction == H323Capability::e_Unknown || m_table[i].GetCapabilityDirection() == direction)) {
-      PTRACE(4, "H323\tFound capability: " << m_table[i]);
-      return &m_table[i];
+  if (exact) {
+    std::pair<H323SharedCapabilities::NameIndex::const_iterator, H323SharedCapabilities::NameIndex::const_iterator> range = m_body->m_nameIndex.equal_range(formatName);
+    for (H323SharedCapabilities::NameIndex::const_iterator it = range.first; it != range.second; ++it) {
+      if (direction == H323Capability::e_Unknown || it->second->GetCapabilityDirection() == direction) {
+        PTRACE(4, "H323\tFound capability: " << *it->second);
+        return it->second;
+      }
+    }
+  }
+  else {
+    PStringArray wildcard = formatName.Tokenise('*', false);
+    for (PINDEX i = 0; i < m_body->m_table.GetSize(); i++) {
+      PCaselessString str = m_body->m_table[i].GetFormatName();
+      if (MatchWildcard(str, wildcard) &&
+                (direction == H323Capability::e_Unknown || m_body->m_table[i].GetCapabilityDirection() == direction)) {
+        PTRACE(4, "H323\tFound capability: " << m_body->m_table[i]);
+        return &m_body->m_table[i];
+      }
     }
   }
 
@@ -3341,10 +3535,10 @@ H323Capability * H323Capabilities::FindCapability(const PString & formatName,
 H323Capability * H323Capabilities::FindCapability(
                               H323Capability::CapabilityDirection direction) const
 {
-  for (PINDEX i = 0; i < m_table.GetSize(); i++) {
-    if (m_table[i].GetCapabilityDirection() == direction) {
-      PTRACE(4, "H323\tFound capability: " << m_table[i]);
-      return &m_table[i];
+  for (PINDEX i = 0; i < m_body->m_table.GetSize(); i++) {
+    if (m_body->m_table[i].GetCapabilityDirection() == direction) {
+      PTRACE(4, "H323\tFound capability: " << m_body->m_table[i]);
+      return &m_body->m_table[i];
     }
   }
 
@@ -3356,10 +3550,10 @@ H323Capability * H323Capabilities::FindCapability(
 H323Capability * H323Capabilities::FindCapability(const H323Capability & capability) const
 {
 
-  for (PINDEX i = 0; i < m_table.GetSize(); i++) {
-    if (m_table[i] == capability) {
-      PTRACE(4, "H323\tFound capability: " << m_table[i]);
-      return &m_table[i];
+  for (PINDEX i = 0; i < m_body->m_table.GetSize(); i++) {
+    if (m_body->m_table[i] == capability) {
+      PTRACE(4, "H323\tFound capability: " << m_body->m_table[i]);
+      return &m_body->m_table[i];
     }
   }
 
@@ -3370,13 +3564,20 @@ H323Capability * H323Capabilities::FindCapability(const H323Capability & capabil
 
 H323Capability * H323Capabilities::FindCapability(const H245_Capability & cap) const
 {
-  for (PINDEX i = 0; i < m_table.GetSize(); i++) {
-    H323Capability & capability = m_table[i];
+  return FindMatchingCapability(cap, m_body->m_mediaPacketizations);
+}
 
-    for (PINDEX j = 0; j <= m_mediaPacketizations.GetSize(); ++j) {
+
+H323Capability * H323Capabilities::FindMatchingCapability(const H245_Capability & cap,
+                                                          const PStringSet & mediaPacketizations) const
+{
+  for (PINDEX i = 0; i < m_body->m_table.GetSize(); i++) {
+    H323Capability & capability = m_body->m_table[i];
+
+    for (PINDEX j = 0; j <= mediaPacketizations.GetSize(); ++j) {
       PString mediaPacketization;
-      if (j < m_mediaPacketizations.GetSize())
-        mediaPacketization = m_mediaPacketizations.GetKeyAt(j);
+      if (j < mediaPacketizations.GetSize())
+        mediaPacketization = mediaPacketizations.GetKeyAt(j);
 
       switch (cap.GetTag()) {
         case H245_Capability::e_receiveAudioCapability :
@@ -3610,8 +3811,8 @@ H323Capability * H323Capabilities::FindCapability(const H245_ModeElement & modeE
 {
   PTRACE(4, "H323\tFindCapability: " << modeElement.m_type.GetTagName());
 
-  for (PINDEX i = 0; i < m_table.GetSize(); i++) {
-    H323Capability & capability = m_table[i];
+  for (PINDEX i = 0; i < m_body->m_table.GetSize(); i++) {
+    H323Capability & capability = m_body->m_table[i];
     switch (modeElement.m_type.GetTag()) {
       case H245_ModeElementType::e_audioMode :
         if (capability.GetMainType() == H323Capability::e_Audio) {
@@ -3672,8 +3873,8 @@ H323Capability * H323Capabilities::FindCapability(const H245_ModeElement & modeE
 H323Capability * H323Capabilities::FindCapability(H323Capability::MainTypes mainType,
                                                   unsigned subType) const
 {
-  for (PINDEX i = 0; i < m_table.GetSize(); i++) {
-    H323Capability & capability = m_table[i];
+  for (PINDEX i = 0; i < m_body->m_table.GetSize(); i++) {
+    H323Capability & capability = m_body->m_table[i];
     if (capability.GetMainType() == mainType &&
                         (subType == UINT_MAX || capability.GetSubType() == subType)) {
       PTRACE(4, "H323\tFound capability: " << capability);
@@ -3685,12 +3886,73 @@ H323Capability * H323Capabilities::FindCapability(H323Capability::MainTypes main
   return NULL;
 }
 
+/* The non-const lookups return a capability the caller may modify, so make
+   sure it is not one shared with a copy of this table. */
+
+H323Capability * H323Capabilities::FindCapability(unsigned capabilityNumber)
+{
+  MakeUnique();
+  return GetConstThis().FindCapability(capabilityNumber);
+}
+
+
+H323Capability * H323Capabilities::FindCapability(const PString & formatName,
+                                                  H323Capability::CapabilityDirection direction,
+                                                  PBoolean exact)
+{
+  MakeUnique();
+  return GetConstThis().FindCapability(formatName, direction, exact);
+}
+
+
+H323Capability * H323Capabilities::FindCapability(H323Capability::CapabilityDirection direction)
+{
+  MakeUnique();
+  return GetConstThis().FindCapability(direction);
+}
+
+
+H323Capability * H323Capabilities::FindCapability(const H323Capability & capability)
+{
+  MakeUnique();
+  return GetConstThis().FindCapability(capability);
+}
+
+
+H323Capability * H323Capabilities::FindCapability(const H245_Capability & cap)
+{
+  MakeUnique();
+  return GetConstThis().FindCapability(cap);
+}
+
+
+H323Capability * H323Capabilities::FindCapability(const H245_DataType & dataType, const PString & mediaPacketization)
+{
+  MakeUnique();
+  return GetConstThis().FindCapability(dataType, mediaPacketization);
+}
+
+
+H323Capability * H323Capabilities::FindCapability(const H245_ModeElement & modeElement, const PString & mediaPacketization)
+{
+  MakeUnique();
+  return GetConstThis().FindCapability(modeElement, mediaPacketization);
+}
+
+
+H323Capability * H323Capabilities::FindCapability(H323Capability::MainTypes mainType, unsigned subType)
+{
+  MakeUnique();
+  return GetConstThis().FindCapability(mainType, subType);
+}
+
+
 
 void H323Capabilities::BuildPDU(const H323Connection & connection,
                                 H245_TerminalCapabilitySet & pdu) const
 {
-  PINDEX tableSize = m_table.GetSize();
-  PINDEX setSize = m_set.GetSize();
+  PINDEX tableSize = m_body->m_table.GetSize();
+  PINDEX setSize = m_body->m_set.GetSize();
   PAssert((tableSize > 0) == (setSize > 0), PLogicError);
   if (tableSize == 0 || setSize == 0)
     return;
@@ -3705,7 +3967,7 @@ void H323Capabilities::BuildPDU(const H323Connection & connection,
   PINDEX count = 0;
   PINDEX i;
   for (i = 0; i < tableSize; i++) {
-    H323Capability & capability = m_table[i];
+    H323Capability & capability = m_body->m_table[i];
     if (capability.IsUsable(connection)) {
       pdu.m_capabilityTable.SetSize(count+1);
       H245_CapabilityTableEntry & entry = pdu.m_capabilityTable[count++];
@@ -3729,17 +3991,17 @@ void H323Capabilities::BuildPDU(const H323Connection & connection,
   pdu.m_capabilityDescriptors.SetSize(setSize);
   for (PINDEX outer = 0; outer < setSize; outer++) {
     H245_CapabilityDescriptor & desc = pdu.m_capabilityDescriptors[outer];
-    desc.m_capabilityDescriptorNumber = m_set[outer].m_capabilityDescriptorNumber;
+    desc.m_capabilityDescriptorNumber = m_body->m_set[outer].m_capabilityDescriptorNumber;
     desc.IncludeOptionalField(H245_CapabilityDescriptor::e_simultaneousCapabilities);
-    PINDEX middleSize = m_set[outer].GetSize();
+    PINDEX middleSize = m_body->m_set[outer].GetSize();
     desc.m_simultaneousCapabilities.SetSize(middleSize);
     for (PINDEX middle = 0; middle < middleSize; middle++) {
       H245_AlternativeCapabilitySet & alt = desc.m_simultaneousCapabilities[middle];
-      PINDEX innerSize = m_set[outer][middle].GetSize();
+      PINDEX innerSize = m_body->m_set[outer][middle].GetSize();
       alt.SetSize(innerSize);
       count = 0;
       for (PINDEX inner = 0; inner < innerSize; inner++) {
-        H323Capability & capability = m_set[outer][middle][inner];
+        H323Capability & capability = m_body->m_set[outer][middle][inner];
         if (capability.IsUsable(connection)) {
           alt.SetSize(count+1);
           alt[count++] = capability.GetCapabilityNumber();
@@ -3752,51 +4014,60 @@ void H323Capabilities::BuildPDU(const H323Connection & connection,
 
 PBoolean H323Capabilities::Merge(const H323Capabilities & newCaps)
 {
-  PTRACE_IF(4, !m_table.IsEmpty(), "H323\tCapability merge of:\n" << newCaps << "\nInto:\n" << *this);
+  /* Merging into an empty table gives the same capabilities and numbers as
+     the new table, so share it instead of cloning every capability. */
+  if (m_body->m_table.IsEmpty() && m_body->m_set.IsEmpty()) {
+    operator=(newCaps);
+    return !m_body->m_table.IsEmpty();
+  }
+
+  MakeUnique();
+
+  PTRACE_IF(4, !m_body->m_table.IsEmpty(), "H323\tCapability merge of:\n" << newCaps << "\nInto:\n" << *this);
 
   // Remove any descriptors we already have, then add them back in.
-  for (PINDEX newDesc = 0; newDesc < newCaps.m_set.GetSize(); ++newDesc) {
-    for (PINDEX oldDesc = 0; oldDesc < m_set.GetSize(); ++oldDesc) {
-      if (newCaps.m_set[newDesc].m_capabilityDescriptorNumber == m_set[oldDesc].m_capabilityDescriptorNumber) {
-        m_set.RemoveAt(oldDesc);
+  for (PINDEX newDesc = 0; newDesc < newCaps.m_body->m_set.GetSize(); ++newDesc) {
+    for (PINDEX oldDesc = 0; oldDesc < m_body->m_set.GetSize(); ++oldDesc) {
+      if (newCaps.m_body->m_set[newDesc].m_capabilityDescriptorNumber == m_body->m_set[oldDesc].m_capabilityDescriptorNumber) {
+        m_body->m_set.RemoveAt(oldDesc);
         break;
       }
     }
   }
 
   // Remove any capabilities from old set that are in the new set, then add them back in.
-  for (PINDEX newCap = 0; newCap < newCaps.m_table.GetSize(); ++newCap) {
-    for (PINDEX oldCap = 0; oldCap < m_table.GetSize(); ++oldCap) {
-      if (newCaps.m_table[newCap].assignedCapabilityNumber == m_table[oldCap].assignedCapabilityNumber) {
-        Remove(&m_table[oldCap]);
+  for (PINDEX newCap = 0; newCap < newCaps.m_body->m_table.GetSize(); ++newCap) {
+    for (PINDEX oldCap = 0; oldCap < m_body->m_table.GetSize(); ++oldCap) {
+      if (newCaps.m_body->m_table[newCap].assignedCapabilityNumber == m_body->m_table[oldCap].assignedCapabilityNumber) {
+        Remove(&m_body->m_table[oldCap]);
         break;
       }
     }
   }
 
   // Add any new and replacement capabilities.
-  for (PINDEX i = 0; i < newCaps.m_table.GetSize(); i++)
-    Copy(newCaps.m_table[i]);
+  for (PINDEX i = 0; i < newCaps.m_body->m_table.GetSize(); i++)
+    Copy(newCaps.m_body->m_table[i]);
 
   // Add any new and replacement descriptors.
-  PINDEX outerSize = newCaps.m_set.GetSize();
-  PINDEX outerBase = m_set.GetSize();
-  m_set.SetSize(outerBase+outerSize);
+  PINDEX outerSize = newCaps.m_body->m_set.GetSize();
+  PINDEX outerBase = m_body->m_set.GetSize();
+  m_body->m_set.SetSize(outerBase+outerSize);
   for (PINDEX outer = 0; outer < outerSize; outer++) {
-    PINDEX middleSize = newCaps.m_set[outer].GetSize();
-    m_set[outerBase+outer].m_capabilityDescriptorNumber = newCaps.m_set[outer].m_capabilityDescriptorNumber;
-    m_set[outerBase+outer].SetSize(middleSize);
+    PINDEX middleSize = newCaps.m_body->m_set[outer].GetSize();
+    m_body->m_set[outerBase+outer].m_capabilityDescriptorNumber = newCaps.m_body->m_set[outer].m_capabilityDescriptorNumber;
+    m_body->m_set[outerBase+outer].SetSize(middleSize);
     for (PINDEX middle = 0; middle < middleSize; middle++) {
-      PINDEX innerSize = newCaps.m_set[outer][middle].GetSize();
+      PINDEX innerSize = newCaps.m_body->m_set[outer][middle].GetSize();
       for (PINDEX inner = 0; inner < innerSize; inner++) {
-        H323Capability * cap = FindCapability(newCaps.m_set[outer][middle][inner].GetCapabilityNumber());
+        H323Capability * cap = FindCapability(newCaps.m_body->m_set[outer][middle][inner].GetCapabilityNumber());
         if (cap != NULL)
-          m_set[outerBase+outer][middle].Append(cap);
+          m_body->m_set[outerBase+outer][middle].Append(cap);
       }
     }
   }
 
-  return !m_table.IsEmpty();
+  return !m_body->m_table.IsEmpty();
 }
 
 
@@ -3805,29 +4076,34 @@ void H323Capabilities::Reorder(const PStringArray & preferenceOrder)
   if (preferenceOrder.IsEmpty())
     return;
 
-  m_table.DisallowDeleteObjects();
+  MakeUnique();
+
+  m_body->m_table.DisallowDeleteObjects();
 
   PINDEX preference = 0;
   PINDEX base = 0;
 
   for (preference = 0; preference < preferenceOrder.GetSize(); preference++) {
     PStringArray wildcard = preferenceOrder[preference].Tokenise('*', false);
-    for (PINDEX idx = base; idx < m_table.GetSize(); idx++) {
-      PCaselessString str = m_table[idx].GetFormatName();
+    for (PINDEX idx = base; idx < m_body->m_table.GetSize(); idx++) {
+      PCaselessString str = m_body->m_table[idx].GetFormatName();
       if (MatchWildcard(str, wildcard)) {
         if (idx != base)
-          m_table.InsertAt(base, m_table.RemoveAt(idx));
+          m_body->m_table.InsertAt(base, m_body->m_table.RemoveAt(idx));
         base++;
       }
     }
   }
 
-  for (PINDEX outer = 0; outer < m_set.GetSize(); outer++) {
-    for (PINDEX middle = 0; middle < m_set[outer].GetSize(); middle++) {
-      H323CapabilitiesList & list = m_set[outer][middle];
-      for (PINDEX idx = 0; idx < m_table.GetSize(); idx++) {
+  // Duplicate numbers or names must now resolve to the earliest in the new order
+  m_body->RebuildIndex();
+
+  for (PINDEX outer = 0; outer < m_body->m_set.GetSize(); outer++) {
+    for (PINDEX middle = 0; middle < m_body->m_set[outer].GetSize(); middle++) {
+      H323CapabilitiesList & list = m_body->m_set[outer][middle];
+      for (PINDEX idx = 0; idx < m_body->m_table.GetSize(); idx++) {
         for (PINDEX inner = 0; inner < list.GetSize(); inner++) {
-          if (&m_table[idx] == &list[inner]) {
+          if (&m_body->m_table[idx] == &list[inner]) {
             list.Append(list.RemoveAt(inner));
             break;
           }
@@ -3836,7 +4112,7 @@ void H323Capabilities::Reorder(const PStringArray & preferenceOrder)
     }
   }
 
-  m_table.AllowDeleteObjects();
+  m_body->m_table.AllowDeleteObjects();
 }
 
 
@@ -3849,13 +4125,13 @@ PBoolean H323Capabilities::IsAllowed(const H323Capability & capability)
 PBoolean H323Capabilities::IsAllowed(const unsigned a_capno)
 {
   // Check that capno is actually in the set
-  PINDEX outerSize = m_set.GetSize();
+  PINDEX outerSize = m_body->m_set.GetSize();
   for (PINDEX outer = 0; outer < outerSize; outer++) {
-    PINDEX middleSize = m_set[outer].GetSize();
+    PINDEX middleSize = m_body->m_set[outer].GetSize();
     for (PINDEX middle = 0; middle < middleSize; middle++) {
-      PINDEX innerSize = m_set[outer][middle].GetSize();
+      PINDEX innerSize = m_body->m_set[outer][middle].GetSize();
       for (PINDEX inner = 0; inner < innerSize; inner++) {
-        if (a_capno == m_set[outer][middle][inner].GetCapabilityNumber()) {
+        if (a_capno == m_body->m_set[outer][middle][inner].GetCapabilityNumber()) {
           return true;
         }
       }
@@ -3880,19 +4156,19 @@ PBoolean H323Capabilities::IsAllowed(const unsigned a_capno1, const unsigned a_c
     return true;
   }
 
-  PINDEX outerSize = m_set.GetSize();
+  PINDEX outerSize = m_body->m_set.GetSize();
   for (PINDEX outer = 0; outer < outerSize; outer++) {
-    PINDEX middleSize = m_set[outer].GetSize();
+    PINDEX middleSize = m_body->m_set[outer].GetSize();
     for (PINDEX middle = 0; middle < middleSize; middle++) {
-      PINDEX innerSize = m_set[outer][middle].GetSize();
+      PINDEX innerSize = m_body->m_set[outer][middle].GetSize();
       for (PINDEX inner = 0; inner < innerSize; inner++) {
-        if (a_capno1 == m_set[outer][middle][inner].GetCapabilityNumber()) {
+        if (a_capno1 == m_body->m_set[outer][middle][inner].GetCapabilityNumber()) {
           /* Now go searching for the other half... */
           for (PINDEX middle2 = 0; middle2 < middleSize; ++middle2) {
             if (middle != middle2) {
-              PINDEX innerSize2 = m_set[outer][middle2].GetSize();
+              PINDEX innerSize2 = m_body->m_set[outer][middle2].GetSize();
               for (PINDEX inner2 = 0; inner2 < innerSize2; ++inner2) {
-                if (a_capno2 == m_set[outer][middle2][inner2].GetCapabilityNumber()) {
+                if (a_capno2 == m_body->m_set[outer][middle2][inner2].GetCapabilityNumber()) {
                   return true;
                 }
               }
@@ -3906,12 +4182,81 @@ PBoolean H323Capabilities::IsAllowed(const unsigned a_capno1, const unsigned a_c
 }
 
 
+static bool IsIdenticalCapability(const H323Capability & cap1, const H323Capability & cap2)
+{
+  if (strcmp(cap1.GetClass(), cap2.GetClass()) != 0 ||
+      cap1.GetCapabilityNumber() != cap2.GetCapabilityNumber() ||
+      cap1.GetCapabilityDirection() != cap2.GetCapabilityDirection() ||
+      cap1.Compare(cap2) != PObject::EqualTo)
+    return false;
+
+  OpalMediaFormat format1 = cap1.GetMediaFormat();
+  OpalMediaFormat format2 = cap2.GetMediaFormat();
+  if (format1 != format2 || format1.GetPayloadType() != format2.GetPayloadType())
+    return false;
+
+  PStringToString options1 = format1.GetOptions();
+  PStringToString options2 = format2.GetOptions();
+  if (options1.GetSize() != options2.GetSize())
+    return false;
+
+  for (PStringToString::const_iterator it = options1.begin(); it != options1.end(); ++it) {
+    const PString * value = options2.GetAt(it->first);
+    if (value == NULL || *value != it->second)
+      return false;
+  }
+
+  return true;
+}
+
+
+bool H323Capabilities::IsIdentical(const H323Capabilities & other) const
+{
+  if (m_body == other.m_body)
+    return true;
+
+  const H323SharedCapabilities & body1 = *m_body;
+  const H323SharedCapabilities & body2 = *other.m_body;
+
+  if (body1.m_table.GetSize() != body2.m_table.GetSize() ||
+      body1.m_set.GetSize() != body2.m_set.GetSize() ||
+      body1.m_mediaPacketizations.GetSize() != body2.m_mediaPacketizations.GetSize())
+    return false;
+
+  for (PStringSet::const_iterator it = body1.m_mediaPacketizations.begin(); it != body1.m_mediaPacketizations.end(); ++it) {
+    if (!body2.m_mediaPacketizations.Contains(*it))
+      return false;
+  }
+
+  for (PINDEX i = 0; i < body1.m_table.GetSize(); i++) {
+    if (!IsIdenticalCapability(body1.m_table[i], body2.m_table[i]))
+      return false;
+  }
+
+  for (PINDEX outer = 0; outer < body1.m_set.GetSize(); outer++) {
+    if (body1.m_set[outer].m_capabilityDescriptorNumber != body2.m_set[outer].m_capabilityDescriptorNumber ||
+        body1.m_set[outer].GetSize() != body2.m_set[outer].GetSize())
+      return false;
+    for (PINDEX middle = 0; middle < body1.m_set[outer].GetSize(); middle++) {
+      if (body1.m_set[outer][middle].GetSize() != body2.m_set[outer][middle].GetSize())
+        return false;
+      for (PINDEX inner = 0; inner < body1.m_set[outer][middle].GetSize(); inner++) {
+        if (body1.m_set[outer][middle][inner].GetCapabilityNumber() != body2.m_set[outer][middle][inner].GetCapabilityNumber())
+          return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+
 OpalMediaFormatList H323Capabilities::GetMediaFormats() const
 {
   OpalMediaFormatList formats;
 
-  for (PINDEX i = 0; i < m_table.GetSize(); i++) {
-    OpalMediaFormat fmt = m_table[i].GetMediaFormat();
+  for (PINDEX i = 0; i < m_body->m_table.GetSize(); i++) {
+    OpalMediaFormat fmt = m_body->m_table[i].GetMediaFormat();
 #if 0 // Yep, proved unworkable!
     OpalMediaFormatList::const_iterator it = formats.FindFormat(fmt);
     if (it != formats.end()) {
@@ -3926,11 +4271,11 @@ OpalMediaFormatList H323Capabilities::GetMediaFormats() const
   }
 
   // Reorder to first entry, really should be selected entry, but we don't have that
-  if (!m_set.IsEmpty()) {
+  if (!m_body->m_set.IsEmpty()) {
     PStringArray order;
-    for (PINDEX middle = 0;  middle < m_set[0].GetSize(); ++middle) {
-      for (PINDEX inner = 0; inner < m_set[0][middle].GetSize(); ++inner) {
-        PString name = m_set[0][middle][inner].GetMediaFormat().GetName();
+    for (PINDEX middle = 0;  middle < m_body->m_set[0].GetSize(); ++middle) {
+      for (PINDEX inner = 0; inner < m_body->m_set[0][middle].GetSize(); ++inner) {
+        PString name = m_body->m_set[0][middle][inner].GetMediaFormat().GetName();
         if (order.GetValuesIndex(name) == P_MAX_INDEX)
           order += name;
       }
@@ -1111,6 +1111,26 @@ void H323EndPoint::OnReceivedInitiateReturnError()
 {
 }
 
+
+void H323EndPoint::ShareLocalCapabilities(H323Capabilities & capabilities)
+{
+  static const size_t MaxSharedLocalCapabilities = 10;
+
+  PWaitAndSignal mutex(m_sharedLocalCapabilitiesMutex);
+
+  for (std::list<H323Capabilities>::iterator it = m_sharedLocalCapabilities.begin(); it != m_sharedLocalCapabilities.end(); ++it) {
+    if (it->IsIdentical(capabilities)) {
+      capabilities = *it;
+      m_sharedLocalCapabilities.splice(m_sharedLocalCapabilities.begin(), m_sharedLocalCapabilities, it);
+      return;
+    }
+  }
+
+  m_sharedLocalCapabilities.push_front(capabilities);
+  if (m_sharedLocalCapabilities.size() > MaxSharedLocalCapabilities)
+    m_sharedLocalCapabilities.pop_back();
+}
+
 PBoolean H323EndPoint::ParsePartyName(const PString & remoteParty,
                                             PString & alias,
                                H323TransportAddress & address,
@@ -120,7 +120,7 @@ void IAX2CallProcessor::AssignConnection(IAX2Connection * _con)
 
   remote.SetSourceCallNumber(newCallNumber);
   
-  Resume();
+  Activate();
 }
 
 void IAX2CallProcessor::PrintOn(ostream & strm) const
@@ -195,7 +195,7 @@ void IAX2CallProcessor::Hangup(PString dieMessage)
   PTRACE(3, "Hangup request " << dieMessage);
   hangList.AppendString(dieMessage);   //send this text to remote endpoint 
   
-  activate.Signal();
+  Activate();
 }
 
 void IAX2CallProcessor::CheckForHangupMessages()
@@ -474,6 +474,9 @@ void IAX2CallProcessor::SendSoundMessage(PBYTEArray *sound)
     TransmitFrameToRemoteEndpoint(f);
   } else {
     IAX2MiniFrame *f = new IAX2MiniFrame(this, *sound, true, thisTimeStamp & 0xffff);
+    /*Trunk frames are not encrypted, so only plain calls can go in them*/
+    if (!encryption.IsEncrypted() && endpoint.IsTrunking(remote.RemoteAddress()))
+      f->SetTrunked(true);
     TransmitFrameToRemoteEndpoint(f);
   }
   
@@ -484,14 +487,14 @@ void IAX2CallProcessor::SendDtmf(const PString & dtmfs)
 {
   PTRACE(4, "Activate the iax2 processeor, DTMF of  " << dtmfs << " to send");
   dtmfText += dtmfs;
-  activate.Signal();
+  Activate();
 }
 
 void IAX2CallProcessor::SendText(const PString & text)
 {
   PTRACE(4, "Activate the iax2 processeor, text of " << text << " to send");
   textList.AppendString(text);
-  activate.Signal();
+  Activate();
 }
 
 void IAX2CallProcessor::SendHold()
@@ -515,7 +518,7 @@ void IAX2CallProcessor::SendTransfer(
     transferCalledContext = calledContext;
   }
   
-  activate.Signal();
+  Activate();
 }
 
 
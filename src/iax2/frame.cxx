@@ -76,6 +76,7 @@ void IAX2Frame::ZeroAllValues()
   isFullFrame       = false;
   isVideo           = false;
   isAudio           = false;
+  isTrunkFrame      = false;
   
   currentReadIndex  = 0;
   currentWriteIndex = 0;
@@ -217,11 +218,24 @@ PBoolean IAX2Frame::ProcessNetworkPacket()
     remote.SetDestCallNumber(a & 0x7fff);
     return true;
   }
-  if (a == 0) {    //We have a mini frame here, of video type.
+  if (a == 0) {
+    BYTE metaCommand = 0;
+    Read1Byte(metaCommand);
+    if ((metaCommand & 0x80) == 0) {
+      /*V bit is clear, so a meta frame, of which we only know trunks */
+      if (metaCommand != MetaTrunkCommand) {
+        PTRACE(3, "Frame\tUnsupported meta command " << (unsigned)metaCommand);
+        return false;
+      }
+      isTrunkFrame = true;
+      return true;
+    }
+
+    //We have a mini frame here, of video type.
     isVideo = true;
-    PINDEX b = 0;
-    Read2Bytes(b);
-    remote.SetSourceCallNumber(b);
+    BYTE low = 0;
+    Read1Byte(low);
+    remote.SetSourceCallNumber(((metaCommand & 0x7f) << 8) | low);
     BuildConnectionToken();
     return true;
   }
@@ -230,6 +244,59 @@ PBoolean IAX2Frame::ProcessNetworkPacket()
   return true;
 }
 
+PBoolean IAX2Frame::SplitTrunkFrame(IAX2FrameList & frames)
+{
+  BYTE commandData = 0;
+  DWORD trunkTimeStamp = 0;
+  if (!Read1Byte(commandData) || !Read4Bytes(trunkTimeStamp)) {
+    PTRACE(3, "Frame\tTrunk frame too short for header " << IdString());
+    return false;
+  }
+
+  PBoolean hasTimeStamps = (commandData & MetaTrunkTimeStamps) != 0;
+  PIPSocket::Address remoteAddress = remote.RemoteAddress();
+  PINDEX entries = 0;
+
+  while (GetUnReadBytes() > 0) {
+    PINDEX length = 0;
+    PINDEX callNumber = 0;
+    PINDEX entryTimeStamp = trunkTimeStamp & 0xffff;
+
+    PBoolean ok;
+    if (hasTimeStamps)
+      ok = Read2Bytes(length) && Read2Bytes(callNumber) && Read2Bytes(entryTimeStamp);
+    else
+      ok = Read2Bytes(callNumber) && Read2Bytes(length);
+
+    if (!ok || length > GetUnReadBytes()) {
+      PTRACE(3, "Frame\tTrunk frame entry " << entries << " is truncated " << IdString());
+      return false;
+    }
+
+    /*Make it look like the mini frame would have, had it been sent alone */
+    IAX2Frame * entry = new IAX2Frame(endpoint);
+    entry->remote.SetRemoteAddress(remoteAddress);
+    entry->remote.SetRemotePort(remote.RemotePort());
+    entry->data.SetSize(length + 4);
+    entry->Write2Bytes(callNumber & 0x7fff);
+    entry->Write2Bytes(entryTimeStamp);
+    memcpy(entry->data.GetPointer() + 4, data.GetPointer() + currentReadIndex, length);
+    currentReadIndex += length;
+
+    if (callNumber == 0 || !entry->ProcessNetworkPacket()) {
+      PTRACE(3, "Frame\tTrunk frame entry " << entries << " is invalid " << IdString());
+      delete entry;
+      return false;
+    }
+
+    frames.AddNewFrame(entry);
+    ++entries;
+  }
+
+  PTRACE(6, "Frame\tSplit trunk frame " << IdString() << " into " << entries << " mini frames");
+  return true;
+}
+
 void IAX2Frame::BuildConnectionToken()
 {
   connectionToken = remote.BuildConnectionToken();
@@ -459,6 +526,7 @@ PBoolean IAX2MiniFrame::ProcessNetworkPacket()
 
 void IAX2MiniFrame::ZeroAllValues()
 {
+  isTrunked = false;
 }
 
 void IAX2MiniFrame::AlterTimeStamp(PINDEX newValue)
@@ -473,10 +541,12 @@ PBoolean IAX2MiniFrame::WriteHeader()
   if(IsVideo()) {
     data.SetSize(6);
     Write2Bytes(0);
-  } else 
+    Write2Bytes(0x8000 | (remote.SourceCallNumber() & 0x7fff)); //V bit, so not a meta frame
+  } else {
     data.SetSize(4);
+    Write2Bytes(remote.SourceCallNumber() & 0x7fff);
+  }
   
-  Write2Bytes(remote.SourceCallNumber() & 0x7fff);
   Write2Bytes(timeStamp & 0xffff);
   
   return true;
@@ -91,19 +91,36 @@ IAX2Connection::IAX2Connection(OpalCall & call,               /* Owner call for
 IAX2Connection::~IAX2Connection()
 {
   iax2Processor.Terminate();
-  iax2Processor.WaitForTermination(1000);
-  if (!iax2Processor.IsTerminated()) {
-    PAssertAlways("List rpocessor failed to terminate");
+
+  /*The final pass of the processor may still be queued on, or running in,
+    the endpoint thread pool, and it uses both the processor and this
+    connection. GarbageCollection() normally keeps us alive until it is done,
+    so this only waits when we are deleted some other way. */
+  if (iax2Processor.WaitForTermination(endpoint.GetManager().GetSignalingTimeout())) {
+    PTRACE(3, "connection has terminated");
+    delete & iax2Processor;
+  }
+  else {
+    /*The pool is stuck, leak the processor rather than block here forever,
+      or have its final pass use freed memory when it does run. */
+    PTRACE(1, "IAX2Con\tProcessor did not terminate, abandoning it");
   }
-  PTRACE(3, "connection has terminated");
 
-  delete & iax2Processor;
   delete m_jitterBuffer;
 }
 
+bool IAX2Connection::GarbageCollection()
+{
+  return iax2Processor.IsTerminated() && OpalConnection::GarbageCollection();
+}
+
 void IAX2Connection::StartOperation()
 {
   iax2Processor.AssignConnection(this);
+  if (!endpoint.GetCallTable().AddCall(GetRemoteInfo().SourceCallNumber(), this)) {
+    Release(EndedByLocalCongestion);
+    return;
+  }
 
   SetPhase(SetUpPhase);
 }
@@ -50,6 +50,8 @@
 
 IAX2EndPoint::IAX2EndPoint(OpalManager & mgr)
   : OpalEndPoint(mgr, "iax2", IsNetworkEndPoint | SupportsE164)
+  , m_trunkPeriod(20)
+  , m_threadPool(15, "IAX2 Pool")
   , m_callsEstablished(0)
 {
   m_localUserName = mgr.GetDefaultUserName();
@@ -143,7 +145,7 @@ void IAX2EndPoint::NewIncomingConnection(IAX2Frame *f)
 {
   PTRACE(3, "IAX2\tWe have received a NEW request from " << f->GetConnectionToken());
   
-  if (m_connectionsActive.Contains(f->GetConnectionToken())) {
+  if (m_callTable.FindCall(*f) != NULL) {
     /*Have received  a duplicate new packet */
     PTRACE(3, "IAX2\thave received  a duplicate new packet from " 
 	   << f->GetConnectionToken());
@@ -197,8 +199,10 @@ void IAX2EndPoint::NewIncomingConnection(IAX2Frame *f)
     return;
   }
 
-  /*Now activate the connection and start processing packets */
+  /*Now activate the connection and start processing packets. The remote
+    details are known from the NEW, so later frames can find the call. */
   connection->StartOperation();
+  m_callTable.AddRemote(connection->GetRemoteInfo().SourceCallNumber(), f->GetRemoteInfo());
   connection->IncomingEthernetFrame(f);
 }
 
@@ -225,32 +229,13 @@ PINDEX IAX2EndPoint::NextSrcCallNumber(IAX2Processor * /*processor*/)
 
 PBoolean IAX2EndPoint::ConnectionForFrameIsAlive(IAX2Frame *f)
 {
-  PString frameToken = f->GetConnectionToken();
-
-  // ReportStoredConnections();
-
-  PBoolean res = m_connectionsActive.Contains(frameToken);
-  if (res) {
-    return true;
-  }
-
-  m_mutexTokenTable.StartRead();
-  PString tokenTranslated = m_tokenTable(frameToken);
-  m_mutexTokenTable.EndRead();
-
-  if (tokenTranslated.IsEmpty()) {
-    PTRACE(4, "No matching translation table entry token for \"" << frameToken << "\"");
-    return false;
-  }
-
-  res = m_connectionsActive.Contains(tokenTranslated);
-  if (res) {
-    PTRACE(5, "Found \"" << tokenTranslated << "\" in the connectionsActive table");
+  /*Frames we send carry our call number as the source call number */
+  PINDEX callNumber = f->GetRemoteInfo().SourceCallNumber();
+  if (m_callTable.IsCallActive(callNumber))
     return true;
-  }
 
-  PTRACE(6, "ERR Could not find matching connection for \"" << tokenTranslated 
-	 << "\" or \"" << frameToken << "\"");
+  PTRACE(6, "ERR Could not find matching connection for call number " << callNumber
+	 << " of \"" << f->GetConnectionToken() << "\"");
   return false;
 }
 
@@ -265,12 +250,7 @@ void IAX2EndPoint::ReportStoredConnections()
       PTRACE(5, "    #" << (i + 1) << "                     \"" << cons[i] << "\"");
     }
 
-    m_mutexTokenTable.StartRead();
-    PTRACE(5, " There are " << m_tokenTable.GetSize() 
-	   << " stored connections in the token translation table.");
-    for (PStringToString::iterator it = m_tokenTable.begin(); it != m_tokenTable.end(); ++it)
-      PTRACE(5, " token table at " << i << " is " << it->first << " " << it->second);
-    m_mutexTokenTable.EndRead();
+    PTRACE(5, " There are " << m_callTable.GetSize() << " stored calls in the call table.");
   }
 #endif
 }
@@ -361,10 +341,7 @@ void IAX2EndPoint::OnReleased(OpalConnection & opalCon)
 {
   IAX2Connection &con((IAX2Connection &)opalCon);
 
-  PString token(con.GetRemoteInfo().BuildOurConnectionToken());
-  m_mutexTokenTable.StartWrite();
-  m_tokenTable.RemoveAt(token);
-  m_mutexTokenTable.EndWrite();
+  m_callTable.RemoveCall(con.GetRemoteInfo().SourceCallNumber(), &con);
   OpalEndPoint::OnReleased(opalCon);
 }
 
@@ -487,85 +464,17 @@ PINDEX IAX2EndPoint::GetOutSequenceNumberForStatusQuery()
 }
 
 
-PBoolean IAX2EndPoint::ProcessInConnectionTestAll(IAX2Frame *frame)
-{
-  if (!frame->IsFullFrame()) {
-    // Do Not have a FullFrame, so dont add a translation entry.
-    // Only process miniframes when the call is setup, when we have a 
-    // translation table in place and working...
-    return false;
-  }
-     
-  PINDEX destCallNo = frame->GetRemoteInfo().DestCallNumber();  
-  /*destCallNo is the call number at our end. We do not know if the
-     frame is encrypted, so examination of anything other than the
-     source call number/dest call number is unwise */ 
-
-  PString callToken;
-  {
-    PSafePtr<IAX2Connection> connection;
-    for (connection = PSafePtrCast<OpalConnection, IAX2Connection>
-	   (m_connectionsActive.GetAt(0)); 
-	 connection != NULL; 
-	 ++connection) {
-      if (connection->GetRemoteInfo().SourceCallNumber() == destCallNo) {
-	PString token(frame->GetConnectionToken());
-	callToken = connection->GetCallToken();
-	if (!token.IsEmpty()) /* token available, modify token table */ {
-	  m_mutexTokenTable.StartWrite();
-	  m_tokenTable.SetAt(token, callToken);
-	  m_mutexTokenTable.EndWrite();
-	}
-      }
-    }
-  }
-
-  if (callToken.IsEmpty()) {
-    PTRACE(3, "Iax2Ep\tFail to find home for the frame " << *frame);
-    return false;
-  }
-
-  PTRACE(5, "Iax2Ep\tProcess " << *frame << " in connection" << callToken);
-  return ProcessFrameInConnection(frame, callToken);
-}
-
-
 PBoolean IAX2EndPoint::ProcessInMatchingConnection(IAX2Frame *f)
 {
-  ReportStoredConnections();
-
-  PString tokenTranslated;
-  m_mutexTokenTable.StartRead();
-  tokenTranslated = m_tokenTable(f->GetConnectionToken());
-  m_mutexTokenTable.EndRead();
-
-  if (tokenTranslated.IsEmpty()) 
-    tokenTranslated = f->GetConnectionToken();
-
-  if (tokenTranslated.IsEmpty()) {
-    PTRACE(3, "Distribution\tERR Could not find matching connection "
-	   << "for incoming frame of " << f->GetRemoteInfo());
+  PSafePtr<IAX2Connection> connection = m_callTable.FindCall(*f);
+  if (connection == NULL) {
+    PTRACE(5, "Distribution\tNo matching connection for incoming frame of " << f->GetRemoteInfo());
     return false;
   }
 
-  return ProcessFrameInConnection(f, tokenTranslated);
-}
-
-PBoolean IAX2EndPoint::ProcessFrameInConnection(IAX2Frame *f, 
-						const PString & token)
-{
-  IAX2Connection *connection;
-  connection = PSafePtrCast<OpalConnection, IAX2Connection>
-    (m_connectionsActive.FindWithLock(token));
-  if (connection != NULL) {
-    PTRACE(5, "Distribution\tHave a connection for " << f->GetRemoteInfo());
-    connection->IncomingEthernetFrame(f);
-    return true;
-  }
-  
-  PTRACE(3, "Distribution\tERR Could not find matching connection for \"" 
-	 << token << "\" or \"" << f->GetConnectionToken() << "\"");
-  return false;
+  PTRACE(5, "Distribution\tHave a connection for " << f->GetRemoteInfo());
+  connection->IncomingEthernetFrame(f);
+  return true;
 }
 
 //The receiving thread has finished reading a frame, and has droppped it here.
@@ -595,9 +504,6 @@ void IAX2EndPoint::ProcessReceivedEthernetFrames()
       continue;
     }
 
-    if (ProcessInConnectionTestAll(f))
-	continue;
-
     /**These packets cannot be encrypted, as they are not going to a phone call */
     IAX2Frame *af = f->BuildAppropriateFrameType();
     delete f;
@@ -718,6 +624,22 @@ void IAX2EndPoint::SetPassword(PString newValue)
   m_password = newValue; 
 }
 
+void IAX2EndPoint::SetTrunking(const PIPSocket::Address & remote, bool enable)
+{
+  PWaitAndSignal m(m_trunkPeersMutex);
+  if (enable)
+    m_trunkPeers.Include(remote.AsString());
+  else
+    m_trunkPeers.Exclude(remote.AsString());
+  PTRACE(3, "IAX2\tTrunking to " << remote << (enable ? " enabled" : " disabled"));
+}
+
+bool IAX2EndPoint::IsTrunking(const PIPSocket::Address & remote)
+{
+  PWaitAndSignal m(m_trunkPeersMutex);
+  return !m_trunkPeers.IsEmpty() && m_trunkPeers.Contains(remote.AsString());
+}
+
 void IAX2EndPoint::SetLocalUserName(PString newValue)
 { 
   m_localUserName = newValue; 
@@ -814,6 +736,176 @@ PINDEX IAX2EndPoint::GetRegistrationsCount() {
 
 ////////////////////////////////////////////////////////////////////////////////
 
+IAX2CallTable::IAX2CallTable()
+  : m_size(0)
+{
+  memset(m_localBuckets, 0, sizeof(m_localBuckets));
+  memset(m_remoteBuckets, 0, sizeof(m_remoteBuckets));
+}
+
+IAX2CallTable::~IAX2CallTable()
+{
+  for (PINDEX i = 0; i < NumBuckets; i++) {
+    while (m_localBuckets[i] != NULL) {
+      Entry * entry = m_localBuckets[i];
+      m_localBuckets[i] = entry->m_nextLocal;
+      delete entry;
+    }
+  }
+}
+
+unsigned IAX2CallTable::HashLocal(PINDEX localCallNumber)
+{
+  return localCallNumber & (NumBuckets-1);
+}
+
+unsigned IAX2CallTable::HashRemote(const PIPSocket::Address & address, PINDEX port, PINDEX remoteCallNumber)
+{
+  // FNV-1a over the address bytes, port and call number
+  unsigned hash = 2166136261U;
+  for (PINDEX i = 0; i < address.GetSize(); i++)
+    hash = (hash ^ address[i]) * 16777619U;
+  hash = (hash ^ (port & 0xffff)) * 16777619U;
+  hash = (hash ^ (remoteCallNumber & 0x7fff)) * 16777619U;
+  return hash & (NumBuckets-1);
+}
+
+IAX2CallTable::Entry * IAX2CallTable::FindLocal(PINDEX localCallNumber)
+{
+  Entry * entry = m_localBuckets[HashLocal(localCallNumber)];
+  while (entry != NULL && entry->m_localCallNumber != localCallNumber)
+    entry = entry->m_nextLocal;
+  return entry;
+}
+
+PBoolean IAX2CallTable::AddCall(PINDEX localCallNumber, IAX2Connection * connection)
+{
+  PWaitAndSignal lock(m_writeMutex);
+
+  unsigned bucket = HashLocal(localCallNumber);
+  PWaitAndSignal stripe(GetStripe(bucket));
+
+  if (FindLocal(localCallNumber) != NULL) {
+    PTRACE(2, "Iax2Ep\tCall number " << localCallNumber << " is already in use, rejecting " << *connection);
+    return false;
+  }
+
+  Entry * entry = new Entry;
+  entry->m_connection = connection;
+  entry->m_connection.SetSafetyMode(PSafeReference);
+  entry->m_localCallNumber = localCallNumber;
+  entry->m_remotePort = 0;
+  entry->m_remoteCallNumber = 0;
+  entry->m_remoteKnown = false;
+  entry->m_nextRemote = NULL;
+  entry->m_nextLocal = m_localBuckets[bucket];
+  m_localBuckets[bucket] = entry;
+  ++m_size;
+  return true;
+}
+
+void IAX2CallTable::AddRemote(PINDEX localCallNumber, IAX2Remote & remote)
+{
+  PWaitAndSignal lock(m_writeMutex);
+
+  /*Only writers change the chains, and we are the writer, so the local
+    chain can be read without its stripe */
+  Entry * entry = FindLocal(localCallNumber);
+  if (entry == NULL || entry->m_remoteKnown)
+    return;
+
+  PIPSocket::Address address = remote.RemoteAddress();
+  PINDEX port = remote.RemotePort();
+  PINDEX remoteCallNumber = remote.SourceCallNumber();
+  unsigned bucket = HashRemote(address, port, remoteCallNumber);
+  PWaitAndSignal stripe(GetStripe(bucket));
+
+  entry->m_remoteAddress = address;
+  entry->m_remotePort = port;
+  entry->m_remoteCallNumber = remoteCallNumber;
+  entry->m_remoteKnown = true;
+  entry->m_nextRemote = m_remoteBuckets[bucket];
+  m_remoteBuckets[bucket] = entry;
+  PTRACE(5, "Iax2Ep\tCall number " << localCallNumber << " is " << address << ':' << port << " call " << remoteCallNumber);
+}
+
+void IAX2CallTable::RemoveCall(PINDEX localCallNumber, IAX2Connection * connection)
+{
+  PWaitAndSignal lock(m_writeMutex);
+
+  /*A connection that was rejected as a duplicate must not remove the call
+    that owns the number */
+  Entry * entry = FindLocal(localCallNumber);
+  if (entry == NULL || entry->m_connection != connection)
+    return;
+
+  if (entry->m_remoteKnown) {
+    unsigned bucket = HashRemote(entry->m_remoteAddress, entry->m_remotePort, entry->m_remoteCallNumber);
+    PWaitAndSignal stripe(GetStripe(bucket));
+    Entry ** link = &m_remoteBuckets[bucket];
+    while (*link != entry)
+      link = &(*link)->m_nextRemote;
+    *link = entry->m_nextRemote;
+  }
+
+  {
+    unsigned bucket = HashLocal(localCallNumber);
+    PWaitAndSignal stripe(GetStripe(bucket));
+    Entry ** link = &m_localBuckets[bucket];
+    while (*link != entry)
+      link = &(*link)->m_nextLocal;
+    *link = entry->m_nextLocal;
+  }
+
+  delete entry;
+  --m_size;
+}
+
+PSafePtr<IAX2Connection> IAX2CallTable::FindCall(IAX2Frame & frame)
+{
+  IAX2Remote & remote = frame.GetRemoteInfo();
+  PIPSocket::Address address = remote.RemoteAddress();
+  PINDEX port = remote.RemotePort();
+  PINDEX remoteCallNumber = remote.SourceCallNumber();
+
+  {
+    unsigned bucket = HashRemote(address, port, remoteCallNumber);
+    PWaitAndSignal stripe(GetStripe(bucket));
+    for (Entry * entry = m_remoteBuckets[bucket]; entry != NULL; entry = entry->m_nextRemote) {
+      if (entry->m_remoteCallNumber == remoteCallNumber && entry->m_remotePort == port && entry->m_remoteAddress == address)
+        return entry->m_connection;
+    }
+  }
+
+  /*Mini frames only have the remote call number, so if we get here they do
+    not belong to a call we know about */
+  PINDEX localCallNumber = remote.DestCallNumber();
+  if (!frame.IsFullFrame() || localCallNumber == 0)
+    return NULL;
+
+  PSafePtr<IAX2Connection> connection;
+  {
+    unsigned bucket = HashLocal(localCallNumber);
+    PWaitAndSignal stripe(GetStripe(bucket));
+    Entry * entry = FindLocal(localCallNumber);
+    if (entry == NULL)
+      return NULL;
+    connection = entry->m_connection;
+  }
+
+  /*This is the first frame from the remote for a call we started */
+  AddRemote(localCallNumber, remote);
+  return connection;
+}
+
+PBoolean IAX2CallTable::IsCallActive(PINDEX localCallNumber)
+{
+  PWaitAndSignal stripe(GetStripe(HashLocal(localCallNumber)));
+  return FindLocal(localCallNumber) != NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 IAX2IncomingEthernetFrames::IAX2IncomingEthernetFrames() 
   : PThread(1000, NoAutoDeleteThread, NormalPriority, "IAX Incoming")
 {
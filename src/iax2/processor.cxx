@@ -109,13 +109,22 @@ PString IAX2WaitingForAck::GetResponseAsString() const
 
 ////////////////////////////////////////////////////////////////////////////////
 
+void IAX2ProcessorWork::Work()
+{
+  m_processor.ProcessPendingWork();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 IAX2Processor::IAX2Processor(IAX2EndPoint &ep)
-  : PThread(1000, NoAutoDeleteThread, NormalPriority, "IAX2 Processor")
-  , endpoint(ep)
+  : endpoint(ep)
   , controlFramesSent(0)
   , controlFramesRcvd(0)
 {
+  scheduled = false;
+  rerun = false;
   endThread = false;
+  terminated = false;
   
   remote.SetDestCallNumber(0);
   remote.SetRemoteAddress(0);
@@ -143,9 +152,6 @@ IAX2Processor::~IAX2Processor()
 
 void IAX2Processor::SetCallToken(const PString & newToken) 
 {
-  if (!IsHandlingSpecialPackets())
-    SetThreadName("Proc" + newToken);
-
   callToken = newToken;
 } 
 
@@ -154,20 +160,27 @@ PString IAX2Processor::GetCallToken()
   return callToken;
 }
 
-void IAX2Processor::Main()
+void IAX2Processor::ProcessPendingWork()
 {
-  PTRACE(3, "Processor\tStart of iax2 processing thread");
-  PString name = GetThreadName();
-  if (IsHandlingSpecialPackets())
-    SetThreadName("Special Iax packets");
-
-  while(endThread == false) {
-    activate.Wait();
+  for (;;) {
     ProcessLists();
+
+    PWaitAndSignal m(activateMutex);
+    if (rerun) {
+      rerun = false;
+      continue;
+    }
+
+    scheduled = false;
+    if (endThread) {
+      /*This was the final pass, after Terminate() was called. After this
+        point, the processor is never touched by the thread pool again. */
+      terminated = true;
+      PTRACE(3, "End of iax connection processing");
+      terminatedSync.Signal();
+    }
+    return;
   }
-  ProcessLists();
-    
-  PTRACE(3, "End of iax connection processing");
 }
 
 PBoolean IAX2Processor::IsStatusQueryEthernetFrame(IAX2Frame *frame)
@@ -226,14 +239,23 @@ void IAX2Processor::OnNoResponseTimeoutStart(PTimer &, P_INT_PTR)
 
 void IAX2Processor::Activate()
 {
-  activate.Signal();
+  PWaitAndSignal m(activateMutex);
+
+  if (terminated)
+    return;
+
+  if (scheduled) {
+    rerun = true;
+    return;
+  }
+
+  scheduled = true;
+  endpoint.GetThreadPool().AddWork(new IAX2ProcessorWork(*this));
 }
 
 void IAX2Processor::Terminate()
 {
   endThread = true;
-  if (IsSuspended())
-    Resume();
 
   PTRACE(4, "Processor\tProcessor has been directed to end. " 
 	 << (IsTerminated() ? "Has already ended" : "So end now."));
@@ -241,6 +263,23 @@ void IAX2Processor::Terminate()
   Activate();
 }
 
+PBoolean IAX2Processor::WaitForTermination(const PTimeInterval & maxWait)
+{
+  PSimpleTimer timeout(maxWait);
+  for (;;) {
+    {
+      PWaitAndSignal m(activateMutex);
+      if (terminated)
+        return true;
+    }
+
+    if (timeout.HasExpired())
+      return false;
+
+    terminatedSync.Wait(timeout.GetRemaining());
+  }
+}
+
 PBoolean IAX2Processor::ProcessOneIncomingEthernetFrame()
 {  
   IAX2Frame *frame = frameList.GetLastFrame();
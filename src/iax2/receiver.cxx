@@ -103,6 +103,15 @@ void IAX2Receiver::Main()
 void IAX2Receiver::AddNewReceivedFrame(IAX2Frame *newFrame)
 {
   /**This method may split a frame up (if it is trunked) */
+  if (newFrame->IsTrunkFrame()) {
+    PTRACE(6, "IAX2 Rx\tSplit trunk frame into list of received frames " << newFrame->IdString());
+    if (!newFrame->SplitTrunkFrame(fromNetworkFrames)) {
+      PTRACE(3, "IAX2 Rx\tDiscarding rest of malformed trunk frame " << newFrame->IdString());
+    }
+    delete newFrame;
+    return;
+  }
+
   PTRACE(6, "IAX2 Rx\tAdd frame to list of received frames " << newFrame->IdString());
   fromNetworkFrames.AddNewFrame(newFrame);
 }
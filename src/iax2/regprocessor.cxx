@@ -73,7 +73,6 @@ IAX2RegProcessor::IAX2RegProcessor(
   remote.SetRemoteAddress(ip);
   
   Activate();
-  Resume();
 }
 
 IAX2RegProcessor::~IAX2RegProcessor()
@@ -53,7 +53,6 @@
 IAX2SpecialProcessor::IAX2SpecialProcessor(IAX2EndPoint & ep)
  : IAX2Processor(ep)
 {
-  Resume();
 }
 
 IAX2SpecialProcessor::~IAX2SpecialProcessor()
@@ -39,10 +39,87 @@
 
 #define new PNEW
 
+IAX2TrunkBuffer::IAX2TrunkBuffer(const PIPSocket::Address & _address, WORD _port)
+  : address(_address)
+  , port(_port)
+  , data(MaxTrunkFrameSize)
+  , size(IAX2Frame::MetaTrunkHeaderSize)
+  , entries(0)
+  , startTick(PTimer::Tick())
+  , firstEntryTick(startTick)
+{
+}
+
+PBoolean IAX2TrunkBuffer::AddMiniFrame(IAX2MiniFrame & frame)
+{
+  PINDEX mediaSize = frame.GetMediaDataSize();
+  if (size + IAX2Frame::MetaTrunkEntrySize + mediaSize > MaxTrunkFrameSize)
+    return false;
+
+  if (entries == 0)
+    firstEntryTick = PTimer::Tick();
+
+  BYTE * entry = data.GetPointer() + size;
+  PINDEX callNumber = frame.GetRemoteInfo().SourceCallNumber() & 0x7fff;
+  DWORD timeStamp = frame.GetTimeStamp() & 0xffff;
+
+  entry[0] = (BYTE)(mediaSize >> 8);
+  entry[1] = (BYTE)mediaSize;
+  entry[2] = (BYTE)(callNumber >> 8);
+  entry[3] = (BYTE)callNumber;
+  entry[4] = (BYTE)(timeStamp >> 8);
+  entry[5] = (BYTE)timeStamp;
+  memcpy(entry + IAX2Frame::MetaTrunkEntrySize, frame.GetMediaDataPointer(), mediaSize);
+
+  size += IAX2Frame::MetaTrunkEntrySize + mediaSize;
+  entries++;
+  return true;
+}
+
+PBoolean IAX2TrunkBuffer::IsDue(const PTimeInterval & period) const
+{
+  return entries > 0 && (PTimer::Tick() - firstEntryTick) >= period;
+}
+
+PBoolean IAX2TrunkBuffer::IsIdle() const
+{
+  return entries == 0 && (PTimer::Tick() - firstEntryTick) >= IdleTimeout;
+}
+
+PBoolean IAX2TrunkBuffer::Transmit(PUDPSocket & sock)
+{
+  if (entries == 0)
+    return true;
+
+  DWORD trunkTimeStamp = (DWORD)(PTimer::Tick() - startTick).GetMilliSeconds();
+
+  BYTE * header = data.GetPointer();
+  header[0] = 0;
+  header[1] = 0;
+  header[2] = IAX2Frame::MetaTrunkCommand;
+  header[3] = IAX2Frame::MetaTrunkTimeStamps;
+  header[4] = (BYTE)(trunkTimeStamp >> 24);
+  header[5] = (BYTE)(trunkTimeStamp >> 16);
+  header[6] = (BYTE)(trunkTimeStamp >> 8);
+  header[7] = (BYTE)trunkTimeStamp;
+
+  PTRACE(6, "IAX2Transmit\tSend trunk frame of " << entries << " entries, " 
+	 << size << " bytes, to " << address << ":" << port);
+  PBoolean result = sock.WriteTo(header, size, address, port);
+
+  size = IAX2Frame::MetaTrunkHeaderSize;
+  entries = 0;
+  return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
 IAX2Transmit::IAX2Transmit(IAX2EndPoint & _newEndpoint, PUDPSocket & _newSocket)
   : PThread(1000, NoAutoDeleteThread, NormalPriority, "IAX2 Transmitter"),
      ep(_newEndpoint),
-     sock(_newSocket)
+     sock(_newSocket),
+     trunkFramesSent(0),
+     trunkedMiniFrames(0)
 {
   sendNowFrames.Initialise();
   ackingFrames.Initialise();
@@ -96,11 +173,16 @@ void IAX2Transmit::SendVnakRequestedFrames(IAX2FullFrameProtocol &src)
 void IAX2Transmit::Main()
 {
   SetThreadName("IAX2Transmit");
+  PBoolean trunksWaiting = false;
   while(keepGoing) {
     if (!keepGoing)
       break;
 
-    activate.Wait();
+    /*While voice frames sit in a trunk buffer, wake up in time to send them*/
+    if (trunksWaiting)
+      activate.Wait(ep.GetTrunkPeriod());
+    else
+      activate.Wait();
     
     if (!keepGoing)
       break;
@@ -108,7 +190,11 @@ void IAX2Transmit::Main()
     ProcessAckingList();
     
     ProcessSendList();
+
+    trunksWaiting = ProcessTrunks(false);
   }
+
+  ProcessTrunks(true);
   PTRACE(6, "IAX2Transmit\tEnd of the Transmit thread.");  
 }
 
@@ -140,9 +226,75 @@ void IAX2Transmit::ReportLists(PString & answer, bool getFullReport)
     ackingFrames.ReportList(aList);
     reply << aList;
   }
+  reply << PString("   TrunkFrames   = ") << trunkFramesSent 
+	<< " carrying " << trunkedMiniFrames << " mini frames\n";
   answer = reply;
 }
 
+void IAX2Transmit::AddToTrunk(IAX2MiniFrame * frame)
+{
+  IAX2Remote & remote = frame->GetRemoteInfo();
+  PIPSocket::Address address = remote.RemoteAddress();
+  WORD port = (WORD)remote.RemotePort();
+  PString key = address.AsString() + ':' + PString(PString::Unsigned, port);
+
+  IAX2TrunkBuffer * trunk = trunkBuffers.GetAt(key);
+  if (trunk == NULL) {
+    PTRACE(4, "IAX2Transmit\tStart trunk to " << key);
+    trunk = new IAX2TrunkBuffer(address, port);
+    trunkBuffers.SetAt(key, trunk);
+  }
+
+  if (!trunk->AddMiniFrame(*frame)) {
+    PINDEX entries = trunk->GetEntries();
+    if (trunk->Transmit(sock)) {
+      trunkFramesSent++;
+      trunkedMiniFrames += entries;
+    }
+    if (!trunk->AddMiniFrame(*frame)) {
+      PTRACE(3, "IAX2Transmit\tMini frame too large for trunk, send alone " << frame->IdString());
+      frame->TransmitPacket(sock);
+    }
+  }
+
+  delete frame;
+}
+
+PBoolean IAX2Transmit::ProcessTrunks(PBoolean force)
+{
+  if (trunkBuffers.IsEmpty())
+    return false;
+
+  PTimeInterval period = ep.GetTrunkPeriod();
+  PBoolean waiting = false;
+  PStringList idle;
+
+  for (PDictionary<PString, IAX2TrunkBuffer>::iterator it = trunkBuffers.begin(); it != trunkBuffers.end(); ++it) {
+    IAX2TrunkBuffer & trunk = it->second;
+    PINDEX entries = trunk.GetEntries();
+    if (entries == 0) {
+      if (trunk.IsIdle())
+	idle.AppendString(it->first);
+    }
+    else if (force || trunk.IsDue(period)) {
+      if (trunk.Transmit(sock)) {
+	trunkFramesSent++;
+	trunkedMiniFrames += entries;
+      }
+    }
+    else
+      waiting = true;
+  }
+
+  /*A trunk that has had nothing to send for a while has no active calls*/
+  for (PStringList::iterator it = idle.begin(); it != idle.end(); ++it) {
+    PTRACE(4, "IAX2Transmit\tEnd idle trunk to " << *it);
+    trunkBuffers.RemoveAt(*it);
+  }
+
+  return waiting;
+}
+
 void IAX2Transmit::ProcessSendList()
 {
   for(;;) {
@@ -162,6 +314,14 @@ void IAX2Transmit::ProcessSendList()
       }
     }
     
+    if (PIsDescendant(active, IAX2MiniFrame) && ((IAX2MiniFrame *)active)->IsTrunked()) {
+      if (ep.ConnectionForFrameIsAlive(active))
+	AddToTrunk((IAX2MiniFrame *)active);
+      else
+	delete active;
+      continue;
+    }
+
     if (!active->TransmitPacket(sock)) {
       PTRACE(4, "IAX2Transmit\tDelete  " << active->IdString() 
 	     << " as transmit failed.");
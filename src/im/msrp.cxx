@@ -45,6 +45,8 @@
 #include <im/t140.h>
 #include <sdp/sdp.h>
 
+#include <algorithm>
+
 
 #define CRLF "\r\n"
 
@@ -499,24 +501,52 @@ void OpalMSRPMediaStream::OnReceiveMSRP(OpalMSRPManager &, OpalMSRPManager::Inco
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 
+// Maximum time a handler thread waits before picking up newly started connections
+static const unsigned HandlerSelectInterval = 100;
+
+// Leave room in the first handler for the listening socket
+static const size_t MaxConnectionsPerHandler = FD_SETSIZE - 1;
+
+// Time allowed for an outgoing TCP connection
+static const unsigned ConnectTimeout = 2000;
+
+
 OpalMSRPManager::OpalMSRPManager(OpalManager & _opalManager, WORD _port)
   : opalManager(_opalManager)
   , m_listenerPort(_port)
-  , m_listenerThread(NULL)
+  , m_running(true)
+  , m_dispatchPool(4, 0, "MSRP Dispatch")
 {
-  if (m_listenerSocket.Listen(5, m_listenerPort, PSocket::CanReuseAddress)) 
-    m_listenerThread = new PThreadObj<OpalMSRPManager>(*this, &OpalMSRPManager::ListenerThread);
-  else {
+  if (!m_listenerSocket.Listen(5, m_listenerPort, PSocket::CanReuseAddress)) {
     PTRACE(2, "MSRP\tCannot start MSRP listener on port " << m_listenerPort);
   }
+
+  // Outgoing connections still need servicing even if we cannot listen
+  PWaitAndSignal m(m_connectionInfoMapAddMutex);
+  m_handlers.resize(1);
+  m_handlers[0].m_thread = new PThreadObj1Arg<OpalMSRPManager, size_t>(*this, 0, &OpalMSRPManager::HandlerThread, false, "MSRP Handler");
 }
 
 OpalMSRPManager::~OpalMSRPManager()
 {
   PWaitAndSignal m(mutex);
 
+  m_running = false;
   m_listenerSocket.Close();
-  PThread::WaitAndDelete(m_listenerThread);
+
+  std::vector<PThread *> threads;
+  {
+    PWaitAndSignal m2(m_connectionInfoMapAddMutex);
+    for (size_t i = 0; i < m_handlers.size(); ++i)
+      threads.push_back(m_handlers[i].m_thread);
+  }
+
+  for (size_t i = 0; i < threads.size(); ++i)
+    PThread::WaitAndDelete(threads[i]);
+
+  PWaitAndSignal m2(m_connectionInfoMapAddMutex);
+  m_handlers.clear();
+  m_connectionInfoMap.clear();
 }
 
 
@@ -550,33 +580,131 @@ bool OpalMSRPManager::GetLocalPort(WORD & port)
   return true;
 }
 
-void OpalMSRPManager::ListenerThread()
+void OpalMSRPManager::HandlerThread(size_t index)
 {
-  PTRACE(2, "MSRP\tListener thread started");
+  PTRACE(3, "MSRP\tHandler thread " << index << " started");
 
-  for (;;) {
-    MSRPProtocol * protocol = new MSRPProtocol;
-    if (!protocol->Accept(m_listenerSocket)) {
-      PTRACE(2, "MSRP\tListener accept failed");
-      delete protocol;
-      break;
-    }
-
-    PIPSocket * socket = protocol->GetSocket();
-    PIPSocketAddressAndPort remoteAddr;
-    socket->GetPeerAddress(remoteAddr);
+  while (m_running) {
+    PSocket::SelectList readList, writeList;
+    if (index == 0 && m_listenerSocket.IsOpen())
+      readList += m_listenerSocket;
 
-    PTRACE(2, "MSRP\tListener accepted new incoming connection");
-    PSafePtr<Connection> connection = new Connection(*this, remoteAddr.AsString(), protocol);
+    // Take references so connections survive being closed while we read them
+    typedef std::map<PSocket *, PSafePtr<Connection> > ActiveMap;
+    ActiveMap active;
     {
       PWaitAndSignal m(m_connectionInfoMapAddMutex);
-      connection.SetSafetyMode(PSafeReference);
-      m_connectionInfoMap[remoteAddr.AsString()] = connection;
-      connection.SetSafetyMode(PSafeReadWrite);
+      HandlerConnections & connections = m_handlers[index].m_connections;
+      for (HandlerConnections::iterator it = connections.begin(); it != connections.end(); ++it) {
+        Connection * connection = it->first;
+        if (connection->m_running && connection->m_protocol->IsOpen()) {
+          PSocket * socket = connection->m_protocol->GetSocket();
+          active[socket] = it->second;
+          readList += *socket;
+          // Anything a sender could not write without blocking is finished here
+          if (connection->m_protocol->HasQueuedData())
+            writeList += *socket;
+        }
+      }
+    }
+
+    if (readList.IsEmpty()) {
+      PThread::Sleep(HandlerSelectInterval);
+      continue;
+    }
+
+    PChannel::Errors error = PSocket::Select(readList, writeList, HandlerSelectInterval);
+    if (error != PChannel::NoError) {
+      PTRACE(2, "MSRP\tSelect failed: " << PChannel::GetErrorText(error));
+      PThread::Sleep(HandlerSelectInterval);
+      continue;
+    }
+
+    for (PSocket::SelectList::iterator it = writeList.begin(); it != writeList.end(); ++it) {
+      ActiveMap::iterator conn = active.find(&*it);
+      if (conn != active.end() && !conn->second->m_protocol->WriteQueued()) {
+        PTRACE(3, "MSRP\tConnection " << conn->second->m_key << " lost on write");
+        conn->second->m_running = false;
+        conn->second->m_protocol->Close();
+
+        PWaitAndSignal m(m_connectionInfoMapAddMutex);
+        RemoveConnection(*conn->second);
+      }
+    }
+
+    for (PSocket::SelectList::iterator it = readList.begin(); it != readList.end(); ++it) {
+      if (&*it == &m_listenerSocket) {
+        MSRPProtocol * protocol = new MSRPProtocol;
+        if (!protocol->Accept(m_listenerSocket)) {
+          PTRACE(2, "MSRP\tListener accept failed");
+          delete protocol;
+          continue;
+        }
+
+        PIPSocket * socket = protocol->GetSocket();
+        PIPSocketAddressAndPort remoteAddr;
+        socket->GetPeerAddress(remoteAddr);
+
+        PTRACE(3, "MSRP\tListener accepted new incoming connection from " << remoteAddr);
+        PSafePtr<Connection> connection(new Connection(*this, remoteAddr.AsString(), protocol), PSafeReference);
+        {
+          PWaitAndSignal m(m_connectionInfoMapAddMutex);
+          m_connectionInfoMap[remoteAddr.AsString()] = connection;
+        }
+        connection->StartHandler();
+        continue;
+      }
+
+      ActiveMap::iterator conn = active.find(&*it);
+      if (conn != active.end() && !conn->second->OnReadable()) {
+        PTRACE(3, "MSRP\tConnection " << conn->second->m_key << " lost");
+        conn->second->m_running = false;
+        conn->second->m_protocol->Close();
+
+        // Users still holding it will fail, new users get a new connection
+        PWaitAndSignal m(m_connectionInfoMapAddMutex);
+        RemoveConnection(*conn->second);
+      }
     }
-    connection->StartHandler();
   }
-  PTRACE(2, "MSRP\tListener thread ended");
+
+  PTRACE(3, "MSRP\tHandler thread " << index << " ended");
+}
+
+
+void OpalMSRPManager::AddToHandler(Connection & connection)
+{
+  PWaitAndSignal m(m_connectionInfoMapAddMutex);
+
+  if (!m_running)
+    return;
+
+  size_t index = 0;
+  while (index < m_handlers.size() && m_handlers[index].m_connections.size() >= MaxConnectionsPerHandler)
+    ++index;
+
+  if (index >= m_handlers.size()) {
+    m_handlers.resize(index+1);
+    m_handlers[index].m_thread = new PThreadObj1Arg<OpalMSRPManager, size_t>(*this, index, &OpalMSRPManager::HandlerThread, false, "MSRP Handler");
+    PTRACE(3, "MSRP\tAdded handler thread " << index << " for more than " << index*MaxConnectionsPerHandler << " connections");
+  }
+
+  connection.m_handlerIndex = index;
+  m_handlers[index].m_connections[&connection] = PSafePtr<Connection>(&connection, PSafeReference);
+}
+
+
+void OpalMSRPManager::RemoveConnection(Connection & connection)
+{
+  // Erasing may drop the last reference other than this one
+  PSafePtr<Connection> guard(&connection, PSafeReference);
+
+  ConnectionInfoMapType::iterator it = m_connectionInfoMap.find(connection.m_key);
+  if (it != m_connectionInfoMap.end() && (Connection *)it->second == &connection)
+    m_connectionInfoMap.erase(it);
+
+  if (connection.m_handlerIndex < m_handlers.size())
+    m_handlers[connection.m_handlerIndex].m_connections.erase(&connection);
 }
 
 
@@ -596,6 +724,7 @@ PSafePtr<OpalMSRPManager::Connection> OpalMSRPManager::OpenConnection(const PURL
   PString connectionKey(ap.AsString());
 
   PSafePtr<Connection> connectionPtr = NULL;
+  bool reused = false;
 
   // see if we already have a connection to that remote host
   // if not, create one and add to the connection map
@@ -603,36 +732,48 @@ PSafePtr<OpalMSRPManager::Connection> OpalMSRPManager::OpenConnection(const PURL
     PWaitAndSignal m(m_connectionInfoMapAddMutex);
     ConnectionInfoMapType::iterator r = m_connectionInfoMap.find(connectionKey);
     if (r != m_connectionInfoMap.end()) {
-      PTRACE(2, "MSRP\tReusing existing connection to " << ap);
       connectionPtr = r->second;
-      connectionPtr.SetSafetyMode(PSafeReadWrite);
+      connectionPtr.SetSafetyMode(PSafeReference);
       ++connectionPtr->m_refCount;
-      return connectionPtr;
+      reused = true;
     }
+    else {
+      connectionPtr = PSafePtr<Connection>(new Connection(*this, connectionKey), PSafeReference);
+      m_connectionInfoMap[connectionKey] = connectionPtr;
+    }
+  }
 
-    connectionPtr = PSafePtr<Connection>(new Connection(*this, connectionKey));
-    m_connectionInfoMap[connectionKey] = connectionPtr;
+  if (reused) {
+    /* Another user may be connecting it right now, wait for them, outside
+       the map mutex, as they need it if the connect fails. Lost connections
+       are removed from the map, so new users get a new connection. */
+    if (!connectionPtr->WaitConnected(ConnectTimeout*2)) {
+      PTRACE(2, "MSRP\tExisting connection to " << ap << " did not connect");
+      CloseConnection(connectionPtr);
+      return NULL;
+    }
+    PTRACE(3, "MSRP\tReusing existing connection to " << ap);
+    return connectionPtr;
   }
 
-  connectionPtr.SetSafetyMode(PSafeReadWrite);
-  
   // create a connection to the remote
   // if cannot, remove it from connection map
-  connectionPtr->m_protocol->SetReadTimeout(2000);
+  connectionPtr->m_protocol->SetReadTimeout(ConnectTimeout);
   if (!connectionPtr->m_protocol->Connect(ap.GetAddress(), ap.GetPort())) {
     PTRACE(2, "MSRP\tUnable to make new connection to " << ap);
+    connectionPtr->SetState(Connection::Failed);
     PWaitAndSignal m(m_connectionInfoMapAddMutex);
-    m_connectionInfoMap.erase(connectionKey);
+    RemoveConnection(*connectionPtr);
     connectionPtr.SetNULL();
     return NULL;
   }
 
-  PTRACE(2, "MSRP\tConnection established to to " << ap);
-
+  PTRACE(2, "MSRP\tConnection established to " << ap);
 
   PString uid;
   connectionPtr->m_protocol->SendSEND(localURL, remoteURL, "", "", uid);
   connectionPtr->StartHandler();
+  connectionPtr->SetState(Connection::Connected);
 
   return connectionPtr;
 }
@@ -642,7 +783,7 @@ bool OpalMSRPManager::CloseConnection(PSafePtr<OpalMSRPManager::Connection> & co
 {
   PWaitAndSignal m(m_connectionInfoMapAddMutex);
   if (--connection->m_refCount == 0) {
-    m_connectionInfoMap.erase(connection->m_key);
+    RemoveConnection(*connection);
     connection.SetNULL();
   }
   return true;
@@ -691,25 +832,54 @@ OpalMSRPManager::Connection::Connection(OpalMSRPManager & manager, const std::st
   : m_manager(manager)
   , m_key(key)
   , m_protocol(protocol)
-  , m_running(true)
-  , m_handlerThread(NULL)
+  , m_running(false)
   , m_refCount(1)
-
+  , m_handlerIndex(P_MAX_INDEX)
+  , m_state(protocol != NULL ? Connected : Connecting)
 {
   PTRACE(3, "MSRP\tCreating connection");
   if (m_protocol == NULL)
     m_protocol = new MSRPProtocol();
 }
 
+void OpalMSRPManager::Connection::SetState(States state)
+{
+  PWaitAndSignal m(m_stateMutex);
+  m_state = state;
+  m_stateChanged.Signal();
+}
+
+bool OpalMSRPManager::Connection::WaitConnected(const PTimeInterval & timeout)
+{
+  PSimpleTimer timer(timeout);
+  PWaitAndSignal m(m_stateMutex);
+
+  bool waited = false;
+  while (m_state == Connecting && !timer.HasExpired()) {
+    m_stateMutex.Signal();
+    m_stateChanged.Wait(timer.GetRemaining());
+    m_stateMutex.Wait();
+    waited = true;
+  }
+
+  // Only one waiter is woken, pass it on to any others
+  if (waited)
+    m_stateChanged.Signal();
+
+  return m_state == Connected;
+}
+
 void OpalMSRPManager::Connection::StartHandler()
 {
-  m_handlerThread = new PThreadObj<OpalMSRPManager::Connection>(*this, &OpalMSRPManager::Connection::HandlerThread);
+  // Only read when the handler thread says there is data
+  m_protocol->SetReadTimeout(0);
+  m_running = true;
+  m_manager.AddToHandler(*this);
 }
 
 OpalMSRPManager::Connection::~Connection()
 {
   m_running = false;
-  PThread::WaitAndDelete(m_handlerThread);
 
   delete m_protocol;
   m_protocol = NULL;
@@ -717,52 +887,56 @@ OpalMSRPManager::Connection::~Connection()
 }
 
 
-void OpalMSRPManager::Connection::HandlerThread()
+bool OpalMSRPManager::Connection::OnReadable()
 {
-  PTRACE(2, "MSRP\tMSRP connection thread started");
-
-  m_protocol->SetReadTimeout(1000);
-
-  while (m_running) {
-
-    PIPSocket::SelectList sockets;
-    sockets += *m_protocol->GetSocket();
-
-    if (PIPSocket::Select(sockets, 1000) != PChannel::NoError) 
-      break;
-
-    if (sockets.GetSize() != 0) {
-
-      PTRACE(3, "MSRP\tMSRP message received");
+  if (!m_protocol->ReadAvailable())
+    return false;
 
-      OpalMSRPManager::IncomingMSRP incomingMsg;
-      if (!m_protocol->ReadMessage(incomingMsg.m_command, incomingMsg.m_chunkId, incomingMsg.m_mime, incomingMsg.m_body))
-        break;
+  // A single read may complete several pipelined chunks
+  for (;;) {
+    OpalMSRPManager::IncomingMSRP incomingMsg;
+    switch (m_protocol->ParseMessage(incomingMsg.m_command, incomingMsg.m_chunkId, incomingMsg.m_mime, incomingMsg.m_body)) {
+      case MSRPProtocol::ParseIncomplete :
+        return true;
+      case MSRPProtocol::ParseFailed :
+        return false;
+      default :
+        OnReceivedMessage(incomingMsg);
+    }
+  }
+}
 
-      PString fromPath(incomingMsg.m_mime("From-Path"));
-      PString toPath (incomingMsg.m_mime("To-Path"));
 
-      if (incomingMsg.m_command == MSRPProtocol::SEND) {
-        m_protocol->SendResponse(incomingMsg.m_chunkId, 200, "OK", toPath, fromPath);
-        PTRACE(3, "MSRP\tMSRP SEND received from=" << fromPath << ",to=" << toPath);
-        if (incomingMsg.m_mime.Contains(PHTTP::ContentTypeTag)) {
-          incomingMsg.m_connection = PSafePtr<Connection>(this);
-          m_manager.DispatchMessage(incomingMsg);
-        }
-        if (incomingMsg.m_mime("Success-Report") *= "yes") {
-          PMIMEInfo mime;
-          PString fromUrl(incomingMsg.m_mime("From-Path"));
-          PString toUrl  (incomingMsg.m_mime("To-Path"));
-          mime.SetAt("Message-ID", incomingMsg.m_mime("Message-ID"));
-          mime.SetAt("Byte-Range", incomingMsg.m_mime("Byte-Range"));
-          mime.SetAt("Status",     "000 200 OK");
-          m_protocol->SendREPORT(incomingMsg.m_chunkId, toUrl, fromUrl, mime);
-        }
-      }
+void OpalMSRPManager::Connection::OnReceivedMessage(IncomingMSRP & incomingMsg)
+{
+  PString fromPath(incomingMsg.m_mime("From-Path"));
+  PString toPath (incomingMsg.m_mime("To-Path"));
+
+  if (incomingMsg.m_command == MSRPProtocol::SEND) {
+    m_protocol->SendResponse(incomingMsg.m_chunkId, 200, "OK", toPath, fromPath);
+    PTRACE(3, "MSRP\tMSRP SEND received from=" << fromPath << ",to=" << toPath);
+    if (incomingMsg.m_mime.Contains(PHTTP::ContentTypeTag)) {
+      // Callbacks may take their time, so they must not hold up the handler
+      incomingMsg.m_connection = PSafePtr<Connection>(this, PSafeReference);
+      m_manager.m_dispatchPool.AddWork(new PSafeWorkArg1<Connection, IncomingMSRP>(
+                                          this, incomingMsg, &Connection::DispatchMessage), m_key.c_str());
+    }
+    if (incomingMsg.m_mime("Success-Report") *= "yes") {
+      PMIMEInfo mime;
+      mime.SetAt("Message-ID", incomingMsg.m_mime("Message-ID"));
+      mime.SetAt("Byte-Range", incomingMsg.m_mime("Byte-Range"));
+      mime.SetAt("Status",     "000 200 OK");
+      m_protocol->SendREPORT(incomingMsg.m_chunkId, toPath, fromPath, mime);
     }
   }
+  else if (incomingMsg.m_command != MSRPProtocol::REPORT && incomingMsg.m_command != MSRPProtocol::NumCommands)
+    m_protocol->OnChunkResponse();
+}
+
 
-  PTRACE(2, "MSRP\tMSRP protocol thread finished");
+void OpalMSRPManager::Connection::DispatchMessage(IncomingMSRP incomingMsg)
+{
+  m_manager.DispatchMessage(incomingMsg);
 }
 
 ////////////////////////////////////////////////////////
@@ -773,7 +947,106 @@ static char const * const MSRPCommands[MSRPProtocol::NumCommands] = {
 
 MSRPProtocol::MSRPProtocol()
 : PInternetProtocol("msrp 2855", NumCommands, MSRPCommands)
-{ }
+, m_rxOffset(0)
+, m_rxScanned(0)
+, m_outstandingChunks(0)
+{
+  // Writes are queued, what the socket will not take now is sent by the handler thread
+  SetWriteTimeout(0);
+}
+
+
+bool MSRPProtocol::QueueData(const PString & data)
+{
+  PWaitAndSignal lock(m_mutex);
+
+  if (m_txBuffer.size() + data.GetLength() > MaximumQueuedData) {
+    PTRACE(2, "MSRP\tSend queue full, remote is not reading");
+    return false;
+  }
+
+  m_txBuffer.append(data, data.GetLength());
+  return InternalWriteQueued();
+}
+
+
+bool MSRPProtocol::WriteQueued()
+{
+  PWaitAndSignal lock(m_mutex);
+  return InternalWriteQueued();
+}
+
+
+bool MSRPProtocol::HasQueuedData()
+{
+  PWaitAndSignal lock(m_mutex);
+  return !m_txBuffer.empty();
+}
+
+
+bool MSRPProtocol::InternalWriteQueued()
+{
+  if (m_txBuffer.empty())
+    return true;
+
+  if (Write(m_txBuffer.data(), m_txBuffer.size())) {
+    m_txBuffer.clear();
+    return true;
+  }
+
+  // With no write timeout, a full socket buffer shows as a timeout
+  m_txBuffer.erase(0, GetLastWriteCount());
+  if (GetErrorCode(LastWriteError) == Timeout)
+    return true;
+
+  PTRACE(2, "MSRP\tWrite failed: " << GetErrorText(LastWriteError));
+  return false;
+}
+
+
+PBoolean MSRPProtocol::Close()
+{
+  PBoolean ok = PInternetProtocol::Close();
+  m_windowAvailable.Signal();
+  return ok;
+}
+
+
+bool MSRPProtocol::WaitForSendWindow(const PMIMEInfo & mime)
+{
+  /* With "Failure-Report: no" there is no response at all, and with
+     "partial" only for errors, so nothing would ever reopen the window */
+  PCaselessString failureReport = mime("Failure-Report");
+  if (failureReport == "no" || failureReport == "partial")
+    return true;
+
+  PSimpleTimer timeout(SendWindowTimeout);
+  for (;;) {
+    {
+      PWaitAndSignal m(m_windowMutex);
+      if (m_outstandingChunks < MaximumOutstandingChunks) {
+        ++m_outstandingChunks;
+        return true;
+      }
+    }
+
+    if (!IsOpen() || timeout.HasExpired()) {
+      PTRACE(2, "MSRP\tNo responses to " << m_outstandingChunks << " outstanding chunks, aborting send");
+      return false;
+    }
+
+    m_windowAvailable.Wait(timeout.GetRemaining());
+  }
+}
+
+
+void MSRPProtocol::OnChunkResponse()
+{
+  PWaitAndSignal m(m_windowMutex);
+  if (m_outstandingChunks > 0)
+    --m_outstandingChunks;
+  m_windowAvailable.Signal();
+}
 
 bool MSRPProtocol::SendSEND(const PURL & from, 
                             const PURL & to,
@@ -781,56 +1054,56 @@ bool MSRPProtocol::SendSEND(const PURL & from,
                             const PString & contentType,
                                   PString & messageId)
 {
-  // create a message
-  Message message;
-  message.m_id          = messageId = PGloballyUniqueID().AsString();
-  message.m_fromURL     = from;
-  message.m_toURL       = to;
-  message.m_contentType = contentType;
-  message.m_length      = text.GetLength();
-  
-  // break the text into chunks
-  if (message.m_length == 0) {
-    Message::Chunk chunk(PGloballyUniqueID().AsString(), 0, 0);
-    message.m_chunks.push_back(chunk);
-  }
-  else {
-    unsigned offs = 0;
-    while ((message.m_length - offs) > MaximumMessageLength) {
-      Message::Chunk chunk(PGloballyUniqueID().AsString(), offs, MaximumMessageLength);
-      message.m_chunks.push_back(chunk);
-      offs += MaximumMessageLength;
-    }
-    Message::Chunk chunk(PGloballyUniqueID().AsString(), offs, message.m_length - offs);
-    message.m_chunks.push_back(chunk);
-  }
+  PStringStream strm(text);
+  return SendSEND(from, to, strm, text.GetLength(), contentType, messageId);
+}
 
-  // add message to the message map
-  //m_messageMap.insert(MessageMap::value_type(message.m_id, message));
 
-  // send the chunks
-  for (Message::ChunkList::const_iterator r = message.m_chunks.begin(); r != message.m_chunks.end(); ++r) {
+bool MSRPProtocol::SendSEND(const PURL & from, 
+                            const PURL & to,
+                            istream & body,
+                            PINDEX length,
+                            const PString & contentType,
+                                  PString & messageId)
+{
+  messageId = PGloballyUniqueID().AsString();
+
+  PString toUrl = to.AsString();
+  PString fromUrl = from.AsString();
+  PString total = length != P_MAX_INDEX ? PString(PString::Unsigned, (unsigned)length) : PString('*');
+
+  // Read and send one chunk at a time, the send window limits how far ahead we get
+  PBYTEArray buffer(MaximumMessageLength);
+  PINDEX offset = 0;
+  bool isLast;
+  do {
+    PINDEX count = 0;
+    if (length != 0) {
+      body.read((char *)buffer.GetPointer(), length != P_MAX_INDEX ? std::min(length - offset, (PINDEX)MaximumMessageLength) : MaximumMessageLength);
+      count = (PINDEX)body.gcount();
+    }
+    isLast = length != P_MAX_INDEX ? offset + count >= length || count == 0 : body.peek() == EOF;
+
+    PString chunkId = PGloballyUniqueID().AsString();
     PMIMEInfo mime;
-    mime.SetAt("Message-ID",   message.m_id);
-    bool isLast = ((r+1) == message.m_chunks.end());
+    mime.SetAt("Message-ID", messageId);
 
-    PString body;
-    if (message.m_length != 0) {
+    PString chunk;
+    if (count > 0) {
       mime.SetAt("Success-Report", "yes");
-      mime.SetAt("Byte-Range",   psprintf("%u-%u/%u", r->m_rangeFrom, r->m_rangeTo, message.m_length));
-      body = (PHTTP::ContentTypeTag() & message.m_contentType) + CRLF CRLF +
-             text.Mid(r->m_rangeFrom-1, r->m_rangeTo - r->m_rangeFrom + 1) + CRLF;
+      mime.SetAt("Byte-Range", PSTRSTRM(offset + 1 << '-' << offset + count << '/' << total));
+      chunk = (PHTTP::ContentTypeTag() & contentType) + CRLF CRLF +
+              PString((const char *)(const BYTE *)buffer, count) + CRLF;
     }
 
-    body += PString("-------") + r->m_chunkId + (isLast ? '$' : '+') + CRLF;   // note that RFC 4975 mandates a CRLF before the terminator
+    chunk += PString("-------") + chunkId + (isLast ? '$' : '+') + CRLF;   // note that RFC 4975 mandates a CRLF before the terminator
 
-    if (!SendChunk(r->m_chunkId, 
-                   message.m_toURL.AsString(),
-                   message.m_fromURL.AsString(),
-                   mime, 
-                   body))
+    if (!SendChunk(chunkId, toUrl, fromUrl, mime, chunk))
       return false;
-  }
+
+    offset += count;
+  } while (!isLast);
+
   return true;
 }
 
@@ -841,26 +1114,22 @@ bool MSRPProtocol::SendChunk(const PString & chunkId,
                              const PMIMEInfo & mime, 
                              const PString & body)
 {
+  // Pipeline chunks, but stop when the remote falls too far behind in responding
+  if (!WaitForSendWindow(mime))
+    return false;
+
   // Note that RFC 4975 mandates the order and position of of To-Path and From-Path
-  *this << "MSRP " << chunkId << " " << MSRPCommands[SEND] << CRLF
-        << "To-Path: " << toUrl << CRLF
-        << "From-Path: "<< fromUrl << CRLF
-        << ::setfill('\r');
-  mime.PrintContents(*this);
-  *this << body;
-  flush();
+  PStringStream pdu;
+  pdu << "MSRP " << chunkId << " " << MSRPCommands[SEND] << CRLF
+      << "To-Path: " << toUrl << CRLF
+      << "From-Path: "<< fromUrl << CRLF
+      << ::setfill('\r');
+  mime.PrintContents(pdu);
+  pdu << body;
 
-  {
-    PStringStream str; str << ::setfill('\r');
-    mime.PrintContents(str);
-    PTRACE(4, "Sending MSRP chunk\n" << "MSRP " << chunkId << " " << MSRPCommands[SEND] << CRLF 
-                                       << "To-Path: " << toUrl << CRLF 
-                                       << "From-Path: "<< fromUrl << CRLF 
-                                       << str << CRLF
-                                       << body);
-  }
+  PTRACE(4, "Sending MSRP chunk\n" << pdu);
 
-  return true;
+  return QueueData(pdu);
 }
 
 bool MSRPProtocol::SendREPORT(const PString & chunkId, 
@@ -869,30 +1138,17 @@ bool MSRPProtocol::SendREPORT(const PString & chunkId,
                             const PMIMEInfo & mime)
 {
   // Note that RFC 4975 mandates the order and position of of To-Path and From-Path
-  *this << "MSRP " << chunkId << " " << MSRPCommands[REPORT] << CRLF
-        << "To-Path: " << toUrl << CRLF
-        << "From-Path: "<< fromUrl << CRLF
-        << ::setfill('\r');
-  mime.PrintContents(*this);
-  *this << "-------" << chunkId << "$" << CRLF;
-  flush();
-
-#if PTRACING
-  static const unsigned Level = 4;
-  if (PTrace::CanTrace(Level)) {
-    ostream & trace = PTRACE_BEGIN(Level, "MSRP");
-    trace << "Sending MSRP REPORT\n"
-             "MSRP " << chunkId << " " << MSRPCommands[REPORT] << "\n"
-             "To-Path: " << toUrl << "\n"
-             "From-Path: " << fromUrl << '\n'
-             << ::setfill('\r');
-    mime.PrintContents(trace);
-    trace << "-------" << chunkId << '$'
-          << PTrace::End;
-  }
-#endif
+  PStringStream pdu;
+  pdu << "MSRP " << chunkId << " " << MSRPCommands[REPORT] << CRLF
+      << "To-Path: " << toUrl << CRLF
+      << "From-Path: "<< fromUrl << CRLF
+      << ::setfill('\r');
+  mime.PrintContents(pdu);
+  pdu << "-------" << chunkId << "$" << CRLF;
 
-  return true;
+  PTRACE(4, "MSRP\tSending MSRP REPORT\n" << pdu);
+
+  return QueueData(pdu);
 }
 
 bool MSRPProtocol::SendResponse(const PString & chunkId, 
@@ -902,64 +1158,124 @@ bool MSRPProtocol::SendResponse(const PString & chunkId,
                                 const PString & fromUrl)
 {
   // Note that RFC 4975 mandates the order and position of of To-Path and From-Path
-  *this << "MSRP " << chunkId << " " << response << (text.IsEmpty() ? "" : " ") << text << CRLF
-        << "To-Path: " << toUrl << CRLF
-        << "From-Path: "<< fromUrl << CRLF
-        << "-------" << chunkId << "$" << CRLF;
-  flush();
+  PStringStream pdu;
+  pdu << "MSRP " << chunkId << " " << response << (text.IsEmpty() ? "" : " ") << text << CRLF
+      << "To-Path: " << toUrl << CRLF
+      << "From-Path: "<< fromUrl << CRLF
+      << "-------" << chunkId << "$" << CRLF;
 
-  PTRACE(4, "Sending MSRP response\n" << "MSRP " << chunkId << " " << response << (text.IsEmpty() ? "" : " ") << CRLF 
-                                                 << "To-Path: " << toUrl << CRLF
-                                                 << "From-Path: "<< fromUrl << CRLF
-                                                 << "-------" << chunkId << "$");
+  PTRACE(4, "Sending MSRP response\n" << pdu);
 
+  return QueueData(pdu);
+}
+
+bool MSRPProtocol::ReadAvailable()
+{
+  // Drop consumed messages once they make up most of the buffer
+  if (m_rxOffset > 0 && m_rxOffset*2 >= m_rxBuffer.size()) {
+    m_rxBuffer.erase(0, m_rxOffset);
+    m_rxScanned = m_rxScanned > m_rxOffset ? m_rxScanned - m_rxOffset : 0;
+    m_rxOffset = 0;
+  }
+
+  char buffer[4096];
+  if (!Read(buffer, sizeof(buffer)))
+    return GetErrorCode(LastReadError) == Timeout;
+
+  if (GetLastReadCount() == 0)
+    return false;
+
+  m_rxBuffer.append(buffer, GetLastReadCount());
   return true;
 }
 
-bool MSRPProtocol::ReadMessage(int & command, 
-                           PString & chunkId,
-                         PMIMEInfo & mime, 
-                           PString & body)
+
+MSRPProtocol::ParseResult MSRPProtocol::ParseMessage(int & command, 
+                                                 PString & chunkId,
+                                               PMIMEInfo & mime, 
+                                                 PString & body)
 {
-  // get the MSRP start line
-  PString startLine;
-  do {
-    if (!ReadLine(startLine, false)) {
-      PTRACE(2, "MSRP\tError while reading MSRP command");
-      return false;
-    }
-  } while (startLine.IsEmpty());
+  // skip blank lines between messages
+  while (m_rxOffset < m_rxBuffer.size() && (m_rxBuffer[m_rxOffset] == '\r' || m_rxBuffer[m_rxOffset] == '\n'))
+    ++m_rxOffset;
+
+  std::string::size_type startLineEnd = m_rxBuffer.find(CRLF, m_rxOffset);
+  if (startLineEnd == std::string::npos) {
+    if (m_rxBuffer.size() - m_rxOffset <= MaximumHeaderSize)
+      return ParseIncomplete;
+    PTRACE(2, "MSRP\tMSRP command line too long");
+    return ParseFailed;
+  }
 
-  // get tokens
+  PString startLine(m_rxBuffer.data() + m_rxOffset, startLineEnd - m_rxOffset);
   PStringArray tokens = startLine.Tokenise(' ', false);
   if (tokens.GetSize() < 3) {
     PTRACE(2, "MSRP\tReceived malformed MSRP command line \"" << startLine << "\" with " << tokens.GetSize() << " tokens");
-    return false;
+    return ParseFailed;
   }
 
   if (!(tokens[0] *= "MSRP")) {
     PTRACE(2, "MSRP\tFirst token on MSRP command line is not MSRP");
-    return false;
+    return ParseFailed;
   }
 
-  chunkId = tokens[1];
-  PString terminator = "-------" + chunkId;
-  body.MakeEmpty();
+  // Find the end-line, resuming where the last partial read left off
+  std::string endLine(CRLF "-------");
+  endLine += (const char *)tokens[1];
 
-  // read MIME until empty line or terminator
-  {
-    mime.RemoveAll();
-    PString line;
-    while (ReadLine(line, false)) {
-      if (line.IsEmpty())
-        break;
-      if (line.Find(terminator) == 0)
-        break;
-      mime.AddMIME(line);
+  std::string::size_type endPos = m_rxBuffer.find(endLine, std::max(startLineEnd, m_rxScanned));
+  if (endPos == std::string::npos) {
+    if (m_rxBuffer.size() - m_rxOffset > MaximumChunkSize) {
+      PTRACE(2, "MSRP\tMaximum chunk size exceeded");
+      return ParseFailed;
     }
+    if (m_rxBuffer.size() > endLine.size())
+      m_rxScanned = m_rxBuffer.size() - endLine.size();
+    return ParseIncomplete;
+  }
+
+  std::string::size_type flagPos = endPos + endLine.size();
+  if (flagPos + 3 > m_rxBuffer.size()) {
+    m_rxScanned = endPos;
+    return ParseIncomplete;
+  }
+
+  char flag = m_rxBuffer[flagPos];
+  if ((flag != '$' && flag != '+' && flag != '#') || m_rxBuffer.compare(flagPos+1, 2, CRLF) != 0) {
+    PTRACE(2, "MSRP\tMalformed end-line for transaction " << tokens[1]);
+    return ParseFailed;
   }
 
-  // determine what command was given
+  // Header block ends at an empty line, or at the end-line if there is no body
+  static const char BlankLine[] = CRLF CRLF;
+  std::string::const_iterator bufferStart = m_rxBuffer.begin();
+  std::string::size_type headerEnd = endPos;
+  std::string::size_type bodyStart = std::search(bufferStart + startLineEnd, bufferStart + endPos + 2, BlankLine, BlankLine+4) - bufferStart;
+  if (bodyStart < endPos) {
+    headerEnd = bodyStart;
+    bodyStart += 4;
+  }
+  else
+    bodyStart = endPos;
+
+  mime.RemoveAll();
+  std::string::size_type lineStart = startLineEnd + 2;
+  while (lineStart < headerEnd) {
+    std::string::size_type lineEnd = m_rxBuffer.find(CRLF, lineStart);
+    if (lineEnd == std::string::npos || lineEnd > headerEnd)
+      lineEnd = headerEnd;
+    mime.AddMIME(PString(m_rxBuffer.data() + lineStart, lineEnd - lineStart));
+    lineStart = lineEnd + 2;
+  }
+
+  // The body is copied once, directly out of the receive buffer
+  if (bodyStart < endPos)
+    body = PString(m_rxBuffer.data() + bodyStart, endPos - bodyStart);
+  else
+    body.MakeEmpty();
+
+  chunkId = tokens[1];
+
   command = NumCommands;
   for (PINDEX i = 0; i < NumCommands; ++i) {
     if (tokens[2] *= MSRPCommands[i]) {
@@ -973,37 +1289,16 @@ bool MSRPProtocol::ReadMessage(int & command,
       command = code;
   }
 
-  // handle SEND bodies
-  if ((command == SEND) && mime.Contains(PHTTP::ContentTypeTag)) {
-    for (;;) {
-      PString line;
-      if (!ReadLine(line)) {
-        PTRACE(2, "MSRP\tError while reading MSRP command body");
-        return false;
-      }
-      if (line.Find(terminator) == 0) {
-        break;
-      }
-      if ((body.GetSize() + line.GetLength()) > 10240) {
-        PTRACE(2, "MSRP\tMaximum body size exceeded");
-        return false;
-      }
-      body += line;
-    }
-  }
+  m_rxOffset = flagPos + 3;
+  m_rxScanned = 0;
 
-  {
-    PStringStream str; str << ::setfill('\r');
-    mime.PrintContents(str);
-    PTRACE(4, "Received MSRP message\n" << startLine << "\n" << str << body << terminator);
-  }
+  PTRACE_IF(3, flag == '#', "MSRP\tTransaction " << chunkId << " aborted by remote");
+  PTRACE(4, "MSRP\tReceived MSRP message " << startLine << ", body " << body.GetLength() << " bytes" << (flag == '+' ? ", more to follow" : ""));
 
-  return true;
+  return ParseComplete;
 }
 
 
-
-
 ////////////////////////////////////////////////////////
 
 #endif //  OPAL_HAS_MSRP
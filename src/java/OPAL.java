@@ -32,4 +32,30 @@ public class OPAL implements OPALConstants {
     OPALJNI.OpalFreeMessage(SWIGTYPE_p_OpalMessage.getCPtr(IN));
   }
 
+  public static SWIGTYPE_p_p_OpalMessage new_OpalMessageArray(int nelements) {
+    long cPtr = OPALJNI.new_OpalMessageArray(nelements);
+    return (cPtr == 0) ? null : new SWIGTYPE_p_p_OpalMessage(cPtr, false);
+  }
+
+  public static void delete_OpalMessageArray(SWIGTYPE_p_p_OpalMessage ary) {
+    OPALJNI.delete_OpalMessageArray(SWIGTYPE_p_p_OpalMessage.getCPtr(ary));
+  }
+
+  public static SWIGTYPE_p_OpalMessage OpalMessageArray_getitem(SWIGTYPE_p_p_OpalMessage ary, int index) {
+    long cPtr = OPALJNI.OpalMessageArray_getitem(SWIGTYPE_p_p_OpalMessage.getCPtr(ary), index);
+    return (cPtr == 0) ? null : new SWIGTYPE_p_OpalMessage(cPtr, false);
+  }
+
+  public static void OpalMessageArray_setitem(SWIGTYPE_p_p_OpalMessage ary, int index, SWIGTYPE_p_OpalMessage value) {
+    OPALJNI.OpalMessageArray_setitem(SWIGTYPE_p_p_OpalMessage.getCPtr(ary), index, SWIGTYPE_p_OpalMessage.getCPtr(value));
+  }
+
+  public static long OpalGetMessages(SWIGTYPE_p_OpalHandleStruct opal, SWIGTYPE_p_p_OpalMessage messages, long maxMessages, long timeout) {
+    return OPALJNI.OpalGetMessages(SWIGTYPE_p_OpalHandleStruct.getCPtr(opal), SWIGTYPE_p_p_OpalMessage.getCPtr(messages), maxMessages, timeout);
+  }
+
+  public static void OpalSignalMediaRing(OpalMediaRing ring) {
+    OPALJNI.OpalSignalMediaRing(OpalMediaRing.getCPtr(ring), ring);
+  }
+
 }
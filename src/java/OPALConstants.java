@@ -13,6 +13,8 @@ public interface OPALConstants {
   public final static String OPAL_INITIALISE_FUNCTION = OPALJNI.OPAL_INITIALISE_FUNCTION_get();
   public final static String OPAL_SHUTDOWN_FUNCTION = OPALJNI.OPAL_SHUTDOWN_FUNCTION_get();
   public final static String OPAL_GET_MESSAGE_FUNCTION = OPALJNI.OPAL_GET_MESSAGE_FUNCTION_get();
+  public final static String OPAL_GET_MESSAGES_FUNCTION = OPALJNI.OPAL_GET_MESSAGES_FUNCTION_get();
+  public final static String OPAL_SIGNAL_MEDIA_RING_FUNCTION = OPALJNI.OPAL_SIGNAL_MEDIA_RING_FUNCTION_get();
   public final static String OPAL_SEND_MESSAGE_FUNCTION = OPALJNI.OPAL_SEND_MESSAGE_FUNCTION_get();
   public final static String OPAL_FREE_MESSAGE_FUNCTION = OPALJNI.OPAL_FREE_MESSAGE_FUNCTION_get();
   public final static String OPAL_PREFIX_H323 = OPALJNI.OPAL_PREFIX_H323_get();
@@ -35,6 +37,7 @@ public interface OPALConstants {
   public final static String OPAL_PREFIX_SKINNY = OPALJNI.OPAL_PREFIX_SKINNY_get();
   public final static String OPAL_PREFIX_LYNC = OPALJNI.OPAL_PREFIX_LYNC_get();
   public final static String OPAL_PREFIX_ALL = OPALJNI.OPAL_PREFIX_ALL_get();
+  public final static int OPAL_MEDIA_RING_WRAP = OPALJNI.OPAL_MEDIA_RING_WRAP_get();
   public final static String OPAL_MWI_EVENT_PACKAGE = OPALJNI.OPAL_MWI_EVENT_PACKAGE_get();
   public final static String OPAL_LINE_APPEARANCE_EVENT_PACKAGE = OPALJNI.OPAL_LINE_APPEARANCE_EVENT_PACKAGE_get();
 }
@@ -14,10 +14,18 @@ public class OPALJNI {
   public final static native long OpalGetMessage(long jarg1, long jarg2);
   public final static native long OpalSendMessage(long jarg1, long jarg2);
   public final static native void OpalFreeMessage(long jarg1);
+  public final static native long new_OpalMessageArray(int jarg1);
+  public final static native void delete_OpalMessageArray(long jarg1);
+  public final static native long OpalMessageArray_getitem(long jarg1, int jarg2);
+  public final static native void OpalMessageArray_setitem(long jarg1, int jarg2, long jarg3);
   public final static native int OPAL_C_API_VERSION_get();
   public final static native String OPAL_INITIALISE_FUNCTION_get();
   public final static native String OPAL_SHUTDOWN_FUNCTION_get();
   public final static native String OPAL_GET_MESSAGE_FUNCTION_get();
+  public final static native long OpalGetMessages(long jarg1, long jarg2, long jarg3, long jarg4);
+  public final static native String OPAL_GET_MESSAGES_FUNCTION_get();
+  public final static native void OpalSignalMediaRing(long jarg1, OpalMediaRing jarg1_);
+  public final static native String OPAL_SIGNAL_MEDIA_RING_FUNCTION_get();
   public final static native String OPAL_SEND_MESSAGE_FUNCTION_get();
   public final static native String OPAL_FREE_MESSAGE_FUNCTION_get();
   public final static native String OPAL_PREFIX_H323_get();
@@ -40,6 +48,20 @@ public class OPALJNI {
   public final static native String OPAL_PREFIX_SKINNY_get();
   public final static native String OPAL_PREFIX_LYNC_get();
   public final static native String OPAL_PREFIX_ALL_get();
+  public final static native void OpalMediaRing_size_set(long jarg1, OpalMediaRing jarg1_, long jarg2);
+  public final static native long OpalMediaRing_size_get(long jarg1, OpalMediaRing jarg1_);
+  public final static native void OpalMediaRing_readPosition_set(long jarg1, OpalMediaRing jarg1_, long jarg2);
+  public final static native long OpalMediaRing_readPosition_get(long jarg1, OpalMediaRing jarg1_);
+  public final static native void OpalMediaRing_writePosition_set(long jarg1, OpalMediaRing jarg1_, long jarg2);
+  public final static native long OpalMediaRing_writePosition_get(long jarg1, OpalMediaRing jarg1_);
+  public final static native void OpalMediaRing_overruns_set(long jarg1, OpalMediaRing jarg1_, long jarg2);
+  public final static native long OpalMediaRing_overruns_get(long jarg1, OpalMediaRing jarg1_);
+  public final static native void OpalMediaRing_consumerWaiting_set(long jarg1, OpalMediaRing jarg1_, long jarg2);
+  public final static native long OpalMediaRing_consumerWaiting_get(long jarg1, OpalMediaRing jarg1_);
+  public final static native java.nio.ByteBuffer OpalMediaRing_data_get(long jarg1, OpalMediaRing jarg1_);
+  public final static native long new_OpalMediaRing();
+  public final static native void delete_OpalMediaRing(long jarg1);
+  public final static native int OPAL_MEDIA_RING_WRAP_get();
   public final static native void OpalParamGeneral_audioRecordDevice_set(long jarg1, OpalParamGeneral jarg1_, String jarg2);
   public final static native String OpalParamGeneral_audioRecordDevice_get(long jarg1, OpalParamGeneral jarg1_);
   public final static native void OpalParamGeneral_audioPlayerDevice_set(long jarg1, OpalParamGeneral jarg1_, String jarg2);
@@ -126,6 +148,8 @@ public class OPALJNI {
   public final static native String OpalParamGeneral_privateKey_get(long jarg1, OpalParamGeneral jarg1_);
   public final static native void OpalParamGeneral_autoCreateCertificate_set(long jarg1, OpalParamGeneral jarg1_, long jarg2);
   public final static native long OpalParamGeneral_autoCreateCertificate_get(long jarg1, OpalParamGeneral jarg1_);
+  public final static native void OpalParamGeneral_mediaRingSize_set(long jarg1, OpalParamGeneral jarg1_, long jarg2);
+  public final static native long OpalParamGeneral_mediaRingSize_get(long jarg1, OpalParamGeneral jarg1_);
   public final static native long new_OpalParamGeneral();
   public final static native void delete_OpalParamGeneral(long jarg1);
   public final static native void OpalProductDescription_vendor_set(long jarg1, OpalProductDescription jarg1_, String jarg2);
@@ -280,6 +304,8 @@ public class OPALJNI {
   public final static native int OpalStatusMediaStream_volume_get(long jarg1, OpalStatusMediaStream jarg1_);
   public final static native void OpalStatusMediaStream_watermark_set(long jarg1, OpalStatusMediaStream jarg1_, String jarg2);
   public final static native String OpalStatusMediaStream_watermark_get(long jarg1, OpalStatusMediaStream jarg1_);
+  public final static native void OpalStatusMediaStream_mediaRing_set(long jarg1, OpalStatusMediaStream jarg1_, long jarg2, OpalMediaRing jarg2_);
+  public final static native long OpalStatusMediaStream_mediaRing_get(long jarg1, OpalStatusMediaStream jarg1_);
   public final static native long new_OpalStatusMediaStream();
   public final static native void delete_OpalStatusMediaStream(long jarg1);
   public final static native void OpalParamSetUserData_callToken_set(long jarg1, OpalParamSetUserData jarg1_, String jarg2);
@@ -0,0 +1,86 @@
+/* ----------------------------------------------------------------------------
+ * This file was automatically generated by SWIG (http://www.swig.org).
+ * Version 3.0.7
+ *
+ * Do not make changes to this file unless you know what you are doing--modify
+ * the SWIG interface file instead.
+ * ----------------------------------------------------------------------------- */
+
+package org.opalvoip.opal;
+
+public class OpalMediaRing {
+  private transient long swigCPtr;
+  protected transient boolean swigCMemOwn;
+
+  protected OpalMediaRing(long cPtr, boolean cMemoryOwn) {
+    swigCMemOwn = cMemoryOwn;
+    swigCPtr = cPtr;
+  }
+
+  protected static long getCPtr(OpalMediaRing obj) {
+    return (obj == null) ? 0 : obj.swigCPtr;
+  }
+
+  protected void finalize() {
+    delete();
+  }
+
+  public synchronized void delete() {
+    if (swigCPtr != 0) {
+      if (swigCMemOwn) {
+        swigCMemOwn = false;
+        OPALJNI.delete_OpalMediaRing(swigCPtr);
+      }
+      swigCPtr = 0;
+    }
+  }
+
+  public void setSize(long value) {
+    OPALJNI.OpalMediaRing_size_set(swigCPtr, this, value);
+  }
+
+  public long getSize() {
+    return OPALJNI.OpalMediaRing_size_get(swigCPtr, this);
+  }
+
+  public void setReadPosition(long value) {
+    OPALJNI.OpalMediaRing_readPosition_set(swigCPtr, this, value);
+  }
+
+  public long getReadPosition() {
+    return OPALJNI.OpalMediaRing_readPosition_get(swigCPtr, this);
+  }
+
+  public void setWritePosition(long value) {
+    OPALJNI.OpalMediaRing_writePosition_set(swigCPtr, this, value);
+  }
+
+  public long getWritePosition() {
+    return OPALJNI.OpalMediaRing_writePosition_get(swigCPtr, this);
+  }
+
+  public void setOverruns(long value) {
+    OPALJNI.OpalMediaRing_overruns_set(swigCPtr, this, value);
+  }
+
+  public long getOverruns() {
+    return OPALJNI.OpalMediaRing_overruns_get(swigCPtr, this);
+  }
+
+  public void setConsumerWaiting(long value) {
+    OPALJNI.OpalMediaRing_consumerWaiting_set(swigCPtr, this, value);
+  }
+
+  public long getConsumerWaiting() {
+    return OPALJNI.OpalMediaRing_consumerWaiting_get(swigCPtr, this);
+  }
+
+  public java.nio.ByteBuffer getData() {
+    return OPALJNI.OpalMediaRing_data_get(swigCPtr, this);
+  }
+
+  public OpalMediaRing() {
+    this(OPALJNI.new_OpalMediaRing(), true);
+  }
+
+}
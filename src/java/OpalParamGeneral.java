@@ -382,6 +382,14 @@ public class OpalParamGeneral {
     return OPALJNI.OpalParamGeneral_autoCreateCertificate_get(swigCPtr, this);
   }
 
+  public void setMediaRingSize(long value) {
+    OPALJNI.OpalParamGeneral_mediaRingSize_set(swigCPtr, this, value);
+  }
+
+  public long getMediaRingSize() {
+    return OPALJNI.OpalParamGeneral_mediaRingSize_get(swigCPtr, this);
+  }
+
   public OpalParamGeneral() {
     this(OPALJNI.new_OpalParamGeneral(), true);
   }
@@ -91,6 +91,15 @@ public class OpalStatusMediaStream {
     return OPALJNI.OpalStatusMediaStream_watermark_get(swigCPtr, this);
   }
 
+  public void setMediaRing(OpalMediaRing value) {
+    OPALJNI.OpalStatusMediaStream_mediaRing_set(swigCPtr, this, OpalMediaRing.getCPtr(value), value);
+  }
+
+  public OpalMediaRing getMediaRing() {
+    long cPtr = OPALJNI.OpalStatusMediaStream_mediaRing_get(swigCPtr, this);
+    return (cPtr == 0) ? null : new OpalMediaRing(cPtr, false);
+  }
+
   public OpalStatusMediaStream() {
     this(OPALJNI.new_OpalStatusMediaStream(), true);
   }
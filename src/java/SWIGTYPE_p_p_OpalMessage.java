@@ -0,0 +1,26 @@
+/* ----------------------------------------------------------------------------
+ * This file was automatically generated by SWIG (http://www.swig.org).
+ * Version 3.0.7
+ *
+ * Do not make changes to this file unless you know what you are doing--modify
+ * the SWIG interface file instead.
+ * ----------------------------------------------------------------------------- */
+
+package org.opalvoip.opal;
+
+public class SWIGTYPE_p_p_OpalMessage {
+  private transient long swigCPtr;
+
+  protected SWIGTYPE_p_p_OpalMessage(long cPtr, @SuppressWarnings("unused") boolean futureUse) {
+    swigCPtr = cPtr;
+  }
+
+  protected SWIGTYPE_p_p_OpalMessage() {
+    swigCPtr = 0;
+  }
+
+  protected static long getCPtr(SWIGTYPE_p_p_OpalMessage obj) {
+    return (obj == null) ? 0 : obj.swigCPtr;
+  }
+}
+
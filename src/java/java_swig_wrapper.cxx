@@ -229,6 +229,22 @@ static void SWIGUNUSED SWIG_JavaThrowException(JNIEnv *jenv, SWIG_JavaExceptionC
     int opal_java_swig_wrapper_link;
   
 
+static OpalMessage * *new_OpalMessageArray(int nelements) { 
+  return (new OpalMessage *[nelements]());
+}
+
+static void delete_OpalMessageArray(OpalMessage * *ary) { 
+  delete [] ary;
+}
+
+static OpalMessage * OpalMessageArray_getitem(OpalMessage * *ary, int index) {
+    return ary[index];
+}
+static void OpalMessageArray_setitem(OpalMessage * *ary, int index, OpalMessage * value) {
+    ary[index] = value;
+}
+
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -320,13 +336,67 @@ SWIGEXPORT void JNICALL Java_org_opalvoip_opal_OPALJNI_OpalFreeMessage(JNIEnv *j
 }
 
 
+SWIGEXPORT jlong JNICALL Java_org_opalvoip_opal_OPALJNI_new_1OpalMessageArray(JNIEnv *jenv, jclass jcls, jint jarg1) {
+  jlong jresult = 0 ;
+  int arg1 ;
+  OpalMessage **result = 0 ;
+  
+  (void)jenv;
+  (void)jcls;
+  arg1 = (int)jarg1; 
+  result = (OpalMessage **)new_OpalMessageArray(arg1);
+  *(OpalMessage ***)&jresult = result; 
+  return jresult;
+}
+
+
+SWIGEXPORT void JNICALL Java_org_opalvoip_opal_OPALJNI_delete_1OpalMessageArray(JNIEnv *jenv, jclass jcls, jlong jarg1) {
+  OpalMessage **arg1 = (OpalMessage **) 0 ;
+  
+  (void)jenv;
+  (void)jcls;
+  arg1 = *(OpalMessage ***)&jarg1; 
+  delete_OpalMessageArray(arg1);
+}
+
+
+SWIGEXPORT jlong JNICALL Java_org_opalvoip_opal_OPALJNI_OpalMessageArray_1getitem(JNIEnv *jenv, jclass jcls, jlong jarg1, jint jarg2) {
+  jlong jresult = 0 ;
+  OpalMessage **arg1 = (OpalMessage **) 0 ;
+  int arg2 ;
+  OpalMessage *result = 0 ;
+  
+  (void)jenv;
+  (void)jcls;
+  arg1 = *(OpalMessage ***)&jarg1; 
+  arg2 = (int)jarg2; 
+  result = (OpalMessage *)OpalMessageArray_getitem(arg1,arg2);
+  *(OpalMessage **)&jresult = result; 
+  return jresult;
+}
+
+
+SWIGEXPORT void JNICALL Java_org_opalvoip_opal_OPALJNI_OpalMessageArray_1setitem(JNIEnv *jenv, jclass jcls, jlong jarg1, jint jarg2, jlong jarg3) {
+  OpalMessage **arg1 = (OpalMessage **) 0 ;
+  int arg2 ;
+  OpalMessage *arg3 = (OpalMessage *) 0 ;
+  
+  (void)jenv;
+  (void)jcls;
+  arg1 = *(OpalMessage ***)&jarg1; 
+  arg2 = (int)jarg2; 
+  arg3 = *(OpalMessage **)&jarg3; 
+  OpalMessageArray_setitem(arg1,arg2,arg3);
+}
+
+
 SWIGEXPORT jint JNICALL Java_org_opalvoip_opal_OPALJNI_OPAL_1C_1API_1VERSION_1get(JNIEnv *jenv, jclass jcls) {
   jint jresult = 0 ;
   int result;
   
   (void)jenv;
   (void)jcls;
-  result = (int)(36);
+  result = (int)(37);
   jresult = (jint)result; 
   return jresult;
 }
@@ -368,6 +438,61 @@ SWIGEXPORT jstring JNICALL Java_org_opalvoip_opal_OPALJNI_OPAL_1GET_1MESSAGE_1FU
 }
 
 
+SWIGEXPORT jlong JNICALL Java_org_opalvoip_opal_OPALJNI_OpalGetMessages(JNIEnv *jenv, jclass jcls, jlong jarg1, jlong jarg2, jlong jarg3, jlong jarg4) {
+  jlong jresult = 0 ;
+  OpalHandle arg1 = (OpalHandle) 0 ;
+  OpalMessage **arg2 = (OpalMessage **) 0 ;
+  unsigned int arg3 ;
+  unsigned int arg4 ;
+  unsigned int result;
+  
+  (void)jenv;
+  (void)jcls;
+  arg1 = *(OpalHandle *)&jarg1; 
+  arg2 = *(OpalMessage ***)&jarg2; 
+  arg3 = (unsigned int)jarg3; 
+  arg4 = (unsigned int)jarg4; 
+  result = (unsigned int)OpalGetMessages(arg1,arg2,arg3,arg4);
+  jresult = (jlong)result; 
+  return jresult;
+}
+
+
+SWIGEXPORT jstring JNICALL Java_org_opalvoip_opal_OPALJNI_OPAL_1GET_1MESSAGES_1FUNCTION_1get(JNIEnv *jenv, jclass jcls) {
+  jstring jresult = 0 ;
+  char *result = 0 ;
+  
+  (void)jenv;
+  (void)jcls;
+  result = (char *)("OpalGetMessages");
+  if (result) jresult = jenv->NewStringUTF((const char *)result);
+  return jresult;
+}
+
+
+SWIGEXPORT void JNICALL Java_org_opalvoip_opal_OPALJNI_OpalSignalMediaRing(JNIEnv *jenv, jclass jcls, jlong jarg1, jobject jarg1_) {
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  
+  (void)jenv;
+  (void)jcls;
+  (void)jarg1_;
+  arg1 = *(OpalMediaRing **)&jarg1; 
+  OpalSignalMediaRing(arg1);
+}
+
+
+SWIGEXPORT jstring JNICALL Java_org_opalvoip_opal_OPALJNI_OPAL_1SIGNAL_1MEDIA_1RING_1FUNCTION_1get(JNIEnv *jenv, jclass jcls) {
+  jstring jresult = 0 ;
+  char *result = 0 ;
+  
+  (void)jenv;
+  (void)jcls;
+  result = (char *)("OpalSignalMediaRing");
+  if (result) jresult = jenv->NewStringUTF((const char *)result);
+  return jresult;
+}
+
+
 SWIGEXPORT jstring JNICALL Java_org_opalvoip_opal_OPALJNI_OPAL_1SEND_1MESSAGE_1FUNCTION_1get(JNIEnv *jenv, jclass jcls) {
   jstring jresult = 0 ;
   char *result = 0 ;
@@ -632,6 +757,195 @@ SWIGEXPORT jstring JNICALL Java_org_opalvoip_opal_OPALJNI_OPAL_1PREFIX_1ALL_1get
 }
 
 
+SWIGEXPORT void JNICALL Java_org_opalvoip_opal_OPALJNI_OpalMediaRing_1size_1set(JNIEnv *jenv, jclass jcls, jlong jarg1, jobject jarg1_, jlong jarg2) {
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  unsigned int arg2 ;
+  
+  (void)jenv;
+  (void)jcls;
+  (void)jarg1_;
+  arg1 = *(OpalMediaRing **)&jarg1; 
+  arg2 = (unsigned int)jarg2; 
+  if (arg1) (arg1)->m_size = arg2;
+}
+
+
+SWIGEXPORT jlong JNICALL Java_org_opalvoip_opal_OPALJNI_OpalMediaRing_1size_1get(JNIEnv *jenv, jclass jcls, jlong jarg1, jobject jarg1_) {
+  jlong jresult = 0 ;
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  unsigned int result;
+  
+  (void)jenv;
+  (void)jcls;
+  (void)jarg1_;
+  arg1 = *(OpalMediaRing **)&jarg1; 
+  result = (unsigned int) ((arg1)->m_size);
+  jresult = (jlong)result; 
+  return jresult;
+}
+
+
+SWIGEXPORT void JNICALL Java_org_opalvoip_opal_OPALJNI_OpalMediaRing_1readPosition_1set(JNIEnv *jenv, jclass jcls, jlong jarg1, jobject jarg1_, jlong jarg2) {
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  unsigned int arg2 ;
+  
+  (void)jenv;
+  (void)jcls;
+  (void)jarg1_;
+  arg1 = *(OpalMediaRing **)&jarg1; 
+  arg2 = (unsigned int)jarg2; 
+  if (arg1) (arg1)->m_readPosition = arg2;
+}
+
+
+SWIGEXPORT jlong JNICALL Java_org_opalvoip_opal_OPALJNI_OpalMediaRing_1readPosition_1get(JNIEnv *jenv, jclass jcls, jlong jarg1, jobject jarg1_) {
+  jlong jresult = 0 ;
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  unsigned int result;
+  
+  (void)jenv;
+  (void)jcls;
+  (void)jarg1_;
+  arg1 = *(OpalMediaRing **)&jarg1; 
+  result = (unsigned int) ((arg1)->m_readPosition);
+  jresult = (jlong)result; 
+  return jresult;
+}
+
+
+SWIGEXPORT void JNICALL Java_org_opalvoip_opal_OPALJNI_OpalMediaRing_1writePosition_1set(JNIEnv *jenv, jclass jcls, jlong jarg1, jobject jarg1_, jlong jarg2) {
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  unsigned int arg2 ;
+  
+  (void)jenv;
+  (void)jcls;
+  (void)jarg1_;
+  arg1 = *(OpalMediaRing **)&jarg1; 
+  arg2 = (unsigned int)jarg2; 
+  if (arg1) (arg1)->m_writePosition = arg2;
+}
+
+
+SWIGEXPORT jlong JNICALL Java_org_opalvoip_opal_OPALJNI_OpalMediaRing_1writePosition_1get(JNIEnv *jenv, jclass jcls, jlong jarg1, jobject jarg1_) {
+  jlong jresult = 0 ;
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  unsigned int result;
+  
+  (void)jenv;
+  (void)jcls;
+  (void)jarg1_;
+  arg1 = *(OpalMediaRing **)&jarg1; 
+  result = (unsigned int) ((arg1)->m_writePosition);
+  jresult = (jlong)result; 
+  return jresult;
+}
+
+
+SWIGEXPORT void JNICALL Java_org_opalvoip_opal_OPALJNI_OpalMediaRing_1overruns_1set(JNIEnv *jenv, jclass jcls, jlong jarg1, jobject jarg1_, jlong jarg2) {
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  unsigned int arg2 ;
+  
+  (void)jenv;
+  (void)jcls;
+  (void)jarg1_;
+  arg1 = *(OpalMediaRing **)&jarg1; 
+  arg2 = (unsigned int)jarg2; 
+  if (arg1) (arg1)->m_overruns = arg2;
+}
+
+
+SWIGEXPORT jlong JNICALL Java_org_opalvoip_opal_OPALJNI_OpalMediaRing_1overruns_1get(JNIEnv *jenv, jclass jcls, jlong jarg1, jobject jarg1_) {
+  jlong jresult = 0 ;
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  unsigned int result;
+  
+  (void)jenv;
+  (void)jcls;
+  (void)jarg1_;
+  arg1 = *(OpalMediaRing **)&jarg1; 
+  result = (unsigned int) ((arg1)->m_overruns);
+  jresult = (jlong)result; 
+  return jresult;
+}
+
+
+SWIGEXPORT void JNICALL Java_org_opalvoip_opal_OPALJNI_OpalMediaRing_1consumerWaiting_1set(JNIEnv *jenv, jclass jcls, jlong jarg1, jobject jarg1_, jlong jarg2) {
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  unsigned int arg2 ;
+  
+  (void)jenv;
+  (void)jcls;
+  (void)jarg1_;
+  arg1 = *(OpalMediaRing **)&jarg1; 
+  arg2 = (unsigned int)jarg2; 
+  if (arg1) (arg1)->m_consumerWaiting = arg2;
+}
+
+
+SWIGEXPORT jlong JNICALL Java_org_opalvoip_opal_OPALJNI_OpalMediaRing_1consumerWaiting_1get(JNIEnv *jenv, jclass jcls, jlong jarg1, jobject jarg1_) {
+  jlong jresult = 0 ;
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  unsigned int result;
+  
+  (void)jenv;
+  (void)jcls;
+  (void)jarg1_;
+  arg1 = *(OpalMediaRing **)&jarg1; 
+  result = (unsigned int) ((arg1)->m_consumerWaiting);
+  jresult = (jlong)result; 
+  return jresult;
+}
+
+
+SWIGEXPORT jobject JNICALL Java_org_opalvoip_opal_OPALJNI_OpalMediaRing_1data_1get(JNIEnv *jenv, jclass jcls, jlong jarg1, jobject jarg1_) {
+  jobject jresult = 0 ;
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  unsigned char *result = 0 ;
+  
+  (void)jenv;
+  (void)jcls;
+  (void)jarg1_;
+  arg1 = *(OpalMediaRing **)&jarg1; 
+  result = (unsigned char *) ((arg1)->m_data);
+  jresult = jenv->NewDirectByteBuffer(result, arg1->m_size); 
+  return jresult;
+}
+
+
+SWIGEXPORT jlong JNICALL Java_org_opalvoip_opal_OPALJNI_new_1OpalMediaRing(JNIEnv *jenv, jclass jcls) {
+  jlong jresult = 0 ;
+  OpalMediaRing *result = 0 ;
+  
+  (void)jenv;
+  (void)jcls;
+  result = (OpalMediaRing *)new OpalMediaRing();
+  *(OpalMediaRing **)&jresult = result; 
+  return jresult;
+}
+
+
+SWIGEXPORT void JNICALL Java_org_opalvoip_opal_OPALJNI_delete_1OpalMediaRing(JNIEnv *jenv, jclass jcls, jlong jarg1) {
+  OpalMediaRing *arg1 = (OpalMediaRing *) 0 ;
+  
+  (void)jenv;
+  (void)jcls;
+  arg1 = *(OpalMediaRing **)&jarg1; 
+  delete arg1;
+}
+
+
+SWIGEXPORT jint JNICALL Java_org_opalvoip_opal_OPALJNI_OPAL_1MEDIA_1RING_1WRAP_1get(JNIEnv *jenv, jclass jcls) {
+  jint jresult = 0 ;
+  int result;
+  
+  (void)jenv;
+  (void)jcls;
+  result = (int)(0xffffffff);
+  jresult = (jint)result; 
+  return jresult;
+}
+
+
 SWIGEXPORT void JNICALL Java_org_opalvoip_opal_OPALJNI_OpalParamGeneral_1audioRecordDevice_1set(JNIEnv *jenv, jclass jcls, jlong jarg1, jobject jarg1_, jstring jarg2) {
   OpalParamGeneral *arg1 = (OpalParamGeneral *) 0 ;
   char *arg2 = (char *) 0 ;
@@ -2028,6 +2342,34 @@ SWIGEXPORT jlong JNICALL Java_org_opalvoip_opal_OPALJNI_OpalParamGeneral_1autoCr
 }
 
 
+SWIGEXPORT void JNICALL Java_org_opalvoip_opal_OPALJNI_OpalParamGeneral_1mediaRingSize_1set(JNIEnv *jenv, jclass jcls, jlong jarg1, jobject jarg1_, jlong jarg2) {
+  OpalParamGeneral *arg1 = (OpalParamGeneral *) 0 ;
+  unsigned int arg2 ;
+  
+  (void)jenv;
+  (void)jcls;
+  (void)jarg1_;
+  arg1 = *(OpalParamGeneral **)&jarg1; 
+  arg2 = (unsigned int)jarg2; 
+  if (arg1) (arg1)->m_mediaRingSize = arg2;
+}
+
+
+SWIGEXPORT jlong JNICALL Java_org_opalvoip_opal_OPALJNI_OpalParamGeneral_1mediaRingSize_1get(JNIEnv *jenv, jclass jcls, jlong jarg1, jobject jarg1_) {
+  jlong jresult = 0 ;
+  OpalParamGeneral *arg1 = (OpalParamGeneral *) 0 ;
+  unsigned int result;
+  
+  (void)jenv;
+  (void)jcls;
+  (void)jarg1_;
+  arg1 = *(OpalParamGeneral **)&jarg1; 
+  result = (unsigned int) ((arg1)->m_mediaRingSize);
+  jresult = (jlong)result; 
+  return jresult;
+}
+
+
 SWIGEXPORT jlong JNICALL Java_org_opalvoip_opal_OPALJNI_new_1OpalParamGeneral(JNIEnv *jenv, jclass jcls) {
   jlong jresult = 0 ;
   OpalParamGeneral *result = 0 ;
@@ -4697,6 +5039,35 @@ SWIGEXPORT jstring JNICALL Java_org_opalvoip_opal_OPALJNI_OpalStatusMediaStream_
 }
 
 
+SWIGEXPORT void JNICALL Java_org_opalvoip_opal_OPALJNI_OpalStatusMediaStream_1mediaRing_1set(JNIEnv *jenv, jclass jcls, jlong jarg1, jobject jarg1_, jlong jarg2, jobject jarg2_) {
+  OpalStatusMediaStream *arg1 = (OpalStatusMediaStream *) 0 ;
+  OpalMediaRing *arg2 = (OpalMediaRing *) 0 ;
+  
+  (void)jenv;
+  (void)jcls;
+  (void)jarg1_;
+  (void)jarg2_;
+  arg1 = *(OpalStatusMediaStream **)&jarg1; 
+  arg2 = *(OpalMediaRing **)&jarg2; 
+  if (arg1) (arg1)->m_mediaRing = arg2;
+}
+
+
+SWIGEXPORT jlong JNICALL Java_org_opalvoip_opal_OPALJNI_OpalStatusMediaStream_1mediaRing_1get(JNIEnv *jenv, jclass jcls, jlong jarg1, jobject jarg1_) {
+  jlong jresult = 0 ;
+  OpalStatusMediaStream *arg1 = (OpalStatusMediaStream *) 0 ;
+  OpalMediaRing *result = 0 ;
+  
+  (void)jenv;
+  (void)jcls;
+  (void)jarg1_;
+  arg1 = *(OpalStatusMediaStream **)&jarg1; 
+  result = (OpalMediaRing *) ((arg1)->m_mediaRing);
+  *(OpalMediaRing **)&jresult = result; 
+  return jresult;
+}
+
+
 SWIGEXPORT jlong JNICALL Java_org_opalvoip_opal_OPALJNI_new_1OpalStatusMediaStream(JNIEnv *jenv, jclass jcls) {
   jlong jresult = 0 ;
   OpalStatusMediaStream *result = 0 ;
@@ -17,5 +17,17 @@
   OpalMessage * OpalSendMessage(OpalHandle IN, const OpalMessage * IN);
   void OpalFreeMessage(OpalMessage * IN);
 
+  // Array of message pointers for OpalGetMessages()
+  %include "carrays.i"
+  %array_functions(OpalMessage *, OpalMessageArray);
+
+  // Media ring data is a direct ByteBuffer on the shared memory, not a copy
+  %immutable OpalMediaRing::m_data;
+  %typemap(jni)     unsigned char * m_data "jobject"
+  %typemap(jtype)   unsigned char * m_data "java.nio.ByteBuffer"
+  %typemap(jstype)  unsigned char * m_data "java.nio.ByteBuffer"
+  %typemap(javaout) unsigned char * m_data { return $jnicall; }
+  %typemap(out)     unsigned char * m_data %{ $result = jenv->NewDirectByteBuffer($1, arg1->m_size); %}
+
   /* Parse the header file to generate wrappers */
   %include "opal.h"
@@ -451,6 +451,7 @@ bool OpalCall::Transfer(const PString & newAddress, OpalConnection * connection)
 OpalMediaFormatList OpalCall::GetMediaFormats(const OpalConnection & connection)
 {
   OpalMediaFormatList commonFormats;
+  OpalMediaFormatSet commonSet;
 
   bool first = true;
   const OpalMediaTypeList allMediaTypes = OpalMediaType::GetList();
@@ -475,19 +476,17 @@ OpalMediaFormatList OpalCall::GetMediaFormats(const OpalConnection & connection)
     }
     if (first) {
       commonFormats = possibleFormats;
+      commonSet += possibleFormats;
       first = false;
     }
     else {
       // Want intersection of the possible formats for all connections.
-      for (OpalMediaFormatList::iterator format = commonFormats.begin(); format != commonFormats.end(); ) {
-        if (possibleFormats.HasFormat(*format))
-          ++format;
-        else
-          commonFormats.erase(format++);
-      }
+      commonSet &= OpalMediaFormatSet(possibleFormats);
     }
   }
 
+  commonSet.RemoveMissing(commonFormats);
+
   connection.AdjustMediaFormats(true, NULL, commonFormats);
 
   PTRACE(4, "GetMediaFormats for " << connection << "\n    "
@@ -135,6 +135,8 @@ OpalConnection::OpalConnection(OpalCall & call,
   , m_jitterParams(m_endpoint.GetManager().GetJitterParameters())
   , m_rxBandwidthAvailable(m_endpoint.GetInitialBandwidth(OpalBandwidth::Rx))
   , m_txBandwidthAvailable(m_endpoint.GetInitialBandwidth(OpalBandwidth::Tx))
+  , m_lastCallProgress(OpalToneDetector::NoCallProgress)
+  , m_detectInBandTones(false)
   , m_dtmfScaleMultiplier(1)
   , m_dtmfScaleDivisor(1)
   , m_dtmfDetectNotifier(PCREATE_NOTIFIER(OnDetectInBandDTMF))
@@ -1057,7 +1059,7 @@ void OpalConnection::OnPatchMediaStream(PBoolean isSource, OpalMediaPatch & patc
     }
 
 #if OPAL_PTLIB_DTMF
-    if (m_detectInBandDTMF && isSource) {
+    if ((m_detectInBandDTMF || m_detectInBandTones) && isSource) {
       patch.AddFilter(m_dtmfDetectNotifier, OpalPCM16);
       PTRACE(4, "Added detect DTMF filter on connection " << *this << ", patch " << patch);
     }
@@ -1409,6 +1411,12 @@ void OpalConnection::OnUserInputTone(char tone, unsigned duration)
 }
 
 
+void OpalConnection::OnDetectedCallProgress(OpalToneDetector::CallProgress PTRACE_PARAM(progress))
+{
+  PTRACE(3, "Call progress tone \"" << progress << "\" detected on " << *this);
+}
+
+
 PString OpalConnection::GetUserInput(unsigned timeout)
 {
   PString reply;
@@ -1452,11 +1460,27 @@ void OpalConnection::OnDetectInBandDTMF(RTP_DataFrame & frame, P_INT_PTR)
   // This allows us to access the 16 bit PCM audio (at 8Khz sample rate)
   // before the audio is passed on to the sound card (or other output device)
 
-  // Pass the 16 bit PCM audio through the DTMF decoder
-  PString tones = m_dtmfDecoder.Decode((const short *)frame.GetPayloadPtr(),
-                                       frame.GetPayloadSize()/sizeof(short),
-                                       m_dtmfScaleMultiplier,
-                                       m_dtmfScaleDivisor);
+  // Pass the 16 bit PCM audio through the DTMF decoder, or our own tone detector
+  PString tones;
+  if (m_detectInBandTones) {
+    tones = m_toneDetector.Detect((const short *)frame.GetPayloadPtr(),
+                                  frame.GetPayloadSize()/sizeof(short),
+                                  m_dtmfScaleMultiplier,
+                                  m_dtmfScaleDivisor);
+
+    OpalToneDetector::CallProgress progress = m_toneDetector.GetCallProgress();
+    if (progress != m_lastCallProgress) {
+      m_lastCallProgress = progress;
+      GetEndPoint().GetManager().QueueDecoupledEvent(new PSafeWorkArg1<OpalConnection, OpalToneDetector::CallProgress>(
+                            this, progress, &OpalConnection::OnDetectedCallProgress));
+    }
+  }
+  else
+    tones = m_dtmfDecoder.Decode((const short *)frame.GetPayloadPtr(),
+                                 frame.GetPayloadSize()/sizeof(short),
+                                 m_dtmfScaleMultiplier,
+                                 m_dtmfScaleDivisor);
+
   if (!tones.IsEmpty()) {
     PTRACE(3, "DTMF detected: \"" << tones << '"');
     for (PINDEX i = 0; i < tones.GetLength(); i++)
@@ -1714,6 +1738,7 @@ void OpalConnection::OnApplyStringOptions()
 #if OPAL_PTLIB_DTMF
     m_sendInBandDTMF   = m_stringOptions.GetBoolean(OPAL_OPT_ENABLE_INBAND_DTMF, m_sendInBandDTMF);
     m_detectInBandDTMF = m_stringOptions.GetBoolean(OPAL_OPT_DETECT_INBAND_DTMF, m_detectInBandDTMF);
+    m_detectInBandTones = m_stringOptions.GetBoolean(OPAL_OPT_DETECT_INBAND_TONES, m_detectInBandTones);
     m_sendInBandDTMF   = m_stringOptions.GetBoolean(OPAL_OPT_SEND_INBAND_DTMF,   m_sendInBandDTMF);
 
     m_dtmfScaleMultiplier = m_stringOptions.GetInteger(OPAL_OPT_DTMF_MULT, m_dtmfScaleMultiplier);
@@ -1934,7 +1934,8 @@ PString OpalConsoleManager::GetArgumentSpec() const
 
          "[Audio options:]"
          "-jitter:           Set audio jitter buffer size (min[,max] default 50,250)\n"
-         "-silence-detect:   Set audio silence detect mode (\"none\", \"fixed\" or default \"adaptive\")\n"
+         "-silence-detect:   Set audio silence detect mode (\"none\", \"fixed\", \"spectral\" or default \"adaptive\")\n"
+         "-comfort-noise.    Play comfort noise rather than silence when remote stops sending.\n"
          "-no-inband-detect. Disable detection of in-band tones.\n";
 
 #if OPAL_VIDEO
@@ -2123,11 +2124,19 @@ bool OpalConsoleManager::Initialise(PArgList & args, bool verbose, const PString
       params.m_mode = OpalSilenceDetector::AdaptiveSilenceDetection;
     else if (arg.NumCompare("fixed") == EqualTo)
       params.m_mode = OpalSilenceDetector::FixedSilenceDetection;
+    else if (arg.NumCompare("spectral") == EqualTo)
+      params.m_mode = OpalSilenceDetector::SpectralSilenceDetection;
     else
       params.m_mode = OpalSilenceDetector::NoSilenceDetection;
     SetSilenceDetectParams(params);
   }
 
+  if (args.HasOption("comfort-noise")) {
+    OpalSilenceDetector::Params params = GetSilenceDetectParams();
+    params.m_comfortNoise = true;
+    SetSilenceDetectParams(params);
+  }
+
   if (args.HasOption("no-inband-detect"))
     DisableDetectInBandDTMF(true);
 
@@ -2953,7 +2962,7 @@ bool OpalManagerCLI::Initialise(PArgList & args, bool verbose, const PString & d
 #endif // OPAL_HAS_MIXER
 
   m_cli->SetCommand("audio vad", PCREATE_NOTIFIER(CmdSilenceDetect),
-                    "Voice Activity Detection (aka Silence Detection)", "\"on\" | \"adaptive\" | <level>");
+                    "Voice Activity Detection (aka Silence Detection)", "\"on\" | \"adaptive\" | \"spectral\" | <level>");
   m_cli->SetCommand("audio in-band-dtmf-disable", m_disableDetectInBandDTMF, "In-band (digital filter) DTMF detection");
 
   m_cli->SetCommand("auto-start", PCREATE_NOTIFIER(CmdAutoStart),
@@ -3619,6 +3628,8 @@ void OpalManagerCLI::CmdSilenceDetect(PCLI::Arguments & args, P_INT_PTR)
       params.m_mode = OpalSilenceDetector::NoSilenceDetection;
     else if (PConstCaselessString("adaptive").NumCompare(args[0]) == EqualTo)
       params.m_mode = OpalSilenceDetector::AdaptiveSilenceDetection;
+    else if (PConstCaselessString("spectral").NumCompare(args[0]) == EqualTo)
+      params.m_mode = OpalSilenceDetector::SpectralSilenceDetection;
     else if (args[0].FindSpan("0123456789") == P_MAX_INDEX) {
       params.m_mode = OpalSilenceDetector::FixedSilenceDetection;
       params.m_threshold = args[0].AsUnsigned();
@@ -3644,6 +3655,12 @@ void OpalManagerCLI::CmdSilenceDetect(PCLI::Arguments & args, P_INT_PTR)
              "silence deadband=" << params.m_silenceDeadband;
       break;
 
+    case OpalSilenceDetector::SpectralSilenceDetection:
+      out << "SPECTRAL, "
+             "signal deadband=" << params.m_signalDeadband << ", "
+             "silence deadband=" << params.m_silenceDeadband;
+      break;
+
     default :
       out << "OFF";
   }
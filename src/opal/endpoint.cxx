@@ -39,6 +39,10 @@
 #include <opal/call.h>
 #include <rtp/rtp_session.h>
 
+#if OPAL_PTLIB_SSL
+  #include <ptclib/pssl.h>
+#endif
+
 static const OpalBandwidth DefaultInitialBandwidth = 4000000; // 4Mb/s
 
 #define new PNEW
@@ -55,6 +59,7 @@ OpalEndPoint::OpalEndPoint(OpalManager & mgr,
   , m_prefixName(prefix)
   , m_attributes(attributes)
   , m_maxSizeUDP(4096)
+  , m_receiveThreadsUDP(1)
   , m_productInfo(mgr.GetProductInfo())
   , m_defaultLocalPartyName(mgr.GetDefaultUserName())
   , m_defaultDisplayName(mgr.GetDefaultDisplayName())
@@ -64,6 +69,10 @@ OpalEndPoint::OpalEndPoint(OpalManager & mgr,
 {
   m_manager.AttachEndPoint(this);
 
+#if OPAL_PTLIB_SSL
+  m_sslContext[false] = m_sslContext[true] = NULL;
+#endif
+
   if (m_defaultLocalPartyName.IsEmpty())
     m_defaultLocalPartyName = PProcess::Current().GetName() & "User";
 
@@ -73,6 +82,13 @@ OpalEndPoint::OpalEndPoint(OpalManager & mgr,
 
 OpalEndPoint::~OpalEndPoint()
 {
+#if OPAL_PTLIB_SSL
+  delete m_sslContext[false];
+  delete m_sslContext[true];
+  for (std::list<PSSLContext *>::iterator it = m_sslRetiredContexts.begin(); it != m_sslRetiredContexts.end(); ++it)
+    delete *it;
+#endif
+
   PTRACE(4, m_prefixName << " endpoint destroyed.");
 }
 
@@ -242,8 +258,10 @@ bool OpalEndPoint::StartListener(OpalListener * listener)
     return false;
 
   OpalListenerUDP * udpListener = dynamic_cast<OpalListenerUDP *>(listener);
-  if (udpListener != NULL)
+  if (udpListener != NULL) {
     udpListener->SetBufferSize(m_maxSizeUDP);
+    udpListener->SetReceiveThreads(m_receiveThreadsUDP);
+  }
 
   // as the listener is not open, this will have the effect of immediately
   // stopping the listener thread. This is good - it means that the 
@@ -767,6 +785,113 @@ bool OpalEndPoint::ApplySSLCredentials(PSSLContext & context, bool create) const
 {
   return m_manager.ApplySSLCredentials(*this, context, create);
 }
+
+
+PString OpalEndPoint::GetSSLCredentialsKey() const
+{
+  PStringStream key;
+  PStringArray files = m_manager.GetSSLCertificateAuthorityFiles().Tokenise(";");
+  files.AppendString(m_manager.GetSSLCertificateFile());
+  files.AppendString(m_manager.GetSSLPrivateKeyFile());
+  for (PINDEX i = 0; i < files.GetSize(); ++i) {
+    key << files[i] << '@';
+    PFileInfo info;
+    if (!files[i].IsEmpty() && PFile::GetInfo(files[i], info))
+      key << info.modified.GetTimeInSeconds();
+    key << '\n';
+  }
+  return key;
+}
+
+
+PSSLContext * OpalEndPoint::GetSSLContext(bool server)
+{
+  static PTimeInterval const CheckInterval(0, 10);
+
+  PWaitAndSignal mutex(m_sslContextMutex);
+
+  PSSLContext * & context = m_sslContext[server];
+  PTimeInterval now = PTimer::Tick();
+  if (context == NULL || now - m_sslCredentialsChecked[server] > CheckInterval) {
+    m_sslCredentialsChecked[server] = now;
+    PString key = GetSSLCredentialsKey();
+    if (context != NULL && key != m_sslCredentials[server]) {
+      PTRACE(3, "SSL credentials changed, creating new " << (server ? "listener" : "outgoing") << " context");
+      RetireSSLContext(context);
+      context = NULL;
+    }
+    m_sslCredentials[server] = key;
+  }
+
+  if (context == NULL) {
+    context = new PSSLContext();
+    if (server)
+      context->SetCipherList("ALL");
+
+    if (!ApplySSLCredentials(*context, server)) {
+      PTRACE(2, "Could not apply SSL credentials for " << (server ? "listener" : "outgoing") << " context");
+      delete context;
+      context = NULL;
+    }
+  }
+
+  return context;
+}
+
+
+void OpalEndPoint::InvalidateSSLContexts()
+{
+  PWaitAndSignal mutex(m_sslContextMutex);
+
+  for (int server = 0; server < 2; ++server) {
+    if (m_sslContext[server] != NULL) {
+      RetireSSLContext(m_sslContext[server]);
+      m_sslContext[server] = NULL;
+    }
+  }
+}
+
+
+PSSLContext * OpalEndPoint::UseSSLContext(bool server)
+{
+  PWaitAndSignal mutex(m_sslContextMutex); // Recursive, so GetSSLContext() is atomic with this
+
+  PSSLContext * context = GetSSLContext(server);
+  if (context != NULL)
+    ++m_sslContextUsers[context];
+  return context;
+}
+
+
+void OpalEndPoint::ReleaseSSLContext(PSSLContext * context)
+{
+  if (context == NULL)
+    return;
+
+  PWaitAndSignal mutex(m_sslContextMutex);
+
+  std::map<PSSLContext *, unsigned>::iterator users = m_sslContextUsers.find(context);
+  if (users == m_sslContextUsers.end() || --users->second > 0)
+    return;
+  m_sslContextUsers.erase(users);
+
+  std::list<PSSLContext *>::iterator retired = std::find(m_sslRetiredContexts.begin(), m_sslRetiredContexts.end(), context);
+  if (retired != m_sslRetiredContexts.end()) {
+    PTRACE(4, "Deleting replaced SSL context, last connection using it has gone");
+    m_sslRetiredContexts.erase(retired);
+    delete context;
+  }
+}
+
+
+void OpalEndPoint::RetireSSLContext(PSSLContext * context)
+{
+  // Connections may still be using it, if so it is deleted when the last one goes
+  if (m_sslContextUsers.find(context) == m_sslContextUsers.end())
+    delete context;
+  else
+    m_sslRetiredContexts.push_back(context);
+}
 #endif
 
 
@@ -319,6 +319,10 @@ OpalManager::OpalManager()
   , m_staleReceiverTimeout(0,0,1) // Minutes
 #if OPAL_SRTP
   , m_dtlsTimeout(0, 3)           // Seconds
+#endif
+#if OPAL_VIDEO
+  , m_maxCodecThreads(0)
+  , m_codecThreadsInUse(0)
 #endif
   , m_rtpIpPorts(5000, 5999)
 #if OPAL_PTLIB_SSL
@@ -2196,6 +2200,37 @@ PBoolean OpalManager::SetVideoOutputDevice(const PVideoDevice::OpenArgs & args,
   return args.Validate<PVideoOutputDevice>(m_videoOutputDevice[role]);
 }
 
+
+unsigned OpalManager::AllocateCodecThreads(unsigned requested)
+{
+  PWaitAndSignal mutex(m_codecThreadsMutex);
+
+  unsigned granted = requested;
+  if (m_maxCodecThreads > 0) {
+    unsigned available = m_codecThreadsInUse < m_maxCodecThreads ? m_maxCodecThreads - m_codecThreadsInUse : 0;
+    if (granted > available)
+      granted = available;
+    if (granted == 0)
+      granted = 1; // Can always run, just not in parallel
+  }
+
+  m_codecThreadsInUse += granted;
+  PTRACE(4, "Allocated " << granted << " of " << requested << " codec threads, "
+         << m_codecThreadsInUse << " of " << m_maxCodecThreads << " in use");
+  return granted;
+}
+
+
+void OpalManager::ReleaseCodecThreads(unsigned threads)
+{
+  PWaitAndSignal mutex(m_codecThreadsMutex);
+
+  if (m_codecThreadsInUse > threads)
+    m_codecThreadsInUse -= threads;
+  else
+    m_codecThreadsInUse = 0;
+}
+
 #endif // OPAL_VIDEO
 
 
@@ -42,6 +42,9 @@
 #include <ptlib/videoio.h>
 #include <ptclib/cypher.h>
 
+#include <algorithm>
+#include <map>
+
 
 #define new PNEW
 #define PTraceModule() "MediaFormat"
@@ -126,6 +129,10 @@ static PMutex & GetMediaFormatsListMutex()
 }
 
 
+// Only changed with GetMediaFormatsListMutex() held
+static unsigned MediaFormatsListSequence;
+
+
 static void Clamp(OpalMediaFormatInternal & fmt1, const OpalMediaFormatInternal & fmt2, const PString & variableOption, const PString & minOption, const PString & maxOption)
 {
   if (fmt1.FindOption(variableOption) == NULL)
@@ -236,10 +243,73 @@ void OpalBandwidth::ReadFrom(std::istream & strm)
   }
 }
 
+/////////////////////////////////////////////////////////////////////////////
+
+class OpalMediaOptionNames
+{
+    PReadWriteMutex                     m_mutex;
+    std::map<PCaselessString, unsigned> m_identifiers;
+
+  public:
+    unsigned Intern(const PString & name)
+    {
+      {
+        PReadWaitAndSignal lock(m_mutex);
+        std::map<PCaselessString, unsigned>::const_iterator it = m_identifiers.find(name);
+        if (it != m_identifiers.end())
+          return it->second;
+      }
+
+      PWriteWaitAndSignal lock(m_mutex);
+      std::map<PCaselessString, unsigned>::const_iterator it = m_identifiers.find(name);
+      if (it != m_identifiers.end())
+        return it->second;
+
+      unsigned id = (unsigned)m_identifiers.size();
+      m_identifiers[name] = id;
+      return id;
+    }
+
+    unsigned Find(const PString & name)
+    {
+      PReadWaitAndSignal lock(m_mutex);
+      std::map<PCaselessString, unsigned>::const_iterator it = m_identifiers.find(name);
+      return it != m_identifiers.end() ? it->second : UINT_MAX;
+    }
+};
+
+
+static OpalMediaOptionNames & GetMediaOptionNames()
+{
+  static OpalMediaOptionNames names;
+  return names;
+}
+
+
+OpalMediaOptionKey::OpalMediaOptionKey(const PString & name)
+  : m_name(name)
+  , m_id(Intern(name))
+{
+}
+
+
+unsigned OpalMediaOptionKey::Intern(const PString & name)
+{
+  return GetMediaOptionNames().Intern(name);
+}
+
+
+unsigned OpalMediaOptionKey::Find(const PString & name)
+{
+  return GetMediaOptionNames().Find(name);
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 OpalMediaOption::OpalMediaOption(const PString & name)
   : m_name(name)
+  , m_id(OpalMediaOptionKey::Intern(m_name))
   , m_readOnly(false)
   , m_merge(NoMerge)
 {
@@ -252,6 +322,7 @@ OpalMediaOption::OpalMediaOption(const char * name, bool readOnly, MergeType mer
   , m_merge(merge)
 {
   m_name.Replace("=", "_", true);
+  m_id = OpalMediaOptionKey::Intern(m_name);
 }
 
 
@@ -803,6 +874,49 @@ const PString & OpalMediaFormat::MediaPacketizationsOption() { static const PCon
 const PString & OpalMediaFormat::ProtocolOption()        { static const PConstString s(PLUGINCODEC_OPTION_PROTOCOL);           return s; }
 const PString & OpalMediaFormat::MaxTxPacketSizeOption() { static const PConstString s(PLUGINCODEC_OPTION_MAX_TX_PACKET_SIZE); return s; }
 
+static const OpalMediaOptionKey & NeedsJitterKey()   { static const OpalMediaOptionKey k(OpalMediaFormat::NeedsJitterOption());   return k; }
+static const OpalMediaOptionKey & MaxFrameSizeKey()  { static const OpalMediaOptionKey k(OpalMediaFormat::MaxFrameSizeOption());  return k; }
+static const OpalMediaOptionKey & FrameTimeKey()     { static const OpalMediaOptionKey k(OpalMediaFormat::FrameTimeOption());     return k; }
+static const OpalMediaOptionKey & ClockRateKey()     { static const OpalMediaOptionKey k(OpalMediaFormat::ClockRateOption());     return k; }
+static const OpalMediaOptionKey & MaxBitRateKey()    { static const OpalMediaOptionKey k(OpalMediaFormat::MaxBitRateOption());    return k; }
+static const OpalMediaOptionKey & TargetBitRateKey() { static const OpalMediaOptionKey k(OpalMediaFormat::TargetBitRateOption()); return k; }
+
+
+bool OpalMediaFormat::NeedsJitterBuffer() const
+{
+  return GetOptionBoolean(NeedsJitterKey());
+}
+
+
+OpalBandwidth OpalMediaFormat::GetMaxBandwidth() const
+{
+  return GetOptionInteger(MaxBitRateKey());
+}
+
+
+OpalBandwidth OpalMediaFormat::GetUsedBandwidth() const
+{
+  return GetOptionInteger(TargetBitRateKey(), GetOptionInteger(MaxBitRateKey()));
+}
+
+
+PINDEX OpalMediaFormat::GetFrameSize() const
+{
+  return GetOptionInteger(MaxFrameSizeKey());
+}
+
+
+unsigned OpalMediaFormat::GetFrameTime() const
+{
+  return GetOptionInteger(FrameTimeKey());
+}
+
+
+unsigned OpalMediaFormat::GetClockRate() const
+{
+  return GetOptionInteger(ClockRateKey(), AudioClockRate);
+}
+
 
 OpalMediaFormat::OpalMediaFormat(OpalMediaFormatInternal * info)
   : m_info(NULL)
@@ -891,6 +1005,7 @@ void OpalMediaFormat::Construct(OpalMediaFormatInternal * info)
   else {
     m_info = info;
     registeredFormats.OpalMediaFormatBaseList::Append(this);
+    ++MediaFormatsListSequence;
   }
 }
 
@@ -947,7 +1062,6 @@ PBoolean OpalMediaFormat::MakeUnique()
     return true;
 
   m_info = (OpalMediaFormatInternal *)m_info->Clone();
-  m_info->options.MakeUnique();
   return false;
 }
 
@@ -1233,6 +1347,7 @@ bool OpalMediaFormat::SetRegisteredMediaFormat(const OpalMediaFormat & mediaForm
          is really happening is the above only compares the name, and below
          copies all of the attributes (OpalMediaFormatOtions) across. */
       *format = mediaFormat;
+      ++MediaFormatsListSequence;
       return true;
     }
   }
@@ -1249,6 +1364,7 @@ bool OpalMediaFormat::RemoveRegisteredMediaFormat(const OpalMediaFormat & mediaF
   for (OpalMediaFormatList::iterator format = registeredFormats.begin(); format != registeredFormats.end(); ++format) {
     if (*format == mediaFormat) {
       registeredFormats.erase(format);
+      ++MediaFormatsListSequence;
       return true;
     }
   }
@@ -1257,6 +1373,13 @@ bool OpalMediaFormat::RemoveRegisteredMediaFormat(const OpalMediaFormat & mediaF
 }
 
 
+unsigned OpalMediaFormat::GetRegisteredMediaFormatsSequence()
+{
+  PWaitAndSignal mutex(GetMediaFormatsListMutex());
+  return MediaFormatsListSequence;
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 OpalMediaFormatInternal::OpalMediaFormatInternal(const char * fullName,
@@ -1274,9 +1397,11 @@ OpalMediaFormatInternal::OpalMediaFormatInternal(const char * fullName,
   , rtpPayloadType(pt)
   , rtpEncodingName(en)
   , mediaType(_mediaType)
+  , m_optionIndex(NULL)
   , codecVersionTime(ts != 0 ? ts : PTime().GetTimeInSeconds())
   , forceIsTransportable(false)
   , m_allowMultiple(am)
+  , m_setIndex(OpalMediaFormatSet::GetIndex(formatName))
 {
 
   AddOption(new OpalMediaOptionString(OpalMediaFormat::DescriptionOption(), true, fullName));
@@ -1318,6 +1443,7 @@ OpalMediaFormatInternal::OpalMediaFormatInternal(const char * fullName,
 
   PWaitAndSignal mutex(GetMediaFormatsListMutex());
   DeconflictPayloadTypes(GetMediaFormatsList());
+  ++MediaFormatsListSequence;
 }
 
 
@@ -1379,6 +1505,33 @@ void OpalMediaFormatInternal::DeconflictPayloadTypes(OpalMediaFormatList & forma
 }
 
 
+OpalMediaFormatInternal::OpalMediaFormatInternal(const OpalMediaFormatInternal & other)
+  : PObject(other)
+  , formatName(other.formatName)
+  , rtpPayloadType(other.rtpPayloadType)
+  , rtpEncodingName(other.rtpEncodingName)
+  , mediaType(other.mediaType)
+  , options(other.options)
+  , m_optionIndex(NULL)
+  , codecVersionTime(other.codecVersionTime)
+  , forceIsTransportable(other.forceIsTransportable)
+  , m_allowMultiple(other.m_allowMultiple)
+  , m_setIndex(other.m_setIndex)
+{
+  // Never share the options with another instance, so the index cannot go stale
+  options.MakeUnique();
+  BuildOptionIndex();
+}
+
+
+OpalMediaFormatInternal::~OpalMediaFormatInternal()
+{
+  delete m_optionIndex.load();
+  for (size_t i = 0; i < m_retiredIndexes.size(); ++i)
+    delete m_retiredIndexes[i];
+}
+
+
 PObject * OpalMediaFormatInternal::Clone() const
 {
   PWaitAndSignal m1(media_format_mutex);
@@ -1395,8 +1548,7 @@ bool OpalMediaFormatInternal::Merge(const OpalMediaFormatInternal & mediaFormat)
 
   for (PINDEX i = 0; i < options.GetSize(); i++) {
     OpalMediaOption & opt = options[i];
-    PString name = opt.GetName();
-    OpalMediaOption * option = mediaFormat.FindOption(opt.GetName());
+    OpalMediaOption * option = mediaFormat.FindOptionByID(opt.GetID());
     if (option == NULL) {
       PTRACE_IF(3, formatName == mediaFormat.formatName, "MediaFormat\tCannot merge unmatched option " << opt.GetName());
     }
@@ -1419,8 +1571,7 @@ bool OpalMediaFormatInternal::ValidateMerge(const OpalMediaFormatInternal & medi
 
   for (PINDEX i = 0; i < options.GetSize(); i++) {
     OpalMediaOption & opt = options[i];
-    PString name = opt.GetName();
-    OpalMediaOption * option = mediaFormat.FindOption(opt.GetName());
+    OpalMediaOption * option = mediaFormat.FindOptionByID(opt.GetID());
     if (option == NULL) {
       PTRACE_IF(2, formatName == mediaFormat.formatName, "MediaFormat\tValidate: unmatched option " << opt.GetName());
     }
@@ -1494,9 +1645,8 @@ bool OpalMediaFormatInternal::SetOptionValue(const PString & name, const PString
 
 
 template <class OptionType, typename ValueType>
-static ValueType GetOptionOfType(const OpalMediaFormatInternal & format, const PString & name, ValueType dflt)
+static ValueType GetOptionOfType(const OpalMediaFormatInternal & format, OpalMediaOption * option, const PString & name, ValueType dflt)
 {
-  OpalMediaOption * option = format.FindOption(name);
   if (option == NULL)
     return dflt;
 
@@ -1511,9 +1661,15 @@ static ValueType GetOptionOfType(const OpalMediaFormatInternal & format, const P
 
 
 template <class OptionType, typename ValueType>
-static bool SetOptionOfType(OpalMediaFormatInternal & format, const PString & name, ValueType value)
+static ValueType GetOptionOfType(const OpalMediaFormatInternal & format, const PString & name, ValueType dflt)
+{
+  return GetOptionOfType<OptionType, ValueType>(format, format.FindOption(name), name, dflt);
+}
+
+
+template <class OptionType, typename ValueType>
+static bool SetOptionOfType(OpalMediaFormatInternal & format, OpalMediaOption * option, const PString & name, ValueType value)
 {
-  OpalMediaOption * option = format.FindOption(name);
   if (option == NULL)
     return false;
 
@@ -1529,14 +1685,56 @@ static bool SetOptionOfType(OpalMediaFormatInternal & format, const PString & na
 }
 
 
-bool OpalMediaFormatInternal::GetOptionBoolean(const PString & name, bool dflt) const
+template <class OptionType, typename ValueType>
+static bool SetOptionOfType(OpalMediaFormatInternal & format, const PString & name, ValueType value)
 {
-  PWaitAndSignal m(media_format_mutex);
-  const OpalMediaOptionEnum * optEnum = dynamic_cast<const OpalMediaOptionEnum *>(FindOption(name));
+  return SetOptionOfType<OptionType, ValueType>(format, format.FindOption(name), name, value);
+}
+
+
+static bool GetBooleanOption(const OpalMediaFormatInternal & format, OpalMediaOption * option, const PString & name, bool dflt)
+{
+  const OpalMediaOptionEnum * optEnum = dynamic_cast<const OpalMediaOptionEnum *>(option);
   if (optEnum != NULL && optEnum->GetEnumerations().GetSize() == 2)
     return optEnum->GetValue() != 0;
 
-  return GetOptionOfType<OpalMediaOptionBoolean, bool>(*this, name, dflt);
+  return GetOptionOfType<OpalMediaOptionBoolean, bool>(format, option, name, dflt);
+}
+
+
+static int GetIntegerOption(const OpalMediaFormatInternal & format, OpalMediaOption * option, const PString & name, int dflt)
+{
+  OpalMediaOptionUnsigned * optUnsigned = dynamic_cast<OpalMediaOptionUnsigned *>(option);
+  if (optUnsigned != NULL)
+    return optUnsigned->GetValue();
+
+  return GetOptionOfType<OpalMediaOptionInteger, int>(format, option, name, dflt);
+}
+
+
+static bool SetIntegerOption(OpalMediaFormatInternal & format, OpalMediaOption * option, const PString & name, int value)
+{
+  OpalMediaOptionUnsigned * optUnsigned = dynamic_cast<OpalMediaOptionUnsigned *>(option);
+  if (optUnsigned != NULL) {
+    optUnsigned->SetValue(value);
+    return true;
+  }
+
+  return SetOptionOfType<OpalMediaOptionInteger, int>(format, option, name, value);
+}
+
+
+bool OpalMediaFormatInternal::GetOptionBoolean(const PString & name, bool dflt) const
+{
+  PWaitAndSignal m(media_format_mutex);
+  return GetBooleanOption(*this, FindOption(name), name, dflt);
+}
+
+
+bool OpalMediaFormatInternal::GetOptionBoolean(const OpalMediaOptionKey & key, bool dflt) const
+{
+  // No lock, a single word read of a value, and options are never deleted while in use
+  return GetBooleanOption(*this, FindOption(key), key.GetName(), dflt);
 }
 
 
@@ -1556,24 +1754,28 @@ bool OpalMediaFormatInternal::SetOptionBoolean(const PString & name, bool value)
 int OpalMediaFormatInternal::GetOptionInteger(const PString & name, int dflt) const
 {
   PWaitAndSignal m(media_format_mutex);
-  OpalMediaOptionUnsigned * optUnsigned = dynamic_cast<OpalMediaOptionUnsigned *>(FindOption(name));
-  if (optUnsigned != NULL)
-    return optUnsigned->GetValue();
+  return GetIntegerOption(*this, FindOption(name), name, dflt);
+}
 
-  return GetOptionOfType<OpalMediaOptionInteger, int>(*this, name, dflt);
+
+int OpalMediaFormatInternal::GetOptionInteger(const OpalMediaOptionKey & key, int dflt) const
+{
+  // No lock, a single word read of a value, and options are never deleted while in use
+  return GetIntegerOption(*this, FindOption(key), key.GetName(), dflt);
 }
 
 
 bool OpalMediaFormatInternal::SetOptionInteger(const PString & name, int value)
 {
   PWaitAndSignal m(media_format_mutex);
-  OpalMediaOptionUnsigned * optUnsigned = dynamic_cast<OpalMediaOptionUnsigned *>(FindOption(name));
-  if (optUnsigned != NULL) {
-    optUnsigned->SetValue(value);
-    return true;
-  }
+  return SetIntegerOption(*this, FindOption(name), name, value);
+}
+
 
-  return SetOptionOfType<OpalMediaOptionInteger, int>(*this, name, value);
+bool OpalMediaFormatInternal::SetOptionInteger(const OpalMediaOptionKey & key, int value)
+{
+  PWaitAndSignal m(media_format_mutex);
+  return SetIntegerOption(*this, FindOption(key), key.GetName(), value);
 }
 
 
@@ -1612,6 +1814,13 @@ PString OpalMediaFormatInternal::GetOptionString(const PString & name, const PSt
 }
 
 
+PString OpalMediaFormatInternal::GetOptionString(const OpalMediaOptionKey & key, const PString & dflt) const
+{
+  PWaitAndSignal m(media_format_mutex);
+  return GetOptionOfType<OpalMediaOptionString, PString>(*this, FindOption(key), key.GetName(), dflt);
+}
+
+
 bool OpalMediaFormatInternal::SetOptionString(const PString & name, const PString & value)
 {
   PWaitAndSignal m(media_format_mutex);
@@ -1658,33 +1867,67 @@ bool OpalMediaFormatInternal::AddOption(OpalMediaOption * option, PBoolean overw
       return false;
     }
 
-    options.RemoveAt(index);
+    // A lock free reader could have just found the old one, so keep it
+    options.DisallowDeleteObjects();
+    m_retiredOptions.Append(options.RemoveAt(index));
+    options.AllowDeleteObjects();
   }
 
   options.Append(option);
+  BuildOptionIndex();
   return true;
 }
 
 
-class OpalMediaOptionSearchArg : public OpalMediaOption
+static bool CompareOptionID(const OpalMediaOption * option, unsigned id)
 {
-public:
-  OpalMediaOptionSearchArg(const PString & name) : OpalMediaOption(name) { }
-  virtual Comparison CompareValue(const OpalMediaOption &) const { return EqualTo; }
-  virtual void Assign(const OpalMediaOption &) { }
-};
+  return option->GetID() < id;
+}
+
+
+static bool CompareOptionsByID(const OpalMediaOption * option1, const OpalMediaOption * option2)
+{
+  return option1->GetID() < option2->GetID();
+}
+
+
+void OpalMediaFormatInternal::BuildOptionIndex()
+{
+  // Called with media_format_mutex held, or during construction
+  OptionIndex * index = new OptionIndex(options.GetSize());
+  for (PINDEX i = 0; i < options.GetSize(); i++)
+    (*index)[i] = &options[i];
+
+  // Options are sorted by name, so need to re-sort by identifier
+  std::sort(index->begin(), index->end(), CompareOptionsByID);
+
+  const OptionIndex * old = m_optionIndex.exchange(index);
+  if (old != NULL)
+    m_retiredIndexes.push_back(old);
+}
+
 
 OpalMediaOption * OpalMediaFormatInternal::FindOption(const PString & name) const
 {
-  PWaitAndSignal m(media_format_mutex);
-  OpalMediaOptionSearchArg search(name);
-  PINDEX index = options.GetValuesIndex(search);
-  if (index == P_MAX_INDEX)
+  unsigned id = OpalMediaOptionKey::Find(name);
+  if (id == UINT_MAX)
     return NULL;
 
-  PAssert(options[index].GetName() == name, "OpalMediaOption name mismatch");
+  OpalMediaOption * option = FindOptionByID(id);
+  PAssert(option == NULL || option->GetName() == name, "OpalMediaOption name mismatch");
+  return option;
+}
+
 
-  return &options[index];
+OpalMediaOption * OpalMediaFormatInternal::FindOptionByID(unsigned id) const
+{
+  // No lock, the published index is never modified, only replaced
+  const OptionIndex * index = m_optionIndex.load();
+  if (index == NULL)
+    return NULL;
+
+  OptionIndex::const_iterator it = std::lower_bound(index->begin(), index->end(), id, CompareOptionID);
+  return it != index->end() && (*it)->GetID() == id ? *it : NULL;
 }
 
 
@@ -1956,6 +2199,8 @@ const PString & OpalVideoFormat::TxKeyFramePeriodOption()         { static const
 const PString & OpalVideoFormat::RateControlPeriodOption()        { static const PConstString s(PLUGINCODEC_OPTION_RATE_CONTROL_PERIOD);       return s; }
 const PString & OpalVideoFormat::FrameDropOption()                { static const PConstString s("Frame Drop");                                 return s; }
 const PString & OpalVideoFormat::FreezeUntilIntraFrameOption()    { static const PConstString s("Freeze Until Intra-Frame");                   return s; }
+const PString & OpalVideoFormat::EncoderThreadsOption()           { static const PConstString s(PLUGINCODEC_OPTION_ENCODER_THREADS);           return s; }
+const PString & OpalVideoFormat::DecoderThreadsOption()           { static const PConstString s(PLUGINCODEC_OPTION_DECODER_THREADS);           return s; }
 const PString & OpalVideoFormat::ContentRoleOption()              { static const PConstString s("Content Role");                               return s; }
 const PString & OpalVideoFormat::ContentRoleMaskOption()          { static const PConstString s("Content Role Mask");                          return s; }
 #if OPAL_SDP
@@ -2030,6 +2275,8 @@ OpalVideoFormatInternal::OpalVideoFormatInternal(const char * fullName,
     AddOption(new OpalMediaOptionUnsigned(OpalMediaFormat::MaxTxPacketSizeOption(),        true,  OpalMediaOption::MinMerge, PluginCodec_RTP_MaxPayloadSize, 100       ));
     AddOption(new OpalMediaOptionBoolean (OpalVideoFormat::FrameDropOption(),              false, OpalMediaOption::NoMerge,     true                                   ));
     AddOption(new OpalMediaOptionBoolean (OpalVideoFormat::FreezeUntilIntraFrameOption(),  false, OpalMediaOption::NoMerge,     false                                  ));
+    AddOption(new OpalMediaOptionUnsigned(OpalVideoFormat::EncoderThreadsOption(),         false, OpalMediaOption::NoMerge,     0,                           0,  64));
+    AddOption(new OpalMediaOptionUnsigned(OpalVideoFormat::DecoderThreadsOption(),         false, OpalMediaOption::NoMerge,     0,                           0,  64));
 #if OPAL_SDP
     AddOption(new OpalMediaOptionEnum    (OpalVideoFormat::UseImageAttributeInSDP(),       false,
                                           OpalVideoFormat::PEnumNames_ImageAttributeInSDP::Names(), OpalVideoFormat::NumImageAttributeInSDP,
@@ -2418,6 +2665,131 @@ OpalMediaTypeList OpalMediaFormatList::GetMediaTypes() const
 }
 
 
+/////////////////////////////////////////////////////////////////////////////
+
+OpalMediaFormatSet::OpalMediaFormatSet(const OpalMediaFormatList & formats)
+{
+  operator+=(formats);
+}
+
+
+PINDEX OpalMediaFormatSet::GetIndex(const OpalMediaFormat & format)
+{
+  // Set when the internal object is constructed and never changed, so no lock
+  return format.m_info != NULL ? format.m_info->m_setIndex : P_MAX_INDEX;
+}
+
+
+PINDEX OpalMediaFormatSet::GetIndex(const PString & formatName)
+{
+  static PMutex mutex;
+  static std::map<PCaselessString, PINDEX> indexes;
+
+  PWaitAndSignal lock(mutex);
+  std::map<PCaselessString, PINDEX>::iterator it = indexes.find(formatName);
+  if (it != indexes.end())
+    return it->second;
+
+  PINDEX index = indexes.size();
+  indexes[formatName] = index;
+  return index;
+}
+
+
+OpalMediaFormatSet & OpalMediaFormatSet::operator+=(const OpalMediaFormat & format)
+{
+  AddIndex(GetIndex(format));
+  return *this;
+}
+
+
+void OpalMediaFormatSet::AddIndex(PINDEX index)
+{
+  if (index == P_MAX_INDEX)
+    return;
+
+  PINDEX word = index/BitsPerWord;
+  if ((PINDEX)m_bits.size() <= word)
+    m_bits.resize(word+1);
+  m_bits[word] |= (Word)1 << (index%BitsPerWord);
+}
+
+
+OpalMediaFormatSet & OpalMediaFormatSet::operator+=(const OpalMediaFormatList & formats)
+{
+  for (OpalMediaFormatList::const_iterator format = formats.begin(); format != formats.end(); ++format)
+    operator+=(*format);
+  return *this;
+}
+
+
+OpalMediaFormatSet & OpalMediaFormatSet::operator|=(const OpalMediaFormatSet & other)
+{
+  if (m_bits.size() < other.m_bits.size())
+    m_bits.resize(other.m_bits.size());
+  for (size_t i = 0; i < other.m_bits.size(); ++i)
+    m_bits[i] |= other.m_bits[i];
+  return *this;
+}
+
+
+OpalMediaFormatSet & OpalMediaFormatSet::operator&=(const OpalMediaFormatSet & other)
+{
+  if (m_bits.size() > other.m_bits.size())
+    m_bits.resize(other.m_bits.size());
+  for (size_t i = 0; i < m_bits.size(); ++i)
+    m_bits[i] &= other.m_bits[i];
+  return *this;
+}
+
+
+bool OpalMediaFormatSet::Contains(const OpalMediaFormat & format) const
+{
+  return ContainsIndex(GetIndex(format));
+}
+
+
+bool OpalMediaFormatSet::ContainsIndex(PINDEX index) const
+{
+  if (index == P_MAX_INDEX)
+    return false;
+
+  PINDEX word = index/BitsPerWord;
+  return word < (PINDEX)m_bits.size() && (m_bits[word] & ((Word)1 << (index%BitsPerWord))) != 0;
+}
+
+
+bool OpalMediaFormatSet::IsSubsetOf(const OpalMediaFormatSet & other) const
+{
+  for (size_t i = 0; i < m_bits.size(); ++i) {
+    if ((m_bits[i] & ~(i < other.m_bits.size() ? other.m_bits[i] : 0)) != 0)
+      return false;
+  }
+  return true;
+}
+
+
+bool OpalMediaFormatSet::IsEmpty() const
+{
+  for (size_t i = 0; i < m_bits.size(); ++i) {
+    if (m_bits[i] != 0)
+      return false;
+  }
+  return true;
+}
+
+
+void OpalMediaFormatSet::RemoveMissing(OpalMediaFormatList & formats) const
+{
+  for (OpalMediaFormatList::iterator format = formats.begin(); format != formats.end(); ) {
+    if (Contains(*format))
+      ++format;
+    else
+      formats.erase(format++);
+  }
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 namespace OpalRtx
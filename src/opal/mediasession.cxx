@@ -39,6 +39,7 @@
 #include <opal/manager.h>
 //#include <h323/h323caps.h>
 #include <sdp/sdp.h>
+#include <rtp/pcapcapture.h>
 
 #include <ptclib/random.h>
 #include <ptclib/cypher.h>
@@ -533,6 +534,7 @@ OpalMediaTransport::OpalMediaTransport(const PString & name)
   , m_opened(false)
   , m_started(false)
   , m_congestionControl(NULL)
+  , m_capture(NULL)
 {
   m_ccTimer.SetNotifier(PCREATE_NOTIFIER(ProcessCongestionControl), "RTP-CC");
 }
@@ -980,10 +982,38 @@ void OpalUDPMediaTransport::InternalRxData(SubChannels subchannel, const PBYTEAr
     InternalSetRemoteAddress(ap, subchannel, true PTRACE_PARAM(, "first PDU"));
   }
 
+  OpalPCAPCapture * capture = m_capture;
+  if (capture != NULL && !data.IsEmpty()) {
+    PIPAddressAndPort ap;
+    m_socketInfo[subchannel].m_socket->GetLastReceiveAddress(ap);
+    PIPSocketAddressAndPort localAP = GetCaptureAddress(subchannel);
+    capture->Capture(localAP.GetPort(), ap, localAP, data, data.GetSize());
+  }
+
   OpalMediaTransport::InternalRxData(subchannel, data);
 }
 
 
+PIPSocketAddressAndPort OpalUDPMediaTransport::GetCaptureAddress(SubChannels subchannel)
+{
+  // m_localAP does not change after Open(), so no lock if bound to an interface
+  SocketInfo & info = m_socketInfo[subchannel];
+  if (!info.m_localAP.GetAddress().IsAny())
+    return info.m_localAP;
+
+  /* Bound to all interfaces, so capture with the one the remote is reached
+     by. The route lookup is only done here, when actually capturing, and
+     again only after the remote changes. */
+  PWaitAndSignal mutex(m_captureMutex);
+  if (!info.m_captureAP.IsValid()) {
+    if (!info.m_routeTo.IsValid())
+      return info.m_localAP; // Remote not known yet
+    info.m_captureAP = PIPSocketAddressAndPort(PIPSocket::GetRouteInterfaceAddress(info.m_routeTo), info.m_localAP.GetPort());
+  }
+  return info.m_captureAP;
+}
+
+
 bool OpalUDPMediaTransport::InternalSetRemoteAddress(const PIPSocket::AddressAndPort & newAP,
                                                      SubChannels subchannel,
                                                      bool dontOverride
@@ -1015,6 +1045,14 @@ bool OpalUDPMediaTransport::InternalSetRemoteAddress(const PIPSocket::AddressAnd
 
   m_socketInfo[subchannel].m_remoteAddress = OpalTransportAddress(newAP, OpalTransportAddress::UdpPrefix());
   socket->SetSendAddress(newAP);
+
+  // Capture address of a wildcard binding is resolved again when next needed
+  SocketInfo & info = m_socketInfo[subchannel];
+  if (info.m_localAP.GetAddress().IsAny()) {
+    PWaitAndSignal mutex(m_captureMutex);
+    info.m_routeTo = newAP.GetAddress();
+    info.m_captureAP = PIPSocketAddressAndPort();
+  }
   m_remoteAddressSet = true;
   m_subchannels[subchannel].m_consecutiveUnavailableErrors = 0; // Prevent errors from previous address.
 
@@ -1211,8 +1249,12 @@ bool OpalUDPMediaTransport::Open(OpalMediaSession & session,
     PTRACE_CONTEXT_ID_TO(socket);
 
     PIPSocketAddressAndPort ap;
-    if (socket.GetLocalAddress(ap) && ap.IsValid())
+    if (socket.GetLocalAddress(ap) && ap.IsValid()) {
       m_socketInfo[subchannel].m_localAddress = OpalTransportAddress(ap, OpalTransportAddress::UdpPrefix());
+      m_socketInfo[subchannel].m_localAP = ap;
+      if (remoteIP.IsValid() && !remoteIP.IsAny())
+        m_socketInfo[subchannel].m_routeTo = remoteIP;
+    }
 
     /* Make socket timeout slightly longer (200ms) than media timeout to avoid
        a race condition with m_mediaTimer expiring. */
@@ -1224,6 +1266,9 @@ bool OpalUDPMediaTransport::Open(OpalMediaSession & session,
   }
   m_mediaTimer = m_mediaTimeout;
 
+  if (manager.GetPCAPCapture().IsTriggered(session.GetConnection()))
+    m_capture = &manager.GetPCAPCapture();
+
   m_opened = true;
   return true;
 }
@@ -1246,8 +1291,14 @@ bool OpalUDPMediaTransport::Write(const void * data, PINDEX length, SubChannels
     socket->GetSendAddress(sendAddr);
 
   if (sendAddr.IsValid()) {
-    if (socket->WriteTo(data, length, sendAddr))
+    if (socket->WriteTo(data, length, sendAddr)) {
+      OpalPCAPCapture * capture = m_capture;
+      if (capture != NULL) {
+        PIPSocketAddressAndPort localAP = GetCaptureAddress(subchannel);
+        capture->Capture(localAP.GetPort(), localAP, sendAddr, data, length);
+      }
       return true;
+    }
   }
   else {
     PTRACE(4, "UDP write has no destination address.");
@@ -1311,8 +1362,14 @@ bool OpalMediaSession::IsOpen() const
 void OpalMediaSession::Start()
 {
   OpalMediaTransportPtr transport = m_transport; // This way avoids races
-  if (transport != NULL)
-    transport->Start();
+  if (transport == NULL)
+    return;
+
+  // Capture, or triggers, may have changed since the transport was opened
+  OpalPCAPCapture & capture = m_connection.GetEndPoint().GetManager().GetPCAPCapture();
+  transport->SetCapture(capture.IsTriggered(m_connection) ? &capture : NULL);
+
+  transport->Start();
 }
 
 
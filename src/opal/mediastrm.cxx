@@ -46,6 +46,7 @@
 #include <opal/endpoint.h>
 #include <opal/call.h>
 #include <lids/lid.h>
+#include <codec/silencedetect.h>
 #include <ptlib/sound.h>
 
 
@@ -789,9 +790,13 @@ OpalRawMediaStream::OpalRawMediaStream(OpalConnection & conn,
   , m_channel(chan)
   , m_autoDelete(autoDelete)
   , m_silence(10*sizeof(short)*mediaFormat.GetTimeUnits()) // At least 10ms
+  , m_comfortNoise(NULL)
   , m_averageSignalSum(0)
   , m_averageSignalSamples(0)
 {
+  if (!isSource && mediaFormat.GetMediaType() == OpalMediaType::Audio() &&
+                   conn.GetEndPoint().GetManager().GetSilenceDetectParams().m_comfortNoise)
+    m_comfortNoise = new OpalPCM16ComfortNoise;
 }
 
 
@@ -802,6 +807,8 @@ OpalRawMediaStream::~OpalRawMediaStream()
   if (m_autoDelete)
     delete m_channel;
   m_channel = NULL;
+
+  delete m_comfortNoise;
 }
 
 
@@ -893,15 +900,21 @@ PBoolean OpalRawMediaStream::WriteData(const BYTE * buffer, PINDEX length, PINDE
      So, silence buffer is set to be the largest chunk of audio the remote has
      ever sent to us. Then when they stop sending, (we get length==0) we just
      keep outputting that number of bytes to the raw channel until the remote
-     starts up again.
+     starts up again. If comfort noise is enabled, the silence is filled with
+     noise matching the background of what the remote last sent.
      */
 
-  if (buffer != NULL && length != 0)
+  if (buffer != NULL && length != 0) {
     m_silence.SetMinSize(length);
+    if (m_comfortNoise != NULL)
+      m_comfortNoise->Analyse((const short *)buffer, length/sizeof(short));
+  }
   else {
     length = m_silence.GetSize();
+    if (m_comfortNoise != NULL)
+      m_comfortNoise->Generate((short *)m_silence.GetPointer(), length/sizeof(short));
     buffer = m_silence;
-    PTRACE(6, "Playing silence " << length << " bytes");
+    PTRACE(6, "Playing " << (m_comfortNoise != NULL ? "comfort noise " : "silence ") << length << " bytes");
   }
 
   if (!m_channel->Write(buffer, length)) {
@@ -968,11 +981,7 @@ void OpalRawMediaStream::CollectAverage(const BYTE * buffer, PINDEX size)
 
   size = size/2;
   m_averageSignalSamples += size;
-  const short * pcm = (const short *)buffer;
-  while (size-- > 0) {
-    m_averageSignalSum += PABS(*pcm);
-    pcm++;
-  }
+  m_averageSignalSum += OpalPCM16SilenceDetector::GetSignalSum((const short *)buffer, size);
 }
 
 
@@ -51,6 +51,9 @@
 #include <ep/lyncep.h>
 
 #include <queue>
+#include <map>
+#include <algorithm>
+#include <limits.h>
 
 
 class OpalManager_C;
@@ -133,6 +136,49 @@ inline bool IsNullString(const char * str)
 }
 
 
+/* The media ring as allocated, the application only ever sees the
+   OpalMediaRing part. The call holds one reference and each
+   OpalIndMediaStream message carrying the ring holds another, so it lasts
+   for as long as the application keeps the message, even past the call. */
+struct OpalMediaRingAllocation : OpalMediaRing
+{
+  OpalMediaRingAllocation(unsigned size)
+    : m_references(1)
+    , m_buffer(size)
+  {
+    m_size = size;
+    m_readPosition = m_writePosition = m_overruns = m_consumerWaiting = 0;
+    m_data = &m_buffer[0];
+  }
+
+  atomic<unsigned>           m_references;
+  PSyncPoint                 m_written;
+  std::vector<unsigned char> m_buffer;
+};
+
+
+static void ReferenceMediaRing(OpalMediaRing * ring)
+{
+  if (ring != NULL)
+    ++static_cast<OpalMediaRingAllocation *>(ring)->m_references;
+}
+
+
+static void ReleaseMediaRing(OpalMediaRing * ring)
+{
+  if (ring != NULL && --static_cast<OpalMediaRingAllocation *>(ring)->m_references == 0)
+    delete static_cast<OpalMediaRingAllocation *>(ring);
+}
+
+
+static void FreeMessage(OpalMessage * message)
+{
+  if (message->m_type == OpalIndMediaStream)
+    ReleaseMediaRing(message->m_param.m_mediaStream.m_mediaRing);
+  free(message);
+}
+
+
 class OpalMessageBuffer
 {
   public:
@@ -167,16 +213,38 @@ struct OpalMediaDataCallbacks
   bool OnReadMediaData(const OpalLocalConnection &, const OpalMediaStream &, void *, PINDEX, PINDEX &);
   bool OnWriteMediaData(const OpalLocalConnection &, const OpalMediaStream &, const void *, PINDEX, PINDEX &);
 
+  OpalMediaRing * GetMediaRing(const PString & token, const PString & type, const OpalMediaFormat & mediaFormat, bool forMessage = false);
+  OpalMediaRing * GetMediaRing(const OpalLocalConnection & connection, const OpalMediaStream & mediaStream);
+  PINDEX WaitMediaRing(const OpalLocalConnection & connection, const OpalMediaStream & mediaStream, OpalMediaRing & ring, void * data, PINDEX size);
+  void RetireMediaRing(const PString & token, const PString & type);
+  void ReleaseMediaRings(const PString & token);
+
   OpalMediaDataFunction m_mediaReadData;
   OpalMediaDataFunction m_mediaWriteData;
   OpalMediaDataType     m_mediaDataHeader;
+  unsigned              m_mediaRingSize;
+
+  typedef std::map<PString, OpalMediaRing *> MediaRingMap;
+  MediaRingMap          m_mediaRings;    // Open streams, by call token and stream type
+  typedef std::multimap<PString, OpalMediaRing *> RetiredRingMap;
+  RetiredRingMap        m_retiredRings;  // Closed streams, by call token, released with the call
+  PMutex                m_mediaRingMutex;
 
   OpalMediaDataCallbacks()
     : m_mediaReadData(NULL)
     , m_mediaWriteData(NULL)
     , m_mediaDataHeader(OpalMediaDataPayloadOnly)
+    , m_mediaRingSize(0)
   {
   }
+
+  ~OpalMediaDataCallbacks()
+  {
+    for (MediaRingMap::iterator it = m_mediaRings.begin(); it != m_mediaRings.end(); ++it)
+      ReleaseMediaRing(it->second);
+    for (RetiredRingMap::iterator it = m_retiredRings.begin(); it != m_retiredRings.end(); ++it)
+      ReleaseMediaRing(it->second);
+  }
 };
 
 
@@ -299,6 +367,7 @@ class OpalManager_C : public OpalManager
 
     void PostMessage(OpalMessageBuffer & message);
     OpalMessage * GetMessage(unsigned timeout, const char * & error);
+    unsigned GetMessages(OpalMessage ** messages, unsigned maxMessages, unsigned timeout);
     OpalMessage * SendMessage(const OpalMessage * message);
 
     virtual void OnEstablishedCall(OpalCall & call);
@@ -467,7 +536,7 @@ OpalMessageBuffer::OpalMessageBuffer(OpalMessageType type)
 OpalMessageBuffer::~OpalMessageBuffer()
 {
   if (m_data != NULL)
-    free(m_data);
+    FreeMessage((OpalMessage *)m_data);
 }
 
 
@@ -612,6 +681,234 @@ bool OpalLocalEndPoint_C::OnWriteMediaData(const OpalLocalConnection & connectio
 }
 
 
+static __inline void MediaRingBarrier()
+{
+#if defined(_MSC_VER)
+  MemoryBarrier();
+#elif defined(__GNUC__)
+  __sync_synchronize();
+#endif
+}
+
+
+static __inline unsigned MediaRingRecordSize(unsigned length)
+{
+  return (sizeof(PUInt32) + length + 3) & ~3u;
+}
+
+
+static const unsigned MediaRingMinimumFrames = 4;
+static const unsigned MediaRingMinimumWait = 10;  // Milliseconds
+static const unsigned MediaRingMaximumWait = 100;
+
+
+static bool WriteMediaRing(OpalMediaRing & ring, const void * data, PINDEX length)
+{
+  unsigned recordSize = MediaRingRecordSize(length);
+  unsigned position = ring.m_writePosition;
+  unsigned offset = position & (ring.m_size-1);
+  unsigned skip = recordSize > ring.m_size - offset ? ring.m_size - offset : 0;
+
+  MediaRingBarrier();
+  if (skip + recordSize > ring.m_size - (position - ring.m_readPosition)) {
+    ++ring.m_overruns;
+    PTRACE(5, "Media ring full, discarding " << length << " bytes");
+    return false;
+  }
+
+  // Records never wrap, so the application can use them in place
+  if (skip > 0) {
+    *(PUInt32 *)(ring.m_data + offset) = OPAL_MEDIA_RING_WRAP;
+    position += skip;
+    offset = 0;
+  }
+
+  *(PUInt32 *)(ring.m_data + offset) = length;
+  memcpy(ring.m_data + offset + sizeof(PUInt32), data, length);
+
+  MediaRingBarrier();
+  ring.m_writePosition = position + recordSize;
+  return true;
+}
+
+
+static PINDEX ReadMediaRing(OpalMediaRing & ring, void * data, PINDEX size)
+{
+  unsigned position = ring.m_readPosition;
+  for (;;) {
+    if (position == ring.m_writePosition)
+      return 0;
+
+    MediaRingBarrier();
+    unsigned offset = position & (ring.m_size-1);
+    PUInt32 length = *(const PUInt32 *)(ring.m_data + offset);
+    if (length == OPAL_MEDIA_RING_WRAP) {
+      position += ring.m_size - offset;
+      continue;
+    }
+
+    PINDEX copied = std::min((PINDEX)length, size);
+    PTRACE_IF(3, copied < (PINDEX)length, "Media ring record of " << length << " bytes truncated to " << size);
+    memcpy(data, ring.m_data + offset + sizeof(PUInt32), copied);
+
+    MediaRingBarrier();
+    ring.m_readPosition = position + MediaRingRecordSize(length);
+    return copied;
+  }
+}
+
+
+static unsigned MediaRingFrameSize(const OpalMediaFormat & mediaFormat)
+{
+  // Largest record one read or write may produce, with room for the RTP
+  // header, CSRCs, extensions and the video frame header
+  static const unsigned HeaderRoom = 128;
+
+#if OPAL_VIDEO
+  if (mediaFormat.GetMediaType() == OpalMediaType::Video())
+    return HeaderRoom + (unsigned)PVideoFrameInfo::CalculateFrameBytes(
+                              mediaFormat.GetOptionInteger(OpalVideoFormat::FrameWidthOption(), PVideoFrameInfo::CIFWidth),
+                              mediaFormat.GetOptionInteger(OpalVideoFormat::FrameHeightOption(), PVideoFrameInfo::CIFHeight));
+#endif
+
+  // Ring is shared by the encoded and raw sides, so allow for PCM-16 of the same duration
+  unsigned framesPerPacket = std::max(mediaFormat.GetOptionInteger(OpalAudioFormat::TxFramesPerPacketOption(), 1),
+                                      mediaFormat.GetOptionInteger(OpalAudioFormat::RxFramesPerPacketOption(), 1));
+  unsigned frameSize = std::max((unsigned)mediaFormat.GetFrameSize(),
+                                mediaFormat.GetFrameTime()*mediaFormat.GetOptionInteger(OpalAudioFormat::ChannelsOption(), 1)*2);
+  return HeaderRoom + std::max(framesPerPacket, 1U)*frameSize;
+}
+
+
+OpalMediaRing * OpalMediaDataCallbacks::GetMediaRing(const PString & token,
+                                                     const PString & type,
+                                                     const OpalMediaFormat & mediaFormat,
+                                                     bool forMessage)
+{
+  if (m_mediaRingSize == 0)
+    return NULL;
+
+  PWaitAndSignal lock(m_mediaRingMutex);
+
+  PString key = token + ' ' + type;
+  MediaRingMap::iterator it = m_mediaRings.find(key);
+  if (it != m_mediaRings.end()) {
+    if (forMessage)
+      ReferenceMediaRing(it->second);
+    return it->second;
+  }
+
+  // The configured size is a minimum, the ring must be able to hold several frames of the format
+  unsigned ringSize = m_mediaRingSize;
+  unsigned minimumSize = MediaRingMinimumFrames*MediaRingRecordSize(MediaRingFrameSize(mediaFormat));
+  while (ringSize < minimumSize && ringSize < 0x40000000)
+    ringSize <<= 1;
+
+  OpalMediaRing * ring = new OpalMediaRingAllocation(ringSize);
+  if (forMessage)
+    ReferenceMediaRing(ring);
+  m_mediaRings[key] = ring;
+  PTRACE(4, "Created media ring of " << ringSize << " bytes for " << key << " using " << mediaFormat);
+  return ring;
+}
+
+
+OpalMediaRing * OpalMediaDataCallbacks::GetMediaRing(const OpalLocalConnection & connection,
+                                                     const OpalMediaStream & mediaStream)
+{
+  if (m_mediaRingSize == 0)
+    return NULL;
+
+  /* Only OpalLocalMediaStream calls the media call backs. The ring is kept
+     on the stream after the first frame, it cannot be released under it as
+     the call holds it until cleared, which is after all its streams. */
+  OpalLocalMediaStream & localStream = const_cast<OpalLocalMediaStream &>(static_cast<const OpalLocalMediaStream &>(mediaStream));
+  OpalMediaRing * ring = (OpalMediaRing *)localStream.GetContext();
+  if (ring != NULL)
+    return ring;
+
+  // Named from the network side, as in the OpalIndMediaStream message
+  PStringStream type;
+  type << mediaStream.GetMediaFormat().GetMediaType() << (mediaStream.IsSource() ? " out" : " in");
+  ring = GetMediaRing(connection.GetCall().GetToken(), type, mediaStream.GetMediaFormat());
+  localStream.SetContext(ring);
+  return ring;
+}
+
+
+PINDEX OpalMediaDataCallbacks::WaitMediaRing(const OpalLocalConnection & connection,
+                                             const OpalMediaStream & mediaStream,
+                                             OpalMediaRing & ring,
+                                             void * data,
+                                             PINDEX size)
+{
+  PINDEX length = ReadMediaRing(ring, data, size);
+  if (length > 0)
+    return length;
+
+  // When simulating synchronous, OpalLocalMediaStream does the pacing after we return
+  const OpalMediaFormat & mediaFormat = mediaStream.GetMediaFormat();
+  if (connection.GetSynchronicity(mediaFormat, mediaStream.IsSource()) == OpalLocalEndPoint::e_SimulateSynchronous)
+    return 0;
+
+  /* Wait for up to a packet time for the application to produce a record.
+     It calls OpalSignalMediaRing() when it sees the flag set, so the ring
+     is checked again after setting it in case that raced the write. */
+  unsigned clockRate = mediaFormat.GetClockRate();
+  unsigned framesPerPacket = std::max(mediaFormat.GetOptionInteger(OpalAudioFormat::TxFramesPerPacketOption(), 1), 1);
+  unsigned timeout = clockRate > 0 ? mediaFormat.GetFrameTime()*framesPerPacket*1000/clockRate : 0;
+  PSimpleTimer timer(std::min(std::max(timeout, MediaRingMinimumWait), MediaRingMaximumWait));
+  for (;;) {
+    ring.m_consumerWaiting = 1;
+    MediaRingBarrier();
+    if (ring.m_readPosition != ring.m_writePosition)
+      break;
+
+    PTimeInterval remaining = timer.GetRemaining();
+    if (remaining <= 0 || !mediaStream.IsOpen()) {
+      ring.m_consumerWaiting = 0;
+      return 0;
+    }
+
+    static_cast<OpalMediaRingAllocation &>(ring).m_written.Wait(remaining);
+  }
+
+  ring.m_consumerWaiting = 0;
+  return ReadMediaRing(ring, data, size);
+}
+
+
+void OpalMediaDataCallbacks::RetireMediaRing(const PString & token, const PString & type)
+{
+  PWaitAndSignal lock(m_mediaRingMutex);
+
+  // A stream opening again gets a new ring, sized for its possibly new format
+  MediaRingMap::iterator it = m_mediaRings.find(token + ' ' + type);
+  if (it != m_mediaRings.end()) {
+    m_retiredRings.insert(RetiredRingMap::value_type(token, it->second));
+    m_mediaRings.erase(it);
+  }
+}
+
+
+void OpalMediaDataCallbacks::ReleaseMediaRings(const PString & token)
+{
+  PWaitAndSignal lock(m_mediaRingMutex);
+
+  PString prefix = token + ' ';
+  MediaRingMap::iterator it = m_mediaRings.lower_bound(prefix);
+  while (it != m_mediaRings.end() && it->first.NumCompare(prefix) == PObject::EqualTo) {
+    ReleaseMediaRing(it->second);
+    m_mediaRings.erase(it++);
+  }
+
+  std::pair<RetiredRingMap::iterator, RetiredRingMap::iterator> range = m_retiredRings.equal_range(token);
+  for (RetiredRingMap::iterator retired = range.first; retired != range.second; ++retired)
+    ReleaseMediaRing(retired->second);
+  m_retiredRings.erase(range.first, range.second);
+}
+
+
 bool OpalMediaDataCallbacks::OnReadMediaFrame(const OpalLocalConnection & connection,
                                               const OpalMediaStream & mediaStream,
                                               RTP_DataFrame & frame)
@@ -621,6 +918,13 @@ bool OpalMediaDataCallbacks::OnReadMediaFrame(const OpalLocalConnection & connec
     return false;
   }
 
+  OpalMediaRing * ring = GetMediaRing(connection, mediaStream);
+  if (ring != NULL) {
+    PINDEX length = WaitMediaRing(connection, mediaStream, *ring, frame.GetPointer(), frame.GetSize());
+    frame.SetPayloadSize(length > frame.GetHeaderSize() ? length-frame.GetHeaderSize() : 0);
+    return true;
+  }
+
   if (m_mediaReadData == NULL) {
     PTRACE(2, "OnReadMediaFrame failed due to no call back set.");
     return false;
@@ -649,6 +953,12 @@ bool OpalMediaDataCallbacks::OnWriteMediaFrame(const OpalLocalConnection & conne
     return false;
   }
 
+  OpalMediaRing * ring = GetMediaRing(connection, mediaStream);
+  if (ring != NULL) {
+    WriteMediaRing(*ring, frame.GetPointer(), frame.GetPacketSize());
+    return true;
+  }
+
   if (m_mediaWriteData == NULL) {
     PTRACE(2, "OnWriteMediaFrame failed due to no call back set.");
     return false;
@@ -675,6 +985,12 @@ bool OpalMediaDataCallbacks::OnReadMediaData(const OpalLocalConnection & connect
     return false;
   }
 
+  OpalMediaRing * ring = GetMediaRing(connection, mediaStream);
+  if (ring != NULL) {
+    length = WaitMediaRing(connection, mediaStream, *ring, data, size);
+    return true;
+  }
+
   if (m_mediaReadData == NULL) {
     PTRACE(2, "OnReadMediaData failed due to no call back set.");
     return false;
@@ -705,6 +1021,13 @@ bool OpalMediaDataCallbacks::OnWriteMediaData(const OpalLocalConnection & connec
     return false;
   }
 
+  OpalMediaRing * ring = GetMediaRing(connection, mediaStream);
+  if (ring != NULL) {
+    WriteMediaRing(*ring, data, length);
+    written = length;
+    return true;
+  }
+
   if (m_mediaWriteData == NULL) {
     PTRACE(2, "OnWriteMediaData failed due to no call back set.");
     return false;
@@ -1202,6 +1525,23 @@ OpalMessage * OpalManager_C::GetMessage(unsigned timeout, const char * & error)
 }
 
 
+unsigned OpalManager_C::GetMessages(OpalMessage ** messages, unsigned maxMessages, unsigned timeout)
+{
+  if (m_shuttingDown || messages == NULL || maxMessages == 0)
+    return 0;
+
+  PTRACE(5, "GetMessages: max=" << maxMessages << " timeout=" << timeout);
+
+  // Only wait for the first, the rest is whatever has already queued
+  unsigned count = 0;
+  while (count < maxMessages && m_messageQueue.Dequeue(messages[count], count == 0 ? timeout : 0))
+    ++count;
+
+  PTRACE_IF(4, count > 0, "Giving " << count << " messages to application");
+  return count;
+}
+
+
 OpalMessage * OpalManager_C::SendMessage(const OpalMessage * message)
 {
   if (message == NULL)
@@ -1759,6 +2099,23 @@ void OpalManager_C::HandleSetGeneral(const OpalMessage & command, OpalMessageBuf
   if (command.m_param.m_general.m_autoCreateCertificate > 0)
     SetSSLAutoCreateCertificate(command.m_param.m_general.m_autoCreateCertificate == 1);
 #endif
+
+  if (m_apiVersion < 37)
+    return;
+
+  if (localEP != NULL) {
+    response->m_param.m_general.m_mediaRingSize = localEP->m_mediaRingSize > 0 ? localEP->m_mediaRingSize : UINT_MAX;
+    unsigned size = command.m_param.m_general.m_mediaRingSize;
+    if (size == UINT_MAX)
+      localEP->m_mediaRingSize = 0;
+    else if (size > 0) {
+      // Power of two so positions can free run, and room for at least a maximum size RTP packet
+      unsigned ringSize = 4096;
+      while (ringSize < size && ringSize < 0x40000000)
+        ringSize <<= 1;
+      localEP->m_mediaRingSize = ringSize;
+    }
+  }
 }
 
 
@@ -2664,6 +3021,20 @@ void OpalManager_C::OnIndMediaStream(const OpalMediaStream & stream, OpalMediaSt
   SET_MESSAGE_STRING(message, m_param.m_mediaStream.m_type, type);
   SET_MESSAGE_STRING(message, m_param.m_mediaStream.m_format, stream.GetMediaFormat().GetName());
   message->m_param.m_mediaStream.m_state = state;
+  if (state == OpalMediaStateOpen && m_apiVersion >= 37) {
+    PSafePtr<OpalLocalConnection> local = connection.GetOtherPartyConnectionAs<OpalLocalConnection>();
+    OpalMediaDataCallbacks * callbacks = local != NULL ? dynamic_cast<OpalMediaDataCallbacks *>(&local->GetEndPoint()) : NULL;
+    if (callbacks != NULL) // The message holds a reference, released by OpalFreeMessage()
+      message->m_param.m_mediaStream.m_mediaRing = callbacks->GetMediaRing(connection.GetCall().GetToken(), type, stream.GetMediaFormat(), true);
+  }
+  else if (state == OpalMediaStateClose) {
+    // The local connection may already be gone, so try all the endpoints that could have a ring
+    for (PINDEX i = 0; i < PARRAYSIZE(LocalPrefixes); ++i) {
+      OpalMediaDataCallbacks * callbacks = dynamic_cast<OpalMediaDataCallbacks *>(FindEndPoint(LocalPrefixes[i]));
+      if (callbacks != NULL)
+        callbacks->RetireMediaRing(connection.GetCall().GetToken(), type);
+    }
+  }
   PTRACE(4, "OnIndMediaStream:"
             " token=\"" << message->m_param.m_userInput.m_callToken << "\""
             " id=\"" << message->m_param.m_mediaStream.m_identifier << '"');
@@ -2763,6 +3134,12 @@ void OpalManager_C::OnClearedCall(OpalCall & call)
             " reason=\"" << message->m_param.m_callCleared.m_reason << '"');
   PostMessage(message);
 
+  for (PINDEX i = 0; i < PARRAYSIZE(LocalPrefixes); ++i) {
+    OpalMediaDataCallbacks * callbacks = dynamic_cast<OpalMediaDataCallbacks *>(FindEndPoint(LocalPrefixes[i]));
+    if (callbacks != NULL)
+      callbacks->ReleaseMediaRings(call.GetToken());
+  }
+
   OpalManager::OnClearedCall(call);
 }
 
@@ -3041,6 +3418,12 @@ extern "C" {
   }
 
 
+  unsigned OPAL_EXPORT OpalGetMessages(OpalHandle handle, OpalMessage ** messages, unsigned maxMessages, unsigned timeout)
+  {
+    return handle == NULL ? 0 : handle->m_manager->GetMessages(messages, maxMessages, timeout);
+  }
+
+
   OpalMessage * OPAL_EXPORT OpalSendMessage(OpalHandle handle, const OpalMessage * message)
   {
     return handle == NULL ? NULL : handle->m_manager->SendMessage(message);
@@ -3050,7 +3433,14 @@ extern "C" {
   void OPAL_EXPORT OpalFreeMessage(OpalMessage * message)
   {
     if (message != NULL)
-      free(message);
+      FreeMessage(message);
+  }
+
+
+  void OPAL_EXPORT OpalSignalMediaRing(OpalMediaRing * ring)
+  {
+    if (ring != NULL)
+      static_cast<OpalMediaRingAllocation *>(ring)->m_written.Signal();
   }
 
 }; // extern "C"
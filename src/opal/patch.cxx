@@ -55,6 +55,9 @@
 OpalMediaPatch::OpalMediaPatch(OpalMediaStream & src)
   : PSafeObject(m_instrumentedMutex)
   , m_source(src)
+#if OPAL_VIDEO
+  , m_codecBufferOwner(NULL)
+#endif
   , m_bypassToPatch(NULL)
   , m_bypassFromPatch(NULL)
   , m_patchThread(NULL)
@@ -266,12 +269,48 @@ static bool SetStreamDataSize(OpalMediaStream & stream, OpalTranscoder & codec)
 }
 
 
+#if OPAL_VIDEO
+void OpalMediaPatch::Sink::AllocateCodecThreads(OpalMediaFormat & sourceFormat, OpalMediaFormat & destinationFormat)
+{
+  if (sourceFormat.GetMediaType() != OpalMediaType::Video())
+    return;
+
+  OpalManager & manager = m_patch.m_source.GetConnection().GetEndPoint().GetManager();
+
+  if (sourceFormat.IsTransportable()) {
+    unsigned threads = manager.AllocateCodecThreads(sourceFormat.GetOptionInteger(OpalVideoFormat::DecoderThreadsOption()));
+    m_codecThreads += threads;
+    sourceFormat.SetOptionInteger(OpalVideoFormat::DecoderThreadsOption(), threads);
+  }
+
+  if (destinationFormat.IsTransportable()) {
+    unsigned threads = manager.AllocateCodecThreads(destinationFormat.GetOptionInteger(OpalVideoFormat::EncoderThreadsOption()));
+    m_codecThreads += threads;
+    destinationFormat.SetOptionInteger(OpalVideoFormat::EncoderThreadsOption(), threads);
+  }
+}
+
+
+void OpalMediaPatch::Sink::ReleaseCodecThreads()
+{
+  if (m_codecThreads == 0)
+    return;
+
+  m_patch.m_source.GetConnection().GetEndPoint().GetManager().ReleaseCodecThreads(m_codecThreads);
+  m_codecThreads = 0;
+}
+#endif // OPAL_VIDEO
+
+
 bool OpalMediaPatch::Sink::CreateTranscoders()
 {
-  delete m_primaryCodec;
+  m_patch.DeleteTranscoder(m_primaryCodec);
   m_primaryCodec = NULL;
   delete m_secondaryCodec;
   m_secondaryCodec = NULL;
+#if OPAL_VIDEO
+  ReleaseCodecThreads();
+#endif
 
   // Find the media formats than can be used to get from source to sink
   OpalMediaFormat sourceFormat = m_patch.m_source.GetMediaFormat();
@@ -300,6 +339,10 @@ bool OpalMediaPatch::Sink::CreateTranscoders()
     return true;
   }
 
+#if OPAL_VIDEO
+  AllocateCodecThreads(sourceFormat, destinationFormat);
+#endif
+
   PString id = m_stream->GetID();
   m_primaryCodec = OpalTranscoder::Create(sourceFormat, destinationFormat, (const BYTE *)id, id.GetLength());
   if (m_primaryCodec != NULL) {
@@ -507,6 +550,9 @@ OpalMediaPatch::Sink::Sink(OpalMediaPatch & p, const OpalMediaStreamPtr & s)
   , m_stream(s)
   , m_primaryCodec(NULL)
   , m_secondaryCodec(NULL)
+#if OPAL_VIDEO
+  , m_codecThreads(0)
+#endif
 {
   PTRACE_CONTEXT_ID_FROM(p);
 
@@ -516,8 +562,11 @@ OpalMediaPatch::Sink::Sink(OpalMediaPatch & p, const OpalMediaStreamPtr & s)
 
 OpalMediaPatch::Sink::~Sink()
 {
-  delete m_primaryCodec;
+  m_patch.DeleteTranscoder(m_primaryCodec);
   delete m_secondaryCodec;
+#if OPAL_VIDEO
+  ReleaseCodecThreads();
+#endif
 }
 
 
@@ -734,6 +783,12 @@ void OpalMediaPatch::Main()
      each time and passed back in to source.Read() (and eventually the JB) so
      it knows where it is up to in extracting data from the JB. */
   RTP_DataFrame sourceFrame(0);
+#if OPAL_VIDEO
+  // Only raw video frames are big enough for building them in place to matter
+  OpalMediaFormat sourceFormat = m_source.GetMediaFormat();
+  bool useCodecBuffer = sourceFormat.GetMediaType() == OpalMediaType::Video() && !sourceFormat.IsTransportable();
+  bool inCodecBuffer = false;
+#endif
 
   while (m_source.IsOpen()) {
     if (m_source.IsPaused()) {
@@ -743,6 +798,25 @@ void OpalMediaPatch::Main()
       continue;
     }
 
+#if OPAL_VIDEO
+    /* If the codec can take the frame in memory of its own, e.g. shared with
+       an encoder process, read the source straight into it, saving a copy. */
+    PINDEX frameSize = RTP_DataFrame::MinHeaderSize + m_source.GetDataSize();
+    BYTE * codecBuffer = useCodecBuffer ? GetCodecInputBuffer(frameSize) : NULL;
+    if (codecBuffer != NULL) {
+      // Plain header, or the frame would parse whatever was left there
+      memset(codecBuffer, 0, RTP_DataFrame::MinHeaderSize);
+      codecBuffer[0] = 0x80;
+      sourceFrame = RTP_DataFrame(codecBuffer, frameSize, false);
+      inCodecBuffer = true;
+    }
+    else if (inCodecBuffer) {
+      // The codec may have gone, do not touch its memory again
+      sourceFrame = RTP_DataFrame(0);
+      inCodecBuffer = false;
+    }
+#endif // OPAL_VIDEO
+
     if (!m_source.ReadPacket(sourceFrame)) {
       PTRACE(4, "Thread ended because source read failed on " << *this);
       break;
@@ -775,6 +849,10 @@ void OpalMediaPatch::Main()
     }
   }
 
+#if OPAL_VIDEO
+  ReleaseCodecBuffer();
+#endif
+
   m_source.OnStopMediaPatch(*this);
 
   if (m_sinks.IsEmpty()) {
@@ -872,6 +950,57 @@ bool OpalMediaPatch::DispatchFrame(RTP_DataFrame & frame)
 }
 
 
+#if OPAL_VIDEO
+BYTE * OpalMediaPatch::GetCodecInputBuffer(PINDEX size)
+{
+  // Done with the last frame, so anything retired since can go now
+  ReleaseCodecBuffer();
+
+  if (!LockReadOnly(P_DEBUG_LOCATION))
+    return NULL;
+
+  // Only worth it if the one sink converts the frame before anyone else uses it
+  BYTE * buffer = NULL;
+  if (m_sinks.GetSize() == 1 && m_bypassToPatch == NULL) {
+    OpalTranscoder * codec = m_sinks.front().m_primaryCodec;
+    if (codec != NULL && (buffer = codec->GetInputBuffer(size)) != NULL) {
+      // Keep the codec, and its memory, alive should the sink let go of it mid frame
+      PWaitAndSignal mutex(m_codecBufferMutex);
+      m_codecBufferOwner = codec;
+    }
+  }
+
+  UnlockReadOnly(P_DEBUG_LOCATION);
+  return buffer;
+}
+
+
+void OpalMediaPatch::ReleaseCodecBuffer()
+{
+  PWaitAndSignal mutex(m_codecBufferMutex);
+  m_codecBufferOwner = NULL;
+  m_retiredCodecs.RemoveAll();
+}
+#endif // OPAL_VIDEO
+
+
+void OpalMediaPatch::DeleteTranscoder(OpalTranscoder * codec)
+{
+#if OPAL_VIDEO
+  if (codec != NULL) {
+    PWaitAndSignal mutex(m_codecBufferMutex);
+    if (codec == m_codecBufferOwner) {
+      PTRACE(4, "Deferring delete of " << *codec << " until patch thread has finished with its buffer");
+      m_retiredCodecs.Append(codec);
+      return;
+    }
+  }
+#endif
+
+  delete codec;
+}
+
+
 bool OpalMediaPatch::DispatchFrameLocked(RTP_DataFrame & frame, bool bypassing)
 {
   if (m_transcoderChanged) {
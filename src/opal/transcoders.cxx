@@ -145,6 +145,12 @@ void OpalTranscoder::SetInstanceID(const BYTE * /*instance*/, unsigned /*instanc
 }
 
 
+BYTE * OpalTranscoder::GetInputBuffer(PINDEX /*size*/)
+{
+  return NULL;
+}
+
+
 RTP_DataFrame::PayloadTypes OpalTranscoder::GetPayloadType(PBoolean input) const
 {
   PWaitAndSignal mutex(updateMutex);
@@ -465,6 +471,83 @@ OpalMediaFormatList OpalTranscoder::GetSourceFormats(const OpalMediaFormat & dst
 }
 
 
+/* For each format, indexed by OpalMediaFormatSet::GetIndex(), the formats
+   reachable via a transcoder. This is a row of the bit matrix, for quick
+   tests, and the same indexes in the order GetPossibleFormats() adds them.
+   Only indexes are kept, as the registered formats they refer to may have
+   their options changed or be removed. */
+struct TranscoderClosureRow
+{
+  OpalMediaFormatSet  m_reachable;
+  std::vector<PINDEX> m_order;
+};
+
+typedef std::vector<TranscoderClosureRow> TranscoderClosure;
+
+// Rebuilt if transcoders are registered or removed, e.g. plug ins.
+static void UpdateTranscoderClosure(TranscoderClosure & closure, size_t & transcoderCount)
+{
+  OpalTranscoderList availableTranscoders = OpalTranscoderFactory::GetKeyList();
+  if (transcoderCount == availableTranscoders.size())
+    return;
+
+  closure.clear();
+  transcoderCount = availableTranscoders.size();
+
+  OpalMediaFormatSet done;
+  for (OpalTranscoderIterator t = availableTranscoders.begin(); t != availableTranscoders.end(); ++t) {
+    OpalMediaFormat dstFormat = t->second;
+    PINDEX index = OpalMediaFormatSet::GetIndex(dstFormat);
+    if (index == P_MAX_INDEX || done.Contains(dstFormat))
+      continue;
+    done += dstFormat;
+
+    if ((PINDEX)closure.size() <= index)
+      closure.resize(index+1);
+    TranscoderClosureRow & row = closure[index];
+
+    OpalMediaFormatList srcFormats = OpalTranscoder::GetSourceFormats(dstFormat);
+    for (OpalMediaFormatList::iterator s = srcFormats.begin(); s != srcFormats.end(); ++s) {
+      OpalMediaFormatList dstFormats = OpalTranscoder::GetDestinationFormats(*s);
+      if (dstFormats.GetSize() > 0) {
+        row.m_reachable += *s;
+        row.m_order.push_back(OpalMediaFormatSet::GetIndex(*s));
+        for (OpalMediaFormatList::iterator d = dstFormats.begin(); d != dstFormats.end(); ++d) {
+          if (d->IsValid()) {
+            row.m_reachable += *d;
+            row.m_order.push_back(OpalMediaFormatSet::GetIndex(*d));
+          }
+        }
+      }
+    }
+  }
+
+  PTRACE(4, "Calculated transcoder closure for " << transcoderCount << " transcoders");
+}
+
+
+// Rebuilt from the master list whenever it changes, so options are never stale.
+static void UpdateRegisteredFormats(std::vector<OpalMediaFormat> & registered, unsigned & sequence)
+{
+  unsigned current = OpalMediaFormat::GetRegisteredMediaFormatsSequence();
+  if (sequence == current && !registered.empty())
+    return;
+
+  sequence = current;
+  registered.clear();
+
+  OpalMediaFormatList formats = OpalMediaFormat::GetAllRegisteredMediaFormats();
+  for (OpalMediaFormatList::iterator f = formats.begin(); f != formats.end(); ++f) {
+    PINDEX index = OpalMediaFormatSet::GetIndex(*f);
+    if (index == P_MAX_INDEX)
+      continue;
+    if ((PINDEX)registered.size() <= index)
+      registered.resize(index+1);
+    registered[index] = *f;
+  }
+}
+
+
 OpalMediaFormatList OpalTranscoder::GetPossibleFormats(const OpalMediaFormatList & formats)
 {
   OpalMediaFormatList possibleFormats;
@@ -473,18 +556,29 @@ OpalMediaFormatList OpalTranscoder::GetPossibleFormats(const OpalMediaFormatList
   for (OpalMediaFormatList::const_iterator f = formats.begin(); f != formats.end(); ++f)
     possibleFormats += *f;
 
-  // Now calculate all of the possible formats via a transcoder
-  for (OpalMediaFormatList::const_iterator f = formats.begin(); f != formats.end(); ++f) {
-    OpalMediaFormatList srcFormats = GetSourceFormats(*f);
-    for (OpalMediaFormatList::iterator s = srcFormats.begin(); s != srcFormats.end(); ++s) {
-      OpalMediaFormatList dstFormats = GetDestinationFormats(*s);
-      if (dstFormats.GetSize() > 0) {
-        possibleFormats += *s;
+  OpalMediaFormatSet possibleSet(possibleFormats);
 
-        for (OpalMediaFormatList::iterator d = dstFormats.begin(); d != dstFormats.end(); ++d) {
-          if (d->IsValid())
-            possibleFormats += *d;
-        }
+  // Now add all of the possible formats via a transcoder
+  static PMutex mutex;
+  static TranscoderClosure closure;
+  static size_t transcoderCount = 0;
+  static std::vector<OpalMediaFormat> registered;
+  static unsigned registeredSequence = 0;
+
+  PWaitAndSignal lock(mutex);
+  UpdateTranscoderClosure(closure, transcoderCount);
+  UpdateRegisteredFormats(registered, registeredSequence);
+
+  for (OpalMediaFormatList::const_iterator f = formats.begin(); f != formats.end(); ++f) {
+    PINDEX index = OpalMediaFormatSet::GetIndex(*f);
+    if (index >= (PINDEX)closure.size() || closure[index].m_reachable.IsSubsetOf(possibleSet))
+      continue;
+
+    const std::vector<PINDEX> & order = closure[index].m_order;
+    for (std::vector<PINDEX>::const_iterator r = order.begin(); r != order.end(); ++r) {
+      if (*r < (PINDEX)registered.size() && registered[*r].IsValid() && !possibleSet.ContainsIndex(*r)) {
+        possibleFormats += registered[*r];
+        possibleSet.AddIndex(*r);
       }
     }
   }
@@ -879,6 +879,8 @@ OpalListenerUDP::OpalListenerUDP(OpalEndPoint & endpoint,
   , m_listenerBundle(PMonitoredSockets::Create(binding.AsString(),
                                                !exclusive
                                                P_NAT_PARAM(&endpoint.GetManager().GetNatMethods())))
+  , m_bufferSize(32768)
+  , m_receiveThreadCount(1)
 {
 }
 
@@ -891,6 +893,7 @@ OpalListenerUDP::OpalListenerUDP(OpalEndPoint & endpoint,
                                                !m_exclusiveListener
                                                P_NAT_PARAM(&endpoint.GetManager().GetNatMethods())))
   , m_bufferSize(32768)
+  , m_receiveThreadCount(1)
 {
   if (binding.GetHostName() == "*")
     m_binding.SetAddress(PIPSocket::GetInvalidAddress()); // Set invalid to distinguish between "*", "0.0.0.0" and "[::]"
@@ -905,20 +908,37 @@ OpalListenerUDP::~OpalListenerUDP()
 
 PBoolean OpalListenerUDP::Open(const AcceptHandler & theAcceptHandler, ThreadMode /*mode*/)
 {
-  if (m_listenerBundle != NULL &&
-      m_listenerBundle->Open(m_binding.GetPort()) &&
-      OpalListenerIP::Open(theAcceptHandler, SingleThreadMode)) {
-    m_binding.SetPort(m_listenerBundle->GetPort());
-    /* UDP packets need to be handled. Not so much at high speed, but must not be
-       significantly delayed by media threads which are running at HighPriority.
-       This, for example, helps make sure that a SIP BYE is received and processed
-       to kill a call where codecs etc in the media threads are hogging all the CPU. */
-    m_thread->SetPriority(PThread::HighestPriority);
-    return true;
+  if (m_listenerBundle == NULL || !m_listenerBundle->Open(m_binding.GetPort())) {
+    PTRACE(1, "Could not start any UDP listeners for port " << m_binding.GetPort());
+    return false;
   }
 
-  PTRACE(1, "Could not start any UDP listeners for port " << m_binding.GetPort());
-  return false;
+  if (m_receiveThreadCount > 1) {
+    m_acceptHandler = theAcceptHandler;
+    m_threadMode = SingleThreadMode;
+
+    for (unsigned i = 0; i < m_receiveThreadCount; ++i) {
+      ReceiveThread * info = new ReceiveThread;
+      info->m_thread = new PThreadObj1Arg<OpalListenerUDP, ReceiveThread *>(*this, info, &OpalListenerUDP::ReceiveThreadMain,
+                                                                            false, psprintf("UDP Rx:%u", i));
+      info->m_thread->SetPriority(PThread::HighestPriority);
+      m_receiveThreads.push_back(info);
+    }
+
+    m_thread = new PThreadObj<OpalListenerUDP>(*this, &OpalListenerUDP::ReadForReceiveThreads, false, "Opal Listener");
+  }
+  else if (!OpalListenerIP::Open(theAcceptHandler, SingleThreadMode)) {
+    PTRACE(1, "Could not start UDP listener thread for port " << m_binding.GetPort());
+    return false;
+  }
+
+  m_binding.SetPort(m_listenerBundle->GetPort());
+  /* UDP packets need to be handled. Not so much at high speed, but must not be
+     significantly delayed by media threads which are running at HighPriority.
+     This, for example, helps make sure that a SIP BYE is received and processed
+     to kill a call where codecs etc in the media threads are hogging all the CPU. */
+  m_thread->SetPriority(PThread::HighestPriority);
+  return true;
 }
 
 
@@ -961,6 +981,96 @@ OpalTransport * OpalListenerUDP::Accept(const PTimeInterval & timeout)
 }
 
 
+static unsigned HashRemoteKey(const PString & key)
+{
+  // FNV-1a, PString::HashFunction() has too small a range to spread threads
+  unsigned hash = 2166136261U;
+  for (const char * ptr = key; *ptr != '\0'; ++ptr)
+    hash = (hash ^ (BYTE)*ptr) * 16777619U;
+  return hash;
+}
+
+
+void OpalListenerUDP::ReadForReceiveThreads()
+{
+  PTRACE(3, "Started listening thread on " << GetLocalAddress() << " with " << m_receiveThreads.size() << " receive threads");
+
+  while (IsOpen()) {
+    PBYTEArray pdu;
+    PMonitoredSockets::BundleParams param;
+    param.m_buffer = pdu.GetPointer(m_bufferSize);
+    param.m_length = m_bufferSize;
+    param.m_timeout = PMaxTimeInterval;
+    m_listenerBundle->ReadFromBundle(param);
+
+    if (param.m_errorCode != PChannel::NoError)
+      continue;
+
+    pdu.SetSize(param.m_lastCount);
+
+    OpalTransportAddress remoteAddress(param.m_addr, param.m_port, OpalTransportAddress::UdpPrefix());
+    PString key = remoteAddress + '%' + param.m_iface;
+
+    // Same remote always goes to the same thread, so its packets are handled in order
+    ReceiveThread & info = *m_receiveThreads[HashRemoteKey(key) % m_receiveThreads.size()];
+
+    PTimeInterval now = PTimer::Tick();
+    if (now - info.m_lastCacheCheck > 10000) {
+      info.m_lastCacheCheck = now;
+      TransportCache::iterator it = info.m_transports.begin();
+      while (it != info.m_transports.end()) {
+        if (now - it->second.m_lastUsed > 60000)
+          info.m_transports.erase(it++);
+        else
+          ++it;
+      }
+    }
+
+    CachedTransport & cached = info.m_transports[key];
+    cached.m_lastUsed = now;
+    if (cached.m_transport == NULL || !cached.m_transport->IsOpen()) {
+      OpalTransportUDP * transport = new OpalTransportUDP(m_endpoint, m_listenerBundle, param.m_iface, remoteAddress);
+      transport->GetChannel()->SetBufferSize(m_bufferSize);
+      cached.m_transport = transport;
+      PTRACE(4, "Created cached transport " << *transport);
+    }
+
+    info.m_queue.Enqueue(ReceivedPacket(cached.m_transport, pdu));
+  }
+
+  PTRACE(3, "Stopped listening thread on " << GetLocalAddress());
+
+  for (std::vector<ReceiveThread *>::iterator it = m_receiveThreads.begin(); it != m_receiveThreads.end(); ++it) {
+    (*it)->m_queue.Close(false);
+    PThread::WaitAndDelete((*it)->m_thread);
+    delete *it;
+  }
+  m_receiveThreads.clear();
+}
+
+
+void OpalListenerUDP::ReceiveThreadMain(ReceiveThread * info)
+{
+  ReceivedPacket packet;
+  while (info->m_queue.Dequeue(packet)) {
+    OpalTransportUDP * transport = dynamic_cast<OpalTransportUDP *>(&*packet.m_transport);
+    if (transport == NULL)
+      continue;
+
+    /* The remote address of a cached transport is never changed, it is
+       shared with PDUs still being processed in the SIP thread pool, and
+       responses to a Via address use WriteTo(). Only this thread reads. */
+    {
+      PSafeLockReadWrite lock(*transport);
+      transport->m_preReadPacket = packet.m_pdu;
+      transport->m_preReadOK = true;
+    }
+
+    m_acceptHandler(*this, packet.m_transport);
+  }
+}
+
+
 OpalTransport * OpalListenerUDP::CreateTransport(const OpalTransportAddress & localAddress,
                                                  const OpalTransportAddress & remoteAddress) const
 {
@@ -1765,6 +1875,33 @@ bool OpalTransportUDP::WriteConnect(const WriteConnectCallback & function)
 }
 
 
+bool OpalTransportUDP::WriteTo(const void * buf, PINDEX len, const OpalTransportAddress & address)
+{
+  PMonitoredSocketChannel * socket = dynamic_cast<PMonitoredSocketChannel *>(m_channel);
+  if (socket == NULL)
+    return false;
+
+  PIPSocketAddressAndPort ap;
+  if (!address.GetIpAndPort(ap)) {
+    PTRACE(2, "Illegal address to write to: " << address);
+    return socket->SetErrorValues(PChannel::BadParameter, EINVAL, PChannel::LastWriteError);
+  }
+
+  PMonitoredSockets::BundleParams param;
+  param.m_buffer = const_cast<void *>(buf);
+  param.m_length = len;
+  param.m_addr = ap.GetAddress();
+  param.m_port = ap.GetPort();
+  param.m_iface = socket->GetInterface();
+  socket->GetMonitoredSockets()->WriteToBundle(param);
+  if (param.m_errorCode == PChannel::NoError)
+    return true;
+
+  // As Write() would, so GetErrorText(PChannel::LastWriteError) says why
+  return socket->SetErrorValues(param.m_errorCode, param.m_errorNumber, PChannel::LastWriteError);
+}
+
+
 const PCaselessString & OpalTransportUDP::GetProtoPrefix() const
 {
   return OpalTransportAddress::UdpPrefix();
@@ -1775,12 +1912,197 @@ const PCaselessString & OpalTransportUDP::GetProtoPrefix() const
 
 #if OPAL_PTLIB_SSL
 
+class OpalTLSHandshakeWork : public PObject
+{
+    PCLASSINFO(OpalTLSHandshakeWork, PObject);
+  public:
+    OpalTLSHandshakeWork() : m_queued(PTimer::Tick()) { }
+    virtual void Work() = 0;
+
+  protected:
+    PTimeInterval m_queued;
+};
+
+
+/* Separate pools for accepting and connecting, so an incoming flood cannot
+   starve our own outgoing connections, and vice versa. */
+class OpalTLSHandshakePool : public PQueuedThreadPool<OpalTLSHandshakeWork>
+{
+    typedef PQueuedThreadPool<OpalTLSHandshakeWork> BaseClass;
+    PCLASSINFO(OpalTLSHandshakePool, BaseClass);
+  public:
+    OpalTLSHandshakePool(bool server)
+      : BaseClass(4, 0, server ? "TLS Accept" : "TLS Connect", PThread::HighPriority)
+      , m_server(server)
+      , m_timeout(0, server ? 10 : 20)
+    {
+    }
+
+    static OpalTLSHandshakePool & Get(bool server)
+    {
+      static OpalTLSHandshakePool serverPool(true);
+      static OpalTLSHandshakePool clientPool(false);
+      return server ? serverPool : clientPool;
+    }
+
+    void Queue(OpalTLSHandshakeWork * work)
+    {
+      m_mutex.Wait();
+      ++m_statistics.m_pending;
+      m_mutex.Signal();
+      AddWork(work);
+    }
+
+    // Returns false if it has been queued for so long it is not worth starting
+    bool Start(PChannel & socket, const PTimeInterval & queued)
+    {
+      PTimeInterval timeout = GetTimeout();
+      PTimeInterval remaining = timeout - (PTimer::Tick() - queued);
+      if (remaining <= 0) {
+        PTRACE(2, "TLS", "Handshake queued for longer than " << timeout << " seconds, abandoning");
+        return false;
+      }
+
+      // Limits each read/write of the handshake, so a silent peer cannot hold a thread
+      socket.SetReadTimeout(remaining);
+      socket.SetWriteTimeout(remaining);
+      return true;
+    }
+
+    void Completed(PChannel * socket, bool ok, bool started, const PTimeInterval & queued)
+    {
+      if (ok && socket != NULL) {
+        socket->SetReadTimeout(PMaxTimeInterval);
+        socket->SetWriteTimeout(PMaxTimeInterval);
+      }
+
+      PTimeInterval duration = PTimer::Tick() - queued;
+
+      PWaitAndSignal mutex(m_mutex);
+      --m_statistics.m_pending;
+      if (!ok) {
+        ++m_statistics.m_failed;
+        if (!started || duration >= m_timeout)
+          ++m_statistics.m_timedOut;
+      }
+      else {
+        if (m_server)
+          ++m_statistics.m_accepted;
+        else
+          ++m_statistics.m_connected;
+        m_statistics.m_totalTime += duration;
+        if (m_statistics.m_maximumTime < duration)
+          m_statistics.m_maximumTime = duration;
+      }
+    }
+
+    OpalTransportTLS::HandshakeStatistics GetStatistics()
+    {
+      PWaitAndSignal mutex(m_mutex);
+      return m_statistics;
+    }
+
+    PTimeInterval GetTimeout()
+    {
+      PWaitAndSignal mutex(m_mutex);
+      return m_timeout;
+    }
+
+    void SetTimeout(const PTimeInterval & timeout)
+    {
+      PWaitAndSignal mutex(m_mutex);
+      m_timeout = timeout;
+    }
+
+  protected:
+    bool m_server;
+    PDECLARE_MUTEX(m_mutex);
+    PTimeInterval m_timeout;
+    OpalTransportTLS::HandshakeStatistics m_statistics;
+};
+
+
+class OpalTLSAcceptWork : public OpalTLSHandshakeWork
+{
+    PCLASSINFO(OpalTLSAcceptWork, OpalTLSHandshakeWork);
+  public:
+    OpalTLSAcceptWork(OpalListenerTLS & listener, PTCPSocket * socket)
+      : m_listener(listener)
+      , m_socket(socket)
+    {
+      PWaitAndSignal mutex(m_listener.m_handshakesMutex);
+      ++m_listener.m_pendingHandshakes;
+    }
+
+    virtual void Work()
+    {
+      OpalTLSHandshakePool & pool = OpalTLSHandshakePool::Get(true);
+      OpalTransport * transport = NULL;
+      bool started = m_listener.IsOpen() && pool.Start(*m_socket, m_queued);
+      if (started)
+        transport = m_listener.OnHandshake(m_socket); // Takes the socket, even on failure
+      else
+        delete m_socket;
+      pool.Completed(transport != NULL ? m_socket : NULL, transport != NULL, started, m_queued);
+
+      if (transport != NULL)
+        transport->AttachThread(new PThreadObj1Arg<OpalListenerTLS, OpalTransportPtr>(
+                      m_listener, transport, &OpalListenerTLS::TransportThreadMain, false, "Opal Answer"));
+
+      /* Must be last, listener may be destroyed as soon as this is done. The
+         signal is inside the mutex, so the destructor, which must take the
+         mutex to see the count is zero, cannot run until we are out of it. */
+      PWaitAndSignal mutex(m_listener.m_handshakesMutex);
+      if (--m_listener.m_pendingHandshakes == 0)
+        m_listener.m_handshakesDone.Signal();
+    }
+
+  protected:
+    OpalListenerTLS & m_listener;
+    PTCPSocket      * m_socket;
+};
+
+
+class OpalTLSConnectWork : public OpalTLSHandshakeWork
+{
+    PCLASSINFO(OpalTLSConnectWork, OpalTLSHandshakeWork);
+  public:
+    OpalTLSConnectWork(OpalTransportTLS & transport, PSSLChannel * ssl, PChannel * socket)
+      : m_transport(transport)
+      , m_ssl(ssl)
+      , m_socket(socket)
+    {
+    }
+
+    virtual void Work()
+    {
+      OpalTLSHandshakePool & pool = OpalTLSHandshakePool::Get(false);
+      bool started = pool.Start(*m_socket, m_queued);
+      bool ok = started && m_ssl->Connect(m_socket);
+      pool.Completed(m_socket, ok, started, m_queued);
+
+      if (!started) {
+        delete m_ssl; // Never given the socket, so the transport keeps it
+        m_ssl = NULL;
+      }
+
+      // Must be last, transport may be destroyed as soon as this is done
+      m_transport.OnHandshakeComplete(m_ssl, ok);
+    }
+
+  protected:
+    OpalTransportTLS & m_transport;
+    PSSLChannel      * m_ssl;
+    PChannel         * m_socket;
+};
+
+
 OpalListenerTLS::OpalListenerTLS(OpalEndPoint & ep,
                                  PIPSocket::Address binding,
                                  WORD port,
                                  PBoolean exclusive)
                                  : OpalListenerTCP(ep, binding, port, exclusive)
-                                 , m_sslContext(NULL)
+                                 , m_pendingHandshakes(0)
 {
 }
 
@@ -1789,23 +2111,32 @@ OpalListenerTLS::OpalListenerTLS(OpalEndPoint & ep,
                                  const OpalTransportAddress & binding,
                                  OpalTransportAddress::BindOptions option)
                                  : OpalListenerTCP(ep, binding, option)
-                                 , m_sslContext(NULL)
+                                 , m_pendingHandshakes(0)
 {
 }
 
 
 OpalListenerTLS::~OpalListenerTLS()
 {
-  delete m_sslContext;
+  CloseWait();
+
+  /* Queued handshakes still refer to us, as we are closed they complete
+     without doing a handshake, but we have to wait for them to get to it. */
+  for (;;) {
+    m_handshakesMutex.Wait();
+    unsigned pending = m_pendingHandshakes;
+    m_handshakesMutex.Signal();
+    if (pending == 0)
+      break;
+    PTRACE(4, "Waiting for " << pending << " handshakes to complete");
+    m_handshakesDone.Wait(); // May be an old signal from an earlier zero, so loop
+  }
 }
 
 
 PBoolean OpalListenerTLS::Open(const AcceptHandler & acceptHandler, ThreadMode mode)
 {
-  m_sslContext = new PSSLContext();
-  m_sslContext->SetCipherList("ALL");
-
-  if (!m_endpoint.ApplySSLCredentials(*m_sslContext, true))
+  if (m_endpoint.GetSSLContext(true) == NULL)
     return false;
 
   return OpalListenerTCP::Open(acceptHandler, mode);
@@ -1814,12 +2145,30 @@ PBoolean OpalListenerTLS::Open(const AcceptHandler & acceptHandler, ThreadMode m
 
 OpalTransport * OpalListenerTLS::OnAccept(PTCPSocket * socket)
 {
-  PSSLChannel * ssl = new PSSLChannel(m_sslContext);
+  if (m_threadMode != SpawnNewThreadMode)
+    return OnHandshake(socket);
+
+  OpalTLSHandshakePool::Get(true).Queue(new OpalTLSAcceptWork(*this, socket));
+  return NULL;
+}
+
+
+OpalTransport * OpalListenerTLS::OnHandshake(PTCPSocket * socket)
+{
+  // Get context each time, so changed credentials are picked up
+  PSSLContext * context = m_endpoint.UseSSLContext(true);
+  if (context == NULL) {
+    delete socket;
+    return NULL;
+  }
+
+  PSSLChannel * ssl = new PSSLChannel(context);
   if (ssl->Accept(socket))
-    return new OpalTransportTLS(m_endpoint, ssl);
+    return new OpalTransportTLS(m_endpoint, ssl, context);
 
   PTRACE(1, "Accept failed: " << ssl->GetErrorText());
   delete ssl; // Will also delete socket
+  m_endpoint.ReleaseSSLContext(context);
   return NULL;
 }
 
@@ -1849,12 +2198,16 @@ OpalTransportTLS::OpalTransportTLS(OpalEndPoint & ep,
                                    WORD port,
                                    PBoolean reuseAddr)
   : OpalTransportTCP(ep, binding, port, reuseAddr)
+  , m_sslContext(NULL)
+  , m_handshakePending(false)
 {
 }
 
 
-OpalTransportTLS::OpalTransportTLS(OpalEndPoint & ep, PChannel * ssl)
+OpalTransportTLS::OpalTransportTLS(OpalEndPoint & ep, PChannel * ssl, PSSLContext * context)
   : OpalTransportTCP(ep, ssl)
+  , m_sslContext(context)
+  , m_handshakePending(false)
 {
 }
 
@@ -1862,6 +2215,8 @@ OpalTransportTLS::OpalTransportTLS(OpalEndPoint & ep, PChannel * ssl)
 OpalTransportTLS::~OpalTransportTLS()
 {
   CloseWait();
+  WaitForHandshake(); // Closed, so a queued handshake fails quickly, but it still refers to us
+  m_endpoint.ReleaseSSLContext(m_sslContext);
   PTRACE(4, "Deleted transport " << *this);
 }
 
@@ -1882,24 +2237,87 @@ PBoolean OpalTransportTLS::Connect()
 
   PSafeLockReadWrite mutex(*this);
 
+  // A previous attempt may still be completing, it refers to the old channel
+  WaitForHandshake();
+
   delete m_channel;
   m_channel = new PTCPSocket(m_remoteAP.GetPort());
   if (!OpalTransportTCP::Connect())
     return false;
 
-  PSSLContext * context = new PSSLContext();
-  if (!m_endpoint.ApplySSLCredentials(*context, false)) {
-    delete context;
+  PSSLContext * context = m_endpoint.UseSSLContext(false);
+  if (context == NULL)
     return false;
+  m_endpoint.ReleaseSSLContext(m_sslContext);
+  m_sslContext = context;
+
+  /* Do not wait for the handshake, the TCP socket remains our channel until
+     it is done, and anything reading or writing waits for it instead. */
+  m_handshakeMutex.Wait();
+  m_handshakePending = true;
+  m_handshakeMutex.Signal();
+
+  OpalTLSHandshakePool::Get(false).Queue(new OpalTLSConnectWork(*this, new PSSLChannel(context), m_channel));
+  return true;
+}
+
+
+void OpalTransportTLS::OnHandshakeComplete(PChannel * ssl, bool ok)
+{
+  /* Cannot use the transport lock, a writer may hold it while waiting for
+     us, so the channel is switched under our own mutex. Readers and writers
+     have already waited for this, and the TCP socket is not deleted, the
+     SSL channel owns it, so others looking at the channel are safe. */
+  PWaitAndSignal mutex(m_handshakeMutex);
+
+  if (ssl != NULL)
+    m_channel = ssl;
+
+  if (!ok) {
+    PTRACE(1, "Connect failed: " << m_channel->GetErrorText());
+    m_channel->Close();
   }
 
-  PSSLChannel * sslChannel = new PSSLChannel(context, true);
+  m_handshakePending = false;
+  m_handshakeDone.Signal();
+}
 
-  bool ok = sslChannel->Connect(m_channel);
-  PTRACE_IF(1, !ok, "Connect failed: " << sslChannel->GetErrorText());
-  m_channel = sslChannel;
 
-  return ok;
+bool OpalTransportTLS::WaitForHandshake()
+{
+  PWaitAndSignal mutex(m_handshakeMutex);
+
+  bool waited = false;
+  while (m_handshakePending) {
+    m_handshakeMutex.Signal();
+    m_handshakeDone.Wait();
+    m_handshakeMutex.Wait();
+    waited = true;
+  }
+
+  // Only one waiter is woken, pass it on to any others
+  if (waited)
+    m_handshakeDone.Signal();
+
+  return m_channel != NULL && m_channel->IsOpen();
+}
+
+
+PBoolean OpalTransportTLS::Write(const void * buf, PINDEX len)
+{
+  return WaitForHandshake() && OpalTransportTCP::Write(buf, len);
+}
+
+
+PBoolean OpalTransportTLS::ReadPDU(PBYTEArray & pdu)
+{
+  return WaitForHandshake() && OpalTransportTCP::ReadPDU(pdu);
+}
+
+
+PBoolean OpalTransportTLS::WritePDU(const PBYTEArray & pdu)
+{
+  return WaitForHandshake() && OpalTransportTCP::WritePDU(pdu);
 }
 
 
@@ -1909,6 +2327,58 @@ const PCaselessString & OpalTransportTLS::GetProtoPrefix() const
 }
 
 
+OpalTransportTLS::HandshakeStatistics::HandshakeStatistics()
+  : m_accepted(0)
+  , m_connected(0)
+  , m_failed(0)
+  , m_timedOut(0)
+  , m_pending(0)
+  , m_totalTime(0)
+  , m_maximumTime(0)
+{
+}
+
+
+OpalTransportTLS::HandshakeStatistics OpalTransportTLS::GetHandshakeStatistics()
+{
+  HandshakeStatistics stats = OpalTLSHandshakePool::Get(true).GetStatistics();
+  HandshakeStatistics client = OpalTLSHandshakePool::Get(false).GetStatistics();
+  stats.m_connected = client.m_connected;
+  stats.m_failed += client.m_failed;
+  stats.m_timedOut += client.m_timedOut;
+  stats.m_pending += client.m_pending;
+  stats.m_totalTime += client.m_totalTime;
+  if (stats.m_maximumTime < client.m_maximumTime)
+    stats.m_maximumTime = client.m_maximumTime;
+  return stats;
+}
+
+
+void OpalTransportTLS::SetMaxHandshakeThreads(unsigned count, bool server)
+{
+  OpalTLSHandshakePool::Get(server).SetMaxWorkers(std::max(count, 1U));
+}
+
+
+void OpalTransportTLS::SetMaxHandshakeThreads(unsigned count)
+{
+  SetMaxHandshakeThreads(count, true);
+  SetMaxHandshakeThreads(count, false);
+}
+
+
+PTimeInterval OpalTransportTLS::GetHandshakeTimeout(bool server)
+{
+  return OpalTLSHandshakePool::Get(server).GetTimeout();
+}
+
+
+void OpalTransportTLS::SetHandshakeTimeout(const PTimeInterval & timeout, bool server)
+{
+  OpalTLSHandshakePool::Get(server).SetTimeout(timeout);
+}
+
+
 bool OpalTransportTLS::IsAuthenticated(const PString & domain) const
 {
   if (PIPSocket::Address(domain).IsValid()) {
@@ -2020,14 +2490,21 @@ OpalListenerWSS::OpalListenerWSS(OpalEndPoint & endpoint, const OpalTransportAdd
 }
 
 
-OpalTransport * OpalListenerWSS::OnAccept(PTCPSocket * socket)
+OpalTransport * OpalListenerWSS::OnHandshake(PTCPSocket * socket)
 {
-  PSSLChannel * ssl = new PSSLChannel(m_sslContext);
+  PSSLContext * context = m_endpoint.UseSSLContext(true);
+  if (context == NULL) {
+    delete socket;
+    return NULL;
+  }
+
+  PSSLChannel * ssl = new PSSLChannel(context);
   if (ssl->Accept(socket) && AcceptWS(*ssl, m_endpoint.GetPrefixName()))
-    return new OpalTransportWSS(m_endpoint, ssl);
+    return new OpalTransportWSS(m_endpoint, ssl, context);
 
   PTRACE(1, "Accept failed: " << ssl->GetErrorText());
   delete ssl; // Will also delete socket
+  m_endpoint.ReleaseSSLContext(context);
   return NULL;
 }
 
@@ -2107,8 +2584,8 @@ OpalTransportWSS::OpalTransportWSS(OpalEndPoint & endpoint, PIPSocket::Address b
 }
 
 
-OpalTransportWSS::OpalTransportWSS(OpalEndPoint & endpoint, PChannel * socket)
-: OpalTransportTLS(endpoint, new PWebSocket)
+OpalTransportWSS::OpalTransportWSS(OpalEndPoint & endpoint, PChannel * socket, PSSLContext * context)
+: OpalTransportTLS(endpoint, new PWebSocket, context)
 {
   dynamic_cast<PWebSocket *>(m_channel)->Open(socket);
 }
@@ -2125,7 +2602,8 @@ PBoolean OpalTransportWSS::Connect()
 {
   PSafeLockReadWrite mutex(*this);
 
-  if (!OpalTransportTLS::Connect())
+  // The web socket upgrade is sent over TLS, so this one has to wait for it
+  if (!OpalTransportTLS::Connect() || !WaitForHandshake())
     return false;
 
   PWebSocket * webSocket = new PWebSocket();
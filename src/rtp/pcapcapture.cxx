@@ -0,0 +1,395 @@
+/*
+ * pcapcapture.cxx
+ *
+ * Capture of media transport packets to rotating PCAP files
+ *
+ * Open Phone Abstraction Library (OPAL)
+ *
+ * Copyright (C) 2017 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida
+ *
+ * All Rights Reserved.
+ *
+ * Contributor(s): ______________________________________.
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "pcapcapture.h"
+#endif
+
+#include <rtp/pcapcapture.h>
+#include <opal/connection.h>
+#include <opal/call.h>
+
+
+#define new PNEW
+#define PTraceModule() "PCAPCapture"
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+OpalPCAPCapture::Ring::Ring(unsigned size, PINDEX snapLength)
+  : m_snapLength(snapLength)
+  , m_enqueuePosition(0)
+  , m_dequeuePosition(0)
+  , m_dropped(0)
+{
+  size_t count = 16;
+  while (count < size)
+    count <<= 1;
+  m_mask = count - 1;
+
+  m_sequences = new atomic<size_t>[count];
+  for (size_t i = 0; i < count; ++i)
+    m_sequences[i] = i;
+  m_slots = new Slot[count];
+  m_data = new BYTE[count*snapLength];
+}
+
+
+OpalPCAPCapture::Ring::~Ring()
+{
+  delete [] m_sequences;
+  delete [] m_slots;
+  delete [] m_data;
+}
+
+
+static BYTE CopyAddress(BYTE * dst, const PIPSocket::Address & ip)
+{
+  PINDEX size = std::min(ip.GetSize(), (PINDEX)16);
+  for (PINDEX i = 0; i < size; ++i)
+    dst[i] = ip[i];
+  return (BYTE)size;
+}
+
+
+bool OpalPCAPCapture::Ring::Push(const PIPSocketAddressAndPort & src,
+                                 const PIPSocketAddressAndPort & dst,
+                                 const void * data,
+                                 PINDEX length)
+{
+  // Claim a slot, see D. Vyukov's bounded MPMC queue
+  size_t position = m_enqueuePosition;
+  for (;;) {
+    size_t sequence = m_sequences[position & m_mask];
+    intptr_t diff = (intptr_t)sequence - (intptr_t)position;
+    if (diff == 0) {
+      if (m_enqueuePosition.compare_exchange_strong(position, position + 1))
+        break;
+    }
+    else if (diff < 0) {
+      ++m_dropped;
+      return false;
+    }
+    else
+      position = m_enqueuePosition;
+  }
+
+  size_t index = position & m_mask;
+  Slot & slot = m_slots[index];
+  slot.m_time = PTime().GetTimestamp();
+  slot.m_srcAddressSize = CopyAddress(slot.m_srcAddress, src.GetAddress());
+  slot.m_dstAddressSize = CopyAddress(slot.m_dstAddress, dst.GetAddress());
+  slot.m_srcPort = src.GetPort();
+  slot.m_dstPort = dst.GetPort();
+  slot.m_length = (WORD)std::min(length, (PINDEX)65535);
+  slot.m_captured = (WORD)std::min(length, m_snapLength);
+  memcpy(m_data + index*m_snapLength, data, slot.m_captured);
+
+  // Publish to the writer
+  m_sequences[index] = position + 1;
+  return true;
+}
+
+
+const OpalPCAPCapture::Slot * OpalPCAPCapture::Ring::Front(const BYTE * & data)
+{
+  size_t index = m_dequeuePosition & m_mask;
+  if (m_sequences[index] != m_dequeuePosition + 1)
+    return NULL;
+
+  data = m_data + index*m_snapLength;
+  return &m_slots[index];
+}
+
+
+void OpalPCAPCapture::Ring::Pop()
+{
+  m_sequences[m_dequeuePosition & m_mask] = m_dequeuePosition + m_mask + 1;
+  ++m_dequeuePosition;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+
+OpalPCAPCapture::OpalPCAPCapture()
+  : m_running(false)
+  , m_rings(NULL)
+  , m_writerThread(NULL)
+  , m_fileSequence(0)
+  , m_fileSize(0)
+  , m_written(0)
+  , m_filesCreated(0)
+{
+}
+
+
+OpalPCAPCapture::~OpalPCAPCapture()
+{
+  Stop();
+
+  m_retiredRings.push_back(m_rings);
+  for (std::list<Rings *>::iterator it = m_retiredRings.begin(); it != m_retiredRings.end(); ++it) {
+    if (*it != NULL) {
+      for (size_t i = 0; i < (*it)->size(); ++i)
+        delete (**it)[i];
+      delete *it;
+    }
+  }
+}
+
+
+bool OpalPCAPCapture::Start(const Params & params)
+{
+  if (m_running) {
+    PTRACE(2, "Already running");
+    return false;
+  }
+
+  if (!params.m_directory.Exists() && !params.m_directory.Create()) {
+    PTRACE(1, "Could not create directory " << params.m_directory);
+    return false;
+  }
+
+  m_params = params;
+  if (m_params.m_maxFiles == 0)
+    m_params.m_maxFiles = 1;
+
+  PINDEX snapLength = m_params.m_snapLength > 0 && m_params.m_snapLength < 65535 ? m_params.m_snapLength : 65535;
+  unsigned ringCount = std::max(m_params.m_rings, 1U);
+  size_t ringMask = 16; // As Ring constructor rounds up
+  while (ringMask < m_params.m_ringSize)
+    ringMask <<= 1;
+  --ringMask;
+
+  /* Rings are never deleted while the capture object exists, so a transport
+     that was already past its running check when we stopped cannot crash.
+     Replaced ones are retired, and only if the sizes have changed. */
+  Rings * rings = m_rings;
+  if (rings == NULL || rings->size() != ringCount || (*rings)[0]->m_mask != ringMask || (*rings)[0]->m_snapLength != snapLength) {
+    if (rings != NULL)
+      m_retiredRings.push_back(rings);
+    rings = new Rings;
+    for (unsigned i = 0; i < ringCount; ++i)
+      rings->push_back(new Ring(m_params.m_ringSize, snapLength));
+    m_rings = rings;
+  }
+
+  if (!Rotate())
+    return false;
+
+  m_running = true;
+  m_writerThread = new PThreadObj<OpalPCAPCapture>(*this, &OpalPCAPCapture::WriterMain, false, "PCAP-Capture");
+
+  PTRACE(3, "Started capture to " << m_params.m_directory << m_params.m_prefix << "*.pcap,"
+            " " << rings->size() << " rings of " << ((*rings)[0]->m_mask+1) << " packets,"
+            " snap length " << (*rings)[0]->m_snapLength);
+  return true;
+}
+
+
+void OpalPCAPCapture::Stop()
+{
+  if (!m_running.exchange(false))
+    return;
+
+  m_wakeWriter.Signal();
+  PThread::WaitAndDelete(m_writerThread);
+
+  m_file.Close();
+
+  PTRACE(3, "Stopped capture: written=" << m_written << ", files=" << m_filesCreated);
+}
+
+
+void OpalPCAPCapture::AddTrigger(const PString & pattern)
+{
+  PWaitAndSignal lock(m_triggerMutex);
+  m_triggers += pattern;
+}
+
+
+void OpalPCAPCapture::RemoveTrigger(const PString & pattern)
+{
+  PWaitAndSignal lock(m_triggerMutex);
+  m_triggers -= pattern;
+}
+
+
+void OpalPCAPCapture::ClearTriggers()
+{
+  PWaitAndSignal lock(m_triggerMutex);
+  m_triggers.RemoveAll();
+}
+
+
+PStringSet OpalPCAPCapture::GetTriggers() const
+{
+  PWaitAndSignal lock(m_triggerMutex);
+  PStringSet triggers = m_triggers;
+  triggers.MakeUnique();
+  return triggers;
+}
+
+
+bool OpalPCAPCapture::IsTriggered(const OpalConnection & connection) const
+{
+  if (!m_running)
+    return false;
+
+  // Caseless, so Find() below ignores case whatever the trigger is
+  const PCaselessString names[] = {
+    connection.GetCall().GetToken(),
+    connection.GetRemotePartyURL(),
+    connection.GetLocalPartyURL()
+  };
+
+  PWaitAndSignal lock(m_triggerMutex);
+  for (PStringSet::const_iterator it = m_triggers.begin(); it != m_triggers.end(); ++it) {
+    if (*it == "*")
+      return true;
+    for (size_t i = 0; i < PARRAYSIZE(names); ++i) {
+      if (names[i].Find(*it) != P_MAX_INDEX) {
+        PTRACE(4, "Capturing " << connection << ", matched \"" << *it << '"');
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+
+void OpalPCAPCapture::Capture(unsigned hint,
+                              const PIPSocketAddressAndPort & src,
+                              const PIPSocketAddressAndPort & dst,
+                              const void * data,
+                              PINDEX length)
+{
+  if (m_running && length > 0) {
+    Rings & rings = *m_rings;
+    rings[hint % rings.size()]->Push(src, dst, data, length);
+  }
+}
+
+
+OpalPCAPCapture::Statistics OpalPCAPCapture::GetStatistics() const
+{
+  Statistics stats;
+  const Rings * rings = m_rings;
+  if (rings != NULL) {
+    for (size_t i = 0; i < rings->size(); ++i) {
+      PUInt64 dropped = (*rings)[i]->m_dropped;
+      stats.m_captured += (*rings)[i]->m_enqueuePosition;
+      stats.m_dropped += dropped;
+    }
+  }
+  stats.m_written = m_written;
+  stats.m_files = m_filesCreated;
+  return stats;
+}
+
+
+void OpalPCAPCapture::WriterMain()
+{
+  PTRACE(4, "Writer started");
+
+  while (m_running) {
+    m_wakeWriter.Wait(m_params.m_flushInterval);
+    Drain();
+  }
+
+  // Anything captured while we were stopping
+  Drain();
+
+  PTRACE(4, "Writer ended");
+}
+
+
+void OpalPCAPCapture::Drain()
+{
+  Rings & rings = *m_rings;
+  for (size_t i = 0; i < rings.size(); ++i) {
+    Ring & ring = *rings[i];
+    const BYTE * data;
+    const Slot * slot;
+    while ((slot = ring.Front(data)) != NULL) {
+      if (m_fileSize >= m_params.m_maxFileSize)
+        Rotate();
+
+      if (m_file.IsOpen()) {
+        PTime when((time_t)(slot->m_time/1000000), (long)(slot->m_time%1000000));
+        PIPSocketAddressAndPort src(PIPSocket::Address(slot->m_srcAddressSize, slot->m_srcAddress), slot->m_srcPort);
+        PIPSocketAddressAndPort dst(PIPSocket::Address(slot->m_dstAddressSize, slot->m_dstAddress), slot->m_dstPort);
+        m_fileSize += m_file.WriteUDP(when, src, dst, data, slot->m_captured, slot->m_length);
+        ++m_written;
+      }
+
+      ring.Pop();
+    }
+  }
+
+  m_file.FlushBuffer();
+
+  if (m_params.m_maxFileTime > 0 && (PTime() - m_fileOpened) >= m_params.m_maxFileTime)
+    Rotate();
+}
+
+
+bool OpalPCAPCapture::Rotate()
+{
+  m_file.Close();
+
+  m_fileOpened.SetCurrentTime();
+  PFilePath path = m_params.m_directory + m_params.m_prefix
+                 + m_fileOpened.AsString("-yyyyMMdd-hhmmss-")
+                 + PString(PString::Unsigned, ++m_fileSequence) + ".pcap";
+  if (!m_file.Open(path, PFile::WriteOnly)) {
+    PTRACE(1, "Could not create capture file " << path << ": " << m_file.GetErrorText());
+    return false;
+  }
+
+  m_fileSize = m_file.GetLength();
+  ++m_filesCreated;
+  m_files.AppendString(path);
+
+  // Keep the disk usage bounded
+  while ((unsigned)m_files.GetSize() > m_params.m_maxFiles) {
+    PTRACE(4, "Removing old capture file " << m_files.front());
+    PFile::Remove(m_files.front());
+    m_files.RemoveHead();
+  }
+
+  PTRACE(4, "Capturing to " << path);
+  return true;
+}
+
+
+// End Of File ///////////////////////////////////////////////////////////////
@@ -36,10 +36,38 @@
 #include <rtp/pcapfile.h>
 #include <codec/vidcodec.h>
 
+#include <algorithm>
+
+#if _WIN32
+  #include <io.h>
+#else
+  #include <sys/mman.h>
+  #include <unistd.h>
+#endif
+
 
 #define PTraceModule() "PCAPFile"
 
 
+static const off_t MinimumChunkSize = 16*1024*1024; // Not worth a thread for less
+static const unsigned RecordChainLength = 8;        // Consecutive headers to trust a resync
+static const off_t MaximumResyncSearch = 1024*1024;
+static const DWORD MaximumRecordSize = 262144;
+
+
+static unsigned GetProcessorCount()
+{
+#if _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors;
+#else
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (unsigned)count : 1;
+#endif
+}
+
+
 void Reverse(char * ptr, size_t sz)
 {
   char * top = ptr+sz-1;
@@ -58,7 +86,13 @@ void Reverse(char * ptr, size_t sz)
 ///////////////////////////////////////////////////////////////////////////////
 
 OpalPCAPFile::OpalPCAPFile()
-  : m_filterSSRC(0)
+  : m_mapBase(NULL)
+  , m_mapSize(0)
+  , m_mapPosition(0)
+  , m_writeBufferUsed(0)
+  , m_filterSSRC(0)
+  , m_activeIndex(NULL)
+  , m_activePosition(0)
 {
   OpalMediaFormatList list = OpalMediaFormat::GetAllRegisteredMediaFormats();
   for (OpalMediaFormatList::iterator it = list.begin(); it != list.end(); ++it) {
@@ -72,12 +106,22 @@ OpalPCAPFile::OpalPCAPFile()
 }
 
 
+OpalPCAPFile::~OpalPCAPFile()
+{
+  Unmap();
+}
+
+
 bool OpalPCAPFile::InternalOpen(OpenMode mode, OpenOptions opts, PFileInfo::Permissions permissions)
 {
   PAssert(mode != PFile::ReadWrite, PInvalidParameter);
 
   PWaitAndSignal mutex(m_writeMutex);
 
+  Unmap();
+  m_streamIndex.clear();
+  m_activeIndex = NULL;
+
   if (!PFile::InternalOpen(mode, opts, permissions))
     return false;
 
@@ -118,10 +162,115 @@ bool OpalPCAPFile::InternalOpen(OpenMode mode, OpenOptions opts, PFileInfo::Perm
     REVERSE(m_fileHeader.network);
   }
 
+  // Map the whole file, failing that we just read it the old fashioned way
+  off_t length = PFile::GetLength();
+  if (length > 0 && (PUInt64)length <= (size_t)-1) {
+#if _WIN32
+    HANDLE mapping = CreateFileMapping((HANDLE)_get_osfhandle(GetHandle()), NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping != NULL) {
+      m_mapBase = (const BYTE *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mapping);
+    }
+#else
+    void * ptr = mmap(NULL, (size_t)length, PROT_READ, MAP_SHARED, GetHandle(), 0);
+    if (ptr != MAP_FAILED) {
+      madvise(ptr, (size_t)length, MADV_SEQUENTIAL);
+      m_mapBase = (const BYTE *)ptr;
+    }
+#endif
+  }
+
+  if (m_mapBase != NULL) {
+    m_mapSize = length;
+    m_mapPosition = sizeof(m_fileHeader);
+    PTRACE(4, "Memory mapped " << length << " bytes of \"" << GetFilePath() << '"');
+  }
+  else
+    PTRACE(3, "Could not memory map \"" << GetFilePath() << "\", using file reads");
+
+  return true;
+}
+
+
+void OpalPCAPFile::Unmap()
+{
+  if (m_mapBase == NULL)
+    return;
+
+#if _WIN32
+  UnmapViewOfFile(m_mapBase);
+#else
+  munmap((void *)m_mapBase, (size_t)m_mapSize);
+#endif
+
+  m_mapBase = NULL;
+  m_mapSize = m_mapPosition = 0;
+}
+
+
+bool OpalPCAPFile::Close()
+{
+  FlushBuffer();
+  Unmap();
+  m_streamIndex.clear();
+  m_activeIndex = NULL;
+  return PFile::Close();
+}
+
+
+off_t OpalPCAPFile::GetPosition() const
+{
+  return m_mapBase != NULL ? m_mapPosition : PFile::GetPosition();
+}
+
+
+bool OpalPCAPFile::SetPosition(off_t pos, FilePositionOrigin origin)
+{
+  if (m_mapBase == NULL) {
+    if (!PFile::SetPosition(pos, origin))
+      return false;
+    pos = PFile::GetPosition();
+  }
+  else {
+    switch (origin) {
+      case Current :
+        pos += m_mapPosition;
+        break;
+      case End :
+        pos += m_mapSize;
+        break;
+      default :
+        break;
+    }
+    if (pos < 0 || pos > m_mapSize)
+      return false;
+    m_mapPosition = pos;
+  }
+
+  if (m_activeIndex != NULL) {
+    size_t lo = 0, hi = m_activeIndex->size();
+    while (lo < hi) {
+      size_t mid = (lo + hi)/2;
+      if ((*m_activeIndex)[mid].m_position < (PUInt64)pos)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    m_activePosition = lo;
+  }
+
   return true;
 }
 
 
+bool OpalPCAPFile::IsEndOfFile() const
+{
+  if (m_activeIndex != NULL)
+    return m_activePosition >= m_activeIndex->size();
+  return m_mapBase != NULL ? m_mapPosition >= m_mapSize : PFile::IsEndOfFile();
+}
+
+
 bool OpalPCAPFile::Restart()
 {
   if (SetPosition(sizeof(m_fileHeader)))
@@ -132,6 +281,25 @@ bool OpalPCAPFile::Restart()
 }
 
 
+bool OpalPCAPFile::ReadPacket()
+{
+  if (m_activeIndex != NULL) {
+    if (m_activePosition >= m_activeIndex->size())
+      return false;
+    off_t position = (off_t)(*m_activeIndex)[m_activePosition++].m_position;
+    if (m_mapBase != NULL)
+      m_mapPosition = position;
+    else if (!PFile::SetPosition(position))
+      return false;
+  }
+
+  if (m_mapBase != NULL)
+    return m_rawPacket.Read(m_mapBase, m_mapSize, m_mapPosition);
+
+  return m_rawPacket.Read(*this);
+}
+
+
 void OpalPCAPFile::PrintOn(ostream & strm) const
 {
   strm << "PCAP v" << m_fileHeader.version_major << '.' << m_fileHeader.version_minor
@@ -146,7 +314,66 @@ bool OpalPCAPFile::WriteFrame(const PEthSocket::Frame & frame)
   header.ts_usec = frame.GetTimestamp().GetMicrosecond();
   header.incl_len = header.orig_len = frame.GetSize();
   PWaitAndSignal mutex(m_writeMutex);
-  return Write(&header, sizeof(header)) && frame.Write(*this);
+  return InternalFlushBuffer() && Write(&header, sizeof(header)) && frame.Write(*this);
+}
+
+
+PINDEX OpalPCAPFile::WriteUDP(const PTime & when,
+                              const PIPSocketAddressAndPort & src,
+                              const PIPSocketAddressAndPort & dst,
+                              const void * data,
+                              PINDEX captured,
+                              PINDEX length)
+{
+  PWaitAndSignal mutex(m_writeMutex);
+
+  BYTE * payload = (BYTE *)m_writeFrame.CreateUDP(src, dst, length);
+  if (payload == NULL)
+    return 0;
+  memcpy(payload, data, captured);
+
+  // The payload is the tail of the frame, so the headers are what precedes it
+  PINDEX frameSize = m_writeFrame.GetSize();
+  const BYTE * frame = payload + length - frameSize;
+
+  RecordHeader header;
+  header.ts_sec = (uint32_t)when.GetTimeInSeconds();
+  header.ts_usec = when.GetMicrosecond();
+  header.incl_len = frameSize - (length - captured);
+  header.orig_len = frameSize;
+
+  PINDEX recordSize = sizeof(header) + header.incl_len;
+  BYTE * ptr = m_writeBuffer.GetPointer(m_writeBufferUsed + recordSize) + m_writeBufferUsed;
+  memcpy(ptr, &header, sizeof(header));
+  memcpy(ptr + sizeof(header), frame, header.incl_len);
+  m_writeBufferUsed += recordSize;
+
+  if (m_writeBufferUsed >= 65536 && !InternalFlushBuffer())
+    return 0;
+
+  return recordSize;
+}
+
+
+bool OpalPCAPFile::FlushBuffer()
+{
+  PWaitAndSignal mutex(m_writeMutex);
+  return InternalFlushBuffer();
+}
+
+
+bool OpalPCAPFile::InternalFlushBuffer()
+{
+  if (m_writeBufferUsed == 0)
+    return true;
+
+  PINDEX size = m_writeBufferUsed;
+  m_writeBufferUsed = 0;
+  if (Write(m_writeBuffer, size))
+    return true;
+
+  PTRACE(1, "Could not write " << size << " bytes to \"" << GetFilePath() << '"');
+  return false;
 }
 
 
@@ -190,15 +417,50 @@ bool OpalPCAPFile::Frame::Read(PChannel & channel, PINDEX)
 }
 
 
+bool OpalPCAPFile::Frame::Read(const BYTE * base, off_t size, off_t & position)
+{
+  PreRead();
+
+  if (position >= size)
+    return false;
+
+  RecordHeader recordHeader;
+  if (size - position < (off_t)sizeof(recordHeader)) {
+    PTRACE(1, "Truncated record header at " << position);
+    return false;
+  }
+  memcpy(&recordHeader, base + position, sizeof(recordHeader));
+
+  if (m_otherEndian) {
+    REVERSE(recordHeader.ts_sec);
+    REVERSE(recordHeader.ts_usec);
+    REVERSE(recordHeader.incl_len);
+    REVERSE(recordHeader.orig_len);
+  }
+
+  off_t dataPosition = position + sizeof(recordHeader);
+  if (size - dataPosition < (off_t)recordHeader.incl_len) {
+    PTRACE(1, "Truncated record data at " << position);
+    return false;
+  }
+
+  m_timestamp.SetTimestamp(recordHeader.ts_sec, recordHeader.ts_usec);
+  memcpy(m_rawData.GetPointer(recordHeader.incl_len), base + dataPosition, recordHeader.incl_len);
+  m_rawSize = recordHeader.incl_len;
+  position = dataPosition + recordHeader.incl_len;
+  return true;
+}
+
+
 int OpalPCAPFile::GetDataLink(PBYTEArray & payload)
 {
-  return m_rawPacket.Read(*this) ? m_rawPacket.GetDataLink(payload) : -1;
+  return ReadPacket() ? m_rawPacket.GetDataLink(payload) : -1;
 }
 
 
 int OpalPCAPFile::GetIP(PBYTEArray & payload)
 {
-  if (!m_rawPacket.Read(*this))
+  if (!ReadPacket())
     return -1;
 
   PIPSocket::Address src, dst;
@@ -216,7 +478,7 @@ int OpalPCAPFile::GetIP(PBYTEArray & payload)
 
 int OpalPCAPFile::GetTCP(PBYTEArray & payload)
 {
-  return m_rawPacket.Read(*this) &&
+  return ReadPacket() &&
          m_rawPacket.GetTCP(payload, m_packetSrc, m_packetDst) &&
          m_packetSrc.MatchWildcard(m_filterSrc) &&
          m_packetDst.MatchWildcard(m_filterDst)
@@ -226,7 +488,7 @@ int OpalPCAPFile::GetTCP(PBYTEArray & payload)
 
 int OpalPCAPFile::GetUDP(PBYTEArray & payload)
 {
-  return m_rawPacket.Read(*this) &&
+  return ReadPacket() &&
          m_rawPacket.GetUDP(payload, m_packetSrc, m_packetDst) &&
          m_packetSrc.MatchWildcard(m_filterSrc) &&
          m_packetDst.MatchWildcard(m_filterDst)
@@ -236,11 +498,23 @@ int OpalPCAPFile::GetUDP(PBYTEArray & payload)
 
 int OpalPCAPFile::GetRTP(RTP_DataFrame & rtp)
 {
-  int packetLength = GetUDP(rtp);
-  if (packetLength < 0)
+  return ReadPacket() ? ExtractRTP(m_rawPacket, rtp, m_packetSrc, m_packetDst, true) : -1;
+}
+
+
+int OpalPCAPFile::ExtractRTP(PEthSocket::Frame & frame,
+                             RTP_DataFrame & rtp,
+                             PIPSocketAddressAndPort & src,
+                             PIPSocketAddressAndPort & dst,
+                             bool filter) const
+{
+  if (!frame.GetUDP(rtp, src, dst))
     return -1;
 
-  if (!rtp.SetPacketSize(packetLength))
+  if (filter && !(src.MatchWildcard(m_filterSrc) && dst.MatchWildcard(m_filterDst)))
+    return -1;
+
+  if (!rtp.SetPacketSize(rtp.GetSize()))
     return -1;
 
   if (rtp.GetVersion() != 2)
@@ -251,7 +525,7 @@ int OpalPCAPFile::GetRTP(RTP_DataFrame & rtp)
     return -1;
 
   RTP_SyncSourceId ssrc = rtp.GetSyncSource();
-  if (ssrc == 0 || (m_filterSSRC != 0 && m_filterSSRC != ssrc))
+  if (ssrc == 0 || (filter && m_filterSSRC != 0 && m_filterSSRC != ssrc))
     return -1;
 
   if (rtp.GetContribSrcCount() > 4) // While possible, extremely unlikely in modern usage
@@ -263,10 +537,23 @@ int OpalPCAPFile::GetRTP(RTP_DataFrame & rtp)
 
 int OpalPCAPFile::GetDecodedRTP(RTP_DataFrame & decodedRTP, DecodeContext & context)
 {
-  off_t thisPacketsFilePosition  = GetPosition();
+  return InternalGetDecodedRTP(NULL, decodedRTP, context);
+}
+
+
+int OpalPCAPFile::GetDecodedRTP(StreamCursor & cursor, RTP_DataFrame & decodedRTP, DecodeContext & context)
+{
+  return InternalGetDecodedRTP(&cursor, decodedRTP, context);
+}
+
+
+int OpalPCAPFile::InternalGetDecodedRTP(StreamCursor * cursor, RTP_DataFrame & decodedRTP, DecodeContext & context)
+{
+  // With a cursor the "position" is the packet number in the stream index
+  off_t thisPacketsFilePosition = cursor != NULL ? (off_t)cursor->m_position : GetPosition();
 
   RTP_DataFrame encodedRTP;
-  if (GetRTP(encodedRTP) < 0)
+  if ((cursor != NULL ? GetRTP(*cursor, encodedRTP) : GetRTP(encodedRTP)) < 0)
     return 0;
 
   if (context.m_transcoder == NULL) {
@@ -298,7 +585,8 @@ int OpalPCAPFile::GetDecodedRTP(RTP_DataFrame & decodedRTP, DecodeContext & cont
       bool missing = true;
       // Scan ahead 100 packets looking for out of order one
       for (PINDEX i = 0; i < 100; ++i) {
-        if (GetRTP(encodedRTP) >= 0 && encodedRTP.GetSequenceNumber() == expectedSequenceNumber) {
+        if ((cursor != NULL ? GetRTP(*cursor, encodedRTP) : GetRTP(encodedRTP)) >= 0 &&
+                                            encodedRTP.GetSequenceNumber() == expectedSequenceNumber) {
           PTRACE(3, "Restoring out of order packet at " << expectedSequenceNumber);
           thisSequenceNumber = expectedSequenceNumber;
           missing = false;
@@ -309,10 +597,16 @@ int OpalPCAPFile::GetDecodedRTP(RTP_DataFrame & decodedRTP, DecodeContext & cont
       /* If found move back to position so is read next time, then the one we
          are using now is skipped as out of order. If not found we read it
          again immediately. */
-      SetPosition(thisPacketsFilePosition);
+      if (cursor != NULL)
+        cursor->m_position = (size_t)thisPacketsFilePosition;
+      else
+        SetPosition(thisPacketsFilePosition);
 
       if (missing) {
-        GetRTP(encodedRTP);
+        if (cursor != NULL)
+          GetRTP(*cursor, encodedRTP);
+        else
+          GetRTP(encodedRTP);
         encodedRTP.SetDiscontinuity(sequenceDelta);
         PTRACE(3, "Detected " << sequenceDelta << " missing RTP packets:"
                " expected=" << expectedSequenceNumber << ", got=" << thisSequenceNumber);
@@ -390,6 +684,8 @@ void OpalPCAPFile::DiscoveredRTPInfo::PrintOn(ostream & strm) const
 struct OpalPCAPFile::DiscoveryInfo
 {
   unsigned           m_totalPackets;
+  RTP_SequenceNumber m_firstSequenceNumber;
+  RTP_Timestamp      m_firstTimestamp;
   RTP_SequenceNumber m_expectedSequenceNumber;
   unsigned           m_matchedSequenceNumber;
   RTP_Timestamp      m_lastTimestamp;
@@ -401,6 +697,8 @@ struct OpalPCAPFile::DiscoveryInfo
 
   DiscoveryInfo(const RTP_DataFrame & rtp)
     : m_totalPackets(1)
+    , m_firstSequenceNumber(rtp.GetSequenceNumber())
+    , m_firstTimestamp(rtp.GetTimestamp())
     , m_expectedSequenceNumber(rtp.GetSequenceNumber()+1)
     , m_matchedSequenceNumber(0)
     , m_lastTimestamp(rtp.GetTimestamp())
@@ -428,6 +726,29 @@ struct OpalPCAPFile::DiscoveryInfo
     AddPacket(rtp);
   }
 
+  // Append the results from the following chunk of the file, as if scanned in one pass
+  void Merge(const DiscoveryInfo & other)
+  {
+    m_totalPackets += other.m_totalPackets;
+
+    for (map<RTP_DataFrame::PayloadTypes, unsigned>::const_iterator it = other.m_payloadTypes.begin(); it != other.m_payloadTypes.end(); ++it)
+      m_payloadTypes[it->first] += it->second;
+
+    m_matchedSequenceNumber += other.m_matchedSequenceNumber;
+    if (m_expectedSequenceNumber == other.m_firstSequenceNumber)
+      ++m_matchedSequenceNumber;
+    m_expectedSequenceNumber = other.m_expectedSequenceNumber;
+
+    // Other counted its first packet as monotonic, which it may not be
+    m_matchedTimestamps += other.m_matchedTimestamps - 1;
+    if (other.m_firstTimestamp >= m_lastTimestamp)
+      ++m_matchedTimestamps;
+    m_lastTimestamp = other.m_lastTimestamp;
+
+    for (RTP_DataFrameList::const_iterator it = other.m_firstFrames.begin(); it != other.m_firstFrames.end(); ++it)
+      AddPacket(*it);
+  }
+
   void AddPacket(const RTP_DataFrame & rtp)
   {
     if (m_firstFrames.size() > 100)
@@ -517,54 +838,283 @@ struct OpalPCAPFile::DiscoveryInfo
 };
 
 
-bool OpalPCAPFile::DiscoverRTP(DiscoveredRTP & discoveredRTP, const ProgressNotifier & progressNotifier)
+struct OpalPCAPFile::DiscoveryChunk : PObject
 {
-  if (!Restart())
-    return false;
+  DiscoveryChunk(off_t start, off_t end)
+    : m_start(start)
+    , m_end(end)
+    , m_position(start)
+    , m_finish(start)
+    , m_packets(0)
+    , m_abort(false)
+  { }
+
+  off_t             m_start;      // Records starting in [m_start, m_end) belong to this chunk
+  off_t             m_end;
+  volatile off_t    m_position;
+  off_t             m_finish;     // End of the last record read, the next chunk must start here
+  volatile unsigned m_packets;
+  volatile bool     m_abort;
+  DiscoveryMap      m_discovered;
+  StreamIndexMap    m_index;
+};
 
-  PTRACE(3, "Starting RTP discovery");
 
-  map<DiscoveredRTPKey, DiscoveryInfo> discoveryMap;
+bool OpalPCAPFile::IsRecordChain(off_t position) const
+{
+  DWORD snaplen = m_fileHeader.snaplen != 0 ? m_fileHeader.snaplen : MaximumRecordSize;
+  DWORD lastSeconds = 0;
 
-  Progress progress(GetLength());
-  while (!IsEndOfFile()) {
-    ++progress.m_packets;
-    progress.m_filePosition = GetPosition();
+  for (unsigned count = 0; count < RecordChainLength; ++count) {
+    if (position == m_mapSize)
+      return count > 0; // Exactly hit the end, good enough
+    if (m_mapSize - position < (off_t)sizeof(RecordHeader))
+      return false;
 
-    if (!progressNotifier.IsNULL())
-      progressNotifier(*this, progress);
-    if (progress.m_abort)
+    RecordHeader header;
+    memcpy(&header, m_mapBase + position, sizeof(header));
+    if (m_rawPacket.m_otherEndian) {
+      REVERSE(header.ts_sec);
+      REVERSE(header.ts_usec);
+      REVERSE(header.incl_len);
+      REVERSE(header.orig_len);
+    }
+
+    if (header.ts_usec >= 1000000 ||
+        header.incl_len == 0 ||
+        header.incl_len > snaplen ||
+        header.incl_len > header.orig_len ||
+        header.orig_len > MaximumRecordSize)
+      return false;
+
+    // Captures are in time order, give or take, so consecutive records are close together
+    if (count > 0 && (header.ts_sec + 1 < lastSeconds || header.ts_sec > lastSeconds + 3600))
       return false;
+    lastSeconds = header.ts_sec;
+
+    position += sizeof(header) + header.incl_len;
+    if (position > m_mapSize)
+      return false;
+  }
 
-    RTP_DataFrame rtp;
-    if (GetRTP(rtp) < 0)
+  return true;
+}
+
+
+void OpalPCAPFile::DiscoverChunk(DiscoveryChunk * chunk)
+{
+  PTRACE(4, "Discovering RTP from " << chunk->m_start << " to " << chunk->m_end);
+
+  Frame frame;
+  frame.m_otherEndian = m_rawPacket.m_otherEndian;
+  RTP_DataFrame rtp;
+  PIPSocketAddressAndPort src, dst;
+
+  off_t position = chunk->m_start;
+  while (position < chunk->m_end && !chunk->m_abort) {
+    off_t recordPosition = position;
+    if (!frame.Read(m_mapBase, m_mapSize, position))
+      break;
+
+    chunk->m_position = position;
+    ++chunk->m_packets;
+
+    if (ExtractRTP(frame, rtp, src, dst, true) < 0)
       continue;
 
     DiscoveredRTPKey key;
-    key.m_src = m_packetSrc;
-    key.m_dst = m_packetDst;
+    key.m_src = src;
+    key.m_dst = dst;
     key.m_ssrc = rtp.GetSyncSource();
 
-    map<DiscoveredRTPKey, DiscoveryInfo>::iterator it;
-    if ((it = discoveryMap.find(key)) != discoveryMap.end())
+    DiscoveryMap::iterator it;
+    if ((it = chunk->m_discovered.find(key)) != chunk->m_discovered.end())
       it->second.ProcessPacket(rtp);
-    else {
-      discoveryMap.insert(make_pair(key, rtp));
-      PTRACE(4, "Adding RTP discovery possibility: " << key);
+    else
+      chunk->m_discovered.insert(make_pair(key, rtp));
+
+    PacketIndexEntry entry;
+    entry.m_position = recordPosition;
+    entry.m_time = frame.GetTimestamp().GetTimestamp();
+    chunk->m_index[key].push_back(entry);
+  }
+
+  chunk->m_finish = position;
+  chunk->m_position = chunk->m_end;
+}
+
+
+bool OpalPCAPFile::DiscoverRTP(DiscoveredRTP & discoveredRTP, const ProgressNotifier & progressNotifier, unsigned threads)
+{
+  m_activeIndex = NULL;
+  m_streamIndex.clear();
+
+  if (!Restart())
+    return false;
+
+  PTRACE(3, "Starting RTP discovery");
+  PTimeInterval startTick = PTimer::Tick();
+
+  Progress progress(GetLength());
+  PList<DiscoveryChunk> chunks;
+
+  if (m_mapBase != NULL) {
+    if (threads == 0)
+      threads = GetProcessorCount();
+    off_t dataSize = m_mapSize - sizeof(m_fileHeader);
+    if ((off_t)threads > dataSize/MinimumChunkSize)
+      threads = (unsigned)(dataSize/MinimumChunkSize);
+    if (threads == 0)
+      threads = 1;
+
+    /* Records have no sync marker, so each chunk starts at the first position
+       after its nominal start where a chain of plausible record headers
+       begins. Chunks where no such point is found are absorbed by the
+       previous chunk. */
+    std::vector<off_t> starts(1, (off_t)sizeof(m_fileHeader));
+    for (unsigned i = 1; i < threads; ++i) {
+      off_t position = sizeof(m_fileHeader) + dataSize*i/threads;
+      off_t limit = std::min(position + MaximumResyncSearch, m_mapSize);
+      while (position < limit && !IsRecordChain(position))
+        ++position;
+      if (position < limit && position > starts.back())
+        starts.push_back(position);
+      else
+        PTRACE(3, "Could not find record boundary for chunk " << i);
+    }
+    starts.push_back(m_mapSize);
+
+    for (size_t i = 0; i+1 < starts.size(); ++i)
+      chunks.Append(new DiscoveryChunk(starts[i], starts[i+1]));
+
+    PList<PThread> workers;
+    for (PINDEX i = 0; i < chunks.GetSize(); ++i)
+      workers.Append(new PThreadObj1Arg<OpalPCAPFile, DiscoveryChunk *>(*this, &chunks[i], &OpalPCAPFile::DiscoverChunk,
+                                                                       false, "PCAP-Discover"));
+
+    for (;;) {
+      progress.m_filePosition = sizeof(m_fileHeader);
+      progress.m_packets = 0;
+      for (PINDEX i = 0; i < chunks.GetSize(); ++i) {
+        progress.m_filePosition += chunks[i].m_position - chunks[i].m_start;
+        progress.m_packets += chunks[i].m_packets;
+      }
+
+      if (!progressNotifier.IsNULL())
+        progressNotifier(*this, progress);
+
+      if (progress.m_abort) {
+        for (PINDEX i = 0; i < chunks.GetSize(); ++i)
+          chunks[i].m_abort = true;
+      }
+
+      PINDEX i = 0;
+      while (i < workers.GetSize() && workers[i].WaitForTermination(progressNotifier.IsNULL() ? PMaxTimeInterval : 100))
+        ++i;
+      if (i >= workers.GetSize())
+        break;
+    }
+
+    if (progress.m_abort)
+      return false;
+
+    /* A chunk start found by IsRecordChain() may still be a false boundary.
+       Chunk 0 starts at a real one, so each chunk that ends exactly where
+       the next starts proves the next one right. At the first that does
+       not, the rest of the file is scanned again in one pass. */
+    for (PINDEX i = 0; i+1 < chunks.GetSize(); ++i) {
+      if (chunks[i].m_finish != chunks[i+1].m_start) {
+        PTRACE(2, "Chunk " << i << " ended at " << chunks[i].m_finish << ", not at next chunk start "
+               << chunks[i+1].m_start << ", rescanning rest of file");
+        while (chunks.GetSize() > i+1)
+          chunks.RemoveAt(i+1);
+        DiscoveryChunk * rescan = new DiscoveryChunk(chunks[i].m_finish, m_mapSize);
+        chunks.Append(rescan);
+        DiscoverChunk(rescan);
+        break;
+      }
+    }
+  }
+  else {
+    // Not mapped, a single pass through the file with ordinary reads
+    DiscoveryChunk * chunk = new DiscoveryChunk(sizeof(m_fileHeader), GetLength());
+    chunks.Append(chunk);
+
+    while (!IsEndOfFile()) {
+      ++progress.m_packets;
+      progress.m_filePosition = GetPosition();
+
+      if (!progressNotifier.IsNULL())
+        progressNotifier(*this, progress);
+      if (progress.m_abort)
+        return false;
+
+      RTP_DataFrame rtp;
+      if (GetRTP(rtp) < 0)
+        continue;
+
+      DiscoveredRTPKey key;
+      key.m_src = m_packetSrc;
+      key.m_dst = m_packetDst;
+      key.m_ssrc = rtp.GetSyncSource();
+
+      DiscoveryMap::iterator it;
+      if ((it = chunk->m_discovered.find(key)) != chunk->m_discovered.end())
+        it->second.ProcessPacket(rtp);
+      else {
+        chunk->m_discovered.insert(make_pair(key, rtp));
+        PTRACE(4, "Adding RTP discovery possibility: " << key);
+      }
+
+      PacketIndexEntry entry;
+      entry.m_position = progress.m_filePosition;
+      entry.m_time = GetPacketTime().GetTimestamp();
+      chunk->m_index[key].push_back(entry);
+    }
+  }
+
+  // Stitch the chunks back together in file order
+  DiscoveryMap discoveryMap;
+  for (PINDEX i = 0; i < chunks.GetSize(); ++i) {
+    for (DiscoveryMap::iterator it = chunks[i].m_discovered.begin(); it != chunks[i].m_discovered.end(); ++it) {
+      DiscoveryMap::iterator existing = discoveryMap.find(it->first);
+      if (existing == discoveryMap.end())
+        discoveryMap.insert(*it);
+      else
+        existing->second.Merge(it->second);
+    }
+
+    for (StreamIndexMap::iterator it = chunks[i].m_index.begin(); it != chunks[i].m_index.end(); ++it) {
+      PacketIndex & index = m_streamIndex[it->first];
+      if (index.empty())
+        index.swap(it->second);
+      else
+        index.insert(index.end(), it->second.begin(), it->second.end());
     }
   }
 
+#if !_WIN32
+  /* The sequential advice suits the discovery scan, but reads via the index
+     skip over other streams, and cursors move about the file independently */
+  if (m_mapBase != NULL)
+    madvise((void *)m_mapBase, (size_t)m_mapSize, MADV_NORMAL);
+#endif
+
   PTRACE(4, "Finalising RTP discovery: " << discoveryMap.size() << " possibilities");
 
-  for (map<DiscoveredRTPKey, DiscoveryInfo>::iterator it = discoveryMap.begin(); it != discoveryMap.end(); ++it) {
+  for (DiscoveryMap::iterator it = discoveryMap.begin(); it != discoveryMap.end(); ++it) {
     DiscoveredRTPInfo * info = new DiscoveredRTPInfo(it->first);
     if (it->second.Finalise(*info, m_payloadType2mediaFormat))
       discoveredRTP.Append(info);
-    else
+    else {
+      m_streamIndex.erase(it->first);
       delete info;
+    }
   }
 
-  PTRACE(3, "Completed RTP discovery: " << discoveredRTP << " streams");
+  PTRACE(3, "Completed RTP discovery: " << discoveredRTP.GetSize() << " streams,"
+            " " << chunks.GetSize() << " chunks, " << GetLength() << " bytes"
+            " in " << (PTimer::Tick() - startTick) << " seconds");
 
   return Restart();
 }
@@ -578,10 +1128,90 @@ bool OpalPCAPFile::SetFilters(const DiscoveredRTPInfo & info, const PString & fo
   m_filterSrc = info.m_src;
   m_filterDst = info.m_dst;
   m_filterSSRC = info.m_ssrc;
+
+  // If discovered, only visit this stream's packets from now on
+  StreamIndexMap::const_iterator it = m_streamIndex.find(info);
+  m_activeIndex = it != m_streamIndex.end() ? &it->second : NULL;
+  return Restart();
+}
+
+
+static size_t FindPacketTime(const OpalPCAPFile::PacketIndex & index, const PTime & when)
+{
+  PInt64 time = when.GetTimestamp();
+  size_t lo = 0, hi = index.size();
+  while (lo < hi) {
+    size_t mid = (lo + hi)/2;
+    if (index[mid].m_time < time)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+
+bool OpalPCAPFile::SeekTime(const PTime & when)
+{
+  if (m_activeIndex == NULL)
+    return false;
+
+  m_activePosition = FindPacketTime(*m_activeIndex, when);
+  return m_activePosition < m_activeIndex->size();
+}
+
+
+bool OpalPCAPFile::OpenStream(const DiscoveredRTPKey & stream, StreamCursor & cursor) const
+{
+  StreamIndexMap::const_iterator it = m_streamIndex.find(stream);
+  if (it == m_streamIndex.end()) {
+    PTRACE(2, "Stream " << stream << " not discovered");
+    return false;
+  }
+
+  cursor.m_index = &it->second;
+  cursor.m_position = 0;
+  cursor.m_frame.m_otherEndian = m_rawPacket.m_otherEndian;
   return true;
 }
 
 
+bool OpalPCAPFile::SeekStream(StreamCursor & cursor, const PTime & when) const
+{
+  if (cursor.m_index == NULL)
+    return false;
+
+  cursor.m_position = FindPacketTime(*cursor.m_index, when);
+  return cursor.m_position < cursor.m_index->size();
+}
+
+
+int OpalPCAPFile::GetRTP(StreamCursor & cursor, RTP_DataFrame & rtp)
+{
+  if (cursor.m_index == NULL || cursor.m_position >= cursor.m_index->size())
+    return -1;
+
+  off_t position = (off_t)(*cursor.m_index)[cursor.m_position++].m_position;
+
+  if (m_mapBase != NULL) {
+    if (!cursor.m_frame.Read(m_mapBase, m_mapSize, position))
+      return -1;
+  }
+  else {
+    // Without a mapping all cursors share the one file position, borrow it
+    PWaitAndSignal mutex(m_writeMutex);
+    off_t savedPosition = PFile::GetPosition();
+    bool ok = PFile::SetPosition(position) && cursor.m_frame.Read(*this);
+    PFile::SetPosition(savedPosition);
+    if (!ok)
+      return -1;
+  }
+
+  PIPSocketAddressAndPort src, dst;
+  return ExtractRTP(cursor.m_frame, rtp, src, dst, false);
+}
+
+
 void OpalPCAPFile::SetPayloadMap(const PayloadMap & payloadMap, bool overwrite)
 {
   if (overwrite)
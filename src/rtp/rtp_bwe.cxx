@@ -0,0 +1,264 @@
+/*
+ * rtp_bwe.cxx
+ *
+ * Send side bandwidth estimation for transport wide congestion control
+ *
+ * Open Phone Abstraction Library (OPAL)
+ *
+ * Copyright (C) 2017 Vox Lucida Pty. Ltd.
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open Phone Abstraction Library.
+ *
+ * The Initial Developer of the Original Code is Vox Lucida
+ *
+ * All Rights Reserved.
+ *
+ * Contributor(s): ______________________________________.
+ */
+
+#include <ptlib.h>
+
+#ifdef __GNUC__
+#pragma implementation "rtp_bwe.h"
+#endif
+
+#include <rtp/rtp_bwe.h>
+
+#include <algorithm>
+
+
+#define new PNEW
+#define PTraceModule() "RTP-BWE"
+
+
+RTP_BandwidthEstimator::RTP_BandwidthEstimator()
+  : m_accumulatedDelay(0)
+  , m_smoothedDelay(0)
+  , m_previousTrend(0)
+  , m_numDeltas(0)
+  , m_historyIndex(0)
+  , m_usage(e_Normal)
+  , m_threshold(12.5)
+  , m_timeOverUsing(-1)
+  , m_overuseCounter(0)
+  , m_delayBasedRate(InitialBitRate)
+  , m_lossBasedRate(InitialBitRate)
+  , m_ackedRate(0)
+  , m_feedbackBytes(0)
+{
+  m_history.reserve(TrendlineWindow);
+}
+
+
+unsigned RTP_BandwidthEstimator::GetTargetBitRate() const
+{
+  return (unsigned)std::max((double)MinBitRate, std::min(m_delayBasedRate, m_lossBasedRate));
+}
+
+
+void RTP_BandwidthEstimator::OnPacketFeedback(const PTimeInterval & sent,
+                                              const PTimeInterval & arrived,
+                                              unsigned size,
+                                              const PTimeInterval & now)
+{
+  if (m_feedbackBytes == 0 || arrived < m_feedbackFirstArrival)
+    m_feedbackFirstArrival = arrived;
+  if (m_feedbackBytes == 0 || arrived > m_feedbackLastArrival)
+    m_feedbackLastArrival = arrived;
+  m_feedbackBytes += size;
+
+  if (!m_currentGroup.m_valid) {
+    m_currentGroup.m_valid = true;
+    m_currentGroup.m_firstSent = m_currentGroup.m_lastSent = sent;
+    m_currentGroup.m_lastArrival = arrived;
+    return;
+  }
+
+  if (sent < m_currentGroup.m_firstSent)
+    return; // Reordered from a previous group, ignore
+
+  if ((sent - m_currentGroup.m_firstSent).GetMicroSeconds() <= BurstTimeMicroSeconds) {
+    m_currentGroup.m_lastSent = sent;
+    if (arrived > m_currentGroup.m_lastArrival)
+      m_currentGroup.m_lastArrival = arrived;
+    return;
+  }
+
+  if (m_previousGroup.m_valid) {
+    double sendDelta = (m_currentGroup.m_lastSent - m_previousGroup.m_lastSent).GetMicroSeconds()/1000.0;
+    double arrivalDelta = (m_currentGroup.m_lastArrival - m_previousGroup.m_lastArrival).GetMicroSeconds()/1000.0;
+    if (arrivalDelta < -1000 || arrivalDelta > 10000)
+      Reset(); // Remote reference time jumped, start again
+    else
+      OnGroupDelta(sendDelta, arrivalDelta, m_currentGroup.m_lastArrival, now);
+  }
+
+  m_previousGroup = m_currentGroup;
+  m_currentGroup.m_firstSent = m_currentGroup.m_lastSent = sent;
+  m_currentGroup.m_lastArrival = arrived;
+}
+
+
+void RTP_BandwidthEstimator::OnFeedbackComplete(unsigned received, unsigned lost, const PTimeInterval & now)
+{
+  double span = (m_feedbackLastArrival - m_feedbackFirstArrival).GetMicroSeconds()/1000000.0;
+  if (span >= 0.05) {
+    double rate = m_feedbackBytes*8/span;
+    m_ackedRate = m_ackedRate > 0 ? 0.8*m_ackedRate + 0.2*rate : rate;
+  }
+  m_feedbackBytes = 0;
+
+  double elapsed = m_lastRateUpdate > 0 ? std::min((now - m_lastRateUpdate).GetMilliSeconds()/1000.0, 1.0) : 0;
+  m_lastRateUpdate = now;
+
+  switch (m_usage) {
+    case e_Overusing :
+      if (m_ackedRate > 0)
+        m_delayBasedRate = std::min(m_delayBasedRate, 0.85*m_ackedRate);
+      else
+        m_delayBasedRate *= 0.85;
+      break;
+
+    case e_Underusing :
+      break; // Hold, let the queues drain
+
+    default :
+      m_delayBasedRate += std::max(1000.0, m_delayBasedRate*0.08*elapsed);
+      // Do not run away when the encoder is not using what it has got
+      if (m_ackedRate > 0)
+        m_delayBasedRate = std::min(m_delayBasedRate, 1.5*m_ackedRate + 10000);
+  }
+  m_delayBasedRate = std::max((double)MinBitRate, std::min(m_delayBasedRate, (double)MaxBitRate));
+
+  unsigned total = received + lost;
+  if (total >= 20) {
+    double loss = (double)lost/total;
+    if (loss > 0.10)
+      m_lossBasedRate *= 1 - 0.5*loss;
+    else if (loss < 0.02 && (now - m_lastLossIncrease) >= 1000) {
+      m_lossBasedRate *= 1.05;
+      m_lastLossIncrease = now;
+    }
+    // Loss controller only ever limits, never leads
+    m_lossBasedRate = std::max((double)MinBitRate, std::min(m_lossBasedRate, 1.5*m_delayBasedRate));
+  }
+
+  PTRACE(5, "Estimate:"
+            " usage=" << m_usage << ","
+            " threshold=" << m_threshold << ","
+            " acked=" << (unsigned)m_ackedRate << ","
+            " delay-based=" << (unsigned)m_delayBasedRate << ","
+            " loss-based=" << (unsigned)m_lossBasedRate << ","
+            " lost=" << lost << '/' << total);
+}
+
+
+void RTP_BandwidthEstimator::Reset()
+{
+  m_previousGroup.m_valid = false;
+  m_accumulatedDelay = m_smoothedDelay = m_previousTrend = 0;
+  m_numDeltas = 0;
+  m_history.clear();
+  m_historyIndex = 0;
+  m_usage = e_Normal;
+  m_timeOverUsing = -1;
+  m_overuseCounter = 0;
+}
+
+
+void RTP_BandwidthEstimator::OnGroupDelta(double sendDelta,
+                                          double arrivalDelta,
+                                          const PTimeInterval & arrived,
+                                          const PTimeInterval & now)
+{
+  if (m_numDeltas == 0)
+    m_firstArrival = arrived;
+  if (m_numDeltas < TrendlineMaxDeltas)
+    ++m_numDeltas;
+
+  m_accumulatedDelay += arrivalDelta - sendDelta;
+  m_smoothedDelay = 0.9*m_smoothedDelay + 0.1*m_accumulatedDelay;
+
+  std::pair<double, double> sample((arrived - m_firstArrival).GetMicroSeconds()/1000.0, m_smoothedDelay);
+  if (m_history.size() < TrendlineWindow)
+    m_history.push_back(sample);
+  else {
+    m_history[m_historyIndex] = sample;
+    m_historyIndex = (m_historyIndex + 1) % TrendlineWindow;
+  }
+
+  double trend = m_previousTrend;
+  if (m_history.size() == TrendlineWindow)
+    trend = m_numDeltas*GetSlope()*4.0;
+
+  Detect(trend, sendDelta);
+  UpdateThreshold(trend, now);
+  m_previousTrend = trend;
+}
+
+
+double RTP_BandwidthEstimator::GetSlope() const
+{
+  double sumX = 0, sumY = 0;
+  for (size_t i = 0; i < m_history.size(); ++i) {
+    sumX += m_history[i].first;
+    sumY += m_history[i].second;
+  }
+  double avgX = sumX/m_history.size();
+  double avgY = sumY/m_history.size();
+
+  double numerator = 0, denominator = 0;
+  for (size_t i = 0; i < m_history.size(); ++i) {
+    double dx = m_history[i].first - avgX;
+    numerator += dx*(m_history[i].second - avgY);
+    denominator += dx*dx;
+  }
+  return denominator != 0 ? numerator/denominator : m_previousTrend;
+}
+
+
+void RTP_BandwidthEstimator::Detect(double trend, double sendDelta)
+{
+  if (trend > m_threshold) {
+    m_timeOverUsing = m_timeOverUsing < 0 ? sendDelta/2 : m_timeOverUsing + sendDelta;
+    ++m_overuseCounter;
+    if (m_timeOverUsing > 10 && m_overuseCounter > 1 && trend >= m_previousTrend) {
+      m_timeOverUsing = 0;
+      m_overuseCounter = 0;
+      m_usage = e_Overusing;
+    }
+  }
+  else {
+    m_timeOverUsing = -1;
+    m_overuseCounter = 0;
+    m_usage = trend < -m_threshold ? e_Underusing : e_Normal;
+  }
+}
+
+
+void RTP_BandwidthEstimator::UpdateThreshold(double trend, const PTimeInterval & now)
+{
+  double elapsed = m_lastThresholdUpdate > 0 ? std::min((now - m_lastThresholdUpdate).GetMilliSeconds(), (PInt64)100) : 0;
+  m_lastThresholdUpdate = now;
+
+  double absTrend = trend < 0 ? -trend : trend;
+  if (absTrend > m_threshold + 15)
+    return; // Ignore spikes, e.g. from a route change
+
+  double k = absTrend < m_threshold ? 0.039 : 0.0087;
+  m_threshold += k*(absTrend - m_threshold)*elapsed;
+  m_threshold = std::max(6.0, std::min(m_threshold, 600.0));
+}
+
+
+// End Of File ///////////////////////////////////////////////////////////////
@@ -35,6 +35,7 @@
 #include <opal_config.h>
 
 #include <rtp/rtp_session.h>
+#include <rtp/rtp_bwe.h>
 
 #include <opal/endpoint.h>
 #include <sdp/ice.h>
@@ -124,18 +125,37 @@ OpalRTPSession::OpalRTPSession(const Init & init)
   , m_rtcpPacketsReceived(0)
   , m_roundTripTime(-1)
   , m_reportTimer(0, 4)  // Seconds
+  , m_pacerDropping(false)
+  , m_pacerDroppedPackets(0)
   , m_qos(m_manager.GetMediaQoS(init.m_mediaType))
   , m_packetOverhead(0)
   , m_remoteControlPort(0)
   , m_sendEstablished(true)
+  , m_relaySourceIn(0)
+  , m_relaySourceOut(0)
+  , m_relayOffsetsSet(false)
+  , m_relayStatisticsSample(64)
+  , m_relayPendingPackets(0)
+  , m_relayPendingOctets(0)
+  , m_relayedSources(0)
+  , m_relayedSSRC(0)
+  , m_relayedSequenceOffset(0)
+  , m_relayedTimestampOffset(0)
+  , m_relayedLastSequenceNumber(0)
+  , m_relayedLastTimestamp(0)
   , m_dataNotifier(PCREATE_NOTIFIER(OnRxDataPacket))
   , m_controlNotifier(PCREATE_NOTIFIER(OnRxControlPacket))
 {
   m_defaultSSRC[e_Receiver] = m_defaultSSRC[e_Sender] = 0;
+  memset(m_relayPayloadTypes, RTP_DataFrame::IllegalPayloadType, sizeof(m_relayPayloadTypes));
+  memset(m_relayExtensionIds, 0, sizeof(m_relayExtensionIds));
 
   PTRACE_CONTEXT_ID_TO(m_reportTimer);
   m_reportTimer.SetNotifier(PCREATE_NOTIFIER(TimedSendReport), "RTP-Report");
   m_reportTimer.Stop();
+
+  PTRACE_CONTEXT_ID_TO(m_pacerTimer);
+  m_pacerTimer.SetNotifier(PCREATE_NOTIFIER(TimedSendPaced), "RTP-Pacer");
 }
 
 
@@ -619,9 +639,14 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnSendData(RTP_Dat
   if (rewrite != e_RewriteNothing)
     frame.SetSyncSource(m_sourceIdentifier);
 
+  // Another session relaying into us owns the sequence numbers, share them
+  bool relayed = rewrite == e_RewriteHeader && m_session.m_relayedSources > 0 && m_sourceIdentifier == m_session.m_relayedSSRC;
+
   if (m_packets == 0) {
     m_firstPacketTime.SetCurrentTime();
-    if (rewrite == e_RewriteHeader || rewrite == e_Retransmit)
+    if (relayed)
+      frame.SetSequenceNumber(m_lastSequenceNumber = m_session.NextRelayedSequenceNumber(0, frame.GetTimestamp()));
+    else if (rewrite == e_RewriteHeader || rewrite == e_Retransmit)
       frame.SetSequenceNumber(m_lastSequenceNumber = (RTP_SequenceNumber)PRandom::Number(1, 32768));
     PTRACE(3, &m_session, m_session << "first sent data: "
             << setw(1) << frame
@@ -631,7 +656,11 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnSendData(RTP_Dat
   else {
     PTRACE_IF(5, frame.GetDiscontinuity() > 0, &m_session,
               *this << "have discontinuity: " << frame.GetDiscontinuity() << ", sn=" << m_lastSequenceNumber);
-    if (rewrite == e_RewriteHeader || rewrite == e_Retransmit) {
+    if (relayed) {
+      frame.SetSequenceNumber(m_lastSequenceNumber = m_session.NextRelayedSequenceNumber(frame.GetDiscontinuity(), frame.GetTimestamp()));
+      PTRACE_IF(4, m_lastSequenceNumber == 0, &m_session, m_session << "sequence number wraparound");
+    }
+    else if (rewrite == e_RewriteHeader || rewrite == e_Retransmit) {
       frame.SetSequenceNumber(m_lastSequenceNumber += (RTP_SequenceNumber)(frame.GetDiscontinuity() + 1));
       PTRACE_IF(4, m_lastSequenceNumber == 0, &m_session, m_session << "sequence number wraparound");
     }
@@ -676,7 +705,7 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::SyncSource::OnSendData(RTP_Dat
 
     OpalMediaTransport::CongestionControl * cc = m_session.GetCongestionControl();
     if (cc != NULL) {
-      PUInt16b sn((uint16_t)cc->HandleTransmitPacket(m_session.m_sessionId, frame.GetSyncSource()));
+      PUInt16b sn((uint16_t)cc->HandleTransmitPacket(m_session.m_sessionId, frame.GetSyncSource(), frame.GetPacketSize()));
       frame.SetHeaderExtension(m_session.m_transportWideSeqNumHdrExtId, 2, (const BYTE *)&sn, RTP_DataFrame::RFC5285_OneByte);
     }
   }
@@ -1533,10 +1562,28 @@ class RTP_TransportWideCongestionControlHandler : public OpalMediaTransport::Con
 {
 protected:
   OpalRTPSession & m_session;
+  PDECLARE_MUTEX(m_mutex);
 
-  // For transmit
+  // For transmit, a ring buffer so unacknowledged packets do not accumulate
+  enum { MaxOutstandingPackets = 8192 }; // Must be power of two
+  struct SentInfo
+  {
+    SentInfo() : m_sequenceNumber(UINT_MAX), m_sessionID(0), m_SSRC(0), m_size(0) { }
+
+    unsigned         m_sequenceNumber;
+    PTimeInterval    m_sentTime;
+    unsigned         m_sessionID;
+    RTP_SyncSourceId m_SSRC;
+    unsigned         m_size;
+  };
   atomic<uint16_t> m_transportWideSequenceNumber;
-  RTP_TransportWideCongestionControl::PacketMap m_sentPackets;
+  std::vector<SentInfo> m_sentPackets;
+
+  // Estimation and pacing
+  RTP_BandwidthEstimator m_estimator;
+  PTimeInterval m_pacerNextSend;
+  typedef std::map<unsigned, unsigned> SessionBitRates;
+  SessionBitRates m_flowControlBitRates;
 
   // For receive
   struct Info
@@ -1556,18 +1603,46 @@ protected:
 public:
   RTP_TransportWideCongestionControlHandler(OpalRTPSession & session)
     : m_session(session)
+    , m_sentPackets(MaxOutstandingPackets)
     , m_packetBaseTime(0)
     , m_rtcpSequenceNumber(0)
   {
   }
 
-  virtual unsigned HandleTransmitPacket(unsigned sessionID, uint32_t ssrc)
+  virtual unsigned HandleTransmitPacket(unsigned sessionID, uint32_t ssrc, unsigned size)
   {
     unsigned sn = ++m_transportWideSequenceNumber;
-    m_sentPackets.insert(make_pair(sn, RTP_TransportWideCongestionControl::Info(0, sessionID, ssrc)));
+
+    PWaitAndSignal lock(m_mutex);
+    SentInfo & info = m_sentPackets[sn & (MaxOutstandingPackets-1)];
+    info.m_sequenceNumber = sn;
+    info.m_sentTime = PTimer::Tick();
+    info.m_sessionID = sessionID;
+    info.m_SSRC = ssrc;
+    info.m_size = size;
     return sn;
   }
 
+  virtual PTimeInterval GetPacingDelay(unsigned size)
+  {
+    static const PTimeInterval MaxBurst(5);
+    static const PTimeInterval MaxDelay(100);
+
+    PWaitAndSignal lock(m_mutex);
+
+    // Leaky bucket, draining at a multiple of the estimate so encoder bursts are smoothed, not throttled
+    PTimeInterval now = PTimer::Tick();
+    if (m_pacerNextSend < now - MaxBurst)
+      m_pacerNextSend = now - MaxBurst;
+
+    PTimeInterval delay = m_pacerNextSend > now ? m_pacerNextSend - now : PTimeInterval(0);
+    if (delay > MaxDelay)
+      return PMaxTimeInterval; // Too far behind, queuing more only adds latency
+
+    m_pacerNextSend += PTimeInterval::MicroSeconds(size*8*1000000ULL*2/(m_estimator.GetTargetBitRate()*5));
+    return delay;
+  }
+
   virtual void HandleReceivePacket(unsigned sn, const PTime & received)
   {
     m_queue.push(Info(sn, received));
@@ -1619,12 +1694,59 @@ public:
 
   virtual void ProcessTWCC(RTP_TransportWideCongestionControl & twcc)
   {
-    for (RTP_TransportWideCongestionControl::PacketMap::iterator pkt = twcc.m_packets.begin(); pkt != twcc.m_packets.end(); ++pkt) {
-      RTP_TransportWideCongestionControl::PacketMap::iterator sent = m_sentPackets.find(pkt->first);
-      if (sent != m_sentPackets.end()) {
-        pkt->second.m_sessionID = sent->second.m_sessionID;
-        pkt->second.m_SSRC = sent->second.m_SSRC;
-        m_sentPackets.erase(sent);
+    if (twcc.m_packets.empty())
+      return;
+
+    SessionBitRates flowControl;
+
+    {
+      PWaitAndSignal lock(m_mutex);
+
+      PTimeInterval now = PTimer::Tick();
+      SessionBitRates sessionBytes;
+      unsigned totalBytes = 0;
+      unsigned received = 0;
+      for (RTP_TransportWideCongestionControl::PacketMap::iterator pkt = twcc.m_packets.begin(); pkt != twcc.m_packets.end(); ++pkt) {
+        unsigned sn = pkt->first & 0xffff;
+        SentInfo & sent = m_sentPackets[sn & (MaxOutstandingPackets-1)];
+        if (sent.m_sequenceNumber != sn)
+          continue; // Too old, or never sent
+
+        pkt->second.m_sessionID = sent.m_sessionID;
+        pkt->second.m_SSRC = sent.m_SSRC;
+        m_estimator.OnPacketFeedback(sent.m_sentTime, pkt->second.m_timestamp, sent.m_size, now);
+        sessionBytes[sent.m_sessionID] += sent.m_size;
+        totalBytes += sent.m_size;
+        ++received;
+        sent.m_sequenceNumber = UINT_MAX; // Only use once
+      }
+
+      if (received == 0)
+        return;
+
+      unsigned span = twcc.m_packets.rbegin()->first - twcc.m_packets.begin()->first + 1;
+      m_estimator.OnFeedbackComplete(received, span > received ? span - received : 0, now);
+
+      /* Share the estimate between the sessions on this transport, in proportion
+         to what they are actually sending. Only tell the encoders when it moves
+         by more than 5%, so we do not keep thrashing them. */
+      unsigned target = m_estimator.GetTargetBitRate();
+      for (SessionBitRates::iterator it = sessionBytes.begin(); it != sessionBytes.end(); ++it) {
+        unsigned rate = (unsigned)((PUInt64)target*it->second/totalBytes);
+        unsigned & previous = m_flowControlBitRates[it->first];
+        if (rate*20 < previous*19 || rate*20 > previous*21) {
+          previous = rate;
+          flowControl[it->first] = rate;
+        }
+      }
+    }
+
+    // Outside of mutex, this can take a while
+    for (SessionBitRates::iterator it = flowControl.begin(); it != flowControl.end(); ++it) {
+      OpalMediaStreamPtr stream = m_session.GetConnection().GetMediaStream(it->first, false);
+      if (stream != NULL && stream->GetMediaFormat().GetMediaType() == OpalMediaType::Video()) {
+        PTRACE(4, &m_session, m_session << "TWCC estimate for session " << it->first << " is " << it->second << "bps");
+        m_session.GetConnection().ExecuteMediaCommand(OpalMediaFlowControl(it->second, OpalMediaType::Video(), it->first), true);
       }
     }
   }
@@ -2881,7 +3003,31 @@ bool OpalRTPSession::Close()
   PTRACE(3, *this << "closing RTP.");
 
   m_reportTimer.Stop(true);
+  m_pacerTimer.Stop(true);
+
+  // Send what the pacer was still holding back, before any BYE below
+  unsigned pacedSent = 0, pacedLost = 0;
+  for (;;) {
+    m_pacerMutex.Wait();
+    if (m_pacedFrames.empty()) {
+      m_pacerMutex.Signal();
+      break;
+    }
+    PacedFrame paced = m_pacedFrames.front();
+    m_pacedFrames.pop();
+    m_pacerMutex.Signal();
+
+    if (pacedLost == 0 && InternalWriteData(paced.m_frame, paced.m_rewrite,
+                                            paced.m_remote.IsValid() ? &paced.m_remote : NULL) != e_AbortTransport)
+      ++pacedSent;
+    else
+      ++pacedLost;
+  }
+  PTRACE_IF(3, pacedSent > 0, *this << "flushed " << pacedSent << " paced packets on close");
+  PTRACE_IF(2, pacedLost > 0, *this << "lost " << pacedLost << " paced packets on close, transport closed");
+  PTRACE_IF(3, m_pacerDroppedPackets > 0, *this << "pacer dropped " << m_pacerDroppedPackets << " packets during session");
   m_endpoint.RegisterLocalRTP(this, true);
+  SetRelay(NULL);
 
   if (IsOpen() && LockReadOnly(P_DEBUG_LOCATION)) {
     for (SyncSourceMap::iterator it = m_SSRC.begin(); it != m_SSRC.end(); ++it) {
@@ -3018,6 +3164,10 @@ bool OpalRTPSession::SetRemoteAddress(const OpalTransportAddress & remoteAddress
 
 void OpalRTPSession::OnRxDataPacket(OpalMediaTransport &, PBYTEArray data)
 {
+  // Relayed packets never get to the session lock
+  if (RelayDataPacket(data))
+    return;
+
   P_INSTRUMENTED_LOCK_READ_WRITE(return);
 
   if (data.IsEmpty()) {
@@ -3045,6 +3195,394 @@ void OpalRTPSession::OnRxDataPacket(OpalMediaTransport &, PBYTEArray data)
 }
 
 
+bool OpalRTPSession::SetRelay(OpalRTPSession * target,
+                              unsigned statisticsSample,
+                              RTP_DataFrame::PayloadTypes payloadType,
+                              RTP_DataFrame::PayloadTypes targetPayloadType)
+{
+  OpalMediaTransportPtr transport;
+  PSafePtr<OpalRTPSession> session;
+  RTP_SyncSourceId ssrcOut = 0;
+  BYTE payloadTypes[RTP_DataFrame::MaxPayloadType+1];
+  BYTE extensionIds[256];
+
+  if (target != NULL) {
+    if (target == this) {
+      PTRACE(2, *this << "cannot relay to self");
+      return false;
+    }
+
+    PSafeLockReadOnly lock(*target);
+    if (!lock.IsLocked())
+      return false;
+
+    transport = target->GetTransport();
+    if (transport == NULL || !transport->IsOpen()) {
+      PTRACE(2, *this << "cannot relay to " << *target << ", no transport");
+      return false;
+    }
+
+    session = target;
+    session.SetSafetyMode(PSafeReference);
+
+    SyncSource * info;
+    if (!target->GetSyncSource(0, e_Sender, info)) {
+      PTRACE(2, *this << "cannot relay to " << *target << ", no sender SSRC");
+      return false;
+    }
+
+    ssrcOut = info->m_sourceIdentifier;
+
+    if (payloadType == RTP_DataFrame::IllegalPayloadType) {
+      for (PINDEX pt = 0; pt <= RTP_DataFrame::MaxPayloadType; ++pt)
+        payloadTypes[pt] = (BYTE)pt;
+    }
+    else {
+      memset(payloadTypes, RTP_DataFrame::IllegalPayloadType, sizeof(payloadTypes));
+      payloadTypes[payloadType] = (BYTE)targetPayloadType;
+      if (m_redundencyPayloadType != RTP_DataFrame::IllegalPayloadType &&
+          target->m_redundencyPayloadType != RTP_DataFrame::IllegalPayloadType)
+        payloadTypes[m_redundencyPayloadType] = (BYTE)target->m_redundencyPayloadType;
+      if (m_ulpFecPayloadType != RTP_DataFrame::IllegalPayloadType &&
+          target->m_ulpFecPayloadType != RTP_DataFrame::IllegalPayloadType)
+        payloadTypes[m_ulpFecPayloadType] = (BYTE)target->m_ulpFecPayloadType;
+    }
+
+    // Match header extensions by URI, except the ones that only have meaning for one hop
+    memset(extensionIds, 0, sizeof(extensionIds));
+    RTPHeaderExtensions ourExtensions = GetHeaderExtensions();
+    RTPHeaderExtensions targetExtensions = target->GetHeaderExtensions();
+    for (RTPHeaderExtensions::iterator ours = ourExtensions.begin(); ours != ourExtensions.end(); ++ours) {
+      PString uri = ours->m_uri.AsString();
+      if (ours->m_id > 255 || uri == GetAbsSendTimeHdrExtURI() || uri == GetTransportWideSeqNumHdrExtURI())
+        continue;
+      for (RTPHeaderExtensions::iterator theirs = targetExtensions.begin(); theirs != targetExtensions.end(); ++theirs) {
+        if (theirs->m_uri == ours->m_uri && theirs->m_id <= 255) {
+          extensionIds[ours->m_id] = (BYTE)theirs->m_id;
+          break;
+        }
+      }
+    }
+
+    // From here on, the target numbers what it sends from state shared with us
+    target->AttachRelayedSource(*info);
+  }
+
+  RTP_SyncSourceId flushSSRC;
+  unsigned flushPackets;
+  uint64_t flushOctets;
+  PSafePtr<OpalRTPSession> flushSession;
+
+  {
+    PWaitAndSignal lock(m_relayMutex);
+
+    flushSSRC = m_relaySourceIn;
+    flushPackets = m_relayPendingPackets;
+    flushOctets = m_relayPendingOctets;
+    flushSession = m_relaySession;
+
+    PTRACE_IF(3, m_relayTransport != NULL || transport != NULL,
+              *this << (transport != NULL ? "started" : "stopped") << " direct relay of RTP data");
+
+    m_relayTransport = transport;
+    m_relaySession = session;
+    m_relaySourceIn = 0;
+    m_relaySourceOut = ssrcOut;
+    m_relayOffsetsSet = false;
+    m_relayStatisticsSample = std::max(statisticsSample, 1U);
+    m_relayPendingPackets = 0;
+    m_relayPendingOctets = 0;
+    if (transport != NULL) {
+      memcpy(m_relayPayloadTypes, payloadTypes, sizeof(m_relayPayloadTypes));
+      memcpy(m_relayExtensionIds, extensionIds, sizeof(m_relayExtensionIds));
+    }
+  }
+
+  if (flushPackets > 0) {
+    AddRelayStatistics(flushSSRC, e_Receiver, flushPackets, flushOctets);
+    if (flushSession != NULL)
+      flushSession->AddRelayStatistics(0, e_Sender, flushPackets, flushOctets);
+  }
+
+  if (flushSession != NULL)
+    flushSession->DetachRelayedSource();
+
+  return true;
+}
+
+
+bool OpalRTPSession::RelayDataPacket(PBYTEArray & data)
+{
+  PINDEX size = data.GetSize();
+  if (size < RTP_DataFrame::MinHeaderSize)
+    return false;
+
+  BYTE * ptr = data.GetPointer();
+
+  // Only version 2 RTP, anything else, including RTCP multiplexed on this port, goes the long way
+  if ((ptr[0] & 0xc0) != 0x80 ||
+        (ptr[1] >= RTP_ControlFrame::e_FirstValidPayloadType && ptr[1] <= RTP_ControlFrame::e_LastValidPayloadType))
+    return false;
+
+  PINDEX headerSize = RTP_DataFrame::MinHeaderSize + (ptr[0] & 0x0f)*4;
+  if (size < headerSize)
+    return false;
+
+  // Header extension, RFC 5285 one or two byte forms are renumbered, anything else is passed through
+  BYTE * extension = NULL;
+  PINDEX extensionSize = 0;
+  unsigned extensionProfile = 0;
+  if ((ptr[0] & 0x10) != 0) {
+    if (size < headerSize + 4)
+      return false;
+    extensionProfile = *reinterpret_cast<PUInt16b *>(ptr+headerSize);
+    extensionSize = *reinterpret_cast<PUInt16b *>(ptr+headerSize+2)*4;
+    extension = ptr + headerSize + 4;
+    headerSize += 4 + extensionSize;
+    if (size < headerSize)
+      return false;
+  }
+
+  PINDEX payloadSize = size - headerSize;
+  if ((ptr[0] & 0x20) != 0) {
+    if (payloadSize == 0 || ptr[size-1] > payloadSize)
+      return false;
+    payloadSize -= ptr[size-1];
+  }
+
+  /* Keep the original header, so the normal path gets an untouched packet
+     if the write fails. Extensions bigger than we are prepared to copy take
+     the normal path. */
+  BYTE original[RTP_DataFrame::MinHeaderSize + 15*4 + 4 + 256];
+  if (headerSize > (PINDEX)sizeof(original))
+    return false;
+  memcpy(original, ptr, headerSize);
+
+  PUInt16b & sequenceNumber = *reinterpret_cast<PUInt16b *>(ptr+2);
+  PUInt32b & timestamp      = *reinterpret_cast<PUInt32b *>(ptr+4);
+  PUInt32b & syncSource     = *reinterpret_cast<PUInt32b *>(ptr+8);
+
+  OpalMediaTransportPtr transport;
+  RTP_SyncSourceId flushSSRC = 0;
+  unsigned flushPackets = 0;
+  uint64_t flushOctets = 0;
+  PSafePtr<OpalRTPSession> flushSession;
+
+  {
+    PWaitAndSignal lock(m_relayMutex);
+
+    if (m_relayTransport == NULL)
+      return false;
+
+    BYTE payloadType = m_relayPayloadTypes[ptr[1] & 0x7f];
+    if (payloadType == RTP_DataFrame::IllegalPayloadType)
+      return false;
+    ptr[1] = (BYTE)((ptr[1] & 0x80) | payloadType);
+
+    if (extensionProfile == 0xbede)
+      RelayHeaderExtensions(extension, extensionSize, false);
+    else if ((extensionProfile & 0xfff0) == 0x1000)
+      RelayHeaderExtensions(extension, extensionSize, true);
+
+    RTP_SyncSourceId ssrcIn = syncSource;
+    bool newSource = !m_relayOffsetsSet || ssrcIn != m_relaySourceIn;
+    if (newSource) {
+      PTRACE(4, *this << "relay SSRC=" << RTP_TRACE_SRC(ssrcIn) << " to SSRC=" << RTP_TRACE_SRC(m_relaySourceOut));
+      if (m_relayPendingPackets > 0) {
+        flushSSRC = m_relaySourceIn;
+        flushPackets = m_relayPendingPackets;
+        flushOctets = m_relayPendingOctets;
+        m_relayPendingPackets = 0;
+        m_relayPendingOctets = 0;
+      }
+      m_relaySourceIn = ssrcIn;
+      m_relayOffsetsSet = true;
+    }
+
+    RTP_SequenceNumber sn = sequenceNumber;
+    RTP_Timestamp ts = timestamp;
+    m_relaySession->MapRelayedPacket(newSource, sn, ts);
+    sequenceNumber = sn;
+    timestamp = ts;
+    syncSource = m_relaySourceOut;
+
+    ++m_relayPendingPackets;
+    m_relayPendingOctets += payloadSize;
+    if (flushPackets == 0 && m_relayPendingPackets >= m_relayStatisticsSample) {
+      flushSSRC = m_relaySourceIn;
+      flushPackets = m_relayPendingPackets;
+      flushOctets = m_relayPendingOctets;
+      m_relayPendingPackets = 0;
+      m_relayPendingOctets = 0;
+    }
+
+    if (flushPackets > 0)
+      flushSession = m_relaySession;
+
+    transport = m_relayTransport;
+  }
+
+  // Write outside the lock, so SetRelay() and statistics are never held up by the socket
+  if (!transport->Write(ptr, size, e_Data)) {
+    PTRACE(2, *this << "relay write failed, reverting to media stream path");
+    {
+      PWaitAndSignal lock(m_relayMutex);
+      if (m_relayTransport == transport)
+        m_relayTransport.SetNULL();
+      if (m_relayPendingPackets > 0) {
+        --m_relayPendingPackets;
+        m_relayPendingOctets -= std::min(m_relayPendingOctets, (uint64_t)payloadSize);
+      }
+    }
+    // Put it back the way it was, so the normal path can have it
+    memcpy(ptr, original, headerSize);
+    return false;
+  }
+
+  if (flushPackets > 0) {
+    AddRelayStatistics(flushSSRC, e_Receiver, flushPackets, flushOctets);
+    if (flushSession != NULL)
+      flushSession->AddRelayStatistics(0, e_Sender, flushPackets, flushOctets);
+  }
+
+  return true;
+}
+
+
+void OpalRTPSession::RelayHeaderExtensions(BYTE * ptr, PINDEX size, bool twoByte)
+{
+  BYTE * end = ptr + size;
+  while (ptr < end) {
+    unsigned id, length, elementSize;
+    if (twoByte) {
+      id = ptr[0];
+      if (id == 0) {
+        ++ptr; // Padding
+        continue;
+      }
+      if (ptr + 2 > end)
+        return;
+      length = ptr[1];
+      elementSize = 2 + length;
+    }
+    else {
+      id = ptr[0] >> 4;
+      if (id == 0) {
+        ++ptr; // Padding
+        continue;
+      }
+      if (id == 15)
+        return; // Reserved, stop processing
+      length = (ptr[0] & 0x0f) + 1;
+      elementSize = 1 + length;
+    }
+
+    if (ptr + elementSize > end)
+      return;
+
+    unsigned newId = m_relayExtensionIds[id];
+    if (newId == 0 || (!twoByte && newId > RTP_DataFrame::MaxHeaderExtensionIdOneByte))
+      memset(ptr, 0, elementSize); // Every zero byte is padding
+    else if (twoByte)
+      ptr[0] = (BYTE)newId;
+    else
+      ptr[0] = (BYTE)((newId << 4) | (ptr[0] & 0x0f));
+
+    ptr += elementSize;
+  }
+}
+
+
+void OpalRTPSession::AddRelayStatistics(RTP_SyncSourceId ssrc,
+                                        Direction dir,
+                                        unsigned packets,
+                                        uint64_t octets)
+{
+  P_INSTRUMENTED_LOCK_READ_WRITE(return);
+
+  SyncSource * info;
+  if (ssrc == 0) {
+    if (!GetSyncSource(0, dir, info))
+      return;
+  }
+  else {
+    if ((info = UseSyncSource(ssrc, dir, true)) == NULL)
+      return;
+  }
+
+  if (info->m_packets == 0)
+    info->m_firstPacketTime.SetCurrentTime();
+  info->m_packets += packets;
+  info->m_octets += octets;
+
+  if (dir == e_Sender) {
+    PWaitAndSignal relayedLock(m_relayedMutex);
+    info->m_lastSequenceNumber = m_relayedLastSequenceNumber;
+    info->m_lastPacketTimestamp = m_relayedLastTimestamp;
+  }
+}
+
+
+void OpalRTPSession::AttachRelayedSource(const SyncSource & sender)
+{
+  PWaitAndSignal lock(m_relayedMutex);
+
+  if (m_relayedSources++ == 0 || m_relayedSSRC != sender.m_sourceIdentifier) {
+    m_relayedSSRC = sender.m_sourceIdentifier;
+    m_relayedLastSequenceNumber = sender.m_lastSequenceNumber;
+    m_relayedLastTimestamp = sender.m_lastPacketTimestamp;
+  }
+}
+
+
+void OpalRTPSession::DetachRelayedSource()
+{
+  P_INSTRUMENTED_LOCK_READ_WRITE(return);
+
+  PWaitAndSignal relayedLock(m_relayedMutex);
+  if (m_relayedSources == 0 || --m_relayedSources > 0)
+    return;
+
+  // Hand the sequence back to the sender, for the normal path to carry on from
+  SyncSource * sender;
+  if (GetSyncSource(m_relayedSSRC, e_Sender, sender)) {
+    sender->m_lastSequenceNumber = m_relayedLastSequenceNumber;
+    sender->m_lastPacketTimestamp = m_relayedLastTimestamp;
+  }
+}
+
+
+void OpalRTPSession::MapRelayedPacket(bool newSource, RTP_SequenceNumber & sequenceNumber, RTP_Timestamp & timestamp)
+{
+  PWaitAndSignal lock(m_relayedMutex);
+
+  if (newSource) {
+    /* Continue on from whatever was last sent, by the relay or not, a new
+       source SSRC is just a discontinuity, so leave a nominal 20ms gap in
+       timestamp. */
+    m_relayedSequenceOffset = (RTP_SequenceNumber)(m_relayedLastSequenceNumber + 1 - sequenceNumber);
+    m_relayedTimestampOffset = m_relayedLastTimestamp + m_timeUnits*20 - timestamp;
+    PTRACE(4, *this << "relayed sn offset=" << m_relayedSequenceOffset << ", ts offset=" << m_relayedTimestampOffset);
+  }
+
+  sequenceNumber = m_relayedLastSequenceNumber = (RTP_SequenceNumber)(sequenceNumber + m_relayedSequenceOffset);
+  timestamp = m_relayedLastTimestamp = timestamp + m_relayedTimestampOffset;
+}
+
+
+RTP_SequenceNumber OpalRTPSession::NextRelayedSequenceNumber(unsigned discontinuity, RTP_Timestamp timestamp)
+{
+  PWaitAndSignal lock(m_relayedMutex);
+
+  // Move the relay along too, so what it sends next does not reuse this number
+  RTP_SequenceNumber step = (RTP_SequenceNumber)(discontinuity + 1);
+  m_relayedSequenceOffset += step;
+  m_relayedLastSequenceNumber += step;
+  m_relayedLastTimestamp = timestamp;
+  return m_relayedLastSequenceNumber;
+}
+
+
 void OpalRTPSession::OnRxControlPacket(OpalMediaTransport &, PBYTEArray data)
 {
   P_INSTRUMENTED_LOCK_READ_WRITE(return);
@@ -3080,6 +3618,92 @@ OpalRTPSession::SendReceiveStatus OpalRTPSession::WriteData(RTP_DataFrame & fram
   if (!transport->IsEstablished())
     return e_IgnorePacket;
 
+  /* Smooth out the bursts from a video encoder, before the transmit time is
+     stamped. Anything that has to wait is queued and sent from the pacer timer,
+     once something is queued everything after it is too, to keep the order.
+     If the encoder is so far over the estimated bandwidth that the queue would
+     only grow, the rest of the video frame is dropped, the far end will then
+     ask for an intra frame, and as the queue drains the encoder, following
+     the estimate, catches up. */
+  if (!m_isAudio && rewrite != e_RewriteNothing) {
+    OpalMediaTransport::CongestionControl * cc = GetCongestionControl();
+    if (cc != NULL) {
+      PWaitAndSignal lock(m_pacerMutex);
+      PTimeInterval delay = m_pacerDropping ? PMaxTimeInterval : cc->GetPacingDelay(frame.GetPacketSize());
+      if (delay == PMaxTimeInterval) {
+        PTRACE_IF(3, !m_pacerDropping, *this << "pacer too far behind, dropping rest of video frame,"
+                                                " " << m_pacerDroppedPackets << " packets dropped so far");
+        m_pacerDropping = !frame.GetMarker();
+        ++m_pacerDroppedPackets;
+        return e_IgnorePacket;
+      }
+      if (delay > 0 || !m_pacedFrames.empty()) {
+        PTimeInterval due = PTimer::Tick() + delay;
+        if (!m_pacedFrames.empty() && due < m_pacedFrames.back().m_due)
+          due = m_pacedFrames.back().m_due;
+        m_pacedFrames.push(PacedFrame(frame, rewrite, remote, due));
+        if (m_pacedFrames.size() == 1)
+          m_pacerTimer = std::max(delay, PTimeInterval(1));
+        return e_ProcessPacket;
+      }
+    }
+  }
+
+  return InternalWriteData(frame, rewrite, remote);
+}
+
+
+OpalRTPSession::PacedFrame::PacedFrame(const RTP_DataFrame & frame,
+                                       RewriteMode rewrite,
+                                       const PIPSocketAddressAndPort * remote,
+                                       const PTimeInterval & due)
+  : m_frame(frame)
+  , m_rewrite(rewrite)
+  , m_due(due)
+{
+  m_frame.MakeUnique(); // Caller is free to reuse its buffer
+  if (remote != NULL)
+    m_remote = *remote;
+}
+
+
+void OpalRTPSession::TimedSendPaced(PTimer &, P_INT_PTR)
+{
+  for (;;) {
+    m_pacerMutex.Wait();
+    if (m_pacedFrames.empty()) {
+      m_pacerMutex.Signal();
+      return;
+    }
+
+    PTimeInterval now = PTimer::Tick();
+    if (m_pacedFrames.front().m_due > now) {
+      m_pacerTimer = m_pacedFrames.front().m_due - now;
+      m_pacerMutex.Signal();
+      return;
+    }
+
+    /* Leave it in the queue while sending, so WriteData() keeps queuing behind
+       it rather than overtaking it. The queue is only popped here. */
+    PacedFrame paced = m_pacedFrames.front();
+    m_pacerMutex.Signal();
+
+    InternalWriteData(paced.m_frame, paced.m_rewrite, paced.m_remote.IsValid() ? &paced.m_remote : NULL);
+
+    m_pacerMutex.Wait();
+    if (!m_pacedFrames.empty())
+      m_pacedFrames.pop();
+    m_pacerMutex.Signal();
+  }
+}
+
+
+OpalRTPSession::SendReceiveStatus OpalRTPSession::InternalWriteData(RTP_DataFrame & frame, RewriteMode rewrite, const PIPSocketAddressAndPort * remote)
+{
+  OpalMediaTransportPtr transport = m_transport;
+  if (transport == NULL)
+    return e_AbortTransport;
+
   if (!LockReadWrite(P_DEBUG_LOCATION))
     return e_AbortTransport;
 
@@ -189,6 +189,14 @@ bool OpalRTPMediaStream::SetMediaPassThrough(OpalMediaStream & otherStream, bool
 
     PTRACE(3, "Media pass through set from " << *this << " to " << otherStream);
     m_passThruStream = &otherStream;
+
+    unsigned relaySample = m_rtpSession.GetStringOptions().GetInteger(OPAL_OPT_RTP_RELAY);
+    OpalRTPMediaStream * otherRTP = dynamic_cast<OpalRTPMediaStream *>(&otherStream);
+    if (relaySample > 0 && otherRTP != NULL &&
+            m_rtpSession.GetSessionType() == OpalRTPSession::RTP_AVP() &&
+            otherRTP->m_rtpSession.GetSessionType() == OpalRTPSession::RTP_AVP())
+      m_rtpSession.SetRelay(&otherRTP->m_rtpSession, relaySample,
+                            m_mediaFormat.GetPayloadType(), otherRTP->m_mediaFormat.GetPayloadType());
   }
   else {
     if (m_passThruStream == NULL) {
@@ -198,6 +206,9 @@ bool OpalRTPMediaStream::SetMediaPassThrough(OpalMediaStream & otherStream, bool
 
     PTRACE(2, "Media pass through ceased from " << *this << " to " << *m_passThruStream);
     m_passThruStream.SetNULL();
+
+    if (m_rtpSession.IsRelaying())
+      m_rtpSession.SetRelay(NULL);
   }
 
   return OpalMediaStream::SetMediaPassThrough(otherStream, bypass);
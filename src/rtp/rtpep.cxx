@@ -173,7 +173,8 @@ PStringList OpalRTPEndPoint::GetAvailableStringOptions() const
       OPAL_OPT_DTLS_TIMEOUT,
     #endif
     OPAL_OPT_RTP_ABS_SEND_TIME,
-    OPAL_OPT_TRANSPORT_WIDE_CONGESTION_CONTROL
+    OPAL_OPT_TRANSPORT_WIDE_CONGESTION_CONTROL,
+    OPAL_OPT_RTP_RELAY
   };
 
   PStringList list = OpalEndPoint::GetAvailableStringOptions();
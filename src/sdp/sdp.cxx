@@ -205,20 +205,127 @@ static OpalTransportAddress ParseConnectAddress(const PString & str, WORD port =
 }
 
 
-static PString GetConnectAddressString(const OpalTransportAddress & address)
+static ostream & OutputConnectAddress(ostream & strm, const OpalTransportAddress & address)
 {
-  PStringStream str;
-
   PIPSocket::Address ip;
   if (!address.IsEmpty() && address.GetIpAddress(ip) && ip.IsValid())
-    str << "IN IP" << ip.GetVersion() << ' ' << ip.AsString(false, true);
+    strm << "IN IP" << ip.GetVersion() << ' ' << ip.AsString(false, true);
   else
-    str << "IN IP4 0.0.0.0";
-
-  return str;
+    strm << "IN IP4 0.0.0.0";
+  return strm;
 }
 
 
+/* Walks SDP line by line, in place, either directly over the buffer of the
+   SIP body, or over an array of lines. Nothing is copied until a value is
+   asked for as a PString, which the decode hooks need, and then it is one
+   copy, already trimmed. */
+class SDPLineTokenizer
+{
+  public:
+    SDPLineTokenizer(const PString & str)
+      : m_lines(NULL)
+      , m_next(str)
+      , m_end(m_next + str.GetLength())
+      , m_index(0)
+      , m_line(NULL)
+      , m_value(NULL)
+      , m_valueEnd(NULL)
+    {
+    }
+
+    SDPLineTokenizer(const PStringArray & lines)
+      : m_lines(&lines)
+      , m_next(NULL)
+      , m_end(NULL)
+      , m_index(0)
+      , m_line(NULL)
+      , m_value(NULL)
+      , m_valueEnd(NULL)
+    {
+    }
+
+    // Move to the next "x=value" line, skipping illegal ones
+    bool Next()
+    {
+      const char * line;
+      const char * lineEnd;
+      while (NextRaw(m_next, m_index, line, lineEnd)) {
+        if (lineEnd - line < 3 || line[1] != '=')
+          continue; // Ignore illegal lines
+
+        m_line = line;
+        m_value = line + 2;
+        m_valueEnd = lineEnd;
+        while (m_value < m_valueEnd && isspace((unsigned char)*m_value))
+          ++m_value;
+        while (m_valueEnd > m_value && isspace((unsigned char)m_valueEnd[-1]))
+          --m_valueEnd;
+        return true;
+      }
+      return false;
+    }
+
+    char GetKey() const { return *m_line; }
+    PString GetValue() const { return PString(m_value, m_valueEnd - m_value); }
+    PString GetLine() const { return PString(m_line, m_valueEnd - m_line); }
+
+    /* Get the current "m=" line and the rest of its section, for
+       OpalMediaTypeDefinition::MatchesSDP() to look ahead in. Only these
+       lines are copied, and only for "m=" lines. */
+    PStringArray GetSection() const
+    {
+      PStringArray section;
+      section.AppendString(GetLine());
+
+      const char * next = m_next;
+      PINDEX index = m_index;
+      const char * line;
+      const char * lineEnd;
+      while (NextRaw(next, index, line, lineEnd) && *line != 'm') {
+        while (lineEnd > line && isspace((unsigned char)lineEnd[-1]))
+          --lineEnd;
+        if (lineEnd > line)
+          section.AppendString(PString(line, lineEnd - line));
+      }
+      return section;
+    }
+
+  protected:
+    bool NextRaw(const char * & next, PINDEX & index, const char * & line, const char * & lineEnd) const
+    {
+      if (m_lines != NULL) {
+        if (index >= m_lines->GetSize())
+          return false;
+        const PString & str = (*m_lines)[index++];
+        line = str;
+        lineEnd = line + str.GetLength();
+        return true;
+      }
+
+      // Skip the CR of CRLF, and blank lines
+      while (next < m_end && (*next == '\r' || *next == '\n'))
+        ++next;
+      if (next >= m_end)
+        return false;
+
+      line = next;
+      while (next < m_end && *next != '\r' && *next != '\n')
+        ++next;
+      lineEnd = next;
+      return true;
+    }
+
+    const PStringArray * m_lines;
+    const char * m_next;
+    const char * m_end;
+    PINDEX       m_index;
+    const char * m_line;
+    const char * m_value;
+    const char * m_valueEnd;
+};
+
+
 /////////////////////////////////////////////////////////
 
 SDPMediaFormat::SDPMediaFormat(SDPMediaDescription & parent)
@@ -555,8 +662,13 @@ void SDPCommonAttributes::ParseAttribute(const PString & value)
   PCaselessString attr(value.Left(pos));
   if (pos == P_MAX_INDEX)
     SetAttribute(attr, "1");
-  else if (value[pos] == ':')
-    SetAttribute(attr, value.Mid(pos + 1).LeftTrim());
+  else if (value[pos] == ':') {
+    // Skip leading white space before taking the one copy of the value
+    PINDEX start = pos + 1;
+    while (isspace((unsigned char)value[start]))
+      ++start;
+    SetAttribute(attr, value.Mid(start));
+  }
   else {
     PTRACE(2, "Malformed media attribute " << value);
   }
@@ -1149,7 +1261,7 @@ void SDPMediaDescription::Encode(const OpalTransportAddress & commonAddr, ostrea
 
   PIPSocket::Address commonIP, transportIP;
   if (m_mediaAddress.GetIpAddress(transportIP) && commonAddr.GetIpAddress(commonIP) && commonIP != transportIP)
-    strm << "c=" << GetConnectAddressString(m_mediaAddress) << CRLF;
+    OutputConnectAddress(strm << "c=", m_mediaAddress) << CRLF;
 
   strm << m_bandwidth;
   OutputAttributes(strm);
@@ -1771,7 +1883,7 @@ void SDPRTPAVPMediaDescription::OutputAttributes(ostream & strm) const
     PIPSocket::Address ip;
     WORD port = 0;
     if (m_controlAddress.GetIpAndPort(ip, port) && port != (m_port+1))
-      strm << "a=rtcp:" << port << ' ' << GetConnectAddressString(m_mediaAddress) << CRLF;
+      OutputConnectAddress(strm << "a=rtcp:" << port << ' ', m_mediaAddress) << CRLF;
   }
 
   if (m_reducedSizeRTCP)
@@ -2726,13 +2838,13 @@ void SDPSessionDescription::PrintOn(ostream & strm) const
   strm << "v=" << protocolVersion << CRLF
        << "o=" << ownerUsername << ' '
        << ownerSessionId << ' '
-       << ownerVersion << ' '
-       << GetConnectAddressString(ownerAddress)
+       << ownerVersion << ' ';
+  OutputConnectAddress(strm, ownerAddress)
        << CRLF
        << "s=" << sessionName << CRLF;
 
   if (!defaultConnectAddress.IsEmpty())
-    strm << "c=" << GetConnectAddressString(defaultConnectAddress) << CRLF;
+    OutputConnectAddress(strm << "c=", defaultConnectAddress) << CRLF;
 
   strm << m_bandwidth
        << "t=" << "0 0" << CRLF;
@@ -2824,12 +2936,19 @@ PString SDPSessionDescription::Encode() const
 
 bool SDPSessionDescription::Decode(const PString & str, const OpalMediaFormatList & mediaFormats)
 {
-  // break string into lines
-  return Decode(str.Lines(), mediaFormats);
+  SDPLineTokenizer tokenizer(str);
+  return InternalDecode(tokenizer, mediaFormats);
 }
 
 
 bool SDPSessionDescription::Decode(const PStringArray & lines, const OpalMediaFormatList & mediaFormats)
+{
+  SDPLineTokenizer tokenizer(lines);
+  return InternalDecode(tokenizer, mediaFormats);
+}
+
+
+bool SDPSessionDescription::InternalDecode(SDPLineTokenizer & tokenizer, const OpalMediaFormatList & mediaFormats)
 {
   PTRACE(5, "Decode using media formats:\n    " << setfill(',') << mediaFormats << setfill(' '));
 
@@ -2839,12 +2958,9 @@ bool SDPSessionDescription::Decode(const PStringArray & lines, const OpalMediaFo
 
   // parse keyvalue pairs
   SDPMediaDescription * currentMedia = NULL;
-  for (PINDEX lineIndex = 0; lineIndex < lines.GetSize(); lineIndex++) {
-    const PString & line = lines[lineIndex];
-    if (line.GetLength() < 3 || line[1] != '=')
-      continue; // Ignore illegal lines
-
-    PString value = line.Mid(2).Trim();
+  while (tokenizer.Next()) {
+    char key = tokenizer.GetKey();
+    PString value = tokenizer.GetValue();
 
     /////////////////////////////////
     //
@@ -2852,10 +2968,10 @@ bool SDPSessionDescription::Decode(const PStringArray & lines, const OpalMediaFo
     //
     /////////////////////////////////
 
-    if (currentMedia != NULL && line[0] != 'm')
-      currentMedia->Decode(line[0], value);
+    if (currentMedia != NULL && key != 'm')
+      currentMedia->Decode(key, value);
     else {
-      switch (line[0]) {
+      switch (key) {
         case 'v' : // protocol version (mandatory)
           protocolVersion = value.AsInteger();
           break;
@@ -2908,14 +3024,14 @@ bool SDPSessionDescription::Decode(const PStringArray & lines, const OpalMediaFo
             if (tokens.GetSize() < 4) {
               PTRACE(1, "Media session has only " << tokens.GetSize() << " elements");
             }
-            else if ((mediaType = GetMediaTypeFromSDP(tokens[0], tokens[2], lines, lineIndex)).empty()) {
-              PTRACE(1, "Unknown SDP media type parsing \"" << line << '"');
+            else if ((mediaType = GetMediaTypeFromSDP(tokens[0], tokens[2], tokenizer.GetSection(), 0)).empty()) {
+              PTRACE(1, "Unknown SDP media type parsing \"" << tokenizer.GetLine() << '"');
             }
             else if ((defn = mediaType.GetDefinition()) == NULL) {
-              PTRACE(1, "No definition for media type " << mediaType << " parsing \"" << line << '"');
+              PTRACE(1, "No definition for media type " << mediaType << " parsing \"" << tokenizer.GetLine() << '"');
             }
             else if ((currentMedia = defn->CreateSDPMediaDescription(defaultConnectAddress)) == NULL) {
-              PTRACE(1, "Could not create SDP media description for media type " << mediaType << " parsing \"" << line << '"');
+              PTRACE(1, "Could not create SDP media description for media type " << mediaType << " parsing \"" << tokenizer.GetLine() << '"');
             }
             else {
               PTRACE_CONTEXT_ID_TO(currentMedia);
@@ -2941,7 +3057,7 @@ bool SDPSessionDescription::Decode(const PStringArray & lines, const OpalMediaFo
           break;
 
         default:
-          PTRACE(1, "Unknown session information key " << line[0]);
+          PTRACE(1, "Unknown session information key " << key);
       }
     }
   }
@@ -2465,8 +2465,17 @@ SIP_PDU::StatusCodes SIP_PDU::InternalSend(bool canDoTCP)
       }
       PTRACE(4, "PDU is too large (" << pduLen << " bytes) using compact form.");
     }
+  }
 
-    if (!m_viaAddress.IsEmpty())
+  /* Do not change the remote address of the transport, it may be shared with
+     other PDUs from the same remote being handled on other threads. */
+  OpalTransportUDP * udp = NULL;
+  OpalTransportAddress destination = m_transport->GetRemoteAddress();
+  if (!m_transport->IsReliable() && !m_viaAddress.IsEmpty() && m_viaAddress != destination) {
+    udp = dynamic_cast<OpalTransportUDP *>(&*m_transport);
+    if (udp != NULL)
+      destination = m_viaAddress;
+    else
       m_transport->SetRemoteAddress(m_viaAddress);
   }
 
@@ -2485,7 +2494,7 @@ SIP_PDU::StatusCodes SIP_PDU::InternalSend(bool canDoTCP)
     }
 
     trace << '(' << pduLen << " bytes) to: "
-             "rem=" << m_transport->GetRemoteAddress() << ","
+             "rem=" << destination << ","
              "local=" << m_transport->GetLocalAddress() << ","
              "if=" << m_transport->GetInterface();
 
@@ -2501,7 +2510,8 @@ SIP_PDU::StatusCodes SIP_PDU::InternalSend(bool canDoTCP)
   }
 #endif
 
-  if (m_transport->Write((const char *)pduStr, pduLen))
+  if (udp != NULL ? udp->WriteTo((const char *)pduStr, pduLen, destination)
+                  : m_transport->Write((const char *)pduStr, pduLen))
     return Successful_OK;
 
   PTRACE(1, "PDU (id=" << GetTransactionID() << ")"
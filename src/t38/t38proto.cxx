@@ -39,6 +39,8 @@
 #include <opal/patch.h>
 #include <codec/opalpluginmgr.h>
 
+#include <algorithm>
+
 
 /////////////////////////////////////////////////////////////////////////////
 
@@ -124,6 +126,224 @@ void OpalFaxMediaStream::GetStatistics(OpalMediaStatistics & statistics, bool fr
 }
 
 
+/////////////////////////////////////////////////////////////////////////////
+
+/* Aligned PER of UDPTLPacket is all whole octets:
+     seq-number                 two octets
+     primary-ifp-packet         length + octets
+     error-recovery             one octet, top bit is the choice
+       secondary-ifp-packets    count + { length + octets }
+       fec-info                 length + integer octets, count + { length + octets }
+   Lengths and counts below 128 are one octet, below 16384 are two octets
+   with the top bits 10, anything larger is fragmented and not handled here.
+ */
+
+static const PINDEX MaxShortLength = 16383;
+
+static PINDEX GetLengthSize(PINDEX length)
+{
+  return length < 128 ? 1 : 2;
+}
+
+
+static BYTE * EncodeLength(BYTE * ptr, PINDEX length)
+{
+  if (length >= 128)
+    *ptr++ = (BYTE)(0x80 | (length >> 8));
+  *ptr++ = (BYTE)length;
+  return ptr;
+}
+
+
+static bool DecodeLength(const BYTE * & ptr, const BYTE * end, PINDEX & length)
+{
+  if (ptr >= end)
+    return false;
+
+  BYTE first = *ptr++;
+  if ((first & 0x80) == 0) {
+    length = first;
+    return true;
+  }
+
+  if ((first & 0x40) != 0 || ptr >= end)
+    return false; // Fragmented
+
+  length = ((first & 0x3f) << 8) | *ptr++;
+  return true;
+}
+
+
+static bool DecodeIFP(const BYTE * & ptr, const BYTE * end, OpalUDPTLPacket::IFP & ifp)
+{
+  if (!DecodeLength(ptr, end, ifp.m_size) || ifp.m_size > end - ptr)
+    return false;
+
+  ifp.m_data = ptr;
+  ptr += ifp.m_size;
+  return true;
+}
+
+
+static PINDEX GetIntegerSize(unsigned value)
+{
+  // Two's complement, so a sign bit is needed
+  PINDEX size = 1;
+  while (size < 4 && value >= (1U << (size*8-1)))
+    ++size;
+  return size;
+}
+
+
+OpalUDPTLPacket::OpalUDPTLPacket()
+  : m_sequenceNumber(0)
+  , m_fec(false)
+  , m_fecPackets(0)
+  , m_count(0)
+{
+}
+
+
+void OpalUDPTLPacket::PrintOn(ostream & strm) const
+{
+  strm << "seq=" << m_sequenceNumber << " primary=" << m_primary.m_size;
+  if (m_fec)
+    strm << " fec-npackets=" << m_fecPackets << " fec-data=";
+  else
+    strm << " secondary=";
+  strm << '[';
+  for (PINDEX i = 0; i < m_count; ++i) {
+    if (i > 0)
+      strm << ',';
+    strm << m_entries[i].m_size;
+  }
+  strm << ']';
+}
+
+
+bool OpalUDPTLPacket::Decode(const BYTE * data, PINDEX size)
+{
+  const BYTE * ptr = data;
+  const BYTE * end = data + size;
+
+  if (size < 4)
+    return false;
+
+  m_sequenceNumber = (WORD)((ptr[0] << 8) | ptr[1]);
+  ptr += 2;
+
+  if (!DecodeIFP(ptr, end, m_primary) || ptr >= end)
+    return false;
+
+  // Choice index and padding, odd padding is left to the generic decoder
+  BYTE choice = *ptr++;
+  if ((choice & 0x7f) != 0)
+    return false;
+
+  m_fec = choice != 0;
+  if (m_fec) {
+    PINDEX intSize;
+    if (!DecodeLength(ptr, end, intSize) || intSize < 1 || intSize > 4 || intSize > end - ptr || (*ptr & 0x80) != 0)
+      return false;
+    m_fecPackets = 0;
+    while (intSize-- > 0)
+      m_fecPackets = (m_fecPackets << 8) | *ptr++;
+  }
+  else
+    m_fecPackets = 0;
+
+  if (!DecodeLength(ptr, end, m_count) || m_count > MaxEntries)
+    return false;
+
+  for (PINDEX i = 0; i < m_count; ++i) {
+    if (!DecodeIFP(ptr, end, m_entries[i]))
+      return false;
+  }
+
+  return ptr == end;
+}
+
+
+PINDEX OpalUDPTLPacket::GetEncodedSize() const
+{
+  if (m_primary.m_size > MaxShortLength || m_count > MaxEntries || (m_fec && m_fecPackets > 0x7fffffff))
+    return 0;
+
+  PINDEX size = 2 + GetLengthSize(m_primary.m_size) + m_primary.m_size + 1;
+
+  if (m_fec)
+    size += 1 + GetIntegerSize(m_fecPackets);
+
+  size += GetLengthSize(m_count);
+  for (PINDEX i = 0; i < m_count; ++i) {
+    if (m_entries[i].m_size > MaxShortLength)
+      return 0;
+    size += GetLengthSize(m_entries[i].m_size) + m_entries[i].m_size;
+  }
+
+  return size;
+}
+
+
+PINDEX OpalUDPTLPacket::Encode(BYTE * buffer, PINDEX size) const
+{
+  PINDEX required = GetEncodedSize();
+  if (required == 0 || required > size)
+    return 0;
+
+  BYTE * ptr = buffer;
+  *ptr++ = (BYTE)(m_sequenceNumber >> 8);
+  *ptr++ = (BYTE)m_sequenceNumber;
+
+  ptr = EncodeLength(ptr, m_primary.m_size);
+  memcpy(ptr, m_primary.m_data, m_primary.m_size);
+  ptr += m_primary.m_size;
+
+  *ptr++ = m_fec ? 0x80 : 0x00;
+
+  if (m_fec) {
+    PINDEX intSize = GetIntegerSize(m_fecPackets);
+    *ptr++ = (BYTE)intSize;
+    while (intSize-- > 0)
+      *ptr++ = (BYTE)(m_fecPackets >> (intSize*8));
+  }
+
+  ptr = EncodeLength(ptr, m_count);
+  for (PINDEX i = 0; i < m_count; ++i) {
+    ptr = EncodeLength(ptr, m_entries[i].m_size);
+    memcpy(ptr, m_entries[i].m_data, m_entries[i].m_size);
+    ptr += m_entries[i].m_size;
+  }
+
+  PAssert(ptr - buffer == required, PLogicError);
+  return required;
+}
+
+
+bool OpalUDPTLPacket::SetFromASN(const T38_UDPTLPacket & asn)
+{
+  m_sequenceNumber = (WORD)(unsigned)asn.m_seq_number;
+  m_primary = IFP(asn.m_primary_ifp_packet, asn.m_primary_ifp_packet.GetDataLength());
+
+  m_fec = asn.m_error_recovery.GetTag() == T38_UDPTLPacket_error_recovery::e_fec_info;
+  if (m_fec) {
+    const T38_UDPTLPacket_error_recovery_fec_info & fec = asn.m_error_recovery;
+    m_fecPackets = fec.m_fec_npackets;
+    m_count = std::min(fec.m_fec_data.GetSize(), (PINDEX)MaxEntries);
+    for (PINDEX i = 0; i < m_count; ++i)
+      m_entries[i] = IFP(fec.m_fec_data[i], fec.m_fec_data[i].GetDataLength());
+    return m_count == fec.m_fec_data.GetSize();
+  }
+
+  const T38_UDPTLPacket_error_recovery_secondary_ifp_packets & secondary = asn.m_error_recovery;
+  m_fecPackets = 0;
+  m_count = std::min(secondary.GetSize(), (PINDEX)MaxEntries);
+  for (PINDEX i = 0; i < m_count; ++i)
+    m_entries[i] = IFP(secondary[i], secondary[i].GetDataLength());
+  return m_count == secondary.GetSize();
+}
+
+
 /////////////////////////////////////////////////////////////////////////////
 
 OpalFaxSession::OpalFaxSession(const Init & init)
@@ -132,11 +352,13 @@ OpalFaxSession::OpalFaxSession(const Init & init)
   , m_datagramSize(528)
   , m_consecutiveBadPackets(0)
   , m_awaitingGoodPacket(true)
-  , m_receivedPacket(new T38_UDPTLPacket)
+  , m_receivedASN(new T38_UDPTLPacket)
   , m_expectedSequenceNumber(0)
   , m_secondaryPacket(-1)
   , m_optimiseOnRetransmit(false) // not optimise udptl packets on retransmit
-  , m_sentPacket(new T38_UDPTLPacket)
+  , m_sentIFPs(1)
+  , m_sentCount(1)
+  , m_sentSequenceNumber(0xffff)
   , m_txBytes(0)
   , m_txPackets(0)
   , m_rxBytes(0)
@@ -145,9 +367,6 @@ OpalFaxSession::OpalFaxSession(const Init & init)
 {
   m_timerWriteDataIdle.SetNotifier(PCREATE_NOTIFIER(OnWriteDataIdle), "T38Idle");
 
-  m_sentPacket->m_error_recovery.SetTag(T38_UDPTLPacket_error_recovery::e_secondary_ifp_packets);
-  m_sentPacket->m_seq_number = (unsigned)-1;
-
   m_redundancy[32767] = 1;  // re-send all ifp packets 1 time
 }
 
@@ -155,8 +374,7 @@ OpalFaxSession::OpalFaxSession(const Init & init)
 OpalFaxSession::~OpalFaxSession()
 {
   m_timerWriteDataIdle.Stop();
-  delete m_receivedPacket;
-  delete m_sentPacket;
+  delete m_receivedASN;
 }
 
 
@@ -297,25 +515,11 @@ bool OpalFaxSession::WriteData(RTP_DataFrame & frame)
   PWaitAndSignal mutex(m_writeMutex);
 
   if (!m_sentPacketRedundancy.empty()) {
-    T38_UDPTLPacket_error_recovery &recovery = m_sentPacket->m_error_recovery;
-
-    if (recovery.GetTag() == T38_UDPTLPacket_error_recovery::e_secondary_ifp_packets) {
-      // shift old primary ifp packet to secondary list
-
-      T38_UDPTLPacket_error_recovery_secondary_ifp_packets &secondary = recovery;
-
-      if (secondary.SetSize(secondary.GetSize() + 1)) {
-        for (int i = secondary.GetSize() - 2 ; i >= 0 ; i--) {
-          secondary[i + 1] = secondary[i];
-          secondary[i] = T38_UDPTLPacket_error_recovery_secondary_ifp_packets_subtype();
-        }
-
-        secondary[0].SetValue(m_sentPacket->m_primary_ifp_packet.GetValue());
-        m_sentPacket->m_primary_ifp_packet = T38_UDPTLPacket_primary_ifp_packet();
-      }
-    } else {
-      PTRACE(3, "UDPTL\tNot implemented yet " << recovery.GetTagName());
-    }
+    // shift old primary ifp packet to secondary list, reusing the oldest buffer
+    if (m_sentIFPs.size() <= (size_t)m_sentCount)
+      m_sentIFPs.resize(m_sentCount + 1);
+    std::rotate(m_sentIFPs.begin(), m_sentIFPs.begin() + m_sentCount, m_sentIFPs.begin() + m_sentCount + 1);
+    ++m_sentCount;
   }
 
   // calculate redundancy for new ifp packet
@@ -336,8 +540,10 @@ bool OpalFaxSession::WriteData(RTP_DataFrame & frame)
 
   // set new primary ifp packet
 
-  m_sentPacket->m_seq_number = frame.GetSequenceNumber();
-  m_sentPacket->m_primary_ifp_packet.SetValue(frame.GetPayloadPtr(), plLen);
+  m_sentSequenceNumber = frame.GetSequenceNumber();
+  SentIFP & primary = m_sentIFPs[0];
+  memcpy(primary.m_data.GetPointer(plLen), frame.GetPayloadPtr(), plLen);
+  primary.m_size = plLen;
 
   bool ok = WriteUDPTL();
 
@@ -375,16 +581,8 @@ void OpalFaxSession::DecrementSentPacketRedundancy(bool stripRedundancy)
 
   m_sentPacketRedundancy.resize(iMax + 1);
 
-  if (stripRedundancy) {
-    T38_UDPTLPacket_error_recovery & recovery = m_sentPacket->m_error_recovery;
-
-    if (recovery.GetTag() == T38_UDPTLPacket_error_recovery::e_secondary_ifp_packets) {
-      T38_UDPTLPacket_error_recovery_secondary_ifp_packets &secondary = recovery;
-      secondary.SetSize(iMax > 0 ? iMax : 0);
-    } else {
-      PTRACE(3, "UDPTL\tNot implemented yet " << recovery.GetTagName());
-    }
-  }
+  if (stripRedundancy && m_sentCount > iMax + 1)
+    m_sentCount = iMax > 0 ? iMax + 1 : 1;
 }
 
 
@@ -395,11 +593,41 @@ bool OpalFaxSession::WriteUDPTL()
     return false;
   }
 
+  PINDEX secondaryCount = m_sentCount - 1;
+  if (secondaryCount <= OpalUDPTLPacket::MaxEntries) {
+    OpalUDPTLPacket packet;
+    packet.m_sequenceNumber = m_sentSequenceNumber;
+    packet.m_primary = OpalUDPTLPacket::IFP(m_sentIFPs[0].m_data, m_sentIFPs[0].m_size);
+    packet.m_count = secondaryCount;
+    for (PINDEX i = 0; i < secondaryCount; ++i)
+      packet.m_entries[i] = OpalUDPTLPacket::IFP(m_sentIFPs[i+1].m_data, m_sentIFPs[i+1].m_size);
+
+    PINDEX size = packet.GetEncodedSize();
+    if (size > 0 && packet.Encode(m_sentData.GetPointer(size), size) == size) {
+      PTRACE(5, "UDPTL\tEncoded transmitted UDPTL data, size=" << size << " : " << packet);
+
+      m_txBytes += size;
+      ++m_txPackets;
+
+      return m_transport->Write(m_sentData, size);
+    }
+  }
+
+  // Unusual sizes, use the generic ASN.1 encoder
+  T38_UDPTLPacket asn;
+  asn.m_seq_number = m_sentSequenceNumber;
+  asn.m_primary_ifp_packet.SetValue(m_sentIFPs[0].m_data, m_sentIFPs[0].m_size);
+  asn.m_error_recovery.SetTag(T38_UDPTLPacket_error_recovery::e_secondary_ifp_packets);
+  T38_UDPTLPacket_error_recovery_secondary_ifp_packets & secondary = asn.m_error_recovery;
+  secondary.SetSize(secondaryCount);
+  for (PINDEX i = 0; i < secondaryCount; ++i)
+    secondary[i].SetValue(m_sentIFPs[i+1].m_data, m_sentIFPs[i+1].m_size);
+
   PPER_Stream rawData;
-  m_sentPacket->Encode(rawData);
+  asn.Encode(rawData);
   rawData.CompleteEncoding();
 
-  PTRACE(5, "UDPTL\tEncoded transmitted UDPTL data, size=" << rawData.GetSize() << " :\n  " << setprecision(2) << *m_sentPacket);
+  PTRACE(5, "UDPTL\tEncoded transmitted UDPTL data, size=" << rawData.GetSize() << " :\n  " << setprecision(2) << asn);
 
   m_txBytes += rawData.GetSize();
   ++m_txPackets;
@@ -408,9 +636,9 @@ bool OpalFaxSession::WriteUDPTL()
 }
 
 
-void OpalFaxSession::SetFrameFromIFP(RTP_DataFrame & frame, const PASN_OctetString & ifp, unsigned sequenceNumber)
+void OpalFaxSession::SetFrameFromIFP(RTP_DataFrame & frame, const OpalUDPTLPacket::IFP & ifp, unsigned sequenceNumber)
 {
-  frame.SetPayload(ifp, ifp.GetDataLength());
+  frame.SetPayload(ifp.m_data, ifp.m_size);
   frame.SetSequenceNumber((WORD)(sequenceNumber & 0xffff));
   if (m_secondaryPacket <= 0)
     m_expectedSequenceNumber = sequenceNumber+1;
@@ -423,44 +651,60 @@ void OpalFaxSession::OnReadPacket(OpalMediaTransport &, PBYTEArray data)
 }
 
 
+bool OpalFaxSession::DecodeUDPTL(bool & usedASN)
+{
+  usedASN = false;
+  if (m_receivedPacket.Decode(m_receivedData, m_receivedData.GetSize()))
+    return true;
+
+  // Unusual encoding, or not UDPTL at all, let the generic ASN.1 decoder decide
+  usedASN = true;
+  PPER_Stream per(m_receivedData);
+  if (!m_receivedASN->Decode(per) || per.GetPosition() < per.GetSize())
+    return false;
+
+  if (!m_receivedPacket.SetFromASN(*m_receivedASN)) {
+    PTRACE(4, "UDPTL\tToo many error recovery entries, only using first " << OpalUDPTLPacket::MaxEntries);
+  }
+  return true;
+}
+
+
 bool OpalFaxSession::ReadData(RTP_DataFrame & frame)
 {
-  PBYTEArray rawData;
-  if (!m_readQueue.Dequeue(rawData))
+  // Deliver anything reconstructed from redundancy before the next datagram
+  if (m_secondaryPacket >= 0) {
+    if (m_secondaryPacket == 0)
+      SetFrameFromIFP(frame, m_receivedPacket.m_primary, m_receivedPacket.m_sequenceNumber);
+    else
+      SetFrameFromIFP(frame, m_receivedPacket.m_entries[m_secondaryPacket-1], m_receivedPacket.m_sequenceNumber - m_secondaryPacket);
+    --m_secondaryPacket;
+    return true;
+  }
+
+  if (!m_readQueue.Dequeue(m_receivedData))
     return false;
 
-  if (rawData.GetSize() >= m_datagramSize) {
+  if (m_receivedData.GetSize() >= m_datagramSize) {
     PTRACE(4, "UDPTL\tProbable RTP packet");
     return true;
   }
 
   if (m_rawUDPTL) {
-    frame.SetPayload(rawData, rawData.GetSize());
+    frame.SetPayload(m_receivedData, m_receivedData.GetSize());
     m_rxBytes += frame.GetPayloadSize();
     ++m_rxPackets;
     PTRACE(5, "UDPTL\tRead raw UDPTL, size " << frame.GetPayloadSize());
     return true;
   }
 
-  if (m_secondaryPacket >= 0) {
-    if (m_secondaryPacket == 0)
-      SetFrameFromIFP(frame, m_receivedPacket->m_primary_ifp_packet, m_receivedPacket->m_seq_number);
-    else {
-      T38_UDPTLPacket_error_recovery_secondary_ifp_packets & secondaryPackets = m_receivedPacket->m_error_recovery;
-      SetFrameFromIFP(frame, secondaryPackets[m_secondaryPacket-1], m_receivedPacket->m_seq_number - m_secondaryPacket);
-    }
-    --m_secondaryPacket;
-    return true;
-  }
-
-  PPER_Stream per(rawData);
   // Decode the PDU, but not if still receiving RTP
-  if (  !m_receivedPacket->Decode(per) ||
-         per.GetPosition() < per.GetSize() ||
+  bool usedASN;
+  if (  !DecodeUDPTL(usedASN) ||
         (m_awaitingGoodPacket &&
           (
-            m_receivedPacket->m_primary_ifp_packet.GetSize() == 0 ||
-            m_receivedPacket->m_seq_number >= 32768
+            m_receivedPacket.m_primary.m_size == 0 ||
+            m_receivedPacket.m_sequenceNumber >= 32768
           )
         )
      )
@@ -476,11 +720,13 @@ bool OpalFaxSession::ReadData(RTP_DataFrame & frame)
       ostream & trace = PTRACE_BEGIN(Level);
       trace << "UDPTL\t";
       if (m_awaitingGoodPacket)
-        trace << "Probable RTP packet: " << rawData.GetSize() << " bytes.";
+        trace << "Probable RTP packet: " << m_receivedData.GetSize() << " bytes.";
       else {
         trace << "Raw data decode failure:\n  "
-              << setprecision(2) << rawData << "\n  UDPTL = "
-              << setprecision(2) << m_receivedPacket;
+              << setprecision(2) << m_receivedData;
+        // Otherwise it holds some earlier packet
+        if (usedASN)
+          trace << "\n  UDPTL = " << setprecision(2) << *m_receivedASN;
       }
       trace << PTrace::End;
     }
@@ -493,27 +739,22 @@ bool OpalFaxSession::ReadData(RTP_DataFrame & frame)
   m_awaitingGoodPacket = false;
   m_consecutiveBadPackets = 0;
 
-  PTRACE(5, "UDPTL\tDecoded UDPTL packet:\n  " << setprecision(2) << *m_receivedPacket);
+  PTRACE(5, "UDPTL\tDecoded UDPTL packet: " << m_receivedPacket);
 
-  int missing = m_receivedPacket->m_seq_number - m_expectedSequenceNumber;
-  if (missing > 0 && m_receivedPacket->m_error_recovery.GetTag() == T38_UDPTLPacket_error_recovery::e_secondary_ifp_packets) {
+  int missing = m_receivedPacket.m_sequenceNumber - m_expectedSequenceNumber;
+  if (missing > 0 && !m_receivedPacket.m_fec && m_receivedPacket.m_count > 0) {
     // Packets are missing and we have redundency in the UDPTL packets
-    T38_UDPTLPacket_error_recovery_secondary_ifp_packets & secondaryPackets = m_receivedPacket->m_error_recovery;
-    if (secondaryPackets.GetSize() > 0) {
-      PTRACE(4, "UDPTL\tUsing redundant data to reconstruct missing/out of order packet at SN=" << m_expectedSequenceNumber);
-      m_secondaryPacket = missing;
-      if ((PINDEX)m_secondaryPacket > secondaryPackets.GetSize())
-        m_secondaryPacket = secondaryPackets.GetSize();
-      SetFrameFromIFP(frame, secondaryPackets[m_secondaryPacket-1], m_receivedPacket->m_seq_number - m_secondaryPacket);
-      --m_secondaryPacket;
-      return true;
-    }
+    PTRACE(4, "UDPTL\tUsing redundant data to reconstruct missing/out of order packet at SN=" << m_expectedSequenceNumber);
+    m_secondaryPacket = std::min(missing, (int)m_receivedPacket.m_count);
+    SetFrameFromIFP(frame, m_receivedPacket.m_entries[m_secondaryPacket-1], m_receivedPacket.m_sequenceNumber - m_secondaryPacket);
+    --m_secondaryPacket;
+    return true;
   }
 
-  SetFrameFromIFP(frame, m_receivedPacket->m_primary_ifp_packet, m_receivedPacket->m_seq_number);
-  m_expectedSequenceNumber = m_receivedPacket->m_seq_number+1;
+  SetFrameFromIFP(frame, m_receivedPacket.m_primary, m_receivedPacket.m_sequenceNumber);
+  m_expectedSequenceNumber = m_receivedPacket.m_sequenceNumber+1;
 
-  m_rxBytes += rawData.GetSize();
+  m_rxBytes += m_receivedData.GetSize();
   ++m_rxPackets;
   m_missingPackets += missing;
 